@@ -189,6 +189,7 @@ typedef enum
 #endif /* VBOX_WITH_64_BITS_GUESTS */
     VMMDevReq_HGCMCancel                 = 64,
     VMMDevReq_HGCMCancel2                = 65,
+    VMMDevReq_HGCMCallBatch              = 66,
 #endif
     VMMDevReq_VideoAccelEnable           = 70,
     VMMDevReq_VideoAccelFlush            = 71,
@@ -1917,6 +1918,36 @@ typedef struct
 } VMMDevHGCMCancel2;
 AssertCompileSize(VMMDevHGCMCancel2, 24+4);
 
+/** The maximum number of calls in a VMMDevHGCMCallBatch request. */
+#define VMMDEV_HGCM_BATCH_MAX_CALLS 64
+
+/**
+ * HGCM call batch request structure.
+ *
+ * Used by VMMDevReq_HGCMCallBatch to submit several HGCM calls with a single
+ * VMMDev request.  Each call is a complete VMMDevReq_HGCMCall32/64 request
+ * embedded in the batch at the given offset (dword aligned), and completes on
+ * its own exactly as if it had been submitted separately: the host sets
+ * VBOX_HGCM_REQ_DONE in its header, raises VMMDEV_EVENT_HGCM, and it can be
+ * cancelled using its own physical address.  The submission status of every
+ * call is returned in its header.header.rc.
+ *
+ * VINF_SUCCESS when all calls were submitted.
+ * VERR_INVALID_PARAMETER if the batch is malformed, no call was submitted.
+ */
+typedef struct
+{
+    /** Header. */
+    VMMDevRequestHeader header;
+    /** Number of calls, 1 to VMMDEV_HGCM_BATCH_MAX_CALLS. */
+    uint32_t cCalls;
+    /** Reserved, MBZ. */
+    uint32_t u32Reserved;
+    /** Offsets of the calls relative to the start of the request, aoffCalls[cCalls]. */
+    uint32_t aoffCalls[1];
+} VMMDevHGCMCallBatch;
+AssertCompileSize(VMMDevHGCMCallBatch, 24+12);
+
 #endif /* VBOX_WITH_HGCM */
 
 
@@ -1990,6 +2021,8 @@ DECLINLINE(size_t) vmmdevGetRequestSize(VMMDevRequestType requestType)
 #endif /* VBOX_WITH_64_BITS_GUESTS */
         case VMMDevReq_HGCMCancel:
             return sizeof(VMMDevHGCMCancel);
+        case VMMDevReq_HGCMCallBatch:
+            return sizeof(VMMDevHGCMCallBatch);
 #endif /* VBOX_WITH_HGCM */
         case VMMDevReq_VideoAccelEnable:
             return sizeof(VMMDevVideoAccelEnable);
@@ -27,6 +27,7 @@
 #define ___VBox_hgcm_h
 
 #include <iprt/assert.h>
+#include <iprt/param.h>
 #include <iprt/string.h>
 #include <VBox/cdefs.h>
 #include <VBox/types.h>
@@ -61,9 +62,11 @@
  * 4.1->4.2 Because the VBOX_HGCM_SVC_PARM_CALLBACK parameter type was added
  * 4.2->5.1 Removed the VBOX_HGCM_SVC_PARM_CALLBACK parameter type, as
  *          this problem is already solved by service extension callbacks
+ * 5.1->5.2 Because the VBOX_HGCM_SVC_PARM_PAGES parameter type and the
+ *          VBOXHGCMSVCFNTABLE::fFlags member were added
  */
 #define VBOX_HGCM_SVC_VERSION_MAJOR (0x0005)
-#define VBOX_HGCM_SVC_VERSION_MINOR (0x0001)
+#define VBOX_HGCM_SVC_VERSION_MINOR (0x0002)
 #define VBOX_HGCM_SVC_VERSION ((VBOX_HGCM_SVC_VERSION_MAJOR << 16) + VBOX_HGCM_SVC_VERSION_MINOR)
 
 
@@ -90,6 +93,92 @@ typedef VBOXHGCMSVCHELPERS *PVBOXHGCMSVCHELPERS;
 #define VBOX_HGCM_SVC_PARM_32BIT (1U)
 #define VBOX_HGCM_SVC_PARM_64BIT (2U)
 #define VBOX_HGCM_SVC_PARM_PTR   (3U)
+/** Locked guest pages, see VBOXHGCMSVCPARMPAGES.  Only passed to services
+ * which set VBOX_HGCM_SVC_F_PAGE_LISTS, for the functions selected by
+ * VBOXHGCMSVCFNTABLE::bmPageListFunctions.  HGCM converts them to
+ * VBOX_HGCM_SVC_PARM_PTR for all other calls. */
+#define VBOX_HGCM_SVC_PARM_PAGES (4U)
+
+/**
+ * Scatter/gather view of a guest buffer for VBOX_HGCM_SVC_PARM_PAGES.
+ *
+ * The guest pages stay mapped and locked until the call is completed, so the
+ * service accesses guest memory directly instead of a host copy.  Each entry
+ * of papvPages maps a whole page, the data starts at offFirstPage in the
+ * first one.
+ */
+typedef struct VBOXHGCMSVCPARMPAGES
+{
+    /** Number of pages in papvPages. */
+    uint32_t    cPages;
+    /** The transfer direction, VBOX_HGCM_F_PARM_DIRECTION_XXX.  The pages
+     * must not be written unless VBOX_HGCM_F_PARM_DIRECTION_FROM_HOST is
+     * set, they may be mapped read-only. */
+    uint32_t    fFlags;
+    /** Offset of the data into the first page. */
+    uint32_t    offFirstPage;
+    /** Explicit alignment padding. */
+    uint32_t    u32Padding;
+    /** Ring-3 mappings of the pages. */
+    void      **papvPages;
+} VBOXHGCMSVCPARMPAGES;
+/** Pointer to a page list parameter descriptor. */
+typedef VBOXHGCMSVCPARMPAGES *PVBOXHGCMSVCPARMPAGES;
+/** Pointer to a const page list parameter descriptor. */
+typedef VBOXHGCMSVCPARMPAGES const *PCVBOXHGCMSVCPARMPAGES;
+
+/**
+ * Copies data out of a page list.
+ *
+ * @param   pPages      The page list.
+ * @param   off         The offset into the buffer described by the list.
+ * @param   pvDst       Where to copy to.
+ * @param   cb          Number of bytes to copy.  The caller checks that
+ *                      off + cb is within the parameter size.
+ */
+DECLINLINE(void) VBoxHGCMSvcPagesRead(PCVBOXHGCMSVCPARMPAGES pPages, uint32_t off, void *pvDst, uint32_t cb)
+{
+    uint8_t *pbDst   = (uint8_t *)pvDst;
+    size_t   offBuf  = (size_t)pPages->offFirstPage + off;
+    uint32_t iPage   = (uint32_t)(offBuf >> PAGE_SHIFT);
+    uint32_t offPage = (uint32_t)(offBuf & PAGE_OFFSET_MASK);
+    while (cb > 0 && iPage < pPages->cPages)
+    {
+        uint32_t cbChunk = RT_MIN(cb, PAGE_SIZE - offPage);
+        memcpy(pbDst, (uint8_t const *)pPages->papvPages[iPage] + offPage, cbChunk);
+        pbDst  += cbChunk;
+        cb     -= cbChunk;
+        offPage = 0;
+        iPage++;
+    }
+}
+
+/**
+ * Copies data into a page list.
+ *
+ * @param   pPages      The page list.  Must have been passed with
+ *                      VBOX_HGCM_F_PARM_DIRECTION_FROM_HOST.
+ * @param   off         The offset into the buffer described by the list.
+ * @param   pvSrc       What to copy.
+ * @param   cb          Number of bytes to copy.  The caller checks that
+ *                      off + cb is within the parameter size.
+ */
+DECLINLINE(void) VBoxHGCMSvcPagesWrite(PCVBOXHGCMSVCPARMPAGES pPages, uint32_t off, void const *pvSrc, uint32_t cb)
+{
+    uint8_t const *pbSrc = (uint8_t const *)pvSrc;
+    size_t   offBuf  = (size_t)pPages->offFirstPage + off;
+    uint32_t iPage   = (uint32_t)(offBuf >> PAGE_SHIFT);
+    uint32_t offPage = (uint32_t)(offBuf & PAGE_OFFSET_MASK);
+    while (cb > 0 && iPage < pPages->cPages)
+    {
+        uint32_t cbChunk = RT_MIN(cb, PAGE_SIZE - offPage);
+        memcpy((uint8_t *)pPages->papvPages[iPage] + offPage, pbSrc, cbChunk);
+        pbSrc  += cbChunk;
+        cb     -= cbChunk;
+        offPage = 0;
+        iPage++;
+    }
+}
 
 typedef struct VBOXHGCMSVCPARM
 {
@@ -105,6 +194,12 @@ typedef struct VBOXHGCMSVCPARM
             uint32_t size;
             void *addr;
         } pointer;
+        struct
+        {
+            /** The size of the buffer described by pPages. */
+            uint32_t size;
+            PVBOXHGCMSVCPARMPAGES pPages;
+        } pages;
     } u;
 #ifdef __cplusplus
     /** Extract an uint32_t value from an HGCM parameter structure */
@@ -218,6 +313,57 @@ typedef struct VBOXHGCMSVCPARM
         return rc;
     }
 
+    /** Extract a page list from an HGCM parameter structure */
+    int getPages(PVBOXHGCMSVCPARMPAGES *ppPages, uint32_t *pcb)
+    {
+        AssertPtrReturn(ppPages, VERR_INVALID_POINTER);
+        AssertPtrReturn(pcb, VERR_INVALID_POINTER);
+        if (type == VBOX_HGCM_SVC_PARM_PAGES)
+        {
+            *ppPages = u.pages.pPages;
+            *pcb     = u.pages.size;
+            return VINF_SUCCESS;
+        }
+
+        return VERR_INVALID_PARAMETER;
+    }
+
+    /** Get the size of a pointer or page list parameter, 0 for other types */
+    uint32_t getBufferSize(void) const
+    {
+        if (type == VBOX_HGCM_SVC_PARM_PTR)
+            return u.pointer.size;
+        if (type == VBOX_HGCM_SVC_PARM_PAGES)
+            return u.pages.size;
+        return 0;
+    }
+
+    /** Copy data out of a pointer or page list parameter */
+    int readBuffer(uint32_t off, void *pvDst, uint32_t cb) const
+    {
+        uint32_t const cbBuf = getBufferSize();
+        if (off > cbBuf || cb > cbBuf - off)
+            return VERR_INVALID_PARAMETER;
+        if (type == VBOX_HGCM_SVC_PARM_PTR)
+            memcpy(pvDst, (uint8_t const *)u.pointer.addr + off, cb);
+        else
+            VBoxHGCMSvcPagesRead(u.pages.pPages, off, pvDst, cb);
+        return VINF_SUCCESS;
+    }
+
+    /** Copy data into a pointer or page list parameter */
+    int writeBuffer(uint32_t off, void const *pvSrc, uint32_t cb)
+    {
+        uint32_t const cbBuf = getBufferSize();
+        if (off > cbBuf || cb > cbBuf - off)
+            return VERR_INVALID_PARAMETER;
+        if (type == VBOX_HGCM_SVC_PARM_PTR)
+            memcpy((uint8_t *)u.pointer.addr + off, pvSrc, cb);
+        else
+            VBoxHGCMSvcPagesWrite(u.pages.pPages, off, pvSrc, cb);
+        return VINF_SUCCESS;
+    }
+
     /** Set a uint32_t value to an HGCM parameter structure */
     void setUInt32(uint32_t u32)
     {
@@ -410,10 +556,23 @@ typedef struct VBOXHGCMSVCFNTABLE
     /** User/instance data pointer for the service. */
     void *pvService;
 
+    /** VBOX_HGCM_SVC_F_XXX. */
+    uint32_t                 fFlags;
+
+    /** With VBOX_HGCM_SVC_F_PAGE_LISTS, bit N set means that calls to function
+     * N get page lists, the other functions get heap copies.  Zero for all. */
+    uint64_t                 bmPageListFunctions;
+
     /** @} */
 } VBOXHGCMSVCFNTABLE;
 #pragma pack()
 
+/** @name VBOXHGCMSVCFNTABLE::fFlags
+ * @{ */
+/** The service handles VBOX_HGCM_SVC_PARM_PAGES parameters itself. */
+#define VBOX_HGCM_SVC_F_PAGE_LISTS  UINT32_C(0x00000001)
+/** @} */
+
 
 /** Service initialization entry point. */
 typedef DECLCALLBACK(int) VBOXHGCMSVCLOAD(VBOXHGCMSVCFNTABLE *ptable);
@@ -1730,7 +1730,33 @@ VMMR3DECL(int)      DBGFR3OSQueryNameAndVersion(PUVM pUVM, char *pszName, size_t
 VMMR3DECL(void *)   DBGFR3OSQueryInterface(PUVM pUVM, DBGFOSINTERFACE enmIf);
 
 
+/** @name DBGFCORE_F_XXX - Flags for DBGFR3CoreWriteEx and DBGFR3CoreWriteToStream.
+ * @{ */
+/** Replace an existing file. */
+#define DBGFCORE_F_REPLACE_FILE         RT_BIT_32(0)
+/** Leave holes in the file for zero pages (regular files only). */
+#define DBGFCORE_F_SKIP_ZERO_PAGES      RT_BIT_32(1)
+/** Compress the core with gzip, using multiple threads. */
+#define DBGFCORE_F_GZIP                 RT_BIT_32(2)
+/** Valid flags. */
+#define DBGFCORE_F_VALID_MASK           UINT32_C(0x00000007)
+/** @} */
+
+/**
+ * Core dump stream output callback.
+ *
+ * @returns VBox status code, failure aborts the dump.
+ * @param   pvUser          The user argument.
+ * @param   pvBuf           The data to write.
+ * @param   cbBuf           The number of bytes to write.
+ */
+typedef DECLCALLBACK(int) FNDBGFCOREWRITE(void *pvUser, const void *pvBuf, size_t cbBuf);
+/** Pointer to a core dump stream output callback. */
+typedef FNDBGFCOREWRITE *PFNDBGFCOREWRITE;
+
 VMMR3DECL(int)      DBGFR3CoreWrite(PUVM pUVM, const char *pszFilename, bool fReplaceFile);
+VMMR3DECL(int)      DBGFR3CoreWriteEx(PUVM pUVM, const char *pszFilename, uint32_t fFlags);
+VMMR3DECL(int)      DBGFR3CoreWriteToStream(PUVM pUVM, PFNDBGFCOREWRITE pfnWrite, void *pvUser, uint32_t fFlags);
 
 
 #ifdef IN_RING3
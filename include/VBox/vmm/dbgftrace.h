@@ -27,6 +27,7 @@
 #define ___VBox_vmm_dbgftrace_h
 
 #include <iprt/trace.h>
+#include <iprt/assert.h>
 #include <VBox/types.h>
 
 RT_C_DECLS_BEGIN
@@ -49,6 +50,98 @@ RT_C_DECLS_BEGIN
 VMMDECL(int) DBGFR3TraceConfig(PVM pVM, const char *pszConfig);
 
 
+/** @name Binary Trace Ring Groups
+ * These live in VMCPU::fTraceGroups next to the VMM trace point groups and are
+ * enabled by the "exit", "irq" and "io" trace config names.
+ * @{ */
+/** VM-exits. */
+#define DBGFTRACE_GRP_EXIT      RT_BIT_32(24)
+/** Interrupt delivery. */
+#define DBGFTRACE_GRP_IRQ       RT_BIT_32(25)
+/** I/O port and MMIO accesses. */
+#define DBGFTRACE_GRP_IO        RT_BIT_32(26)
+/** @} */
+
+/**
+ * Binary trace ring event types.
+ *
+ * The meaning of the arguments of DBGFTRACEENTRY is given for each event.
+ * Never change the value of an existing event, the stream format depends on
+ * them.
+ */
+typedef enum DBGFTRACEEVT
+{
+    /** Invalid zero entry. */
+    DBGFTRACEEVT_INVALID = 0,
+    /** VM-exit: u32Arg=exit reason/code, u64Arg1=guest RIP,
+     *  u64Arg2=exit qualification (VT-x) or exit info 1 (AMD-V). */
+    DBGFTRACEEVT_VMEXIT,
+    /** Interrupt fetched for delivery: u32Arg=vector, u64Arg1=source tag,
+     *  u64Arg2=1 for APIC, 0 for PIC. */
+    DBGFTRACEEVT_IRQ,
+    /** I/O port read: u32Arg=port, u64Arg1=value, u64Arg2=access size. */
+    DBGFTRACEEVT_IOPORT_READ,
+    /** I/O port write: u32Arg=port, u64Arg1=value, u64Arg2=access size. */
+    DBGFTRACEEVT_IOPORT_WRITE,
+    /** MMIO read: u32Arg=access size, u64Arg1=GCPhys, u64Arg2=value. */
+    DBGFTRACEEVT_MMIO_READ,
+    /** MMIO write: u32Arg=access size, u64Arg1=GCPhys, u64Arg2=value. */
+    DBGFTRACEEVT_MMIO_WRITE,
+    /** The end of valid events (exclusive). */
+    DBGFTRACEEVT_END,
+    /** The usual 32-bit hack. */
+    DBGFTRACEEVT_32BIT_HACK = 0x7fffffff
+} DBGFTRACEEVT;
+
+/**
+ * Binary trace ring entry.
+ */
+typedef struct DBGFTRACEENTRY
+{
+    /** The host TSC when the event was recorded. */
+    uint64_t            u64Tsc;
+    /** The event type (DBGFTRACEEVT). */
+    uint16_t            u16Evt;
+    /** The virtual CPU which recorded the event. */
+    uint16_t            idCpu;
+    /** Event specific argument. */
+    uint32_t            u32Arg;
+    /** Event specific argument. */
+    uint64_t            u64Arg1;
+    /** Event specific argument. */
+    uint64_t            u64Arg2;
+} DBGFTRACEENTRY;
+AssertCompileSize(DBGFTRACEENTRY, 32);
+/** Pointer to a binary trace ring entry. */
+typedef DBGFTRACEENTRY *PDBGFTRACEENTRY;
+/** Pointer to a const binary trace ring entry. */
+typedef DBGFTRACEENTRY const *PCDBGFTRACEENTRY;
+
+VMM_INT_DECL(void) DBGFTraceRingRecord(PVMCPU pVCpu, DBGFTRACEEVT enmEvt, uint32_t u32Arg, uint64_t u64Arg1, uint64_t u64Arg2);
+
+/**
+ * Records an event in the binary trace ring of the calling virtual CPU if the
+ * event group is enabled.
+ *
+ * Unlike the text trace macros below, this one is always compiled in as it
+ * only costs a test of VMCPU::fTraceGroups while disabled.  The user of this
+ * macro is responsible of including VBox/vmm/vm.h.
+ *
+ * @param   a_pVCpu     The cross context virtual CPU structure of the calling
+ *                      EMT.
+ * @param   a_fGrp      The DBGFTRACE_GRP_XXX group of the event.
+ * @param   a_enmEvt    The event type (DBGFTRACEEVT).
+ * @param   a_u32Arg    Event argument.
+ * @param   a_u64Arg1   Event argument.
+ * @param   a_u64Arg2   Event argument.
+ */
+#define DBGFTRACE_RING_EVT(a_pVCpu, a_fGrp, a_enmEvt, a_u32Arg, a_u64Arg1, a_u64Arg2) \
+    do { \
+        if (RT_UNLIKELY((a_pVCpu)->fTraceGroups & (a_fGrp))) \
+            DBGFTraceRingRecord((a_pVCpu), (a_enmEvt), (a_u32Arg), (a_u64Arg1), (a_u64Arg2)); \
+    } while (0)
+
+
 /** @name VMM Internal Trace Macros
  * @remarks The user of these macros is responsible of including VBox/vmm/vm.h.
  * @{
@@ -0,0 +1,165 @@
+/** @file
+ * DBGF - Debugger Facility, Binary Trace Stream Format.
+ */
+
+/*
+ * Copyright (C) 2015 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ *
+ * The contents of this file may alternatively be used under the terms
+ * of the Common Development and Distribution License Version 1.0
+ * (CDDL) only, as it comes in the "COPYING.CDDL" file of the
+ * VirtualBox OSE distribution, in which case the provisions of the
+ * CDDL are applicable instead of those of the GPL.
+ *
+ * You may elect to license modified versions of this file under the
+ * terms and conditions of either the GPL or the CDDL or both.
+ */
+
+#ifndef ___VBox_vmm_dbgftracefmt_h
+#define ___VBox_vmm_dbgftracefmt_h
+
+#include <VBox/types.h>
+#include <iprt/assert.h>
+
+
+RT_C_DECLS_BEGIN
+
+
+/** @defgroup grp_dbgf_tracefmt  Binary Trace Stream Format
+ * @ingroup grp_dbgf_trace
+ *
+ * The stream starts with a DBGFTRACEFILEHDR followed by any number of chunks.
+ * Each chunk is a DBGFTRACECHUNKHDR followed by DBGFTRACECHUNKHDR::cbData
+ * bytes of packed entries from a single virtual CPU.
+ *
+ * A packed entry is the event type byte (DBGFTRACEEVT) followed by four
+ * unsigned LEB128 encoded values: the TSC delta to the previous entry in the
+ * chunk (the first is relative to DBGFTRACECHUNKHDR::u64TscFirst), u32Arg,
+ * u64Arg1 and u64Arg2.  A typical entry thus takes 6 to 16 bytes instead of
+ * the 32 bytes of DBGFTRACEENTRY.
+ *
+ * All integers are little endian.
+ *
+ * @{
+ */
+
+/** DBGFTRACEFILEHDR::szMagic. */
+#define DBGFTRACEFILEHDR_MAGIC          "VBoxTrc"
+/** DBGFTRACEFILEHDR::u32Version. */
+#define DBGFTRACEFILEHDR_VERSION        UINT32_C(0x00010000)
+/** DBGFTRACECHUNKHDR::u32Magic ('TRCK'). */
+#define DBGFTRACECHUNKHDR_MAGIC         UINT32_C(0x4b435254)
+/** The maximum size of a packed entry. */
+#define DBGFTRACE_PACKED_ENTRY_MAX      (1 + 10 + 5 + 10 + 10)
+
+/**
+ * The stream header.
+ */
+typedef struct DBGFTRACEFILEHDR
+{
+    /** Magic string (DBGFTRACEFILEHDR_MAGIC), zero terminated. */
+    char                szMagic[8];
+    /** The format version (DBGFTRACEFILEHDR_VERSION). */
+    uint32_t            u32Version;
+    /** The size of this header. */
+    uint32_t            cbHdr;
+    /** The number of virtual CPUs. */
+    uint32_t            cCpus;
+    /** The number of entries in each per virtual CPU ring. */
+    uint32_t            cRingEntries;
+    /** The host TSC frequency (Hz), 0 if unknown. */
+    uint64_t            u64TscHz;
+    /** The host TSC when the stream was started. */
+    uint64_t            u64TscStart;
+    /** The UTC time (nanoseconds since the epoch) when the stream was started. */
+    int64_t             i64UtcStart;
+} DBGFTRACEFILEHDR;
+AssertCompileSize(DBGFTRACEFILEHDR, 48);
+/** Pointer to a stream header. */
+typedef DBGFTRACEFILEHDR *PDBGFTRACEFILEHDR;
+
+/**
+ * A chunk header.
+ */
+typedef struct DBGFTRACECHUNKHDR
+{
+    /** Magic (DBGFTRACECHUNKHDR_MAGIC). */
+    uint32_t            u32Magic;
+    /** The virtual CPU the entries were recorded on. */
+    uint16_t            idCpu;
+    /** The number of entries in the chunk. */
+    uint16_t            cEntries;
+    /** The number of bytes of packed entries following the header. */
+    uint32_t            cbData;
+    /** The number of entries lost (ring overrun) right before this chunk. */
+    uint32_t            cLost;
+    /** The TSC of the first entry. */
+    uint64_t            u64TscFirst;
+} DBGFTRACECHUNKHDR;
+AssertCompileSize(DBGFTRACECHUNKHDR, 24);
+/** Pointer to a chunk header. */
+typedef DBGFTRACECHUNKHDR *PDBGFTRACECHUNKHDR;
+/** Pointer to a const chunk header. */
+typedef DBGFTRACECHUNKHDR const *PCDBGFTRACECHUNKHDR;
+
+
+/**
+ * Packs an unsigned integer (LEB128).
+ *
+ * @returns Pointer to the byte following the encoding.
+ * @param   pb          Where to store it, room for 10 bytes is required.
+ * @param   uValue      The value.
+ */
+DECLINLINE(uint8_t *) DBGFTracePackU64(uint8_t *pb, uint64_t uValue)
+{
+    while (uValue >= 0x80)
+    {
+        *pb++ = (uint8_t)(uValue | 0x80);
+        uValue >>= 7;
+    }
+    *pb++ = (uint8_t)uValue;
+    return pb;
+}
+
+
+/**
+ * Unpacks an unsigned integer (LEB128).
+ *
+ * @returns Pointer to the byte following the encoding, NULL if it overruns
+ *          @a pbEnd or is too long.
+ * @param   pb          The encoded value.
+ * @param   pbEnd       The end of the input.
+ * @param   puValue     Where to return the value.
+ */
+DECLINLINE(uint8_t const *) DBGFTraceUnpackU64(uint8_t const *pb, uint8_t const *pbEnd, uint64_t *puValue)
+{
+    uint64_t uValue = 0;
+    unsigned cShift = 0;
+    while (pb < pbEnd && cShift < 64)
+    {
+        uint8_t const b = *pb++;
+        uValue |= (uint64_t)(b & 0x7f) << cShift;
+        if (!(b & 0x80))
+        {
+            *puValue = uValue;
+            return pb;
+        }
+        cShift += 7;
+    }
+    return NULL;
+}
+
+/** @} */
+
+RT_C_DECLS_END
+
+#endif
+
@@ -225,6 +225,20 @@ typedef struct PDMAUDIOVOLUME
     uint32_t               uRight;
 } PDMAUDIOVOLUME, *PPDMAUDIOVOLUME;
 
+/**
+ * One phase of the table driven linear interpolation rate converter, see
+ * PDMAUDIOSTRMRATE::paPhases.
+ */
+typedef struct PDMAUDIOSTRMRATEPHASE
+{
+    /** Weight of the next source sample (0.32 fixed point), the
+     *  last source sample gets the remainder. */
+    uint32_t       uWeight;
+    /** Number of source samples to advance by after
+     *  producing the output sample of this phase. */
+    uint32_t       cSrcAdvance;
+} PDMAUDIOSTRMRATEPHASE, *PPDMAUDIOSTRMRATEPHASE;
+
 /**
  * Structure for holding rate processing information
  * of a source + destination audio stream. This is needed
@@ -246,6 +260,17 @@ typedef struct PDMAUDIOSTRMRATE
     /** Last processed sample of the input stream.
      *  Needed for interpolation. */
     PDMAUDIOSAMPLE srcSampleLast;
+    /** Number of phases in paPhases; 0 if the rates don't have
+     *  a small enough common divisor and dstInc is used instead. */
+    uint32_t       cPhases;
+    /** The phase of the next output sample. */
+    uint32_t       iPhase;
+    /** Number of source samples to consume before the
+     *  next output sample can be produced. */
+    uint32_t       cSrcToSkip;
+    /** The phase table, cPhases entries. Allocated together
+     *  with this structure. */
+    PPDMAUDIOSTRMRATEPHASE paPhases;
 } PDMAUDIOSTRMRATE, *PPDMAUDIOSTRMRATE;
 
 /**
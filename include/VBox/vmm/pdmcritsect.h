@@ -44,7 +44,7 @@ RT_C_DECLS_BEGIN
 typedef union PDMCRITSECT
 {
     /** Padding. */
-    uint8_t padding[HC_ARCH_BITS == 32 ? 0x80 : 0xc0];
+    uint8_t padding[HC_ARCH_BITS == 32 ? 0x88 : 0xc0];
 #ifdef PDMCRITSECTINT_DECLARED
     /** The internal structure (not normally visible). */
     struct PDMCRITSECTINT s;
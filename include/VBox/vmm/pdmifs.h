@@ -504,6 +504,8 @@ typedef struct PDMIDISPLAYPORT
      * while doing so.
      *
      * @returns VBox status code.
+     * @retval  VINF_TRY_AGAIN if the VBVA updates are reported asynchronously;
+     *          PDMIDISPLAYCONNECTOR::pfnVBVAUpdateComplete is called when done.
      * @param   pInterface          Pointer to this interface.
      * @thread  The emulation thread.
      */
@@ -1012,9 +1014,18 @@ typedef struct PDMIDISPLAYCONNECTOR
      * @thread  The emulation thread.
      */
     DECLR3CALLBACKMEMBER(void, pfnVBVAInputMappingUpdate,(PPDMIDISPLAYCONNECTOR pInterface, int32_t xOrigin, int32_t yOrigin, uint32_t cx, uint32_t cy));
+
+    /**
+     * The display update sequence for which PDMIDISPLAYPORT::pfnUpdateDisplay
+     * returned VINF_TRY_AGAIN is complete, all its VBVA updates were reported.
+     *
+     * @param   pInterface  Pointer to this interface.
+     * @thread  The VBVA flush thread of the VGA device.
+     */
+    DECLR3CALLBACKMEMBER(void, pfnVBVAUpdateComplete,(PPDMIDISPLAYCONNECTOR pInterface));
 } PDMIDISPLAYCONNECTOR;
 /** PDMIDISPLAYCONNECTOR interface ID. */
-#define PDMIDISPLAYCONNECTOR_IID                "e883a720-85fb-11e4-a307-0b06689c9661"
+#define PDMIDISPLAYCONNECTOR_IID                "55b8050e-b746-40f7-829d-0846f4251bcb"
 
 
 /** Pointer to a block port interface. */
@@ -3065,9 +3076,22 @@ typedef struct PDMIHGCMCONNECTOR
     DECLR3CALLBACKMEMBER(int, pfnCall,(PPDMIHGCMCONNECTOR pInterface, PVBOXHGCMCMD pCmd, uint32_t u32ClientID, uint32_t u32Function,
                                        uint32_t cParms, PVBOXHGCMSVCPARM paParms));
 
+    /**
+     * Checks whether the service takes VBOX_HGCM_SVC_PARM_PAGES parameters for
+     * a function, i.e. whether mapping the guest pages of a page list saves
+     * copying them.
+     *
+     * @param   pInterface          Pointer to this interface.
+     * @param   u32ClientID         The client id returned by the pfnConnect call.
+     * @param   u32Function         Function to be performed by the service.
+     * @return  true if the page lists are passed to the service as they are.
+     * @thread  The emulation thread.
+     */
+    DECLR3CALLBACKMEMBER(bool, pfnIsPageListCall,(PPDMIHGCMCONNECTOR pInterface, uint32_t u32ClientID, uint32_t u32Function));
+
 } PDMIHGCMCONNECTOR;
 /** PDMIHGCMCONNECTOR interface ID. */
-# define PDMIHGCMCONNECTOR_IID                  "a1104758-c888-4437-8f2a-7bac17865b5c"
+# define PDMIHGCMCONNECTOR_IID                  "33cb1b2f-2d24-4d72-b0a1-46e1d55b4f02"
 
 #endif /* VBOX_WITH_HGCM */
 
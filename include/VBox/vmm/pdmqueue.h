@@ -38,6 +38,22 @@ RT_C_DECLS_BEGIN
 /** Pointer to a PDM queue. Also called PDM queue handle. */
 typedef struct PDMQUEUE *PPDMQUEUE;
 
+/** Special cMilliesInterval value for the queue creation APIs requesting a
+ * dedicated ring-3 consumer thread.
+ *
+ * Instead of going via the VM_FF_PDM_QUEUES forced action or a polling timer,
+ * the queue owns a worker thread which blocks on a support driver event
+ * semaphore.  Producers in ring-3 and ring-0 signal the semaphore directly,
+ * and only when the worker has announced that it is going to sleep, so a
+ * burst of inserts costs a single wakeup and the consumer drains the whole
+ * batch.  Raw-mode context inserts are forwarded by the EMT on the next
+ * return to ring-3.
+ *
+ * @remarks The consumer callback is called on the worker thread, not on an
+ *          EMT, and may be called while the VM is suspended.  It is the
+ *          caller's responsibility to do the necessary locking. */
+#define PDMQUEUE_INTERVAL_WORKER_THREAD     UINT32_MAX
+
 /** Pointer to a PDM queue item core. */
 typedef struct PDMQUEUEITEMCORE *PPDMQUEUEITEMCORE;
 
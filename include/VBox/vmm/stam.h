@@ -1213,6 +1213,85 @@ VMMR3DECL(int)  STAMR3Dump(PUVM pUVM, const char *pszPat);
 VMMR3DECL(int)  STAMR3DumpToReleaseLog(PUVM pUVM, const char *pszPat);
 VMMR3DECL(int)  STAMR3Print(PUVM pUVM, const char *pszPat);
 
+/**
+ * Binary snapshot header (STAMR3SnapshotBin).
+ *
+ * The header is followed by STAMBINSNAPSHOTHDR::cEntries variable sized
+ * STAMBINSNAPSHOTENTRY records, each 8 byte aligned.
+ */
+typedef struct STAMBINSNAPSHOTHDR
+{
+    /** Magic value (STAMBINSNAPSHOTHDR_MAGIC). */
+    uint32_t        u32Magic;
+    /** Format version (STAMBINSNAPSHOTHDR_VERSION). */
+    uint16_t        uVersion;
+    /** The STAM_SNAPSHOT_BIN_F_XXX flags the snapshot was taken with. */
+    uint16_t        fFlags;
+    /** The registration generation. This changes whenever samples are
+     * registered or deregistered, i.e. when the index to name mapping the
+     * consumer has cached may have to be refreshed. */
+    uint32_t        uGeneration;
+    /** Number of entries following the header. */
+    uint32_t        cEntries;
+    /** The RTTimeNanoTS() value when the snapshot was taken. */
+    uint64_t        u64NanoTS;
+} STAMBINSNAPSHOTHDR;
+/** Pointer to a binary snapshot header. */
+typedef STAMBINSNAPSHOTHDR *PSTAMBINSNAPSHOTHDR;
+/** Pointer to a const binary snapshot header. */
+typedef STAMBINSNAPSHOTHDR const *PCSTAMBINSNAPSHOTHDR;
+/** STAMBINSNAPSHOTHDR::u32Magic value ('STAM'). */
+#define STAMBINSNAPSHOTHDR_MAGIC    UINT32_C(0x4d415453)
+/** STAMBINSNAPSHOTHDR::uVersion value. */
+#define STAMBINSNAPSHOTHDR_VERSION  1
+
+/**
+ * Binary snapshot entry (STAMR3SnapshotBin).
+ *
+ * The entry is followed by cValues 64-bit values in the natural order of the
+ * sample type (e.g. cPeriods, cTicks, cTicksMax, cTicksMin for profiles) and,
+ * if names were requested, the zero terminated sample name.  The total size
+ * is padded to a multiple of 8 bytes.
+ */
+typedef struct STAMBINSNAPSHOTENTRY
+{
+    /** The stable sample index. */
+    uint32_t        iSample;
+    /** The sample type (STAMTYPE). */
+    uint8_t         enmType;
+    /** The sample unit (STAMUNIT). */
+    uint8_t         enmUnit;
+    /** Number of 64-bit values following the entry header. */
+    uint8_t         cValues;
+    /** The length of the name following the values, 0 if not present.
+     * Sample names are limited to 239 chars, so this always fits. */
+    uint8_t         cchName;
+} STAMBINSNAPSHOTENTRY;
+/** Pointer to a binary snapshot entry. */
+typedef STAMBINSNAPSHOTENTRY *PSTAMBINSNAPSHOTENTRY;
+/** Pointer to a const binary snapshot entry. */
+typedef STAMBINSNAPSHOTENTRY const *PCSTAMBINSNAPSHOTENTRY;
+
+/** @name STAM_SNAPSHOT_BIN_F_XXX - STAMR3SnapshotBin flags.
+ * @{ */
+/** Only include samples which changed since the previous binary snapshot
+ * taken with the same baseline.  Requires a baseline. */
+#define STAM_SNAPSHOT_BIN_F_DELTA   RT_BIT_32(0)
+/** Include the sample names. */
+#define STAM_SNAPSHOT_BIN_F_NAMES   RT_BIT_32(1)
+/** Mask of valid flags. */
+#define STAM_SNAPSHOT_BIN_F_VALID_MASK UINT32_C(0x00000003)
+/** @} */
+
+/** Binary snapshot delta baseline of a statistics consumer (opaque). */
+typedef struct STAMSNAPSHOTBINBASELINE *PSTAMSNAPSHOTBINBASELINE;
+
+VMMR3DECL(int)  STAMR3SnapshotBinBaselineCreate(PSTAMSNAPSHOTBINBASELINE *phBaseline);
+VMMR3DECL(void) STAMR3SnapshotBinBaselineDestroy(PSTAMSNAPSHOTBINBASELINE hBaseline);
+VMMR3DECL(int)  STAMR3SnapshotBin(PUVM pUVM, const char *pszPat, uint32_t fFlags, PSTAMSNAPSHOTBINBASELINE hBaseline,
+                                  void **ppvSnapshot, size_t *pcbSnapshot);
+VMMR3DECL(void) STAMR3SnapshotBinFree(PUVM pUVM, void *pvSnapshot);
+
 /**
  * Callback function for STAMR3Enum().
  *
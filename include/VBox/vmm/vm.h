@@ -161,7 +161,7 @@ typedef struct VMCPU
 #ifdef ___IEMInternal_h
         struct IEMCPU       s;
 #endif
-        uint8_t             padding[3072];      /* multiple of 64 */
+        uint8_t             padding[6272];      /* multiple of 64 */
     } iem;
 
     /** TRPM part. */
@@ -206,7 +206,7 @@ typedef struct VMCPU
 #ifdef ___IOMInternal_h
         struct IOMCPU       s;
 #endif
-        uint8_t             padding[512];       /* multiple of 64 */
+        uint8_t             padding[640];       /* multiple of 64 */
     } iom;
 
     /** DBGF part.
@@ -229,7 +229,7 @@ typedef struct VMCPU
     } gim;
 
     /** Align the following members on page boundary. */
-    uint8_t                 abAlignment2[3584];
+    uint8_t                 abAlignment2[256];
 
     /** PGM part. */
     union
@@ -1011,7 +1011,7 @@ typedef struct VM
 #ifdef ___PGMInternal_h
         struct PGM  s;
 #endif
-        uint8_t     padding[4096*2+6080];      /* multiple of 64 */
+        uint8_t     padding[4096*4+6080];      /* multiple of 64 */
     } pgm;
 
     /** HM part. */
@@ -627,7 +627,9 @@ static int vbsvcAutoMountSharedFolder(const char *pszShareName, const char *pszM
 
         mntinf.uid   = pOpts->uid;
         mntinf.gid   = pOpts->gid;
-        mntinf.ttl   = pOpts->ttl;
+        /* Modules without ttl_ms take ttl as it is, so only pass them the old default of 0. */
+        mntinf.ttl   = pOpts->ttl < 0 ? 0 : pOpts->ttl;
+        mntinf.ttl_ms = pOpts->ttl_ms;
         mntinf.dmode = pOpts->dmode;
         mntinf.fmode = pOpts->fmode;
         mntinf.dmask = pOpts->dmask;
@@ -896,7 +898,8 @@ static int vbsvcAutoMountProcessMappings(PCVBGLR3SHAREDFOLDERMAPPING paMappings,
                         {
                             0,                     /* uid */
                             (int)grp_vboxsf->gr_gid, /* gid */
-                            0,                     /* ttl */
+                            -1,                    /* ttl */
+                            VBSF_DEFAULT_TTL_MS,   /* ttl_ms */
                             0770,                  /* dmode, owner and group "vboxsf" have full access */
                             0770,                  /* fmode, owner and group "vboxsf" have full access */
                             0,                     /* dmask */
@@ -18,6 +18,73 @@
 
 #include "vfsmod.h"
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 11, 0)
+/**
+ * A listing carries the same attributes as a stat of every entry. Refresh
+ * the children of [dentry] already in the dcache with them, so the stat
+ * calls usually following a listing (ls -l, make, find) don't have to go
+ * to the host again until the ttl expires.
+ *
+ * @param sf_g      global info
+ * @param dentry    the directory
+ * @param sf_d      the listing
+ */
+static void sf_dir_prime_children(struct sf_glob_info *sf_g, struct dentry *dentry,
+                                  struct sf_dir_info *sf_d)
+{
+    struct list_head *pos;
+    char *name;
+
+    if (!sf_g->ttl)
+        return;
+
+    name = kmalloc(NAME_MAX + 1, GFP_KERNEL);
+    if (!name)
+        return;
+
+    list_for_each(pos, &sf_d->info_list)
+    {
+        struct sf_dir_buf *b = list_entry(pos, struct sf_dir_buf, head);
+        SHFLDIRINFO *info = b->buf;
+        size_t i;
+
+        for (i = 0; i < b->cEntries; ++i)
+        {
+            struct dentry *child;
+            struct qstr qname;
+
+            if (!sf_nlscpy(sf_g, name, NAME_MAX,
+                           info->name.String.utf8, info->name.u16Length))
+            {
+                qname.name = name;
+                qname.len  = strlen(name);
+                child = d_hash_and_lookup(dentry, &qname);
+                if (!IS_ERR_OR_NULL(child))
+                {
+                    /* A changed type is left to the normal revalidation. */
+                    if (   child->d_inode
+                        && !S_ISDIR(child->d_inode->i_mode) == !RTFS_IS_DIRECTORY(info->Info.Attr.fMode))
+                    {
+                        struct sf_inode_info *sf_i = GET_INODE_INFO(child->d_inode);
+
+                        sf_init_inode(sf_g, child->d_inode, &info->Info);
+                        child->d_time = jiffies;
+                        if (sf_i)
+                            sf_i->force_restat = 0;
+                    }
+                    dput(child);
+                }
+            }
+
+            info = (SHFLDIRINFO *)((uintptr_t)info + offsetof(SHFLDIRINFO, name.String)
+                                                   + info->name.u16Size);
+        }
+    }
+
+    kfree(name);
+}
+#endif
+
 /**
  * Open a directory. Read the complete content into a buffer.
  *
@@ -71,7 +138,12 @@ static int sf_dir_open(struct inode *inode, struct file *file)
         {
             err = sf_dir_read_all(sf_g, sf_i, sf_d, params.Handle);
             if (!err)
+            {
                 file->private_data = sf_d;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 11, 0)
+                sf_dir_prime_children(sf_g, file->f_path.dentry, sf_d);
+#endif
+            }
         }
         else
             err = -ENOENT;
@@ -101,6 +101,7 @@ process_mount_opts(const char *s, struct vbsf_mount_opts *opts)
         HOUID,
         HOGID,
         HOTTL,
+        HOTTLMS,
         HODMODE,
         HOFMODE,
         HOUMASK,
@@ -130,7 +131,8 @@ process_mount_opts(const char *s, struct vbsf_mount_opts *opts)
         {"ro",        HORO,        0, "mount read only"},
         {"uid",       HOUID,       1, "default file owner user id"},
         {"gid",       HOGID,       1, "default file owner group id"},
-        {"ttl",       HOTTL,       1, "time to live for dentry"},
+        {"ttl",       HOTTL,       1, "time to live for dentries and attributes in jiffies"},
+        {"ttl_ms",    HOTTLMS,     1, "time to live for dentries and attributes in ms"},
         {"iocharset", HOIOCHARSET, 1, "i/o charset (default utf8)"},
         {"convertcp", HOCONVERTCP, 1, "convert share name from given charset to utf8"},
         {"dmode",     HODMODE,     1, "mode of all directories"},
@@ -241,6 +243,9 @@ process_mount_opts(const char *s, struct vbsf_mount_opts *opts)
                 case HOTTL:
                     opts->ttl = safe_atoi(val, val_len, 10);
                     break;
+                case HOTTLMS:
+                    opts->ttl_ms = safe_atoi(val, val_len, 10);
+                    break;
                 case HODMODE:
                     opts->dmode = safe_atoi(val, val_len, 8);
                     break;
@@ -350,7 +355,10 @@ static int usage(char *argv0)
            "     ro                 mount read only\n"
            "     uid=UID            set the default file owner user id to UID\n"
            "     gid=GID            set the default file owner group id to GID\n"
-           "     ttl=TTL            set the \"time to live\" to TID for the dentry\n");
+           "     ttl=TTL            set the \"time to live\" for dentries and attributes\n"
+           "                        to TTL jiffies\n"
+           "     ttl_ms=TTL         same in milliseconds, overrides ttl (default 200,\n"
+           "                        0 disables caching)\n");
     printf("     dmode=MODE         override the mode of all directories to (octal) MODE\n"
            "     fmode=MODE         override the mode of all regular files to (octal) MODE\n"
            "     umask=UMASK        set the umask to (octal) UMASK\n");
@@ -379,7 +387,8 @@ main(int argc, char **argv)
     {
         0,     /* uid */
         0,     /* gid */
-        0,     /* ttl */
+       -1,     /* ttl */
+       -1,     /* ttl_ms */
        ~0U,    /* dmode */
        ~0U,    /* fmode*/
         0,     /* dmask */
@@ -471,7 +480,11 @@ main(int argc, char **argv)
 
     mntinf.uid   = opts.uid;
     mntinf.gid   = opts.gid;
-    mntinf.ttl   = opts.ttl;
+    /* Modules without ttl_ms take ttl as it is, so only pass them the old
+     * default of 0.  Newer ones get the default in ttl_ms unless ttl was
+     * given. */
+    mntinf.ttl    = opts.ttl < 0 ? 0 : opts.ttl;
+    mntinf.ttl_ms = opts.ttl_ms >= 0 || opts.ttl >= 0 ? opts.ttl_ms : VBSF_DEFAULT_TTL_MS;
     mntinf.dmode = opts.dmode;
     mntinf.fmode = opts.fmode;
     mntinf.dmask = opts.dmask;
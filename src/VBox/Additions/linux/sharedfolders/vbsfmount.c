@@ -47,8 +47,13 @@ int vbsfmount_complete(const char *host_name, const char *mount_point,
         fprintf(m, "uid=%d,", opts->uid);
     if (opts->gid)
         fprintf(m, "gid=%d,", opts->gid);
-    if (opts->ttl)
+    /* Leave out the defaults; ttl_ms overrides ttl, so the default ttl_ms
+     * only matters when ttl was given as well. */
+    if (opts->ttl >= 0)
         fprintf(m, "ttl=%d,", opts->ttl);
+    if (   opts->ttl_ms >= 0
+        && (opts->ttl_ms != VBSF_DEFAULT_TTL_MS || opts->ttl >= 0))
+        fprintf(m, "ttl_ms=%d,", opts->ttl_ms);
     if (*opts->nls_name)
         fprintf(m, "iocharset=%s,", opts->nls_name);
     if (flags & MS_NOSUID)
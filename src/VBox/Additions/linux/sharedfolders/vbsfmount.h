@@ -20,6 +20,10 @@
 #define MAX_HOST_NAME  256
 #define MAX_NLS_NAME    32
 
+/* how long (in milliseconds) attributes and dentries are trusted without
+   asking the host, unless the ttl or ttl_ms mount option says otherwise */
+#define VBSF_DEFAULT_TTL_MS 200
+
 /* Linux constraints the size of data mount argument to PAGE_SIZE - 1. */
 struct vbsf_mount_info_old
 {
@@ -45,11 +49,13 @@ struct vbsf_mount_info_new
     char nls_name[MAX_NLS_NAME];/* name of an I/O charset */
     int  uid;                   /* user ID for all entries, default 0=root */
     int  gid;                   /* group ID for all entries, default 0=root */
-    int  ttl;                   /* time to live */
+    int  ttl;                   /* time to live in jiffies, <0 for the default */
     int  dmode;                 /* mode for directories if != 0xffffffff */
     int  fmode;                 /* mode for regular files if != 0xffffffff */
     int  dmask;                 /* umask applied to directories */
     int  fmask;                 /* umask applied to regular files */
+    int  ttl_ms;                /* time to live in milliseconds, overrides ttl
+                                   if >= 0 */
 };
 
 struct vbsf_mount_opts
@@ -57,6 +63,7 @@ struct vbsf_mount_opts
     int  uid;
     int  gid;
     int  ttl;
+    int  ttl_ms;
     int  dmode;
     int  fmode;
     int  dmask;
@@ -43,6 +43,23 @@ VBGLSFCLIENT client_handle;
 /* forward declarations */
 static struct super_operations sf_super_ops;
 
+static int sf_ms_to_jiffies(int ms)
+{
+    return (ms / 1000) * HZ + ((ms % 1000) * HZ + 999) / 1000;
+}
+
+/* the ttl mount option is in jiffies, the ttl_ms option of newer mount
+   helpers in milliseconds; negative values select the default */
+static int sf_ttl_to_jiffies(struct vbsf_mount_info_new *info)
+{
+    if (   (unsigned)info->length >= sizeof(struct vbsf_mount_info_new)
+        && info->ttl_ms >= 0)
+        return sf_ms_to_jiffies(info->ttl_ms);
+    if (info->ttl >= 0)
+        return info->ttl;
+    return sf_ms_to_jiffies(VBSF_DEFAULT_TTL_MS);
+}
+
 /* allocate global info, try to map host share */
 static int sf_glob_alloc(struct vbsf_mount_info_new *info, struct sf_glob_info **sf_gp)
 {
@@ -154,11 +171,11 @@ static int sf_glob_alloc(struct vbsf_mount_info_new *info, struct sf_glob_info *
         goto fail2;
     }
 
-    sf_g->ttl = info->ttl;
+    sf_g->ttl = sf_ttl_to_jiffies(info);
     sf_g->uid = info->uid;
     sf_g->gid = info->gid;
 
-    if ((unsigned)info->length >= sizeof(struct vbsf_mount_info_new))
+    if ((unsigned)info->length >= offsetof(struct vbsf_mount_info_new, ttl_ms))
     {
         /* new fields */
         sf_g->dmode = info->dmode;
@@ -472,7 +489,7 @@ static int sf_remount_fs(struct super_block *sb, int *flags, char *data)
         {
             sf_g->uid = info->uid;
             sf_g->gid = info->gid;
-            sf_g->ttl = info->ttl;
+            sf_g->ttl = sf_ttl_to_jiffies(info);
             sf_g->dmode = info->dmode;
             sf_g->fmode = info->fmode;
             sf_g->dmask = info->dmask;
@@ -37,7 +37,7 @@ struct sf_glob_info
 {
     VBGLSFMAP map;
     struct nls_table *nls;
-    int ttl;
+    int ttl;                    /* in jiffies */
     int uid;
     int gid;
     int dmode;
@@ -271,7 +271,7 @@ const DBGCCMD    g_aDbgcCmds[] =
     { "unload",     1,       ~0U,       &g_aArgUnload[0],    RT_ELEMENTS(g_aArgUnload),    0, dbgcCmdUnload,    "<modname1> [modname2..N]", "Unloads one or more modules in the current address space." },
     { "unloadplugin", 1,     ~0U,       &g_aArgPlugIn[0],    RT_ELEMENTS(g_aArgPlugIn),    0, dbgcCmdUnloadPlugIn, "<plugin1> [plugin2..N]", "Unloads one or more plugins." },
     { "unset",      1,       ~0U,       &g_aArgUnset[0],     RT_ELEMENTS(g_aArgUnset),     0, dbgcCmdUnset,     "<var1> [var1..[varN]]",  "Unsets (delete) one or more global variables." },
-    { "writecore",  1,        1,        &g_aArgWriteCore[0], RT_ELEMENTS(g_aArgWriteCore), 0, dbgcCmdWriteCore,   "<filename>",           "Write core to file." },
+    { "writecore",  1,        1,        &g_aArgWriteCore[0], RT_ELEMENTS(g_aArgWriteCore), 0, dbgcCmdWriteCore,   "<filename>",           "Write core to file, gzip compressed if the name ends with .gz." },
 };
 /** The number of native commands. */
 const uint32_t      g_cDbgcCmds = RT_ELEMENTS(g_aDbgcCmds);
@@ -1835,7 +1835,13 @@ static DECLCALLBACK(int) dbgcCmdWriteCore(PCDBGCCMD pCmd, PDBGCCMDHLP pCmdHlp, P
     if (!pszDumpPath)
         return DBGCCmdHlpFail(pCmdHlp, pCmd, "Missing file path.\n");
 
-    int rc = DBGFR3CoreWrite(pUVM, pszDumpPath, true /*fReplaceFile*/);
+    /* Compress it if the name says so. */
+    uint32_t fFlags = DBGFCORE_F_REPLACE_FILE | DBGFCORE_F_SKIP_ZERO_PAGES;
+    size_t const cchDumpPath = strlen(pszDumpPath);
+    if (cchDumpPath > 3 && !RTStrICmp(&pszDumpPath[cchDumpPath - 3], ".gz"))
+        fFlags |= DBGFCORE_F_GZIP;
+
+    int rc = DBGFR3CoreWriteEx(pUVM, pszDumpPath, fFlags);
     if (RT_FAILURE(rc))
         return DBGCCmdHlpFail(pCmdHlp, pCmd, "DBGFR3WriteCore failed. rc=%Rrc\n", rc);
 
@@ -320,6 +320,10 @@ VMMR3DECL(int) DBGFR3CoreWrite(PUVM pUVM, const char *pszFilename, bool fReplace
 {
     return VERR_INTERNAL_ERROR;
 }
+VMMR3DECL(int) DBGFR3CoreWriteEx(PUVM pUVM, const char *pszFilename, uint32_t fFlags)
+{
+    return VERR_INTERNAL_ERROR;
+}
 
 VMMR3DECL(int)  DBGFR3PlugInLoad(PUVM pUVM, const char *pszPlugIn, char *pszActual, size_t cbActual, PRTERRINFO pErrInfo)
 {
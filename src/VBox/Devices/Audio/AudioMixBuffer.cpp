@@ -35,6 +35,9 @@
 #endif
 #include <iprt/mem.h>
 #include <iprt/string.h> /* For RT_BZERO. */
+#ifdef RT_ARCH_AMD64
+# include <emmintrin.h>
+#endif
 
 #ifdef TESTCASE
 # define LOG_ENABLED
@@ -124,6 +127,11 @@ static uint32_t s_aVolumeConv[256] = {
 AssertCompile(AUDIOMIXBUF_VOL_0DB <= 0x40000000);   /* Must always hold. */
 AssertCompile(AUDIOMIXBUF_VOL_0DB == 0x40000000);   /* For now -- when only attenuation is used. */
 
+/** Maximum number of phases for the table driven linear interpolation. Rate
+ *  pairs needing more (that is, with a small greatest common divisor) fall
+ *  back to stepping with PDMAUDIOSTRMRATE::dstInc. */
+#define AUDMIXBUF_RATE_MAX_PHASES   4096
+
 /**
  * Structure for holding sample conversion parameters for
  * the audioMixBufConvFromXXX / audioMixBufConvToXXX macros.
@@ -149,6 +157,16 @@ typedef struct AUDMIXBUF_CONVOPTS
 # define AUDMIXBUF_MACRO_FN static inline
 #endif
 
+#ifdef RT_ARCH_AMD64
+# ifdef TESTCASE
+/** Set by the testcases to check the SSE2 code against the generic one. */
+bool g_fAudioMixBufNoSSE2 = false;
+#  define AUDMIXBUF_USE_SSE2()  (!g_fAudioMixBufNoSSE2)
+# else
+#  define AUDMIXBUF_USE_SSE2()  true
+# endif
+#endif
+
 #ifdef DEBUG
 static uint64_t s_cSamplesMixedTotal = 0;
 static inline void audioMixBufPrint(PPDMAUDIOMIXBUF pMixBuf);
@@ -529,6 +547,163 @@ AUDMIXBUF_CONVERT(U32 /* Name */, uint32_t, 0         /* Min */, UINT32_MAX /* M
 
 #undef AUDMIXBUF_CONVERT
 
+#ifdef RT_ARCH_AMD64
+/*
+ * SSE2 variants of the 16-bit signed conversions, the format used by pretty
+ * much all guests and backends. These produce exactly the same results as
+ * the macro-generated routines above, which also handle the tails.
+ */
+
+/**
+ * Applies the volume to two pairs of biased (unsigned) 16-bit samples, given
+ * as four dwords, and stores the resulting two sample pairs.
+ *
+ * The sample is s << 16 and the volume is applied as (s << 16) * vol >> 30,
+ * i.e. floor(s * vol / 2^14). With u = s + 0x8000 this is
+ * floor(u * vol / 2^14) - 2 * vol, which only needs the unsigned 32x32
+ * multiplication SSE2 has.
+ */
+DECLINLINE(void) audioMixBufConvFromS16PairsSSE2(PPDMAUDIOSAMPLE paDst, __m128i uSrc, __m128i uVol, __m128i uBias)
+{
+    __m128i const uZero = _mm_setzero_si128();
+    _mm_storeu_si128((__m128i *)&paDst[0],
+                     _mm_sub_epi64(_mm_srli_epi64(_mm_mul_epu32(_mm_unpacklo_epi32(uSrc, uZero), uVol), 14), uBias));
+    _mm_storeu_si128((__m128i *)&paDst[1],
+                     _mm_sub_epi64(_mm_srli_epi64(_mm_mul_epu32(_mm_unpackhi_epi32(uSrc, uZero), uVol), 14), uBias));
+}
+
+AUDMIXBUF_MACRO_FN uint32_t audioMixBufConvFromS16StereoSSE2(PPDMAUDIOSAMPLE paDst, const void *pvSrc, uint32_t cbSrc,
+                                                             const PAUDMIXBUF_CONVOPTS pOpts)
+{
+    uint32_t cSamples = (uint32_t)RT_MIN(pOpts->cSamples, cbSrc / sizeof(int16_t));
+    if (   pOpts->Volume.uLeft  > AUDIOMIXBUF_VOL_0DB
+        || pOpts->Volume.uRight > AUDIOMIXBUF_VOL_0DB)
+        return audioMixBufConvFromS16Stereo(paDst, pvSrc, cbSrc, pOpts);
+
+    const int16_t *pSrc  = (const int16_t *)pvSrc;
+    __m128i const  uVol  = _mm_set_epi32(0, (int)pOpts->Volume.uRight, 0, (int)pOpts->Volume.uLeft);
+    __m128i const  uBias = _mm_set_epi64x((int64_t)pOpts->Volume.uRight * 2, (int64_t)pOpts->Volume.uLeft * 2);
+    __m128i const  uSign = _mm_set1_epi16(-0x8000);
+    __m128i const  uZero = _mm_setzero_si128();
+
+    uint32_t i = 0;
+    for (; i + 4 <= cSamples; i += 4)
+    {
+        __m128i uSrc = _mm_xor_si128(_mm_loadu_si128((const __m128i *)&pSrc[i * 2]), uSign);
+        audioMixBufConvFromS16PairsSSE2(&paDst[i],     _mm_unpacklo_epi16(uSrc, uZero), uVol, uBias);
+        audioMixBufConvFromS16PairsSSE2(&paDst[i + 2], _mm_unpackhi_epi16(uSrc, uZero), uVol, uBias);
+    }
+
+    if (i < cSamples)
+    {
+        AUDMIXBUF_CONVOPTS convOpts = { cSamples - i, pOpts->Volume };
+        audioMixBufConvFromS16Stereo(&paDst[i], &pSrc[i * 2], (cSamples - i) * 2 * sizeof(int16_t), &convOpts);
+    }
+
+    return cSamples;
+}
+
+AUDMIXBUF_MACRO_FN uint32_t audioMixBufConvFromS16MonoSSE2(PPDMAUDIOSAMPLE paDst, const void *pvSrc, uint32_t cbSrc,
+                                                           const PAUDMIXBUF_CONVOPTS pOpts)
+{
+    uint32_t cSamples = (uint32_t)RT_MIN(pOpts->cSamples, cbSrc / sizeof(int16_t));
+    if (   pOpts->Volume.uLeft  > AUDIOMIXBUF_VOL_0DB
+        || pOpts->Volume.uRight > AUDIOMIXBUF_VOL_0DB)
+        return audioMixBufConvFromS16Mono(paDst, pvSrc, cbSrc, pOpts);
+
+    const int16_t *pSrc  = (const int16_t *)pvSrc;
+    __m128i const  uVol  = _mm_set_epi32(0, (int)pOpts->Volume.uRight, 0, (int)pOpts->Volume.uLeft);
+    __m128i const  uBias = _mm_set_epi64x((int64_t)pOpts->Volume.uRight * 2, (int64_t)pOpts->Volume.uLeft * 2);
+    __m128i const  uSign = _mm_set1_epi16(-0x8000);
+    __m128i const  uZero = _mm_setzero_si128();
+
+    uint32_t i = 0;
+    for (; i + 4 <= cSamples; i += 4)
+    {
+        __m128i uSrc = _mm_xor_si128(_mm_loadl_epi64((const __m128i *)&pSrc[i]), uSign);
+        uSrc = _mm_unpacklo_epi16(uSrc, uSrc); /* Duplicate into left + right. */
+        audioMixBufConvFromS16PairsSSE2(&paDst[i],     _mm_unpacklo_epi16(uSrc, uZero), uVol, uBias);
+        audioMixBufConvFromS16PairsSSE2(&paDst[i + 2], _mm_unpackhi_epi16(uSrc, uZero), uVol, uBias);
+    }
+
+    if (i < cSamples)
+    {
+        AUDMIXBUF_CONVOPTS convOpts = { cSamples - i, pOpts->Volume };
+        audioMixBufConvFromS16Mono(&paDst[i], &pSrc[i], (cSamples - i) * sizeof(int16_t), &convOpts);
+    }
+
+    return cSamples;
+}
+
+/**
+ * Clips two sample pairs to 16-bit signed values, returned as four dwords.
+ *
+ * A sample which fits into 32 bits (the high dword equals the sign of the
+ * low one) simply is shifted down, anything else saturates according to
+ * the sign of the high dword.
+ */
+DECLINLINE(__m128i) audioMixBufClipToS16PairsSSE2(const PDMAUDIOSAMPLE *paSrc)
+{
+    __m128i const uA    = _mm_loadu_si128((const __m128i *)&paSrc[0]);
+    __m128i const uB    = _mm_loadu_si128((const __m128i *)&paSrc[1]);
+    __m128i const uLo   = _mm_unpacklo_epi64(_mm_shuffle_epi32(uA, _MM_SHUFFLE(2, 0, 2, 0)),
+                                             _mm_shuffle_epi32(uB, _MM_SHUFFLE(2, 0, 2, 0)));
+    __m128i const uHi   = _mm_unpacklo_epi64(_mm_shuffle_epi32(uA, _MM_SHUFFLE(3, 1, 3, 1)),
+                                             _mm_shuffle_epi32(uB, _MM_SHUFFLE(3, 1, 3, 1)));
+    __m128i const uFits = _mm_cmpeq_epi32(uHi, _mm_srai_epi32(uLo, 31));
+    __m128i const uSat  = _mm_xor_si128(_mm_srai_epi32(uHi, 31), _mm_set1_epi32(0x7fff));
+    return _mm_or_si128(_mm_and_si128(uFits, _mm_srai_epi32(uLo, 16)), _mm_andnot_si128(uFits, uSat));
+}
+
+AUDMIXBUF_MACRO_FN void audioMixBufConvToS16StereoSSE2(void *pvDst, const PPDMAUDIOSAMPLE paSrc,
+                                                       const PAUDMIXBUF_CONVOPTS pOpts)
+{
+    int16_t *pDst     = (int16_t *)pvDst;
+    uint32_t cSamples = pOpts->cSamples;
+
+    uint32_t i = 0;
+    for (; i + 4 <= cSamples; i += 4)
+        _mm_storeu_si128((__m128i *)&pDst[i * 2], _mm_packs_epi32(audioMixBufClipToS16PairsSSE2(&paSrc[i]),
+                                                                  audioMixBufClipToS16PairsSSE2(&paSrc[i + 2])));
+
+    if (i < cSamples)
+    {
+        AUDMIXBUF_CONVOPTS convOpts = { cSamples - i, pOpts->Volume };
+        audioMixBufConvToS16Stereo(&pDst[i * 2], &paSrc[i], &convOpts);
+    }
+}
+#endif /* RT_ARCH_AMD64 */
+
+/**
+ * Assigns samples without rate conversion.
+ */
+DECLINLINE(void) audioMixBufAssign1To1(PPDMAUDIOSAMPLE paDst, PPDMAUDIOSAMPLE paSrc, uint32_t cSamples)
+{
+    memcpy(paDst, paSrc, cSamples * sizeof(PDMAUDIOSAMPLE));
+}
+
+/**
+ * Blends samples without rate conversion.
+ */
+DECLINLINE(void) audioMixBufBlend1To1(PPDMAUDIOSAMPLE paDst, PPDMAUDIOSAMPLE paSrc, uint32_t cSamples)
+{
+#ifdef RT_ARCH_AMD64
+    if (AUDMIXBUF_USE_SSE2())
+    {
+        /* One 128-bit add per left + right sample pair. */
+        for (uint32_t i = 0; i < cSamples; i++)
+            _mm_storeu_si128((__m128i *)&paDst[i], _mm_add_epi64(_mm_loadu_si128((const __m128i *)&paDst[i]),
+                                                                 _mm_loadu_si128((const __m128i *)&paSrc[i])));
+        return;
+    }
+#endif
+    for (uint32_t i = 0; i < cSamples; i++)
+    {
+        paDst[i].i64LSample += paSrc[i].i64LSample;
+        paDst[i].i64RSample += paSrc[i].i64RSample;
+    }
+}
+
 #define AUDMIXBUF_MIXOP(_aName, _aOp) \
     AUDMIXBUF_MACRO_FN void audioMixBufOp##_aName(PPDMAUDIOSAMPLE paDst, uint32_t cDstSamples, \
                                                   PPDMAUDIOSAMPLE paSrc, uint32_t cSrcSamples, \
@@ -545,11 +720,7 @@ AUDMIXBUF_CONVERT(U32 /* Name */, uint32_t, 0         /* Min */, UINT32_MAX /* M
         { \
             uint32_t cSamples = RT_MIN(cSrcSamples, cDstSamples); \
             AUDMIXBUF_MACRO_LOG(("cSamples=%RU32\n", cSamples)); \
-            for (uint32_t i = 0; i < cSamples; i++) \
-            { \
-                paDst[i].i64LSample _aOp paSrc[i].i64LSample; \
-                paDst[i].i64RSample _aOp paSrc[i].i64RSample; \
-            } \
+            audioMixBuf##_aName##1To1(paDst, paSrc, cSamples); \
             \
             if (pcDstWritten) \
                 *pcDstWritten = cSamples; \
@@ -558,6 +729,68 @@ AUDMIXBUF_CONVERT(U32 /* Name */, uint32_t, 0         /* Min */, UINT32_MAX /* M
             return; \
         } \
         \
+        if (pRate->cPhases) /* Linear interpolation driven by the phase table? */ \
+        { \
+            PPDMAUDIOSAMPLE paSrcStart = paSrc; \
+            PPDMAUDIOSAMPLE paSrcEnd   = paSrc + cSrcSamples; \
+            PPDMAUDIOSAMPLE paDstStart = paDst; \
+            PPDMAUDIOSAMPLE paDstEnd   = paDst + cDstSamples; \
+            PDMAUDIOSAMPLE  samLast    = pRate->srcSampleLast; \
+            uint32_t        cSrcToSkip = pRate->cSrcToSkip; \
+            uint32_t        iPhase     = pRate->iPhase; \
+            \
+            while (paDst < paDstEnd) \
+            { \
+                /* Of the skipped source samples only the last one is needed. */ \
+                if (cSrcToSkip) \
+                { \
+                    uint32_t cSrcAvail = (uint32_t)(paSrcEnd - paSrc); \
+                    if (cSrcToSkip > cSrcAvail) \
+                    { \
+                        if (cSrcAvail) \
+                            samLast = paSrcEnd[-1]; \
+                        cSrcToSkip -= cSrcAvail; \
+                        paSrc       = paSrcEnd; \
+                        break; \
+                    } \
+                    paSrc     += cSrcToSkip; \
+                    samLast    = paSrc[-1]; \
+                    cSrcToSkip = 0; \
+                } \
+                \
+                /* The next source sample is required for interpolating, even if its weight is zero. */ \
+                if (paSrc == paSrcEnd) \
+                    break; \
+                \
+                int64_t const iWeight = pRate->paPhases[iPhase].uWeight; \
+                if (iWeight) \
+                { \
+                    paDst->i64LSample _aOp (samLast.i64LSample * ((int64_t) (INT64_C(1) << 32) - iWeight) + paSrc->i64LSample * iWeight) >> 32; \
+                    paDst->i64RSample _aOp (samLast.i64RSample * ((int64_t) (INT64_C(1) << 32) - iWeight) + paSrc->i64RSample * iWeight) >> 32; \
+                } \
+                else \
+                { \
+                    paDst->i64LSample _aOp samLast.i64LSample; \
+                    paDst->i64RSample _aOp samLast.i64RSample; \
+                } \
+                paDst++; \
+                \
+                cSrcToSkip = pRate->paPhases[iPhase].cSrcAdvance; \
+                if (++iPhase == pRate->cPhases) \
+                    iPhase = 0; \
+            } \
+            \
+            pRate->srcSampleLast = samLast; \
+            pRate->cSrcToSkip    = cSrcToSkip; \
+            pRate->iPhase        = iPhase; \
+            \
+            if (pcDstWritten) \
+                *pcDstWritten = paDst - paDstStart; \
+            if (pcSrcRead) \
+                *pcSrcRead = paSrc - paSrcStart; \
+            return; \
+        } \
+        \
         PPDMAUDIOSAMPLE paSrcStart = paSrc; \
         PPDMAUDIOSAMPLE paSrcEnd   = paSrc + cSrcSamples; \
         PPDMAUDIOSAMPLE paDstStart = paDst; \
@@ -668,7 +901,11 @@ static inline PAUDMIXBUF_FN_CONVFROM audioMixBufConvFromLookup(PDMAUDIOMIXBUFFMT
             switch (AUDMIXBUF_FMT_BITS_PER_SAMPLE(enmFmt))
             {
                 case 8:  return audioMixBufConvFromS8Stereo;
+#ifdef RT_ARCH_AMD64
+                case 16: return AUDMIXBUF_USE_SSE2() ? audioMixBufConvFromS16StereoSSE2 : audioMixBufConvFromS16Stereo;
+#else
                 case 16: return audioMixBufConvFromS16Stereo;
+#endif
                 case 32: return audioMixBufConvFromS32Stereo;
                 default: return NULL;
             }
@@ -678,7 +915,11 @@ static inline PAUDMIXBUF_FN_CONVFROM audioMixBufConvFromLookup(PDMAUDIOMIXBUFFMT
             switch (AUDMIXBUF_FMT_BITS_PER_SAMPLE(enmFmt))
             {
                 case 8:  return audioMixBufConvFromS8Mono;
+#ifdef RT_ARCH_AMD64
+                case 16: return AUDMIXBUF_USE_SSE2() ? audioMixBufConvFromS16MonoSSE2 : audioMixBufConvFromS16Mono;
+#else
                 case 16: return audioMixBufConvFromS16Mono;
+#endif
                 case 32: return audioMixBufConvFromS32Mono;
                 default: return NULL;
             }
@@ -729,7 +970,11 @@ static inline PAUDMIXBUF_FN_CONVTO audioMixBufConvToLookup(PDMAUDIOMIXBUFFMT enm
             switch (AUDMIXBUF_FMT_BITS_PER_SAMPLE(enmFmt))
             {
                 case 8:  return audioMixBufConvToS8Stereo;
+#ifdef RT_ARCH_AMD64
+                case 16: return AUDMIXBUF_USE_SSE2() ? audioMixBufConvToS16StereoSSE2 : audioMixBufConvToS16Stereo;
+#else
                 case 16: return audioMixBufConvToS16Stereo;
+#endif
                 case 32: return audioMixBufConvToS32Stereo;
                 default: return NULL;
             }
@@ -922,18 +1167,51 @@ int AudioMixBufLinkTo(PPDMAUDIOMIXBUF pMixBuf, PPDMAUDIOMIXBUF pParent)
 
     if (RT_SUCCESS(rc))
     {
-        if (!pMixBuf->pRate)
+        /*
+         * Work out the phase table for the linear interpolation: with
+         * the rates reduced by their greatest common divisor, every cPhases
+         * output samples consume exactly uSrcStep source samples, so the
+         * interpolation weights and source steps repeat with that period.
+         */
+        uint32_t const uSrcHz   = AUDMIXBUF_FMT_SAMPLE_FREQ(pMixBuf->AudioFmt);
+        uint32_t const uDstHz   = AUDMIXBUF_FMT_SAMPLE_FREQ(pParent->AudioFmt);
+        uint32_t       uGcd     = uSrcHz;
+        for (uint32_t uRem = uDstHz; uRem; )
         {
-            /* Create rate conversion. */
-            pMixBuf->pRate = (PPDMAUDIOSTRMRATE)RTMemAllocZ(sizeof(PDMAUDIOSTRMRATE));
-            if (!pMixBuf->pRate)
-                return VERR_NO_MEMORY;
+            uint32_t uTmp = uGcd % uRem;
+            uGcd = uRem;
+            uRem = uTmp;
         }
-        else
-            RT_BZERO(pMixBuf->pRate, sizeof(PDMAUDIOSTRMRATE));
+        uint32_t const uSrcStep = uSrcHz / uGcd;
+        uint32_t       cPhases  = uDstHz / uGcd;
+        if (cPhases > AUDMIXBUF_RATE_MAX_PHASES)
+            cPhases = 0;
+
+        /* (Re-)create rate conversion, the phase table lives right behind it. */
+        if (pMixBuf->pRate)
+            RTMemFree(pMixBuf->pRate);
+        pMixBuf->pRate = (PPDMAUDIOSTRMRATE)RTMemAllocZ(sizeof(PDMAUDIOSTRMRATE) + cPhases * sizeof(PDMAUDIOSTRMRATEPHASE));
+        if (!pMixBuf->pRate)
+            return VERR_NO_MEMORY;
+
+        pMixBuf->pRate->dstInc = ((uint64_t)uSrcHz << 32) / uDstHz;
 
-        pMixBuf->pRate->dstInc = ((uint64_t)AUDMIXBUF_FMT_SAMPLE_FREQ(pMixBuf->AudioFmt) << 32)
-                               /            AUDMIXBUF_FMT_SAMPLE_FREQ(pParent->AudioFmt);
+        if (cPhases)
+        {
+            PPDMAUDIOSTRMRATEPHASE paPhases = (PPDMAUDIOSTRMRATEPHASE)(pMixBuf->pRate + 1);
+            uint32_t               uFrac    = 0; /* In 1/cPhases source samples. */
+            for (uint32_t i = 0; i < cPhases; i++)
+            {
+                paPhases[i].uWeight     = (uint32_t)(((uint64_t)uFrac << 32) / cPhases);
+                uFrac                  += uSrcStep;
+                paPhases[i].cSrcAdvance = uFrac / cPhases;
+                uFrac                  %= cPhases;
+            }
+
+            pMixBuf->pRate->cPhases    = cPhases;
+            pMixBuf->pRate->paPhases   = paPhases;
+            pMixBuf->pRate->cSrcToSkip = 1; /* The first source sample. */
+        }
 
         AUDMIXBUF_LOG(("uThisHz=%RU32, uParentHz=%RU32, iFreqRatio=0x%RX64 (%RI64), uRateInc=0x%RX64 (%RU64), cSamples=%RU32 (%RU32 parent)\n",
                        AUDMIXBUF_FMT_SAMPLE_FREQ(pMixBuf->AudioFmt),
@@ -1495,6 +1773,8 @@ void AudioMixBufUnlink(PPDMAUDIOMIXBUF pMixBuf)
     {
         pMixBuf->pRate->dstOffset = pMixBuf->pRate->srcOffset = 0;
         pMixBuf->pRate->dstInc = 0;
+        pMixBuf->pRate->iPhase = 0;
+        pMixBuf->pRate->cSrcToSkip = 1;
     }
 
     pMixBuf->iFreqRatio = 1; /* Prevent division by zero. */
@@ -26,7 +26,9 @@
 
 #include <iprt/assert.h>
 #ifdef IN_RING3
+# include <iprt/asm.h>
 # include <iprt/mem.h>
+# include <iprt/semaphore.h>
 # include <iprt/string.h>
 # include <iprt/uuid.h>
 #endif
@@ -49,6 +51,13 @@
 
 #define AC97_SSM_VERSION 1
 
+/** The shortest I/O thread period (ms). */
+#define AC97_IO_PERIOD_MIN_MS   2
+/** The longest I/O thread period (ms), also used while no stream is running. */
+#define AC97_IO_PERIOD_MAX_MS   10
+/** How often the I/O thread visits a running stream per buffer descriptor. */
+#define AC97_IO_PERIODS_PER_BD  2
+
 #ifdef VBOX
 # define SOFT_VOLUME /** @todo Get rid of this crap. */
 #else
@@ -275,16 +284,21 @@ typedef struct AC97STATE
     /** Bus Master Control Registers for PCM in, PCM out, and Mic in */
     AC97BusMasterRegs       bm_regs[3];
     uint8_t                 mixer_data[256];
-    /** The emulation timer for handling the attached
-     *  LUN drivers. */
-    PTMTIMERR3              pTimer;
-    /** Timer ticks for handling the LUN drivers. */
-    uint64_t                uTicks;
-#ifdef VBOX_WITH_STATISTICS
-# if HC_ARCH_BITS == 32
+    /** The I/O thread doing the DMA transfers and servicing the
+     *  attached LUN drivers. */
+    R3PTRTYPE(PPDMTHREAD)   pThreadIo;
+    /** Event semaphore the I/O thread waits on between periods. */
+    RTSEMEVENT              hEvtIo;
+    /** The current I/O thread period in milliseconds, see ichac97IoUpdatePeriod. */
+    uint32_t volatile       cMsIoPeriod;
     uint32_t                u32Alignment0;
-# endif
-    STAMPROFILE             StatTimer;
+    /** Number of periods the host backend ran out of output data in. */
+    STAMCOUNTER             StatUnderruns;
+    /** Number of periods the host backend had more input data than the
+     *  guest's current buffer can hold. */
+    STAMCOUNTER             StatOverruns;
+#ifdef VBOX_WITH_STATISTICS
+    STAMPROFILE             StatIo;
     STAMCOUNTER             StatBytesRead;
     STAMCOUNTER             StatBytesWritten;
 #endif
@@ -318,9 +332,7 @@ typedef struct AC97STATE
 /** Pointer to the AC97 device state. */
 typedef AC97STATE *PAC97STATE;
 
-#ifdef VBOX_WITH_STATISTICS
-AssertCompileMemberAlignment(AC97STATE, StatTimer, 8);
-#endif
+AssertCompileMemberAlignment(AC97STATE, StatUnderruns, 8);
 
 #ifndef VBOX_DEVICE_STRUCT_TESTCASE
 
@@ -364,7 +376,6 @@ enum
 
 #define GET_BM(a_idx)   ( ((a_idx) >> 4) & 3 )
 
-static DECLCALLBACK(void) ichac97Timer(PPDMDEVINS pDevIns, PTMTIMER pTimer, void *pvUser);
 static int ichac97TransferAudio(PAC97STATE pThis, int index, uint32_t cbElapsed);
 
 static void ichac97WarmReset(PAC97STATE pThis)
@@ -1162,15 +1173,74 @@ static int ichac97ReadAudio(PAC97STATE pThis, PAC97BMREG pReg, uint32_t cbMax, u
     return rc;
 }
 
-static DECLCALLBACK(void) ichac97Timer(PPDMDEVINS pDevIns, PTMTIMER pTimer, void *pvUser)
+/**
+ * Calculates the I/O thread period suitable for the given bus master.
+ *
+ * Services a running stream AC97_IO_PERIODS_PER_BD times per buffer the
+ * guest hands us, so guests using large buffers are not woken up more often
+ * than needed while small buffers still get refilled in time.
+ *
+ * @returns Period in milliseconds.
+ * @param   pThis               The AC'97 state.
+ * @param   index               The bus master index (PI_INDEX, PO_INDEX or MC_INDEX).
+ */
+static uint32_t ichac97IoStreamPeriod(PAC97STATE pThis, int index)
 {
-    PAC97STATE pThis = PDMINS_2_DATA(pDevIns, PAC97STATE);
-    AssertPtrReturnVoid(pThis);
+    PAC97BMREG pReg = &pThis->bm_regs[index];
+    if (   !(pReg->cr & CR_RPBM)
+        || (pReg->sr & SR_DCH))
+        return AC97_IO_PERIOD_MAX_MS;
 
-    STAM_PROFILE_START(&pThis->StatTimer, a);
+    uint32_t uHz;
+    uint32_t cChannels = 2;
+    switch (index)
+    {
+        case PI_INDEX: uHz = ichac97MixerLoad(pThis, AC97_PCM_LR_ADC_Rate);    break;
+        case PO_INDEX: uHz = ichac97MixerLoad(pThis, AC97_PCM_Front_DAC_Rate); break;
+        default:       uHz = ichac97MixerLoad(pThis, AC97_MIC_ADC_Rate); cChannels = 1; break;
+    }
+
+    /* The buffer length is in samples (16-bit words) of all channels. */
+    uint32_t cSamples = pReg->bd.ctl_len & 0xffff;
+    if (   !pReg->bd_valid
+        || !cSamples
+        || !uHz)
+        return AC97_IO_PERIOD_MIN_MS;
+
+    uint32_t cMs = cSamples * 1000 / cChannels / uHz / AC97_IO_PERIODS_PER_BD;
+    return RT_CLAMP(cMs, AC97_IO_PERIOD_MIN_MS, AC97_IO_PERIOD_MAX_MS);
+}
+
+/**
+ * Recalculates the I/O thread period from the currently running streams.
+ *
+ * @param   pThis               The AC'97 state.
+ */
+static void ichac97IoUpdatePeriod(PAC97STATE pThis)
+{
+    uint32_t cMs = RT_MIN(ichac97IoStreamPeriod(pThis, PI_INDEX), ichac97IoStreamPeriod(pThis, PO_INDEX));
+    cMs = RT_MIN(cMs, ichac97IoStreamPeriod(pThis, MC_INDEX));
+    ASMAtomicWriteU32(&pThis->cMsIoPeriod, cMs);
+}
+
+/**
+ * Services the attached LUN drivers and does the DMA transfers of all running
+ * streams, called by the I/O thread once per period.
+ *
+ * @param   pThis               The AC'97 state.
+ */
+static void ichac97DoTransfers(PAC97STATE pThis)
+{
+    STAM_PROFILE_START(&pThis->StatIo, a);
 
     int rc = VINF_SUCCESS;
 
+    PAC97BMREG pRegOut = &pThis->bm_regs[PO_INDEX];
+    PAC97BMREG pRegIn  = &pThis->bm_regs[PI_INDEX];
+    bool const fOutRun = (pRegOut->cr & CR_RPBM) && !(pRegOut->sr & SR_DCH);
+    bool const fInRun  = (pRegIn->cr  & CR_RPBM) && !(pRegIn->sr  & SR_DCH);
+    bool       fUnderrun = false;
+
     uint32_t cbInMax  = 0;
     uint32_t cbOutMin = UINT32_MAX;
 
@@ -1205,6 +1275,8 @@ static DECLCALLBACK(void) ichac97Timer(PPDMDEVINS pDevIns, PTMTIMER pTimer, void
 #endif
                 }
             }
+            else if (fOutRun)
+                fUnderrun = true; /* The backend played everything we gave it last period. */
 
             cbInMax  = RT_MAX(cbInMax, cbIn);
             cbOutMin = RT_MIN(cbOutMin, cbOut);
@@ -1218,6 +1290,13 @@ static DECLCALLBACK(void) ichac97Timer(PPDMDEVINS pDevIns, PTMTIMER pTimer, void
     if (cbOutMin == UINT32_MAX)
         cbOutMin = 0;
 
+    if (fUnderrun)
+        STAM_REL_COUNTER_INC(&pThis->StatUnderruns);
+    if (   fInRun
+        && pRegIn->bd_valid
+        && cbInMax > (pRegIn->bd.ctl_len & 0xffff) << 1)
+        STAM_REL_COUNTER_INC(&pThis->StatOverruns);
+
     /*
      * Playback.
      */
@@ -1233,9 +1312,50 @@ static DECLCALLBACK(void) ichac97Timer(PPDMDEVINS pDevIns, PTMTIMER pTimer, void
     if (cbInMax)
         ichac97TransferAudio(pThis, PI_INDEX, cbInMax); /** @todo Add rc! */
 
-    TMTimerSet(pThis->pTimer, TMTimerGet(pThis->pTimer) + pThis->uTicks);
+    /* The guest may have moved on to differently sized buffers or stopped a stream. */
+    ichac97IoUpdatePeriod(pThis);
+
+    STAM_PROFILE_STOP(&pThis->StatIo, a);
+}
+
+/**
+ * @callback_method_impl{FNPDMTHREADDEV, The AC'97 I/O thread.}
+ *
+ * Replaces the former EMT timer so that the stream processing no longer
+ * competes with guest code execution.  The period adapts to the buffer
+ * sizes of the running streams, see ichac97IoUpdatePeriod.
+ */
+static DECLCALLBACK(int) ichac97IoThread(PPDMDEVINS pDevIns, PPDMTHREAD pThread)
+{
+    PAC97STATE pThis = PDMINS_2_DATA(pDevIns, PAC97STATE);
+
+    if (pThread->enmState == PDMTHREADSTATE_INITIALIZING)
+        return VINF_SUCCESS;
 
-    STAM_PROFILE_STOP(&pThis->StatTimer, a);
+    while (pThread->enmState == PDMTHREADSTATE_RUNNING)
+    {
+        int rc = RTSemEventWait(pThis->hEvtIo, ASMAtomicReadU32(&pThis->cMsIoPeriod));
+        AssertLogRelMsgReturn(RT_SUCCESS(rc) || rc == VERR_TIMEOUT || rc == VERR_INTERRUPTED, ("%Rrc\n", rc), rc);
+        if (pThread->enmState != PDMTHREADSTATE_RUNNING)
+            break;
+
+        /* The bus master registers are shared with the I/O port handlers. */
+        PDMCritSectEnter(pDevIns->pCritSectRoR3, VERR_IGNORED);
+        ichac97DoTransfers(pThis);
+        PDMCritSectLeave(pDevIns->pCritSectRoR3);
+    }
+
+    return VINF_SUCCESS;
+}
+
+/**
+ * @callback_method_impl{FNPDMTHREADWAKEUPDEV}
+ */
+static DECLCALLBACK(int) ichac97IoThreadWakeUp(PPDMDEVINS pDevIns, PPDMTHREAD pThread)
+{
+    PAC97STATE pThis = PDMINS_2_DATA(pDevIns, PAC97STATE);
+    NOREF(pThread);
+    return RTSemEventSignal(pThis->hEvtIo);
 }
 
 static int ichac97TransferAudio(PAC97STATE pThis, int index, uint32_t cbElapsed)
@@ -1585,6 +1705,9 @@ static DECLCALLBACK(int) ichac97IOPortNABMWrite(PPDMDEVINS pDevIns, void *pvUser
                             pReg->sr &= ~SR_DCH;
                             ichac97StreamSetActive(pThis, pReg - pThis->bm_regs, 1);
                         }
+                        ichac97IoUpdatePeriod(pThis);
+                        if (pReg->cr & CR_RPBM)
+                            RTSemEventSignal(pThis->hEvtIo); /* Start transferring right away. */
                     }
                     LogFlowFunc(("CR[%d] <- %#x (cr %#x)\n", GET_BM(index), u32, pReg->cr));
                     break;
@@ -2021,6 +2144,19 @@ static DECLCALLBACK(int) ichac97Destruct(PPDMDEVINS pDevIns)
 
     LogFlowFuncEnter();
 
+    if (pThis->pThreadIo)
+    {
+        int rc = PDMR3ThreadDestroy(pThis->pThreadIo, NULL);
+        AssertRC(rc);
+        pThis->pThreadIo = NULL;
+    }
+
+    if (pThis->hEvtIo != NIL_RTSEMEVENT)
+    {
+        RTSemEventDestroy(pThis->hEvtIo);
+        pThis->hEvtIo = NIL_RTSEMEVENT;
+    }
+
     PAC97DRIVER pDrv;
     while (!RTListIsEmpty(&pThis->lstDrv))
     {
@@ -2173,6 +2309,7 @@ static DECLCALLBACK(int) ichac97Construct(PPDMDEVINS pDevIns, int iInstance, PCF
      * Initialize data (most of it anyway).
      */
     pThis->pDevIns                  = pDevIns;
+    pThis->hEvtIo                   = NIL_RTSEMEVENT;
     /* IBase */
     pThis->IBase.pfnQueryInterface  = ichac97QueryInterface;
 
@@ -2326,21 +2463,21 @@ static DECLCALLBACK(int) ichac97Construct(PPDMDEVINS pDevIns, int iInstance, PCF
 
     if (RT_SUCCESS(rc))
     {
-        /* Start the emulation timer. */
-        rc = PDMDevHlpTMTimerCreate(pDevIns, TMCLOCK_VIRTUAL, ichac97Timer, pThis,
-                                    TMTIMER_FLAGS_NO_CRIT_SECT, "DevIchAc97", &pThis->pTimer);
+        /* Start the I/O thread. */
+        pThis->cMsIoPeriod = AC97_IO_PERIOD_MAX_MS;
+        rc = RTSemEventCreate(&pThis->hEvtIo);
         AssertRCReturn(rc, rc);
 
-        if (RT_SUCCESS(rc))
-        {
-            pThis->uTicks = PDMDevHlpTMTimeVirtGetFreq(pDevIns) / 200; /** Hz. @todo Make this configurable! */
-            if (pThis->uTicks < 100)
-                pThis->uTicks = 100;
-            LogFunc(("Timer ticks=%RU64\n", pThis->uTicks));
+        rc = PDMDevHlpThreadCreate(pDevIns, &pThis->pThreadIo, pThis, ichac97IoThread, ichac97IoThreadWakeUp,
+                                   0, RTTHREADTYPE_IO, "AC97IO");
+        if (RT_FAILURE(rc))
+            return PDMDEV_SET_ERROR(pDevIns, rc, N_("AC'97: Failed to create the I/O thread"));
+    }
 
-            /* Fire off timer. */
-            TMTimerSet(pThis->pTimer, TMTimerGet(pThis->pTimer) + pThis->uTicks);
-        }
+    if (RT_SUCCESS(rc))
+    {
+        PDMDevHlpSTAMRegister(pDevIns, &pThis->StatUnderruns,        STAMTYPE_COUNTER, "/Devices/AC97/Underruns",         STAMUNIT_OCCURENCES,     "Periods the host backend ran out of output data in.");
+        PDMDevHlpSTAMRegister(pDevIns, &pThis->StatOverruns,         STAMTYPE_COUNTER, "/Devices/AC97/Overruns",          STAMUNIT_OCCURENCES,     "Periods the host backend had more input data than the guest buffer holds.");
     }
 
 # ifdef VBOX_WITH_STATISTICS
@@ -2349,7 +2486,7 @@ static DECLCALLBACK(int) ichac97Construct(PPDMDEVINS pDevIns, int iInstance, PCF
         /*
          * Register statistics.
          */
-        PDMDevHlpSTAMRegister(pDevIns, &pThis->StatTimer,            STAMTYPE_PROFILE, "/Devices/AC97/Timer",             STAMUNIT_TICKS_PER_CALL, "Profiling ichac97Timer.");
+        PDMDevHlpSTAMRegister(pDevIns, &pThis->StatIo,               STAMTYPE_PROFILE, "/Devices/AC97/Io",                STAMUNIT_TICKS_PER_CALL, "Profiling ichac97DoTransfers.");
         PDMDevHlpSTAMRegister(pDevIns, &pThis->StatBytesRead,        STAMTYPE_COUNTER, "/Devices/AC97/BytesRead"   ,      STAMUNIT_BYTES,          "Bytes read from AC97 emulation.");
         PDMDevHlpSTAMRegister(pDevIns, &pThis->StatBytesWritten,     STAMTYPE_COUNTER, "/Devices/AC97/BytesWritten",      STAMUNIT_BYTES,          "Bytes written to AC97 emulation.");
     }
@@ -36,6 +36,7 @@
 # include <iprt/uuid.h>
 # include <iprt/string.h>
 # include <iprt/mem.h>
+# include <iprt/semaphore.h>
 #endif
 #include <iprt/list.h>
 
@@ -84,6 +85,14 @@
 #define HDA_NREGS           114
 #define HDA_NREGS_SAVED     112
 
+/** The shortest I/O thread period (ms), used while a running stream has a
+ *  small cyclic buffer or an unknown format. */
+#define HDA_IO_PERIOD_MIN_MS    2
+/** The longest I/O thread period (ms), also used while no stream is running. */
+#define HDA_IO_PERIOD_MAX_MS    10
+/** How often the I/O thread visits a running stream per cyclic buffer. */
+#define HDA_IO_PERIODS_PER_CBL  4
+
 /**
  *  NB: Register values stored in memory (au32Regs[]) are indexed through
  *  the HDA_RMX_xxx macros (also HDA_MEM_IND_NAME()). On the other hand, the
@@ -644,13 +653,21 @@ typedef struct HDASTATE
     bool                               fR0Enabled;
     /** Flag whether the RC part is enabled. */
     bool                               fRCEnabled;
-    /** The emulation timer for handling the attached
-     *  LUN drivers. */
-    PTMTIMERR3                         pTimer;
-    /** Timer ticks for handling the LUN drivers. */
-    uint64_t                           uTicks;
+    /** The I/O thread doing the DMA transfers and servicing the
+     *  attached LUN drivers. */
+    R3PTRTYPE(PPDMTHREAD)              pThreadIo;
+    /** Event semaphore the I/O thread waits on between periods. */
+    RTSEMEVENT                         hEvtIo;
+    /** The current I/O thread period in milliseconds, see hdaIoUpdatePeriod. */
+    uint32_t volatile                  cMsIoPeriod;
+    uint32_t                           u32Padding3;
+    /** Number of periods the host backend ran out of output data in. */
+    STAMCOUNTER                        StatUnderruns;
+    /** Number of periods the host backend had more input data than the
+     *  guest's cyclic buffer can hold. */
+    STAMCOUNTER                        StatOverruns;
 # ifdef VBOX_WITH_STATISTICS
-    STAMPROFILE                        StatTimer;
+    STAMPROFILE                        StatIo;
     STAMCOUNTER                        StatBytesRead;
     STAMCOUNTER                        StatBytesWritten;
 # endif
@@ -729,10 +746,10 @@ static int hdaRegWriteU16(PHDASTATE pThis, uint32_t iReg, uint32_t pu32Value);
 static int hdaRegReadU8(PHDASTATE pThis, uint32_t iReg, uint32_t *pu32Value);
 static int hdaRegWriteU8(PHDASTATE pThis, uint32_t iReg, uint32_t pu32Value);
 
-static DECLCALLBACK(void) hdaTimer(PPDMDEVINS pDevIns, PTMTIMER pTimer, void *pvUser);
 static int hdaTransfer(PHDASTATE pThis, ENMSOUNDSOURCE enmSrc, uint32_t cbAvail);
 
 #ifdef IN_RING3
+static void hdaIoUpdatePeriod(PHDASTATE pThis);
 DECLINLINE(void) hdaInitTransferDescriptor(PHDASTATE pThis, PHDABDLEDESC pBdle, uint8_t u8Strm,
                                            PHDASTREAMTRANSFERDESC pStreamDesc);
 static void hdaFetchBdle(PHDASTATE pThis, PHDABDLEDESC pBdle, PHDASTREAMTRANSFERDESC pStreamDesc);
@@ -1567,6 +1584,13 @@ static int hdaRegWriteSDCTL(PHDASTATE pThis, uint32_t iReg, uint32_t u32Value)
                     AssertMsgFailed(("Changing RUN bit on non-attached stream, register %RU32\n", iReg));
                     break;
             }
+
+            /* The I/O period depends on the set of running streams. */
+            int rc = hdaRegWriteU24(pThis, iReg, u32Value);
+            hdaIoUpdatePeriod(pThis);
+            if (fRun)
+                RTSemEventSignal(pThis->hEvtIo); /* Start transferring right away. */
+            return rc;
         }
 #else /* !IN_RING3 */
         return VINF_IOM_R3_MMIO_WRITE;
@@ -2426,15 +2450,72 @@ static DECLCALLBACK(int) hdaSetVolume(PHDASTATE pThis, ENMSOUNDSOURCE enmSource,
     return rc;
 }
 
-static DECLCALLBACK(void) hdaTimer(PPDMDEVINS pDevIns, PTMTIMER pTimer, void *pvUser)
+/**
+ * Calculates the I/O thread period suitable for the given stream.
+ *
+ * Services a running stream HDA_IO_PERIODS_PER_CBL times per cyclic buffer,
+ * so guests setting up large buffers are not woken up more often than
+ * needed while small buffers still get refilled in time.
+ *
+ * @returns Period in milliseconds.
+ * @param   pThis               The HDA state.
+ * @param   u8Strm              The stream number.
+ */
+static uint32_t hdaIoStreamPeriod(PHDASTATE pThis, uint8_t u8Strm)
 {
-    PHDASTATE pThis = PDMINS_2_DATA(pDevIns, PHDASTATE);
-    AssertPtr(pThis);
+    if (!(HDA_STREAM_REG(pThis, CTL, u8Strm) & HDA_REG_FIELD_FLAG_MASK(SDCTL, RUN)))
+        return HDA_IO_PERIOD_MAX_MS;
 
-    STAM_PROFILE_START(&pThis->StatTimer, a);
+    PDMAUDIOSTREAMCFG strmCfg;
+    int rc = hdaSdFmtToAudSettings(HDA_STREAM_REG(pThis, FMT, u8Strm), &strmCfg);
+    if (RT_FAILURE(rc))
+        return HDA_IO_PERIOD_MIN_MS;
+
+    uint32_t cbSample  = strmCfg.enmFormat == AUD_FMT_S8  ? 1
+                       : strmCfg.enmFormat == AUD_FMT_S32 ? 4 : 2;
+    uint64_t cbPerSec  = (uint64_t)strmCfg.uHz * strmCfg.cChannels * cbSample;
+    uint32_t cbCbl     = HDA_STREAM_REG(pThis, CBL, u8Strm);
+    if (!cbPerSec || !cbCbl)
+        return HDA_IO_PERIOD_MIN_MS;
+
+    uint64_t cMs = cbCbl * UINT64_C(1000) / cbPerSec / HDA_IO_PERIODS_PER_CBL;
+    return (uint32_t)RT_CLAMP(cMs, HDA_IO_PERIOD_MIN_MS, HDA_IO_PERIOD_MAX_MS);
+}
+
+/**
+ * Recalculates the I/O thread period from the currently running streams.
+ *
+ * Must be called whenever a stream is started or stopped.
+ *
+ * @param   pThis               The HDA state.
+ */
+static void hdaIoUpdatePeriod(PHDASTATE pThis)
+{
+    uint32_t cMs = RT_MIN(hdaIoStreamPeriod(pThis, 0 /* Line In */), hdaIoStreamPeriod(pThis, 4 /* Out */));
+#ifdef VBOX_WITH_HDA_MIC_IN
+    cMs = RT_MIN(cMs, hdaIoStreamPeriod(pThis, 2 /* Mic In */));
+#endif
+    if (cMs != pThis->cMsIoPeriod)
+        LogRel2(("HDA: I/O period is now %RU32ms\n", cMs));
+    ASMAtomicWriteU32(&pThis->cMsIoPeriod, cMs);
+}
+
+/**
+ * Services the attached LUN drivers and does the DMA transfers of all running
+ * streams, called by the I/O thread once per period.
+ *
+ * @param   pThis               The HDA state.
+ */
+static void hdaDoTransfers(PHDASTATE pThis)
+{
+    STAM_PROFILE_START(&pThis->StatIo, a);
 
     int rc = VINF_SUCCESS;
 
+    bool const fOutRun = RT_BOOL(SDCTL(pThis, 4) & HDA_REG_FIELD_FLAG_MASK(SDCTL, RUN));
+    bool const fInRun  = RT_BOOL(SDCTL(pThis, 0) & HDA_REG_FIELD_FLAG_MASK(SDCTL, RUN));
+    bool       fUnderrun = false;
+
     uint32_t cbInMax  = 0;
     uint32_t cbOutMin = UINT32_MAX;
 
@@ -2465,6 +2546,8 @@ static DECLCALLBACK(void) hdaTimer(PPDMDEVINS pDevIns, PTMTIMER pTimer, void *pv
                     LogFlowFunc(("\tLUN#%RU8: [2] cbIn=%RU32, cbOut=%RU32\n", pDrv->uLUN, cbIn, cbOut));
 #endif
             }
+            else if (fOutRun)
+                fUnderrun = true; /* The backend played everything we gave it last period. */
 
             cbInMax  = RT_MAX(cbInMax, cbIn);
             cbOutMin = RT_MIN(cbOutMin, cbOut);
@@ -2478,6 +2561,11 @@ static DECLCALLBACK(void) hdaTimer(PPDMDEVINS pDevIns, PTMTIMER pTimer, void *pv
     if (cbOutMin == UINT32_MAX)
         cbOutMin = 0;
 
+    if (fUnderrun)
+        STAM_REL_COUNTER_INC(&pThis->StatUnderruns);
+    if (fInRun && cbInMax > HDA_STREAM_REG(pThis, CBL, 0))
+        STAM_REL_COUNTER_INC(&pThis->StatOverruns);
+
     /*
      * Playback.
      */
@@ -2493,9 +2581,47 @@ static DECLCALLBACK(void) hdaTimer(PPDMDEVINS pDevIns, PTMTIMER pTimer, void *pv
     if (cbInMax)
         hdaTransfer(pThis, PI_INDEX, cbInMax); /** @todo Add rc! */
 
-    TMTimerSet(pThis->pTimer, TMTimerGet(pThis->pTimer) + pThis->uTicks);
+    STAM_PROFILE_STOP(&pThis->StatIo, a);
+}
+
+/**
+ * @callback_method_impl{FNPDMTHREADDEV, The HDA I/O thread.}
+ *
+ * Replaces the former EMT timer so that the stream processing no longer
+ * competes with guest code execution.  The period adapts to the cyclic
+ * buffer sizes of the running streams, see hdaIoUpdatePeriod.
+ */
+static DECLCALLBACK(int) hdaIoThread(PPDMDEVINS pDevIns, PPDMTHREAD pThread)
+{
+    PHDASTATE pThis = PDMINS_2_DATA(pDevIns, PHDASTATE);
+
+    if (pThread->enmState == PDMTHREADSTATE_INITIALIZING)
+        return VINF_SUCCESS;
+
+    while (pThread->enmState == PDMTHREADSTATE_RUNNING)
+    {
+        int rc = RTSemEventWait(pThis->hEvtIo, ASMAtomicReadU32(&pThis->cMsIoPeriod));
+        AssertLogRelMsgReturn(RT_SUCCESS(rc) || rc == VERR_TIMEOUT || rc == VERR_INTERRUPTED, ("%Rrc\n", rc), rc);
+        if (pThread->enmState != PDMTHREADSTATE_RUNNING)
+            break;
+
+        /* The register state is shared with the MMIO handlers. */
+        PDMCritSectEnter(pDevIns->pCritSectRoR3, VERR_IGNORED);
+        hdaDoTransfers(pThis);
+        PDMCritSectLeave(pDevIns->pCritSectRoR3);
+    }
 
-    STAM_PROFILE_STOP(&pThis->StatTimer, a);
+    return VINF_SUCCESS;
+}
+
+/**
+ * @callback_method_impl{FNPDMTHREADWAKEUPDEV}
+ */
+static DECLCALLBACK(int) hdaIoThreadWakeUp(PPDMDEVINS pDevIns, PPDMTHREAD pThread)
+{
+    PHDASTATE pThis = PDMINS_2_DATA(pDevIns, PHDASTATE);
+    NOREF(pThread);
+    return RTSemEventSignal(pThis->hEvtIo);
 }
 
 static int hdaTransfer(PHDASTATE pThis,
@@ -3126,6 +3252,8 @@ static DECLCALLBACK(int) hdaLoadExec(PPDMDEVINS pDevIns, PSSMHANDLE pSSM, uint32
         pThis->u64CORBBase = RT_MAKE_U64(HDA_REG(pThis, CORBLBASE), HDA_REG(pThis, CORBUBASE));
         pThis->u64RIRBBase = RT_MAKE_U64(HDA_REG(pThis, RIRBLBASE), HDA_REG(pThis, RIRBUBASE));
         pThis->u64DPBase   = RT_MAKE_U64(HDA_REG(pThis, DPLBASE), HDA_REG(pThis, DPUBASE));
+
+        hdaIoUpdatePeriod(pThis);
     }
 
     LogFlowFuncLeaveRC(rc);
@@ -3431,6 +3559,8 @@ static DECLCALLBACK(void) hdaReset(PPDMDEVINS pDevIns)
     /* Emulation of codec "wake up" (HDA spec 5.5.1 and 6.5). */
     HDA_REG(pThis, STATESTS) = 0x1;
 
+    hdaIoUpdatePeriod(pThis);
+
     LogRel(("HDA: Reset\n"));
 }
 
@@ -3441,6 +3571,19 @@ static DECLCALLBACK(int) hdaDestruct(PPDMDEVINS pDevIns)
 {
     PHDASTATE pThis = PDMINS_2_DATA(pDevIns, PHDASTATE);
 
+    if (pThis->pThreadIo)
+    {
+        int rc = PDMR3ThreadDestroy(pThis->pThreadIo, NULL);
+        AssertRC(rc);
+        pThis->pThreadIo = NULL;
+    }
+
+    if (pThis->hEvtIo != NIL_RTSEMEVENT)
+    {
+        RTSemEventDestroy(pThis->hEvtIo);
+        pThis->hEvtIo = NIL_RTSEMEVENT;
+    }
+
     PHDADRIVER pDrv;
     while (!RTListIsEmpty(&pThis->lstDrv))
     {
@@ -3586,6 +3729,7 @@ static DECLCALLBACK(int) hdaConstruct(PPDMDEVINS pDevIns, int iInstance, PCFGMNO
     pThis->pDevInsR3                = pDevIns;
     pThis->pDevInsR0                = PDMDEVINS_2_R0PTR(pDevIns);
     pThis->pDevInsRC                = PDMDEVINS_2_RCPTR(pDevIns);
+    pThis->hEvtIo                   = NIL_RTSEMEVENT;
     /* IBase */
     pThis->IBase.pfnQueryInterface  = hdaQueryInterface;
 
@@ -3865,23 +4009,21 @@ static DECLCALLBACK(int) hdaConstruct(PPDMDEVINS pDevIns, int iInstance, PCFGMNO
 
     if (RT_SUCCESS(rc))
     {
-        /* Start the emulation timer. */
-        rc = PDMDevHlpTMTimerCreate(pDevIns, TMCLOCK_VIRTUAL, hdaTimer, pThis,
-                                    TMTIMER_FLAGS_NO_CRIT_SECT, "DevIchHda", &pThis->pTimer);
+        /* Start the I/O thread. */
+        pThis->cMsIoPeriod = HDA_IO_PERIOD_MAX_MS;
+        rc = RTSemEventCreate(&pThis->hEvtIo);
         AssertRCReturn(rc, rc);
 
-        if (RT_SUCCESS(rc))
-        {
-            /** @todo Investigate why sounds is getting corrupted if the "ticks" value is too
-             *        low, e.g. "PDMDevHlpTMTimeVirtGetFreq / 200". */
-            pThis->uTicks = PDMDevHlpTMTimeVirtGetFreq(pDevIns) / 500; /** @todo Make this configurable! */
-            if (pThis->uTicks < 100)
-                pThis->uTicks = 100;
-            LogFunc(("Timer ticks=%RU64\n", pThis->uTicks));
-
-            /* Fire off timer. */
-            TMTimerSet(pThis->pTimer, TMTimerGet(pThis->pTimer) + pThis->uTicks);
-        }
+        rc = PDMDevHlpThreadCreate(pDevIns, &pThis->pThreadIo, pThis, hdaIoThread, hdaIoThreadWakeUp,
+                                   0, RTTHREADTYPE_IO, "HDAIO");
+        if (RT_FAILURE(rc))
+            return PDMDEV_SET_ERROR(pDevIns, rc, N_("HDA: Failed to create the I/O thread"));
+    }
+
+    if (RT_SUCCESS(rc))
+    {
+        PDMDevHlpSTAMRegister(pDevIns, &pThis->StatUnderruns,        STAMTYPE_COUNTER, "/Devices/HDA/Underruns",         STAMUNIT_OCCURENCES,     "Periods the host backend ran out of output data in.");
+        PDMDevHlpSTAMRegister(pDevIns, &pThis->StatOverruns,         STAMTYPE_COUNTER, "/Devices/HDA/Overruns",          STAMUNIT_OCCURENCES,     "Periods the host backend had more input data than the guest buffer holds.");
     }
 
 # ifdef VBOX_WITH_STATISTICS
@@ -3890,7 +4032,7 @@ static DECLCALLBACK(int) hdaConstruct(PPDMDEVINS pDevIns, int iInstance, PCFGMNO
         /*
          * Register statistics.
          */
-        PDMDevHlpSTAMRegister(pDevIns, &pThis->StatTimer,            STAMTYPE_PROFILE, "/Devices/HDA/Timer",             STAMUNIT_TICKS_PER_CALL, "Profiling hdaTimer.");
+        PDMDevHlpSTAMRegister(pDevIns, &pThis->StatIo,               STAMTYPE_PROFILE, "/Devices/HDA/Io",                STAMUNIT_TICKS_PER_CALL, "Profiling hdaDoTransfers.");
         PDMDevHlpSTAMRegister(pDevIns, &pThis->StatBytesRead,        STAMTYPE_COUNTER, "/Devices/HDA/BytesRead"   ,      STAMUNIT_BYTES,          "Bytes read from HDA emulation.");
         PDMDevHlpSTAMRegister(pDevIns, &pThis->StatBytesWritten,     STAMTYPE_COUNTER, "/Devices/HDA/BytesWritten",      STAMUNIT_BYTES,          "Bytes written to HDA emulation.");
     }
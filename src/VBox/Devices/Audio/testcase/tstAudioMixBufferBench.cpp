@@ -0,0 +1,437 @@
+/* $Id$ */
+/** @file
+ * Audio testcase - Mixing buffer conversion, mixing and rate conversion benchmark.
+ */
+
+/*
+ * Copyright (C) 2014-2015 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include <iprt/err.h>
+#include <iprt/initterm.h>
+#include <iprt/mem.h>
+#include <iprt/rand.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+#include <iprt/time.h>
+
+
+#include "../AudioMixBuffer.h"
+#include "../DrvAudio.h"
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+/** The size of the mixing buffers (in samples). */
+#define TST_BUF_SAMPLES     _4K
+/** The number of samples written per round in the benchmarks, about 20ms at 48KHz. */
+#define TST_CHUNK_SAMPLES   960
+
+/** Source samples, 16-bit signed stereo. */
+static int16_t  g_ai16Src[TST_BUF_SAMPLES * 2];
+/** Destination samples, 16-bit signed stereo. */
+static int16_t  g_ai16Dst[TST_BUF_SAMPLES * 2];
+#ifdef RT_ARCH_AMD64
+/** Internal samples produced by the SSE2 code. */
+static PDMAUDIOSAMPLE g_aSamplesSse2[TST_BUF_SAMPLES];
+/** Destination samples produced by the SSE2 code, 16-bit signed stereo. */
+static int16_t  g_ai16DstSse2[TST_BUF_SAMPLES * 2];
+#endif
+
+
+/**
+ * Initializes a mixing buffer for 16-bit signed samples.
+ */
+static int tstInitBuf(PPDMAUDIOMIXBUF pMixBuf, const char *pszName, uint32_t uHz, uint8_t cChannels)
+{
+    PDMAUDIOSTREAMCFG cfg =
+    {
+        uHz,                      /* Hz */
+        cChannels                 /* Channels */,
+        AUD_FMT_S16               /* Format */,
+        PDMAUDIOENDIANNESS_LITTLE /* ENDIANNESS */
+    };
+    PDMPCMPROPS props;
+
+    int rc = DrvAudioStreamCfgToProps(&cfg, &props);
+    if (RT_SUCCESS(rc))
+        rc = AudioMixBufInit(pMixBuf, pszName, &props, TST_BUF_SAMPLES);
+    return rc;
+}
+
+
+/**
+ * Checks that 16-bit samples survive the conversion to the internal format
+ * and back at 0dB for all lengths up to a few vector widths.
+ */
+static void tstRoundTrip(RTTEST hTest, uint8_t cChannels)
+{
+    RTTestSubF(hTest, "Round trip, %u channel(s)", cChannels);
+
+    PDMAUDIOMIXBUF mb;
+    RTTESTI_CHECK_RC_OK_RETV(tstInitBuf(&mb, "RoundTrip", 44100, cChannels));
+
+    for (uint32_t i = 0; i < RT_ELEMENTS(g_ai16Src); i++)
+        g_ai16Src[i] = (int16_t)RTRandU32();
+    g_ai16Src[0] = INT16_MIN;
+    g_ai16Src[1] = INT16_MAX;
+
+    for (uint32_t cSamples = 1; cSamples <= 67; cSamples++)
+    {
+        uint32_t const cbSamples = cSamples * cChannels * sizeof(int16_t);
+        uint32_t       cWritten, cbRead;
+
+        AudioMixBufReset(&mb);
+        RT_ZERO(g_ai16Dst);
+        RTTESTI_CHECK_RC_OK_RETV(AudioMixBufWriteAt(&mb, 0, g_ai16Src, cbSamples, &cWritten));
+        RTTESTI_CHECK_RETV(cWritten == cSamples);
+        RTTESTI_CHECK_RC_OK_RETV(AudioMixBufReadAt(&mb, 0, g_ai16Dst, cbSamples, &cbRead));
+        RTTESTI_CHECK_RETV(cbRead == cbSamples);
+
+        if (cChannels == 2)
+            RTTESTI_CHECK_MSG(!memcmp(g_ai16Src, g_ai16Dst, cbSamples), ("cSamples=%u\n", cSamples));
+        else
+        {
+            /* Mono is stored as left == right and read back as their average. */
+            for (uint32_t i = 0; i < cSamples; i++)
+                RTTESTI_CHECK_MSG_RETV(g_ai16Src[i] == g_ai16Dst[i],
+                                       ("cSamples=%u i=%u: %d != %d\n", cSamples, i, g_ai16Dst[i], g_ai16Src[i]));
+        }
+    }
+
+    AudioMixBufDestroy(&mb);
+}
+
+
+/**
+ * Checks that the rate conversion of a constant signal yields exactly that
+ * signal and the expected number of samples.
+ */
+static void tstRateConstant(RTTEST hTest, uint32_t uHzChild, uint32_t uHzParent)
+{
+    RTTestSubF(hTest, "Rate conversion %RU32Hz -> %RU32Hz", uHzChild, uHzParent);
+
+    PDMAUDIOMIXBUF parent, child;
+    RTTESTI_CHECK_RC_OK_RETV(tstInitBuf(&parent, "Parent", uHzParent, 2));
+    RTTESTI_CHECK_RC_OK_RETV(tstInitBuf(&child, "Child", uHzChild, 2));
+    RTTESTI_CHECK_RC_OK_RETV(AudioMixBufLinkTo(&child, &parent));
+
+    for (uint32_t i = 0; i < TST_CHUNK_SAMPLES; i++)
+    {
+        g_ai16Src[i * 2]     = -12345;
+        g_ai16Src[i * 2 + 1] = 23456;
+    }
+
+    uint32_t cSamplesChild  = 0;
+    uint32_t cSamplesParent = 0;
+    for (unsigned iRound = 0; iRound < 32; iRound++)
+    {
+        uint32_t cWritten, cMixed, cRead;
+        RTTESTI_CHECK_RC_OK_RETV(AudioMixBufWriteAt(&child, 0, g_ai16Src, 100 * 2 * sizeof(int16_t), &cWritten));
+        RTTESTI_CHECK_RC_OK_RETV(AudioMixBufMixToParent(&child, cWritten, &cMixed));
+        cSamplesChild += cWritten;
+
+        for (;;)
+        {
+            RTTESTI_CHECK_RC_OK_RETV(AudioMixBufReadCirc(&parent, g_ai16Dst, sizeof(g_ai16Dst), &cRead));
+            if (!cRead)
+                break;
+            for (uint32_t i = 0; i < cRead; i++)
+                RTTESTI_CHECK_MSG_RETV(g_ai16Dst[i * 2] == -12345 && g_ai16Dst[i * 2 + 1] == 23456,
+                                       ("Sample %u: l=%d r=%d\n", cSamplesParent + i, g_ai16Dst[i * 2], g_ai16Dst[i * 2 + 1]));
+            cSamplesParent += cRead;
+            AudioMixBufFinish(&parent, cRead);
+        }
+    }
+
+    /* Every output sample needs the source sample following it for interpolating,
+     * so only the positions before the last source sample can be produced. */
+    uint64_t const cExpected = ((uint64_t)(cSamplesChild - 1) * uHzParent + uHzChild - 1) / uHzChild;
+    RTTESTI_CHECK_MSG(cSamplesParent + 1 >= cExpected && cSamplesParent <= cExpected + 1,
+                      ("Expected about %RU64 samples, got %RU32\n", cExpected, cSamplesParent));
+
+    AudioMixBufDestroy(&parent);
+    AudioMixBufDestroy(&child);
+}
+
+
+#ifdef RT_ARCH_AMD64
+/**
+ * Checks that the SSE2 conversion from 16-bit samples produces exactly the
+ * same internal samples as the generic code.
+ */
+static void tstSse2ConvFrom(RTTEST hTest, uint8_t cChannels, uint8_t uVolLeft, uint8_t uVolRight)
+{
+    RTTestSubF(hTest, "SSE2 vs generic write, %u channel(s), volume %u/%u", cChannels, uVolLeft, uVolRight);
+
+    PDMAUDIOMIXBUF mb;
+    RTTESTI_CHECK_RC_OK_RETV(tstInitBuf(&mb, "ConvFrom", 48000, cChannels));
+    PDMAUDIOVOLUME vol = { false, uVolLeft, uVolRight };
+    AudioMixBufSetVolume(&mb, &vol);
+
+    for (uint32_t cSamples = 1; cSamples <= TST_CHUNK_SAMPLES; cSamples += cSamples < 67 ? 1 : TST_CHUNK_SAMPLES - 67)
+    {
+        uint32_t const cbSamples = cSamples * cChannels * sizeof(int16_t);
+        uint32_t       cWritten;
+
+        g_fAudioMixBufNoSSE2 = false;
+        AudioMixBufReset(&mb);
+        RTTESTI_CHECK_RC_OK_RETV(AudioMixBufWriteAt(&mb, 0, g_ai16Src, cbSamples, &cWritten));
+        RTTESTI_CHECK_RETV(cWritten == cSamples);
+        memcpy(g_aSamplesSse2, mb.pSamples, cSamples * sizeof(PDMAUDIOSAMPLE));
+
+        g_fAudioMixBufNoSSE2 = true;
+        AudioMixBufReset(&mb);
+        RTTESTI_CHECK_RC_OK_RETV(AudioMixBufWriteAt(&mb, 0, g_ai16Src, cbSamples, &cWritten));
+        RTTESTI_CHECK_RETV(cWritten == cSamples);
+        for (uint32_t i = 0; i < cSamples; i++)
+            RTTESTI_CHECK_MSG_BREAK(   g_aSamplesSse2[i].i64LSample == mb.pSamples[i].i64LSample
+                                    && g_aSamplesSse2[i].i64RSample == mb.pSamples[i].i64RSample,
+                                    ("cSamples=%u i=%u: SSE2 %RI64/%RI64, generic %RI64/%RI64\n", cSamples, i,
+                                     g_aSamplesSse2[i].i64LSample, g_aSamplesSse2[i].i64RSample,
+                                     mb.pSamples[i].i64LSample, mb.pSamples[i].i64RSample));
+    }
+
+    g_fAudioMixBufNoSSE2 = false;
+    AudioMixBufDestroy(&mb);
+}
+
+
+/**
+ * Returns a random internal sample value, biased towards the 16-bit clipping
+ * boundaries.
+ */
+static int64_t tstRandSample(void)
+{
+    static int64_t const s_ai64Edges[] =
+    {
+        0, -1, INT32_MAX, INT32_MIN, (int64_t)INT32_MAX + 1, (int64_t)INT32_MIN - 1,
+        INT64_MAX, INT64_MIN, (int64_t)INT16_MAX << 16, (int64_t)INT16_MIN << 16
+    };
+    uint32_t const uPick = RTRandU32Ex(0, 3);
+    if (!uPick)
+        return s_ai64Edges[RTRandU32Ex(0, RT_ELEMENTS(s_ai64Edges) - 1)];
+    return (int64_t)RTRandU64() >> RTRandU32Ex(16, 63);
+}
+
+
+/**
+ * Checks that the SSE2 conversion to 16-bit stereo, including the clipping,
+ * produces exactly the same samples as the generic code.
+ */
+static void tstSse2ConvTo(RTTEST hTest)
+{
+    RTTestSub(hTest, "SSE2 vs generic read");
+
+    PDMAUDIOMIXBUF mb;
+    RTTESTI_CHECK_RC_OK_RETV(tstInitBuf(&mb, "ConvTo", 48000, 2));
+
+    for (uint32_t cSamples = 1; cSamples <= TST_CHUNK_SAMPLES; cSamples += cSamples < 67 ? 1 : TST_CHUNK_SAMPLES - 67)
+    {
+        uint32_t const cbSamples = cSamples * 2 * sizeof(int16_t);
+        uint32_t       cbRead;
+
+        AudioMixBufReset(&mb);
+        for (uint32_t i = 0; i < cSamples; i++)
+        {
+            mb.pSamples[i].i64LSample = tstRandSample();
+            mb.pSamples[i].i64RSample = tstRandSample();
+        }
+
+        g_fAudioMixBufNoSSE2 = false;
+        RTTESTI_CHECK_RC_OK_RETV(AudioMixBufReadAt(&mb, 0, g_ai16DstSse2, cbSamples, &cbRead));
+        RTTESTI_CHECK_RETV(cbRead == cbSamples);
+
+        g_fAudioMixBufNoSSE2 = true;
+        RTTESTI_CHECK_RC_OK_RETV(AudioMixBufReadAt(&mb, 0, g_ai16Dst, cbSamples, &cbRead));
+        RTTESTI_CHECK_RETV(cbRead == cbSamples);
+
+        for (uint32_t i = 0; i < cSamples * 2; i++)
+            RTTESTI_CHECK_MSG_BREAK(g_ai16DstSse2[i] == g_ai16Dst[i],
+                                    ("cSamples=%u i=%u: sample %RI64: SSE2 %d, generic %d\n", cSamples, i,
+                                     i & 1 ? mb.pSamples[i / 2].i64RSample : mb.pSamples[i / 2].i64LSample,
+                                     g_ai16DstSse2[i], g_ai16Dst[i]));
+    }
+
+    g_fAudioMixBufNoSSE2 = false;
+    AudioMixBufDestroy(&mb);
+}
+
+
+/**
+ * Mixes two children into their parent at the same rate, which blends
+ * without rate conversion, and returns the resulting parent samples.
+ */
+static void tstBlend(PPDMAUDIOSAMPLE paResult)
+{
+    PDMAUDIOMIXBUF parent, child1, child2;
+    RTTESTI_CHECK_RC_OK_RETV(tstInitBuf(&parent, "Parent", 48000, 2));
+    RTTESTI_CHECK_RC_OK_RETV(tstInitBuf(&child1, "Child1", 48000, 2));
+    RTTESTI_CHECK_RC_OK_RETV(tstInitBuf(&child2, "Child2", 48000, 2));
+    RTTESTI_CHECK_RC_OK_RETV(AudioMixBufLinkTo(&child1, &parent));
+    RTTESTI_CHECK_RC_OK_RETV(AudioMixBufLinkTo(&child2, &parent));
+
+    uint32_t cWritten, cMixed;
+    RTTESTI_CHECK_RC_OK(AudioMixBufWriteAt(&child1, 0, g_ai16Src, TST_CHUNK_SAMPLES * 2 * sizeof(int16_t), &cWritten));
+    RTTESTI_CHECK_RC_OK(AudioMixBufMixToParent(&child1, cWritten, &cMixed));
+    RTTESTI_CHECK_RC_OK(AudioMixBufWriteAt(&child2, 0, &g_ai16Src[TST_CHUNK_SAMPLES * 2],
+                                           TST_CHUNK_SAMPLES * 2 * sizeof(int16_t), &cWritten));
+    RTTESTI_CHECK_RC_OK(AudioMixBufMixToParent(&child2, cWritten, &cMixed));
+    memcpy(paResult, parent.pSamples, TST_CHUNK_SAMPLES * sizeof(PDMAUDIOSAMPLE));
+
+    AudioMixBufDestroy(&child2);
+    AudioMixBufDestroy(&child1);
+    AudioMixBufDestroy(&parent);
+}
+
+
+/**
+ * Checks that the SSE2 blending produces exactly the same samples as the
+ * generic code.
+ */
+static void tstSse2Blend(RTTEST hTest)
+{
+    RTTestSub(hTest, "SSE2 vs generic blend");
+
+    static PDMAUDIOSAMPLE s_aGeneric[TST_CHUNK_SAMPLES];
+    g_fAudioMixBufNoSSE2 = false;
+    tstBlend(g_aSamplesSse2);
+    g_fAudioMixBufNoSSE2 = true;
+    tstBlend(s_aGeneric);
+    g_fAudioMixBufNoSSE2 = false;
+
+    RTTESTI_CHECK(!memcmp(g_aSamplesSse2, s_aGeneric, sizeof(s_aGeneric)));
+}
+#endif /* RT_ARCH_AMD64 */
+
+
+/**
+ * Times the conversion to and from the internal format.
+ */
+static void tstBenchConversion(RTTEST hTest, uint8_t cChannels, uint8_t uVol)
+{
+    PDMAUDIOMIXBUF mb;
+    RTTESTI_CHECK_RC_OK_RETV(tstInitBuf(&mb, "Conversion", 48000, cChannels));
+
+    PDMAUDIOVOLUME vol = { false, uVol, uVol };
+    AudioMixBufSetVolume(&mb, &vol);
+
+    uint32_t const cbChunk = TST_CHUNK_SAMPLES * cChannels * sizeof(int16_t);
+    unsigned const cRounds = _16K;
+    uint32_t       cWritten, cbRead;
+
+    uint64_t nsStart = RTTimeNanoTS();
+    for (unsigned i = 0; i < cRounds; i++)
+        AudioMixBufWriteAt(&mb, 0, g_ai16Src, cbChunk, &cWritten);
+    uint64_t cNsElapsed = RTTimeNanoTS() - nsStart;
+    RTTestValueF(hTest, cNsElapsed * 1000 / ((uint64_t)cRounds * TST_CHUNK_SAMPLES), RTTESTUNIT_NONE,
+                 "Write, %u channel(s), volume %u, ps/sample", cChannels, uVol);
+
+    nsStart = RTTimeNanoTS();
+    for (unsigned i = 0; i < cRounds; i++)
+        AudioMixBufReadAt(&mb, 0, g_ai16Dst, cbChunk, &cbRead);
+    cNsElapsed = RTTimeNanoTS() - nsStart;
+    RTTestValueF(hTest, cNsElapsed * 1000 / ((uint64_t)cRounds * TST_CHUNK_SAMPLES), RTTESTUNIT_NONE,
+                 "Read, %u channel(s), ps/sample", cChannels);
+
+    AudioMixBufDestroy(&mb);
+}
+
+
+/**
+ * Times writing to a child buffer and mixing it to its parent, including
+ * the rate conversion if the rates differ.
+ */
+static void tstBenchMix(RTTEST hTest, uint32_t uHzChild, uint32_t uHzParent)
+{
+    PDMAUDIOMIXBUF parent, child;
+    RTTESTI_CHECK_RC_OK_RETV(tstInitBuf(&parent, "Parent", uHzParent, 2));
+    RTTESTI_CHECK_RC_OK_RETV(tstInitBuf(&child, "Child", uHzChild, 2));
+    RTTESTI_CHECK_RC_OK_RETV(AudioMixBufLinkTo(&child, &parent));
+
+    unsigned const cRounds = _8K;
+    uint64_t       cSamplesParent = 0;
+    uint64_t const nsStart = RTTimeNanoTS();
+    for (unsigned iRound = 0; iRound < cRounds; iRound++)
+    {
+        uint32_t cWritten, cMixed, cRead;
+        AudioMixBufWriteAt(&child, 0, g_ai16Src, TST_CHUNK_SAMPLES * 2 * sizeof(int16_t), &cWritten);
+        AudioMixBufMixToParent(&child, cWritten, &cMixed);
+        for (;;)
+        {
+            AudioMixBufReadCirc(&parent, g_ai16Dst, sizeof(g_ai16Dst), &cRead);
+            if (!cRead)
+                break;
+            cSamplesParent += cRead;
+            AudioMixBufFinish(&parent, cRead);
+        }
+    }
+    uint64_t const cNsElapsed = RTTimeNanoTS() - nsStart;
+    RTTESTI_CHECK_RETV(cSamplesParent);
+
+    RTTestValueF(hTest, cNsElapsed * 1000 / cSamplesParent, RTTESTUNIT_NONE,
+                 "Write + mix + read, %RU32Hz -> %RU32Hz, ps/sample", uHzChild, uHzParent);
+
+    AudioMixBufDestroy(&parent);
+    AudioMixBufDestroy(&child);
+}
+
+
+int main(int argc, char **argv)
+{
+    RTR3InitExe(argc, &argv, 0);
+
+    RTTEST hTest;
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstAudioMixBufferBench", &hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(hTest);
+
+    tstRoundTrip(hTest, 2);
+    tstRoundTrip(hTest, 1);
+
+    static uint32_t const s_aRates[][2] =
+    {
+        { 22050, 44100 }, { 44100, 48000 }, { 48000, 44100 }, { 8000, 48000 }, { 12345, 44100 }, { 44101, 48000 }
+    };
+    for (unsigned i = 0; i < RT_ELEMENTS(s_aRates); i++)
+        tstRateConstant(hTest, s_aRates[i][0], s_aRates[i][1]);
+
+    for (uint32_t i = 0; i < RT_ELEMENTS(g_ai16Src); i++)
+        g_ai16Src[i] = (int16_t)RTRandU32();
+#ifdef RT_ARCH_AMD64
+    g_ai16Src[0] = INT16_MIN;
+    g_ai16Src[1] = INT16_MAX;
+    tstSse2ConvFrom(hTest, 2, 255, 255);
+    tstSse2ConvFrom(hTest, 2, 200, 128);
+    tstSse2ConvFrom(hTest, 2, 1, 254);
+    tstSse2ConvFrom(hTest, 1, 255, 255);
+    tstSse2ConvFrom(hTest, 1, 200, 100);
+    tstSse2ConvTo(hTest);
+    tstSse2Blend(hTest);
+#endif
+
+    RTTestSub(hTest, "Benchmark");
+    tstBenchConversion(hTest, 2, 255);
+    tstBenchConversion(hTest, 2, 200);
+    tstBenchConversion(hTest, 1, 255);
+    tstBenchMix(hTest, 48000, 48000);
+    tstBenchMix(hTest, 44100, 48000);
+    tstBenchMix(hTest, 22050, 44100);
+
+    return RTTestSummaryAndDestroy(hTest);
+}
+
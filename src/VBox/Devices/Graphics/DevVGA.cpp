@@ -121,6 +121,11 @@
 # include <iprt/cdefs.h>
 # include <iprt/mem.h>
 # include <iprt/ctype.h>
+# ifdef RT_ARCH_AMD64
+#  include <emmintrin.h>
+/** SSE2 is part of the AMD64 baseline, use it for the scanline converters. */
+#  define VGA_WITH_SSE2
+# endif
 #endif /* IN_RING3 */
 #include <iprt/assert.h>
 #include <iprt/asm.h>
@@ -1544,6 +1549,40 @@ static inline unsigned int rgb_to_pixel32(unsigned int r, unsigned int g, unsign
     return (r << 16) | (g << 8) | b;
 }
 
+#ifdef VGA_WITH_SSE2
+/**
+ * Converts 8 15 or 16 bpp pixels to 32 bpp, same result as rgb_to_pixel32.
+ *
+ * @param   pbDst       Where to store the 32 bytes of output.
+ * @param   pbSrc       The 16 bytes of input.
+ * @param   cShiftR     Right shift moving red into the top of the low byte.
+ * @param   cShiftG     Right shift moving green into the top of the low byte.
+ * @param   fMaskG      The bits of green which are used.
+ */
+DECLINLINE(void) vga_sse2_draw8_15or16_32(uint8_t *pbDst, const uint8_t *pbSrc, int cShiftR, int cShiftG, int fMaskG)
+{
+    __m128i px = _mm_loadu_si128((const __m128i *)pbSrc);
+    __m128i r  = _mm_and_si128(_mm_srl_epi16(px, _mm_cvtsi32_si128(cShiftR)), _mm_set1_epi16(0xf8));
+    __m128i g  = _mm_and_si128(_mm_srl_epi16(px, _mm_cvtsi32_si128(cShiftG)), _mm_set1_epi16((short)fMaskG));
+    __m128i b  = _mm_and_si128(_mm_slli_epi16(px, 3), _mm_set1_epi16(0xf8));
+    __m128i gb = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+    _mm_storeu_si128((__m128i *)pbDst,        _mm_unpacklo_epi16(gb, r));
+    _mm_storeu_si128((__m128i *)(pbDst + 16), _mm_unpackhi_epi16(gb, r));
+}
+
+/**
+ * Converts 4 24 bpp pixels to 32 bpp, reading 16 bytes.
+ */
+DECLINLINE(void) vga_sse2_draw4_24_32(uint8_t *pbDst, const uint8_t *pbSrc)
+{
+    __m128i px  = _mm_loadu_si128((const __m128i *)pbSrc);
+    __m128i p01 = _mm_unpacklo_epi32(px, _mm_srli_si128(px, 3));
+    __m128i p23 = _mm_unpacklo_epi32(_mm_srli_si128(px, 6), _mm_srli_si128(px, 9));
+    __m128i out = _mm_and_si128(_mm_unpacklo_epi64(p01, p23), _mm_set1_epi32(0x00ffffff));
+    _mm_storeu_si128((__m128i *)pbDst, out);
+}
+#endif /* VGA_WITH_SSE2 */
+
 #define DEPTH 8
 #include "DevVGATmpl.h"
 
@@ -2148,6 +2187,89 @@ static int vga_resize_graphic(PVGASTATE pThis, int cx, int cy,
     return VINF_SUCCESS;
 }
 
+/** The number of pixels vga_draw_line_changed compares at a time. */
+#define VGA_CMP_CHUNK_PIXELS    16
+
+/**
+ * Checks whether a partial update may compare scanlines against the
+ * framebuffer, see vga_draw_line_changed.
+ *
+ * @returns true if it may.
+ * @param   pThis       VGA instance data.
+ * @param   pDrv        The display connector.
+ * @param   v           The VGA_DRAW_LINE* converter index.
+ */
+static bool vga_can_compare_lines(PVGASTATE pThis, PDMIDISPLAYCONNECTOR *pDrv, uint32_t v)
+{
+    /* Only the packed pixel converters work on arbitrary pixel ranges. */
+    if (   v != VGA_DRAW_LINE15
+        && v != VGA_DRAW_LINE16
+        && v != VGA_DRAW_LINE24
+        && v != VGA_DRAW_LINE32)
+        return false;
+    /* There must be a framebuffer copy to compare against, and nothing else drawn into it. */
+    if (   !pThis->fRenderVRAM
+        || pThis->cursor_draw_line
+        || !pDrv->pbData
+        || (   pDrv->pbData >= pThis->vram_ptrR3
+            && pDrv->pbData <  pThis->vram_ptrR3 + pThis->vram_size))
+        return false;
+    return pDrv->cBits == 8 || pDrv->cBits == 15 || pDrv->cBits == 16 || pDrv->cBits == 32;
+}
+
+/**
+ * Draws a scanline of a partial update, only touching the pixels which
+ * actually changed.
+ *
+ * Dirty tracking is page granular (a write to an LFB page unprotects it till
+ * the next refresh), so a dirty page says little about which of the pixels on
+ * the scanlines it covers changed.  The framebuffer still holds the result of
+ * the last refresh though, so convert and compare VGA_CMP_CHUNK_PIXELS at a
+ * time and only copy and report the changed span.
+ *
+ * @returns true if anything on the scanline changed.
+ * @param   pThis           VGA instance data.
+ * @param   pfnDrawLine     The scanline converter.
+ * @param   fCopy           Whether the converter is a plain copy.
+ * @param   pbDst           The framebuffer scanline.
+ * @param   pbSrc           The VRAM scanline.
+ * @param   width           The number of pixels.
+ * @param   cbSrcPixel      Bytes per VRAM pixel.
+ * @param   cbDstPixel      Bytes per framebuffer pixel.
+ * @param   px_left         Where to merge in the left edge of the change.
+ * @param   px_right        Where to merge in the right edge of the change (exclusive).
+ */
+static bool vga_draw_line_changed(PVGASTATE pThis, vga_draw_line_func *pfnDrawLine, bool fCopy,
+                                  uint8_t *pbDst, const uint8_t *pbSrc, int width,
+                                  int cbSrcPixel, int cbDstPixel, int *px_left, int *px_right)
+{
+    uint8_t abTmp[VGA_CMP_CHUNK_PIXELS * 4];
+    int x_first = -1;
+    int x_end = -1;
+    for (int x = 0; x < width; x += VGA_CMP_CHUNK_PIXELS)
+    {
+        int const cx = RT_MIN(VGA_CMP_CHUNK_PIXELS, width - x);
+        const uint8_t *pbNew = pbSrc + x * cbSrcPixel;
+        if (!fCopy)
+        {
+            pfnDrawLine(pThis, abTmp, pbNew, cx);
+            pbNew = abTmp;
+        }
+        if (memcmp(pbDst + x * cbDstPixel, pbNew, cx * cbDstPixel))
+        {
+            memcpy(pbDst + x * cbDstPixel, pbNew, cx * cbDstPixel);
+            if (x_first < 0)
+                x_first = x;
+            x_end = x + cx;
+        }
+    }
+    if (x_first < 0)
+        return false;
+    *px_left  = RT_MIN(*px_left, x_first);
+    *px_right = RT_MAX(*px_right, x_end);
+    return true;
+}
+
 #ifdef VBOX_WITH_VMSVGA
 int vgaR3UpdateDisplay(VGAState *s, unsigned xStart, unsigned yStart, unsigned cx, unsigned cy)
 {
@@ -2279,6 +2401,15 @@ static int vmsvga_draw_graphic(PVGASTATE pThis, bool full_update, bool fFailOnRe
     d = pDrv->pbData;
     linesize = pDrv->cbScanline;
 
+    /* Partial updates only redraw and report the pixels which changed. */
+    bool const fCompare    = !full_update && vga_can_compare_lines(pThis, pDrv, v);
+    bool const fCopy       =    (v == VGA_DRAW_LINE15 && pDrv->cBits == 15)
+                             || (v == VGA_DRAW_LINE16 && pDrv->cBits == 16)
+                             || (v == VGA_DRAW_LINE32 && pDrv->cBits == 32);
+    int  const cbDstPixel  = (pDrv->cBits + 7) / 8;
+    int x_left  = fCompare ? disp_width : 0;
+    int x_right = fCompare ? 0 : disp_width;
+
     for(y = 0; y < height; y++)
     {
         addr = addr1 + y * bwidth;
@@ -2293,24 +2424,35 @@ static int vmsvga_draw_graphic(PVGASTATE pThis, bool full_update, bool fFailOnRe
         update |= (pThis->invalidated_y_table[y >> 5] >> (y & 0x1f)) & 1;
         if (update)
         {
-            if (y_start < 0)
-                y_start = y;
             if (page0 < page_min)
                 page_min = page0;
             if (page1 > page_max)
                 page_max = page1;
-            if (pThis->fRenderVRAM)
+            if (fCompare)
+                update = vga_draw_line_changed(pThis, vga_draw_line, fCopy, d, pThis->CTX_SUFF(vram_ptr) + addr, width,
+                                               bits / 8, cbDstPixel, &x_left, &x_right);
+            else if (pThis->fRenderVRAM)
                 vga_draw_line(pThis, d, pThis->CTX_SUFF(vram_ptr) + addr, width);
             if (pThis->cursor_draw_line)
                 pThis->cursor_draw_line(pThis, d, y);
+        }
+        if (update)
+        {
+            if (y_start < 0)
+                y_start = y;
         } else
         {
             if (y_start >= 0)
             {
                 /* flush to display */
-                Log(("Flush to display (%d,%d)(%d,%d)\n", 0, y_start, disp_width, y - y_start));
-                pDrv->pfnUpdateRect(pDrv, 0, y_start, disp_width, y - y_start);
+                Log(("Flush to display (%d,%d)(%d,%d)\n", x_left, y_start, x_right - x_left, y - y_start));
+                pDrv->pfnUpdateRect(pDrv, x_left, y_start, x_right - x_left, y - y_start);
                 y_start = -1;
+                if (fCompare)
+                {
+                    x_left  = disp_width;
+                    x_right = 0;
+                }
             }
         }
         d += linesize;
@@ -2318,8 +2460,8 @@ static int vmsvga_draw_graphic(PVGASTATE pThis, bool full_update, bool fFailOnRe
     if (y_start >= 0)
     {
         /* flush to display */
-        Log(("Flush to display (%d,%d)(%d,%d)\n", 0, y_start, disp_width, y - y_start));
-        pDrv->pfnUpdateRect(pDrv, 0, y_start, disp_width, y - y_start);
+        Log(("Flush to display (%d,%d)(%d,%d)\n", x_left, y_start, x_right - x_left, y - y_start));
+        pDrv->pfnUpdateRect(pDrv, x_left, y_start, x_right - x_left, y - y_start);
     }
     /* reset modified pages */
     if (page_max != -1 && reset_dirty)
@@ -2458,6 +2600,15 @@ static int vga_draw_graphic(PVGASTATE pThis, bool full_update, bool fFailOnResiz
     d = pDrv->pbData;
     linesize = pDrv->cbScanline;
 
+    /* Partial updates only redraw and report the pixels which changed. */
+    bool const fCompare    = !full_update && vga_can_compare_lines(pThis, pDrv, v);
+    bool const fCopy       =    (v == VGA_DRAW_LINE15 && pDrv->cBits == 15)
+                             || (v == VGA_DRAW_LINE16 && pDrv->cBits == 16)
+                             || (v == VGA_DRAW_LINE32 && pDrv->cBits == 32);
+    int  const cbDstPixel  = (pDrv->cBits + 7) / 8;
+    int x_left  = fCompare ? disp_width : 0;
+    int x_right = fCompare ? 0 : disp_width;
+
     y1 = 0;
     y2 = pThis->cr[0x09] & 0x1F;    /* starting row scan count */
     for(y = 0; y < height; y++) {
@@ -2481,21 +2632,30 @@ static int vga_draw_graphic(PVGASTATE pThis, bool full_update, bool fFailOnResiz
         /* explicit invalidation for the hardware cursor */
         update |= (pThis->invalidated_y_table[y >> 5] >> (y & 0x1f)) & 1;
         if (update) {
-            if (y_start < 0)
-                y_start = y;
             if (page0 < page_min)
                 page_min = page0;
             if (page1 > page_max)
                 page_max = page1;
-            if (pThis->fRenderVRAM)
+            if (fCompare)
+                update = vga_draw_line_changed(pThis, vga_draw_line, fCopy, d, pThis->CTX_SUFF(vram_ptr) + addr, width,
+                                               bits / 8, cbDstPixel, &x_left, &x_right);
+            else if (pThis->fRenderVRAM)
                 vga_draw_line(pThis, d, pThis->CTX_SUFF(vram_ptr) + addr, width);
             if (pThis->cursor_draw_line)
                 pThis->cursor_draw_line(pThis, d, y);
+        }
+        if (update) {
+            if (y_start < 0)
+                y_start = y;
         } else {
             if (y_start >= 0) {
                 /* flush to display */
-                pDrv->pfnUpdateRect(pDrv, 0, y_start, disp_width, y - y_start);
+                pDrv->pfnUpdateRect(pDrv, x_left, y_start, x_right - x_left, y - y_start);
                 y_start = -1;
+                if (fCompare) {
+                    x_left  = disp_width;
+                    x_right = 0;
+                }
             }
         }
         if (!multi_run) {
@@ -2518,7 +2678,7 @@ static int vga_draw_graphic(PVGASTATE pThis, bool full_update, bool fFailOnResiz
     }
     if (y_start >= 0) {
         /* flush to display */
-        pDrv->pfnUpdateRect(pDrv, 0, y_start, disp_width, y - y_start);
+        pDrv->pfnUpdateRect(pDrv, x_left, y_start, x_right - x_left, y - y_start);
     }
     /* reset modified pages */
     if (page_max != -1 && reset_dirty) {
@@ -4659,10 +4819,11 @@ static DECLCALLBACK(int) vgaPortUpdateDisplay(PPDMIDISPLAYPORT pInterface)
 #ifndef VBOX_WITH_HGSMI
     /* This should be called only in non VBVA mode. */
 #else
-    if (VBVAUpdateDisplay (pThis) == VINF_SUCCESS)
+    rc = VBVAUpdateDisplay (pThis);
+    if (rc == VINF_SUCCESS || rc == VINF_TRY_AGAIN)
     {
         PDMCritSectLeave(&pThis->CritSect);
-        return VINF_SUCCESS;
+        return rc;
     }
 #endif /* VBOX_WITH_HGSMI */
 
@@ -6021,6 +6182,9 @@ static DECLCALLBACK(int)   vgaR3Construct(PPDMDEVINS pDevIns, int iInstance, PCF
                                           "CustomVideoMode16\0"
                                           "MaxBiosXRes\0"
                                           "MaxBiosYRes\0"
+#ifdef VBOX_WITH_HGSMI
+                                          "VBVAAsyncFlush\0"
+#endif
 #ifdef VBOX_WITH_VMSVGA
                                           "VMSVGAEnabled\0"
 #endif
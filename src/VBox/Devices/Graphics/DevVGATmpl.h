@@ -388,6 +388,11 @@ static void RT_CONCAT(vga_draw_line15_, DEPTH)(VGAState *s1, uint8_t *d,
     uint32_t v, r, g, b;
 
     w = width;
+#if DEPTH == 32 && defined(VGA_WITH_SSE2)
+    for (; w >= 8; w -= 8, s += 16, d += 32)
+        vga_sse2_draw8_15or16_32(d, s, 7, 2, 0xf8);
+    if (w)
+#endif
     do {
         v = s[0] | (s[1] << 8);
         r = (v >> 7) & 0xf8;
@@ -414,6 +419,11 @@ static void RT_CONCAT(vga_draw_line16_, DEPTH)(VGAState *s1, uint8_t *d,
     uint32_t v, r, g, b;
 
     w = width;
+#if DEPTH == 32 && defined(VGA_WITH_SSE2)
+    for (; w >= 8; w -= 8, s += 16, d += 32)
+        vga_sse2_draw8_15or16_32(d, s, 8, 3, 0xfc);
+    if (w)
+#endif
     do {
         v = s[0] | (s[1] << 8);
         r = (v >> 8) & 0xf8;
@@ -438,6 +448,12 @@ static void RT_CONCAT(vga_draw_line24_, DEPTH)(VGAState *s1, uint8_t *d,
     NOREF(s1);
 
     w = width;
+#if DEPTH == 32 && defined(VGA_WITH_SSE2) && !defined(TARGET_WORDS_BIGENDIAN)
+    /* Reads 16 bytes for 4 pixels, so keep 2 more pixels in reserve. */
+    for (; w >= 6; w -= 4, s += 12, d += 16)
+        vga_sse2_draw4_24_32(d, s);
+    if (w)
+#endif
     do {
 #if defined(TARGET_WORDS_BIGENDIAN)
         r = s[0];
@@ -31,9 +31,8 @@
 #include <iprt/asm.h>
 #include <iprt/string.h>
 #include <iprt/param.h>
-#ifdef VBOX_WITH_VIDEOHWACCEL
 #include <iprt/semaphore.h>
-#endif
+#include <iprt/time.h>
 
 #include "DevVGA.h"
 
@@ -102,6 +101,26 @@ typedef struct VBVACONTEXT
     uint32_t xCursor;
     uint32_t yCursor;
     VBVAMODEHINT aModeHints[VBOX_VIDEO_MAX_SCREENS];
+
+    /** Whether the periodic ring processing is done by the flush thread
+     * ("VBVAAsyncFlush" config value). */
+    bool fAsyncFlush;
+    /** Set when the flush thread has to drain the rings. */
+    bool volatile fFlushPending;
+    /** When fFlushPending was set (RTTimeNanoTS). */
+    uint64_t nsFlushRequested;
+    /** The flush thread. */
+    PPDMTHREAD pFlushThread;
+    /** Wakes up the flush thread. */
+    RTSEMEVENT hFlushEvent;
+    /** Flushes done on the calling thread. */
+    STAMCOUNTER StatFlushSync;
+    /** Flushes handed to the flush thread. */
+    STAMCOUNTER StatFlushAsync;
+    /** Flush requests merged into one already pending. */
+    STAMCOUNTER StatFlushCoalesced;
+    /** Time from requesting an asynchronous flush till the rings were drained. */
+    STAMPROFILE StatFlushLatency;
 } VBVACONTEXT;
 
 
@@ -546,6 +565,129 @@ static int vbvaFlush(PVGASTATE pVGAState, VBVACONTEXT *pCtx)
     return rc;
 }
 
+/** Checks whether a guest ring is filled to the point where processing must
+ * not be deferred to the flush thread.
+ * The rings are read without synchronizing with the guest, this is a hint only.
+ */
+static bool vbvaIsAboveWatermark(VBVACONTEXT *pCtx)
+{
+    unsigned uScreenId;
+    for (uScreenId = 0; uScreenId < pCtx->cViews; uScreenId++)
+    {
+        VBVADATA *pVBVAData = &pCtx->aViews[uScreenId].vbva;
+        VBVABUFFER *pVBVA = pVBVAData->guest.pVBVA;
+        if (pVBVA)
+        {
+            uint32_t const cRecords = (ASMAtomicUoReadU32(&pVBVA->indexRecordFree) + VBVA_MAX_RECORDS - pVBVAData->indexRecordFirst)
+                                    % VBVA_MAX_RECORDS;
+            if (cRecords >= VBVA_MAX_RECORDS / 2)
+                return true;
+
+            uint32_t const off32Free = ASMAtomicUoReadU32(&pVBVA->off32Free);
+            if (   pVBVAData->cbData
+                && off32Free < pVBVAData->cbData
+                && (off32Free + pVBVAData->cbData - pVBVAData->off32Data) % pVBVAData->cbData >= pVBVAData->cbData / 2)
+                return true;
+        }
+    }
+    return false;
+}
+
+/** Processes the guest rings on the calling thread, taking care of a pending
+ * asynchronous flush as well.  The caller owns the VGA lock.
+ */
+static int vbvaFlushSync(PVGASTATE pVGAState, VBVACONTEXT *pCtx)
+{
+    STAM_REL_COUNTER_INC(&pCtx->StatFlushSync);
+    if (ASMAtomicXchgBool(&pCtx->fFlushPending, false))
+        STAM_REL_PROFILE_ADD_PERIOD(&pCtx->StatFlushLatency, RTTimeNanoTS() - pCtx->nsFlushRequested);
+    return vbvaFlush(pVGAState, pCtx);
+}
+
+/** Hands the processing of the guest rings to the flush thread.  Requests
+ * arriving before the thread got to it are merged.  The caller owns the VGA lock.
+ */
+static void vbvaFlushAsync(PVGASTATE pVGAState, VBVACONTEXT *pCtx)
+{
+    NOREF(pVGAState);
+    if (!ASMAtomicReadBool(&pCtx->fFlushPending))
+    {
+        STAM_REL_COUNTER_INC(&pCtx->StatFlushAsync);
+        pCtx->nsFlushRequested = RTTimeNanoTS();
+        ASMAtomicWriteBool(&pCtx->fFlushPending, true);
+        int rc = RTSemEventSignal(pCtx->hFlushEvent);
+        AssertRC(rc);
+    }
+    else
+        STAM_REL_COUNTER_INC(&pCtx->StatFlushCoalesced);
+}
+
+/**
+ * The VBVA flush thread, drains the guest rings so the EMT running the display
+ * refresh does not have to.
+ *
+ * HGSMI commands written to VGA_PORT_HGSMI_GUEST are still processed on the
+ * EMT doing the OUT.  The guest drivers read the results (VBVA_QUERY_CONF32,
+ * VBVA_ENABLE, VBVA_QUERY_MODE_HINTS, ...) from the command buffer as soon as
+ * the OUT returns, and VBVA_FLUSH must free ring space before it does, so
+ * completing them here would need an asynchronous completion protocol the
+ * existing guest additions don't have.
+ *
+ * @returns VBox status code.
+ * @param   pDevIns     The VGA device instance.
+ * @param   pThread     The thread.
+ */
+static DECLCALLBACK(int) vbvaFlushThread(PPDMDEVINS pDevIns, PPDMTHREAD pThread)
+{
+    PVGASTATE    pVGAState = (PVGASTATE)pThread->pvUser;
+    VBVACONTEXT *pCtx      = (VBVACONTEXT *)HGSMIContext(pVGAState->pHGSMI);
+    NOREF(pDevIns);
+
+    if (pThread->enmState == PDMTHREADSTATE_INITIALIZING)
+        return VINF_SUCCESS;
+
+    while (pThread->enmState == PDMTHREADSTATE_RUNNING)
+    {
+        if (!ASMAtomicReadBool(&pCtx->fFlushPending))
+        {
+            int rc = RTSemEventWait(pCtx->hFlushEvent, RT_INDEFINITE_WAIT);
+            AssertLogRelMsgReturn(RT_SUCCESS(rc) || rc == VERR_INTERRUPTED, ("%Rrc\n", rc), rc);
+            continue;
+        }
+
+        PDMCritSectEnter(&pVGAState->CritSect, VERR_SEM_BUSY);
+        /* Someone may have done a synchronous flush meanwhile. */
+        if (ASMAtomicXchgBool(&pCtx->fFlushPending, false))
+        {
+            if (!pCtx->fPaused)
+                vbvaFlush(pVGAState, pCtx);
+            STAM_REL_PROFILE_ADD_PERIOD(&pCtx->StatFlushLatency, RTTimeNanoTS() - pCtx->nsFlushRequested);
+
+            /* The display refresh left ending the update sequence to us, as
+             * that must come after the updates reported above. */
+            pVGAState->pDrv->pfnVBVAUpdateComplete(pVGAState->pDrv);
+        }
+        PDMCritSectLeave(&pVGAState->CritSect);
+    }
+
+    return VINF_SUCCESS;
+}
+
+/**
+ * Unblocks the VBVA flush thread so it can respond to a state change.
+ *
+ * @returns VBox status code.
+ * @param   pDevIns     The VGA device instance.
+ * @param   pThread     The thread.
+ */
+static DECLCALLBACK(int) vbvaFlushThreadWakeUp(PPDMDEVINS pDevIns, PPDMTHREAD pThread)
+{
+    PVGASTATE    pVGAState = (PVGASTATE)pThread->pvUser;
+    VBVACONTEXT *pCtx      = (VBVACONTEXT *)HGSMIContext(pVGAState->pHGSMI);
+    NOREF(pDevIns);
+    return RTSemEventSignal(pCtx->hFlushEvent);
+}
+
 static int vbvaResize(PVGASTATE pVGAState, VBVAVIEW *pView, const VBVAINFOSCREEN *pNewScreen)
 {
     /* Callers ensure that pNewScreen contains valid data. */
@@ -2567,8 +2709,10 @@ static DECLCALLBACK(int) vbvaChannelHandler(void *pvHandler, uint16_t u16Channel
                 break;
             }
 
+            /* The guest only asks when it ran out of ring space and
+             * expects it to be available on return, so this is never deferred. */
             // const VBVAFLUSH *pVbvaFlush = (VBVAFLUSH *)pvBuffer;
-            rc = vbvaFlush(pVGAState, pCtx);
+            rc = vbvaFlushSync(pVGAState, pCtx);
         } break;
 
         case VBVA_INFO_SCREEN:
@@ -2814,7 +2958,17 @@ int VBVAUpdateDisplay (PVGASTATE pVGAState)
     {
         if (!pCtx->fPaused)
         {
-            rc = vbvaFlush (pVGAState, pCtx);
+            /* Leave the ring processing to the flush thread unless the guest
+             * is about to run out of space.  VINF_TRY_AGAIN tells the display
+             * that the thread also completes the update sequence. */
+            if (   pCtx->fAsyncFlush
+                && !vbvaIsAboveWatermark(pCtx))
+            {
+                vbvaFlushAsync(pVGAState, pCtx);
+                rc = VINF_TRY_AGAIN;
+            }
+            else
+                rc = vbvaFlushSync(pVGAState, pCtx);
 
             if (RT_SUCCESS (rc))
             {
@@ -2928,6 +3082,27 @@ int VBVAInit (PVGASTATE pVGAState)
              pCtx->fPaused = true;
              memset(pCtx->aModeHints, ~0, sizeof(pCtx->aModeHints));
              pVGAState->fHostCursorCapabilities = 0;
+
+             pCtx->hFlushEvent = NIL_RTSEMEVENT;
+             rc = CFGMR3QueryBoolDef(pDevIns->pCfg, "VBVAAsyncFlush", &pCtx->fAsyncFlush, true);
+             AssertLogRelRCReturn(rc, rc);
+             if (pCtx->fAsyncFlush)
+             {
+                 rc = RTSemEventCreate(&pCtx->hFlushEvent);
+                 AssertLogRelRCReturn(rc, rc);
+                 rc = PDMDevHlpThreadCreate(pDevIns, &pCtx->pFlushThread, pVGAState, vbvaFlushThread, vbvaFlushThreadWakeUp,
+                                            0, RTTHREADTYPE_IO, "VBVA");
+                 AssertLogRelRCReturn(rc, rc);
+             }
+
+             PDMDevHlpSTAMRegister(pDevIns, &pCtx->StatFlushSync,      STAMTYPE_COUNTER, "/Devices/VGA/VBVA/FlushSync",
+                                   STAMUNIT_OCCURENCES, "Ring flushes done on the requesting thread.");
+             PDMDevHlpSTAMRegister(pDevIns, &pCtx->StatFlushAsync,     STAMTYPE_COUNTER, "/Devices/VGA/VBVA/FlushAsync",
+                                   STAMUNIT_OCCURENCES, "Ring flushes handed to the flush thread.");
+             PDMDevHlpSTAMRegister(pDevIns, &pCtx->StatFlushCoalesced, STAMTYPE_COUNTER, "/Devices/VGA/VBVA/FlushCoalesced",
+                                   STAMUNIT_OCCURENCES, "Flush requests merged into a pending one.");
+             PDMDevHlpSTAMRegister(pDevIns, &pCtx->StatFlushLatency,   STAMTYPE_PROFILE, "/Devices/VGA/VBVA/FlushLatency",
+                                   STAMUNIT_NS_PER_CALL, "Time from requesting an asynchronous flush till it was done.");
          }
      }
 
@@ -2937,10 +3112,25 @@ int VBVAInit (PVGASTATE pVGAState)
 
 void VBVADestroy (PVGASTATE pVGAState)
 {
+    if (!pVGAState->pHGSMI)
+        return;
+
     VBVACONTEXT *pCtx = (VBVACONTEXT *)HGSMIContext (pVGAState->pHGSMI);
 
     if (pCtx)
     {
+        if (pCtx->pFlushThread)
+        {
+            int rcThread;
+            PDMR3ThreadDestroy(pCtx->pFlushThread, &rcThread);
+            pCtx->pFlushThread = NULL;
+        }
+        if (pCtx->hFlushEvent != NIL_RTSEMEVENT)
+        {
+            RTSemEventDestroy(pCtx->hFlushEvent);
+            pCtx->hFlushEvent = NIL_RTSEMEVENT;
+        }
+
         pCtx->mouseShapeInfo.fSet = false;
         RTMemFree(pCtx->mouseShapeInfo.pu8Shape);
         pCtx->mouseShapeInfo.pu8Shape = NULL;
@@ -7600,8 +7600,9 @@ static DECLCALLBACK(int) e1kR3Construct(PPDMDEVINS pDevIns, int iInstance, PCFGM
     pThis->pTxQueueR0 = PDMQueueR0Ptr(pThis->pTxQueueR3);
     pThis->pTxQueueRC = PDMQueueRCPtr(pThis->pTxQueueR3);
 
-    /* Create the RX notifier signaller. */
-    rc = PDMDevHlpQueueCreate(pDevIns, sizeof(PDMQUEUEITEMCORE), 1, 0,
+    /* Create the RX notifier signaller.  The consumer only signals a
+       semaphore, so it doesn't need to wait for the EMT to get around to it. */
+    rc = PDMDevHlpQueueCreate(pDevIns, sizeof(PDMQUEUEITEMCORE), 1, PDMQUEUE_INTERVAL_WORKER_THREAD,
                               e1kCanRxQueueConsumer, true, "E1000-Rcv", &pThis->pCanRxQueueR3);
     if (RT_FAILURE(rc))
         return rc;
@@ -1726,6 +1726,111 @@ static int vmmdevReqHandler_HGCMCall(PVMMDEV pThis, VMMDevRequestHeader *pReqHdr
     return VERR_NOT_SUPPORTED;
 }
 
+/**
+ * Handles VMMDevReq_HGCMCallBatch.
+ *
+ * The embedded calls are submitted one by one and complete independently.
+ *
+ * @returns VBox status code that the guest should see.
+ * @param   pThis           The VMMDev instance data.
+ * @param   pReqHdr         The header of the request to handle.
+ * @param   GCPhysReqHdr    The guest physical address of the request header.
+ */
+static int vmmdevReqHandler_HGCMCallBatch(PVMMDEV pThis, VMMDevRequestHeader *pReqHdr, RTGCPHYS GCPhysReqHdr)
+{
+    VMMDevHGCMCallBatch *pReq = (VMMDevHGCMCallBatch *)pReqHdr;
+    AssertMsgReturn(pReq->header.size >= sizeof(*pReq), ("%u\n", pReq->header.size), VERR_INVALID_PARAMETER);
+
+    if (!pThis->pHGCMDrv)
+    {
+        Log(("VMMDevReq_HGCMCallBatch: HGCM Connector is NULL!\n"));
+        return VERR_NOT_SUPPORTED;
+    }
+
+    uint32_t const cbReq  = pReq->header.size;
+    uint32_t const cCalls = pReq->cCalls;
+    if (   cCalls == 0
+        || cCalls > VMMDEV_HGCM_BATCH_MAX_CALLS
+        || pReq->u32Reserved != 0
+        || cbReq < RT_UOFFSETOF(VMMDevHGCMCallBatch, aoffCalls) + cCalls * sizeof(pReq->aoffCalls[0]))
+    {
+        LogRelMax(50, ("VMMDev: Invalid HGCM call batch: cCalls=%u size=%u\n", cCalls, cbReq));
+        return VERR_INVALID_PARAMETER;
+    }
+    uint32_t const offFirstCall = RT_UOFFSETOF(VMMDevHGCMCallBatch, aoffCalls) + cCalls * sizeof(pReq->aoffCalls[0]);
+    if (cbReq < offFirstCall + sizeof(VMMDevHGCMCall))
+    {
+        LogRelMax(50, ("VMMDev: Invalid HGCM call batch: no room for calls, cCalls=%u size=%u\n", cCalls, cbReq));
+        return VERR_INVALID_PARAMETER;
+    }
+
+    /*
+     * Validate all the calls before submitting any of them.  The calls must
+     * not overlap, otherwise one call could be submitted twice under the same
+     * address and cancellation and completion would be ambiguous.
+     */
+    uint32_t i;
+    for (i = 0; i < cCalls; i++)
+    {
+        uint32_t const off = pReq->aoffCalls[i];
+        if (   off < offFirstCall
+            || (off & 3)
+            || off > cbReq - sizeof(VMMDevHGCMCall))
+        {
+            LogRelMax(50, ("VMMDev: Invalid HGCM call batch: call #%u at %#x, size=%u\n", i, off, cbReq));
+            return VERR_INVALID_PARAMETER;
+        }
+
+        VMMDevHGCMCall *pCall = (VMMDevHGCMCall *)((uint8_t *)pReq + off);
+        if (   pCall->header.header.size < sizeof(VMMDevHGCMCall)
+            || pCall->header.header.size > cbReq - off
+            || pCall->header.header.version != VMMDEV_REQUEST_HEADER_VERSION
+#ifdef VBOX_WITH_64_BITS_GUESTS
+            || (   pCall->header.header.requestType != VMMDevReq_HGCMCall32
+                && pCall->header.header.requestType != VMMDevReq_HGCMCall64)
+#else
+            || pCall->header.header.requestType != VMMDevReq_HGCMCall
+#endif
+           )
+        {
+            LogRelMax(50, ("VMMDev: Invalid HGCM call batch: call #%u at %#x has type %d, size %u\n",
+                           i, off, pCall->header.header.requestType, pCall->header.header.size));
+            return VERR_INVALID_PARAMETER;
+        }
+
+        for (uint32_t j = 0; j < i; j++)
+        {
+            uint32_t const offOther = pReq->aoffCalls[j];
+            uint32_t const cbOther  = ((VMMDevHGCMCall *)((uint8_t *)pReq + offOther))->header.header.size;
+            if (   off < offOther + cbOther
+                && offOther < off + pCall->header.header.size)
+            {
+                LogRelMax(50, ("VMMDev: Invalid HGCM call batch: call #%u at %#x overlaps call #%u at %#x\n",
+                               i, off, j, offOther));
+                return VERR_INVALID_PARAMETER;
+            }
+        }
+    }
+
+    /*
+     * Submit them.  The host copy of the batch including the status of each
+     * call is written back before any completion can touch the calls.
+     */
+    for (i = 0; i < cCalls; i++)
+    {
+        uint32_t const  off   = pReq->aoffCalls[i];
+        VMMDevHGCMCall *pCall = (VMMDevHGCMCall *)((uint8_t *)pReq + off);
+#ifdef VBOX_WITH_64_BITS_GUESTS
+        bool f64Bits = (pCall->header.header.requestType == VMMDevReq_HGCMCall64);
+#else
+        bool f64Bits = false;
+#endif
+        pCall->header.header.rc = vmmdevHGCMCall(pThis, pCall, pCall->header.header.size, GCPhysReqHdr + off, f64Bits);
+    }
+
+    return VINF_SUCCESS;
+}
+
 /**
  * Handles VMMDevReq_HGCMCancel.
  *
@@ -2634,6 +2739,11 @@ static int vmmdevReqDispatcher(PVMMDEV pThis, VMMDevRequestHeader *pReqHdr, RTGC
         case VMMDevReq_HGCMCancel2:
             pReqHdr->rc = vmmdevReqHandler_HGCMCancel2(pThis, pReqHdr);
             break;
+
+        case VMMDevReq_HGCMCallBatch:
+            pReqHdr->rc = vmmdevReqHandler_HGCMCallBatch(pThis, pReqHdr, GCPhysReqHdr);
+            *pfDelayedUnlock = true;
+            break;
 #endif /* VBOX_WITH_HGCM */
 
         case VMMDevReq_VideoAccelEnable:
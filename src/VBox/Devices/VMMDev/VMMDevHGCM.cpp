@@ -77,6 +77,36 @@ typedef struct VBOXHGCMLINPTR
 
 } VBOXHGCMLINPTR;
 
+/**
+ * Guest pages of a page list parameter mapped for the duration of a call.
+ *
+ * The structure lives in the command memory block, the mapping locks follow
+ * the page pointer array.
+ */
+typedef struct VBOXHGCMPAGEMAP
+{
+    /** Next mapping of the command. */
+    struct VBOXHGCMPAGEMAP *pNext;
+
+    /** Heap copy of the buffer, used instead if the pages could not be mapped. */
+    void *pvBounce;
+
+    /** Pointer to the mapping locks. */
+    PPGMPAGEMAPLOCK paLocks;
+
+    /** Number of mapping locks held. */
+    uint32_t cLocks;
+
+    /** The descriptor passed to the service. */
+    VBOXHGCMSVCPARMPAGES Pages;
+
+    /** The page mappings, VBOXHGCMSVCPARMPAGES::papvPages points here. */
+    void *apvPages[1];
+} VBOXHGCMPAGEMAP;
+
+/** Page lists smaller than this are copied, mapping them costs more than the copy. */
+#define VMMDEV_HGCM_PAGE_MAP_MIN    PAGE_SIZE
+
 struct VBOXHGCMCMD
 {
     /** Active commands, list is protected by critsectHGCMCmdList. */
@@ -116,6 +146,9 @@ struct VBOXHGCMCMD
 
     /** Pointer to descriptions of linear pointers.  */
     VBOXHGCMLINPTR *paLinPtrs;
+
+    /** Mapped page list parameters, in the same memory block. */
+    VBOXHGCMPAGEMAP *pPageMaps;
 };
 
 
@@ -472,6 +505,162 @@ static int vmmdevHGCMPageListWrite(PPDMDEVINSR3 pDevIns, const HGCMPageListInfo
     return rc;
 }
 
+/**
+ * Returns the page list info of a page list parameter, NULL if it is not
+ * entirely within the request.
+ */
+static const HGCMPageListInfo *vmmdevHGCMPageListInfoGet(const VMMDevHGCMCall *pHGCMCall, uint32_t cbHGCMCall, uint32_t offPageListInfo)
+{
+    if (   cbHGCMCall < sizeof (HGCMPageListInfo)
+        || offPageListInfo > cbHGCMCall - sizeof (HGCMPageListInfo))
+        return NULL;
+
+    const HGCMPageListInfo *pPageListInfo = (const HGCMPageListInfo *)((const uint8_t *)pHGCMCall + offPageListInfo);
+    if (   pPageListInfo->cPages == 0
+        || cbHGCMCall - offPageListInfo < RT_UOFFSETOF(HGCMPageListInfo, aPages) + pPageListInfo->cPages * sizeof (RTGCPHYS64))
+        return NULL;
+
+    return pPageListInfo;
+}
+
+/**
+ * Decides whether a page list parameter is mapped instead of copied.
+ *
+ * @returns Number of pages to map, 0 if the buffer is copied.
+ * @param   fPageLists      Whether the service takes page lists for the call,
+ *                          otherwise HGCM would copy the mapped pages anyway.
+ * @param   pPageListInfo   The guest page list.
+ * @param   cb              The buffer size.
+ */
+static uint32_t vmmdevHGCMPageListMapPages(bool fPageLists, const HGCMPageListInfo *pPageListInfo, uint32_t cb)
+{
+    if (   !fPageLists
+        || cb < VMMDEV_HGCM_PAGE_MAP_MIN
+        || pPageListInfo->offFirstPage >= PAGE_SIZE)
+        return 0;
+
+    uint64_t cPages = ((uint64_t)pPageListInfo->offFirstPage + cb + PAGE_OFFSET_MASK) >> PAGE_SHIFT;
+    if (cPages > pPageListInfo->cPages)
+        return 0;
+
+    return (uint32_t)cPages;
+}
+
+/** Size of a VBOXHGCMPAGEMAP for @a cPages pages, including the mapping locks. */
+DECLINLINE(uint32_t) vmmdevHGCMPageMapSize(uint32_t cPages)
+{
+    return RT_ALIGN_32(RT_UOFFSETOF(VBOXHGCMPAGEMAP, apvPages) + cPages * sizeof (void *), 8)
+         + cPages * sizeof (PGMPAGEMAPLOCK);
+}
+
+/** Releases the page mapping locks and the bounce buffer of a page list parameter. */
+static void vmmdevHGCMPageMapRelease(PVMMDEV pThis, VBOXHGCMPAGEMAP *pPageMap)
+{
+    while (pPageMap->cLocks > 0)
+        PDMDevHlpPhysReleasePageMappingLock(pThis->pDevIns, &pPageMap->paLocks[--pPageMap->cLocks]);
+
+    if (pPageMap->pvBounce)
+    {
+        RTMemFree(pPageMap->pvBounce);
+        pPageMap->pvBounce = NULL;
+    }
+}
+
+/** Releases all page list parameter mappings of a command before it is freed. */
+static void vmmdevHGCMPageMapsRelease(PVMMDEV pThis, PVBOXHGCMCMD pCmd)
+{
+    VBOXHGCMPAGEMAP *pPageMap = pCmd->pPageMaps;
+    while (pPageMap)
+    {
+        vmmdevHGCMPageMapRelease(pThis, pPageMap);
+        pPageMap = pPageMap->pNext;
+    }
+    pCmd->pPageMaps = NULL;
+}
+
+/**
+ * Passes a page list parameter to the service without copying it.
+ *
+ * The guest pages are mapped and stay locked until the command completes.  If
+ * a page cannot be mapped (MMIO, access handlers) the buffer is copied to the
+ * heap like before.
+ *
+ * @returns VBox status code.
+ * @param   pThis           The VMMDev instance data.
+ * @param   pCmd            The command.
+ * @param   pPageMap        The mapping structure, vmmdevHGCMPageMapSize(cPages)
+ *                          bytes in the command memory block.
+ * @param   cPages          Number of pages to map, see vmmdevHGCMPageListMapPages.
+ * @param   pPageListInfo   The guest page list.
+ * @param   cb              The buffer size.
+ * @param   pHostParm       The host parameter to set up.
+ */
+static int vmmdevHGCMPageListMap(PVMMDEV pThis, PVBOXHGCMCMD pCmd, VBOXHGCMPAGEMAP *pPageMap, uint32_t cPages,
+                                 const HGCMPageListInfo *pPageListInfo, uint32_t cb, VBOXHGCMSVCPARM *pHostParm)
+{
+    pPageMap->paLocks  = (PPGMPAGEMAPLOCK)((uint8_t *)pPageMap + vmmdevHGCMPageMapSize(cPages) - cPages * sizeof (PGMPAGEMAPLOCK));
+    pPageMap->cLocks   = 0;
+    pPageMap->pvBounce = NULL;
+
+    /* Link it first, so that everything is released with the command. */
+    pPageMap->pNext = pCmd->pPageMaps;
+    pCmd->pPageMaps = pPageMap;
+
+    /* Only take write locks if the host writes to the buffer, read locks
+       do not break page sharing. */
+    bool const fWrite = RT_BOOL(pPageListInfo->flags & VBOX_HGCM_F_PARM_DIRECTION_FROM_HOST);
+
+    int rc = VINF_SUCCESS;
+    uint32_t iPage;
+    for (iPage = 0; iPage < cPages && RT_SUCCESS(rc); iPage++)
+    {
+        RTGCPHYS GCPhys = pPageListInfo->aPages[iPage] & ~(RTGCPHYS)PAGE_OFFSET_MASK;
+        if (fWrite)
+            rc = PDMDevHlpPhysGCPhys2CCPtr(pThis->pDevIns, GCPhys, 0, &pPageMap->apvPages[iPage],
+                                           &pPageMap->paLocks[iPage]);
+        else
+            rc = PDMDevHlpPhysGCPhys2CCPtrReadOnly(pThis->pDevIns, GCPhys, 0, (void const **)&pPageMap->apvPages[iPage],
+                                                   &pPageMap->paLocks[iPage]);
+        if (RT_SUCCESS(rc))
+            pPageMap->cLocks++;
+    }
+
+    if (RT_SUCCESS(rc))
+    {
+        pPageMap->Pages.cPages       = cPages;
+        pPageMap->Pages.fFlags       = pPageListInfo->flags;
+        pPageMap->Pages.offFirstPage = pPageListInfo->offFirstPage;
+        pPageMap->Pages.u32Padding   = 0;
+        pPageMap->Pages.papvPages    = &pPageMap->apvPages[0];
+
+        pHostParm->type             = VBOX_HGCM_SVC_PARM_PAGES;
+        pHostParm->u.pages.size     = cb;
+        pHostParm->u.pages.pPages   = &pPageMap->Pages;
+        return VINF_SUCCESS;
+    }
+
+    Log(("vmmdevHGCMPageListMap: page %u (%RGp) not mappable (%Rrc), copying %u bytes\n",
+         iPage - 1, pPageListInfo->aPages[iPage - 1], rc, cb));
+    vmmdevHGCMPageMapRelease(pThis, pPageMap);
+
+    pPageMap->pvBounce = RTMemAllocZ(cb);
+    if (!pPageMap->pvBounce)
+        return VERR_NO_MEMORY;
+
+    if (pPageListInfo->flags & VBOX_HGCM_F_PARM_DIRECTION_TO_HOST)
+        rc = vmmdevHGCMPageListRead(pThis->pDevIns, pPageMap->pvBounce, cb, pPageListInfo);
+    else
+        rc = VINF_SUCCESS;
+
+    if (RT_SUCCESS(rc))
+    {
+        pHostParm->type           = VBOX_HGCM_SVC_PARM_PTR;
+        pHostParm->u.pointer.size = cb;
+        pHostParm->u.pointer.addr = pPageMap->pvBounce;
+    }
+    return rc;
+}
+
 static void vmmdevRestoreSavedCommand(VBOXHGCMCMD *pCmd, VBOXHGCMCMD *pSavedCmd)
 {
     /* Copy relevant saved command information to the new allocated structure. */
@@ -665,6 +854,11 @@ int vmmdevHGCMCall (PVMMDEV pThis, VMMDevHGCMCall *pHGCMCall, uint32_t cbHGCMCal
 
     uint32_t cLinPtrs = 0;
     uint32_t cLinPtrPages  = 0;
+    uint32_t cbPageMaps = 0;
+
+    /* Only services taking page lists benefit from mapping the guest pages. */
+    bool const fPageLists = pThis->pHGCMDrv->pfnIsPageListCall(pThis->pHGCMDrv, pHGCMCall->u32ClientID,
+                                                               pHGCMCall->u32Function);
 
     if (f64Bits)
     {
@@ -712,8 +906,16 @@ int vmmdevHGCMCall (PVMMDEV pThis, VMMDevHGCMCall *pHGCMCall, uint32_t cbHGCMCal
                         break;
                     }
 
-                    cbCmdSize += pGuestParm->u.PageList.size;
-                    Log(("vmmdevHGCMCall: pagelist size = %d\n", pGuestParm->u.PageList.size));
+                    /* Large buffers are mapped instead of copied, which only needs the mapping structure. */
+                    const HGCMPageListInfo *pPageListInfo = vmmdevHGCMPageListInfoGet(pHGCMCall, cbHGCMCall,
+                                                                                      pGuestParm->u.PageList.offset);
+                    uint32_t cMapPages = pPageListInfo
+                                       ? vmmdevHGCMPageListMapPages(fPageLists, pPageListInfo, pGuestParm->u.PageList.size) : 0;
+                    if (cMapPages)
+                        cbPageMaps += vmmdevHGCMPageMapSize(cMapPages);
+                    else
+                        cbCmdSize += pGuestParm->u.PageList.size;
+                    Log(("vmmdevHGCMCall: pagelist size = %d, %u pages mapped\n", pGuestParm->u.PageList.size, cMapPages));
                 } break;
 
                 case VMMDevHGCMParmType_32bit:
@@ -776,8 +978,16 @@ int vmmdevHGCMCall (PVMMDEV pThis, VMMDevHGCMCall *pHGCMCall, uint32_t cbHGCMCal
                         break;
                     }
 
-                    cbCmdSize += pGuestParm->u.PageList.size;
-                    Log(("vmmdevHGCMCall: pagelist size = %d\n", pGuestParm->u.PageList.size));
+                    /* Large buffers are mapped instead of copied, which only needs the mapping structure. */
+                    const HGCMPageListInfo *pPageListInfo = vmmdevHGCMPageListInfoGet(pHGCMCall, cbHGCMCall,
+                                                                                      pGuestParm->u.PageList.offset);
+                    uint32_t cMapPages = pPageListInfo
+                                       ? vmmdevHGCMPageListMapPages(fPageLists, pPageListInfo, pGuestParm->u.PageList.size) : 0;
+                    if (cMapPages)
+                        cbPageMaps += vmmdevHGCMPageMapSize(cMapPages);
+                    else
+                        cbCmdSize += pGuestParm->u.PageList.size;
+                    Log(("vmmdevHGCMCall: pagelist size = %d, %u pages mapped\n", pGuestParm->u.PageList.size, cMapPages));
                 } break;
 
                 case VMMDevHGCMParmType_32bit:
@@ -800,6 +1010,14 @@ int vmmdevHGCMCall (PVMMDEV pThis, VMMDevHGCMCall *pHGCMCall, uint32_t cbHGCMCal
         return rc;
     }
 
+    /* The page list mappings go to the end of the block. */
+    uint32_t const offPageMaps = RT_ALIGN_32(cbCmdSize, 8);
+    if (cbPageMaps > VMMDEV_MAX_HGCM_DATA_SIZE - offPageMaps)
+    {
+        return VERR_INVALID_PARAMETER;
+    }
+    cbCmdSize = offPageMaps + cbPageMaps;
+
     PVBOXHGCMCMD pCmd = (PVBOXHGCMCMD)RTMemAllocZ(cbCmdSize);
 
     if (pCmd == NULL)
@@ -847,6 +1065,8 @@ int vmmdevHGCMCall (PVMMDEV pThis, VMMDevHGCMCall *pHGCMCall, uint32_t cbHGCMCal
         uint32_t iLinPtr = 0;
         RTGCPHYS *pPages  = (RTGCPHYS *)((uint8_t *)pCmd->paLinPtrs + sizeof (VBOXHGCMLINPTR) *cLinPtrs);
 
+        uint8_t *pbPageMap = (uint8_t *)pCmd + offPageMaps;
+
         if (f64Bits)
         {
 #ifdef VBOX_WITH_64_BITS_GUESTS
@@ -951,6 +1171,20 @@ int vmmdevHGCMCall (PVMMDEV pThis, VMMDevHGCMCall *pHGCMCall, uint32_t cbHGCMCal
                              break;
                          }
 
+                         /* Same decision as when sizing the command. */
+                         uint32_t cMapPages = vmmdevHGCMPageListInfoGet(pHGCMCall, cbHGCMCall, pGuestParm->u.PageList.offset)
+                                            ? vmmdevHGCMPageListMapPages(fPageLists, pPageListInfo, size) : 0;
+                         if (cMapPages)
+                         {
+                             /* Let the service access the guest pages directly. */
+                             VBOXHGCMPAGEMAP *pPageMap = (VBOXHGCMPAGEMAP *)pbPageMap;
+                             pbPageMap += vmmdevHGCMPageMapSize(cMapPages);
+
+                             rc = vmmdevHGCMPageListMap(pThis, pCmd, pPageMap, cMapPages, pPageListInfo, size, pHostParm);
+                             Log(("vmmdevHGCMCall: PageList guest parameter mapped rc = %Rrc\n", rc));
+                             break;
+                         }
+
                          pHostParm->type = VBOX_HGCM_SVC_PARM_PTR;
                          pHostParm->u.pointer.size = size;
 
@@ -1092,6 +1326,20 @@ int vmmdevHGCMCall (PVMMDEV pThis, VMMDevHGCMCall *pHGCMCall, uint32_t cbHGCMCal
                              break;
                          }
 
+                         /* Same decision as when sizing the command. */
+                         uint32_t cMapPages = vmmdevHGCMPageListInfoGet(pHGCMCall, cbHGCMCall, pGuestParm->u.PageList.offset)
+                                            ? vmmdevHGCMPageListMapPages(fPageLists, pPageListInfo, size) : 0;
+                         if (cMapPages)
+                         {
+                             /* Let the service access the guest pages directly. */
+                             VBOXHGCMPAGEMAP *pPageMap = (VBOXHGCMPAGEMAP *)pbPageMap;
+                             pbPageMap += vmmdevHGCMPageMapSize(cMapPages);
+
+                             rc = vmmdevHGCMPageListMap(pThis, pCmd, pPageMap, cMapPages, pPageListInfo, size, pHostParm);
+                             Log(("vmmdevHGCMCall: PageList guest parameter mapped rc = %Rrc\n", rc));
+                             break;
+                         }
+
                          pHostParm->type = VBOX_HGCM_SVC_PARM_PTR;
                          pHostParm->u.pointer.size = size;
 
@@ -1150,6 +1398,8 @@ int vmmdevHGCMCall (PVMMDEV pThis, VMMDevHGCMCall *pHGCMCall, uint32_t cbHGCMCal
 
     if (RT_FAILURE (rc))
     {
+        vmmdevHGCMPageMapsRelease (pThis, pCmd);
+
         if (pCmd->paLinPtrs)
         {
             RTMemFree (pCmd->paLinPtrs);
@@ -1855,6 +2105,9 @@ static int vmmdevHGCMParmVerify64(HGCMFunctionParameter64 *pGuestParm, VBOXHGCMS
             if (   pHostParm->type == VBOX_HGCM_SVC_PARM_PTR
                 && pGuestParm->u.PageList.size >= pHostParm->u.pointer.size)
                 rc = VINF_SUCCESS;
+            else if (   pHostParm->type == VBOX_HGCM_SVC_PARM_PAGES
+                     && pGuestParm->u.PageList.size >= pHostParm->u.pages.size)
+                rc = VINF_SUCCESS;
             break;
 
         default:
@@ -1898,6 +2151,9 @@ static int vmmdevHGCMParmVerify32(HGCMFunctionParameter *pGuestParm, VBOXHGCMSVC
             if (   pHostParm->type == VBOX_HGCM_SVC_PARM_PTR
                 && pGuestParm->u.PageList.size >= pHostParm->u.pointer.size)
                 rc = VINF_SUCCESS;
+            else if (   pHostParm->type == VBOX_HGCM_SVC_PARM_PAGES
+                     && pGuestParm->u.PageList.size >= pHostParm->u.pages.size)
+                rc = VINF_SUCCESS;
             break;
 
         default:
@@ -1967,6 +2223,7 @@ DECLCALLBACK(void) hgcmCompletedWorker (PPDMIHGCMPORT pInterface, int32_t result
                 LogRel(("VMMDev: Failed to allocate %u bytes for HGCM request completion!!!\n", pCmd->cbSize));
 
                 /* Free it. The command have to be excluded from list of active commands anyway. */
+                vmmdevHGCMPageMapsRelease (pThis, pCmd);
                 RTMemFree (pCmd);
                 return;
             }
@@ -2080,7 +2337,8 @@ DECLCALLBACK(void) hgcmCompletedWorker (PPDMIHGCMPORT pInterface, int32_t result
                                 break;
                             }
 
-                            if (size > 0)
+                            /* Mapped pages were accessed directly by the service. */
+                            if (size > 0 && pHostParm->type == VBOX_HGCM_SVC_PARM_PTR)
                             {
                                 if (pPageListInfo->flags & VBOX_HGCM_F_PARM_DIRECTION_FROM_HOST)
                                 {
@@ -2188,7 +2446,8 @@ DECLCALLBACK(void) hgcmCompletedWorker (PPDMIHGCMPORT pInterface, int32_t result
                                 break;
                             }
 
-                            if (size > 0)
+                            /* Mapped pages were accessed directly by the service. */
+                            if (size > 0 && pHostParm->type == VBOX_HGCM_SVC_PARM_PTR)
                             {
                                 if (pPageListInfo->flags & VBOX_HGCM_F_PARM_DIRECTION_FROM_HOST)
                                 {
@@ -2296,7 +2555,8 @@ DECLCALLBACK(void) hgcmCompletedWorker (PPDMIHGCMPORT pInterface, int32_t result
                                 break;
                             }
 
-                            if (size > 0)
+                            /* Mapped pages were accessed directly by the service. */
+                            if (size > 0 && pHostParm->type == VBOX_HGCM_SVC_PARM_PTR)
                             {
                                 if (pPageListInfo->flags & VBOX_HGCM_F_PARM_DIRECTION_FROM_HOST)
                                 {
@@ -2364,6 +2624,8 @@ DECLCALLBACK(void) hgcmCompletedWorker (PPDMIHGCMPORT pInterface, int32_t result
     }
 
     /* Deallocate the command memory. */
+    vmmdevHGCMPageMapsRelease (pThis, pCmd);
+
     if (pCmd->paLinPtrs)
     {
         RTMemFree (pCmd->paLinPtrs);
@@ -2951,6 +3213,8 @@ int vmmdevHGCMLoadStateDone(PVMMDEV pThis, PSSMHANDLE pSSM)
             }
 
             /* Deallocate the saved command structure. */
+            vmmdevHGCMPageMapsRelease(pThis, pIter);
+
             if (pIter->paLinPtrs != NULL)
             {
                 RTMemFree(pIter->paLinPtrs);
@@ -2980,6 +3244,7 @@ void vmmdevHGCMDestroy(PVMMDEV pThis)
         vmmdevHGCMRemoveCommand(pThis, pIter);
 
         /* Deallocate the command memory. */
+        vmmdevHGCMPageMapsRelease(pThis, pIter);
         RTMemFree(pIter->paLinPtrs);
         RTMemFree(pIter);
 
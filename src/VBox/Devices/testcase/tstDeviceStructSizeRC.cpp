@@ -1886,10 +1886,13 @@ int main()
     GEN_CHECK_OFF(HDASTATE, fCviIoc);
     GEN_CHECK_OFF(HDASTATE, fR0Enabled);
     GEN_CHECK_OFF(HDASTATE, fRCEnabled);
-    GEN_CHECK_OFF(HDASTATE, pTimer);
-    GEN_CHECK_OFF(HDASTATE, uTicks);
+    GEN_CHECK_OFF(HDASTATE, pThreadIo);
+    GEN_CHECK_OFF(HDASTATE, hEvtIo);
+    GEN_CHECK_OFF(HDASTATE, cMsIoPeriod);
+    GEN_CHECK_OFF(HDASTATE, StatUnderruns);
+    GEN_CHECK_OFF(HDASTATE, StatOverruns);
 #ifdef VBOX_WITH_STATISTICS
-    GEN_CHECK_OFF(HDASTATE, StatTimer);
+    GEN_CHECK_OFF(HDASTATE, StatIo);
 #endif
     GEN_CHECK_OFF(HDASTATE, pCodec);
     GEN_CHECK_OFF(HDASTATE, lstDrv);
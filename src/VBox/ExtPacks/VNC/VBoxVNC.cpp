@@ -43,6 +43,12 @@
 
 #include <rfb/rfb.h>
 
+#if defined(RT_ARCH_AMD64)
+// SSE2 is always there on AMD64
+# include <emmintrin.h>
+# define VNC_WITH_SSE2
+#endif
+
 #ifdef LIBVNCSERVER_IPv6
 // enable manually!
 // #define VBOX_USE_IPV6
@@ -57,6 +63,10 @@
 #define VNC_ADDRESSSIZE         60
 #define VNC_PORTSSIZE           20
 #define VNC_ADDRESS_OPTION_MAX  500
+// width and height of the tiles the framebuffer is hashed in
+#define VNC_TILE_SIZE           64
+// maximum number of separate damage rectangles collected per update sequence
+#define VNC_MAX_DAMAGE_RECTS    16
 
 
 /*********************************************************************************************************************************
@@ -72,12 +82,18 @@ public:
         mScreenBuffer = NULL;
         mCursor = NULL;
         uClients = 0;
+        mcDamage = 0;
+        mpau64TileHash = NULL;
+        mcTilesX = 0;
+        mcTilesY = 0;
     }
 
     ~VNCServerImpl()
     {
         if (mFrameBuffer)
             RTMemFree(mFrameBuffer);
+        if (mpau64TileHash)
+            RTMemFree(mpau64TileHash);
         if (mCursor)
             rfbFreeCursor(mCursor);
         RT_ZERO(szVNCPassword);
@@ -103,6 +119,19 @@ private:
     unsigned char *mScreenBuffer;
     unsigned char *mFrameBuffer;
     uint32_t uClients;
+
+    // damage of the current update sequence, converted when the sequence ends
+    RTRECT maDamage[VNC_MAX_DAMAGE_RECTS];
+    uint32_t mcDamage;
+    // hash of the source pixels of each tile when it was last converted, 0 if unknown
+    uint64_t *mpau64TileHash;
+    uint32_t mcTilesX;
+    uint32_t mcTilesY;
+
+    void addDamage(int32_t x, int32_t y, int32_t w, int32_t h);
+    void flushDamage();
+    void invalidateTiles(int32_t x, int32_t y, int32_t w, int32_t h);
+    void convertRect(uint32_t x, uint32_t y, uint32_t w, uint32_t h);
     static enum rfbNewClientAction rfbNewClientEvent(rfbClientPtr cl);
     static void vncMouseEvent(int buttonMask, int x, int y, rfbClientPtr cl);
     static void vncKeyboardEvent(rfbBool down, rfbKeySym keySym, rfbClientPtr cl);
@@ -717,6 +746,303 @@ static inline void convert16To32bpp(uint8_t msb, uint8_t lsb, uint8_t &r, uint8_
     b = (px << 3) & 0xf8;
 }
 
+// Swap the red and blue bytes of a 32bpp pixel and clear the unused byte.
+static inline uint32_t swapRB(uint32_t px)
+{
+    return (px & 0x0000ff00) | ((px << 16) & 0x00ff0000) | ((px >> 16) & 0x000000ff);
+}
+
+/**
+ * Convert a line of RGB (windows/vbox) 32bpp pixels to BGR (vnc).
+ */
+static void convertLine32To32bpp(uint8_t *pbDst, const uint8_t *pbSrc, uint32_t cPixels)
+{
+    uint32_t i = 0;
+#ifdef VNC_WITH_SSE2
+    const __m128i maskG  = _mm_set1_epi32(0x0000ff00);
+    const __m128i maskRB = _mm_set1_epi32(0x000000ff);
+    for (; i + 4 <= cPixels; i += 4)
+    {
+        __m128i px = _mm_loadu_si128((const __m128i *)(pbSrc + i * 4));
+        __m128i r  = _mm_and_si128(_mm_srli_epi32(px, 16), maskRB);
+        __m128i b  = _mm_slli_epi32(_mm_and_si128(px, maskRB), 16);
+        px = _mm_or_si128(_mm_or_si128(_mm_and_si128(px, maskG), r), b);
+        _mm_storeu_si128((__m128i *)(pbDst + i * 4), px);
+    }
+#endif
+    for (; i < cPixels; i++)
+    {
+        uint32_t px;
+        memcpy(&px, pbSrc + i * 4, sizeof(px));
+        px = swapRB(px);
+        memcpy(pbDst + i * 4, &px, sizeof(px));
+    }
+}
+
+/**
+ * Convert a line of RGB (windows/vbox) 24bpp pixels to BGR (vnc).
+ *
+ * SSE2 has no byte shuffle, so this unpacks four pixels from three dwords
+ * at a time instead.
+ */
+static void convertLine24To32bpp(uint8_t *pbDst, const uint8_t *pbSrc, uint32_t cPixels)
+{
+    uint32_t i = 0;
+    for (; i + 4 <= cPixels; i += 4)
+    {
+        uint32_t au32Src[3];
+        memcpy(au32Src, pbSrc + i * 3, sizeof(au32Src));
+        uint32_t au32Dst[4];
+        au32Dst[0] = swapRB(au32Src[0]);
+        au32Dst[1] = swapRB((au32Src[0] >> 24) | (au32Src[1] << 8));
+        au32Dst[2] = swapRB((au32Src[1] >> 16) | (au32Src[2] << 16));
+        au32Dst[3] = swapRB(au32Src[2] >> 8);
+        memcpy(pbDst + i * 4, au32Dst, sizeof(au32Dst));
+    }
+    for (; i < cPixels; i++)
+    {
+        pbDst[i * 4]     = pbSrc[i * 3 + 2];
+        pbDst[i * 4 + 1] = pbSrc[i * 3 + 1];
+        pbDst[i * 4 + 2] = pbSrc[i * 3];
+        pbDst[i * 4 + 3] = 0;
+    }
+}
+
+/**
+ * Convert a line of RGB 565 pixels to BGR (vnc).
+ */
+static void convertLine16To32bpp(uint8_t *pbDst, const uint8_t *pbSrc, uint32_t cPixels)
+{
+    uint32_t i = 0;
+#ifdef VNC_WITH_SSE2
+    const __m128i maskRB = _mm_set1_epi16(0xf8);
+    const __m128i maskG  = _mm_set1_epi16(0xfc);
+    for (; i + 8 <= cPixels; i += 8)
+    {
+        __m128i px = _mm_loadu_si128((const __m128i *)(pbSrc + i * 2));
+        __m128i r  = _mm_and_si128(_mm_srli_epi16(px, 8), maskRB);
+        __m128i g  = _mm_and_si128(_mm_srli_epi16(px, 3), maskG);
+        __m128i b  = _mm_and_si128(_mm_slli_epi16(px, 3), maskRB);
+        __m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+        _mm_storeu_si128((__m128i *)(pbDst + i * 4),      _mm_unpacklo_epi16(rg, b));
+        _mm_storeu_si128((__m128i *)(pbDst + i * 4 + 16), _mm_unpackhi_epi16(rg, b));
+    }
+#endif
+    for (; i < cPixels; i++)
+    {
+        convert16To32bpp(pbSrc[i * 2], pbSrc[i * 2 + 1], pbDst[i * 4], pbDst[i * 4 + 1], pbDst[i * 4 + 2]);
+        pbDst[i * 4 + 3] = 0;
+    }
+}
+
+/**
+ * Hash the pixels of a tile.
+ *
+ * @returns 64-bit hash, never 0.
+ * @param pbSrc    The first pixel of the tile.
+ * @param cbRow    The number of bytes to hash per row.
+ * @param cbStride The distance between two rows.
+ * @param cRows    The number of rows.
+ */
+static uint64_t hashTile(const uint8_t *pbSrc, uint32_t cbRow, uint32_t cbStride, uint32_t cRows)
+{
+    // Two independent lanes so the multiplications can overlap.
+    uint64_t h1 = UINT64_C(0x9e3779b97f4a7c15);
+    uint64_t h2 = UINT64_C(0xc2b2ae3d27d4eb4f);
+    for (uint32_t y = 0; y < cRows; y++, pbSrc += cbStride)
+    {
+        const uint8_t *pb = pbSrc;
+        uint32_t cb = cbRow;
+        for (; cb >= 16; cb -= 16, pb += 16)
+        {
+            uint64_t au64[2];
+            memcpy(au64, pb, sizeof(au64));
+            h1 = ASMRotateLeftU64((h1 ^ au64[0]) * UINT64_C(0x87c37b91114253d5), 31);
+            h2 = ASMRotateLeftU64((h2 ^ au64[1]) * UINT64_C(0x4cf5ad432745937f), 33);
+        }
+        uint64_t au64Tail[2] = { 0, 0 };
+        memcpy(au64Tail, pb, cb);
+        h1 = ASMRotateLeftU64((h1 ^ au64Tail[0] ^ cb) * UINT64_C(0x87c37b91114253d5), 31);
+        h2 = ASMRotateLeftU64((h2 ^ au64Tail[1]) * UINT64_C(0x4cf5ad432745937f), 33);
+    }
+    uint64_t h = h1 ^ ASMRotateLeftU64(h2, 17);
+    h ^= h >> 29;
+    h *= UINT64_C(0xbf58476d1ce4e5b9);
+    h ^= h >> 32;
+    return h ? h : 1;
+}
+
+/**
+ * Convert a part of the screen buffer into the VNC framebuffer.
+ * The rectangle must be within the framebuffer.
+ */
+void VNCServerImpl::convertRect(uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+{
+    uint32_t const width = FrameInfo.cWidth;
+    uint32_t const bpp = FrameInfo.cBitsPerPixel / 8;
+    const uint8_t *pbSrc = mScreenBuffer + (y * width + x) * bpp;
+    uint8_t *pbDst = mFrameBuffer + (y * width + x) * VNC_SIZEOFRGBA;
+    for (uint32_t i = 0; i < h; i++, pbSrc += width * bpp, pbDst += width * VNC_SIZEOFRGBA)
+    {
+        if (FrameInfo.cBitsPerPixel == 32)
+            convertLine32To32bpp(pbDst, pbSrc, w);
+        else if (FrameInfo.cBitsPerPixel == 24)
+            convertLine24To32bpp(pbDst, pbSrc, w);
+        else if (FrameInfo.cBitsPerPixel == 16)
+            convertLine16To32bpp(pbDst, pbSrc, w);
+    }
+}
+
+/**
+ * Add a rectangle to the damage of the current update sequence.
+ * Overlapping and touching rectangles are merged, so are the closest ones if
+ * there are too many.
+ */
+void VNCServerImpl::addDamage(int32_t x, int32_t y, int32_t w, int32_t h)
+{
+    RTRECT rect;
+    rect.xLeft   = RT_MAX(x, 0);
+    rect.yTop    = RT_MAX(y, 0);
+    rect.xRight  = (int32_t)RT_MIN((int64_t)x + w, (int64_t)FrameInfo.cWidth);
+    rect.yBottom = (int32_t)RT_MIN((int64_t)y + h, (int64_t)FrameInfo.cHeight);
+    if (rect.xLeft >= rect.xRight || rect.yTop >= rect.yBottom)
+        return;
+
+    for (;;)
+    {
+        uint32_t i;
+        for (i = 0; i < mcDamage; i++)
+            if (   rect.xLeft   <= maDamage[i].xRight
+                && rect.xRight  >= maDamage[i].xLeft
+                && rect.yTop    <= maDamage[i].yBottom
+                && rect.yBottom >= maDamage[i].yTop)
+                break;
+        if (i == mcDamage)
+            break;
+
+        // merge and see whether the result touches any of the others
+        rect.xLeft   = RT_MIN(rect.xLeft,   maDamage[i].xLeft);
+        rect.yTop    = RT_MIN(rect.yTop,    maDamage[i].yTop);
+        rect.xRight  = RT_MAX(rect.xRight,  maDamage[i].xRight);
+        rect.yBottom = RT_MAX(rect.yBottom, maDamage[i].yBottom);
+        maDamage[i] = maDamage[--mcDamage];
+    }
+
+    if (mcDamage == VNC_MAX_DAMAGE_RECTS)
+    {
+        // merge into the one which grows the least
+        uint32_t iBest = 0;
+        int64_t cBest = INT64_MAX;
+        for (uint32_t i = 0; i < mcDamage; i++)
+        {
+            int64_t cx = RT_MAX(rect.xRight, maDamage[i].xRight) - RT_MIN(rect.xLeft, maDamage[i].xLeft);
+            int64_t cy = RT_MAX(rect.yBottom, maDamage[i].yBottom) - RT_MIN(rect.yTop, maDamage[i].yTop);
+            int64_t cGrow = cx * cy - (int64_t)(maDamage[i].xRight - maDamage[i].xLeft) * (maDamage[i].yBottom - maDamage[i].yTop);
+            if (cGrow < cBest)
+            {
+                cBest = cGrow;
+                iBest = i;
+            }
+        }
+        RTRECT other = maDamage[iBest];
+        maDamage[iBest] = maDamage[--mcDamage];
+        addDamage(RT_MIN(rect.xLeft, other.xLeft), RT_MIN(rect.yTop, other.yTop),
+                  RT_MAX(rect.xRight, other.xRight) - RT_MIN(rect.xLeft, other.xLeft),
+                  RT_MAX(rect.yBottom, other.yBottom) - RT_MIN(rect.yTop, other.yTop));
+        return;
+    }
+
+    maDamage[mcDamage++] = rect;
+}
+
+/**
+ * Forget the hashes of the tiles in the given rectangle, used when the VNC
+ * framebuffer was modified directly.
+ */
+void VNCServerImpl::invalidateTiles(int32_t x, int32_t y, int32_t w, int32_t h)
+{
+    if (!mpau64TileHash || w <= 0 || h <= 0)
+        return;
+    int32_t const txFirst = RT_MAX(x, 0) / VNC_TILE_SIZE;
+    int32_t const tyFirst = RT_MAX(y, 0) / VNC_TILE_SIZE;
+    int32_t const txLast  = RT_MIN((x + w - 1) / VNC_TILE_SIZE, (int32_t)mcTilesX - 1);
+    int32_t const tyLast  = RT_MIN((y + h - 1) / VNC_TILE_SIZE, (int32_t)mcTilesY - 1);
+    for (int32_t ty = tyFirst; ty <= tyLast; ty++)
+        for (int32_t tx = txFirst; tx <= txLast; tx++)
+            mpau64TileHash[ty * mcTilesX + tx] = 0;
+}
+
+/**
+ * Convert the damage of the current update sequence and tell libvncserver
+ * about it, skipping the tiles whose pixels are the same as last time.
+ */
+void VNCServerImpl::flushDamage()
+{
+    if (!mcDamage)
+        return;
+    if (!mScreenBuffer || !mpau64TileHash)
+    {
+        mcDamage = 0;
+        return;
+    }
+
+    RTRECT bounds = maDamage[0];
+    for (uint32_t i = 1; i < mcDamage; i++)
+    {
+        bounds.xLeft   = RT_MIN(bounds.xLeft,   maDamage[i].xLeft);
+        bounds.yTop    = RT_MIN(bounds.yTop,    maDamage[i].yTop);
+        bounds.xRight  = RT_MAX(bounds.xRight,  maDamage[i].xRight);
+        bounds.yBottom = RT_MAX(bounds.yBottom, maDamage[i].yBottom);
+    }
+
+    uint32_t const width  = FrameInfo.cWidth;
+    uint32_t const height = FrameInfo.cHeight;
+    uint32_t const bpp    = FrameInfo.cBitsPerPixel / 8;
+    for (uint32_t ty = bounds.yTop / VNC_TILE_SIZE; ty <= (uint32_t)(bounds.yBottom - 1) / VNC_TILE_SIZE; ty++)
+        for (uint32_t tx = bounds.xLeft / VNC_TILE_SIZE; tx <= (uint32_t)(bounds.xRight - 1) / VNC_TILE_SIZE; tx++)
+        {
+            RTRECT tile;
+            tile.xLeft   = tx * VNC_TILE_SIZE;
+            tile.yTop    = ty * VNC_TILE_SIZE;
+            tile.xRight  = RT_MIN(tile.xLeft + VNC_TILE_SIZE, (int32_t)width);
+            tile.yBottom = RT_MIN(tile.yTop + VNC_TILE_SIZE, (int32_t)height);
+
+            // the part of the tile which was reported as changed
+            RTRECT clip = { INT32_MAX, INT32_MAX, INT32_MIN, INT32_MIN };
+            for (uint32_t i = 0; i < mcDamage; i++)
+            {
+                int32_t xLeft   = RT_MAX(tile.xLeft,   maDamage[i].xLeft);
+                int32_t yTop    = RT_MAX(tile.yTop,    maDamage[i].yTop);
+                int32_t xRight  = RT_MIN(tile.xRight,  maDamage[i].xRight);
+                int32_t yBottom = RT_MIN(tile.yBottom, maDamage[i].yBottom);
+                if (xLeft < xRight && yTop < yBottom)
+                {
+                    clip.xLeft   = RT_MIN(clip.xLeft,   xLeft);
+                    clip.yTop    = RT_MIN(clip.yTop,    yTop);
+                    clip.xRight  = RT_MAX(clip.xRight,  xRight);
+                    clip.yBottom = RT_MAX(clip.yBottom, yBottom);
+                }
+            }
+            if (clip.xLeft >= clip.xRight)
+                continue;
+
+            // The whole tile is hashed and converted, so the hash always
+            // describes what is in the VNC framebuffer.
+            uint32_t const cx = tile.xRight - tile.xLeft;
+            uint32_t const cy = tile.yBottom - tile.yTop;
+            uint64_t const u64Hash = hashTile(mScreenBuffer + (tile.yTop * width + tile.xLeft) * bpp,
+                                              cx * bpp, width * bpp, cy);
+            uint64_t *pu64Hash = &mpau64TileHash[ty * mcTilesX + tx];
+            if (*pu64Hash == u64Hash)
+                continue;
+            *pu64Hash = u64Hash;
+            convertRect(tile.xLeft, tile.yTop, cx, cy);
+            rfbMarkRectAsModified(mVNCServer, clip.xLeft, clip.yTop, clip.xRight, clip.yBottom);
+        }
+
+    mcDamage = 0;
+}
+
 /**
  * Inform the server that the display was resized.
  * The server will query information about display
@@ -736,42 +1062,35 @@ DECLCALLBACK(void) VNCServerImpl::VRDEResize(HVRDESERVER hServer)
 
     // we always alloc an RGBA buffer
     unsigned char *FrameBuffer = (unsigned char *)RTMemAlloc(info.cWidth * info.cHeight * VNC_SIZEOFRGBA); // RGBA
-    if (info.cBitsPerPixel == 32 || info.cBitsPerPixel == 24)
+    uint32_t cTilesX = (info.cWidth  + VNC_TILE_SIZE - 1) / VNC_TILE_SIZE;
+    uint32_t cTilesY = (info.cHeight + VNC_TILE_SIZE - 1) / VNC_TILE_SIZE;
+    uint64_t *pau64TileHash = (uint64_t *)RTMemAllocZ(RT_MAX(cTilesX * cTilesY, 1) * sizeof(uint64_t));
+    if (!FrameBuffer || !pau64TileHash)
     {
-        // Convert RGB (windows/vbox) to BGR(vnc)
-        uint32_t i, j;
-        for (i = 0, j = 0; i < info.cWidth * info.cHeight * VNC_SIZEOFRGBA; i += VNC_SIZEOFRGBA, j += info.cBitsPerPixel / 8)
-        {
-            unsigned char r = info.pu8Bits[j];
-            unsigned char g = info.pu8Bits[j + 1];
-            unsigned char b = info.pu8Bits[j + 2];
-            FrameBuffer[i]     = b;
-            FrameBuffer[i + 1] = g;
-            FrameBuffer[i + 2] = r;
-        }
-    }
-    else if (info.cBitsPerPixel == 16)
-    {
-        uint32_t i, j;
-        for (i = 0, j = 0;
-             i < info.cWidth * info.cHeight * VNC_SIZEOFRGBA;
-             i += VNC_SIZEOFRGBA, j += info.cBitsPerPixel / 8)
-        {
-            convert16To32bpp(info.pu8Bits[j],
-                             info.pu8Bits[j + 1],
-                             FrameBuffer[i],
-                             FrameBuffer[i + 1],
-                             FrameBuffer[i + 2]);
-        }
+        RTMemFree(FrameBuffer);
+        RTMemFree(pau64TileHash);
+        return;
     }
-    rfbNewFramebuffer(instance->mVNCServer, (char *)FrameBuffer, info.cWidth, info.cHeight, 8, 3, VNC_SIZEOFRGBA);
 
     void *temp = instance->mFrameBuffer;
+    void *tempHash = instance->mpau64TileHash;
     instance->mFrameBuffer = FrameBuffer;
     instance->mScreenBuffer = (unsigned char *)info.pu8Bits;
     instance->FrameInfo = info;
+    instance->mpau64TileHash = pau64TileHash;
+    instance->mcTilesX = cTilesX;
+    instance->mcTilesY = cTilesY;
+    instance->mcDamage = 0;
+
+    // Convert RGB (windows/vbox) to BGR(vnc), the tile hashes are all unknown
+    // so the next update converts the tiles it touches again.
+    instance->convertRect(0, 0, info.cWidth, info.cHeight);
+    rfbNewFramebuffer(instance->mVNCServer, (char *)FrameBuffer, info.cWidth, info.cHeight, 8, 3, VNC_SIZEOFRGBA);
+
     if (temp)
         RTMemFree(temp);
+    if (tempHash)
+        RTMemFree(tempHash);
 }
 
 /**
@@ -797,7 +1116,7 @@ DECLCALLBACK(void) VNCServerImpl::VRDEUpdate(HVRDESERVER hServer, unsigned uScre
          * The server can now process redraw requests from clients or initial
          * fullscreen updates for new clients.
          */
-
+        instance->flushDamage();
     }
     else
     {
@@ -813,52 +1132,15 @@ DECLCALLBACK(void) VNCServerImpl::VRDEUpdate(HVRDESERVER hServer, unsigned uScre
                     VRDEORDERSOLIDRECT *solidrect = (VRDEORDERSOLIDRECT *)ptr;
                     rfbFillRect(instance->mVNCServer, solidrect->x, solidrect->y,
                         solidrect->x + solidrect->w, solidrect->y + solidrect->h, RGB2BGR(solidrect->rgb));
+                    instance->invalidateTiles(solidrect->x, solidrect->y, solidrect->w, solidrect->h);
                     return;
                 }
             ///@todo: more orders
             }
         }
 
-        uint32_t width = instance->FrameInfo.cWidth;
-        uint32_t bpp = instance->FrameInfo.cBitsPerPixel / 8;
-        uint32_t joff = order->y * width + order->x;
-        uint32_t srcx, srcy, destx, desty;
-        if (instance->FrameInfo.cBitsPerPixel == 32 || instance->FrameInfo.cBitsPerPixel == 24)
-        {
-            for (srcy = joff * bpp, desty = joff * VNC_SIZEOFRGBA;
-                 desty < (joff + order->h * width) * VNC_SIZEOFRGBA;
-                 srcy += width * bpp, desty += width * VNC_SIZEOFRGBA)
-            {
-                // RGB to BGR
-                for (srcx = srcy, destx = desty;
-                     destx < desty + order->w * VNC_SIZEOFRGBA;
-                     srcx += bpp, destx += VNC_SIZEOFRGBA)
-                {
-                    instance->mFrameBuffer[destx]     = instance->mScreenBuffer[srcx + 2];
-                    instance->mFrameBuffer[destx + 1] = instance->mScreenBuffer[srcx + 1];
-                    instance->mFrameBuffer[destx + 2] = instance->mScreenBuffer[srcx];
-                }
-            }
-        }
-        else if (instance->FrameInfo.cBitsPerPixel == 16)
-        {
-            for (srcy = joff * bpp, desty = joff * VNC_SIZEOFRGBA;
-                 desty < (joff + order->h * width) * VNC_SIZEOFRGBA;
-                 srcy += width * bpp, desty += width * VNC_SIZEOFRGBA)
-            {
-                for (srcx = srcy, destx = desty;
-                     destx < desty + order->w * VNC_SIZEOFRGBA;
-                     srcx += bpp, destx += VNC_SIZEOFRGBA)
-                {
-                    convert16To32bpp(instance->mScreenBuffer[srcx],
-                                     instance->mScreenBuffer[srcx + 1],
-                                     instance->mFrameBuffer[destx],
-                                     instance->mFrameBuffer[destx + 1],
-                                     instance->mFrameBuffer[destx + 2]);
-                }
-            }
-        }
-        rfbMarkRectAsModified(instance->mVNCServer, order->x, order->y, order->x+order->w, order->y+order->h);
+        // Collect the damage, it is converted when the update sequence ends.
+        instance->addDamage(order->x, order->y, order->w, order->h);
     }
 }
 
@@ -314,6 +314,20 @@ int vbsfMappingsRemove(PSHFLSTRING pMapName)
     return VINF_SUCCESS;
 }
 
+/**
+ * Gets the root handle of a mapping.
+ *
+ * @returns The root, SHFL_ROOT_NIL if there is no such mapping.
+ * @param   pMapName    The mapping name.
+ */
+SHFLROOT vbsfMappingsQueryRootByName(PSHFLSTRING pMapName)
+{
+    SHFLROOT root = SHFL_ROOT_NIL;
+    if (!vbsfMappingGetByName(pMapName->String.ucs2, &root))
+        root = SHFL_ROOT_NIL;
+    return root;
+}
+
 const char* vbsfMappingsQueryHostRoot(SHFLROOT root)
 {
     MAPPING *pFolderMapping = vbsfMappingGetByRoot(root);
@@ -44,6 +44,7 @@ bool vbsfMappingQuery(uint32_t iMapping, PMAPPING *pMapping);
 int vbsfMappingsAdd(PSHFLSTRING pFolderName, PSHFLSTRING pMapName,
                     bool fWritable, bool fAutoMount, bool fCreateSymlinks, bool fMissing);
 int vbsfMappingsRemove(PSHFLSTRING pMapName);
+SHFLROOT vbsfMappingsQueryRootByName(PSHFLSTRING pMapName);
 
 int vbsfMappingsQuery(PSHFLCLIENTDATA pClient, PSHFLMAPPING pMappings, uint32_t *pcMappings);
 int vbsfMappingsQueryName(PSHFLCLIENTDATA pClient, SHFLROOT root, SHFLSTRING *pString);
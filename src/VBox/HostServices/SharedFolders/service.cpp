@@ -21,6 +21,8 @@
 #include "mappings.h"
 #include "shflhandle.h"
 #include "vbsf.h"
+#include "vbsfworker.h"
+#include "vbsfcache.h"
 #include <iprt/alloc.h>
 #include <iprt/string.h>
 #include <iprt/assert.h>
@@ -78,6 +80,9 @@ static DECLCALLBACK(int) svcUnload (void *)
 
     Log(("svcUnload\n"));
 
+    vbsfWorkersTerm();
+    vbsfCacheTerm();
+
     return rc;
 }
 
@@ -100,6 +105,8 @@ static DECLCALLBACK(int) svcDisconnect (void *, uint32_t u32ClientID, void *pvCl
 
     Log(("SharedFolders host service: disconnected, u32ClientID = %u\n", u32ClientID));
 
+    /* The workers must be done with the client before its handles go away. */
+    vbsfWorkersDrain(pClient);
     vbsfDisconnect(pClient);
     return rc;
 }
@@ -112,6 +119,9 @@ static DECLCALLBACK(int) svcDisconnect (void *, uint32_t u32ClientID, void *pvCl
  */
 static DECLCALLBACK(int) svcSaveState(void *, uint32_t u32ClientID, void *pvClient, PSSMHANDLE pSSM)
 {
+    /* Don't let the workers complete calls while the state is being saved. */
+    vbsfWorkersDrain((SHFLCLIENTDATA *)pvClient);
+
 #ifndef UNITTEST  /* Read this as not yet tested */
     SHFLCLIENTDATA *pClient = (SHFLCLIENTDATA *)pvClient;
 
@@ -289,25 +299,102 @@ static DECLCALLBACK(int) svcLoadState(void *, uint32_t u32ClientID, void *pvClie
     return VINF_SUCCESS;
 }
 
-static DECLCALLBACK(void) svcCall (void *, VBOXHGCMCALLHANDLE callHandle, uint32_t u32ClientID, void *pvClient, uint32_t u32Function, uint32_t cParms, VBOXHGCMSVCPARM paParms[])
+/** Number of segments a SHFLIOBUF describes without a heap allocation, 64KB
+ * of page list. */
+#define SHFL_IOBUF_SEGS     16
+
+/**
+ * Host view of the data buffer of a READ or WRITE call.
+ */
+typedef struct SHFLIOBUF
 {
-    int rc = VINF_SUCCESS;
+    /** The S/G buffer passed to vbsfRead and vbsfWrite. */
+    RTSGBUF     SgBuf;
+    /** The segments, aSegs or a heap array for long page lists. */
+    PRTSGSEG    paSegs;
+    RTSGSEG     aSegs[SHFL_IOBUF_SEGS];
+} SHFLIOBUF;
+
+/**
+ * Sets up the S/G buffer for the data of a READ or WRITE call.
+ *
+ * Pointer parameters give a single segment.  Page lists are described page by
+ * page, merging pages which are mapped next to each other, so the file is read
+ * into and written from the guest pages directly.
+ *
+ * @param   pParm       The buffer parameter, PTR or PAGES.
+ * @param   fDirection  VBOX_HGCM_F_PARM_DIRECTION_FROM_HOST for reads,
+ *                      VBOX_HGCM_F_PARM_DIRECTION_TO_HOST for writes.
+ * @param   cb          The transfer size, checked against the parameter size.
+ * @param   pIoBuf      The buffer to set up.  Release it with
+ *                      svcCallReleaseIoBuffer.
+ */
+static int svcCallGetIoBuffer (VBOXHGCMSVCPARM *pParm, uint32_t fDirection, uint32_t cb, SHFLIOBUF *pIoBuf)
+{
+    pIoBuf->paSegs = &pIoBuf->aSegs[0];
 
-    Log(("SharedFolders host service: svcCall: u32ClientID = %u, fn = %u, cParms = %u, pparms = %p\n", u32ClientID, u32Function, cParms, paParms));
+    if (pParm->type == VBOX_HGCM_SVC_PARM_PTR)
+    {
+        pIoBuf->aSegs[0].pvSeg = pParm->u.pointer.addr;
+        pIoBuf->aSegs[0].cbSeg = cb;
+        RTSgBufInit(&pIoBuf->SgBuf, pIoBuf->paSegs, 1);
+        return VINF_SUCCESS;
+    }
 
-    SHFLCLIENTDATA *pClient = (SHFLCLIENTDATA *)pvClient;
+    /* The pages are only mapped writable for FROM_HOST, and only hold guest
+     * data for TO_HOST. */
+    PCVBOXHGCMSVCPARMPAGES pPages = pParm->u.pages.pPages;
+    if (!(pPages->fFlags & fDirection))
+        return VERR_INVALID_PARAMETER;
 
-    bool fAsynchronousProcessing = false;
-
-#ifdef DEBUG
-    uint32_t i;
+    uint32_t const cPages = (uint32_t)(((uint64_t)pPages->offFirstPage + cb + PAGE_OFFSET_MASK) >> PAGE_SHIFT);
+    if (cPages > pPages->cPages)
+        return VERR_INVALID_PARAMETER;
+    if (cPages > SHFL_IOBUF_SEGS)
+    {
+        pIoBuf->paSegs = (PRTSGSEG)RTMemTmpAlloc(cPages * sizeof(RTSGSEG));
+        if (!pIoBuf->paSegs)
+            return VERR_NO_MEMORY;
+    }
 
-    for (i = 0; i < cParms; i++)
+    uint32_t cSegs   = 0;
+    uint32_t offPage = pPages->offFirstPage;
+    for (uint32_t iPage = 0; cb > 0; iPage++)
     {
-        /** @todo parameters other than 32 bit */
-        Log(("    pparms[%d]: type %u, value %u\n", i, paParms[i].type, paParms[i].u.uint32));
+        uint8_t *pb = (uint8_t *)pPages->papvPages[iPage] + offPage;
+        uint32_t const cbChunk = RT_MIN(cb, PAGE_SIZE - offPage);
+        if (   cSegs > 0
+            && (uint8_t *)pIoBuf->paSegs[cSegs - 1].pvSeg + pIoBuf->paSegs[cSegs - 1].cbSeg == pb)
+            pIoBuf->paSegs[cSegs - 1].cbSeg += cbChunk;
+        else
+        {
+            pIoBuf->paSegs[cSegs].pvSeg = pb;
+            pIoBuf->paSegs[cSegs].cbSeg = cbChunk;
+            cSegs++;
+        }
+        cb     -= cbChunk;
+        offPage = 0;
     }
-#endif
+
+    RTSgBufInit(&pIoBuf->SgBuf, pIoBuf->paSegs, cSegs);
+    return VINF_SUCCESS;
+}
+
+/**
+ * Releases a buffer set up by svcCallGetIoBuffer.
+ */
+static void svcCallReleaseIoBuffer (SHFLIOBUF *pIoBuf)
+{
+    if (pIoBuf->paSegs != &pIoBuf->aSegs[0])
+        RTMemTmpFree(pIoBuf->paSegs);
+}
+
+/**
+ * Executes a guest call, either on the service thread or on a worker thread.
+ */
+static int svcCallExecute (SHFLCLIENTDATA *pClient, uint32_t u32Function, uint32_t cParms, VBOXHGCMSVCPARM paParms[])
+{
+    int rc = VINF_SUCCESS;
 
     switch (u32Function)
     {
@@ -520,7 +607,8 @@ static DECLCALLBACK(void) svcCall (void *, VBOXHGCMCALLHANDLE callHandle, uint32
                 || paParms[1].type != VBOX_HGCM_SVC_PARM_64BIT   /* handle */
                 || paParms[2].type != VBOX_HGCM_SVC_PARM_64BIT   /* offset */
                 || paParms[3].type != VBOX_HGCM_SVC_PARM_32BIT   /* count */
-                || paParms[4].type != VBOX_HGCM_SVC_PARM_PTR     /* buffer */
+                || (   paParms[4].type != VBOX_HGCM_SVC_PARM_PTR /* buffer */
+                    && paParms[4].type != VBOX_HGCM_SVC_PARM_PAGES)
                     )
             {
                 rc = VERR_INVALID_PARAMETER;
@@ -532,11 +620,11 @@ static DECLCALLBACK(void) svcCall (void *, VBOXHGCMCALLHANDLE callHandle, uint32
                 SHFLHANDLE Handle  = paParms[1].u.uint64;
                 uint64_t   offset  = paParms[2].u.uint64;
                 uint32_t   count   = paParms[3].u.uint32;
-                uint8_t   *pBuffer = (uint8_t *)paParms[4].u.pointer.addr;
+                SHFLIOBUF  IoBuf;
 
                 /* Verify parameters values. */
                 if (   Handle == SHFL_HANDLE_ROOT
-                    || count > paParms[4].u.pointer.size
+                    || count > paParms[4].getBufferSize()
                    )
                 {
                     rc = VERR_INVALID_PARAMETER;
@@ -556,7 +644,12 @@ static DECLCALLBACK(void) svcCall (void *, VBOXHGCMCALLHANDLE callHandle, uint32
                         pStatusLed->Asserted.s.fReading = pStatusLed->Actual.s.fReading = 1;
                     }
 
-                    rc = vbsfRead (pClient, root, Handle, offset, &count, pBuffer);
+                    rc = svcCallGetIoBuffer(&paParms[4], VBOX_HGCM_F_PARM_DIRECTION_FROM_HOST, count, &IoBuf);
+                    if (RT_SUCCESS(rc))
+                    {
+                        rc = vbsfRead (pClient, root, Handle, offset, &count, &IoBuf.SgBuf);
+                        svcCallReleaseIoBuffer(&IoBuf);
+                    }
                     if (pStatusLed)
                         pStatusLed->Actual.s.fReading = 0;
 
@@ -587,7 +680,8 @@ static DECLCALLBACK(void) svcCall (void *, VBOXHGCMCALLHANDLE callHandle, uint32
                 || paParms[1].type != VBOX_HGCM_SVC_PARM_64BIT   /* handle */
                 || paParms[2].type != VBOX_HGCM_SVC_PARM_64BIT   /* offset */
                 || paParms[3].type != VBOX_HGCM_SVC_PARM_32BIT   /* count */
-                || paParms[4].type != VBOX_HGCM_SVC_PARM_PTR     /* buffer */
+                || (   paParms[4].type != VBOX_HGCM_SVC_PARM_PTR /* buffer */
+                    && paParms[4].type != VBOX_HGCM_SVC_PARM_PAGES)
                     )
             {
                 rc = VERR_INVALID_PARAMETER;
@@ -599,11 +693,11 @@ static DECLCALLBACK(void) svcCall (void *, VBOXHGCMCALLHANDLE callHandle, uint32
                 SHFLHANDLE Handle  = paParms[1].u.uint64;
                 uint64_t   offset  = paParms[2].u.uint64;
                 uint32_t   count   = paParms[3].u.uint32;
-                uint8_t   *pBuffer = (uint8_t *)paParms[4].u.pointer.addr;
+                SHFLIOBUF  IoBuf;
 
                 /* Verify parameters values. */
                 if (   Handle == SHFL_HANDLE_ROOT
-                    || count > paParms[4].u.pointer.size
+                    || count > paParms[4].getBufferSize()
                    )
                 {
                     rc = VERR_INVALID_PARAMETER;
@@ -623,7 +717,12 @@ static DECLCALLBACK(void) svcCall (void *, VBOXHGCMCALLHANDLE callHandle, uint32
                         pStatusLed->Asserted.s.fWriting = pStatusLed->Actual.s.fWriting = 1;
                     }
 
-                    rc = vbsfWrite (pClient, root, Handle, offset, &count, pBuffer);
+                    rc = svcCallGetIoBuffer(&paParms[4], VBOX_HGCM_F_PARM_DIRECTION_TO_HOST, count, &IoBuf);
+                    if (RT_SUCCESS(rc))
+                    {
+                        rc = vbsfWrite (pClient, root, Handle, offset, &count, &IoBuf.SgBuf);
+                        svcCallReleaseIoBuffer(&IoBuf);
+                    }
                     if (pStatusLed)
                         pStatusLed->Actual.s.fWriting = 0;
 
@@ -988,6 +1087,7 @@ static DECLCALLBACK(void) svcCall (void *, VBOXHGCMCALLHANDLE callHandle, uint32
                 SHFLROOT    root       = (SHFLROOT)paParms[0].u.uint32;
 
                 /* Execute the function. */
+                vbsfWorkersDrainRoot(root);
                 rc = vbsfUnmapFolder (pClient, root);
 
                 if (RT_SUCCESS(rc))
@@ -1261,6 +1361,102 @@ static DECLCALLBACK(void) svcCall (void *, VBOXHGCMCALLHANDLE callHandle, uint32
         }
     }
 
+    return rc;
+}
+
+/**
+ * Worker thread callback executing a queued call.
+ */
+static DECLCALLBACK(void) svcCallWorker (PVBSFWORKITEM pItem)
+{
+    int rc = svcCallExecute (pItem->pClient, pItem->u32Function, pItem->cParms, pItem->paParms);
+
+    LogFlow(("SharedFolders host service: svcCallWorker: fn = %u, rc=%Rrc\n", pItem->u32Function, rc));
+
+    g_pHelpers->pfnCallComplete (pItem->hCall, rc);
+}
+
+#ifdef UNITTEST
+/** Lets the unit test run the blocking calls on @a cWorkers threads. */
+int svcTestSetWorkers(uint32_t cWorkers)
+{
+    vbsfWorkersTerm();
+    return vbsfWorkersInit(cWorkers, svcCallWorker);
+}
+#endif
+
+/**
+ * Checks whether a call may block in the host file system, so it has to go to
+ * a worker.
+ *
+ * @returns true if the call is to be queued.
+ * @param   pHandle     Where to return the handle the call operates on, which
+ *                      selects the worker. SHFL_HANDLE_NIL for path based
+ *                      calls, any worker will do for them.
+ */
+static bool svcCallIsBlocking (uint32_t u32Function, uint32_t cParms, VBOXHGCMSVCPARM paParms[], SHFLHANDLE *pHandle)
+{
+    switch (u32Function)
+    {
+        case SHFL_FN_READ:
+        case SHFL_FN_WRITE:
+        case SHFL_FN_LOCK:
+        case SHFL_FN_LIST:
+        case SHFL_FN_INFORMATION:
+        case SHFL_FN_FLUSH:
+        case SHFL_FN_CLOSE:
+            /* Malformed calls are rejected right away by svcCallExecute. */
+            if (   cParms < 2
+                || paParms[1].type != VBOX_HGCM_SVC_PARM_64BIT)
+                return false;
+            *pHandle = paParms[1].u.uint64;
+            return true;
+        case SHFL_FN_CREATE:
+        case SHFL_FN_REMOVE:
+        case SHFL_FN_RENAME:
+        case SHFL_FN_SYMLINK:
+        case SHFL_FN_READLINK:
+            /* Malformed calls are rejected by svcCallExecute on the worker. */
+            *pHandle = SHFL_HANDLE_NIL;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static DECLCALLBACK(void) svcCall (void *, VBOXHGCMCALLHANDLE callHandle, uint32_t u32ClientID, void *pvClient, uint32_t u32Function, uint32_t cParms, VBOXHGCMSVCPARM paParms[])
+{
+    int rc = VINF_SUCCESS;
+
+    Log(("SharedFolders host service: svcCall: u32ClientID = %u, fn = %u, cParms = %u, pparms = %p\n", u32ClientID, u32Function, cParms, paParms));
+
+    SHFLCLIENTDATA *pClient = (SHFLCLIENTDATA *)pvClient;
+
+    bool fAsynchronousProcessing = false;
+
+#ifdef DEBUG
+    uint32_t i;
+
+    for (i = 0; i < cParms; i++)
+    {
+        /** @todo parameters other than 32 bit */
+        Log(("    pparms[%d]: type %u, value %u\n", i, paParms[i].type, paParms[i].u.uint32));
+    }
+#endif
+
+    SHFLHANDLE Handle;
+    if (   vbsfWorkersActive()
+        && svcCallIsBlocking (u32Function, cParms, paParms, &Handle))
+    {
+        /* Completed by the worker. Calls for the same handle stay in order. */
+        SHFLROOT root = cParms >= 1 && paParms[0].type == VBOX_HGCM_SVC_PARM_32BIT
+                      ? (SHFLROOT)paParms[0].u.uint32 : SHFL_ROOT_NIL;
+        rc = vbsfWorkerQueue (pClient, root, Handle, callHandle, u32Function, cParms, paParms);
+        fAsynchronousProcessing = RT_SUCCESS(rc);
+    }
+    else
+        rc = svcCallExecute (pClient, u32Function, cParms, paParms);
+
     LogFlow(("SharedFolders host service: svcCall: rc=%Rrc\n", rc));
 
     if (   !fAsynchronousProcessing
@@ -1350,6 +1546,7 @@ static DECLCALLBACK(int) svcHostCall (void *, uint32_t u32Function, uint32_t cPa
                     /* Update parameters.*/
                     ; /* none */
                 }
+                vbsfCacheFlush();
             }
         }
         if (RT_FAILURE(rc))
@@ -1386,7 +1583,11 @@ static DECLCALLBACK(int) svcHostCall (void *, uint32_t u32Function, uint32_t cPa
             else
             {
                 /* Execute the function. */
+                SHFLROOT root = vbsfMappingsQueryRootByName(pString);
+                if (root != SHFL_ROOT_NIL)
+                    vbsfWorkersDrainRoot(root);
                 rc = vbsfMappingsRemove (pString);
+                vbsfCacheFlush();
 
                 if (RT_SUCCESS(rc))
                 {
@@ -1482,6 +1683,11 @@ extern "C" DECLCALLBACK(DECLEXPORT(int)) VBoxHGCMSvcLoad (VBOXHGCMSVCFNTABLE *pt
             ptable->pfnSaveState  = svcSaveState;
             ptable->pfnLoadState  = svcLoadState;
             ptable->pvService     = NULL;
+
+            /* READ and WRITE only copy the bytes transferred, all other
+             * functions expect plain pointers. */
+            ptable->fFlags              = VBOX_HGCM_SVC_F_PAGE_LISTS;
+            ptable->bmPageListFunctions = RT_BIT_64(SHFL_FN_READ) | RT_BIT_64(SHFL_FN_WRITE);
         }
 
         /* Init handle table */
@@ -1489,6 +1695,26 @@ extern "C" DECLCALLBACK(DECLEXPORT(int)) VBoxHGCMSvcLoad (VBOXHGCMSVCFNTABLE *pt
         AssertRC(rc);
 
         vbsfMappingInit();
+
+#ifndef UNITTEST
+        /* The unit tests expect the calls to complete synchronously and
+         * start the workers themselves where needed.  Without workers the
+         * calls are executed on the service thread, as they used to be. */
+        if (RT_SUCCESS(rc))
+        {
+            int rc2 = vbsfWorkersInit(VBSF_WORKERS_DEFAULT, svcCallWorker);
+            if (RT_FAILURE(rc2))
+                LogRel(("SharedFolders host service: executing all calls on the service thread\n"));
+        }
+
+        /* The service works without the cache, just slower. */
+        if (RT_SUCCESS(rc))
+        {
+            int rc2 = vbsfCacheInit();
+            if (RT_FAILURE(rc2))
+                LogRel(("SharedFolders host service: metadata cache disabled, rc=%Rrc\n", rc2));
+        }
+#endif
     }
 
     return rc;
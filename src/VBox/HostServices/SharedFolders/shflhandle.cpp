@@ -123,6 +123,11 @@ SHFLHANDLE  vbsfAllocHandle(PSHFLCLIENTDATA pClient, uint32_t uType,
 
 static int vbsfFreeHandle(PSHFLCLIENTDATA pClient, SHFLHANDLE handle)
 {
+    int rc = VERR_INVALID_HANDLE;
+
+    /* Handles are closed on the worker threads while the service thread
+     * allocates new ones. */
+    RTCritSectEnter(&lock);
     if (   handle < SHFLHANDLE_MAX
         && (pHandles[handle].uFlags & SHFL_HF_VALID)
         && pHandles[handle].pClient == pClient)
@@ -130,9 +135,10 @@ static int vbsfFreeHandle(PSHFLCLIENTDATA pClient, SHFLHANDLE handle)
         pHandles[handle].uFlags     = 0;
         pHandles[handle].pvUserData = 0;
         pHandles[handle].pClient    = 0;
-        return VINF_SUCCESS;
+        rc = VINF_SUCCESS;
     }
-    return VERR_INVALID_HANDLE;
+    RTCritSectLeave(&lock);
+    return rc;
 }
 
 uintptr_t vbsfQueryHandle(PSHFLCLIENTDATA pClient, SHFLHANDLE handle,
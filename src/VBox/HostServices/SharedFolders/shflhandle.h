@@ -22,6 +22,7 @@
 #include "shfl.h"
 #include <VBox/shflsvc.h>
 #include <iprt/dir.h>
+#include "vbsfcache.h"
 
 #define SHFL_HF_TYPE_MASK       (0x000000FF)
 #define SHFL_HF_TYPE_DIR        (0x00000001)
@@ -48,12 +49,17 @@ typedef struct _SHFLFILEHANDLE
         struct
         {
             RTFILE        Handle;
+            char         *pszPath;         /* host path, for invalidating the cache */
         } file;
         struct
         {
             PRTDIR        Handle;
             PRTDIR        SearchHandle;
             PRTDIRENTRYEX pLastValidEntry; /* last found file in a directory search */
+            char         *pszPath;         /* host path of the directory */
+            PVBSFCACHEDIRLIST pCacheList;  /* cached listing being returned */
+            uint32_t      offCacheList;    /* read position in pCacheList */
+            PVBSFCACHEDIRLIST pCacheNew;   /* listing being recorded */
         } dir;
     };
 } SHFLFILEHANDLE;
@@ -28,14 +28,20 @@
 
 #include "tstSharedFolderService.h"
 #include "vbsf.h"
+#include "vbsfworker.h"
+#include "vbsfcache.h"
 
+#include <iprt/asm.h>
 #include <iprt/fs.h>
 #include <iprt/dir.h>
 #include <iprt/file.h>
 #include <iprt/path.h>
+#include <iprt/semaphore.h>
 #include <iprt/symlink.h>
 #include <iprt/stream.h>
 #include <iprt/test.h>
+#include <iprt/thread.h>
+#include <iprt/time.h>
 
 #include "teststubs.h"
 
@@ -44,12 +50,15 @@
 *   Global Variables                                                                                                             *
 *********************************************************************************************************************************/
 static RTTEST g_hTest = NIL_RTTEST;
+/** Signalled by callComplete, for calls completed on a worker thread. */
+static RTSEMEVENT g_hEvtCallComplete = NIL_RTSEMEVENT;
 
 
 /*********************************************************************************************************************************
 *   Declarations                                                                                                                 *
 *********************************************************************************************************************************/
 extern "C" DECLCALLBACK(DECLEXPORT(int)) VBoxHGCMSvcLoad (VBOXHGCMSVCFNTABLE *ptable);
+extern int svcTestSetWorkers(uint32_t cWorkers);
 
 
 /*********************************************************************************************************************************
@@ -61,12 +70,27 @@ struct VBOXHGCMCALLHANDLE_TYPEDEF
 {
     /** Where to store the result code */
     int32_t rc;
+    /** Set when the call has been completed */
+    bool volatile fCompleted;
+    /** When the call was completed (RTTimeNanoTS) */
+    uint64_t nsCompleted;
 };
 
 /** Call completion callback for guest calls. */
 static DECLCALLBACK(void) callComplete(VBOXHGCMCALLHANDLE callHandle, int32_t rc)
 {
     callHandle->rc = rc;
+    callHandle->nsCompleted = RTTimeNanoTS();
+    ASMAtomicWriteBool(&callHandle->fCompleted, true);
+    if (g_hEvtCallComplete != NIL_RTSEMEVENT)
+        RTSemEventSignal(g_hEvtCallComplete);
+}
+
+/** Waits for a call which may be completed on a worker thread. */
+static void waitForCall(VBOXHGCMCALLHANDLE callHandle)
+{
+    while (!ASMAtomicReadBool(&callHandle->fCompleted))
+        RTSemEventWait(g_hEvtCallComplete, 10);
 }
 
 /**
@@ -147,10 +171,13 @@ extern int testRTDirOpen(PRTDIR *ppDir, const char *pszPath)
     return VINF_SUCCESS;
 }
 
+static unsigned testRTDirOpenFilteredCalls;
+
 /** @todo Do something useful with the last two arguments. */
 extern int testRTDirOpenFiltered(PRTDIR *ppDir, const char *pszPath, RTDIRFILTER, uint32_t)
 {
  /* RTPrintf("%s: pszPath=%s\n", __PRETTY_FUNCTION__, pszPath); */
+    testRTDirOpenFilteredCalls++;
     ARRAY_FROM_PATH(testRTDirOpenName, pszPath);
     *ppDir = testRTDirOpenpDir;
     testRTDirOpenpDir = 0;
@@ -281,10 +308,19 @@ extern int  testRTFileQueryInfo(RTFILE hFile, PRTFSOBJINFO pObjInfo, RTFSOBJATTR
 }
 
 static const char *testRTFileReadData;
+/** Simulated host file system latency for the worker tests. */
+static uint32_t volatile testRTFileReadLatencyMs;
 
 extern int  testRTFileRead(RTFILE File, void *pvBuf, size_t cbToRead,
                             size_t *pcbRead)
 {
+    if (testRTFileReadLatencyMs)
+    {
+        RTThreadSleep(testRTFileReadLatencyMs);
+        if (pcbRead)
+            *pcbRead = cbToRead;
+        return VINF_SUCCESS;
+    }
  /* RTPrintf("%s : File=%p, cbToRead=%llu\n", __PRETTY_FUNCTION__, File,
              LLUIFY(cbToRead)); */
     bufferFromPath(pvBuf, cbToRead, testRTFileReadData);
@@ -294,6 +330,16 @@ extern int  testRTFileRead(RTFILE File, void *pvBuf, size_t cbToRead,
     return VINF_SUCCESS;
 }
 
+extern int testRTFileSgReadAt(RTFILE hFile, RTFOFF off, PRTSGBUF pSgBuf, size_t cbToRead,
+                              size_t *pcbRead)
+{
+    /* One segment at a time, the caller continues after a short read. */
+    size_t cbSeg = cbToRead;
+    void *pvSeg = RTSgBufGetNextSegment(pSgBuf, &cbSeg);
+    NOREF(off);
+    return testRTFileRead(hFile, pvSeg, cbSeg, pcbRead);
+}
+
 extern int testRTFileSeek(RTFILE hFile, int64_t offSeek, unsigned uMethod,
                            uint64_t *poffActual)
 {
@@ -373,6 +419,15 @@ extern int  testRTFileWrite(RTFILE File, const void *pvBuf, size_t cbToWrite,
     return VINF_SUCCESS;
 }
 
+extern int testRTFileSgWriteAt(RTFILE hFile, RTFOFF off, PRTSGBUF pSgBuf, size_t cbToWrite,
+                               size_t *pcbWritten)
+{
+    size_t cbSeg = cbToWrite;
+    void *pvSeg = RTSgBufGetNextSegment(pSgBuf, &cbSeg);
+    NOREF(off);
+    return testRTFileWrite(hFile, pvSeg, cbSeg, pcbWritten);
+}
+
 extern int testRTFsQueryProperties(const char *pszFsPath,
                                       PRTFSPROPERTIES pProperties)
 {
@@ -389,6 +444,9 @@ extern int testRTFsQuerySizes(const char *pszFsPath, PRTFOFF pcbTotal,
                                  RTFOFF *pcbFree, uint32_t *pcbBlock,
                                  uint32_t *pcbSector) { RTPrintf("%s\n", __PRETTY_FUNCTION__); return 0; }
 
+static unsigned testRTPathQueryInfoExCalls;
+static int testRTPathQueryInfoExRc = VINF_SUCCESS;
+
 extern int testRTPathQueryInfoEx(const char *pszPath,
                                     PRTFSOBJINFO pObjInfo,
                                     RTFSOBJATTRADD enmAdditionalAttribs,
@@ -397,8 +455,9 @@ extern int testRTPathQueryInfoEx(const char *pszPath,
  /* RTPrintf("%s: pszPath=%s, enmAdditionalAttribs=0x%x, fFlags=0x%x\n",
              __PRETTY_FUNCTION__, pszPath, (unsigned) enmAdditionalAttribs,
              (unsigned) fFlags); */
+    testRTPathQueryInfoExCalls++;
     RT_ZERO(*pObjInfo);
-    return VINF_SUCCESS;
+    return testRTPathQueryInfoExRc;
 }
 
 extern int testRTSymlinkDelete(const char *pszSymlink, uint32_t fDelete)
@@ -642,6 +701,20 @@ static int flushFile(VBOXHGCMSVCFNTABLE *psvcTable, SHFLROOT root,
     return callHandle.rc;
 }
 
+static int closeFile(VBOXHGCMSVCFNTABLE *psvcTable, SHFLROOT root,
+                     SHFLHANDLE handle)
+{
+    VBOXHGCMSVCPARM aParms[SHFL_CPARMS_CLOSE];
+    VBOXHGCMCALLHANDLE_TYPEDEF callHandle = { VINF_SUCCESS };
+
+    aParms[0].setUInt32(root);
+    aParms[1].setUInt64(handle);
+    psvcTable->pfnCall(psvcTable->pvService, &callHandle, 0,
+                       psvcTable->pvService, SHFL_FN_CLOSE,
+                       SHFL_CPARMS_CLOSE, aParms);
+    return callHandle.rc;
+}
+
 static int listDir(VBOXHGCMSVCFNTABLE *psvcTable, SHFLROOT root,
                    SHFLHANDLE handle, uint32_t fFlags, uint32_t cb,
                    const char *pcszPath, void *pvBuf, uint32_t cbBuf,
@@ -1113,6 +1186,343 @@ void testLockFileSimple(RTTEST hTest)
 }
 
 
+/** The number of files read concurrently by testWorkersBenchmark(). */
+#define TST_BENCH_FILES     16
+/** The number of reads per file by testWorkersBenchmark(). */
+#define TST_BENCH_ROUNDS    32
+/** The size of a read by testWorkersBenchmark(). */
+#define TST_BENCH_READ_SIZE _64K
+
+/**
+ * Checks that the workers execute the calls for a handle in the order they
+ * were queued.
+ */
+static void testWorkersOrdering(RTTEST hTest)
+{
+    VBOXHGCMSVCFNTABLE  svcTable;
+    VBOXHGCMSVCHELPERS  svcHelpers;
+    SHFLROOT Root;
+    SHFLHANDLE Handle;
+    static char s_aszData[64][8];
+    VBOXHGCMSVCPARM aaParms[RT_ELEMENTS(s_aszData)][SHFL_CPARMS_WRITE];
+    VBOXHGCMCALLHANDLE_TYPEDEF aCalls[RT_ELEMENTS(s_aszData)];
+    int rc;
+
+    RTTestSub(hTest, "Worker call ordering");
+    Root = initWithWritableMapping(hTest, &svcTable, &svcHelpers,
+                                   "/test/mapping", "testname");
+    testRTFileOpenpFile = (RTFILE) 0x10000;
+    rc = createFile(&svcTable, Root, "/test/file", SHFL_CF_ACCESS_WRITE,
+                    &Handle, NULL);
+    RTTEST_CHECK_RC_OK(hTest, rc);
+    RTTEST_CHECK_RC_OK(hTest, svcTestSetWorkers(VBSF_WORKERS_DEFAULT));
+    for (unsigned i = 0; i < RT_ELEMENTS(s_aszData); i++)
+    {
+        RTStrPrintf(s_aszData[i], sizeof(s_aszData[i]), "w%u", i);
+        uint32_t cb = (uint32_t)strlen(s_aszData[i]) + 1;
+        aaParms[i][0].setUInt32(Root);
+        aaParms[i][1].setUInt64((uint64_t) Handle);
+        aaParms[i][2].setUInt64(0);
+        aaParms[i][3].setUInt32(cb);
+        aaParms[i][4].setPointer(s_aszData[i], cb);
+        RT_ZERO(aCalls[i]);
+        svcTable.pfnCall(svcTable.pvService, &aCalls[i], 0,
+                         svcTable.pvService, SHFL_FN_WRITE,
+                         SHFL_CPARMS_WRITE, aaParms[i]);
+    }
+    for (unsigned i = 0; i < RT_ELEMENTS(s_aszData); i++)
+    {
+        waitForCall(&aCalls[i]);
+        RTTEST_CHECK_RC_OK(hTest, aCalls[i].rc);
+    }
+    /* The stub keeps what was written last. */
+    RTTEST_CHECK_MSG(hTest,
+                     !strcmp(testRTFileWriteData,
+                             s_aszData[RT_ELEMENTS(s_aszData) - 1]),
+                     (hTest, "pvBuf=%s\n", testRTFileWriteData));
+    unmapAndRemoveMapping(hTest, &svcTable, Root, "testname");
+    AssertReleaseRC(svcTable.pfnDisconnect(NULL, 0, svcTable.pvService));
+    RTTEST_CHECK_RC_OK(hTest, svcTestSetWorkers(0));
+    RTTestGuardedFree(hTest, svcTable.pvService);
+}
+
+/**
+ * Checks that path based calls are queued to the workers and completed
+ * from there.
+ */
+static void testWorkersPathCalls(RTTEST hTest)
+{
+    VBOXHGCMSVCFNTABLE  svcTable;
+    VBOXHGCMSVCHELPERS  svcHelpers;
+    SHFLROOT Root;
+    VBOXHGCMSVCPARM aParms[SHFL_CPARMS_CREATE];
+    struct TESTSHFLSTRING Path;
+    SHFLCREATEPARMS CreateParms;
+    VBOXHGCMCALLHANDLE_TYPEDEF Call;
+
+    RTTestSub(hTest, "Worker path based calls");
+    Root = initWithWritableMapping(hTest, &svcTable, &svcHelpers,
+                                   "/test/mapping", "testname");
+    testRTFileOpenpFile = (RTFILE) 0x10000;
+    RTTEST_CHECK_RC_OK(hTest, svcTestSetWorkers(VBSF_WORKERS_DEFAULT));
+    fillTestShflString(&Path, "/test/file");
+    RT_ZERO(CreateParms);
+    CreateParms.Handle      = SHFL_HANDLE_NIL;
+    CreateParms.CreateFlags = SHFL_CF_ACCESS_READ;
+    aParms[0].setUInt32(Root);
+    aParms[1].setPointer(&Path,   RT_UOFFSETOF(SHFLSTRING, String)
+                                + Path.string.u16Size);
+    aParms[2].setPointer(&CreateParms, sizeof(CreateParms));
+    RT_ZERO(Call);
+    svcTable.pfnCall(svcTable.pvService, &Call, 0,
+                     svcTable.pvService, SHFL_FN_CREATE,
+                     RT_ELEMENTS(aParms), aParms);
+    waitForCall(&Call);
+    RTTEST_CHECK_RC_OK(hTest, Call.rc);
+    RTTEST_CHECK(hTest, CreateParms.Handle != SHFL_HANDLE_NIL);
+    /* Back to synchronous calls for the helpers below. */
+    RTTEST_CHECK_RC_OK(hTest, svcTestSetWorkers(0));
+    if (CreateParms.Handle != SHFL_HANDLE_NIL)
+        closeFile(&svcTable, Root, CreateParms.Handle);
+    unmapAndRemoveMapping(hTest, &svcTable, Root, "testname");
+    AssertReleaseRC(svcTable.pfnDisconnect(NULL, 0, svcTable.pvService));
+    RTTestGuardedFree(hTest, svcTable.pvService);
+}
+
+/**
+ * Reads from a number of files at once with a simulated host latency and
+ * reports the throughput and the mean latency of the calls.
+ */
+static void testWorkersBenchmark(RTTEST hTest, uint32_t cWorkers)
+{
+    VBOXHGCMSVCFNTABLE  svcTable;
+    VBOXHGCMSVCHELPERS  svcHelpers;
+    SHFLROOT Root;
+    SHFLHANDLE aHandles[TST_BENCH_FILES];
+    VBOXHGCMSVCPARM aaParms[TST_BENCH_FILES][SHFL_CPARMS_READ];
+    VBOXHGCMCALLHANDLE_TYPEDEF aCalls[TST_BENCH_FILES];
+    uint64_t ansSubmitted[TST_BENCH_FILES];
+    uint64_t cNsLatency = 0;
+    int rc;
+
+    uint8_t *pbBuf = (uint8_t *)RTTestGuardedAllocTail(hTest, TST_BENCH_FILES * TST_BENCH_READ_SIZE);
+    RTTEST_CHECK_RETV(hTest, pbBuf);
+    Root = initWithWritableMapping(hTest, &svcTable, &svcHelpers,
+                                   "/test/mapping", "testname");
+    testRTFileOpenpFile = (RTFILE) 0x10000;
+    for (unsigned i = 0; i < TST_BENCH_FILES; i++)
+    {
+        rc = createFile(&svcTable, Root, "/test/file", SHFL_CF_ACCESS_READ,
+                        &aHandles[i], NULL);
+        RTTEST_CHECK_RC_OK(hTest, rc);
+    }
+    RTTEST_CHECK_RC_OK(hTest, svcTestSetWorkers(cWorkers));
+    testRTFileReadLatencyMs = 1;
+
+    uint64_t const nsStart = RTTimeNanoTS();
+    for (unsigned iRound = 0; iRound < TST_BENCH_ROUNDS; iRound++)
+    {
+        for (unsigned i = 0; i < TST_BENCH_FILES; i++)
+        {
+            aaParms[i][0].setUInt32(Root);
+            aaParms[i][1].setUInt64((uint64_t) aHandles[i]);
+            aaParms[i][2].setUInt64((uint64_t)iRound * TST_BENCH_READ_SIZE);
+            aaParms[i][3].setUInt32(TST_BENCH_READ_SIZE);
+            aaParms[i][4].setPointer(pbBuf + i * TST_BENCH_READ_SIZE, TST_BENCH_READ_SIZE);
+            RT_ZERO(aCalls[i]);
+            ansSubmitted[i] = RTTimeNanoTS();
+            svcTable.pfnCall(svcTable.pvService, &aCalls[i], 0,
+                             svcTable.pvService, SHFL_FN_READ,
+                             SHFL_CPARMS_READ, aaParms[i]);
+        }
+        for (unsigned i = 0; i < TST_BENCH_FILES; i++)
+        {
+            waitForCall(&aCalls[i]);
+            RTTEST_CHECK_RC_OK(hTest, aCalls[i].rc);
+            RTTEST_CHECK(hTest, aaParms[i][3].u.uint32 == TST_BENCH_READ_SIZE);
+            cNsLatency += aCalls[i].nsCompleted - ansSubmitted[i];
+        }
+    }
+    uint64_t const cNsElapsed = RTTimeNanoTS() - nsStart;
+    uint64_t const cCalls     = TST_BENCH_FILES * TST_BENCH_ROUNDS;
+
+    testRTFileReadLatencyMs = 0;
+    RTTestValueF(hTest, cCalls * RT_NS_1SEC / cNsElapsed, RTTESTUNIT_CALLS_PER_SEC,
+                 "Read, %u workers", cWorkers);
+    RTTestValueF(hTest, cCalls * TST_BENCH_READ_SIZE * RT_NS_1SEC / cNsElapsed, RTTESTUNIT_BYTES_PER_SEC,
+                 "Read throughput, %u workers", cWorkers);
+    RTTestValueF(hTest, cNsLatency / cCalls, RTTESTUNIT_NS_PER_CALL,
+                 "Read latency, %u workers", cWorkers);
+
+    unmapAndRemoveMapping(hTest, &svcTable, Root, "testname");
+    AssertReleaseRC(svcTable.pfnDisconnect(NULL, 0, svcTable.pvService));
+    RTTEST_CHECK_RC_OK(hTest, svcTestSetWorkers(0));
+    RTTestGuardedFree(hTest, svcTable.pvService);
+    RTTestGuardedFree(hTest, pbBuf);
+}
+
+/**
+ * Checks that lookups are served from the cache and that changes made thru
+ * the service invalidate it.
+ */
+static void testCacheLookup(RTTEST hTest)
+{
+    VBOXHGCMSVCFNTABLE  svcTable;
+    VBOXHGCMSVCHELPERS  svcHelpers;
+    SHFLROOT Root;
+    SHFLHANDLE Handle;
+    SHFLCREATERESULT Result;
+    uint32_t cbWritten;
+    int rc;
+
+    RTTestSub(hTest, "Cached lookups");
+    Root = initWithWritableMapping(hTest, &svcTable, &svcHelpers,
+                                   "/test/mapping", "testname");
+    RTTEST_CHECK_RC_OK(hTest, vbsfCacheInit());
+    testRTFileOpenpFile = (RTFILE) 0x10000;
+    rc = createFile(&svcTable, Root, "/test/file", SHFL_CF_ACCESS_WRITE,
+                    &Handle, NULL);
+    RTTEST_CHECK_RC_OK(hTest, rc);
+
+    unsigned const cCallsStart = testRTPathQueryInfoExCalls;
+    rc = createFile(&svcTable, Root, "/test/file", SHFL_CF_LOOKUP, NULL,
+                    &Result);
+    RTTEST_CHECK_RC_OK(hTest, rc);
+    RTTEST_CHECK(hTest, Result == SHFL_FILE_EXISTS);
+    rc = createFile(&svcTable, Root, "/test/file", SHFL_CF_LOOKUP, NULL,
+                    &Result);
+    RTTEST_CHECK_RC_OK(hTest, rc);
+    RTTEST_CHECK(hTest, Result == SHFL_FILE_EXISTS);
+    RTTEST_CHECK_MSG(hTest, testRTPathQueryInfoExCalls == cCallsStart + 1,
+                     (hTest, "cCalls=%u\n", testRTPathQueryInfoExCalls - cCallsStart));
+
+    /* Writing changes the size and the modification time. */
+    rc = writeFile(&svcTable, Root, Handle, 0, 5, &cbWritten, "data", 5);
+    RTTEST_CHECK_RC_OK(hTest, rc);
+    rc = createFile(&svcTable, Root, "/test/file", SHFL_CF_LOOKUP, NULL,
+                    &Result);
+    RTTEST_CHECK_RC_OK(hTest, rc);
+    RTTEST_CHECK_MSG(hTest, testRTPathQueryInfoExCalls == cCallsStart + 2,
+                     (hTest, "cCalls=%u\n", testRTPathQueryInfoExCalls - cCallsStart));
+
+    /* Nothing watches the directory here, so the host could create the file
+     * at any time and not found must not be cached. */
+    testRTPathQueryInfoExRc = VERR_FILE_NOT_FOUND;
+    unsigned const cCallsMissing = testRTPathQueryInfoExCalls;
+    rc = createFile(&svcTable, Root, "/test/missing", SHFL_CF_LOOKUP, NULL,
+                    &Result);
+    RTTEST_CHECK_RC_OK(hTest, rc);
+    unsigned const cCallsPerLookup = testRTPathQueryInfoExCalls - cCallsMissing;
+    rc = createFile(&svcTable, Root, "/test/missing", SHFL_CF_LOOKUP, NULL,
+                    &Result);
+    RTTEST_CHECK_RC_OK(hTest, rc);
+    RTTEST_CHECK_MSG(hTest,    cCallsPerLookup > 0
+                            && testRTPathQueryInfoExCalls == cCallsMissing + 2 * cCallsPerLookup,
+                     (hTest, "cCalls=%u/%u\n", testRTPathQueryInfoExCalls - cCallsMissing, cCallsPerLookup));
+    testRTPathQueryInfoExRc = VINF_SUCCESS;
+
+    unmapAndRemoveMapping(hTest, &svcTable, Root, "testname");
+    AssertReleaseRC(svcTable.pfnDisconnect(NULL, 0, svcTable.pvService));
+    vbsfCacheTerm();
+    RTTestGuardedFree(hTest, svcTable.pvService);
+}
+
+/**
+ * Checks that a repeated search is served from the cached listing.
+ */
+static void testCacheDirList(RTTEST hTest)
+{
+    VBOXHGCMSVCFNTABLE  svcTable;
+    VBOXHGCMSVCHELPERS  svcHelpers;
+    SHFLROOT Root;
+    SHFLHANDLE Handle;
+    SHFLDIRINFO DirInfo;
+    uint32_t cFiles;
+    int rc;
+
+    RTTestSub(hTest, "Cached directory listing");
+    Root = initWithWritableMapping(hTest, &svcTable, &svcHelpers,
+                                   "/test/mapping", "testname");
+    RTTEST_CHECK_RC_OK(hTest, vbsfCacheInit());
+    unsigned const cCallsStart = testRTDirOpenFilteredCalls;
+    for (unsigned i = 0; i < 2; i++)
+    {
+        testRTDirOpenpDir = (PRTDIR)0x10000;
+        rc = createFile(&svcTable, Root, "test/dir",
+                        SHFL_CF_DIRECTORY | SHFL_CF_ACCESS_READ, &Handle, NULL);
+        RTTEST_CHECK_RC_OK(hTest, rc);
+        testRTDirOpenpDir = (PRTDIR)0x20000;
+        rc = listDir(&svcTable, Root, Handle, 0, sizeof (SHFLDIRINFO), "test/dir/*",
+                     &DirInfo, sizeof(DirInfo), 0, &cFiles);
+        RTTEST_CHECK_RC(hTest, rc, VERR_NO_MORE_FILES);
+        RTTEST_CHECK_MSG(hTest, cFiles == 0,
+                         (hTest, "cFiles=%llu\n", LLUIFY(cFiles)));
+        closeFile(&svcTable, Root, Handle);
+    }
+    /* One for each directory handle, one for the first search only. */
+    RTTEST_CHECK_MSG(hTest, testRTDirOpenFilteredCalls == cCallsStart + 3,
+                     (hTest, "cCalls=%u\n", testRTDirOpenFilteredCalls - cCallsStart));
+
+    unmapAndRemoveMapping(hTest, &svcTable, Root, "testname");
+    AssertReleaseRC(svcTable.pfnDisconnect(NULL, 0, svcTable.pvService));
+    vbsfCacheTerm();
+    RTTestGuardedFree(hTest, svcTable.pvService);
+}
+
+/**
+ * Checks that searching with a trailing delimiter, i.e. without a filename
+ * part, works with the cache enabled.
+ */
+static void testCacheDirListTrailingDelimiter(RTTEST hTest)
+{
+    VBOXHGCMSVCFNTABLE  svcTable;
+    VBOXHGCMSVCHELPERS  svcHelpers;
+    SHFLROOT Root;
+    SHFLHANDLE Handle;
+    SHFLDIRINFO DirInfo;
+    uint32_t cFiles;
+    int rc;
+
+    RTTestSub(hTest, "Cached directory listing, trailing delimiter");
+    Root = initWithWritableMapping(hTest, &svcTable, &svcHelpers,
+                                   "/test/mapping", "testname");
+    RTTEST_CHECK_RC_OK(hTest, vbsfCacheInit());
+    for (unsigned i = 0; i < 2; i++)
+    {
+        testRTDirOpenpDir = (PRTDIR)0x10000;
+        rc = createFile(&svcTable, Root, "test/dir",
+                        SHFL_CF_DIRECTORY | SHFL_CF_ACCESS_READ, &Handle, NULL);
+        RTTEST_CHECK_RC_OK(hTest, rc);
+        testRTDirOpenpDir = (PRTDIR)0x20000;
+        rc = listDir(&svcTable, Root, Handle, 0, sizeof (SHFLDIRINFO), "test/dir/",
+                     &DirInfo, sizeof(DirInfo), 0, &cFiles);
+        RTTEST_CHECK_RC(hTest, rc, VERR_NO_MORE_FILES);
+        RTTEST_CHECK_MSG(hTest,
+                         !strcmp(testRTDirOpenName, "/test/mapping/test/dir/"),
+                         (hTest, "pszPath=%s\n", testRTDirOpenName));
+        closeFile(&svcTable, Root, Handle);
+    }
+
+    unmapAndRemoveMapping(hTest, &svcTable, Root, "testname");
+    AssertReleaseRC(svcTable.pfnDisconnect(NULL, 0, svcTable.pvService));
+    vbsfCacheTerm();
+    RTTestGuardedFree(hTest, svcTable.pvService);
+}
+
+static void testWorkers(RTTEST hTest)
+{
+    RTTEST_CHECK_RC_OK_RETV(hTest, RTSemEventCreate(&g_hEvtCallComplete));
+    testWorkersOrdering(hTest);
+    testWorkersPathCalls(hTest);
+    RTTestSub(hTest, "Worker benchmark");
+    testWorkersBenchmark(hTest, 0);
+    testWorkersBenchmark(hTest, 2);
+    testWorkersBenchmark(hTest, VBSF_WORKERS_DEFAULT);
+    RTSemEventDestroy(g_hEvtCallComplete);
+    g_hEvtCallComplete = NIL_RTSEMEVENT;
+}
+
+
 /*********************************************************************************************************************************
 *   Main code                                                                                                                    *
 *********************************************************************************************************************************/
@@ -1148,5 +1558,9 @@ int main(int argc, char **argv)
         return rcExit;
     RTTestBanner(g_hTest);
     testAPI(g_hTest);
+    testWorkers(g_hTest);
+    testCacheLookup(g_hTest);
+    testCacheDirList(g_hTest);
+    testCacheDirListTrailingDelimiter(g_hTest);
     return RTTestSummaryAndDestroy(g_hTest);
 }
@@ -24,6 +24,7 @@
 #define __VBSF_TEST_STUBS__H
 
 #include <iprt/dir.h>
+#include <iprt/sg.h>
 #include <iprt/time.h>
 
 #define RTDirClose           testRTDirClose
@@ -56,6 +57,10 @@ extern int testRTFileOpen(PRTFILE pFile, const char *pszFilename, uint64_t fOpen
 extern int testRTFileQueryInfo(RTFILE hFile, PRTFSOBJINFO pObjInfo, RTFSOBJATTRADD enmAdditionalAttribs);
 #define RTFileRead           testRTFileRead
 extern int testRTFileRead(RTFILE hFile, void *pvBuf, size_t cbToRead, size_t *pcbRead);
+#define RTFileSgReadAt       testRTFileSgReadAt
+extern int testRTFileSgReadAt(RTFILE hFile, RTFOFF off, PRTSGBUF pSgBuf, size_t cbToRead, size_t *pcbRead);
+#define RTFileSgWriteAt      testRTFileSgWriteAt
+extern int testRTFileSgWriteAt(RTFILE hFile, RTFOFF off, PRTSGBUF pSgBuf, size_t cbToWrite, size_t *pcbWritten);
 #define RTFileSetMode        testRTFileSetMode
 extern int testRTFileSetMode(RTFILE hFile, RTFMODE fMode);
 #define RTFileSetSize        testRTFileSetSize
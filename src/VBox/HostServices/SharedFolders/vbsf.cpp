@@ -23,6 +23,7 @@
 #include "mappings.h"
 #include "vbsf.h"
 #include "shflhandle.h"
+#include "vbsfcache.h"
 
 #include <iprt/alloc.h>
 #include <iprt/assert.h>
@@ -118,8 +119,27 @@ static int vbsfBuildFullPath(SHFLCLIENTDATA *pClient, SHFLROOT root, PSHFLSTRING
                            | (fWildCard? VBSF_O_PATH_WILDCARD: 0)
                            | (fPreserveLastComponent? VBSF_O_PATH_PRESERVE_LAST_COMPONENT: 0);
 
+    /* The translation depends on the options and on how the client encodes paths. */
+    uint32_t const fKey =   fu32Options
+                          | (BIT_FLAG(pClient->fu32Flags, SHFL_CF_UTF8) ? RT_BIT_32(8) : 0)
+                          | ((uint32_t)pClient->PathDelimiter << 16);
+    uint32_t cbFullPathRoot = 0;
+    uint32_t uNameGen;
+    if (vbsfCacheLookupPath(root, fKey, pPath, &pszHostPath, &cbFullPathRoot, &uNameGen))
+    {
+        if (pcbFullPathRoot)
+            *pcbFullPathRoot = cbFullPathRoot;
+        if (ppszFullPath)
+            *ppszFullPath = pszHostPath;
+        else
+            vbsfFreeHostPath(pszHostPath);
+        return VINF_SUCCESS;
+    }
+
     int rc = vbsfPathGuestToHost(pClient, root, pPath, cbPath,
-                                 &pszHostPath, pcbFullPathRoot, fu32Options, &fu32PathFlags);
+                                 &pszHostPath, &cbFullPathRoot, fu32Options, &fu32PathFlags);
+    if (pcbFullPathRoot)
+        *pcbFullPathRoot = cbFullPathRoot;
     if (BIT_FLAG(pClient->fu32Flags, SHFL_CF_UTF8))
     {
         LogRel2(("SharedFolders: GuestToHost 0x%RX32 [%.*s]->[%s] %Rrc\n", fu32PathFlags, pPath->u16Length, &pPath->String.utf8[0], pszHostPath, rc));
@@ -131,12 +151,27 @@ static int vbsfBuildFullPath(SHFLCLIENTDATA *pClient, SHFLROOT root, PSHFLSTRING
 
     if (RT_SUCCESS(rc))
     {
+        vbsfCacheEnterPath(root, fKey, pPath, pszHostPath, cbFullPathRoot, uNameGen);
         if (ppszFullPath)
             *ppszFullPath = pszHostPath;
     }
     return rc;
 }
 
+/**
+ * Queries the attributes of a host path, going thru the attribute cache.
+ */
+static int vbsfQueryPathInfo(SHFLCLIENTDATA *pClient, const char *pszPath, PRTFSOBJINFO pInfo)
+{
+    VBSFCACHETICKET Ticket;
+    int rc;
+    if (vbsfCacheLookupInfo(pszPath, SHFL_RT_LINK(pClient), pInfo, &rc, &Ticket))
+        return rc;
+    rc = RTPathQueryInfoEx(pszPath, pInfo, RTFSOBJATTRADD_NOTHING, SHFL_RT_LINK(pClient));
+    vbsfCacheEnterInfo(pszPath, SHFL_RT_LINK(pClient), rc, pInfo, &Ticket);
+    return rc;
+}
+
 static void vbsfFreeFullPath(char *pszFullPath)
 {
     vbsfFreeHostPath(pszFullPath);
@@ -535,6 +570,7 @@ static int vbsfOpenFile(SHFLCLIENTDATA *pClient, const char *pszPath, SHFLCREATE
     }
     else
     {
+        pHandle->file.pszPath = RTStrDup(pszPath);
         pParms->Handle = handle;
     }
 
@@ -651,6 +687,7 @@ static int vbsfOpenDir(SHFLCLIENTDATA *pClient, const char *pszPath,
     }
     else
     {
+        pHandle->dir.pszPath = RTStrDup(pszPath);
         pParms->Handle = handle;
     }
     LogFlow(("vbsfOpenDir: rc = %Rrc\n", rc));
@@ -675,6 +712,13 @@ static int vbsfCloseDir(SHFLFILEHANDLE *pHandle)
         pHandle->dir.pLastValidEntry = NULL;
     }
 
+    vbsfCacheDirListRelease(pHandle->dir.pCacheList);
+    pHandle->dir.pCacheList = NULL;
+    vbsfCacheDirListRelease(pHandle->dir.pCacheNew);
+    pHandle->dir.pCacheNew = NULL;
+    RTStrFree(pHandle->dir.pszPath);
+    pHandle->dir.pszPath = NULL;
+
     LogFlow(("vbsfCloseDir: rc = %d\n", rc));
 
     return rc;
@@ -690,6 +734,9 @@ static int vbsfCloseFile(SHFLFILEHANDLE *pHandle)
 
     rc = RTFileClose(pHandle->file.Handle);
 
+    RTStrFree(pHandle->file.pszPath);
+    pHandle->file.pszPath = NULL;
+
     LogFlow(("vbsfCloseFile: rc = %d\n", rc));
 
     return rc;
@@ -708,7 +755,7 @@ static int vbsfLookupFile(SHFLCLIENTDATA *pClient, char *pszPath, SHFLCREATEPARM
     RTFSOBJINFO info;
     int rc;
 
-    rc = RTPathQueryInfoEx(pszPath, &info, RTFSOBJATTRADD_NOTHING, SHFL_RT_LINK(pClient));
+    rc = vbsfQueryPathInfo(pClient, pszPath, &info);
     LogFlow(("SHFL_CF_LOOKUP\n"));
     /* Client just wants to know if the object exists. */
     switch (rc)
@@ -814,8 +861,8 @@ int vbsfCreate(SHFLCLIENTDATA *pClient, SHFLROOT root, SHFLSTRING *pPath, uint32
             /* Query path information. */
             RTFSOBJINFO info;
 
-            rc = RTPathQueryInfoEx(pszFullPath, &info, RTFSOBJATTRADD_NOTHING, SHFL_RT_LINK(pClient));
-            LogFlow(("RTPathQueryInfoEx returned %Rrc\n", rc));
+            rc = vbsfQueryPathInfo(pClient, pszFullPath, &info);
+            LogFlow(("vbsfQueryPathInfo returned %Rrc\n", rc));
 
             if (RT_SUCCESS(rc))
             {
@@ -875,6 +922,12 @@ int vbsfCreate(SHFLCLIENTDATA *pClient, SHFLROOT root, SHFLSTRING *pPath, uint32
                 {
                     rc = vbsfOpenFile(pClient, pszFullPath, pParms);
                 }
+
+                /* Let the cache know what we changed. */
+                if (pParms->Result == SHFL_FILE_CREATED)
+                    vbsfCacheInvalidateName(pszFullPath);
+                else if (pParms->Result == SHFL_FILE_REPLACED)
+                    vbsfCacheInvalidate(pszFullPath);
             }
             else
             {
@@ -945,13 +998,13 @@ void testRead(RTTEST hTest)
     /* Add tests as required... */
 }
 #endif
-int vbsfRead  (SHFLCLIENTDATA *pClient, SHFLROOT root, SHFLHANDLE Handle, uint64_t offset, uint32_t *pcbBuffer, uint8_t *pBuffer)
+int vbsfRead  (SHFLCLIENTDATA *pClient, SHFLROOT root, SHFLHANDLE Handle, uint64_t offset, uint32_t *pcbBuffer, PRTSGBUF pSgBuf)
 {
     SHFLFILEHANDLE *pHandle = vbsfQueryFileHandle(pClient, Handle);
     size_t count = 0;
-    int rc;
+    int rc = VINF_SUCCESS;
 
-    if (pHandle == 0 || pcbBuffer == 0 || pBuffer == 0)
+    if (pHandle == 0 || pcbBuffer == 0 || pSgBuf == 0)
     {
         AssertFailed();
         return VERR_INVALID_PARAMETER;
@@ -962,17 +1015,24 @@ int vbsfRead  (SHFLCLIENTDATA *pClient, SHFLROOT root, SHFLHANDLE Handle, uint64
     if (*pcbBuffer == 0)
         return VINF_SUCCESS; /* @todo correct? */
 
-
-    rc = RTFileSeek(pHandle->file.Handle, offset, RTFILE_SEEK_BEGIN, NULL);
-    if (rc != VINF_SUCCESS)
+    /* Large requests may be satisfied partially by some hosts and file
+     * systems, keep going until the buffer is full or we hit the end. */
+    while (count < *pcbBuffer)
     {
-        AssertRC(rc);
-        return rc;
-    }
+        size_t cbRead = 0;
+        rc = RTFileSgReadAt(pHandle->file.Handle, offset + count, pSgBuf, *pcbBuffer - count, &cbRead);
+        if (RT_FAILURE(rc) || !cbRead)
+            break;
+        count += cbRead;
 
-    rc = RTFileRead(pHandle->file.Handle, pBuffer, *pcbBuffer, &count);
+        /* A short read leaves the buffer at the end of the segment it stopped in. */
+        RTSgBufReset(pSgBuf);
+        RTSgBufAdvance(pSgBuf, count);
+    }
+    if (RT_FAILURE(rc) && count)
+        rc = VINF_SUCCESS; /* Return what we've got, the guest will ask for the rest again. */
     *pcbBuffer = (uint32_t)count;
-    Log(("RTFileRead returned %Rrc bytes read %x\n", rc, count));
+    Log(("RTFileSgReadAt returned %Rrc bytes read %x\n", rc, count));
     return rc;
 }
 
@@ -988,13 +1048,13 @@ void testWrite(RTTEST hTest)
     /* Add tests as required... */
 }
 #endif
-int vbsfWrite(SHFLCLIENTDATA *pClient, SHFLROOT root, SHFLHANDLE Handle, uint64_t offset, uint32_t *pcbBuffer, uint8_t *pBuffer)
+int vbsfWrite(SHFLCLIENTDATA *pClient, SHFLROOT root, SHFLHANDLE Handle, uint64_t offset, uint32_t *pcbBuffer, PRTSGBUF pSgBuf)
 {
     SHFLFILEHANDLE *pHandle = vbsfQueryFileHandle(pClient, Handle);
     size_t count = 0;
     int rc;
 
-    if (pHandle == 0 || pcbBuffer == 0 || pBuffer == 0)
+    if (pHandle == 0 || pcbBuffer == 0 || pSgBuf == 0)
     {
         AssertFailed();
         return VERR_INVALID_PARAMETER;
@@ -1012,16 +1072,23 @@ int vbsfWrite(SHFLCLIENTDATA *pClient, SHFLROOT root, SHFLHANDLE Handle, uint64_
     if (*pcbBuffer == 0)
         return VINF_SUCCESS; /** @todo correct? */
 
-    rc = RTFileSeek(pHandle->file.Handle, offset, RTFILE_SEEK_BEGIN, NULL);
-    if (rc != VINF_SUCCESS)
+    while (count < *pcbBuffer)
     {
-        AssertRC(rc);
-        return rc;
-    }
+        size_t cbWritten = 0;
+        rc = RTFileSgWriteAt(pHandle->file.Handle, offset + count, pSgBuf, *pcbBuffer - count, &cbWritten);
+        if (RT_FAILURE(rc) || !cbWritten)
+            break;
+        count += cbWritten;
 
-    rc = RTFileWrite(pHandle->file.Handle, pBuffer, *pcbBuffer, &count);
+        RTSgBufReset(pSgBuf);
+        RTSgBufAdvance(pSgBuf, count);
+    }
+    if (RT_FAILURE(rc) && count)
+        rc = VINF_SUCCESS;
+    if (count)
+        vbsfCacheInvalidate(pHandle->file.pszPath);
     *pcbBuffer = (uint32_t)count;
-    Log(("RTFileWrite returned %Rrc bytes written %x\n", rc, count));
+    Log(("RTFileSgWriteAt returned %Rrc bytes written %x\n", rc, count));
     return rc;
 }
 
@@ -1106,7 +1173,7 @@ int vbsfDirList(SHFLCLIENTDATA *pClient, SHFLROOT root, SHFLHANDLE Handle, SHFLS
 
     if (pPath)
     {
-        if (pHandle->dir.SearchHandle == 0)
+        if (pHandle->dir.SearchHandle == 0 && pHandle->dir.pCacheList == NULL)
         {
             /* Build a host full path for the given path
              * and convert ucs2 to utf8 if necessary.
@@ -1119,7 +1186,20 @@ int vbsfDirList(SHFLCLIENTDATA *pClient, SHFLROOT root, SHFLHANDLE Handle, SHFLS
 
             if (RT_SUCCESS(rc))
             {
-                rc = RTDirOpenFiltered(&pHandle->dir.SearchHandle, pszFullPath, RTDIRFILTER_WINNT, 0);
+                /* Serve the listing from the cache if the same search was done recently,
+                 * otherwise record it while reading. */
+                pHandle->dir.pCacheList   = vbsfCacheDirListGet(pszFullPath, SHFL_RT_LINK(pClient));
+                pHandle->dir.offCacheList = 0;
+                if (!pHandle->dir.pCacheList)
+                {
+                    /* A path with a trailing delimiter has no filename part, don't cache that. */
+                    const char *pszFilename = RTPathFilename(pszFullPath);
+                    rc = RTDirOpenFiltered(&pHandle->dir.SearchHandle, pszFullPath, RTDIRFILTER_WINNT, 0);
+                    if (RT_SUCCESS(rc) && pszFilename && pszFilename > pszFullPath)
+                        pHandle->dir.pCacheNew = vbsfCacheDirListBegin(pszFullPath,
+                                                                       pszFilename - pszFullPath - 1,
+                                                                       SHFL_RT_LINK(pClient));
+                }
 
                 /* free the path string */
                 vbsfFreeFullPath(pszFullPath);
@@ -1130,7 +1210,7 @@ int vbsfDirList(SHFLCLIENTDATA *pClient, SHFLROOT root, SHFLHANDLE Handle, SHFLS
             else
                 goto end;
         }
-        Assert(pHandle->dir.SearchHandle);
+        Assert(pHandle->dir.SearchHandle || pHandle->dir.pCacheList);
         DirHandle = pHandle->dir.SearchHandle;
     }
 
@@ -1148,7 +1228,29 @@ int vbsfDirList(SHFLCLIENTDATA *pClient, SHFLROOT root, SHFLHANDLE Handle, SHFLS
         {
             pDirEntry = pDirEntryOrg;
 
-            rc = RTDirReadEx(DirHandle, pDirEntry, &cbDirEntrySize, RTFSOBJATTRADD_NOTHING, SHFL_RT_LINK(pClient));
+            if (pHandle->dir.pCacheList)
+                rc = vbsfCacheDirListRead(pHandle->dir.pCacheList, &pHandle->dir.offCacheList, pDirEntry, cbDirEntry);
+            else
+            {
+                rc = RTDirReadEx(DirHandle, pDirEntry, &cbDirEntrySize, RTFSOBJATTRADD_NOTHING, SHFL_RT_LINK(pClient));
+                if (pHandle->dir.pCacheNew)
+                {
+                    if (rc == VINF_SUCCESS)
+                        vbsfCacheDirListAdd(pHandle->dir.pCacheNew, pDirEntry);
+                    else if (rc == VERR_NO_MORE_FILES)
+                    {
+                        vbsfCacheDirListPublish(pHandle->dir.pCacheNew);
+                        pHandle->dir.pCacheNew = NULL;
+                    }
+                    else if (   rc != VERR_NO_TRANSLATION
+                             && rc != VERR_INVALID_UTF8_ENCODING)
+                    {
+                        /* Incomplete, don't cache it. */
+                        vbsfCacheDirListRelease(pHandle->dir.pCacheNew);
+                        pHandle->dir.pCacheNew = NULL;
+                    }
+                }
+            }
             if (rc == VERR_NO_MORE_FILES)
             {
                 *pIndex = 0; /* listing completed */
@@ -1447,6 +1549,11 @@ static int vbsfSetFileInfo(SHFLCLIENTDATA *pClient, SHFLROOT root, SHFLHANDLE Ha
     }
     /* TODO: mode for directories */
 
+    if (type == SHFL_HF_TYPE_DIR)
+        vbsfCacheInvalidate(vbsfQueryDirHandle(pClient, Handle)->dir.pszPath);
+    else
+        vbsfCacheInvalidate(vbsfQueryFileHandle(pClient, Handle)->file.pszPath);
+
     if (rc == VINF_SUCCESS)
     {
         uint32_t bufsize = sizeof(*pSFDEntry);
@@ -1484,6 +1591,7 @@ static int vbsfSetEndOfFile(SHFLCLIENTDATA *pClient, SHFLROOT root, SHFLHANDLE H
         rc = RTFileSetSize(pHandle->file.Handle, pSFDEntry->cbObject);
         if (rc != VINF_SUCCESS)
             AssertFailed();
+        vbsfCacheInvalidate(pHandle->file.pszPath);
     }
     else
         AssertFailed();
@@ -1766,6 +1874,12 @@ int vbsfRemove(SHFLCLIENTDATA *pClient, SHFLROOT root, SHFLSTRING *pPath, uint32
                 rc = RTFileDelete(pszFullPath);
             else
                 rc = RTDirRemove(pszFullPath);
+
+            /* Whatever was cached below a removed directory is stale as well. */
+            if (flags & (SHFL_REMOVE_SYMLINK | SHFL_REMOVE_FILE))
+                vbsfCacheInvalidateName(pszFullPath);
+            else
+                vbsfCacheInvalidateAll();
         }
 
 #ifndef DEBUG_dmik
@@ -1836,6 +1950,14 @@ int vbsfRename(SHFLCLIENTDATA *pClient, SHFLROOT root, SHFLSTRING *pSrc, SHFLSTR
                 rc = RTDirRename(pszFullPathSrc, pszFullPathDest,
                                    ((flags & SHFL_RENAME_REPLACE_IF_EXISTS) ? RTPATHRENAME_FLAGS_REPLACE : 0));
             }
+
+            if (flags & SHFL_RENAME_FILE)
+            {
+                vbsfCacheInvalidateName(pszFullPathSrc);
+                vbsfCacheInvalidateName(pszFullPathDest);
+            }
+            else
+                vbsfCacheInvalidateAll();
         }
 
 #ifndef DEBUG_dmik
@@ -1895,6 +2017,8 @@ int vbsfSymlink(SHFLCLIENTDATA *pClient, SHFLROOT root, SHFLSTRING *pNewPath, SH
                          RTSYMLINKTYPE_UNKNOWN, 0);
     if (RT_SUCCESS(rc))
     {
+        vbsfCacheInvalidateName(pszFullNewPath);
+
         RTFSOBJINFO info;
         rc = RTPathQueryInfoEx(pszFullNewPath, &info, RTFSOBJATTRADD_NOTHING, SHFL_RT_LINK(pClient));
         if (RT_SUCCESS(rc))
@@ -0,0 +1,1278 @@
+/** @file
+ *
+ * Shared Folders:
+ * Host path, attribute and directory listing cache.
+ */
+
+/*
+ * Copyright (C) 2006-2015 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+#include "vbsfcache.h"
+#include <iprt/alloc.h>
+#include <iprt/asm.h>
+#include <iprt/assert.h>
+#include <iprt/critsect.h>
+#include <iprt/path.h>
+#include <iprt/string.h>
+#include <iprt/thread.h>
+#include <iprt/time.h>
+
+#if defined(RT_OS_LINUX) && !defined(UNITTEST)
+# define VBSF_CACHE_WITH_INOTIFY
+# include <sys/inotify.h>
+# include <errno.h>
+# include <fcntl.h>
+# include <poll.h>
+# include <unistd.h>
+#endif
+
+
+/*
+ * Tools like make or git status stat thousands of files and list the same
+ * directories over and over. Every one of those requests costs a guest to
+ * host path translation (with directory scans if the case has to be
+ * corrected) and one or more system calls. The cache keeps:
+ *
+ *   - guest path to host path translations,
+ *   - the attributes (or the non-existence) of host paths, and
+ *   - complete directory listings including the attributes of the entries,
+ *     which also feed the attribute cache, so the stat calls following a
+ *     listing are answered without touching the host file system.
+ *
+ * Every host directory with cached content has a generation record. Bumping
+ * the generation invalidates the attributes of everything in the directory
+ * and its listing. The service does that for its own modifications; on Linux
+ * hosts the directories are also watched with inotify so changes made on the
+ * host are noticed. Without a watch an entry is only trusted for a short
+ * time (VBSF_CACHE_TTL_NS). Not found statuses and path translations are
+ * only cached for watched directories, as a file created on the host would
+ * otherwise stay invisible to the guest for that time.
+ *
+ * Renames and removals of directories, mapping changes and lost events bump
+ * the global generation which invalidates everything.
+ *
+ * Directory records (and their watches) of directories nobody asked about for
+ * longer than anything cached against them stays valid are reclaimed when one
+ * of the limits is reached, all of them when the mappings change. Lookups in
+ * progress and listings being recorded only refer to a record through the
+ * record epoch, so they notice and don't enter anything.
+ */
+
+/** The number of hash buckets of each table. */
+#define VBSF_CACHE_BUCKETS          4096
+/** The maximum number of cached paths and objects (each). */
+#define VBSF_CACHE_MAX_ENTRIES      32768
+/** The maximum number of directory generation records. When all of them are
+ * in use by recently accessed directories, further directories are not cached. */
+#define VBSF_CACHE_MAX_DIRS         8192
+/** The maximum number of inotify watches we use. */
+#define VBSF_CACHE_MAX_WATCHES      2048
+/** The maximum size of all cached directory listings. */
+#define VBSF_CACHE_MAX_LIST_BYTES   (32 * _1M)
+
+/**
+ * Host directory generation record.
+ */
+typedef struct VBSFCACHEDIR
+{
+    /** Next record in the path hash chain. */
+    struct VBSFCACHEDIR *pNext;
+    /** Next record in the watch descriptor hash chain. */
+    struct VBSFCACHEDIR *pNextWd;
+    /** The inotify watch descriptor, -1 if not watched, -2 if watching failed. */
+    int                  wd;
+    /** The generation, bumped on every change. */
+    uint32_t volatile    uGen;
+    /** Set while reclaiming if the record is to be dropped. */
+    bool                 fDrop;
+    /** When the record was last used for a lookup or for entering something. */
+    uint64_t             nsLastUsed;
+    /** The hash of the path. */
+    uint32_t             uHash;
+    /** The length of the path. */
+    uint32_t             cchPath;
+    /** The path. */
+    char                 szPath[1];
+} VBSFCACHEDIR;
+
+/**
+ * Cached attributes of a host path.
+ */
+typedef struct VBSFCACHEOBJ
+{
+    struct VBSFCACHEOBJ *pNext;
+    /** The directory containing the object. */
+    PVBSFCACHEDIR        pDir;
+    /** The generation of pDir when the attributes were queried. */
+    uint32_t             uDirGen;
+    /** The global generation when the attributes were queried. */
+    uint32_t             uGen;
+    /** When the attributes were queried. */
+    uint64_t             nsTimestamp;
+    uint32_t             uHash;
+    /** RTPATH_F_ON_LINK or RTPATH_F_FOLLOW_LINK. */
+    uint32_t             fFlags;
+    /** The status of the query, VINF_SUCCESS or a not found status. */
+    int                  rc;
+    /** The attributes if rc is VINF_SUCCESS. */
+    RTFSOBJINFO          Info;
+    uint32_t             cchPath;
+    char                 szPath[1];
+} VBSFCACHEOBJ;
+typedef VBSFCACHEOBJ *PVBSFCACHEOBJ;
+
+/**
+ * Cached guest to host path translation.
+ */
+typedef struct VBSFCACHEPATH
+{
+    struct VBSFCACHEPATH *pNext;
+    /** The name generation when the translation was made. */
+    uint32_t             uNameGen;
+    uint32_t             uHash;
+    /** When the translation was made. */
+    uint64_t             nsTimestamp;
+    SHFLROOT             root;
+    /** The translation options and client flags. */
+    uint32_t             fKey;
+    /** The length of the root prefix of the host path. */
+    uint32_t             cbHostPathRoot;
+    /** The size of the host path including the terminator. */
+    uint32_t             cbHostPath;
+    /** The length of the guest path in bytes. */
+    uint32_t             cbGuestPath;
+    /** The guest path followed by the host path. */
+    uint8_t              abData[1];
+} VBSFCACHEPATH;
+typedef VBSFCACHEPATH *PVBSFCACHEPATH;
+
+/**
+ * A directory listing snapshot.
+ */
+typedef struct VBSFCACHEDIRLIST
+{
+    struct VBSFCACHEDIRLIST *pNext;
+    uint32_t volatile    cRefs;
+    /** Set if the snapshot is incomplete and must not be published. */
+    bool                 fFailed;
+    /** Set while the snapshot is in the table. */
+    bool                 fInTable;
+    PVBSFCACHEDIR        pDir;
+    /** The record epoch when pDir was looked up. */
+    uint32_t             uDirEpoch;
+    uint32_t             uDirGen;
+    uint32_t             uGen;
+    uint64_t             nsTimestamp;
+    uint32_t             uHash;
+    uint32_t             fFlags;
+    /** The length of the directory prefix of the key. */
+    uint32_t             cchDir;
+    uint32_t             cEntries;
+    /** The packed VBSFCACHEDIRENT records. */
+    uint8_t             *pbEntries;
+    uint32_t             cbEntries;
+    uint32_t             cbAlloc;
+    /** The key: the directory path or the search pattern. */
+    char                *pszKey;
+} VBSFCACHEDIRLIST;
+
+/**
+ * A packed directory listing entry.
+ */
+typedef struct VBSFCACHEDIRENT
+{
+    RTFSOBJINFO          Info;
+    uint16_t             cbName;
+    char                 szName[1];
+} VBSFCACHEDIRENT;
+typedef VBSFCACHEDIRENT *PVBSFCACHEDIRENT;
+
+/**
+ * The cache instance.
+ */
+typedef struct VBSFCACHE
+{
+    RTCRITSECT           CritSect;
+    /** Bumped to invalidate everything. */
+    uint32_t volatile    uGen;
+    /** Bumped when names appear or disappear, invalidates the translations. */
+    uint32_t volatile    uNameGen;
+    /** Bumped when directory records are freed. */
+    uint32_t             uDirEpoch;
+    /** When idle directory records were last reclaimed. */
+    uint64_t             nsLastReclaim;
+    /** Whether running out of directory records has been logged. */
+    bool                 fDirLimitLogged;
+    /** Whether running out of watches has been logged. */
+    bool                 fWatchLimitLogged;
+    uint32_t             cDirs;
+    uint32_t             cWatches;
+    uint32_t             cObjs;
+    uint32_t             cPaths;
+    uint32_t             cbLists;
+    PVBSFCACHEDIR        apDirs[VBSF_CACHE_BUCKETS];
+    PVBSFCACHEDIR        apDirsByWd[VBSF_CACHE_BUCKETS];
+    PVBSFCACHEOBJ        apObjs[VBSF_CACHE_BUCKETS];
+    PVBSFCACHEPATH       apPaths[VBSF_CACHE_BUCKETS];
+    PVBSFCACHEDIRLIST    apLists[VBSF_CACHE_BUCKETS];
+#ifdef VBSF_CACHE_WITH_INOTIFY
+    /** The inotify descriptor, -1 if not available. */
+    int                  fdInotify;
+    /** Pipe used to wake up the event thread for termination. */
+    int                  afdWakeup[2];
+    RTTHREAD             hThread;
+#endif
+} VBSFCACHE;
+
+/** The cache, NULL if not enabled. */
+static VBSFCACHE *g_pCache;
+
+
+static uint32_t vbsfCacheHash(const void *pv, size_t cb, uint32_t uHash)
+{
+    const uint8_t *pb = (const uint8_t *)pv;
+    while (cb-- > 0)
+        uHash = (uHash ^ *pb++) * UINT32_C(16777619);
+    return uHash;
+}
+
+/** Length of the directory part of a path, 0 if there is none. */
+static size_t vbsfCacheDirLength(const char *pszPath, size_t cchPath)
+{
+    while (cchPath > 0 && !RTPATH_IS_SLASH(pszPath[cchPath - 1]))
+        cchPath--;
+    while (cchPath > 1 && RTPATH_IS_SLASH(pszPath[cchPath - 1]))
+        cchPath--;
+    return cchPath;
+}
+
+/**
+ * Checks whether something cached against the given generations is still
+ * valid. Called with the lock held.
+ */
+static bool vbsfCacheIsValid(PVBSFCACHEDIR pDir, uint32_t uDirGen, uint32_t uGen, uint64_t nsTimestamp, uint64_t nsNow)
+{
+    if (uGen != g_pCache->uGen)
+        return false;
+    if (pDir->uGen != uDirGen)
+        return false;
+    if (nsNow - nsTimestamp >= (pDir->wd >= 0 ? VBSF_CACHE_TTL_WATCHED_NS : VBSF_CACHE_TTL_NS))
+        return false;
+    pDir->nsLastUsed = nsNow;
+    return true;
+}
+
+
+/*
+ * Freeing.
+ */
+
+static void vbsfCacheDirListUnlink(PVBSFCACHEDIRLIST pList)
+{
+    PVBSFCACHEDIRLIST *ppCur = &g_pCache->apLists[pList->uHash % VBSF_CACHE_BUCKETS];
+    while (*ppCur && *ppCur != pList)
+        ppCur = &(*ppCur)->pNext;
+    if (*ppCur)
+        *ppCur = pList->pNext;
+    pList->pNext    = NULL;
+    pList->fInTable = false;
+    g_pCache->cbLists -= pList->cbEntries;
+}
+
+static void vbsfCacheDirListDestroy(PVBSFCACHEDIRLIST pList)
+{
+    RTMemFree(pList->pbEntries);
+    RTStrFree(pList->pszKey);
+    RTMemFree(pList);
+}
+
+/** Drops all cached objects, translations and listings. Called with the lock held. */
+static void vbsfCacheFreeEntries(void)
+{
+    for (unsigned i = 0; i < VBSF_CACHE_BUCKETS; i++)
+    {
+        while (g_pCache->apObjs[i])
+        {
+            PVBSFCACHEOBJ pObj = g_pCache->apObjs[i];
+            g_pCache->apObjs[i] = pObj->pNext;
+            RTMemFree(pObj);
+        }
+        while (g_pCache->apPaths[i])
+        {
+            PVBSFCACHEPATH pPath = g_pCache->apPaths[i];
+            g_pCache->apPaths[i] = pPath->pNext;
+            RTMemFree(pPath);
+        }
+        while (g_pCache->apLists[i])
+        {
+            PVBSFCACHEDIRLIST pList = g_pCache->apLists[i];
+            vbsfCacheDirListUnlink(pList);
+            if (ASMAtomicDecU32(&pList->cRefs) == 0)
+                vbsfCacheDirListDestroy(pList);
+        }
+    }
+    g_pCache->cObjs   = 0;
+    g_pCache->cPaths  = 0;
+    Assert(g_pCache->cbLists == 0);
+}
+
+/*
+ * Directory generation records.
+ */
+
+static PVBSFCACHEDIR vbsfCacheDirFind(const char *pszPath, size_t cchPath, uint32_t uHash)
+{
+    for (PVBSFCACHEDIR pDir = g_pCache->apDirs[uHash % VBSF_CACHE_BUCKETS]; pDir; pDir = pDir->pNext)
+        if (   pDir->uHash == uHash
+            && pDir->cchPath == cchPath
+            && !memcmp(pDir->szPath, pszPath, cchPath))
+            return pDir;
+    return NULL;
+}
+
+#ifdef VBSF_CACHE_WITH_INOTIFY
+static PVBSFCACHEDIR vbsfCacheDirFindByWd(int wd)
+{
+    for (PVBSFCACHEDIR pDir = g_pCache->apDirsByWd[(uint32_t)wd % VBSF_CACHE_BUCKETS]; pDir; pDir = pDir->pNextWd)
+        if (pDir->wd == wd)
+            return pDir;
+    return NULL;
+}
+
+/** Removes a record from the watch descriptor hash. */
+static void vbsfCacheDirUnlinkWd(PVBSFCACHEDIR pDir)
+{
+    PVBSFCACHEDIR *ppCur = &g_pCache->apDirsByWd[(uint32_t)pDir->wd % VBSF_CACHE_BUCKETS];
+    while (*ppCur && *ppCur != pDir)
+        ppCur = &(*ppCur)->pNextWd;
+    if (*ppCur)
+        *ppCur = pDir->pNextWd;
+    pDir->pNextWd = NULL;
+    pDir->wd = -1;
+    g_pCache->cWatches--;
+}
+
+/** Starts watching a directory, failures leave it unwatched. */
+static void vbsfCacheDirWatch(PVBSFCACHEDIR pDir)
+{
+    if (g_pCache->fdInotify < 0)
+        return;
+    if (g_pCache->cWatches >= VBSF_CACHE_MAX_WATCHES)
+    {
+        if (!g_pCache->fWatchLimitLogged)
+        {
+            LogRel(("SharedFolders host service: all %u directory watches in use, host changes to further directories are picked up after %u ms\n",
+                    VBSF_CACHE_MAX_WATCHES, (unsigned)(VBSF_CACHE_TTL_NS / RT_NS_1MS)));
+            g_pCache->fWatchLimitLogged = true;
+        }
+        return;
+    }
+
+    int wd = inotify_add_watch(g_pCache->fdInotify, pDir->szPath,
+                                 IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_DELETE_SELF
+                               | IN_MODIFY | IN_MOVE_SELF | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR);
+    if (wd < 0 || vbsfCacheDirFindByWd(wd))
+    {
+        /* Another path for the same directory may be watched already, rely on the TTL. */
+        pDir->wd = -2;
+        return;
+    }
+    pDir->wd = wd;
+    pDir->pNextWd = g_pCache->apDirsByWd[(uint32_t)wd % VBSF_CACHE_BUCKETS];
+    g_pCache->apDirsByWd[(uint32_t)wd % VBSF_CACHE_BUCKETS] = pDir;
+    g_pCache->cWatches++;
+}
+#endif /* VBSF_CACHE_WITH_INOTIFY */
+
+/** Frees a record which has been removed from the path hash. Called with the lock held. */
+static void vbsfCacheDirFree(PVBSFCACHEDIR pDir)
+{
+#ifdef VBSF_CACHE_WITH_INOTIFY
+    if (pDir->wd >= 0)
+    {
+        /* The IN_IGNORED event this causes won't find the record any more. */
+        if (g_pCache->fdInotify >= 0)
+            inotify_rm_watch(g_pCache->fdInotify, pDir->wd);
+        vbsfCacheDirUnlinkWd(pDir);
+    }
+#endif
+    RTMemFree(pDir);
+    g_pCache->cDirs--;
+}
+
+/**
+ * Drops the directory records which were not used for longer than anything
+ * cached against them stays valid, or all of them, together with whatever
+ * refers to them. Called with the lock held.
+ *
+ * @returns true if any record was dropped.
+ * @param   fAll        Drop all records.
+ * @param   nsNow       The current time.
+ */
+static bool vbsfCacheDirReclaim(bool fAll, uint64_t nsNow)
+{
+    if (!fAll)
+    {
+        /* Don't rescan on every new directory when everything is in use. */
+        if (nsNow - g_pCache->nsLastReclaim < VBSF_CACHE_TTL_NS)
+            return false;
+        g_pCache->nsLastReclaim = nsNow;
+    }
+
+    uint32_t cDrop = 0;
+    for (unsigned i = 0; i < VBSF_CACHE_BUCKETS; i++)
+        for (PVBSFCACHEDIR pDir = g_pCache->apDirs[i]; pDir; pDir = pDir->pNext)
+        {
+            pDir->fDrop = fAll || nsNow - pDir->nsLastUsed >= VBSF_CACHE_TTL_WATCHED_NS;
+            if (pDir->fDrop)
+                cDrop++;
+        }
+    if (!cDrop)
+        return false;
+
+    /* Tickets and listings being recorded hold on to records without the lock. */
+    g_pCache->uDirEpoch++;
+
+    for (unsigned i = 0; i < VBSF_CACHE_BUCKETS; i++)
+    {
+        PVBSFCACHEOBJ *ppObj = &g_pCache->apObjs[i];
+        while (*ppObj)
+        {
+            PVBSFCACHEOBJ pObj = *ppObj;
+            if (pObj->pDir->fDrop)
+            {
+                *ppObj = pObj->pNext;
+                RTMemFree(pObj);
+                g_pCache->cObjs--;
+            }
+            else
+                ppObj = &pObj->pNext;
+        }
+
+        PVBSFCACHEDIRLIST pList = g_pCache->apLists[i];
+        while (pList)
+        {
+            PVBSFCACHEDIRLIST pNext = pList->pNext;
+            if (pList->pDir->fDrop)
+            {
+                vbsfCacheDirListUnlink(pList);
+                if (ASMAtomicDecU32(&pList->cRefs) == 0)
+                    vbsfCacheDirListDestroy(pList);
+            }
+            pList = pNext;
+        }
+    }
+
+    /* Only now, the objects and listings may refer to records in any bucket. */
+    for (unsigned i = 0; i < VBSF_CACHE_BUCKETS; i++)
+    {
+        PVBSFCACHEDIR *ppDir = &g_pCache->apDirs[i];
+        while (*ppDir)
+        {
+            PVBSFCACHEDIR pDir = *ppDir;
+            if (pDir->fDrop)
+            {
+                *ppDir = pDir->pNext;
+                vbsfCacheDirFree(pDir);
+            }
+            else
+                ppDir = &pDir->pNext;
+        }
+    }
+    return true;
+}
+
+/**
+ * Gets the generation record of a directory, creating it if necessary.
+ * Called with the lock held.
+ *
+ * @returns The record, NULL if there are too many or we're out of memory.
+ */
+static PVBSFCACHEDIR vbsfCacheDirGet(const char *pszPath, size_t cchPath)
+{
+    if (!cchPath)
+        return NULL;
+    uint64_t const nsNow = RTTimeNanoTS();
+    uint32_t uHash = vbsfCacheHash(pszPath, cchPath, UINT32_C(2166136261));
+    PVBSFCACHEDIR pDir = vbsfCacheDirFind(pszPath, cchPath, uHash);
+    if (!pDir)
+    {
+        if (   g_pCache->cDirs >= VBSF_CACHE_MAX_DIRS
+            && !vbsfCacheDirReclaim(false /*fAll*/, nsNow))
+        {
+            if (!g_pCache->fDirLimitLogged)
+            {
+                LogRel(("SharedFolders host service: all %u directory records in use, further directories are not cached\n",
+                        VBSF_CACHE_MAX_DIRS));
+                g_pCache->fDirLimitLogged = true;
+            }
+            return NULL;
+        }
+        pDir = (PVBSFCACHEDIR)RTMemAllocZ(RT_OFFSETOF(VBSFCACHEDIR, szPath[cchPath + 1]));
+        if (!pDir)
+            return NULL;
+        pDir->wd      = -1;
+        pDir->uHash   = uHash;
+        pDir->cchPath = (uint32_t)cchPath;
+        memcpy(pDir->szPath, pszPath, cchPath);
+        pDir->pNext = g_pCache->apDirs[uHash % VBSF_CACHE_BUCKETS];
+        g_pCache->apDirs[uHash % VBSF_CACHE_BUCKETS] = pDir;
+        g_pCache->cDirs++;
+    }
+    pDir->nsLastUsed = nsNow;
+#ifdef VBSF_CACHE_WITH_INOTIFY
+    if (pDir->wd == -1)
+    {
+        if (   g_pCache->cWatches >= VBSF_CACHE_MAX_WATCHES
+            && g_pCache->fdInotify >= 0)
+            vbsfCacheDirReclaim(false /*fAll*/, nsNow);
+        vbsfCacheDirWatch(pDir);
+    }
+#endif
+    return pDir;
+}
+
+/** Bumps the generation of the directory containing @a pszPath. */
+static void vbsfCacheDirBump(const char *pszPath, size_t cchPath)
+{
+    size_t cchDir = vbsfCacheDirLength(pszPath, cchPath);
+    if (!cchDir)
+        return;
+    PVBSFCACHEDIR pDir = vbsfCacheDirFind(pszPath, cchDir, vbsfCacheHash(pszPath, cchDir, UINT32_C(2166136261)));
+    if (pDir)
+        ASMAtomicIncU32(&pDir->uGen);
+}
+
+
+/*
+ * Host change notifications.
+ */
+
+#ifdef VBSF_CACHE_WITH_INOTIFY
+static void vbsfCacheProcessEvent(const struct inotify_event *pEvent)
+{
+    if (pEvent->mask & IN_Q_OVERFLOW)
+    {
+        /* We lost track. */
+        ASMAtomicIncU32(&g_pCache->uGen);
+        ASMAtomicIncU32(&g_pCache->uNameGen);
+        return;
+    }
+
+    PVBSFCACHEDIR pDir = vbsfCacheDirFindByWd(pEvent->wd);
+    if (!pDir)
+        return;
+    ASMAtomicIncU32(&pDir->uGen);
+
+    if (pEvent->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF))
+        ASMAtomicIncU32(&g_pCache->uNameGen);
+
+    /* Whatever was cached below a directory which went away is stale and
+     * the deeper levels are not told about it. */
+    if (   (pEvent->mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+        || ((pEvent->mask & IN_ISDIR) && (pEvent->mask & (IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO))))
+        ASMAtomicIncU32(&g_pCache->uGen);
+
+    if (pEvent->mask & IN_IGNORED)
+        vbsfCacheDirUnlinkWd(pDir);
+}
+
+static DECLCALLBACK(int) vbsfCacheEventThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    NOREF(hThreadSelf); NOREF(pvUser);
+    union
+    {
+        struct inotify_event Event;
+        char                 ach[16 * _1K];
+    } Buf;
+
+    for (;;)
+    {
+        struct pollfd aFds[2];
+        aFds[0].fd      = g_pCache->fdInotify;
+        aFds[0].events  = POLLIN;
+        aFds[0].revents = 0;
+        aFds[1].fd      = g_pCache->afdWakeup[0];
+        aFds[1].events  = POLLIN;
+        aFds[1].revents = 0;
+        int rcPoll = poll(aFds, RT_ELEMENTS(aFds), -1);
+        if (rcPoll < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (aFds[1].revents)
+            break;
+
+        ssize_t cbRead = read(g_pCache->fdInotify, &Buf, sizeof(Buf));
+        if (cbRead <= 0)
+            continue;
+
+        RTCritSectEnter(&g_pCache->CritSect);
+        size_t off = 0;
+        while (off + sizeof(struct inotify_event) <= (size_t)cbRead)
+        {
+            const struct inotify_event *pEvent = (const struct inotify_event *)&Buf.ach[off];
+            vbsfCacheProcessEvent(pEvent);
+            off += sizeof(struct inotify_event) + pEvent->len;
+        }
+        RTCritSectLeave(&g_pCache->CritSect);
+    }
+    return VINF_SUCCESS;
+}
+
+static void vbsfCacheInitInotify(void)
+{
+    g_pCache->fdInotify    = -1;
+    g_pCache->afdWakeup[0] = -1;
+    g_pCache->afdWakeup[1] = -1;
+    g_pCache->hThread      = NIL_RTTHREAD;
+
+    int fd = inotify_init();
+    if (fd < 0)
+    {
+        LogRel(("SharedFolders host service: inotify not available (errno=%d), host changes are picked up after %u ms\n",
+                errno, (unsigned)(VBSF_CACHE_TTL_NS / RT_NS_1MS)));
+        return;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    if (pipe(g_pCache->afdWakeup) == 0)
+    {
+        fcntl(g_pCache->afdWakeup[0], F_SETFD, FD_CLOEXEC);
+        fcntl(g_pCache->afdWakeup[1], F_SETFD, FD_CLOEXEC);
+        g_pCache->fdInotify = fd;
+        int rc = RTThreadCreate(&g_pCache->hThread, vbsfCacheEventThread, NULL, 0,
+                                RTTHREADTYPE_IO, RTTHREADFLAGS_WAITABLE, "ShFlWatch");
+        if (RT_SUCCESS(rc))
+            return;
+        g_pCache->fdInotify = -1;
+        close(g_pCache->afdWakeup[0]);
+        close(g_pCache->afdWakeup[1]);
+        g_pCache->afdWakeup[0] = g_pCache->afdWakeup[1] = -1;
+    }
+    close(fd);
+}
+
+static void vbsfCacheTermInotify(void)
+{
+    if (g_pCache->hThread != NIL_RTTHREAD)
+    {
+        char ch = 0;
+        if (write(g_pCache->afdWakeup[1], &ch, 1) == 1)
+            RTThreadWait(g_pCache->hThread, RT_INDEFINITE_WAIT, NULL);
+        g_pCache->hThread = NIL_RTTHREAD;
+    }
+    if (g_pCache->fdInotify >= 0)
+        close(g_pCache->fdInotify); /* Drops all the watches. */
+    if (g_pCache->afdWakeup[0] >= 0)
+        close(g_pCache->afdWakeup[0]);
+    if (g_pCache->afdWakeup[1] >= 0)
+        close(g_pCache->afdWakeup[1]);
+    g_pCache->fdInotify = -1;
+}
+#endif /* VBSF_CACHE_WITH_INOTIFY */
+
+
+/*
+ * Setup.
+ */
+
+/**
+ * Enables the cache. Until this is called (the unit tests don't) all
+ * lookups miss and nothing is entered.
+ */
+int vbsfCacheInit(void)
+{
+    AssertReturn(!g_pCache, VERR_WRONG_ORDER);
+    g_pCache = (VBSFCACHE *)RTMemAllocZ(sizeof(*g_pCache));
+    if (!g_pCache)
+        return VERR_NO_MEMORY;
+    int rc = RTCritSectInit(&g_pCache->CritSect);
+    if (RT_FAILURE(rc))
+    {
+        RTMemFree(g_pCache);
+        g_pCache = NULL;
+        return rc;
+    }
+#ifdef VBSF_CACHE_WITH_INOTIFY
+    vbsfCacheInitInotify();
+#endif
+    return VINF_SUCCESS;
+}
+
+void vbsfCacheTerm(void)
+{
+    if (!g_pCache)
+        return;
+#ifdef VBSF_CACHE_WITH_INOTIFY
+    vbsfCacheTermInotify();
+#endif
+    RTCritSectEnter(&g_pCache->CritSect);
+    vbsfCacheFreeEntries();
+    vbsfCacheDirReclaim(true /*fAll*/, 0);
+    RTCritSectLeave(&g_pCache->CritSect);
+    RTCritSectDelete(&g_pCache->CritSect);
+    RTMemFree(g_pCache);
+    g_pCache = NULL;
+}
+
+/**
+ * Drops everything including the directory records and watches, used when
+ * the mappings change.
+ */
+void vbsfCacheFlush(void)
+{
+    if (!g_pCache)
+        return;
+    RTCritSectEnter(&g_pCache->CritSect);
+    ASMAtomicIncU32(&g_pCache->uGen);
+    ASMAtomicIncU32(&g_pCache->uNameGen);
+    vbsfCacheFreeEntries();
+    vbsfCacheDirReclaim(true /*fAll*/, 0);
+    RTCritSectLeave(&g_pCache->CritSect);
+}
+
+
+/*
+ * Guest to host path translations.
+ */
+
+static uint32_t vbsfCachePathHash(SHFLROOT root, uint32_t fKey, PCSHFLSTRING pGuestPath)
+{
+    uint32_t uHash = vbsfCacheHash(&root, sizeof(root), UINT32_C(2166136261));
+    uHash = vbsfCacheHash(&fKey, sizeof(fKey), uHash);
+    return vbsfCacheHash(&pGuestPath->String, pGuestPath->u16Length, uHash);
+}
+
+/**
+ * Looks up the host path for a guest path.
+ *
+ * @returns true if found, false if not.
+ * @param   root            The mapping.
+ * @param   fKey            Everything else the translation depends on.
+ * @param   pGuestPath      The guest path.
+ * @param   ppszHostPath    Where to return the host path on success, free
+ *                          with vbsfFreeHostPath.
+ * @param   pcbHostPathRoot Where to return the length of the root prefix.
+ * @param   puNameGen       Where to return the state to pass to
+ *                          vbsfCacheEnterPath on failure.
+ */
+bool vbsfCacheLookupPath(SHFLROOT root, uint32_t fKey, PCSHFLSTRING pGuestPath,
+                         char **ppszHostPath, uint32_t *pcbHostPathRoot, uint32_t *puNameGen)
+{
+    *puNameGen = 0;
+    if (!g_pCache)
+        return false;
+
+    uint32_t const uHash  = vbsfCachePathHash(root, fKey, pGuestPath);
+    uint64_t const nsNow  = RTTimeNanoTS();
+    bool           fFound = false;
+
+    RTCritSectEnter(&g_pCache->CritSect);
+    *puNameGen = g_pCache->uNameGen;
+    for (PVBSFCACHEPATH pPath = g_pCache->apPaths[uHash % VBSF_CACHE_BUCKETS]; pPath; pPath = pPath->pNext)
+        if (   pPath->uHash == uHash
+            && pPath->root == root
+            && pPath->fKey == fKey
+            && pPath->cbGuestPath == pGuestPath->u16Length
+            && !memcmp(pPath->abData, &pGuestPath->String, pGuestPath->u16Length))
+        {
+            if (   pPath->uNameGen == g_pCache->uNameGen
+                && nsNow - pPath->nsTimestamp < VBSF_CACHE_TTL_NS)
+            {
+                char *pszHostPath = (char *)RTMemDup(&pPath->abData[pPath->cbGuestPath], pPath->cbHostPath);
+                if (pszHostPath)
+                {
+                    *ppszHostPath = pszHostPath;
+                    if (pcbHostPathRoot)
+                        *pcbHostPathRoot = pPath->cbHostPathRoot;
+                    fFound = true;
+                }
+            }
+            break;
+        }
+    RTCritSectLeave(&g_pCache->CritSect);
+    return fFound;
+}
+
+/**
+ * Enters the result of a guest to host path translation.
+ */
+void vbsfCacheEnterPath(SHFLROOT root, uint32_t fKey, PCSHFLSTRING pGuestPath,
+                        const char *pszHostPath, uint32_t cbHostPathRoot, uint32_t uNameGen)
+{
+    if (!g_pCache)
+        return;
+
+    uint32_t const uHash      = vbsfCachePathHash(root, fKey, pGuestPath);
+    uint32_t const cbHostPath = (uint32_t)strlen(pszHostPath) + 1;
+
+    PVBSFCACHEPATH pNew = (PVBSFCACHEPATH)RTMemAlloc(RT_OFFSETOF(VBSFCACHEPATH, abData[pGuestPath->u16Length + cbHostPath]));
+    if (!pNew)
+        return;
+    pNew->uNameGen       = uNameGen;
+    pNew->uHash          = uHash;
+    pNew->nsTimestamp    = RTTimeNanoTS();
+    pNew->root           = root;
+    pNew->fKey           = fKey;
+    pNew->cbHostPathRoot = cbHostPathRoot;
+    pNew->cbHostPath     = cbHostPath;
+    pNew->cbGuestPath    = pGuestPath->u16Length;
+    memcpy(pNew->abData, &pGuestPath->String, pGuestPath->u16Length);
+    memcpy(&pNew->abData[pGuestPath->u16Length], pszHostPath, cbHostPath);
+
+    RTCritSectEnter(&g_pCache->CritSect);
+    /* Nobody tells us when the host creates or removes a name in an unwatched
+     * directory, which changes how the path is to be translated. */
+    PVBSFCACHEDIR pDir = vbsfCacheDirGet(pszHostPath, vbsfCacheDirLength(pszHostPath, cbHostPath - 1));
+    if (!pDir || pDir->wd < 0)
+    {
+        RTCritSectLeave(&g_pCache->CritSect);
+        RTMemFree(pNew);
+        return;
+    }
+    PVBSFCACHEPATH *ppCur = &g_pCache->apPaths[uHash % VBSF_CACHE_BUCKETS];
+    while (*ppCur)
+    {
+        PVBSFCACHEPATH pCur = *ppCur;
+        if (   pCur->uHash == uHash
+            && pCur->root == root
+            && pCur->fKey == fKey
+            && pCur->cbGuestPath == pNew->cbGuestPath
+            && !memcmp(pCur->abData, pNew->abData, pNew->cbGuestPath))
+        {
+            *ppCur = pCur->pNext;
+            RTMemFree(pCur);
+            g_pCache->cPaths--;
+            break;
+        }
+        ppCur = &pCur->pNext;
+    }
+    if (g_pCache->cPaths >= VBSF_CACHE_MAX_ENTRIES)
+        vbsfCacheFreeEntries();
+    pNew->pNext = g_pCache->apPaths[uHash % VBSF_CACHE_BUCKETS];
+    g_pCache->apPaths[uHash % VBSF_CACHE_BUCKETS] = pNew;
+    g_pCache->cPaths++;
+    RTCritSectLeave(&g_pCache->CritSect);
+}
+
+
+/*
+ * Attributes.
+ */
+
+/** Enters attributes with the lock held. */
+static void vbsfCacheEnterInfoLocked(const char *pszPath, size_t cchPath, uint32_t uHash, uint32_t fFlags, int rc,
+                                     PCRTFSOBJINFO pInfo, PVBSFCACHEDIR pDir, uint32_t uDirGen, uint32_t uGen,
+                                     uint64_t nsTimestamp)
+{
+    PVBSFCACHEOBJ *ppCur = &g_pCache->apObjs[uHash % VBSF_CACHE_BUCKETS];
+    PVBSFCACHEOBJ  pObj  = NULL;
+    while (*ppCur)
+    {
+        PVBSFCACHEOBJ pCur = *ppCur;
+        if (   pCur->uHash == uHash
+            && pCur->fFlags == fFlags
+            && pCur->cchPath == cchPath
+            && !memcmp(pCur->szPath, pszPath, cchPath))
+        {
+            pObj = pCur;
+            break;
+        }
+        ppCur = &pCur->pNext;
+    }
+    if (!pObj)
+    {
+        if (g_pCache->cObjs >= VBSF_CACHE_MAX_ENTRIES)
+            vbsfCacheFreeEntries();
+        pObj = (PVBSFCACHEOBJ)RTMemAlloc(RT_OFFSETOF(VBSFCACHEOBJ, szPath[cchPath + 1]));
+        if (!pObj)
+            return;
+        pObj->uHash   = uHash;
+        pObj->fFlags  = fFlags;
+        pObj->cchPath = (uint32_t)cchPath;
+        memcpy(pObj->szPath, pszPath, cchPath);
+        pObj->szPath[cchPath] = '\0';
+        pObj->pNext = g_pCache->apObjs[uHash % VBSF_CACHE_BUCKETS];
+        g_pCache->apObjs[uHash % VBSF_CACHE_BUCKETS] = pObj;
+        g_pCache->cObjs++;
+    }
+    pObj->pDir        = pDir;
+    pObj->uDirGen     = uDirGen;
+    pObj->uGen        = uGen;
+    pObj->nsTimestamp = nsTimestamp;
+    pObj->rc          = rc;
+    if (RT_SUCCESS(rc))
+        pObj->Info    = *pInfo;
+    else
+        RT_ZERO(pObj->Info);
+}
+
+/**
+ * Looks up the attributes of a host path.
+ *
+ * @returns true if found, false if the caller has to ask the host and pass
+ *          the result to vbsfCacheEnterInfo.
+ * @param   pszPath     The host path.
+ * @param   fFlags      RTPATH_F_ON_LINK or RTPATH_F_FOLLOW_LINK.
+ * @param   pInfo       Where to return the attributes.
+ * @param   prc         Where to return the status of the query.
+ * @param   pTicket     Where to return the cache state on a miss.
+ */
+bool vbsfCacheLookupInfo(const char *pszPath, uint32_t fFlags, PRTFSOBJINFO pInfo, int *prc,
+                         PVBSFCACHETICKET pTicket)
+{
+    pTicket->pDir = NULL;
+    if (!g_pCache)
+        return false;
+
+    size_t const   cchPath = strlen(pszPath);
+    uint32_t const uHash   = vbsfCacheHash(pszPath, cchPath, UINT32_C(2166136261));
+    uint64_t const nsNow   = RTTimeNanoTS();
+    bool           fFound  = false;
+
+    RTCritSectEnter(&g_pCache->CritSect);
+    for (PVBSFCACHEOBJ pObj = g_pCache->apObjs[uHash % VBSF_CACHE_BUCKETS]; pObj; pObj = pObj->pNext)
+        if (   pObj->uHash == uHash
+            && pObj->fFlags == fFlags
+            && pObj->cchPath == cchPath
+            && !memcmp(pObj->szPath, pszPath, cchPath))
+        {
+            if (vbsfCacheIsValid(pObj->pDir, pObj->uDirGen, pObj->uGen, pObj->nsTimestamp, nsNow))
+            {
+                *prc   = pObj->rc;
+                *pInfo = pObj->Info;
+                fFound = true;
+            }
+            break;
+        }
+    if (!fFound)
+    {
+        /* Take the snapshot before the caller asks the host. */
+        pTicket->pDir = vbsfCacheDirGet(pszPath, vbsfCacheDirLength(pszPath, cchPath));
+        if (pTicket->pDir)
+            pTicket->uDirGen = pTicket->pDir->uGen;
+        pTicket->uDirEpoch = g_pCache->uDirEpoch;
+        pTicket->uGen      = g_pCache->uGen;
+    }
+    RTCritSectLeave(&g_pCache->CritSect);
+    return fFound;
+}
+
+/**
+ * Enters the attributes of a host path after vbsfCacheLookupInfo missed.
+ *
+ * Only successful queries and not found statuses are cached, the latter only
+ * for watched directories.
+ */
+void vbsfCacheEnterInfo(const char *pszPath, uint32_t fFlags, int rc, PCRTFSOBJINFO pInfo,
+                        PVBSFCACHETICKET pTicket)
+{
+    if (!g_pCache || !pTicket->pDir)
+        return;
+    if (   rc != VINF_SUCCESS
+        && rc != VERR_FILE_NOT_FOUND
+        && rc != VERR_PATH_NOT_FOUND)
+        return;
+
+    size_t const   cchPath = strlen(pszPath);
+    uint32_t const uHash   = vbsfCacheHash(pszPath, cchPath, UINT32_C(2166136261));
+    RTCritSectEnter(&g_pCache->CritSect);
+    if (   pTicket->uDirEpoch == g_pCache->uDirEpoch
+        && (rc == VINF_SUCCESS || pTicket->pDir->wd >= 0))
+        vbsfCacheEnterInfoLocked(pszPath, cchPath, uHash, fFlags, rc, pInfo,
+                                 pTicket->pDir, pTicket->uDirGen, pTicket->uGen, RTTimeNanoTS());
+    RTCritSectLeave(&g_pCache->CritSect);
+}
+
+
+/*
+ * Invalidation.
+ */
+
+/**
+ * The attributes of an object were changed by the service (write, set info).
+ */
+void vbsfCacheInvalidate(const char *pszPath)
+{
+    if (!g_pCache || !pszPath)
+        return;
+    size_t const cchPath = strlen(pszPath);
+    RTCritSectEnter(&g_pCache->CritSect);
+    vbsfCacheDirBump(pszPath, cchPath);
+    RTCritSectLeave(&g_pCache->CritSect);
+}
+
+/**
+ * An object was created by the service, which also changes the parent
+ * directory and may change the outcome of case corrections.
+ */
+void vbsfCacheInvalidateName(const char *pszPath)
+{
+    if (!g_pCache || !pszPath)
+        return;
+    size_t const cchPath = strlen(pszPath);
+    RTCritSectEnter(&g_pCache->CritSect);
+    vbsfCacheDirBump(pszPath, cchPath);
+    vbsfCacheDirBump(pszPath, vbsfCacheDirLength(pszPath, cchPath));
+    ASMAtomicIncU32(&g_pCache->uNameGen);
+    RTCritSectLeave(&g_pCache->CritSect);
+}
+
+/**
+ * Something was renamed or removed by the service, which may affect a whole
+ * tree.
+ */
+void vbsfCacheInvalidateAll(void)
+{
+    if (!g_pCache)
+        return;
+    ASMAtomicIncU32(&g_pCache->uGen);
+    ASMAtomicIncU32(&g_pCache->uNameGen);
+}
+
+
+/*
+ * Directory listings.
+ */
+
+static uint32_t vbsfCacheDirListHash(const char *pszKey, uint32_t fFlags)
+{
+    return vbsfCacheHash(&fFlags, sizeof(fFlags), vbsfCacheHash(pszKey, strlen(pszKey), UINT32_C(2166136261)));
+}
+
+/**
+ * Gets a valid listing snapshot.
+ *
+ * @returns Retained snapshot, NULL if there is none.
+ * @param   pszKey      The directory path or the search pattern.
+ * @param   fFlags      RTPATH_F_ON_LINK or RTPATH_F_FOLLOW_LINK.
+ */
+PVBSFCACHEDIRLIST vbsfCacheDirListGet(const char *pszKey, uint32_t fFlags)
+{
+    if (!g_pCache)
+        return NULL;
+
+    uint32_t const    uHash = vbsfCacheDirListHash(pszKey, fFlags);
+    uint64_t const    nsNow = RTTimeNanoTS();
+    PVBSFCACHEDIRLIST pRet  = NULL;
+
+    RTCritSectEnter(&g_pCache->CritSect);
+    for (PVBSFCACHEDIRLIST pList = g_pCache->apLists[uHash % VBSF_CACHE_BUCKETS]; pList; pList = pList->pNext)
+        if (   pList->uHash == uHash
+            && pList->fFlags == fFlags
+            && !strcmp(pList->pszKey, pszKey))
+        {
+            if (vbsfCacheIsValid(pList->pDir, pList->uDirGen, pList->uGen, pList->nsTimestamp, nsNow))
+            {
+                ASMAtomicIncU32(&pList->cRefs);
+                pRet = pList;
+            }
+            break;
+        }
+    RTCritSectLeave(&g_pCache->CritSect);
+    return pRet;
+}
+
+/**
+ * Starts recording a listing.
+ *
+ * @returns The new snapshot, NULL if the listing can't be cached.
+ * @param   pszKey      The directory path or the search pattern.
+ * @param   cchDir      The length of the directory part of @a pszKey.
+ * @param   fFlags      RTPATH_F_ON_LINK or RTPATH_F_FOLLOW_LINK.
+ */
+PVBSFCACHEDIRLIST vbsfCacheDirListBegin(const char *pszKey, size_t cchDir, uint32_t fFlags)
+{
+    if (!g_pCache)
+        return NULL;
+
+    PVBSFCACHEDIRLIST pList = (PVBSFCACHEDIRLIST)RTMemAllocZ(sizeof(*pList));
+    if (!pList)
+        return NULL;
+    pList->pszKey = RTStrDup(pszKey);
+    if (!pList->pszKey)
+    {
+        RTMemFree(pList);
+        return NULL;
+    }
+    pList->cRefs  = 1;
+    pList->uHash  = vbsfCacheDirListHash(pszKey, fFlags);
+    pList->fFlags = fFlags;
+    pList->cchDir = (uint32_t)cchDir;
+
+    RTCritSectEnter(&g_pCache->CritSect);
+    pList->pDir = vbsfCacheDirGet(pszKey, cchDir);
+    if (pList->pDir)
+        pList->uDirGen = pList->pDir->uGen;
+    pList->uDirEpoch = g_pCache->uDirEpoch;
+    pList->uGen      = g_pCache->uGen;
+    RTCritSectLeave(&g_pCache->CritSect);
+    pList->nsTimestamp = RTTimeNanoTS();
+
+    if (!pList->pDir)
+    {
+        vbsfCacheDirListDestroy(pList);
+        return NULL;
+    }
+    return pList;
+}
+
+/**
+ * Records an entry read from the host.
+ */
+void vbsfCacheDirListAdd(PVBSFCACHEDIRLIST pList, PCRTDIRENTRYEX pDirEntry)
+{
+    if (pList->fFailed)
+        return;
+
+    uint32_t cbEntry = RT_ALIGN_32(RT_OFFSETOF(VBSFCACHEDIRENT, szName[pDirEntry->cbName + 1]), 8);
+    if (pList->cbEntries + cbEntry > pList->cbAlloc)
+    {
+        uint32_t cbNew = RT_MAX(pList->cbAlloc * 2, _4K);
+        while (cbNew < pList->cbEntries + cbEntry)
+            cbNew *= 2;
+        uint8_t *pbNew = cbNew <= VBSF_CACHE_MAX_LIST_BYTES ? (uint8_t *)RTMemRealloc(pList->pbEntries, cbNew) : NULL;
+        if (!pbNew)
+        {
+            pList->fFailed = true;
+            return;
+        }
+        pList->pbEntries = pbNew;
+        pList->cbAlloc   = cbNew;
+    }
+
+    PVBSFCACHEDIRENT pEnt = (PVBSFCACHEDIRENT)&pList->pbEntries[pList->cbEntries];
+    pEnt->Info   = pDirEntry->Info;
+    pEnt->cbName = pDirEntry->cbName;
+    memcpy(pEnt->szName, pDirEntry->szName, pDirEntry->cbName);
+    pEnt->szName[pDirEntry->cbName] = '\0';
+    pList->cbEntries += cbEntry;
+    pList->cEntries++;
+}
+
+/**
+ * Completes a recorded listing and releases the caller's reference.
+ *
+ * The attributes of the entries are entered into the attribute cache, so the
+ * stat calls which usually follow a listing are served from the cache.
+ */
+void vbsfCacheDirListPublish(PVBSFCACHEDIRLIST pList)
+{
+    if (!pList->fFailed && g_pCache)
+    {
+        char    *pszPath = NULL;
+        uint32_t cbPath  = 0;
+
+        RTCritSectEnter(&g_pCache->CritSect);
+        if (pList->uDirEpoch != g_pCache->uDirEpoch)
+        {
+            /* The directory record was reclaimed while the listing was read. */
+            RTCritSectLeave(&g_pCache->CritSect);
+            vbsfCacheDirListRelease(pList);
+            return;
+        }
+
+        /* Replace the previous snapshot. */
+        for (PVBSFCACHEDIRLIST pOld = g_pCache->apLists[pList->uHash % VBSF_CACHE_BUCKETS]; pOld; pOld = pOld->pNext)
+            if (   pOld->uHash == pList->uHash
+                && pOld->fFlags == pList->fFlags
+                && !strcmp(pOld->pszKey, pList->pszKey))
+            {
+                vbsfCacheDirListUnlink(pOld);
+                if (ASMAtomicDecU32(&pOld->cRefs) == 0)
+                    vbsfCacheDirListDestroy(pOld);
+                break;
+            }
+        if (g_pCache->cbLists + pList->cbEntries > VBSF_CACHE_MAX_LIST_BYTES)
+            vbsfCacheFreeEntries();
+
+        ASMAtomicIncU32(&pList->cRefs);
+        pList->fInTable = true;
+        pList->pNext = g_pCache->apLists[pList->uHash % VBSF_CACHE_BUCKETS];
+        g_pCache->apLists[pList->uHash % VBSF_CACHE_BUCKETS] = pList;
+        g_pCache->cbLists += pList->cbEntries;
+
+        /* Prime the attribute cache. */
+        for (uint32_t off = 0; off < pList->cbEntries; )
+        {
+            PVBSFCACHEDIRENT pEnt    = (PVBSFCACHEDIRENT)&pList->pbEntries[off];
+            uint32_t         cbEntry = RT_ALIGN_32(RT_OFFSETOF(VBSFCACHEDIRENT, szName[pEnt->cbName + 1]), 8);
+            off += cbEntry;
+            if (   (pEnt->cbName == 1 && pEnt->szName[0] == '.')
+                || (pEnt->cbName == 2 && pEnt->szName[0] == '.' && pEnt->szName[1] == '.'))
+                continue;
+
+            uint32_t cchPath = pList->cchDir + 1 + pEnt->cbName;
+            if (cchPath + 1 > cbPath)
+            {
+                RTMemFree(pszPath);
+                cbPath  = RT_ALIGN_32(cchPath + 1, 256);
+                pszPath = (char *)RTMemAlloc(cbPath);
+                if (!pszPath)
+                    break;
+            }
+            memcpy(pszPath, pList->pszKey, pList->cchDir);
+            pszPath[pList->cchDir] = RTPATH_SLASH;
+            memcpy(&pszPath[pList->cchDir + 1], pEnt->szName, pEnt->cbName + 1);
+            vbsfCacheEnterInfoLocked(pszPath, cchPath, vbsfCacheHash(pszPath, cchPath, UINT32_C(2166136261)),
+                                     pList->fFlags, VINF_SUCCESS, &pEnt->Info,
+                                     pList->pDir, pList->uDirGen, pList->uGen, pList->nsTimestamp);
+        }
+
+        RTCritSectLeave(&g_pCache->CritSect);
+        RTMemFree(pszPath);
+    }
+    vbsfCacheDirListRelease(pList);
+}
+
+/**
+ * Reads the next entry of a snapshot.
+ *
+ * @returns VINF_SUCCESS, VERR_NO_MORE_FILES or VERR_BUFFER_OVERFLOW.
+ * @param   pList       The snapshot.
+ * @param   poffNext    The read position, start with 0.
+ * @param   pDirEntry   Where to return the entry.
+ * @param   cbDirEntry  The size of the buffer @a pDirEntry points to.
+ */
+int vbsfCacheDirListRead(PVBSFCACHEDIRLIST pList, uint32_t *poffNext, PRTDIRENTRYEX pDirEntry, size_t cbDirEntry)
+{
+    if (*poffNext >= pList->cbEntries)
+        return VERR_NO_MORE_FILES;
+
+    PVBSFCACHEDIRENT pEnt = (PVBSFCACHEDIRENT)&pList->pbEntries[*poffNext];
+    if (RT_UOFFSETOF(RTDIRENTRYEX, szName[pEnt->cbName + 1]) > cbDirEntry)
+        return VERR_BUFFER_OVERFLOW;
+
+    pDirEntry->Info            = pEnt->Info;
+    pDirEntry->cwcShortName    = 0;
+    pDirEntry->wszShortName[0] = 0;
+    pDirEntry->cbName          = pEnt->cbName;
+    memcpy(pDirEntry->szName, pEnt->szName, pEnt->cbName + 1);
+    *poffNext += RT_ALIGN_32(RT_OFFSETOF(VBSFCACHEDIRENT, szName[pEnt->cbName + 1]), 8);
+    return VINF_SUCCESS;
+}
+
+/**
+ * Releases a snapshot reference.
+ */
+void vbsfCacheDirListRelease(PVBSFCACHEDIRLIST pList)
+{
+    if (!pList)
+        return;
+    if (ASMAtomicDecU32(&pList->cRefs) == 0)
+    {
+        Assert(!pList->fInTable);
+        vbsfCacheDirListDestroy(pList);
+    }
+}
@@ -0,0 +1,82 @@
+/** @file
+ * Shared Folders: Host path, attribute and directory listing cache.
+ */
+
+/*
+ * Copyright (C) 2006-2015 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+#ifndef __VBSFCACHE__H
+#define __VBSFCACHE__H
+
+#include "shfl.h"
+#include <VBox/shflsvc.h>
+#include <iprt/dir.h>
+#include <iprt/fs.h>
+
+/** How long an entry stays valid if the host directory is not being watched
+ * for changes, in nanoseconds. */
+#define VBSF_CACHE_TTL_NS           UINT64_C(200000000)
+/** How long an entry stays valid if the host directory is being watched.
+ * The limit catches changes the host does not report (e.g. the modification
+ * time of a sub-directory), in nanoseconds. */
+#define VBSF_CACHE_TTL_WATCHED_NS   UINT64_C(2000000000)
+
+/** A host directory generation record. */
+typedef struct VBSFCACHEDIR *PVBSFCACHEDIR;
+/** A directory listing snapshot. */
+typedef struct VBSFCACHEDIRLIST *PVBSFCACHEDIRLIST;
+
+/**
+ * The state of the cache when a lookup missed. Passed back when entering
+ * the result so that changes made while the host was being asked invalidate
+ * it right away.
+ */
+typedef struct VBSFCACHETICKET
+{
+    /** The directory containing the object, NULL if not cacheable. */
+    PVBSFCACHEDIR   pDir;
+    /** The record epoch, pDir must not be touched if it changed. */
+    uint32_t        uDirEpoch;
+    /** The generation of pDir. */
+    uint32_t        uDirGen;
+    /** The global generation. */
+    uint32_t        uGen;
+} VBSFCACHETICKET;
+/** Pointer to a cache ticket. */
+typedef VBSFCACHETICKET *PVBSFCACHETICKET;
+
+int  vbsfCacheInit(void);
+void vbsfCacheTerm(void);
+void vbsfCacheFlush(void);
+
+bool vbsfCacheLookupPath(SHFLROOT root, uint32_t fKey, PCSHFLSTRING pGuestPath,
+                         char **ppszHostPath, uint32_t *pcbHostPathRoot, uint32_t *puNameGen);
+void vbsfCacheEnterPath(SHFLROOT root, uint32_t fKey, PCSHFLSTRING pGuestPath,
+                        const char *pszHostPath, uint32_t cbHostPathRoot, uint32_t uNameGen);
+
+bool vbsfCacheLookupInfo(const char *pszPath, uint32_t fFlags, PRTFSOBJINFO pInfo, int *prc,
+                         PVBSFCACHETICKET pTicket);
+void vbsfCacheEnterInfo(const char *pszPath, uint32_t fFlags, int rc, PCRTFSOBJINFO pInfo,
+                        PVBSFCACHETICKET pTicket);
+
+void vbsfCacheInvalidate(const char *pszPath);
+void vbsfCacheInvalidateName(const char *pszPath);
+void vbsfCacheInvalidateAll(void);
+
+PVBSFCACHEDIRLIST vbsfCacheDirListGet(const char *pszKey, uint32_t fFlags);
+PVBSFCACHEDIRLIST vbsfCacheDirListBegin(const char *pszKey, size_t cchDir, uint32_t fFlags);
+void vbsfCacheDirListAdd(PVBSFCACHEDIRLIST pList, PCRTDIRENTRYEX pDirEntry);
+void vbsfCacheDirListPublish(PVBSFCACHEDIRLIST pList);
+int  vbsfCacheDirListRead(PVBSFCACHEDIRLIST pList, uint32_t *poffNext, PRTDIRENTRYEX pDirEntry, size_t cbDirEntry);
+void vbsfCacheDirListRelease(PVBSFCACHEDIRLIST pList);
+
+#endif /* __VBSFCACHE__H */
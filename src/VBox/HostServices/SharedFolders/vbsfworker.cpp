@@ -0,0 +1,344 @@
+/** @file
+ *
+ * Shared Folders:
+ * Worker threads for the blocking handle and path based functions.
+ */
+
+/*
+ * Copyright (C) 2006-2015 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+#include "vbsfworker.h"
+#include <iprt/alloc.h>
+#include <iprt/asm.h>
+#include <iprt/assert.h>
+#include <iprt/critsect.h>
+#include <iprt/semaphore.h>
+#include <iprt/string.h>
+#include <iprt/thread.h>
+
+
+/*
+ * The HGCM service thread must never block on the host file system, so the
+ * functions operating on a handle or a path are handed to a small pool of
+ * threads. All calls for one handle go to the same thread and are executed
+ * in the order they were queued, so a close can never overtake a read and
+ * the file position seen by consecutive reads and writes is preserved.
+ * Path based calls don't depend on each other (the guest waits for one to
+ * complete before it relies on the result) and go to an idle thread.
+ */
+typedef struct VBSFWORKER
+{
+    /** The thread. */
+    RTTHREAD         hThread;
+    /** Signalled when something was queued or on shutdown. */
+    RTSEMEVENT       hEvt;
+    /** The head of the queue. */
+    PVBSFWORKITEM    pHead;
+    /** The tail of the queue. */
+    PVBSFWORKITEM    pTail;
+    /** The call being executed right now. */
+    PVBSFWORKITEM    pCurrent;
+} VBSFWORKER;
+
+static struct
+{
+    /** Protects the queues and VBSFWORKER::pCurrent. */
+    RTCRITSECT       CritSect;
+    /** Signalled by the workers when a call was completed. */
+    RTSEMEVENT       hEvtDone;
+    /** The function executing the calls. */
+    PFNVBSFWORKER    pfnWorker;
+    /** The number of running workers, 0 if calls are processed synchronously. */
+    uint32_t         cWorkers;
+    /** The worker to try first for the next path based call. */
+    uint32_t         iNextAny;
+    /** Tells the workers to terminate. */
+    bool volatile    fShutdown;
+    /** The workers. */
+    VBSFWORKER       aWorkers[VBSF_WORKERS_MAX];
+} g_Workers;
+
+
+static DECLCALLBACK(int) vbsfWorkerThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    VBSFWORKER *pWorker = (VBSFWORKER *)pvUser;
+    NOREF(hThreadSelf);
+
+    for (;;)
+    {
+        RTCritSectEnter(&g_Workers.CritSect);
+        PVBSFWORKITEM pItem = pWorker->pHead;
+        if (pItem)
+        {
+            pWorker->pHead = pItem->pNext;
+            if (!pWorker->pHead)
+                pWorker->pTail = NULL;
+            pWorker->pCurrent = pItem;
+        }
+        RTCritSectLeave(&g_Workers.CritSect);
+
+        if (!pItem)
+        {
+            if (ASMAtomicReadBool(&g_Workers.fShutdown))
+                break;
+            RTSemEventWait(pWorker->hEvt, RT_INDEFINITE_WAIT);
+            continue;
+        }
+
+        g_Workers.pfnWorker(pItem);
+
+        RTCritSectEnter(&g_Workers.CritSect);
+        pWorker->pCurrent = NULL;
+        RTCritSectLeave(&g_Workers.CritSect);
+
+        RTMemFree(pItem);
+        RTSemEventSignal(g_Workers.hEvtDone);
+    }
+
+    return VINF_SUCCESS;
+}
+
+/**
+ * Starts the worker threads.
+ *
+ * @returns IPRT status code.
+ * @param   cWorkers    The number of threads. 0 means the calls are executed
+ *                      synchronously on the service thread.
+ * @param   pfnWorker   The function executing and completing a call.
+ */
+int vbsfWorkersInit(uint32_t cWorkers, PFNVBSFWORKER pfnWorker)
+{
+    AssertReturn(cWorkers <= VBSF_WORKERS_MAX, VERR_INVALID_PARAMETER);
+    AssertReturn(g_Workers.cWorkers == 0, VERR_WRONG_ORDER);
+    if (!cWorkers)
+        return VINF_SUCCESS;
+
+    g_Workers.pfnWorker = pfnWorker;
+    g_Workers.fShutdown = false;
+    int rc = RTCritSectInit(&g_Workers.CritSect);
+    if (RT_SUCCESS(rc))
+    {
+        rc = RTSemEventCreate(&g_Workers.hEvtDone);
+        if (RT_SUCCESS(rc))
+        {
+            for (uint32_t i = 0; i < cWorkers; i++)
+            {
+                VBSFWORKER *pWorker = &g_Workers.aWorkers[i];
+                RT_ZERO(*pWorker);
+                rc = RTSemEventCreate(&pWorker->hEvt);
+                if (RT_SUCCESS(rc))
+                {
+                    rc = RTThreadCreateF(&pWorker->hThread, vbsfWorkerThread, pWorker, 0,
+                                         RTTHREADTYPE_IO, RTTHREADFLAGS_WAITABLE, "ShFl%u", i);
+                    if (RT_SUCCESS(rc))
+                    {
+                        g_Workers.cWorkers = i + 1;
+                        continue;
+                    }
+                    RTSemEventDestroy(pWorker->hEvt);
+                }
+                break;
+            }
+            if (g_Workers.cWorkers)
+            {
+                if (RT_FAILURE(rc))
+                    LogRel(("SharedFolders host service: only %u of %u worker threads started, rc=%Rrc\n",
+                            g_Workers.cWorkers, cWorkers, rc));
+                return VINF_SUCCESS;
+            }
+            RTSemEventDestroy(g_Workers.hEvtDone);
+        }
+        RTCritSectDelete(&g_Workers.CritSect);
+    }
+    LogRel(("SharedFolders host service: failed to start the worker threads, rc=%Rrc\n", rc));
+    return rc;
+}
+
+/**
+ * Stops the worker threads after all queued calls were executed.
+ */
+void vbsfWorkersTerm(void)
+{
+    if (!g_Workers.cWorkers)
+        return;
+
+    vbsfWorkersDrain(NULL);
+
+    ASMAtomicWriteBool(&g_Workers.fShutdown, true);
+    for (uint32_t i = 0; i < g_Workers.cWorkers; i++)
+        RTSemEventSignal(g_Workers.aWorkers[i].hEvt);
+    for (uint32_t i = 0; i < g_Workers.cWorkers; i++)
+    {
+        VBSFWORKER *pWorker = &g_Workers.aWorkers[i];
+        int rc = RTThreadWait(pWorker->hThread, RT_INDEFINITE_WAIT, NULL);
+        AssertRC(rc);
+        RTSemEventDestroy(pWorker->hEvt);
+        pWorker->hEvt    = NIL_RTSEMEVENT;
+        pWorker->hThread = NIL_RTTHREAD;
+    }
+    g_Workers.cWorkers = 0;
+
+    RTSemEventDestroy(g_Workers.hEvtDone);
+    g_Workers.hEvtDone = NIL_RTSEMEVENT;
+    RTCritSectDelete(&g_Workers.CritSect);
+}
+
+/**
+ * Checks whether blocking calls should be queued.
+ */
+bool vbsfWorkersActive(void)
+{
+    return g_Workers.cWorkers != 0;
+}
+
+/**
+ * Picks the worker for a call not bound to a handle: the first idle one,
+ * otherwise the one with the shortest queue. Called with the lock held.
+ */
+static VBSFWORKER *vbsfWorkerPickAny(void)
+{
+    VBSFWORKER *pBest = NULL;
+    uint32_t    cBest = UINT32_MAX;
+    for (uint32_t i = 0; i < g_Workers.cWorkers; i++)
+    {
+        VBSFWORKER *pWorker = &g_Workers.aWorkers[(g_Workers.iNextAny + i) % g_Workers.cWorkers];
+        uint32_t    cItems  = pWorker->pCurrent ? 1 : 0;
+        for (PVBSFWORKITEM pItem = pWorker->pHead; pItem && cItems < cBest; pItem = pItem->pNext)
+            cItems++;
+        if (cItems < cBest)
+        {
+            pBest = pWorker;
+            cBest = cItems;
+            if (!cItems)
+                break;
+        }
+    }
+    g_Workers.iNextAny = (uint32_t)(pBest - &g_Workers.aWorkers[0] + 1) % g_Workers.cWorkers;
+    return pBest;
+}
+
+/**
+ * Queues a call for the worker owning the handle, or for any worker.
+ *
+ * On success the call is completed by the worker, on failure the caller must
+ * complete it.
+ *
+ * @returns IPRT status code.
+ * @param   pClient     The client.
+ * @param   root        The root the call operates on.
+ * @param   Handle      The handle the call operates on, determines the worker.
+ *                      SHFL_HANDLE_NIL for path based calls, which go to an
+ *                      idle worker.
+ * @param   hCall       The HGCM call handle.
+ * @param   u32Function The function number.
+ * @param   cParms      The number of parameters.
+ * @param   paParms     The parameters.
+ */
+int vbsfWorkerQueue(PSHFLCLIENTDATA pClient, SHFLROOT root, SHFLHANDLE Handle, VBOXHGCMCALLHANDLE hCall,
+                    uint32_t u32Function, uint32_t cParms, VBOXHGCMSVCPARM *paParms)
+{
+    AssertReturn(g_Workers.cWorkers, VERR_WRONG_ORDER);
+
+    PVBSFWORKITEM pItem = (PVBSFWORKITEM)RTMemAlloc(sizeof(*pItem));
+    if (!pItem)
+        return VERR_NO_MEMORY;
+    pItem->pNext       = NULL;
+    pItem->pClient     = pClient;
+    pItem->root        = root;
+    pItem->hCall       = hCall;
+    pItem->u32Function = u32Function;
+    pItem->cParms      = cParms;
+    pItem->paParms     = paParms;
+
+    RTCritSectEnter(&g_Workers.CritSect);
+    VBSFWORKER *pWorker = Handle != SHFL_HANDLE_NIL
+                        ? &g_Workers.aWorkers[Handle % g_Workers.cWorkers]
+                        : vbsfWorkerPickAny();
+    if (pWorker->pTail)
+        pWorker->pTail->pNext = pItem;
+    else
+        pWorker->pHead = pItem;
+    pWorker->pTail = pItem;
+    RTCritSectLeave(&g_Workers.CritSect);
+
+    RTSemEventSignal(pWorker->hEvt);
+    return VINF_SUCCESS;
+}
+
+/**
+ * Checks whether a queued or executing call matches the drain filter.
+ */
+DECLINLINE(bool) vbsfWorkItemMatches(PVBSFWORKITEM pItem, PSHFLCLIENTDATA pClient, SHFLROOT root)
+{
+    return (!pClient || pItem->pClient == pClient)
+        && (root == SHFL_ROOT_NIL || pItem->root == root);
+}
+
+/**
+ * Waits until all calls matching the filter have been completed.
+ *
+ * @param   pClient     The client, NULL for all clients.
+ * @param   root        The root, SHFL_ROOT_NIL for all roots.
+ */
+static void vbsfWorkersDrainWorker(PSHFLCLIENTDATA pClient, SHFLROOT root)
+{
+    if (!g_Workers.cWorkers)
+        return;
+
+    for (;;)
+    {
+        bool fBusy = false;
+        RTCritSectEnter(&g_Workers.CritSect);
+        for (uint32_t i = 0; i < g_Workers.cWorkers && !fBusy; i++)
+        {
+            VBSFWORKER *pWorker = &g_Workers.aWorkers[i];
+            if (pWorker->pCurrent && vbsfWorkItemMatches(pWorker->pCurrent, pClient, root))
+                fBusy = true;
+            for (PVBSFWORKITEM pItem = pWorker->pHead; pItem && !fBusy; pItem = pItem->pNext)
+                if (vbsfWorkItemMatches(pItem, pClient, root))
+                    fBusy = true;
+        }
+        RTCritSectLeave(&g_Workers.CritSect);
+        if (!fBusy)
+            break;
+
+        /* The timeout is only a safety net, the workers signal every completion. */
+        RTSemEventWait(g_Workers.hEvtDone, 100);
+    }
+}
+
+/**
+ * Waits until all calls of a client have been completed.
+ *
+ * Must be called before anything the queued calls may refer to is destroyed,
+ * i.e. the client data or handles.
+ *
+ * @param   pClient     The client, NULL for all clients.
+ */
+void vbsfWorkersDrain(PSHFLCLIENTDATA pClient)
+{
+    vbsfWorkersDrainWorker(pClient, SHFL_ROOT_NIL);
+}
+
+/**
+ * Waits until all calls operating on a root have been completed.
+ *
+ * Must be called before the mapping is unmapped or removed.  Calls on other
+ * roots keep going.
+ *
+ * @param   root        The root.
+ */
+void vbsfWorkersDrainRoot(SHFLROOT root)
+{
+    AssertReturnVoid(root != SHFL_ROOT_NIL);
+    vbsfWorkersDrainWorker(NULL, root);
+}
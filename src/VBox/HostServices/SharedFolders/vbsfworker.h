@@ -0,0 +1,68 @@
+/** @file
+ * Shared Folders: Worker threads for the blocking handle and path based functions.
+ */
+
+/*
+ * Copyright (C) 2006-2015 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+#ifndef __VBSFWORKER__H
+#define __VBSFWORKER__H
+
+#include "shfl.h"
+#include <VBox/shflsvc.h>
+
+/** The default number of worker threads. */
+#define VBSF_WORKERS_DEFAULT    4
+/** The maximum number of worker threads. */
+#define VBSF_WORKERS_MAX        16
+
+/**
+ * A guest call queued for a worker thread.
+ */
+typedef struct VBSFWORKITEM
+{
+    /** Next item in the worker queue. */
+    struct VBSFWORKITEM *pNext;
+    /** The client the call belongs to. */
+    PSHFLCLIENTDATA      pClient;
+    /** The root the call operates on, SHFL_ROOT_NIL if malformed. */
+    SHFLROOT             root;
+    /** The HGCM call handle to complete. */
+    VBOXHGCMCALLHANDLE   hCall;
+    /** The function number. */
+    uint32_t             u32Function;
+    /** The number of parameters. */
+    uint32_t             cParms;
+    /** The parameters, owned by HGCM until the call is completed. */
+    VBOXHGCMSVCPARM     *paParms;
+} VBSFWORKITEM;
+/** Pointer to a queued guest call. */
+typedef VBSFWORKITEM *PVBSFWORKITEM;
+
+/**
+ * Executes a queued call on a worker thread and completes it.
+ *
+ * @param   pItem       The call.
+ */
+typedef DECLCALLBACK(void) FNVBSFWORKER(PVBSFWORKITEM pItem);
+/** Pointer to a FNVBSFWORKER. */
+typedef FNVBSFWORKER *PFNVBSFWORKER;
+
+int  vbsfWorkersInit(uint32_t cWorkers, PFNVBSFWORKER pfnWorker);
+void vbsfWorkersTerm(void);
+bool vbsfWorkersActive(void);
+int  vbsfWorkerQueue(PSHFLCLIENTDATA pClient, SHFLROOT root, SHFLHANDLE Handle, VBOXHGCMCALLHANDLE hCall,
+                     uint32_t u32Function, uint32_t cParms, VBOXHGCMSVCPARM *paParms);
+void vbsfWorkersDrain(PSHFLCLIENTDATA pClient);
+void vbsfWorkersDrainRoot(SHFLROOT root);
+
+#endif /* __VBSFWORKER__H */
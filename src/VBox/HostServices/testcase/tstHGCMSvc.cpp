@@ -20,8 +20,171 @@
 *   Header Files                                                                                                                 *
 *********************************************************************************************************************************/
 #include <VBox/hgcmsvc.h>
+#include <VBox/VMMDev.h>
 #include <iprt/initterm.h>
+#include <iprt/mem.h>
+#include <iprt/rand.h>
 #include <iprt/test.h>
+#include <iprt/time.h>
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** The number of pages in the test page list. */
+#define TST_PAGES       256
+
+
+/**
+ * Sets up a page list over @a pbPages with the pages in reverse order, so
+ * that the helpers cannot get away with treating it as contiguous.
+ */
+static void tstInitPageList(VBOXHGCMSVCPARMPAGES *pPages, void **papvPages, uint8_t *pbPages, uint32_t offFirstPage)
+{
+    for (uint32_t i = 0; i < TST_PAGES; i++)
+        papvPages[i] = pbPages + (TST_PAGES - 1 - i) * PAGE_SIZE;
+    pPages->cPages       = TST_PAGES;
+    pPages->fFlags       = VBOX_HGCM_F_PARM_DIRECTION_BOTH;
+    pPages->offFirstPage = offFirstPage;
+    pPages->u32Padding   = 0;
+    pPages->papvPages    = papvPages;
+}
+
+
+/**
+ * Tests the page list parameter accessors against a plain buffer.
+ */
+static void tstPageListParms(RTTEST hTest, uint8_t *pbPages, void **papvPages)
+{
+    RTTestSub(hTest, "HGCM page list parameter handling");
+
+    VBOXHGCMSVCPARMPAGES Pages;
+    tstInitPageList(&Pages, papvPages, pbPages, 123);
+    uint32_t const cbBuf = TST_PAGES * PAGE_SIZE - 123;
+
+    VBOXHGCMSVCPARM parm;
+    parm.type             = VBOX_HGCM_SVC_PARM_PAGES;
+    parm.u.pages.size     = cbBuf;
+    parm.u.pages.pPages   = &Pages;
+
+    PVBOXHGCMSVCPARMPAGES pPagesRet = NULL;
+    uint32_t cbRet = 0;
+    RTTEST_CHECK_RC(hTest, parm.getPages(&pPagesRet, &cbRet), VINF_SUCCESS);
+    RTTEST_CHECK(hTest, pPagesRet == &Pages && cbRet == cbBuf);
+    RTTEST_CHECK(hTest, parm.getBufferSize() == cbBuf);
+    void *pv = NULL;
+    RTTEST_CHECK_RC(hTest, parm.getPointer(&pv, &cbRet), VERR_INVALID_PARAMETER);
+
+    uint8_t *pbRef = (uint8_t *)RTMemAlloc(cbBuf);
+    uint8_t *pbTmp = (uint8_t *)RTMemAlloc(cbBuf);
+    RTTEST_CHECK_RETV(hTest, pbRef && pbTmp);
+    RTRandBytes(pbRef, cbBuf);
+
+    /* Write in odd sized chunks crossing page boundaries and read it all back. */
+    uint32_t off = 0;
+    while (off < cbBuf)
+    {
+        uint32_t cb = RT_MIN(RTRandU32Ex(1, 3 * PAGE_SIZE), cbBuf - off);
+        RTTEST_CHECK_RC_BREAK(hTest, parm.writeBuffer(off, &pbRef[off], cb), VINF_SUCCESS);
+        off += cb;
+    }
+    RTTEST_CHECK_RC(hTest, parm.readBuffer(0, pbTmp, cbBuf), VINF_SUCCESS);
+    RTTEST_CHECK(hTest, memcmp(pbTmp, pbRef, cbBuf) == 0);
+
+    /* The data starts at offFirstPage of the first (i.e. last) page. */
+    RTTEST_CHECK(hTest, memcmp(pbPages + (TST_PAGES - 1) * PAGE_SIZE + 123, pbRef, PAGE_SIZE - 123) == 0);
+
+    /* Random reads. */
+    for (unsigned i = 0; i < 1000; i++)
+    {
+        uint32_t offRead = RTRandU32Ex(0, cbBuf - 1);
+        uint32_t cbRead  = RTRandU32Ex(0, cbBuf - offRead);
+        RTTEST_CHECK_RC_BREAK(hTest, parm.readBuffer(offRead, pbTmp, cbRead), VINF_SUCCESS);
+        RTTEST_CHECK_BREAK(hTest, memcmp(pbTmp, &pbRef[offRead], cbRead) == 0);
+    }
+
+    /* Out of bounds. */
+    RTTEST_CHECK_RC(hTest, parm.readBuffer(cbBuf, pbTmp, 1), VERR_INVALID_PARAMETER);
+    RTTEST_CHECK_RC(hTest, parm.readBuffer(1, pbTmp, cbBuf), VERR_INVALID_PARAMETER);
+    RTTEST_CHECK_RC(hTest, parm.writeBuffer(UINT32_MAX, pbTmp, 2), VERR_INVALID_PARAMETER);
+    RTTEST_CHECK_RC(hTest, parm.readBuffer(cbBuf, pbTmp, 0), VINF_SUCCESS);
+
+    /* The same accessors work on plain pointer parameters. */
+    parm.setPointer(pbTmp, cbBuf);
+    RTTEST_CHECK(hTest, parm.getBufferSize() == cbBuf);
+    RTTEST_CHECK_RC(hTest, parm.getPages(&pPagesRet, &cbRet), VERR_INVALID_PARAMETER);
+    RTTEST_CHECK_RC(hTest, parm.writeBuffer(10, "abc", 3), VINF_SUCCESS);
+    RTTEST_CHECK(hTest, memcmp(&pbTmp[10], "abc", 3) == 0);
+    parm.setUInt32(42);
+    RTTEST_CHECK(hTest, parm.getBufferSize() == 0);
+    RTTEST_CHECK_RC(hTest, parm.readBuffer(0, pbTmp, 1), VERR_INVALID_PARAMETER);
+
+    RTMemFree(pbTmp);
+    RTMemFree(pbRef);
+    RTTestSubDone(hTest);
+}
+
+
+/**
+ * Compares what a service pays for consuming and producing a buffer when it is
+ * passed as a heap copy (VBOX_HGCM_SVC_PARM_PTR, copied in and out of the
+ * guest pages around the call) and when it gets the pages themselves.
+ */
+static void tstPageListBenchmark(RTTEST hTest, uint8_t *pbPages, void **papvPages)
+{
+    RTTestSub(hTest, "Page list vs. bounce buffer benchmark");
+
+    VBOXHGCMSVCPARMPAGES Pages;
+    tstInitPageList(&Pages, papvPages, pbPages, 0);
+
+    /* Where the service gets its data from and puts it, e.g. a file cache. */
+    uint8_t *pbSvc = (uint8_t *)RTMemAlloc(TST_PAGES * PAGE_SIZE);
+    RTTEST_CHECK_RETV(hTest, pbSvc);
+    RTRandBytes(pbSvc, TST_PAGES * PAGE_SIZE);
+
+    static uint32_t const s_acb[] = { _4K, _64K, TST_PAGES * PAGE_SIZE };
+    for (unsigned iSize = 0; iSize < RT_ELEMENTS(s_acb); iSize++)
+    {
+        uint32_t const cb          = s_acb[iSize];
+        uint32_t const cIterations = RT_MAX(_64M / cb, 64);
+
+        /* Bounce buffer: allocate, copy in, service copies, copy out, free. */
+        uint64_t nsStart = RTTimeNanoTS();
+        for (uint32_t i = 0; i < cIterations; i++)
+        {
+            void *pvBounce = RTMemAlloc(cb);
+            VBoxHGCMSvcPagesRead(&Pages, 0, pvBounce, cb);
+            VBOXHGCMSVCPARM parm;
+            parm.setPointer(pvBounce, cb);
+            parm.readBuffer(0, pbSvc, cb);
+            parm.writeBuffer(0, pbSvc, cb);
+            VBoxHGCMSvcPagesWrite(&Pages, 0, pvBounce, cb);
+            RTMemFree(pvBounce);
+        }
+        uint64_t cNsBounce = (RTTimeNanoTS() - nsStart) / cIterations;
+
+        /* Page list: the service accesses the pages directly. */
+        nsStart = RTTimeNanoTS();
+        for (uint32_t i = 0; i < cIterations; i++)
+        {
+            VBOXHGCMSVCPARM parm;
+            parm.type           = VBOX_HGCM_SVC_PARM_PAGES;
+            parm.u.pages.size   = cb;
+            parm.u.pages.pPages = &Pages;
+            parm.readBuffer(0, pbSvc, cb);
+            parm.writeBuffer(0, pbSvc, cb);
+        }
+        uint64_t cNsPages = (RTTimeNanoTS() - nsStart) / cIterations;
+
+        RTTestValueF(hTest, cNsBounce, RTTESTUNIT_NS_PER_CALL, "Bounce buffer, %u bytes", cb);
+        RTTestValueF(hTest, cNsPages,  RTTESTUNIT_NS_PER_CALL, "Page list, %u bytes", cb);
+        RTTestValueF(hTest, cNsPages ? cNsBounce * 100 / cNsPages : 0, RTTESTUNIT_PCT, "Bounce/page list, %u bytes", cb);
+    }
+
+    RTMemFree(pbSvc);
+    RTTestSubDone(hTest);
+}
+
 
 int main()
 {
@@ -40,6 +203,18 @@ int main()
     VBOXHGCMSVCPARM parm;
     parm.testGetString(hTest);
 
+    uint8_t *pbPages  = (uint8_t *)RTMemPageAlloc(TST_PAGES * PAGE_SIZE);
+    void   **papvPages = (void **)RTMemAlloc(TST_PAGES * sizeof(void *));
+    if (pbPages && papvPages)
+    {
+        tstPageListParms(hTest, pbPages, papvPages);
+        tstPageListBenchmark(hTest, pbPages, papvPages);
+    }
+    else
+        RTTestFailed(hTest, "out of memory");
+    RTMemFree(papvPages);
+    RTMemPageFree(pbPages, TST_PAGES * PAGE_SIZE);
+
     /*
      * Summary
      */
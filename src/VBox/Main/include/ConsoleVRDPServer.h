@@ -212,6 +212,12 @@ private:
 
     RTCRITSECT mCritSect;
 
+    /* Serializes the display updates sent to the server, they come from the EMT
+     * as well as from the VBVA flush thread of the VGA device.  Resizes are not
+     * taken under it, the server queries the framebuffer then, which calls the
+     * VGA device; they are serialized with the flush thread by the VGA lock. */
+    mutable RTCRITSECT mUpdateLock;
+
     int lockConsoleVRDPServer (void);
     void unlockConsoleVRDPServer (void);
 
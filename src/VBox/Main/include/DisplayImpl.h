@@ -33,6 +33,10 @@
 
 #include "DisplaySourceBitmapWrap.h"
 
+#ifdef VBOX_WITH_VPX
+# include "VideoRec.h"
+#endif
+
 class Console;
 struct VIDEORECCONTEXT;
 
@@ -77,6 +81,29 @@ typedef struct _DISPLAYFBINFO
     /** The framebuffer has default format and must be updates immediately. */
     bool fDefaultFormat;
 
+    /** Screenshot cache for VBVA screens, see Display::i_takeScreenshotCached. */
+    struct
+    {
+        /** Incremented on every update and resize of the screen. */
+        volatile uint32_t uDamageGen;
+        /** Set when the shadow has to be copied in full. */
+        volatile bool fShadowStale;
+        /** Dirty tile bitmap, allocated by the first screenshot. */
+        uint32_t * volatile pbmDirty;
+        /** 32bpp copy of the guest screen, updated from the dirty tiles. */
+        uint8_t *pu8Shadow;
+        uint32_t cxShadow;
+        uint32_t cyShadow;
+        /** The damage generation the shadow is current for. */
+        uint32_t uShadowGen;
+        /** The last scaled screenshot. */
+        uint8_t *pu8Scaled;
+        uint32_t cxScaled;
+        uint32_t cyScaled;
+        /** The damage generation the scaled screenshot was made at. */
+        uint32_t uScaledGen;
+    } screenshot;
+
 #ifdef VBOX_WITH_HGSMI
     bool fVBVAEnabled;
     bool fVBVAForceResize;
@@ -151,6 +178,7 @@ public:
     int  i_handleDisplayResize(unsigned uScreenId, uint32_t bpp, void *pvVRAM, uint32_t cbLine,
                                uint32_t w, uint32_t h, uint16_t flags);
     void i_handleDisplayUpdate(unsigned uScreenId, int x, int y, int w, int h);
+    void i_completeUpdateSequence();
     void i_handleUpdateVMMDevSupportsGraphics(bool fSupportsGraphics);
     void i_handleUpdateGuestVBVACapabilities(uint32_t fNewCapabilities);
     void i_handleUpdateVBVAInputMapping(int32_t xOrigin, int32_t yOrigin, uint32_t cx, uint32_t cy);
@@ -350,6 +378,7 @@ private:
 
     static DECLCALLBACK(void)  i_displayVBVAInputMappingUpdate(PPDMIDISPLAYCONNECTOR pInterface, int32_t xOrigin, int32_t yOrigin,
                                                                uint32_t cx, uint32_t cy);
+    static DECLCALLBACK(void)  i_displayVBVAUpdateComplete(PPDMIDISPLAYCONNECTOR pInterface);
 #endif
 
 #if defined(VBOX_WITH_HGCM) && defined(VBOX_WITH_CROGL)
@@ -445,10 +474,17 @@ private:
     /* Serializes access to mVideoAccelLegacy and mfVideoAccelVRDP, etc between VRDP and Display. */
     RTCRITSECT mVideoAccelLock;
 
+    /* Serializes the screenshot callers, protects DISPLAYFBINFO::screenshot except the damage tracking. */
+    RTCRITSECT mScreenshotLock;
+
+    void i_screenshotInvalidate(unsigned uScreenId);
+    static int i_displayUpdateScreenshotShadowEMT(Display *pDisplay, ULONG aScreenId);
+
 public:
 
     static int i_displayTakeScreenshotEMT(Display *pDisplay, ULONG aScreenId, uint8_t **ppbData, size_t *pcbData,
                                           uint32_t *pcx, uint32_t *pcy, bool *pfMemFree);
+    int i_takeScreenshotCached(PUVM pUVM, ULONG aScreenId, uint8_t *pbDst, uint32_t cxDst, uint32_t cyDst);
 #if defined(VBOX_WITH_HGCM) && defined(VBOX_WITH_CROGL)
     static BOOL  i_displayCheckTakeScreenshotCrOgl(Display *pDisplay, ULONG aScreenId, uint8_t *pbData,
                                                    uint32_t u32Width, uint32_t u32Height);
@@ -484,6 +520,7 @@ private:
 #ifdef VBOX_WITH_VPX
     VIDEORECCONTEXT *mpVideoRecCtx;
     bool maVideoRecEnabled[SchemaDefs::MaxGuestMonitors];
+    VIDEORECSTATS maVideoRecStats[SchemaDefs::MaxGuestMonitors];
 #endif
 };
 
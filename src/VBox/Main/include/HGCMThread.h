@@ -87,6 +87,11 @@ class HGCMMsgCore: public HGCMObject
     public:
         HGCMMsgCore () : HGCMObject(HGCMOBJ_MSG) {};
 
+        /** Messages are allocated and freed for every guest call, so they
+         *  come from a pool, see hgcmMsgPoolAlloc. */
+        void *operator new (size_t cb) throw();
+        void operator delete (void *pv, size_t cb);
+
         uint32_t MsgId (void) { return m_u32Msg; };
 
         HGCMThread *Thread (void) { return m_pThread; };
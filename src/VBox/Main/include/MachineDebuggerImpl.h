@@ -21,6 +21,8 @@
 #include "MachineDebuggerWrap.h"
 #include <iprt/log.h>
 #include <VBox/vmm/em.h>
+#include <VBox/vmm/stam.h>
+#include <map>
 
 class Console;
 
@@ -127,6 +129,10 @@ private:
     HRESULT getStats(const com::Utf8Str &aPattern,
                      BOOL aWithDescriptions,
                      com::Utf8Str &aStats);
+    HRESULT getStatsBinary(const com::Utf8Str &aPattern,
+                           const com::Utf8Str &aConsumer,
+                           BOOL aWithNames,
+                           std::vector<BYTE> &aStats);
 
     // private methods
     bool i_queueSettings() const;
@@ -153,6 +159,10 @@ private:
     uint32_t mVirtualTimeRateQueued;
     bool mFlushMode;
     /** @}  */
+
+    /** The binary statistics delta baselines of the getStatsBinary consumers. */
+    typedef std::map<com::Utf8Str, PSTAMSNAPSHOTBINBASELINE> StatsBaselineMap;
+    StatsBaselineMap mStatsBaselines;
 };
 
 #endif /* !____H_MACHINEDEBUGGER */
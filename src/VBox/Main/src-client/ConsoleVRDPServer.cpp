@@ -1314,6 +1314,9 @@ ConsoleVRDPServer::ConsoleVRDPServer(Console *console)
     int rc = RTCritSectInit(&mCritSect);
     AssertRC(rc);
 
+    rc = RTCritSectInit(&mUpdateLock);
+    AssertRC(rc);
+
     mcClipboardRefs = 0;
     mpfnClipboardCallback = NULL;
 #ifdef VBOX_WITH_USB
@@ -1421,6 +1424,12 @@ ConsoleVRDPServer::~ConsoleVRDPServer()
         RT_ZERO(mCritSect);
     }
 
+    if (RTCritSectIsInitialized(&mUpdateLock))
+    {
+        RTCritSectDelete(&mUpdateLock);
+        RT_ZERO(mUpdateLock);
+    }
+
     if (RTCritSectIsInitialized(&mTSMFLock))
     {
         RTCritSectDelete(&mTSMFLock);
@@ -3671,7 +3680,9 @@ void ConsoleVRDPServer::SendUpdate(unsigned uScreenId, void *pvUpdate, uint32_t
 {
     if (mpEntryPoints && mhServer)
     {
+        RTCritSectEnter(&mUpdateLock);
         mpEntryPoints->VRDEUpdate(mhServer, uScreenId, pvUpdate, cbUpdate);
+        RTCritSectLeave(&mUpdateLock);
     }
 }
 
@@ -3694,7 +3705,9 @@ void ConsoleVRDPServer::SendUpdateBitmap(unsigned uScreenId, uint32_t x, uint32_
     update.h = h;
     if (mpEntryPoints && mhServer)
     {
+        RTCritSectEnter(&mUpdateLock);
         mpEntryPoints->VRDEUpdate(mhServer, uScreenId, &update, sizeof(update));
+        RTCritSectLeave(&mUpdateLock);
     }
 }
 
@@ -123,6 +123,11 @@ HRESULT Display::FinalConstruct()
     rc = RTCritSectInit(&mVideoAccelLock);
     AssertRC(rc);
 
+    rc = RTCritSectInit(&mScreenshotLock);
+    AssertRC(rc);
+    for (unsigned i = 0; i < RT_ELEMENTS(maFramebuffers); i++)
+        RT_ZERO(maFramebuffers[i].screenshot);
+
 #ifdef VBOX_WITH_HGSMI
     mu32UpdateVBVAFlags = 0;
     mfVMMDevSupportsGraphics = false;
@@ -133,6 +138,7 @@ HRESULT Display::FinalConstruct()
     mpVideoRecCtx = NULL;
     for (unsigned i = 0; i < RT_ELEMENTS(maVideoRecEnabled); i++)
         maVideoRecEnabled[i] = true;
+    RT_ZERO(maVideoRecStats);
 #endif
 
 #ifdef VBOX_WITH_CRHGSMI
@@ -167,6 +173,19 @@ void Display::FinalRelease()
         RT_ZERO(mVideoAccelLock);
     }
 
+    for (unsigned i = 0; i < RT_ELEMENTS(maFramebuffers); i++)
+    {
+        RTMemFree(maFramebuffers[i].screenshot.pbmDirty);
+        RTMemFree(maFramebuffers[i].screenshot.pu8Shadow);
+        RTMemFree(maFramebuffers[i].screenshot.pu8Scaled);
+        RT_ZERO(maFramebuffers[i].screenshot);
+    }
+    if (RTCritSectIsInitialized(&mScreenshotLock))
+    {
+        RTCritSectDelete(&mScreenshotLock);
+        RT_ZERO(mScreenshotLock);
+    }
+
 #ifdef VBOX_WITH_CRHGSMI
     if (RTCritSectRwIsInitialized (&mCrOglLock))
     {
@@ -888,6 +907,8 @@ int Display::i_handleDisplayResize(unsigned uScreenId, uint32_t bpp, void *pvVRA
 
     DISPLAYFBINFO *pFBInfo = &maFramebuffers[uScreenId];
 
+    i_screenshotInvalidate(uScreenId);
+
     /* Reset the update mode. */
     pFBInfo->updateImage.pSourceBitmap.setNull();
     pFBInfo->updateImage.pu8Address = NULL;
@@ -967,6 +988,39 @@ int Display::i_handleDisplayResize(unsigned uScreenId, uint32_t bpp, void *pvVRA
     return VINF_SUCCESS;
 }
 
+/** Screenshot shadow tiles are 1 << DISPLAY_SHOT_TILE_SHIFT pixels square. */
+#define DISPLAY_SHOT_TILE_SHIFT     7
+/** Tiles per line and column of the dirty bitmap, which covers 32768x32768 pixels. */
+#define DISPLAY_SHOT_TILES          256
+
+/**
+ * Records damage for the screenshot cache: bumps the damage generation and
+ * marks the touched tiles of the shadow dirty.  Called with clipped coordinates.
+ */
+static void displayScreenshotMarkDirty(DISPLAYFBINFO *pFBInfo, int x, int y, int w, int h)
+{
+    ASMAtomicIncU32(&pFBInfo->screenshot.uDamageGen);
+
+    uint32_t *pbmDirty = ASMAtomicReadPtrT(&pFBInfo->screenshot.pbmDirty, uint32_t *);
+    if (pbmDirty)
+    {
+        int const txLast = RT_MIN((x + w - 1) >> DISPLAY_SHOT_TILE_SHIFT, DISPLAY_SHOT_TILES - 1);
+        int const tyLast = RT_MIN((y + h - 1) >> DISPLAY_SHOT_TILE_SHIFT, DISPLAY_SHOT_TILES - 1);
+        for (int ty = y >> DISPLAY_SHOT_TILE_SHIFT; ty <= tyLast; ty++)
+            for (int tx = x >> DISPLAY_SHOT_TILE_SHIFT; tx <= txLast; tx++)
+                ASMAtomicBitSet(pbmDirty, ty * DISPLAY_SHOT_TILES + tx);
+    }
+}
+
+/**
+ * Drops the screenshot cache of a screen after its layout or source changed.
+ */
+void Display::i_screenshotInvalidate(unsigned uScreenId)
+{
+    ASMAtomicWriteBool(&maFramebuffers[uScreenId].screenshot.fShadowStale, true);
+    ASMAtomicIncU32(&maFramebuffers[uScreenId].screenshot.uDamageGen);
+}
+
 static void i_checkCoordBounds(int *px, int *py, int *pw, int *ph, int cx, int cy)
 {
     /* Correct negative x and y coordinates. */
@@ -1025,6 +1079,14 @@ void Display::i_handleDisplayUpdate(unsigned uScreenId, int x, int y, int w, int
     i_checkCoordBounds (&x, &y, &w, &h, maFramebuffers[uScreenId].w,
                                         maFramebuffers[uScreenId].h);
 
+#ifdef VBOX_WITH_VPX
+    /* Tell video recording what changed so unchanged parts are not converted again. */
+    if (w != 0 && h != 0)
+        VideoRecMarkDirty(mpVideoRecCtx, uScreenId, x, y, w, h);
+#endif
+    if (w != 0 && h != 0)
+        displayScreenshotMarkDirty(&maFramebuffers[uScreenId], x, y, w, h);
+
     IFramebuffer *pFramebuffer = maFramebuffers[uScreenId].pFramebuffer;
     if (pFramebuffer != NULL)
     {
@@ -1981,6 +2043,199 @@ int Display::i_displayTakeScreenshotEMT(Display *pDisplay, ULONG aScreenId, uint
     return rc;
 }
 
+/**
+ * Brings the screenshot shadow of a VBVA screen up to date by copying the
+ * tiles damaged since the last call from VRAM.
+ *
+ * @returns VBox status code, VERR_NOT_SUPPORTED if the shadow can't be used.
+ * @param   pDisplay    The display.
+ * @param   aScreenId   The screen.
+ * @thread  EMT
+ */
+/* static */
+int Display::i_displayUpdateScreenshotShadowEMT(Display *pDisplay, ULONG aScreenId)
+{
+    DISPLAYFBINFO *pFBInfo = &pDisplay->maFramebuffers[aScreenId];
+#ifdef VBOX_WITH_HGSMI
+    if (!pFBInfo->fVBVAEnabled || pFBInfo->fRenderThreadMode)
+        return VERR_NOT_SUPPORTED;
+#else
+    return VERR_NOT_SUPPORTED;
+#endif
+
+    uint32_t const cx = pFBInfo->w;
+    uint32_t const cy = pFBInfo->h;
+    if (   !cx || cx > DISPLAY_SHOT_TILES << DISPLAY_SHOT_TILE_SHIFT
+        || !cy || cy > DISPLAY_SHOT_TILES << DISPLAY_SHOT_TILE_SHIFT
+        || !pFBInfo->pu8FramebufferVRAM)
+        return VERR_NOT_SUPPORTED;
+
+    uint32_t *pbmDirty = pFBInfo->screenshot.pbmDirty;
+    int rc = VINF_SUCCESS;
+    if (   ASMAtomicXchgBool(&pFBInfo->screenshot.fShadowStale, false)
+        || pFBInfo->screenshot.cxShadow != cx
+        || pFBInfo->screenshot.cyShadow != cy)
+    {
+        /* Clear the dirty bits before copying, damage arriving meanwhile is picked up next time. */
+        for (unsigned i = 0; i < DISPLAY_SHOT_TILES * DISPLAY_SHOT_TILES / 32; i++)
+            ASMAtomicWriteU32(&pbmDirty[i], 0);
+
+        if (   !pFBInfo->screenshot.pu8Shadow
+            || pFBInfo->screenshot.cxShadow * pFBInfo->screenshot.cyShadow != cx * cy)
+        {
+            RTMemFree(pFBInfo->screenshot.pu8Shadow);
+            pFBInfo->screenshot.pu8Shadow = (uint8_t *)RTMemAlloc(cx * cy * 4);
+        }
+        pFBInfo->screenshot.cxShadow = cx;
+        pFBInfo->screenshot.cyShadow = cy;
+        if (!pFBInfo->screenshot.pu8Shadow)
+            rc = VERR_NO_MEMORY;
+        else
+            rc = pDisplay->mpDrv->pUpPort->pfnCopyRect(pDisplay->mpDrv->pUpPort, cx, cy,
+                                                       pFBInfo->pu8FramebufferVRAM, 0, 0, cx, cy,
+                                                       pFBInfo->u32LineSize, pFBInfo->u16BitsPerPixel,
+                                                       pFBInfo->screenshot.pu8Shadow, 0, 0, cx, cy, cx * 4, 32);
+    }
+    else
+    {
+        /* Copy runs of dirty tiles, a tile row at a time. */
+        uint32_t const cTilesX = (cx + RT_BIT_32(DISPLAY_SHOT_TILE_SHIFT) - 1) >> DISPLAY_SHOT_TILE_SHIFT;
+        uint32_t const cTilesY = (cy + RT_BIT_32(DISPLAY_SHOT_TILE_SHIFT) - 1) >> DISPLAY_SHOT_TILE_SHIFT;
+        for (uint32_t ty = 0; ty < cTilesY && RT_SUCCESS(rc); ty++)
+        {
+            uint32_t const y  = ty << DISPLAY_SHOT_TILE_SHIFT;
+            uint32_t const h  = RT_MIN(RT_BIT_32(DISPLAY_SHOT_TILE_SHIFT), cy - y);
+            uint32_t       tx = 0;
+            while (tx < cTilesX && RT_SUCCESS(rc))
+            {
+                if (!ASMAtomicBitTestAndClear(pbmDirty, ty * DISPLAY_SHOT_TILES + tx))
+                {
+                    tx++;
+                    continue;
+                }
+                uint32_t txEnd = tx + 1;
+                while (txEnd < cTilesX && ASMAtomicBitTestAndClear(pbmDirty, ty * DISPLAY_SHOT_TILES + txEnd))
+                    txEnd++;
+
+                uint32_t const x = tx << DISPLAY_SHOT_TILE_SHIFT;
+                uint32_t const w = RT_MIN(txEnd << DISPLAY_SHOT_TILE_SHIFT, cx) - x;
+                rc = pDisplay->mpDrv->pUpPort->pfnCopyRect(pDisplay->mpDrv->pUpPort, w, h,
+                                                           pFBInfo->pu8FramebufferVRAM, x, y, cx, cy,
+                                                           pFBInfo->u32LineSize, pFBInfo->u16BitsPerPixel,
+                                                           pFBInfo->screenshot.pu8Shadow, x, y, cx, cy, cx * 4, 32);
+                tx = txEnd;
+            }
+        }
+    }
+
+    if (RT_FAILURE(rc))
+    {
+        /* E.g. VBVA paused in the VGA device. */
+        ASMAtomicWriteBool(&pFBInfo->screenshot.fShadowStale, true);
+        return VERR_NOT_SUPPORTED;
+    }
+    return VINF_SUCCESS;
+}
+
+/**
+ * Takes a screenshot of a VBVA screen from the screenshot cache.
+ *
+ * Screenshots and thumbnails are polled by management software much more
+ * often than the guest screen changes.  The screen is therefore kept in a
+ * 32bpp shadow updated from the damaged tiles only, and the last scaled
+ * result is reused until the screen changes, which saves the EMT request.
+ *
+ * @returns VBox status code, failure means the caller has to take the
+ *          screenshot the normal way.
+ * @param   pUVM        The user mode VM handle.
+ * @param   aScreenId   The screen.
+ * @param   pbDst       Where to store the 32bpp image.
+ * @param   cxDst       The requested width.
+ * @param   cyDst       The requested height.
+ */
+int Display::i_takeScreenshotCached(PUVM pUVM, ULONG aScreenId, uint8_t *pbDst, uint32_t cxDst, uint32_t cyDst)
+{
+    if (aScreenId >= mcMonitors || mfIsCr3DEnabled)
+        return VERR_NOT_SUPPORTED;
+    DISPLAYFBINFO *pFBInfo = &maFramebuffers[aScreenId];
+
+    /* Only VBVA screens have a shadow.  Don't make the others pay for an EMT
+       request that can only fail; i_displayUpdateScreenshotShadowEMT checks
+       again in case the mode changes in the meantime. */
+#ifdef VBOX_WITH_HGSMI
+    if (!pFBInfo->fVBVAEnabled || pFBInfo->fRenderThreadMode)
+        return VERR_NOT_SUPPORTED;
+#else
+    return VERR_NOT_SUPPORTED;
+#endif
+
+    RTCritSectEnter(&mScreenshotLock);
+
+    /* Damage after this point invalidates whatever is produced here. */
+    uint32_t const uGen = ASMAtomicReadU32(&pFBInfo->screenshot.uDamageGen);
+
+    int rc = VINF_SUCCESS;
+    if (   pFBInfo->screenshot.pu8Scaled
+        && pFBInfo->screenshot.uScaledGen == uGen
+        && pFBInfo->screenshot.cxScaled == cxDst
+        && pFBInfo->screenshot.cyScaled == cyDst)
+        memcpy(pbDst, pFBInfo->screenshot.pu8Scaled, cxDst * 4 * cyDst);
+    else if (   pFBInfo->screenshot.pu8Shadow
+             && pFBInfo->screenshot.uShadowGen == uGen
+             && pFBInfo->screenshot.cxShadow == cxDst
+             && pFBInfo->screenshot.cyShadow == cyDst)
+        memcpy(pbDst, pFBInfo->screenshot.pu8Shadow, cxDst * 4 * cyDst);
+    else
+    {
+        if (!pFBInfo->screenshot.pbmDirty)
+        {
+            uint32_t *pbmDirty = (uint32_t *)RTMemAllocZ(DISPLAY_SHOT_TILES * DISPLAY_SHOT_TILES / 8);
+            ASMAtomicWritePtr(&pFBInfo->screenshot.pbmDirty, pbmDirty);
+            ASMAtomicWriteBool(&pFBInfo->screenshot.fShadowStale, true);
+        }
+        if (pFBInfo->screenshot.pbmDirty)
+            rc = VMR3ReqPriorityCallWaitU(pUVM, VMCPUID_ANY, (PFNRT)Display::i_displayUpdateScreenshotShadowEMT, 2,
+                                          this, aScreenId);
+        else
+            rc = VERR_NO_MEMORY;
+        if (RT_SUCCESS(rc))
+        {
+            uint32_t const cx = pFBInfo->screenshot.cxShadow;
+            uint32_t const cy = pFBInfo->screenshot.cyShadow;
+            pFBInfo->screenshot.uShadowGen = uGen;
+            if (cx == cxDst && cy == cyDst)
+                memcpy(pbDst, pFBInfo->screenshot.pu8Shadow, cxDst * 4 * cyDst);
+            else
+            {
+                BitmapScale32(pbDst, cxDst, cyDst, pFBInfo->screenshot.pu8Shadow, cx * 4, cx, cy);
+
+                /* Keep it for the next poll. */
+                if (   !pFBInfo->screenshot.pu8Scaled
+                    || pFBInfo->screenshot.cxScaled * pFBInfo->screenshot.cyScaled != cxDst * cyDst)
+                {
+                    RTMemFree(pFBInfo->screenshot.pu8Scaled);
+                    pFBInfo->screenshot.pu8Scaled = (uint8_t *)RTMemAlloc(cxDst * 4 * cyDst);
+                }
+                if (pFBInfo->screenshot.pu8Scaled)
+                {
+                    memcpy(pFBInfo->screenshot.pu8Scaled, pbDst, cxDst * 4 * cyDst);
+                    pFBInfo->screenshot.cxScaled   = cxDst;
+                    pFBInfo->screenshot.cyScaled   = cyDst;
+                    pFBInfo->screenshot.uScaledGen = uGen;
+                }
+                else
+                {
+                    pFBInfo->screenshot.cxScaled = 0;
+                    pFBInfo->screenshot.cyScaled = 0;
+                }
+            }
+        }
+    }
+
+    RTCritSectLeave(&mScreenshotLock);
+    return rc;
+}
+
 static int i_displayTakeScreenshot(PUVM pUVM, Display *pDisplay, struct DRVMAINDISPLAY *pDrv, ULONG aScreenId,
                                    BYTE *address, ULONG width, ULONG height)
 {
@@ -1992,6 +2247,9 @@ static int i_displayTakeScreenshot(PUVM pUVM, Display *pDisplay, struct DRVMAIND
         return VINF_SUCCESS;
 #endif
 
+    if (RT_SUCCESS(pDisplay->i_takeScreenshotCached(pUVM, aScreenId, address, width, height)))
+        return VINF_SUCCESS;
+
     uint8_t *pbData = NULL;
     size_t cbData = 0;
     uint32_t cx = 0;
@@ -2294,7 +2552,8 @@ int Display::i_VideoCaptureStart()
             rc = VideoRecStrmInit(mpVideoRecCtx, uScreen,
                                   pszName, ulWidth, ulHeight,
                                   ulRate, ulFPS, ulMaxTime,
-                                  ulMaxSize, com::Utf8Str(strOptions).c_str());
+                                  ulMaxSize, com::Utf8Str(strOptions).c_str(),
+                                  &maVideoRecStats[uScreen]);
             if (rc == VERR_ALREADY_EXISTS)
             {
                 RTStrFree(pszName);
@@ -2314,7 +2573,8 @@ int Display::i_VideoCaptureStart()
                     rc = VideoRecStrmInit(mpVideoRecCtx, uScreen,
                                           pszName, ulWidth, ulHeight, ulRate,
                                           ulFPS, ulMaxTime,
-                                          ulMaxSize, com::Utf8Str(strOptions).c_str());
+                                          ulMaxSize, com::Utf8Str(strOptions).c_str(),
+                                          &maVideoRecStats[uScreen]);
             }
         }
 
@@ -2989,6 +3249,22 @@ DECLCALLBACK(void) Display::i_displayUpdateCallback(PPDMIDISPLAYCONNECTOR pInter
     pDrv->pDisplay->i_handleDisplayUpdate(VBOX_VIDEO_PRIMARY_SCREEN, x, y, cx, cy);
 }
 
+/**
+ * Informs the VRDP server that the current display update sequence is
+ * completed.  At this moment the framebuffer memory contains a definite
+ * image, that is synchronized with the orders already sent to VRDP client.
+ * The server can now process redraw requests from clients or initial
+ * fullscreen updates for new clients.
+ *
+ * @thread EMT or the VBVA flush thread of the VGA device.
+ */
+void Display::i_completeUpdateSequence()
+{
+    Assert(mParent && mParent->i_consoleVRDPServer());
+    for (unsigned uScreenId = 0; uScreenId < mcMonitors; uScreenId++)
+        mParent->i_consoleVRDPServer()->SendUpdate(uScreenId, NULL, 0);
+}
+
 /**
  * Periodic display refresh callback.
  *
@@ -3014,22 +3290,14 @@ DECLCALLBACK(void) Display::i_displayUpdateCallback(PPDMIDISPLAYCONNECTOR pInter
         {
             /* No VBVA do a display update. */
             DISPLAYFBINFO *pFBInfo = &pDisplay->maFramebuffers[VBOX_VIDEO_PRIMARY_SCREEN];
-            pDrv->pUpPort->pfnUpdateDisplay(pDrv->pUpPort);
+            rc = pDrv->pUpPort->pfnUpdateDisplay(pDrv->pUpPort);
         }
 
-        /* Inform the VRDP server that the current display update sequence is
-         * completed. At this moment the framebuffer memory contains a definite
-         * image, that is synchronized with the orders already sent to VRDP client.
-         * The server can now process redraw requests from clients or initial
-         * fullscreen updates for new clients.
+        /* VINF_TRY_AGAIN: the VGA device reports the VBVA updates from its
+         * flush thread, which completes the sequence in i_displayVBVAUpdateComplete.
          */
-        for (uScreenId = 0; uScreenId < pDisplay->mcMonitors; uScreenId++)
-        {
-            DISPLAYFBINFO *pFBInfo = &pDisplay->maFramebuffers[uScreenId];
-
-            Assert(pDisplay->mParent && pDisplay->mParent->i_consoleVRDPServer());
-            pDisplay->mParent->i_consoleVRDPServer()->SendUpdate(uScreenId, NULL, 0);
-        }
+        if (rc != VINF_TRY_AGAIN)
+            pDisplay->i_completeUpdateSequence();
     }
 
 #ifdef VBOX_WITH_VPX
@@ -3476,6 +3744,8 @@ void  Display::i_handleCrVRecScreenshotPerform(uint32_t uScreen,
 {
     Assert(mfCrOglVideoRecState == CRVREC_STATE_SUBMITTED);
 # if VBOX_WITH_VPX
+    /* There is no damage information for the 3D content. */
+    VideoRecMarkDirty(mpVideoRecCtx, uScreen, 0, 0, x + uGuestWidth, y + uGuestHeight);
     int rc = VideoRecCopyToIntBuf(mpVideoRecCtx, uScreen, x, y,
                                   uPixelFormat,
                                   uBitsPerPixel, uBytesPerLine,
@@ -3687,6 +3957,7 @@ DECLCALLBACK(int) Display::i_displayVBVAEnable(PPDMIDISPLAYCONNECTOR pInterface,
 
     pThis->maFramebuffers[uScreenId].fVBVAEnabled = true;
     pThis->maFramebuffers[uScreenId].pVBVAHostFlags = pHostFlags;
+    pThis->i_screenshotInvalidate(uScreenId);
     pThis->maFramebuffers[uScreenId].fRenderThreadMode = fRenderThreadMode;
     pThis->maFramebuffers[uScreenId].fVBVAForceResize = true;
 
@@ -3706,6 +3977,8 @@ DECLCALLBACK(void) Display::i_displayVBVADisable(PPDMIDISPLAYCONNECTOR pInterfac
 
     bool fRenderThreadMode = pFBInfo->fRenderThreadMode;
 
+    pThis->i_screenshotInvalidate(uScreenId);
+
     if (uScreenId == VBOX_VIDEO_PRIMARY_SCREEN)
     {
         /* Make sure that the primary screen is visible now.
@@ -3852,6 +4125,14 @@ DECLCALLBACK(void) Display::i_displayVBVAUpdateEnd(PPDMIDISPLAYCONNECTOR pInterf
     pThis->i_handleDisplayUpdate(uScreenId, x - pFBInfo->xOrigin, y - pFBInfo->yOrigin, cx, cy);
 }
 
+DECLCALLBACK(void) Display::i_displayVBVAUpdateComplete(PPDMIDISPLAYCONNECTOR pInterface)
+{
+    LogFlowFunc(("\n"));
+
+    PDRVMAINDISPLAY pDrv = PDMIDISPLAYCONNECTOR_2_MAINDISPLAY(pInterface);
+    pDrv->pDisplay->i_completeUpdateSequence();
+}
+
 #ifdef DEBUG_sunlover
 static void logVBVAResize(const PVBVAINFOVIEW pView, const PVBVAINFOSCREEN pScreen, const DISPLAYFBINFO *pFBInfo)
 {
@@ -4127,6 +4408,16 @@ DECLCALLBACK(void) Display::i_drvDestruct(PPDMDRVINS pDrvIns)
         AutoWriteLock displayLock(pThis->pDisplay COMMA_LOCKVAL_SRC_POS);
 #ifdef VBOX_WITH_VPX
         pThis->pDisplay->i_VideoCaptureStop();
+        for (unsigned uScreen = 0; uScreen < pThis->pDisplay->mcMonitors; uScreen++)
+        {
+            PVIDEORECSTATS pStats = &pThis->pDisplay->maVideoRecStats[uScreen];
+            PDMDrvHlpSTAMDeregister(pDrvIns, &pStats->StatFramesEncoded);
+            PDMDrvHlpSTAMDeregister(pDrvIns, &pStats->StatFramesDropped);
+            PDMDrvHlpSTAMDeregister(pDrvIns, &pStats->StatFramesUnchanged);
+            PDMDrvHlpSTAMDeregister(pDrvIns, &pStats->StatConvert);
+            PDMDrvHlpSTAMDeregister(pDrvIns, &pStats->StatEncode);
+            PDMDrvHlpSTAMDeregister(pDrvIns, &pStats->StatLatency);
+        }
 #endif
 #ifdef VBOX_WITH_CRHGSMI
         pThis->pDisplay->i_destructCrHgsmiData();
@@ -4189,6 +4480,7 @@ DECLCALLBACK(int) Display::i_drvConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg, ui
     pThis->IConnector.pfnVBVAMousePointerShape = Display::i_displayVBVAMousePointerShape;
     pThis->IConnector.pfnVBVAGuestCapabilityUpdate = Display::i_displayVBVAGuestCapabilityUpdate;
     pThis->IConnector.pfnVBVAInputMappingUpdate = Display::i_displayVBVAInputMappingUpdate;
+    pThis->IConnector.pfnVBVAUpdateComplete    = Display::i_displayVBVAUpdateComplete;
 #endif
 
     /*
@@ -4236,6 +4528,23 @@ DECLCALLBACK(int) Display::i_drvConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfg, ui
 #endif
 
 #ifdef VBOX_WITH_VPX
+    for (unsigned uScreen = 0; uScreen < pDisplay->mcMonitors; uScreen++)
+    {
+        PVIDEORECSTATS pStats = &pDisplay->maVideoRecStats[uScreen];
+        PDMDrvHlpSTAMRegisterF(pDrvIns, &pStats->StatFramesEncoded, STAMTYPE_COUNTER, STAMVISIBILITY_USED, STAMUNIT_OCCURENCES,
+                               "Video frames encoded and written.", "/Main/VideoRec/%u/FramesEncoded", uScreen);
+        PDMDrvHlpSTAMRegisterF(pDrvIns, &pStats->StatFramesDropped, STAMTYPE_COUNTER, STAMVISIBILITY_USED, STAMUNIT_OCCURENCES,
+                               "Video frames dropped because the encoder was busy.", "/Main/VideoRec/%u/FramesDropped", uScreen);
+        PDMDrvHlpSTAMRegisterF(pDrvIns, &pStats->StatFramesUnchanged, STAMTYPE_COUNTER, STAMVISIBILITY_USED, STAMUNIT_OCCURENCES,
+                               "Video frames skipped because nothing changed.", "/Main/VideoRec/%u/FramesUnchanged", uScreen);
+        PDMDrvHlpSTAMRegisterF(pDrvIns, &pStats->StatConvert, STAMTYPE_PROFILE, STAMVISIBILITY_USED, STAMUNIT_NS_PER_CALL,
+                               "RGB to YUV conversion.", "/Main/VideoRec/%u/Convert", uScreen);
+        PDMDrvHlpSTAMRegisterF(pDrvIns, &pStats->StatEncode, STAMTYPE_PROFILE, STAMVISIBILITY_USED, STAMUNIT_NS_PER_CALL,
+                               "Encoding and writing.", "/Main/VideoRec/%u/Encode", uScreen);
+        PDMDrvHlpSTAMRegisterF(pDrvIns, &pStats->StatLatency, STAMTYPE_PROFILE, STAMVISIBILITY_USED, STAMUNIT_NS_PER_CALL,
+                               "Time from capturing a frame till it has been written.", "/Main/VideoRec/%u/Latency", uScreen);
+    }
+
     ComPtr<IMachine> pMachine = pDisplay->mParent->i_machine();
     BOOL fEnabled = false;
     HRESULT hrc = pMachine->COMGETTER(VideoCaptureEnabled)(&fEnabled);
@@ -167,6 +167,17 @@ class HGCMService
 
         uint32_t SizeOfClient(void) { return m_fntable.cbClient; };
 
+        /** Whether calls to @a u32Function get VBOX_HGCM_SVC_PARM_PAGES
+         *  parameters as they are instead of bounced copies. */
+        bool TakesPageLists(uint32_t u32Function)
+        {
+            uint64_t const bmPageLists = m_fntable.bmPageListFunctions;
+            return    (m_fntable.fFlags & VBOX_HGCM_SVC_F_PAGE_LISTS)
+                   && (   !bmPageLists
+                       || (   u32Function < 64
+                           && (bmPageLists & RT_BIT_64(u32Function))));
+        };
+
         int RegisterExtension(HGCMSVCEXTHANDLE handle, PFNHGCMSVCEXT pfnExtension, void *pvExtension);
         void UnregisterExtension(HGCMSVCEXTHANDLE handle);
 
@@ -413,9 +424,32 @@ class HGCMMsgHeader: public HGCMMsgCore
 };
 
 
+/* A page list parameter replaced by a heap copy, see hgcmCallBouncePages. */
+typedef struct HGCMBOUNCEDPAGES
+{
+    /* The original page list, NULL if the parameter was not replaced. */
+    PVBOXHGCMSVCPARMPAGES pPages;
+    /* The heap copy. */
+    void *pvBounce;
+} HGCMBOUNCEDPAGES;
+
 class HGCMMsgCall: public HGCMMsgHeader
 {
     public:
+        HGCMMsgCall() : paBounced(NULL) {};
+
+        /* Frees the heap copies of calls which were never completed. This does
+         * not touch paParms, which belongs to the VMMDev command and may be gone. */
+        ~HGCMMsgCall()
+        {
+            if (paBounced)
+            {
+                for (uint32_t i = 0; i < cParms; i++)
+                    RTMemFree(paBounced[i].pvBounce);
+                RTMemFree(paBounced);
+            }
+        };
+
         /* client identifier */
         uint32_t u32ClientId;
 
@@ -426,6 +460,11 @@ class HGCMMsgCall: public HGCMMsgHeader
         uint32_t cParms;
 
         VBOXHGCMSVCPARM *paParms;
+
+        /* Page list parameters which were replaced by heap copies because the
+         * service does not handle VBOX_HGCM_SVC_PARM_PAGES, indexed by parameter.
+         * NULL if there are none. */
+        HGCMBOUNCEDPAGES *paBounced;
 };
 
 class HGCMMsgLoadSaveStateClient: public HGCMMsgCore
@@ -503,6 +542,76 @@ static HGCMMsgCore *hgcmMessageAllocSvc(uint32_t u32MsgId)
     return NULL;
 }
 
+/*
+ * Replaces the page list parameters of a guest call by heap copies, for services
+ * which do not handle VBOX_HGCM_SVC_PARM_PAGES themselves.
+ */
+static int hgcmCallBouncePages(HGCMMsgCall *pMsg)
+{
+    uint32_t i;
+    for (i = 0; i < pMsg->cParms; i++)
+    {
+        VBOXHGCMSVCPARM *pParm = &pMsg->paParms[i];
+        if (pParm->type != VBOX_HGCM_SVC_PARM_PAGES)
+            continue;
+
+        if (!pMsg->paBounced)
+        {
+            pMsg->paBounced = (HGCMBOUNCEDPAGES *)RTMemAllocZ(pMsg->cParms * sizeof(pMsg->paBounced[0]));
+            if (!pMsg->paBounced)
+                return VERR_NO_MEMORY;
+        }
+
+        PVBOXHGCMSVCPARMPAGES pPages = pParm->u.pages.pPages;
+        uint32_t const cb = pParm->u.pages.size;
+        void *pv = RTMemAlloc(RT_MAX(cb, 1));
+        if (!pv)
+            return VERR_NO_MEMORY;
+        if (pPages->fFlags & VBOX_HGCM_F_PARM_DIRECTION_TO_HOST)
+            VBoxHGCMSvcPagesRead(pPages, 0, pv, cb);
+        else
+            RT_BZERO(pv, cb);
+
+        pMsg->paBounced[i].pPages   = pPages;
+        pMsg->paBounced[i].pvBounce = pv;
+        pParm->type           = VBOX_HGCM_SVC_PARM_PTR;
+        pParm->u.pointer.size = cb;
+        pParm->u.pointer.addr = pv;
+    }
+    return VINF_SUCCESS;
+}
+
+/*
+ * Undoes hgcmCallBouncePages, copying the data the service returned back into the guest pages.
+ */
+static void hgcmCallUnbouncePages(HGCMMsgCall *pMsg)
+{
+    if (!pMsg->paBounced)
+        return;
+
+    uint32_t i;
+    for (i = 0; i < pMsg->cParms; i++)
+    {
+        PVBOXHGCMSVCPARMPAGES pPages = pMsg->paBounced[i].pPages;
+        if (!pPages)
+            continue;
+
+        VBOXHGCMSVCPARM *pParm = &pMsg->paParms[i];
+        void *pv = pMsg->paBounced[i].pvBounce;
+        uint32_t const cb = pParm->u.pointer.size;
+        if (pPages->fFlags & VBOX_HGCM_F_PARM_DIRECTION_FROM_HOST)
+            VBoxHGCMSvcPagesWrite(pPages, 0, pv, cb);
+        RTMemFree(pv);
+
+        pParm->type           = VBOX_HGCM_SVC_PARM_PAGES;
+        pParm->u.pages.size   = cb;
+        pParm->u.pages.pPages = pPages;
+    }
+
+    RTMemFree(pMsg->paBounced);
+    pMsg->paBounced = NULL;
+}
+
 /*
  * The service thread. Loads the service library and calls the service entry points.
  */
@@ -611,9 +720,18 @@ DECLCALLBACK(void) hgcmServiceThread(HGCMTHREADHANDLE ThreadHandle, void *pvUser
 
                 if (pClient)
                 {
-                    pSvc->m_fntable.pfnCall(pSvc->m_fntable.pvService, (VBOXHGCMCALLHANDLE)pMsg, pMsg->u32ClientId,
-                                            HGCM_CLIENT_DATA(pSvc, pClient), pMsg->u32Function,
-                                            pMsg->cParms, pMsg->paParms);
+                    if (!pSvc->TakesPageLists(pMsg->u32Function))
+                        rc = hgcmCallBouncePages(pMsg);
+
+                    if (RT_SUCCESS(rc))
+                        pSvc->m_fntable.pfnCall(pSvc->m_fntable.pvService, (VBOXHGCMCALLHANDLE)pMsg, pMsg->u32ClientId,
+                                                HGCM_CLIENT_DATA(pSvc, pClient), pMsg->u32Function,
+                                                pMsg->cParms, pMsg->paParms);
+                    else
+                    {
+                        hgcmCallUnbouncePages(pMsg);
+                        hgcmMsgComplete(pMsgCore, rc);
+                    }
 
                     hgcmObjDereference(pClient);
                 }
@@ -766,6 +884,7 @@ DECLCALLBACK(void) hgcmServiceThread(HGCMTHREADHANDLE ThreadHandle, void *pvUser
         * is called by the service, and the service does not get
         * any other messages.
         */
+       hgcmCallUnbouncePages((HGCMMsgCall *)pMsgCore);
        hgcmMsgComplete(pMsgCore, rc);
    }
    else
@@ -2358,6 +2477,33 @@ int HGCMGuestCall(PPDMIHGCMPORT pHGCMPort,
     return rc;
 }
 
+/* Checks whether the service of a client takes page list parameters for the
+ * given function, so the caller only maps the guest pages when they are not
+ * bounced anyway.
+ *
+ * @param u32ClientId    The client handle.
+ * @param u32Function    The function number.
+ * @return true if page lists are passed to the service as they are.
+ */
+bool HGCMGuestIsPageListCall(uint32_t u32ClientId,
+                             uint32_t u32Function)
+{
+    bool fPageLists = false;
+
+    HGCMClient *pClient = (HGCMClient *)hgcmObjReference(u32ClientId, HGCMOBJ_CLIENT);
+
+    if (pClient)
+    {
+        AssertRelease(pClient->pService);
+
+        fPageLists = pClient->pService->TakesPageLists(u32Function);
+
+        hgcmObjDereference(pClient);
+    }
+
+    return fPageLists;
+}
+
 /* The host calls the service.
  *
  * @param pszServiceName The service name to be called.
@@ -21,6 +21,8 @@
 #include "HGCMThread.h"
 
 #include <VBox/err.h>
+#include <iprt/critsect.h>
+#include <iprt/mem.h>
 #include <iprt/semaphore.h>
 #include <iprt/thread.h>
 #include <iprt/string.h>
@@ -65,6 +67,29 @@
 
 /** @todo consider use of RTReq */
 
+/* Messages are recycled through free lists of HGCMMSG_POOL_GRANULARITY sized
+ * classes, so that the alloc/free pair of every guest call does not hit the
+ * heap. Larger messages are not pooled. */
+#define HGCMMSG_POOL_GRANULARITY       (64)
+#define HGCMMSG_POOL_CLASSES           (8)
+/* How many free messages are kept per class. */
+#define HGCMMSG_POOL_MAX_FREE          (64)
+
+typedef struct HGCMMSGPOOLFREE
+{
+    struct HGCMMSGPOOLFREE *pNext;
+} HGCMMSGPOOLFREE;
+
+static struct
+{
+    /* Serializes access to the free lists. */
+    RTCRITSECT critsect;
+    /* Whether the pool is usable, i.e. between hgcmThreadInit and hgcmThreadUninit. */
+    bool volatile fInitialized;
+    HGCMMSGPOOLFREE *apFree[HGCMMSG_POOL_CLASSES];
+    uint32_t acFree[HGCMMSG_POOL_CLASSES];
+} g_MsgPool;
+
 static DECLCALLBACK(int) hgcmWorkerThreadFunc (RTTHREAD ThreadSelf, void *pvUser);
 
 class HGCMThread: public HGCMObject
@@ -172,6 +197,82 @@ void HGCMMsgCore::InitializeCore (uint32_t u32MsgId, HGCMTHREADHANDLE hThread)
     }
 }
 
+/*
+ * Message memory pool.
+ */
+
+static void *hgcmMsgPoolAlloc (size_t cb)
+{
+    size_t iClass = (cb + HGCMMSG_POOL_GRANULARITY - 1) / HGCMMSG_POOL_GRANULARITY;
+    if (   iClass == 0
+        || iClass > HGCMMSG_POOL_CLASSES
+        || !g_MsgPool.fInitialized)
+    {
+        return RTMemAlloc (cb);
+    }
+    iClass--;
+
+    HGCMMSGPOOLFREE *pFree = NULL;
+    if (RT_SUCCESS(RTCritSectEnter (&g_MsgPool.critsect)))
+    {
+        pFree = g_MsgPool.apFree[iClass];
+        if (pFree)
+        {
+            g_MsgPool.apFree[iClass] = pFree->pNext;
+            g_MsgPool.acFree[iClass]--;
+        }
+        RTCritSectLeave (&g_MsgPool.critsect);
+    }
+
+    if (pFree)
+    {
+        return pFree;
+    }
+
+    /* Always allocate the full class size, the block is reused by any message of the class. */
+    return RTMemAlloc ((iClass + 1) * HGCMMSG_POOL_GRANULARITY);
+}
+
+static void hgcmMsgPoolFree (void *pv, size_t cb)
+{
+    if (!pv)
+    {
+        return;
+    }
+
+    size_t iClass = (cb + HGCMMSG_POOL_GRANULARITY - 1) / HGCMMSG_POOL_GRANULARITY;
+    if (   iClass != 0
+        && iClass <= HGCMMSG_POOL_CLASSES
+        && g_MsgPool.fInitialized
+        && RT_SUCCESS(RTCritSectEnter (&g_MsgPool.critsect)))
+    {
+        iClass--;
+        if (   g_MsgPool.fInitialized
+            && g_MsgPool.acFree[iClass] < HGCMMSG_POOL_MAX_FREE)
+        {
+            HGCMMSGPOOLFREE *pFree = (HGCMMSGPOOLFREE *)pv;
+            pFree->pNext = g_MsgPool.apFree[iClass];
+            g_MsgPool.apFree[iClass] = pFree;
+            g_MsgPool.acFree[iClass]++;
+            pv = NULL;
+        }
+        RTCritSectLeave (&g_MsgPool.critsect);
+    }
+
+    /* Also blocks allocated before the pool was initialized or of an unpooled size. */
+    RTMemFree (pv);
+}
+
+void *HGCMMsgCore::operator new (size_t cb) throw()
+{
+    return hgcmMsgPoolAlloc (cb);
+}
+
+void HGCMMsgCore::operator delete (void *pv, size_t cb)
+{
+    hgcmMsgPoolFree (pv, cb);
+}
+
 /*
  * HGCMThread implementation.
  */
@@ -395,6 +496,8 @@ int HGCMThread::MsgPost (HGCMMsgCore *pMsg, PHGCMMSGCALLBACK pfnCallback, bool f
 
     LogFlow(("HGCMThread::MsgPost: thread = %p, pMsg = %p, pfnCallback = %p\n", this, pMsg, pfnCallback));
 
+    bool fWasEmpty = false;
+
     rc = Enter ();
 
     if (RT_SUCCESS(rc))
@@ -410,6 +513,8 @@ int HGCMThread::MsgPost (HGCMMsgCore *pMsg, PHGCMMSGCALLBACK pfnCallback, bool f
         pMsg->m_pNext = NULL;
         pMsg->m_pPrev = m_pMsgInputQueueTail;
 
+        fWasEmpty = m_pMsgInputQueueTail == NULL;
+
         if (m_pMsgInputQueueTail)
         {
             m_pMsgInputQueueTail->m_pNext = pMsg;
@@ -425,8 +530,14 @@ int HGCMThread::MsgPost (HGCMMsgCore *pMsg, PHGCMMSGCALLBACK pfnCallback, bool f
 
         LogFlow(("HGCMThread::MsgPost: going to inform the thread %p about message, fWait = %d\n", this, fWait));
 
-        /* Inform the worker thread that there is a message. */
-        RTSemEventMultiSignal (m_eventThread);
+        /* Inform the worker thread that there is a message. The thread only
+         * waits after finding the queue empty and re-checks it after each wakeup,
+         * so it is enough to signal when the queue was empty.
+         */
+        if (fWasEmpty)
+        {
+            RTSemEventMultiSignal (m_eventThread);
+        }
 
         LogFlow(("HGCMThread::MsgPost: event signalled\n"));
 
@@ -834,6 +945,15 @@ int hgcmThreadInit (void)
 
     rc = hgcmObjInit ();
 
+    if (RT_SUCCESS(rc))
+    {
+        rc = RTCritSectInit (&g_MsgPool.critsect);
+        if (RT_SUCCESS(rc))
+        {
+            ASMAtomicWriteBool (&g_MsgPool.fInitialized, true);
+        }
+    }
+
     LogFlow(("MAIN::hgcmThreadInit: rc = %Rrc\n", rc));
 
     return rc;
@@ -841,5 +961,26 @@ int hgcmThreadInit (void)
 
 void hgcmThreadUninit (void)
 {
+    if (g_MsgPool.fInitialized)
+    {
+        RTCritSectEnter (&g_MsgPool.critsect);
+        ASMAtomicWriteBool (&g_MsgPool.fInitialized, false);
+
+        unsigned i;
+        for (i = 0; i < HGCMMSG_POOL_CLASSES; i++)
+        {
+            while (g_MsgPool.apFree[i])
+            {
+                HGCMMSGPOOLFREE *pFree = g_MsgPool.apFree[i];
+                g_MsgPool.apFree[i] = pFree->pNext;
+                RTMemFree (pFree);
+            }
+            g_MsgPool.acFree[i] = 0;
+        }
+
+        RTCritSectLeave (&g_MsgPool.critsect);
+        RTCritSectDelete (&g_MsgPool.critsect);
+    }
+
     hgcmObjUninit ();
 }
@@ -114,6 +114,12 @@ void MachineDebugger::uninit()
 
     unconst(mParent) = NULL;
     mFlushMode = false;
+
+    for (StatsBaselineMap::iterator it = mStatsBaselines.begin();
+         it != mStatsBaselines.end();
+         ++it)
+        STAMR3SnapshotBinBaselineDestroy(it->second);
+    mStatsBaselines.clear();
 }
 
 // IMachineDebugger properties
@@ -779,19 +785,22 @@ HRESULT MachineDebugger::getVM(LONG64 *aVM)
 
 HRESULT MachineDebugger::dumpGuestCore(const com::Utf8Str &aFilename, const com::Utf8Str &aCompression)
 {
-    if (aCompression.length())
-        return setError(E_INVALIDARG, tr("The compression parameter must be empty"));
+    uint32_t fFlags = DBGFCORE_F_SKIP_ZERO_PAGES;
+    if (aCompression.equals("gzip"))
+        fFlags |= DBGFCORE_F_GZIP;
+    else if (aCompression.length())
+        return setError(E_INVALIDARG, tr("The compression parameter must be empty or \"gzip\""));
 
     AutoWriteLock alock(this COMMA_LOCKVAL_SRC_POS);
     Console::SafeVMPtr ptrVM(mParent);
     HRESULT hrc = ptrVM.rc();
     if (SUCCEEDED(hrc))
     {
-        int vrc = DBGFR3CoreWrite(ptrVM.rawUVM(), aFilename.c_str(), false /*fReplaceFile*/);
+        int vrc = DBGFR3CoreWriteEx(ptrVM.rawUVM(), aFilename.c_str(), fFlags);
         if (RT_SUCCESS(vrc))
             hrc = S_OK;
         else
-            hrc = setError(E_FAIL, tr("DBGFR3CoreWrite failed with %Rrc"), vrc);
+            hrc = setError(E_FAIL, tr("DBGFR3CoreWriteEx failed with %Rrc"), vrc);
     }
 
     return hrc;
@@ -1419,6 +1428,62 @@ HRESULT MachineDebugger::getStats(const com::Utf8Str &aPattern, BOOL aWithDescri
     return S_OK;
 }
 
+/**
+ * Get the VM statistics in the binary snapshot format.
+ *
+ * @returns COM status code.
+ * @param   aPattern            The selection pattern. A bit similar to filename globbing.
+ * @param   aConsumer           The consumer name.  If not empty, only include samples which
+ *                              changed since this consumer's last call.
+ * @param   aWithNames          Whether to include the sample names.
+ * @param   aStats              Where to return the snapshot (STAMBINSNAPSHOTHDR).
+ */
+HRESULT MachineDebugger::getStatsBinary(const com::Utf8Str &aPattern, const com::Utf8Str &aConsumer, BOOL aWithNames,
+                                        std::vector<BYTE> &aStats)
+{
+    Console::SafeVMPtrQuiet ptrVM(mParent);
+
+    if (!ptrVM.isOk())
+        return setError(VBOX_E_INVALID_VM_STATE, "Machine is not running");
+
+    uint32_t fFlags = 0;
+    if (aWithNames)
+        fFlags |= STAM_SNAPSHOT_BIN_F_NAMES;
+
+    /* The write lock serializes the use of the consumer baselines. */
+    AutoWriteLock alock(this COMMA_LOCKVAL_SRC_POS);
+
+    PSTAMSNAPSHOTBINBASELINE hBaseline = NULL;
+    int vrc = VINF_SUCCESS;
+    if (aConsumer.isNotEmpty())
+    {
+        StatsBaselineMap::const_iterator it = mStatsBaselines.find(aConsumer);
+        if (it != mStatsBaselines.end())
+            hBaseline = it->second;
+        else if (mStatsBaselines.size() >= 64)
+            return setError(E_INVALIDARG, tr("Too many statistics consumers"));
+        else
+        {
+            vrc = STAMR3SnapshotBinBaselineCreate(&hBaseline);
+            if (RT_SUCCESS(vrc))
+                mStatsBaselines[aConsumer] = hBaseline;
+        }
+        fFlags |= STAM_SNAPSHOT_BIN_F_DELTA;
+    }
+
+    void  *pvSnapshot;
+    size_t cbSnapshot;
+    if (RT_SUCCESS(vrc))
+        vrc = STAMR3SnapshotBin(ptrVM.rawUVM(), aPattern.c_str(), fFlags, hBaseline, &pvSnapshot, &cbSnapshot);
+    if (RT_FAILURE(vrc))
+        return setError(vrc == VERR_NO_MEMORY ? E_OUTOFMEMORY : E_FAIL, tr("STAMR3SnapshotBin failed with %Rrc"), vrc);
+
+    aStats.assign((BYTE *)pvSnapshot, (BYTE *)pvSnapshot + cbSnapshot);
+    STAMR3SnapshotBinFree(ptrVM.rawUVM(), pvSnapshot);
+
+    return S_OK;
+}
+
 
 // public methods only for internal purposes
 /////////////////////////////////////////////////////////////////////////////
@@ -647,6 +647,18 @@ static DECLCALLBACK(int) iface_hgcmCall(PPDMIHGCMCONNECTOR pInterface, PVBOXHGCM
     return HGCMGuestCall(pDrv->pHGCMPort, pCmd, u32ClientID, u32Function, cParms, paParms);
 }
 
+static DECLCALLBACK(bool) iface_hgcmIsPageListCall(PPDMIHGCMCONNECTOR pInterface, uint32_t u32ClientID, uint32_t u32Function)
+{
+    Log9(("Enter\n"));
+
+    PDRVMAINVMMDEV pDrv = RT_FROM_MEMBER(pInterface, DRVMAINVMMDEV, HGCMConnector);
+
+    if (!pDrv->pVMMDev || !pDrv->pVMMDev->hgcmIsActive())
+        return false;
+
+    return HGCMGuestIsPageListCall(u32ClientID, u32Function);
+}
+
 /**
  * Execute state save operation.
  *
@@ -819,6 +831,7 @@ DECLCALLBACK(int) VMMDev::drvConstruct(PPDMDRVINS pDrvIns, PCFGMNODE pCfgHandle,
     pThis->HGCMConnector.pfnConnect                   = iface_hgcmConnect;
     pThis->HGCMConnector.pfnDisconnect                = iface_hgcmDisconnect;
     pThis->HGCMConnector.pfnCall                      = iface_hgcmCall;
+    pThis->HGCMConnector.pfnIsPageListCall            = iface_hgcmIsPageListCall;
 #endif
 
     /*
@@ -19,6 +19,8 @@
 #include <VBox/log.h>
 #include <iprt/asm.h>
 #include <iprt/assert.h>
+#include <iprt/critsect.h>
+#include <iprt/mp.h>
 #include <iprt/semaphore.h>
 #include <iprt/thread.h>
 #include <iprt/time.h>
@@ -34,10 +36,23 @@
 #include <vpx/vp8cx.h>
 #include <vpx/vpx_image.h>
 
+#if defined(RT_ARCH_AMD64)
+/* SSE2 is part of the AMD64 baseline, no need to check the host CPU. */
+# include <emmintrin.h>
+# define VIDEOREC_WITH_SSE2
+#endif
+
 /** Default VPX codec to use */
 #define DEFAULTCODEC (vpx_codec_vp8_cx())
 
-static int videoRecEncodeAndWrite(PVIDEORECSTREAM pStrm);
+/** The maximum number of encoder threads per screen. */
+#define VIDEOREC_MAX_ENCODER_THREADS    8
+
+/** Convert the whole frame at least this often (ms), regardless of what
+ * Display told us about changes.  Keeps lost updates from sticking around. */
+#define VIDEOREC_FULL_REFRESH_MS        1000
+
+static int videoRecEncodeAndWrite(PVIDEORECSTREAM pStrm, uint64_t u64TimeStamp);
 static int videoRecRGBToYUV(PVIDEORECSTREAM pStrm);
 
 /* state to synchronized between threads */
@@ -55,6 +70,9 @@ enum
 /* Must be always accessible and therefore cannot be part of VIDEORECCONTEXT */
 static uint32_t g_enmState = VIDREC_UNINITIALIZED;
 
+/* number of VideoRecMarkDirty() calls in progress, delay termination */
+static uint32_t volatile g_cDirtyMarkers = 0;
+
 
 typedef struct VIDEORECSTREAM
 {
@@ -94,18 +112,39 @@ typedef struct VIDEORECSTREAM
     uint64_t            u64TimeStamp;
     /* encoder deadline */
     unsigned int        uEncoderDeadline;
+    /* semaphore to signal the encoder thread */
+    RTSEMEVENT          WaitEvent;
+    /* encoder thread of this stream */
+    RTTHREAD            Thread;
+    /* protects the damage rectangle */
+    RTCRITSECT          CritSectDirty;
+    /* true if the damage rectangle is valid */
+    bool                fDirty;
+    /* damage since the last frame in source coordinates, the max values are exclusive */
+    uint32_t            xDirtyMin;
+    uint32_t            yDirtyMin;
+    uint32_t            xDirtyMax;
+    uint32_t            yDirtyMax;
+    /* time stamp of the last frame copied in full */
+    uint64_t            u64LastFullTimeStamp;
+    /* the part of the RGB buffer the encoder thread has to convert, target
+     * coordinates aligned on 2 pixels */
+    uint32_t            xConv;
+    uint32_t            yConv;
+    uint32_t            cxConv;
+    uint32_t            cyConv;
+    /* RTTimeNanoTS() when the current frame was captured */
+    uint64_t            u64CaptureNanoTS;
+    /* statistics, owned by the caller */
+    PVIDEORECSTATS      pStats;
 } VIDEORECSTREAM;
 
 typedef struct VIDEORECCONTEXT
 {
-    /* semaphore to signal the encoding worker thread */
-    RTSEMEVENT          WaitEvent;
     /* semaphore required during termination */
     RTSEMEVENT          TermEvent;
     /* true if video recording is enabled */
     bool                fEnabled;
-    /* worker thread */
-    RTTHREAD            Thread;
     /* number of stream contexts */
     uint32_t            cScreens;
     /* maximal time stamp */
@@ -280,31 +319,39 @@ private:
 };
 
 /**
- * Convert an image to YUV420p format
+ * Convert (a part of) an image to YUV420p format
  * @returns true on success, false on failure
  * @param aWidth    width of image
  * @param aHeight   height of image
  * @param aDestBuf  an allocated memory buffer large enough to hold the
  *                  destination image (i.e. width * height * 12bits)
  * @param aSrcBuf   the source image as an array of bytes
+ * @param aX        left edge of the part to convert, must be even
+ * @param aY        top edge of the part to convert, must be even
+ * @param aCX       width of the part to convert, must be even
+ * @param aCY       height of the part to convert, must be even
  */
 template <class T>
 inline bool colorConvWriteYUV420p(unsigned aWidth, unsigned aHeight,
-                                  uint8_t *aDestBuf, uint8_t *aSrcBuf)
+                                  uint8_t *aDestBuf, uint8_t *aSrcBuf,
+                                  unsigned aX, unsigned aY, unsigned aCX, unsigned aCY)
 {
     AssertReturn(0 == (aWidth & 1), false);
     AssertReturn(0 == (aHeight & 1), false);
+    AssertReturn(0 == ((aX | aY | aCX | aCY) & 1), false);
+    AssertReturn(aX + aCX <= aWidth && aY + aCY <= aHeight, false);
     bool rc = true;
     T iter1(aWidth, aHeight, aSrcBuf);
+    iter1.skip(aY * aWidth + aX);
     T iter2 = iter1;
     iter2.skip(aWidth);
     unsigned cPixels = aWidth * aHeight;
-    unsigned offY = 0;
-    unsigned offU = cPixels;
-    unsigned offV = cPixels + cPixels / 4;
-    for (unsigned i = 0; (i < aHeight / 2) && rc; ++i)
+    unsigned offY = aY * aWidth + aX;
+    unsigned offU = cPixels + aY / 2 * (aWidth / 2) + aX / 2;
+    unsigned offV = offU + cPixels / 4;
+    for (unsigned i = 0; (i < aCY / 2) && rc; ++i)
     {
-        for (unsigned j = 0; (j < aWidth / 2) && rc; ++j)
+        for (unsigned j = 0; (j < aCX / 2) && rc; ++j)
         {
             unsigned red, green, blue, u, v;
             rc = iter1.getRGB(&red, &green, &blue);
@@ -343,14 +390,131 @@ inline bool colorConvWriteYUV420p(unsigned aWidth, unsigned aHeight,
         }
         if (rc)
         {
-            iter1.skip(aWidth);
-            iter2.skip(aWidth);
-            offY += aWidth;
+            iter1.skip(2 * aWidth - aCX);
+            iter2.skip(2 * aWidth - aCX);
+            offY += 2 * aWidth - aCX;
+            offU += (aWidth - aCX) / 2;
+            offV += (aWidth - aCX) / 2;
         }
     }
     return rc;
 }
 
+#ifdef VIDEOREC_WITH_SSE2
+/**
+ * Multiplies four BGRA32 pixels with the given weights and returns the four
+ * sums as 32-bit integers.
+ * @param aPixels   four BGRA32 pixels
+ * @param aWeights  the blue, green, red and alpha weights as 16-bit integers,
+ *                  twice
+ */
+static inline __m128i colorConvSse2Dot4(__m128i aPixels, __m128i aWeights)
+{
+    const __m128i zero = _mm_setzero_si128();
+    /* [B0*wb+G0*wg, R0*wr+A0*wa, B1*wb+G1*wg, ...] for pixels 0+1 and 2+3 */
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(aPixels, zero), aWeights);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(aPixels, zero), aWeights);
+    __m128 even = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 odd  = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1));
+    return _mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd));
+}
+
+/**
+ * Luma of four BGRA32 pixels, same formula as colorConvWriteYUV420p.
+ */
+static inline __m128i colorConvSse2Y4(__m128i aPixels)
+{
+    const __m128i weights = _mm_setr_epi16(25, 129, 66, 0, 25, 129, 66, 0);
+    __m128i y = colorConvSse2Dot4(aPixels, weights);
+    y = _mm_srai_epi32(_mm_add_epi32(y, _mm_set1_epi32(128)), 8);
+    return _mm_add_epi32(y, _mm_set1_epi32(16));
+}
+
+/**
+ * Quarter chroma contributions of four BGRA32 pixels, same formula as
+ * colorConvWriteYUV420p.
+ */
+static inline __m128i colorConvSse2Chroma4(__m128i aPixels, __m128i aWeights)
+{
+    __m128i c = colorConvSse2Dot4(aPixels, aWeights);
+    c = _mm_srai_epi32(_mm_add_epi32(c, _mm_set1_epi32(128)), 8);
+    return _mm_srai_epi32(_mm_add_epi32(c, _mm_set1_epi32(128)), 2);
+}
+
+/**
+ * Sums the chroma contributions of 2x2 pixel blocks.
+ * @returns four 32-bit chroma values
+ * @param aRow0Lo  contributions of pixels 0-3 of the upper row
+ * @param aRow0Hi  contributions of pixels 4-7 of the upper row
+ * @param aRow1Lo  contributions of pixels 0-3 of the lower row
+ * @param aRow1Hi  contributions of pixels 4-7 of the lower row
+ */
+static inline __m128i colorConvSse2Sum2x2(__m128i aRow0Lo, __m128i aRow0Hi, __m128i aRow1Lo, __m128i aRow1Hi)
+{
+    __m128 lo = _mm_castsi128_ps(_mm_add_epi32(aRow0Lo, aRow1Lo));
+    __m128 hi = _mm_castsi128_ps(_mm_add_epi32(aRow0Hi, aRow1Hi));
+    return _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0))),
+                         _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1))));
+}
+
+/**
+ * SSE2 version of colorConvWriteYUV420p<ColorConvBGRA32Iter>, produces the
+ * exact same output.  Does 8x2 pixels per iteration and leaves the remaining
+ * columns to the generic code.
+ */
+static bool colorConvWriteYUV420pBGRA32Sse2(unsigned aWidth, unsigned aHeight,
+                                            uint8_t *aDestBuf, uint8_t *aSrcBuf,
+                                            unsigned aX, unsigned aY, unsigned aCX, unsigned aCY)
+{
+    AssertReturn(0 == (aWidth & 1), false);
+    AssertReturn(0 == (aHeight & 1), false);
+    AssertReturn(0 == ((aX | aY | aCX | aCY) & 1), false);
+    AssertReturn(aX + aCX <= aWidth && aY + aCY <= aHeight, false);
+
+    const __m128i weightsU = _mm_setr_epi16(112, -74, -38, 0, 112, -74, -38, 0);
+    const __m128i weightsV = _mm_setr_epi16(-18, -94, 112, 0, -18, -94, 112, 0);
+    unsigned const cPixels = aWidth * aHeight;
+    unsigned const cxSimd  = aCX & ~7U;
+    for (unsigned yRow = aY; yRow < aY + aCY; yRow += 2)
+    {
+        const uint8_t *pbSrc0 = aSrcBuf + (yRow * aWidth + aX) * 4;
+        const uint8_t *pbSrc1 = pbSrc0 + aWidth * 4;
+        uint8_t *pbY0 = aDestBuf + yRow * aWidth + aX;
+        uint8_t *pbY1 = pbY0 + aWidth;
+        uint8_t *pbU  = aDestBuf + cPixels + yRow / 2 * (aWidth / 2) + aX / 2;
+        uint8_t *pbV  = pbU + cPixels / 4;
+        for (unsigned x = 0; x < cxSimd; x += 8)
+        {
+            __m128i row0Lo = _mm_loadu_si128((const __m128i *)(pbSrc0 + x * 4));
+            __m128i row0Hi = _mm_loadu_si128((const __m128i *)(pbSrc0 + x * 4 + 16));
+            __m128i row1Lo = _mm_loadu_si128((const __m128i *)(pbSrc1 + x * 4));
+            __m128i row1Hi = _mm_loadu_si128((const __m128i *)(pbSrc1 + x * 4 + 16));
+
+            __m128i y0 = _mm_packs_epi32(colorConvSse2Y4(row0Lo), colorConvSse2Y4(row0Hi));
+            __m128i y1 = _mm_packs_epi32(colorConvSse2Y4(row1Lo), colorConvSse2Y4(row1Hi));
+            _mm_storel_epi64((__m128i *)(pbY0 + x), _mm_packus_epi16(y0, y0));
+            _mm_storel_epi64((__m128i *)(pbY1 + x), _mm_packus_epi16(y1, y1));
+
+            __m128i u = colorConvSse2Sum2x2(colorConvSse2Chroma4(row0Lo, weightsU), colorConvSse2Chroma4(row0Hi, weightsU),
+                                            colorConvSse2Chroma4(row1Lo, weightsU), colorConvSse2Chroma4(row1Hi, weightsU));
+            __m128i v = colorConvSse2Sum2x2(colorConvSse2Chroma4(row0Lo, weightsV), colorConvSse2Chroma4(row0Hi, weightsV),
+                                            colorConvSse2Chroma4(row1Lo, weightsV), colorConvSse2Chroma4(row1Hi, weightsV));
+            u = _mm_packs_epi32(u, u);
+            v = _mm_packs_epi32(v, v);
+            uint32_t u32U = _mm_cvtsi128_si32(_mm_packus_epi16(u, u));
+            uint32_t u32V = _mm_cvtsi128_si32(_mm_packus_epi16(v, v));
+            memcpy(pbU + x / 2, &u32U, sizeof(u32U));
+            memcpy(pbV + x / 2, &u32V, sizeof(u32V));
+        }
+    }
+
+    if (cxSimd < aCX)
+        return colorConvWriteYUV420p<ColorConvBGRA32Iter>(aWidth, aHeight, aDestBuf, aSrcBuf,
+                                                          aX + cxSimd, aY, aCX - cxSimd, aCY);
+    return true;
+}
+#endif /* VIDEOREC_WITH_SSE2 */
+
 /**
  * Convert an image to RGB24 format
  * @returns true on success, false on failure
@@ -385,38 +549,45 @@ inline bool colorConvWriteRGB24(unsigned aWidth, unsigned aHeight,
 }
 
 /**
- * Worker thread for all streams.
+ * Worker thread for one stream.
  *
  * RGB/YUV conversion and encoding.
  */
 static DECLCALLBACK(int) videoRecThread(RTTHREAD Thread, void *pvUser)
 {
-    PVIDEORECCONTEXT pCtx = (PVIDEORECCONTEXT)pvUser;
+    PVIDEORECSTREAM pStrm = (PVIDEORECSTREAM)pvUser;
     for (;;)
     {
-        int rc = RTSemEventWait(pCtx->WaitEvent, RT_INDEFINITE_WAIT);
+        int rc = RTSemEventWait(pStrm->WaitEvent, RT_INDEFINITE_WAIT);
         AssertRCBreak(rc);
 
         if (ASMAtomicReadU32(&g_enmState) == VIDREC_TERMINATING)
             break;
-        for (unsigned uScreen = 0; uScreen < pCtx->cScreens; uScreen++)
+        if (ASMAtomicReadBool(&pStrm->fRgbFilled))
         {
-            PVIDEORECSTREAM pStrm = &pCtx->Strm[uScreen];
-            if (   pStrm->fEnabled
-                && ASMAtomicReadBool(&pStrm->fRgbFilled))
+            /* The next frame may be copied in as soon as the RGB buffer
+             * has been converted, so take what we need before. */
+            uint64_t const u64TimeStamp     = pStrm->u64TimeStamp;
+            uint64_t const u64CaptureNanoTS = pStrm->u64CaptureNanoTS;
+            uint64_t const u64StartNanoTS   = RTTimeNanoTS();
+            rc = videoRecRGBToYUV(pStrm);
+            ASMAtomicWriteBool(&pStrm->fRgbFilled, false);
+            uint64_t const u64ConvNanoTS    = RTTimeNanoTS();
+            STAM_REL_PROFILE_ADD_PERIOD(&pStrm->pStats->StatConvert, u64ConvNanoTS - u64StartNanoTS);
+            if (RT_SUCCESS(rc))
             {
-                rc = videoRecRGBToYUV(pStrm);
-                ASMAtomicWriteBool(&pStrm->fRgbFilled, false);
-                if (RT_SUCCESS(rc))
-                    rc = videoRecEncodeAndWrite(pStrm);
-                if (RT_FAILURE(rc))
+                rc = videoRecEncodeAndWrite(pStrm, u64TimeStamp);
+                uint64_t const u64DoneNanoTS = RTTimeNanoTS();
+                STAM_REL_PROFILE_ADD_PERIOD(&pStrm->pStats->StatEncode, u64DoneNanoTS - u64ConvNanoTS);
+                STAM_REL_PROFILE_ADD_PERIOD(&pStrm->pStats->StatLatency, u64DoneNanoTS - u64CaptureNanoTS);
+            }
+            if (RT_FAILURE(rc))
+            {
+                static unsigned cErrors = 100;
+                if (cErrors > 0)
                 {
-                    static unsigned cErrors = 100;
-                    if (cErrors > 0)
-                    {
-                        LogRel(("Error %Rrc encoding / writing video frame\n", rc));
-                        cErrors--;
-                    }
+                    LogRel(("Error %Rrc encoding / writing video frame\n", rc));
+                    cErrors--;
                 }
             }
         }
@@ -447,16 +618,14 @@ int VideoRecContextCreate(PVIDEORECCONTEXT *ppCtx, uint32_t cScreens)
          * it is required to call placement new for correct initialization
          * of the object. */
         new (&pCtx->Strm[uScreen] + RT_OFFSETOF(VIDEORECSTREAM, Ebml)) WebMWriter();
-    }
 
-    int rc = RTSemEventCreate(&pCtx->WaitEvent);
-    AssertRCReturn(rc, rc);
-
-    rc = RTSemEventCreate(&pCtx->TermEvent);
-    AssertRCReturn(rc, rc);
+        pCtx->Strm[uScreen].WaitEvent = NIL_RTSEMEVENT;
+        pCtx->Strm[uScreen].Thread    = NIL_RTTHREAD;
+        int rc = RTCritSectInit(&pCtx->Strm[uScreen].CritSectDirty);
+        AssertRCReturn(rc, rc);
+    }
 
-    rc = RTThreadCreate(&pCtx->Thread, videoRecThread, (void*)pCtx, 0,
-                        RTTHREADTYPE_MAIN_WORKER, RTTHREADFLAGS_WAITABLE, "VideoRec");
+    int rc = RTSemEventCreate(&pCtx->TermEvent);
     AssertRCReturn(rc, rc);
 
     ASMAtomicWriteU32(&g_enmState, VIDREC_IDLE);
@@ -472,13 +641,16 @@ int VideoRecContextCreate(PVIDEORECCONTEXT *ppCtx, uint32_t cScreens)
  * @param   strFile             File to save the recorded data
  * @param   uTargetWidth        Width of the target image in the video recoriding file (movie)
  * @param   uTargetHeight       Height of the target image in video recording file.
+ * @param   pStats              The statistics to update for this screen.
  */
 int VideoRecStrmInit(PVIDEORECCONTEXT pCtx, uint32_t uScreen, const char *pszFile,
                      uint32_t uWidth, uint32_t uHeight, uint32_t uRate, uint32_t uFps,
-                     uint32_t uMaxTime, uint32_t uMaxFileSize, const char *pszOptions)
+                     uint32_t uMaxTime, uint32_t uMaxFileSize, const char *pszOptions,
+                     PVIDEORECSTATS pStats)
 {
     AssertPtrReturn(pCtx, VERR_INVALID_PARAMETER);
     AssertReturn(uScreen < pCtx->cScreens, VERR_INVALID_PARAMETER);
+    AssertPtrReturn(pStats, VERR_INVALID_PARAMETER);
 
     pCtx->u64MaxTimeStamp = (uMaxTime > 0 ? RTTimeProgramMilliTS() + uMaxTime * 1000 : 0);
     pCtx->uMaxFileSize = uMaxFileSize;
@@ -489,6 +661,12 @@ int VideoRecStrmInit(PVIDEORECCONTEXT pCtx, uint32_t uScreen, const char *pszFil
     pStrm->pu8RgbBuf = (uint8_t *)RTMemAllocZ(uWidth * uHeight * 4);
     AssertReturn(pStrm->pu8RgbBuf, VERR_NO_MEMORY);
     pStrm->uEncoderDeadline = VPX_DL_REALTIME;
+    pStrm->pStats = pStats;
+
+    /* Split the host CPUs between the screens, VP8 needs token partitions
+     * to make use of more than one thread. */
+    uint32_t cThreads = RTMpGetOnlineCount() / pCtx->cScreens;
+    cThreads = RT_MAX(RT_MIN(cThreads, VIDEOREC_MAX_ENCODER_THREADS), 1);
 
     /* Play safe: the file must not exist, overwriting is potentially
      * hazardous as nothing prevents the user from picking a file name of some
@@ -536,6 +714,10 @@ int VideoRecStrmInit(PVIDEORECCONTEXT pCtx, uint32_t uScreen, const char *pszFil
                 pStrm->uEncoderDeadline = value.toUInt32();
             }
         }
+        else if (key == "threads")
+        {
+            cThreads = RT_MAX(RT_MIN(value.toUInt32(), VIDEOREC_MAX_ENCODER_THREADS), 1);
+        }
         else LogRel(("Getting unknown option: %s=%s\n", key.c_str(), value.c_str()));
 
     } while(pos != com::Utf8Str::npos);
@@ -549,8 +731,8 @@ int VideoRecStrmInit(PVIDEORECCONTEXT pCtx, uint32_t uScreen, const char *pszFil
     /* 1ms per frame */
     pStrm->VpxConfig.g_timebase.num = 1;
     pStrm->VpxConfig.g_timebase.den = 1000;
-    /* disable multithreading */
-    pStrm->VpxConfig.g_threads = 0;
+    /* multithreading, see the token partitions below */
+    pStrm->VpxConfig.g_threads = cThreads > 1 ? cThreads : 0;
 
     pStrm->uDelay = 1000 / uFps;
 
@@ -567,6 +749,15 @@ int VideoRecStrmInit(PVIDEORECCONTEXT pCtx, uint32_t uScreen, const char *pszFil
         return VERR_INVALID_PARAMETER;
     }
 
+    if (cThreads > 1)
+    {
+        int iPartitions = cThreads > 4 ? VP8_EIGHT_TOKENPARTITION
+                        : cThreads > 2 ? VP8_FOUR_TOKENPARTITION : VP8_TWO_TOKENPARTITION;
+        rcv = vpx_codec_control(&pStrm->VpxCodec, VP8E_SET_TOKEN_PARTITIONS, iPartitions);
+        if (rcv != VPX_CODEC_OK)
+            LogRel(("Failed to set the VP8 token partitions: %s\n", vpx_codec_err_to_string(rcv)));
+    }
+
     if (!vpx_img_alloc(&pStrm->VpxRawImage, VPX_IMG_FMT_I420, uWidth, uHeight, 1))
     {
         LogFlow(("Failed to allocate image %dx%d", uWidth, uHeight));
@@ -574,6 +765,14 @@ int VideoRecStrmInit(PVIDEORECCONTEXT pCtx, uint32_t uScreen, const char *pszFil
     }
     pStrm->pu8YuvBuf = pStrm->VpxRawImage.planes[0];
 
+    rc = RTSemEventCreate(&pStrm->WaitEvent);
+    AssertRCReturn(rc, rc);
+
+    rc = RTThreadCreateF(&pStrm->Thread, videoRecThread, pStrm, 0,
+                         RTTHREADTYPE_MAIN_WORKER, RTTHREADFLAGS_WAITABLE, "VideoRec%u", uScreen);
+    AssertRCReturn(rc, rc);
+
+    LogRel(("VideoRec: Screen #%u uses %u encoder thread(s)\n", uScreen, cThreads));
     pCtx->fEnabled = true;
     pStrm->fEnabled = true;
     return VINF_SUCCESS;
@@ -602,10 +801,20 @@ void VideoRecContextClose(PVIDEORECCONTEXT pCtx)
         int rc = RTSemEventWait(pCtx->TermEvent, RT_INDEFINITE_WAIT);
         AssertRC(rc);
     }
+    while (ASMAtomicReadU32(&g_cDirtyMarkers) > 0)
+        RTThreadYield();
 
-    RTSemEventSignal(pCtx->WaitEvent);
-    RTThreadWait(pCtx->Thread, 10000, NULL);
-    RTSemEventDestroy(pCtx->WaitEvent);
+    for (unsigned uScreen = 0; uScreen < pCtx->cScreens; uScreen++)
+    {
+        PVIDEORECSTREAM pStrm = &pCtx->Strm[uScreen];
+        if (pStrm->Thread != NIL_RTTHREAD)
+        {
+            RTSemEventSignal(pStrm->WaitEvent);
+            RTThreadWait(pStrm->Thread, 10000, NULL);
+        }
+        RTSemEventDestroy(pStrm->WaitEvent);
+        RTCritSectDelete(&pStrm->CritSectDirty);
+    }
     RTSemEventDestroy(pCtx->TermEvent);
 
     for (unsigned uScreen = 0; uScreen < pCtx->cScreens; uScreen++)
@@ -707,19 +916,69 @@ bool VideoRecIsFull(PVIDEORECCONTEXT pCtx, uint32_t uScreen, uint64_t u64TimeSta
     return false;
 }
 
+/**
+ * VideoRec utility function to record a change of the screen content.
+ *
+ * Only the changed part of the framebuffer is copied and converted for the
+ * next frame, and frames are skipped if nothing changed at all.
+ *
+ * @param   pCtx    Pointer to video recording context.
+ * @param   uScreen screen id.
+ * @param   x       left edge of the changed rectangle (framebuffer coordinates).
+ * @param   y       top edge of the changed rectangle.
+ * @param   w       width of the changed rectangle.
+ * @param   h       height of the changed rectangle.
+ */
+void VideoRecMarkDirty(PVIDEORECCONTEXT pCtx, uint32_t uScreen, uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+{
+    if (!w || !h)
+        return;
+
+    /* Guard against termination, VideoRecContextClose() waits for us. */
+    ASMAtomicIncU32(&g_cDirtyMarkers);
+    uint32_t enmState = ASMAtomicReadU32(&g_enmState);
+    if (   (   enmState == VIDREC_IDLE
+            || enmState == VIDREC_COPYING)
+        && pCtx
+        && uScreen < pCtx->cScreens
+        && pCtx->Strm[uScreen].fEnabled)
+    {
+        PVIDEORECSTREAM pStrm = &pCtx->Strm[uScreen];
+        uint32_t const xMax = (uint32_t)RT_MIN((uint64_t)x + w, UINT32_MAX);
+        uint32_t const yMax = (uint32_t)RT_MIN((uint64_t)y + h, UINT32_MAX);
+        RTCritSectEnter(&pStrm->CritSectDirty);
+        if (!pStrm->fDirty)
+        {
+            pStrm->xDirtyMin = x;
+            pStrm->yDirtyMin = y;
+            pStrm->xDirtyMax = xMax;
+            pStrm->yDirtyMax = yMax;
+            pStrm->fDirty    = true;
+        }
+        else
+        {
+            pStrm->xDirtyMin = RT_MIN(pStrm->xDirtyMin, x);
+            pStrm->yDirtyMin = RT_MIN(pStrm->yDirtyMin, y);
+            pStrm->xDirtyMax = RT_MAX(pStrm->xDirtyMax, xMax);
+            pStrm->yDirtyMax = RT_MAX(pStrm->yDirtyMax, yMax);
+        }
+        RTCritSectLeave(&pStrm->CritSectDirty);
+    }
+    ASMAtomicDecU32(&g_cDirtyMarkers);
+}
+
 /**
  * VideoRec utility function to encode the source image and write the encoded
  * image to target file.
  *
  * @returns IPRT status code.
- * @param   pCtx  Pointer to video recording context.
- * @param   uSourceWidth      Width of the source image.
- * @param   uSourceHeight     Height of the source image.
+ * @param   pStrm         Pointer to the stream.
+ * @param   u64TimeStamp  Time stamp of the frame (milliseconds).
  */
-static int videoRecEncodeAndWrite(PVIDEORECSTREAM pStrm)
+static int videoRecEncodeAndWrite(PVIDEORECSTREAM pStrm, uint64_t u64TimeStamp)
 {
     /* presentation time stamp */
-    vpx_codec_pts_t pts = pStrm->u64TimeStamp;
+    vpx_codec_pts_t pts = u64TimeStamp;
     vpx_codec_err_t rcv = vpx_codec_encode(&pStrm->VpxCodec,
                                            &pStrm->VpxRawImage,
                                            pts /* time stamp */,
@@ -751,6 +1010,7 @@ static int videoRecEncodeAndWrite(PVIDEORECSTREAM pStrm)
     }
 
     pStrm->cFrame++;
+    STAM_REL_COUNTER_INC(&pStrm->pStats->StatFramesEncoded);
     return rc;
 }
 
@@ -766,10 +1026,21 @@ static int videoRecRGBToYUV(PVIDEORECSTREAM pStrm)
     {
         case VPX_IMG_FMT_RGB32:
             LogFlow(("32 bit\n"));
+#ifdef VIDEOREC_WITH_SSE2
+            if (!colorConvWriteYUV420pBGRA32Sse2(pStrm->uTargetWidth,
+                                                 pStrm->uTargetHeight,
+                                                 pStrm->pu8YuvBuf,
+                                                 pStrm->pu8RgbBuf,
+                                                 pStrm->xConv, pStrm->yConv,
+                                                 pStrm->cxConv, pStrm->cyConv))
+#else
             if (!colorConvWriteYUV420p<ColorConvBGRA32Iter>(pStrm->uTargetWidth,
                                                             pStrm->uTargetHeight,
                                                             pStrm->pu8YuvBuf,
-                                                            pStrm->pu8RgbBuf))
+                                                            pStrm->pu8RgbBuf,
+                                                            pStrm->xConv, pStrm->yConv,
+                                                            pStrm->cxConv, pStrm->cyConv))
+#endif
                 return VERR_GENERAL_FAILURE;
             break;
         case VPX_IMG_FMT_RGB24:
@@ -777,7 +1048,9 @@ static int videoRecRGBToYUV(PVIDEORECSTREAM pStrm)
             if (!colorConvWriteYUV420p<ColorConvBGR24Iter>(pStrm->uTargetWidth,
                                                            pStrm->uTargetHeight,
                                                            pStrm->pu8YuvBuf,
-                                                           pStrm->pu8RgbBuf))
+                                                           pStrm->pu8RgbBuf,
+                                                           pStrm->xConv, pStrm->yConv,
+                                                           pStrm->cxConv, pStrm->cyConv))
                 return VERR_GENERAL_FAILURE;
             break;
         case VPX_IMG_FMT_RGB565:
@@ -785,7 +1058,9 @@ static int videoRecRGBToYUV(PVIDEORECSTREAM pStrm)
             if (!colorConvWriteYUV420p<ColorConvBGR565Iter>(pStrm->uTargetWidth,
                                                             pStrm->uTargetHeight,
                                                             pStrm->pu8YuvBuf,
-                                                            pStrm->pu8RgbBuf))
+                                                            pStrm->pu8RgbBuf,
+                                                            pStrm->xConv, pStrm->yConv,
+                                                            pStrm->cxConv, pStrm->cyConv))
                 return VERR_GENERAL_FAILURE;
             break;
         default:
@@ -843,6 +1118,7 @@ int VideoRecCopyToIntBuf(PVIDEORECCONTEXT pCtx, uint32_t uScreen, uint32_t x, ui
         }
         if (ASMAtomicReadBool(&pStrm->fRgbFilled))
         {
+            STAM_REL_COUNTER_INC(&pStrm->pStats->StatFramesDropped);
             rc = VERR_TRY_AGAIN; /* previous frame not yet encoded */
             break;
         }
@@ -899,6 +1175,7 @@ int VideoRecCopyToIntBuf(PVIDEORECCONTEXT pCtx, uint32_t uScreen, uint32_t x, ui
             h = pStrm->uTargetHeight - destY;
 
         /* Calculate bytes per pixel */
+        uint32_t const u32OldPixelFormat = pStrm->u32PixelFormat;
         uint32_t bpp = 1;
         if (uPixelFormat == BitmapFormat_BGR)
         {
@@ -930,9 +1207,63 @@ int VideoRecCopyToIntBuf(PVIDEORECCONTEXT pCtx, uint32_t uScreen, uint32_t x, ui
             || uSourceHeight < pStrm->uLastSourceHeight)
             memset(pStrm->pu8RgbBuf, 0, pStrm->uTargetWidth * pStrm->uTargetHeight * 4);
 
+        /* Unless the whole frame has to be refreshed, only copy and convert
+         * what changed since the last frame and skip the frame if nothing did. */
+        bool const fFull =    uSourceWidth  != pStrm->uLastSourceWidth
+                           || uSourceHeight != pStrm->uLastSourceHeight
+                           || pStrm->u32PixelFormat != u32OldPixelFormat
+                           || u64TimeStamp - pStrm->u64LastFullTimeStamp >= VIDEOREC_FULL_REFRESH_MS;
         pStrm->uLastSourceWidth  = uSourceWidth;
         pStrm->uLastSourceHeight = uSourceHeight;
 
+        RTCritSectEnter(&pStrm->CritSectDirty);
+        bool const     fDirty    = pStrm->fDirty;
+        uint32_t const xDirtyMin = pStrm->xDirtyMin;
+        uint32_t const yDirtyMin = pStrm->yDirtyMin;
+        uint32_t const xDirtyMax = pStrm->xDirtyMax;
+        uint32_t const yDirtyMax = pStrm->yDirtyMax;
+        pStrm->fDirty = false;
+        RTCritSectLeave(&pStrm->CritSectDirty);
+
+        if (fFull)
+            pStrm->u64LastFullTimeStamp = u64TimeStamp;
+        else
+        {
+            uint32_t const xMin = RT_MAX(x, xDirtyMin);
+            uint32_t const yMin = RT_MAX(y, yDirtyMin);
+            uint32_t const xMax = RT_MIN(x + w, xDirtyMax);
+            uint32_t const yMax = RT_MIN(y + h, yDirtyMax);
+            if (   !fDirty
+                || xMin >= xMax
+                || yMin >= yMax)
+            {
+                STAM_REL_COUNTER_INC(&pStrm->pStats->StatFramesUnchanged);
+                break; /* nothing changed, the encoder keeps showing the last frame */
+            }
+            destX += xMin - x;
+            destY += yMin - y;
+            x = xMin;
+            y = yMin;
+            w = xMax - xMin;
+            h = yMax - yMin;
+        }
+
+        /* The conversion works on 2x2 blocks. */
+        if (fFull)
+        {
+            pStrm->xConv  = 0;
+            pStrm->yConv  = 0;
+            pStrm->cxConv = pStrm->uTargetWidth;
+            pStrm->cyConv = pStrm->uTargetHeight;
+        }
+        else
+        {
+            pStrm->xConv  = destX & ~1U;
+            pStrm->yConv  = destY & ~1U;
+            pStrm->cxConv = RT_MIN(RT_ALIGN_32(destX + w, 2), pStrm->uTargetWidth)  - pStrm->xConv;
+            pStrm->cyConv = RT_MIN(RT_ALIGN_32(destY + h, 2), pStrm->uTargetHeight) - pStrm->yConv;
+        }
+
         /* Calculate start offset in source and destination buffers */
         uint32_t offSrc = y * uBytesPerLine + x * bpp;
         uint32_t offDst = (destY * pStrm->uTargetWidth + destX) * bpp;
@@ -947,10 +1278,11 @@ int VideoRecCopyToIntBuf(PVIDEORECCONTEXT pCtx, uint32_t uScreen, uint32_t x, ui
             offDst += pStrm->uTargetWidth * bpp;
         }
 
-        pStrm->u64TimeStamp = u64TimeStamp;
+        pStrm->u64TimeStamp     = u64TimeStamp;
+        pStrm->u64CaptureNanoTS = RTTimeNanoTS();
 
         ASMAtomicWriteBool(&pStrm->fRgbFilled, true);
-        RTSemEventSignal(pCtx->WaitEvent);
+        RTSemEventSignal(pStrm->WaitEvent);
     } while (0);
 
     if (!ASMAtomicCmpXchgU32(&g_enmState, VIDREC_IDLE, VIDREC_COPYING))
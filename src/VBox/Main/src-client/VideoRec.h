@@ -18,16 +18,42 @@
 #ifndef ____H_VIDEOREC
 #define ____H_VIDEOREC
 
+#include <VBox/vmm/stam.h>
+
 struct VIDEORECCONTEXT;
 typedef struct VIDEORECCONTEXT *PVIDEORECCONTEXT;
 
 struct VIDEORECSTREAM;
 typedef struct VIDEORECSTREAM *PVIDEORECSTREAM;
 
+/**
+ * Video recording statistics of one screen.
+ *
+ * These are owned by the caller so they can be registered once and survive
+ * recording being stopped and started again.
+ */
+typedef struct VIDEORECSTATS
+{
+    /* frames encoded and written */
+    STAMCOUNTER         StatFramesEncoded;
+    /* frames dropped because the encoder was still busy with the previous one */
+    STAMCOUNTER         StatFramesDropped;
+    /* frames skipped because nothing changed on the screen */
+    STAMCOUNTER         StatFramesUnchanged;
+    /* RGB to YUV conversion time */
+    STAMPROFILE         StatConvert;
+    /* encoding and writing time */
+    STAMPROFILE         StatEncode;
+    /* time from capturing a frame till it has been written */
+    STAMPROFILE         StatLatency;
+} VIDEORECSTATS;
+typedef VIDEORECSTATS *PVIDEORECSTATS;
+
 int  VideoRecContextCreate(PVIDEORECCONTEXT *ppCtx, uint32_t cScreens);
 int  VideoRecStrmInit(PVIDEORECCONTEXT pCtx, uint32_t uScreen, const char *pszFile,
                       uint32_t uWidth, uint32_t uHeight, uint32_t uRate, uint32_t uFps,
-                      uint32_t uMaxTime, uint32_t uMaxFileSize, const char *pszOptions);
+                      uint32_t uMaxTime, uint32_t uMaxFileSize, const char *pszOptions,
+                      PVIDEORECSTATS pStats);
 void VideoRecContextClose(PVIDEORECCONTEXT pCtx);
 bool VideoRecIsEnabled(PVIDEORECCONTEXT pCtx);
 int  VideoRecCopyToIntBuf(PVIDEORECCONTEXT pCtx, uint32_t uScreen,
@@ -36,6 +62,7 @@ int  VideoRecCopyToIntBuf(PVIDEORECCONTEXT pCtx, uint32_t uScreen,
                           uint8_t *pu8BufferAddress, uint64_t u64TimeStamp);
 bool VideoRecIsReady(PVIDEORECCONTEXT pCtx, uint32_t uScreen, uint64_t u64TimeStamp);
 bool VideoRecIsFull(PVIDEORECCONTEXT pCtx, uint32_t uScreen, uint64_t u64TimeStamp);
+void VideoRecMarkDirty(PVIDEORECCONTEXT pCtx, uint32_t uScreen, uint32_t x, uint32_t y, uint32_t w, uint32_t h);
 
 #endif /* !____H_VIDEOREC */
 
@@ -25,6 +25,7 @@
 #include <VBox/vmm/vm.h>
 #include <VBox/err.h>
 #include <iprt/assert.h>
+#include <iprt/asm-amd64-x86.h>
 
 
 /**
@@ -265,3 +266,37 @@ VMM_INT_DECL(bool) DBGFIsStepping(PVMCPU pVCpu)
     return pVCpu->dbgf.s.fSingleSteppingRaw;
 }
 
+
+
+/**
+ * Records an event in the binary trace ring of the calling virtual CPU.
+ *
+ * Use DBGFTRACE_RING_EVT rather than calling this directly, it checks that the
+ * event group is enabled first.
+ *
+ * @param   pVCpu       The cross context virtual CPU structure of the calling
+ *                      EMT.
+ * @param   enmEvt      The event type.
+ * @param   u32Arg      Event argument.
+ * @param   u64Arg1     Event argument.
+ * @param   u64Arg2     Event argument.
+ */
+VMM_INT_DECL(void) DBGFTraceRingRecord(PVMCPU pVCpu, DBGFTRACEEVT enmEvt, uint32_t u32Arg, uint64_t u64Arg1, uint64_t u64Arg2)
+{
+    PDBGFTRACERING pRing = pVCpu->dbgf.s.CTX_SUFF(pTraceRing);
+    if (pRing)
+    {
+        /* We're the only producer, so no need for atomic increments here.  The
+           entry must be complete before the new head index is published. */
+        uint64_t const  idx    = pRing->idxHead;
+        PDBGFTRACEENTRY pEntry = &pRing->aEntries[idx & (pRing->cEntries - 1)];
+        pEntry->u64Tsc  = ASMReadTSC();
+        pEntry->u16Evt  = (uint16_t)enmEvt;
+        pEntry->idCpu   = (uint16_t)pVCpu->idCpu;
+        pEntry->u32Arg  = u32Arg;
+        pEntry->u64Arg1 = u64Arg1;
+        pEntry->u64Arg2 = u64Arg2;
+        ASMAtomicWriteU64(&pRing->idxHead, idx + 1);
+    }
+}
+
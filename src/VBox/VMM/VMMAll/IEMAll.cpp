@@ -912,6 +912,85 @@ DECLINLINE(void) iemInitDecoder(PIEMCPU pIemCpu, bool fBypassHandlers)
 }
 
 
+/**
+ * Translates a guest virtual address using one of the IEM TLBs, walking the
+ * guest page tables and loading the entry on a miss.
+ *
+ * @returns VBox status code from PGMGstGetPage.
+ * @param   pIemCpu             The IEM per CPU data.
+ * @param   pTlb                The TLB to use (CodeTlb or DataTlb).
+ * @param   GCPtr               The guest virtual address.
+ * @param   ppTlbe              Where to return the TLB entry on success.
+ */
+IEM_STATIC int iemTlbLookup(PIEMCPU pIemCpu, PIEMTLB pTlb, RTGCPTR GCPtr, PIEMTLBENTRY *ppTlbe)
+{
+    uint64_t const     uTag  = IEMTLB_CALC_TAG(pTlb, GCPtr);
+    PIEMTLBENTRY const pTlbe = IEMTLB_TAG_TO_ENTRY(pTlb, uTag);
+    if (pTlbe->uTag == uTag)
+        pTlb->cTlbHits++;
+    else
+    {
+        pTlb->cTlbMisses++;
+        uint64_t fFlags;
+        RTGCPHYS GCPhys;
+        int rc = PGMGstGetPage(IEMCPU_TO_VMCPU(pIemCpu), GCPtr, &fFlags, &GCPhys);
+        if (RT_FAILURE(rc))
+        {
+            pTlbe->uTag = 0;
+            return rc;
+        }
+        pTlbe->uTag   = uTag;
+        pTlbe->fFlags = fFlags;
+        pTlbe->GCPhys = GCPhys & ~(RTGCPHYS)PAGE_OFFSET_MASK;
+    }
+    *ppTlbe = pTlbe;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Invalidates all entries of an IEM TLB by bumping the revision.
+ *
+ * @param   pTlb                The TLB.
+ */
+DECLINLINE(void) iemTlbInvalidateAll(PIEMTLB pTlb)
+{
+    pTlb->uTlbRevision += IEMTLB_REVISION_INCR;
+    if (RT_LIKELY(pTlb->uTlbRevision != 0))
+    { /* very likely */ }
+    else
+    {
+        /* Wrapped around, make sure no stale entry can match again. */
+        pTlb->uTlbRevision = IEMTLB_REVISION_INCR;
+        for (unsigned i = 0; i < RT_ELEMENTS(pTlb->aEntries); i++)
+            pTlb->aEntries[i].uTag = 0;
+    }
+}
+
+
+/**
+ * Invalidates the entries of an IEM TLB covering the given page range.
+ *
+ * @param   pTlb                The TLB.
+ * @param   GCPtrFirst          The first page to invalidate.
+ * @param   cPages              The number of pages.
+ */
+IEM_STATIC void iemTlbInvalidateRange(PIEMTLB pTlb, RTGCPTR GCPtrFirst, uint64_t cPages)
+{
+    uint64_t const uTagFirst = IEMTLB_CALC_TAG(pTlb, GCPtrFirst);
+    if (cPages == 1)
+    {
+        PIEMTLBENTRY pTlbe = IEMTLB_TAG_TO_ENTRY(pTlb, uTagFirst);
+        if (pTlbe->uTag == uTagFirst)
+            pTlbe->uTag = 0;
+    }
+    else
+        for (unsigned i = 0; i < RT_ELEMENTS(pTlb->aEntries); i++)
+            if (pTlb->aEntries[i].uTag - uTagFirst < cPages)
+                pTlb->aEntries[i].uTag = 0;
+}
+
+
 /**
  * Prefetch opcodes the first time when starting executing.
  *
@@ -971,25 +1050,28 @@ IEM_STATIC VBOXSTRICTRC iemInitDecoderAndPrefetchOpcodes(PIEMCPU pIemCpu, bool f
     }
 #endif /* VBOX_WITH_RAW_MODE_NOT_R0 */
 
-    RTGCPHYS    GCPhys;
-    uint64_t    fFlags;
-    int rc = PGMGstGetPage(IEMCPU_TO_VMCPU(pIemCpu), GCPtrPC, &fFlags, &GCPhys);
+    PIEMTLBENTRY pTlbe;
+    int rc = iemTlbLookup(pIemCpu, &pIemCpu->CodeTlb, GCPtrPC, &pTlbe);
     if (RT_FAILURE(rc))
     {
         Log(("iemInitDecoderAndPrefetchOpcodes: %RGv - rc=%Rrc\n", GCPtrPC, rc));
         return iemRaisePageFault(pIemCpu, GCPtrPC, IEM_ACCESS_INSTRUCTION, rc);
     }
-    if (!(fFlags & X86_PTE_US) && pIemCpu->uCpl == 3)
+    /* Like real CPUs, drop the entry on a permission fault so a guest relaxing
+       the PTE without INVLPG sees the change on the retry. */
+    if (!(pTlbe->fFlags & X86_PTE_US) && pIemCpu->uCpl == 3)
     {
         Log(("iemInitDecoderAndPrefetchOpcodes: %RGv - supervisor page\n", GCPtrPC));
+        pTlbe->uTag = 0;
         return iemRaisePageFault(pIemCpu, GCPtrPC, IEM_ACCESS_INSTRUCTION, VERR_ACCESS_DENIED);
     }
-    if ((fFlags & X86_PTE_PAE_NX) && (pCtx->msrEFER & MSR_K6_EFER_NXE))
+    if ((pTlbe->fFlags & X86_PTE_PAE_NX) && (pCtx->msrEFER & MSR_K6_EFER_NXE))
     {
         Log(("iemInitDecoderAndPrefetchOpcodes: %RGv - NX\n", GCPtrPC));
+        pTlbe->uTag = 0;
         return iemRaisePageFault(pIemCpu, GCPtrPC, IEM_ACCESS_INSTRUCTION, VERR_ACCESS_DENIED);
     }
-    GCPhys |= GCPtrPC & PAGE_OFFSET_MASK;
+    RTGCPHYS const GCPhys = pTlbe->GCPhys | (GCPtrPC & PAGE_OFFSET_MASK);
     /** @todo Check reserved bits and such stuff. PGM is better at doing
      *        that, so do it when implementing the guest virtual address
      *        TLB... */
@@ -1142,25 +1224,28 @@ IEM_STATIC VBOXSTRICTRC iemOpcodeFetchMoreBytes(PIEMCPU pIemCpu, size_t cbMin)
     }
 #endif /* VBOX_WITH_RAW_MODE_NOT_R0 */
 
-    RTGCPHYS    GCPhys;
-    uint64_t    fFlags;
-    int rc = PGMGstGetPage(IEMCPU_TO_VMCPU(pIemCpu), GCPtrNext, &fFlags, &GCPhys);
+    PIEMTLBENTRY pTlbe;
+    int rc = iemTlbLookup(pIemCpu, &pIemCpu->CodeTlb, GCPtrNext, &pTlbe);
     if (RT_FAILURE(rc))
     {
         Log(("iemOpcodeFetchMoreBytes: %RGv - rc=%Rrc\n", GCPtrNext, rc));
         return iemRaisePageFault(pIemCpu, GCPtrNext, IEM_ACCESS_INSTRUCTION, rc);
     }
-    if (!(fFlags & X86_PTE_US) && pIemCpu->uCpl == 3)
+    /* Like real CPUs, drop the entry on a permission fault so a guest relaxing
+       the PTE without INVLPG sees the change on the retry. */
+    if (!(pTlbe->fFlags & X86_PTE_US) && pIemCpu->uCpl == 3)
     {
         Log(("iemOpcodeFetchMoreBytes: %RGv - supervisor page\n", GCPtrNext));
+        pTlbe->uTag = 0;
         return iemRaisePageFault(pIemCpu, GCPtrNext, IEM_ACCESS_INSTRUCTION, VERR_ACCESS_DENIED);
     }
-    if ((fFlags & X86_PTE_PAE_NX) && (pCtx->msrEFER & MSR_K6_EFER_NXE))
+    if ((pTlbe->fFlags & X86_PTE_PAE_NX) && (pCtx->msrEFER & MSR_K6_EFER_NXE))
     {
         Log(("iemOpcodeFetchMoreBytes: %RGv - NX\n", GCPtrNext));
+        pTlbe->uTag = 0;
         return iemRaisePageFault(pIemCpu, GCPtrNext, IEM_ACCESS_INSTRUCTION, VERR_ACCESS_DENIED);
     }
-    GCPhys |= GCPtrNext & PAGE_OFFSET_MASK;
+    RTGCPHYS const GCPhys = pTlbe->GCPhys | (GCPtrNext & PAGE_OFFSET_MASK);
     Log5(("GCPtrNext=%RGv GCPhys=%RGp cbOpcodes=%#x\n",  GCPtrNext,  GCPhys,  pIemCpu->cbOpcode));
     /** @todo Check reserved bits and such stuff. PGM is better at doing
      *        that, so do it when implementing the guest virtual address
@@ -6260,9 +6345,8 @@ iemMemPageTranslateAndCheckAccess(PIEMCPU pIemCpu, RTGCPTR GCPtrMem, uint32_t fA
 {
     /** @todo Need a different PGM interface here.  We're currently using
      *        generic / REM interfaces. this won't cut it for R0 & RC. */
-    RTGCPHYS    GCPhys;
-    uint64_t    fFlags;
-    int rc = PGMGstGetPage(IEMCPU_TO_VMCPU(pIemCpu), GCPtrMem, &fFlags, &GCPhys);
+    PIEMTLBENTRY pTlbe;
+    int rc = iemTlbLookup(pIemCpu, &pIemCpu->DataTlb, GCPtrMem, &pTlbe);
     if (RT_FAILURE(rc))
     {
         /** @todo Check unassigned memory in unpaged mode. */
@@ -6272,7 +6356,11 @@ iemMemPageTranslateAndCheckAccess(PIEMCPU pIemCpu, RTGCPTR GCPtrMem, uint32_t fA
     }
 
     /* If the page is writable and does not have the no-exec bit set, all
-       access is allowed.  Otherwise we'll have to check more carefully... */
+       access is allowed.  Otherwise we'll have to check more carefully...
+       Like real CPUs, we drop the entry when raising a permission fault, so a
+       guest relaxing the PTE without INVLPG (lazy #PF handlers, COW) sees the
+       change when retrying. */
+    uint64_t const fFlags = pTlbe->fFlags;
     if ((fFlags & (X86_PTE_RW | X86_PTE_US | X86_PTE_PAE_NX)) != (X86_PTE_RW | X86_PTE_US))
     {
         /* Write to read only memory? */
@@ -6283,6 +6371,7 @@ iemMemPageTranslateAndCheckAccess(PIEMCPU pIemCpu, RTGCPTR GCPtrMem, uint32_t fA
         {
             Log(("iemMemPageTranslateAndCheckAccess: GCPtrMem=%RGv - read-only page -> #PF\n", GCPtrMem));
             *pGCPhysMem = NIL_RTGCPHYS;
+            pTlbe->uTag = 0;
             return iemRaisePageFault(pIemCpu, GCPtrMem, fAccess & ~IEM_ACCESS_TYPE_READ, VERR_ACCESS_DENIED);
         }
 
@@ -6293,6 +6382,7 @@ iemMemPageTranslateAndCheckAccess(PIEMCPU pIemCpu, RTGCPTR GCPtrMem, uint32_t fA
         {
             Log(("iemMemPageTranslateAndCheckAccess: GCPtrMem=%RGv - user access to kernel page -> #PF\n", GCPtrMem));
             *pGCPhysMem = NIL_RTGCPHYS;
+            pTlbe->uTag = 0;
             return iemRaisePageFault(pIemCpu, GCPtrMem, fAccess, VERR_ACCESS_DENIED);
         }
 
@@ -6303,6 +6393,7 @@ iemMemPageTranslateAndCheckAccess(PIEMCPU pIemCpu, RTGCPTR GCPtrMem, uint32_t fA
         {
             Log(("iemMemPageTranslateAndCheckAccess: GCPtrMem=%RGv - NX -> #PF\n", GCPtrMem));
             *pGCPhysMem = NIL_RTGCPHYS;
+            pTlbe->uTag = 0;
             return iemRaisePageFault(pIemCpu, GCPtrMem, fAccess & ~(IEM_ACCESS_TYPE_READ | IEM_ACCESS_TYPE_WRITE),
                                      VERR_ACCESS_DENIED);
         }
@@ -6318,10 +6409,13 @@ iemMemPageTranslateAndCheckAccess(PIEMCPU pIemCpu, RTGCPTR GCPtrMem, uint32_t fA
     {
         int rc2 = PGMGstModifyPage(IEMCPU_TO_VMCPU(pIemCpu), GCPtrMem, 1, fAccessedDirty, ~(uint64_t)fAccessedDirty);
         AssertRC(rc2);
+        if (RT_SUCCESS(rc2))
+            pTlbe->fFlags |= fAccessedDirty;
+        else
+            pTlbe->uTag = 0;
     }
 
-    GCPhys |= GCPtrMem & PAGE_OFFSET_MASK;
-    *pGCPhysMem = GCPhys;
+    *pGCPhysMem = pTlbe->GCPhys | (GCPtrMem & PAGE_OFFSET_MASK);
     return VINF_SUCCESS;
 }
 
@@ -11166,6 +11260,59 @@ VMMDECL(VBOXSTRICTRC) IEMInjectTrpmEvent(PVMCPU pVCpu)
 }
 
 
+/**
+ * Invalidates all the IEM TLB entries of a virtual CPU.
+ *
+ * Called by PGM on CR3 loads and paging mode changes, and by HM before it
+ * lets the guest execute natively (the guest may modify its page tables and
+ * execute INVLPG without us seeing it).
+ *
+ * @param   pVCpu       The cross context virtual CPU structure of the calling EMT.
+ */
+VMM_INT_DECL(void) IEMTlbInvalidateAll(PVMCPU pVCpu)
+{
+    iemTlbInvalidateAll(&pVCpu->iem.s.CodeTlb);
+    iemTlbInvalidateAll(&pVCpu->iem.s.DataTlb);
+}
+
+
+/**
+ * Invalidates the IEM TLB entries for a guest page (INVLPG).
+ *
+ * Since the TLB entries do not record whether they were loaded from a large
+ * page, all entries within the largest page containing @a GCPtr the paging
+ * mode allows are flushed, i.e. 1GB in long mode.  This doesn't cost more than
+ * a 2MB range since ranges are handled by scanning all the entries anyway.
+ *
+ * @param   pVCpu       The cross context virtual CPU structure of the calling EMT.
+ * @param   GCPtr       The guest virtual address of the page to invalidate.
+ */
+VMM_INT_DECL(void) IEMTlbInvalidatePage(PVMCPU pVCpu, RTGCPTR GCPtr)
+{
+    PCPUMCTX pCtx   = pVCpu->iem.s.CTX_SUFF(pCtx);
+    uint64_t cPages = 1;
+    if (CPUMIsGuestInLongModeEx(pCtx))
+    {
+        GCPtr &= ~(RTGCPTR)(_1G - 1);
+        cPages = _1G / X86_PAGE_4K_SIZE;
+    }
+    else if (pCtx->cr4 & X86_CR4_PAE)
+    {
+        GCPtr &= ~(RTGCPTR)X86_PAGE_2M_OFFSET_MASK;
+        cPages = X86_PAGE_2M_SIZE / X86_PAGE_4K_SIZE;
+    }
+    else if (pCtx->cr4 & X86_CR4_PSE)
+    {
+        GCPtr &= ~(RTGCPTR)X86_PAGE_4M_OFFSET_MASK;
+        cPages = X86_PAGE_4M_SIZE / X86_PAGE_4K_SIZE;
+    }
+    else
+        GCPtr &= ~(RTGCPTR)X86_PAGE_4K_OFFSET_MASK;
+    iemTlbInvalidateRange(&pVCpu->iem.s.CodeTlb, GCPtr, cPages);
+    iemTlbInvalidateRange(&pVCpu->iem.s.DataTlb, GCPtr, cPages);
+}
+
+
 VMM_INT_DECL(int) IEMBreakpointSet(PVM pVM, RTGCPTR GCPtrBp)
 {
     return VERR_NOT_IMPLEMENTED;
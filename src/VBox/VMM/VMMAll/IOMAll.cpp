@@ -22,6 +22,7 @@
 #define LOG_GROUP LOG_GROUP_IOM
 #include <VBox/vmm/iom.h>
 #include <VBox/vmm/mm.h>
+#include <VBox/vmm/dbgftrace.h>
 #if defined(IEM_VERIFICATION_MODE) && defined(IN_RING3)
 # include <VBox/vmm/iem.h>
 #endif
@@ -90,6 +91,7 @@ VMMDECL(VBOXSTRICTRC) IOMIOPortRead(PVM pVM, PVMCPU pVCpu, RTIOPORT Port, uint32
 #if defined(IEM_VERIFICATION_MODE) && defined(IN_RING3)
     IEMNotifyIOPortRead(pVM, Port, cbValue);
 #endif
+    iomIOPortCountAccess(pVM, Port);
 
 #ifdef VBOX_WITH_STATISTICS
     /*
@@ -102,19 +104,14 @@ VMMDECL(VBOXSTRICTRC) IOMIOPortRead(PVM pVM, PVMCPU pVCpu, RTIOPORT Port, uint32
         if (pStats)
             pVCpu->iom.s.CTX_SUFF(pStatsLastRead) = pStats;
     }
+#else
+    NOREF(pVCpu);
 #endif
 
     /*
      * Get handler for current context.
      */
-    CTX_SUFF(PIOMIOPORTRANGE) pRange = pVCpu->iom.s.CTX_SUFF(pRangeLastRead);
-    if (    !pRange
-        ||   (unsigned)Port - (unsigned)pRange->Port >= (unsigned)pRange->cPorts)
-    {
-        pRange = iomIOPortGetRange(pVM, Port);
-        if (pRange)
-            pVCpu->iom.s.CTX_SUFF(pRangeLastRead) = pRange;
-    }
+    CTX_SUFF(PIOMIOPORTRANGE) pRange = iomIOPortGetRange(pVM, Port);
     MMHYPER_RC_ASSERT_RCPTR(pVM, pRange);
     if (pRange)
     {
@@ -181,6 +178,8 @@ VMMDECL(VBOXSTRICTRC) IOMIOPortRead(PVM pVM, PVMCPU pVCpu, RTIOPORT Port, uint32
                     return VERR_IOM_INVALID_IOPORT_SIZE;
             }
         }
+        if (rcStrict == VINF_SUCCESS)
+            DBGFTRACE_RING_EVT(pVCpu, DBGFTRACE_GRP_IO, DBGFTRACEEVT_IOPORT_READ, Port, *pu32Value, cbValue);
         Log3(("IOMIOPortRead: Port=%RTiop *pu32=%08RX32 cb=%d rc=%Rrc\n", Port, *pu32Value, cbValue, VBOXSTRICTRC_VAL(rcStrict)));
         return rcStrict;
     }
@@ -220,6 +219,7 @@ VMMDECL(VBOXSTRICTRC) IOMIOPortRead(PVM pVM, PVMCPU pVCpu, RTIOPORT Port, uint32
             IOM_UNLOCK_SHARED(pVM);
             return VERR_IOM_INVALID_IOPORT_SIZE;
     }
+    DBGFTRACE_RING_EVT(pVCpu, DBGFTRACE_GRP_IO, DBGFTRACEEVT_IOPORT_READ, Port, *pu32Value, cbValue);
     Log3(("IOMIOPortRead: Port=%RTiop *pu32=%08RX32 cb=%d rc=VINF_SUCCESS\n", Port, *pu32Value, cbValue));
     IOM_UNLOCK_SHARED(pVM);
     return VINF_SUCCESS;
@@ -257,6 +257,7 @@ VMM_INT_DECL(VBOXSTRICTRC) IOMIOPortReadString(PVM pVM, PVMCPU pVCpu, RTIOPORT u
 #if defined(IEM_VERIFICATION_MODE) && defined(IN_RING3)
     IEMNotifyIOPortReadString(pVM, uPort, pvDst, *pcTransfers, cb);
 #endif
+    iomIOPortCountAccess(pVM, uPort);
 
     const uint32_t cRequestedTransfers = *pcTransfers;
     Assert(cRequestedTransfers > 0);
@@ -272,19 +273,14 @@ VMM_INT_DECL(VBOXSTRICTRC) IOMIOPortReadString(PVM pVM, PVMCPU pVCpu, RTIOPORT u
         if (pStats)
             pVCpu->iom.s.CTX_SUFF(pStatsLastRead) = pStats;
     }
+#else
+    NOREF(pVCpu);
 #endif
 
     /*
      * Get handler for current context.
      */
-    CTX_SUFF(PIOMIOPORTRANGE) pRange = pVCpu->iom.s.CTX_SUFF(pRangeLastRead);
-    if (    !pRange
-        ||   (unsigned)uPort - (unsigned)pRange->Port >= (unsigned)pRange->cPorts)
-    {
-        pRange = iomIOPortGetRange(pVM, uPort);
-        if (pRange)
-            pVCpu->iom.s.CTX_SUFF(pRangeLastRead) = pRange;
-    }
+    CTX_SUFF(PIOMIOPORTRANGE) pRange = iomIOPortGetRange(pVM, uPort);
     MMHYPER_RC_ASSERT_RCPTR(pVM, pRange);
     if (pRange)
     {
@@ -450,6 +446,7 @@ VMMDECL(VBOXSTRICTRC) IOMIOPortWrite(PVM pVM, PVMCPU pVCpu, RTIOPORT Port, uint3
 #if defined(IEM_VERIFICATION_MODE) && defined(IN_RING3)
     IEMNotifyIOPortWrite(pVM, Port, u32Value, cbValue);
 #endif
+    iomIOPortCountAccess(pVM, Port);
 
 /** @todo bird: When I get time, I'll remove the RC/R0 trees and link the RC/R0
  *        entries to the ring-3 node. */
@@ -464,19 +461,14 @@ VMMDECL(VBOXSTRICTRC) IOMIOPortWrite(PVM pVM, PVMCPU pVCpu, RTIOPORT Port, uint3
         if (pStats)
             pVCpu->iom.s.CTX_SUFF(pStatsLastWrite) = pStats;
     }
+#else
+    NOREF(pVCpu);
 #endif
 
     /*
      * Get handler for current context.
      */
-    CTX_SUFF(PIOMIOPORTRANGE) pRange = pVCpu->iom.s.CTX_SUFF(pRangeLastWrite);
-    if (    !pRange
-        ||   (unsigned)Port - (unsigned)pRange->Port >= (unsigned)pRange->cPorts)
-    {
-        pRange = iomIOPortGetRange(pVM, Port);
-        if (pRange)
-            pVCpu->iom.s.CTX_SUFF(pRangeLastWrite) = pRange;
-    }
+    CTX_SUFF(PIOMIOPORTRANGE) pRange = iomIOPortGetRange(pVM, Port);
     MMHYPER_RC_ASSERT_RCPTR(pVM, pRange);
     if (pRange)
     {
@@ -529,6 +521,8 @@ VMMDECL(VBOXSTRICTRC) IOMIOPortWrite(PVM pVM, PVMCPU pVCpu, RTIOPORT Port, uint3
             STAM_COUNTER_INC(&pStats->OutRZToR3);
 # endif
 #endif
+        if (rcStrict == VINF_SUCCESS)
+            DBGFTRACE_RING_EVT(pVCpu, DBGFTRACE_GRP_IO, DBGFTRACEEVT_IOPORT_WRITE, Port, u32Value, cbValue);
         Log3(("IOMIOPortWrite: Port=%RTiop u32=%08RX32 cb=%d rc=%Rrc\n", Port, u32Value, cbValue, VBOXSTRICTRC_VAL(rcStrict)));
         return rcStrict;
     }
@@ -557,6 +551,7 @@ VMMDECL(VBOXSTRICTRC) IOMIOPortWrite(PVM pVM, PVMCPU pVCpu, RTIOPORT Port, uint3
     if (pStats)
         STAM_COUNTER_INC(&pStats->CTX_SUFF_Z(Out));
 #endif
+    DBGFTRACE_RING_EVT(pVCpu, DBGFTRACE_GRP_IO, DBGFTRACEEVT_IOPORT_WRITE, Port, u32Value, cbValue);
     Log3(("IOMIOPortWrite: Port=%RTiop u32=%08RX32 cb=%d nop\n", Port, u32Value, cbValue));
     IOM_UNLOCK_SHARED(pVM);
     return VINF_SUCCESS;
@@ -597,6 +592,7 @@ VMM_INT_DECL(VBOXSTRICTRC) IOMIOPortWriteString(PVM pVM, PVMCPU pVCpu, RTIOPORT
 #if defined(IEM_VERIFICATION_MODE) && defined(IN_RING3)
     IEMNotifyIOPortWriteString(pVM, uPort, pvSrc, *pcTransfers, cb);
 #endif
+    iomIOPortCountAccess(pVM, uPort);
 
     const uint32_t cRequestedTransfers = *pcTransfers;
     Assert(cRequestedTransfers > 0);
@@ -612,19 +608,14 @@ VMM_INT_DECL(VBOXSTRICTRC) IOMIOPortWriteString(PVM pVM, PVMCPU pVCpu, RTIOPORT
         if (pStats)
             pVCpu->iom.s.CTX_SUFF(pStatsLastWrite) = pStats;
     }
+#else
+    NOREF(pVCpu);
 #endif
 
     /*
      * Get handler for current context.
      */
-    CTX_SUFF(PIOMIOPORTRANGE) pRange = pVCpu->iom.s.CTX_SUFF(pRangeLastWrite);
-    if (    !pRange
-        ||   (unsigned)uPort - (unsigned)pRange->Port >= (unsigned)pRange->cPorts)
-    {
-        pRange = iomIOPortGetRange(pVM, uPort);
-        if (pRange)
-            pVCpu->iom.s.CTX_SUFF(pRangeLastWrite) = pRange;
-    }
+    CTX_SUFF(PIOMIOPORTRANGE) pRange = iomIOPortGetRange(pVM, uPort);
     MMHYPER_RC_ASSERT_RCPTR(pVM, pRange);
     if (pRange)
     {
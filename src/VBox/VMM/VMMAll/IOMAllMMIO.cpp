@@ -25,10 +25,12 @@
 #include <VBox/vmm/pgm.h>
 #include <VBox/vmm/selm.h>
 #include <VBox/vmm/mm.h>
+#include <VBox/vmm/dbgftrace.h>
 #include <VBox/vmm/em.h>
 #include <VBox/vmm/pgm.h>
 #include <VBox/vmm/trpm.h>
 #include <VBox/vmm/iem.h>
+#include <VBox/vmm/patm.h>
 #include "IOMInternal.h"
 #include <VBox/vmm/vm.h>
 #include <VBox/vmm/vmm.h>
@@ -235,6 +237,26 @@ bool iomSaveDataToReg(PDISCPUSTATE pCpu, PCDISOPPARAM pParam, PCPUMCTXCORE pRegF
 }
 
 
+/**
+ * Gets the value of an MMIO access for the binary trace ring.
+ *
+ * @returns The value, zero if not a 1, 2, 4 or 8 byte access.
+ * @param   pvValue             The value.
+ * @param   cbValue             The access size.
+ */
+DECLINLINE(uint64_t) iomMmioTraceValue(void const *pvValue, unsigned cbValue)
+{
+    switch (cbValue)
+    {
+        case 1: return *(uint8_t const *)pvValue;
+        case 2: return *(uint16_t const *)pvValue;
+        case 4: return *(uint32_t const *)pvValue;
+        case 8: return *(uint64_t const *)pvValue;
+        default: return 0;
+    }
+}
+
+
 /**
  * Deals with complicated MMIO writes.
  *
@@ -468,6 +490,9 @@ static VBOXSTRICTRC iomMMIODoWrite(PVM pVM, PVMCPU pVCpu, PIOMMMIORANGE pRange,
     }
     else
         rcStrict = VINF_SUCCESS;
+    if (   RT_UNLIKELY(pVCpu->fTraceGroups & DBGFTRACE_GRP_IO)
+        && rcStrict == VINF_SUCCESS)
+        DBGFTraceRingRecord(pVCpu, DBGFTRACEEVT_MMIO_WRITE, cb, GCPhysFault, iomMmioTraceValue(pvData, cb));
 
     STAM_PROFILE_STOP(&pStats->CTX_SUFF_Z(ProfWrite), a);
     STAM_COUNTER_INC(&pStats->Accesses);
@@ -698,6 +723,9 @@ DECLINLINE(VBOXSTRICTRC) iomMMIODoRead(PVM pVM, PVMCPU pVCpu, PIOMMMIORANGE pRan
             case VINF_IOM_MMIO_UNUSED_00: rcStrict = iomMMIODoRead00s(pvValue, cbValue); break;
         }
     }
+    if (   RT_UNLIKELY(pVCpu->fTraceGroups & DBGFTRACE_GRP_IO)
+        && rcStrict == VINF_SUCCESS)
+        DBGFTraceRingRecord(pVCpu, DBGFTRACEEVT_MMIO_READ, cbValue, GCPhys, iomMmioTraceValue(pvValue, cbValue));
 
     STAM_PROFILE_STOP(&pStats->CTX_SUFF_Z(ProfRead), a);
     STAM_COUNTER_INC(&pStats->Accesses);
@@ -736,32 +764,28 @@ DECLINLINE(void) iomMMIOStatLength(PVM pVM, unsigned cb)
 }
 
 
-#ifndef IEM_USE_IEM_INSTEAD
-
 /**
  * MOV      reg, mem         (read)
  * MOVZX    reg, mem         (read)
  * MOVSX    reg, mem         (read)
  *
+ * Worker for iomInterpretMOVxXRead and the decode cache.
+ *
  * @returns VBox status code.
  *
  * @param   pVM         The cross context VM structure.
  * @param   pVCpu       The cross context virtual CPU structure of the calling EMT.
  * @param   pRegFrame   Pointer to CPUMCTXCORE guest registers structure.
- * @param   pCpu        Disassembler CPU state.
+ * @param   uOpcode     The instruction (OP_MOV, OP_MOVZX or OP_MOVSX).
+ * @param   cb          The size of the MMIO read.
+ * @param   pDstParam   The destination register operand.
  * @param   pRange      Pointer MMIO range.
  * @param   GCPhysFault The GC physical address corresponding to pvFault.
  */
-static int iomInterpretMOVxXRead(PVM pVM, PVMCPU pVCpu, PCPUMCTXCORE pRegFrame, PDISCPUSTATE pCpu,
-                                 PIOMMMIORANGE pRange, RTGCPHYS GCPhysFault)
+static int iomMmioMovRead(PVM pVM, PVMCPU pVCpu, PCPUMCTXCORE pRegFrame, uint16_t uOpcode, unsigned cb,
+                          PCDISOPPARAM pDstParam, PIOMMMIORANGE pRange, RTGCPHYS GCPhysFault)
 {
     Assert(pRange->CTX_SUFF(pfnReadCallback) || !pRange->pfnReadCallbackR3);
-
-    /*
-     * Get the data size from parameter 2,
-     * and call the handler function to get the data.
-     */
-    unsigned cb = DISGetParamSize(pCpu, &pCpu->Param2);
     AssertMsg(cb > 0 && cb <= sizeof(uint64_t), ("cb=%d\n", cb));
 
     uint64_t u64Data = 0;
@@ -772,7 +796,7 @@ static int iomInterpretMOVxXRead(PVM pVM, PVMCPU pVCpu, PCPUMCTXCORE pRegFrame,
          * Do sign extension for MOVSX.
          */
         /** @todo checkup MOVSX implementation! */
-        if (pCpu->pCurInstr->uOpcode == OP_MOVSX)
+        if (uOpcode == OP_MOVSX)
         {
             if (cb == 1)
             {
@@ -791,7 +815,7 @@ static int iomInterpretMOVxXRead(PVM pVM, PVMCPU pVCpu, PCPUMCTXCORE pRegFrame,
         /*
          * Store the result to register (parameter 1).
          */
-        bool fRc = iomSaveDataToReg(pCpu, &pCpu->Param1, pRegFrame, u64Data);
+        bool fRc = iomSaveDataToReg(NULL, pDstParam, pRegFrame, u64Data);
         AssertMsg(fRc, ("Failed to store register value!\n")); NOREF(fRc);
     }
 
@@ -804,27 +828,29 @@ static int iomInterpretMOVxXRead(PVM pVM, PVMCPU pVCpu, PCPUMCTXCORE pRegFrame,
 /**
  * MOV      mem, reg|imm     (write)
  *
+ * Worker for iomInterpretMOVxXWrite and the decode cache.
+ *
  * @returns VBox status code.
  *
  * @param   pVM         The cross context VM structure.
  * @param   pVCpu       The cross context virtual CPU structure of the calling EMT.
  * @param   pRegFrame   Pointer to CPUMCTXCORE guest registers structure.
- * @param   pCpu        Disassembler CPU state.
+ * @param   pSrcParam   The source register or immediate operand.
  * @param   pRange      Pointer MMIO range.
  * @param   GCPhysFault The GC physical address corresponding to pvFault.
  */
-static int iomInterpretMOVxXWrite(PVM pVM, PVMCPU pVCpu, PCPUMCTXCORE pRegFrame, PDISCPUSTATE pCpu,
-                                  PIOMMMIORANGE pRange, RTGCPHYS GCPhysFault)
+static int iomMmioMovWrite(PVM pVM, PVMCPU pVCpu, PCPUMCTXCORE pRegFrame, PCDISOPPARAM pSrcParam,
+                           PIOMMMIORANGE pRange, RTGCPHYS GCPhysFault)
 {
     Assert(pRange->CTX_SUFF(pfnWriteCallback) || !pRange->pfnWriteCallbackR3);
 
     /*
-     * Get data to write from second parameter,
+     * Get data to write from the source operand,
      * and call the callback to write it.
      */
     unsigned cb = 0;
     uint64_t u64Data  = 0;
-    bool fRc = iomGetRegImmData(pCpu, &pCpu->Param2, pRegFrame, &u64Data, &cb);
+    bool fRc = iomGetRegImmData(NULL, pSrcParam, pRegFrame, &u64Data, &cb);
     AssertMsg(fRc, ("Failed to get reg/imm port number!\n")); NOREF(fRc);
 
     int rc = VBOXSTRICTRC_TODO(iomMMIODoWrite(pVM, pVCpu, pRange, GCPhysFault, &u64Data, cb));
@@ -834,6 +860,185 @@ static int iomInterpretMOVxXWrite(PVM pVM, PVMCPU pVCpu, PCPUMCTXCORE pRegFrame,
 }
 
 
+/**
+ * Looks up the current instruction in the MMIO decode cache.
+ *
+ * @returns Pointer to the cache entry on hit, NULL on miss.
+ * @param   pVM         The cross context VM structure.
+ * @param   pVCpu       The cross context virtual CPU structure of the calling EMT.
+ * @param   pCtxCore    Trap register frame.
+ * @param   pRange      The MMIO range being accessed.
+ * @param   pGCPtrInstr Where to return the flat address of the instruction,
+ *                      NIL_RTGCPTR if it couldn't be determined or mustn't be
+ *                      cached.
+ */
+static PIOMMMIODECODEENTRY iomMmioDecodeCacheLookup(PVM pVM, PVMCPU pVCpu, PCPUMCTXCORE pCtxCore, PIOMMMIORANGE pRange,
+                                                    PRTGCPTR pGCPtrInstr)
+{
+    *pGCPtrInstr = NIL_RTGCPTR;
+
+    /* A hit just advances RIP.  Single stepping, RF, interrupt shadows and
+       modes where IP wraps or the CS limit applies need the full treatment. */
+    if (pCtxCore->eflags.u32 & (X86_EFL_TF | X86_EFL_RF))
+        return NULL;
+    if (VMCPU_FF_IS_SET(pVCpu, VMCPU_FF_INHIBIT_INTERRUPTS))
+        return NULL;
+    uint8_t const enmCpuMode = (uint8_t)CPUMGetGuestDisMode(pVCpu);
+    if (   enmCpuMode != DISCPUMODE_64BIT
+        && (   enmCpuMode != DISCPUMODE_32BIT
+            || !CPUMSELREG_ARE_HIDDEN_PARTS_VALID(pVCpu, &pCtxCore->cs)
+            || pCtxCore->cs.u64Base  != 0
+            || pCtxCore->cs.u32Limit != UINT32_MAX))
+        return NULL;
+
+    RTGCPTR GCPtrInstr;
+    int rc = SELMValidateAndConvertCSAddr(pVCpu, pCtxCore->eflags, pCtxCore->ss.Sel, pCtxCore->cs.Sel, &pCtxCore->cs,
+                                          pCtxCore->rip, &GCPtrInstr);
+    if (RT_FAILURE(rc))
+        return NULL;
+#ifdef VBOX_WITH_RAW_MODE
+    if (PATMIsPatchGCAddr(pVM, GCPtrInstr))
+        return NULL;
+#else
+    NOREF(pVM);
+#endif
+    *pGCPtrInstr = GCPtrInstr;
+
+    for (unsigned i = 0; i < RT_ELEMENTS(pVCpu->iom.s.aMmioDecodeCache); i++)
+    {
+        PIOMMMIODECODEENTRY pEntry = &pVCpu->iom.s.aMmioDecodeCache[i];
+        if (   pEntry->GCPtrInstr  == GCPtrInstr
+            && pEntry->cbInstr
+            && pEntry->enmCpuMode  == enmCpuMode
+            && pEntry->GCPhysRange == pRange->GCPhys)
+        {
+            if (   enmCpuMode == DISCPUMODE_32BIT
+                && pCtxCore->rip + pEntry->cbInstr > UINT32_MAX)
+                return NULL;
+
+            /* Make sure it's still the same instruction (code may have been
+               replaced or remapped since). */
+            uint8_t abInstr[sizeof(pEntry->abInstr)];
+            rc = PGMPhysSimpleReadGCPtr(pVCpu, abInstr, GCPtrInstr, pEntry->cbInstr);
+            if (   RT_SUCCESS(rc)
+                && !memcmp(abInstr, pEntry->abInstr, pEntry->cbInstr))
+                return pEntry;
+            pEntry->cbInstr = 0;
+            break;
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * Adds a decoded MOV, MOVZX or MOVSX instruction to the MMIO decode cache.
+ *
+ * Instructions whose register operand isn't a plain general register or
+ * immediate are ignored.
+ *
+ * @param   pVCpu       The cross context virtual CPU structure of the calling EMT.
+ * @param   pDis        The disassembler state of the instruction.
+ * @param   cbInstr     The instruction length.
+ * @param   pRange      The MMIO range being accessed.
+ */
+static void iomMmioDecodeCacheInsert(PVMCPU pVCpu, PDISCPUSTATE pDis, unsigned cbInstr, PIOMMMIORANGE pRange)
+{
+    bool const         fWrite    = DISUSE_IS_EFFECTIVE_ADDR(pDis->Param1.fUse);
+    PCDISOPPARAM const pRegParam = fWrite ? &pDis->Param2 : &pDis->Param1;
+    uint64_t const     fRegUse   = pRegParam->fUse;
+    if (   (fRegUse & (DISUSE_BASE | DISUSE_INDEX | DISUSE_SCALE | DISUSE_DISPLACEMENT8 | DISUSE_DISPLACEMENT16
+                       | DISUSE_DISPLACEMENT32 | DISUSE_DISPLACEMENT64 | DISUSE_RIPDISPLACEMENT32))
+        || !(fRegUse & (  DISUSE_REG_GEN8 | DISUSE_REG_GEN16 | DISUSE_REG_GEN32 | DISUSE_REG_GEN64
+                        | (fWrite ? DISUSE_IMMEDIATE : 0)))
+        || cbInstr > sizeof(pVCpu->iom.s.aMmioDecodeCache[0].abInstr)
+        || !DISUSE_IS_EFFECTIVE_ADDR(fWrite ? pDis->Param1.fUse : pDis->Param2.fUse))
+        return;
+
+    PIOMMMIODECODEENTRY pEntry = &pVCpu->iom.s.aMmioDecodeCache[  pVCpu->iom.s.iMmioDecodeNext++
+                                                                 % RT_ELEMENTS(pVCpu->iom.s.aMmioDecodeCache)];
+    pEntry->GCPtrInstr  = pDis->uInstrAddr;
+    pEntry->GCPhysRange = pRange->GCPhys;
+    pEntry->fRegUse     = fRegUse;
+    pEntry->uImmValue   = pRegParam->uValue;
+    memcpy(pEntry->abInstr, pDis->abInstr, cbInstr);
+    pEntry->cbInstr     = (uint8_t)cbInstr;
+    pEntry->uOpcode     = pDis->pCurInstr->uOpcode;
+    pEntry->enmCpuMode  = pDis->uCpuMode;
+    pEntry->fWrite      = fWrite;
+    pEntry->cbRead      = fWrite ? 0 : (uint8_t)DISGetParamSize(pDis, &pDis->Param2);
+    pEntry->idxGenReg   = pRegParam->Base.idxGenReg;
+}
+
+
+/**
+ * Emulates an instruction found in the MMIO decode cache.
+ *
+ * @returns VBox status code.
+ * @param   pVM         The cross context VM structure.
+ * @param   pVCpu       The cross context virtual CPU structure of the calling EMT.
+ * @param   pCtxCore    Trap register frame.
+ * @param   pEntry      The cache entry.
+ * @param   pRange      The MMIO range being accessed.
+ * @param   GCPhysFault The GC physical address being accessed.
+ */
+static int iomMmioDecodeCacheExec(PVM pVM, PVMCPU pVCpu, PCPUMCTXCORE pCtxCore, PIOMMMIODECODEENTRY pEntry,
+                                  PIOMMMIORANGE pRange, RTGCPHYS GCPhysFault)
+{
+    DISOPPARAM RegParam;
+    RT_ZERO(RegParam);
+    RegParam.fUse           = pEntry->fRegUse;
+    RegParam.uValue         = pEntry->uImmValue;
+    RegParam.Base.idxGenReg = pEntry->idxGenReg;
+    if (pEntry->fWrite)
+        return iomMmioMovWrite(pVM, pVCpu, pCtxCore, &RegParam, pRange, GCPhysFault);
+    return iomMmioMovRead(pVM, pVCpu, pCtxCore, pEntry->uOpcode, pEntry->cbRead, &RegParam, pRange, GCPhysFault);
+}
+
+
+#ifndef IEM_USE_IEM_INSTEAD
+
+/**
+ * MOV      reg, mem         (read)
+ * MOVZX    reg, mem         (read)
+ * MOVSX    reg, mem         (read)
+ *
+ * @returns VBox status code.
+ *
+ * @param   pVM         The cross context VM structure.
+ * @param   pVCpu       The cross context virtual CPU structure of the calling EMT.
+ * @param   pRegFrame   Pointer to CPUMCTXCORE guest registers structure.
+ * @param   pCpu        Disassembler CPU state.
+ * @param   pRange      Pointer MMIO range.
+ * @param   GCPhysFault The GC physical address corresponding to pvFault.
+ */
+static int iomInterpretMOVxXRead(PVM pVM, PVMCPU pVCpu, PCPUMCTXCORE pRegFrame, PDISCPUSTATE pCpu,
+                                 PIOMMMIORANGE pRange, RTGCPHYS GCPhysFault)
+{
+    return iomMmioMovRead(pVM, pVCpu, pRegFrame, pCpu->pCurInstr->uOpcode, DISGetParamSize(pCpu, &pCpu->Param2),
+                          &pCpu->Param1, pRange, GCPhysFault);
+}
+
+
+/**
+ * MOV      mem, reg|imm     (write)
+ *
+ * @returns VBox status code.
+ *
+ * @param   pVM         The cross context VM structure.
+ * @param   pVCpu       The cross context virtual CPU structure of the calling EMT.
+ * @param   pRegFrame   Pointer to CPUMCTXCORE guest registers structure.
+ * @param   pCpu        Disassembler CPU state.
+ * @param   pRange      Pointer MMIO range.
+ * @param   GCPhysFault The GC physical address corresponding to pvFault.
+ */
+static int iomInterpretMOVxXWrite(PVM pVM, PVMCPU pVCpu, PCPUMCTXCORE pRegFrame, PDISCPUSTATE pCpu,
+                                  PIOMMMIORANGE pRange, RTGCPHYS GCPhysFault)
+{
+    return iomMmioMovWrite(pVM, pVCpu, pRegFrame, &pCpu->Param2, pRange, GCPhysFault);
+}
+
+
 /** Wrapper for reading virtual memory. */
 DECLINLINE(int) iomRamRead(PVMCPU pVCpu, void *pDest, RTGCPTR GCSrc, uint32_t cb)
 {
@@ -1754,14 +1959,69 @@ static VBOXSTRICTRC iomMmioCommonPfHandler(PVM pVM, PVMCPU pVCpu, uint32_t uErro
         return rc;
     }
 
+    /*
+     * Try the decode cache first.  Drivers tend to poke the same registers
+     * from the same few instructions over and over again.
+     */
+    RTGCPTR             GCPtrInstr;
+    PIOMMMIODECODEENTRY pEntry = iomMmioDecodeCacheLookup(pVM, pVCpu, pCtxCore, pRange, &GCPtrInstr);
+    if (pEntry)
+    {
+        STAM_REL_COUNTER_INC(&pVM->iom.s.StatMmioDecodeCacheHits);
+        STAM_PROFILE_START(&pVM->iom.s.StatRZInstMov, b);
+        AssertMsg(uErrorCode == UINT32_MAX || pEntry->fWrite == !!(uErrorCode & X86_TRAP_PF_RW),
+                  ("fWrite=%RTbool ErrCd=%#x\n", pEntry->fWrite, uErrorCode));
+        rc = iomMmioDecodeCacheExec(pVM, pVCpu, pCtxCore, pEntry, pRange, GCPhysFault);
+        STAM_PROFILE_STOP(&pVM->iom.s.StatRZInstMov, b);
+        if (rc == VINF_SUCCESS)
+            pCtxCore->rip += pEntry->cbInstr; /* The lookup ruled out wrapping, TF, RF and shadows. */
+        else
+        {
+            STAM_COUNTER_INC(&pVM->iom.s.StatRZMMIOFailures);
+#if defined(VBOX_WITH_STATISTICS) && !defined(IN_RING3)
+            if (pEntry->fWrite)
+                STAM_COUNTER_INC(&pStats->CTX_MID_Z(Write,ToR3));
+            else
+                STAM_COUNTER_INC(&pStats->CTX_MID_Z(Read,ToR3));
+#endif
+        }
+
+        STAM_PROFILE_STOP(&pVM->iom.s.StatRZMMIOHandler, a);
+        PDMCritSectLeave(pDevIns->CTX_SUFF(pCritSectRo));
+        iomMmioReleaseRange(pVM, pRange);
+        return rc;
+    }
+    STAM_REL_COUNTER_INC(&pVM->iom.s.StatMmioDecodeCacheMisses);
+
 #ifdef IEM_USE_IEM_INSTEAD
 
+    /*
+     * IEM doesn't hand out its decoding, so we only spend a disassembly on
+     * instructions that miss twice in a row and are thus likely to be back.
+     */
+    if (GCPtrInstr != NIL_RTGCPTR)
+    {
+        if (GCPtrInstr == pVCpu->iom.s.GCPtrMmioDecodeLastMiss)
+        {
+            PDISCPUSTATE pDis = &pVCpu->iom.s.DisState;
+            unsigned     cbOp;
+            rc = EMInterpretDisasOneEx(pVM, pVCpu, GCPtrInstr, pCtxCore, pDis, &cbOp);
+            if (   RT_SUCCESS(rc)
+                && (   pDis->pCurInstr->uOpcode == OP_MOV
+                    || pDis->pCurInstr->uOpcode == OP_MOVZX
+                    || pDis->pCurInstr->uOpcode == OP_MOVSX))
+                iomMmioDecodeCacheInsert(pVCpu, pDis, cbOp, pRange);
+            pVCpu->iom.s.GCPtrMmioDecodeLastMiss = NIL_RTGCPTR;
+        }
+        else
+            pVCpu->iom.s.GCPtrMmioDecodeLastMiss = GCPtrInstr;
+    }
+
     /*
      * Let IEM call us back via iomMmioHandler.
      */
     VBOXSTRICTRC rcStrict = IEMExecOne(pVCpu);
 
-    NOREF(pCtxCore); NOREF(GCPhysFault);
     STAM_PROFILE_STOP(&pVM->iom.s.StatRZMMIOHandler, a);
     PDMCritSectLeave(pDevIns->CTX_SUFF(pCritSectRo));
     iomMmioReleaseRange(pVM, pRange);
@@ -1804,6 +2064,8 @@ static VBOXSTRICTRC iomMmioCommonPfHandler(PVM pVM, PVMCPU pVCpu, uint32_t uErro
             else
                 rc = iomInterpretMOVxXRead(pVM, pVCpu, pCtxCore, pDis, pRange, GCPhysFault);
             STAM_PROFILE_STOP(&pVM->iom.s.StatRZInstMov, b);
+            if (rc == VINF_SUCCESS && GCPtrInstr != NIL_RTGCPTR)
+                iomMmioDecodeCacheInsert(pVCpu, pDis, cbOp, pRange);
             break;
         }
 
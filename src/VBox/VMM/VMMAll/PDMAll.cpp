@@ -23,6 +23,7 @@
 #include "PDMInternal.h"
 #include <VBox/vmm/pdm.h>
 #include <VBox/vmm/mm.h>
+#include <VBox/vmm/dbgftrace.h>
 #include <VBox/vmm/vm.h>
 #include <VBox/err.h>
 
@@ -64,6 +65,7 @@ VMMDECL(int) PDMGetInterrupt(PVMCPU pVCpu, uint8_t *pu8Interrupt)
             pdmUnlock(pVM);
             *pu8Interrupt = (uint8_t)i;
             VBOXVMM_PDM_IRQ_GET(pVCpu, RT_LOWORD(uTagSrc), RT_HIWORD(uTagSrc), i);
+            DBGFTRACE_RING_EVT(pVCpu, DBGFTRACE_GRP_IRQ, DBGFTRACEEVT_IRQ, i, uTagSrc, 1 /*APIC*/);
             return VINF_SUCCESS;
         }
     }
@@ -84,6 +86,7 @@ VMMDECL(int) PDMGetInterrupt(PVMCPU pVCpu, uint8_t *pu8Interrupt)
             pdmUnlock(pVM);
             *pu8Interrupt = (uint8_t)i;
             VBOXVMM_PDM_IRQ_GET(pVCpu, RT_LOWORD(uTagSrc), RT_HIWORD(uTagSrc), i);
+            DBGFTRACE_RING_EVT(pVCpu, DBGFTRACE_GRP_IRQ, DBGFTRACEEVT_IRQ, i, uTagSrc, 0 /*PIC*/);
             return VINF_SUCCESS;
         }
     }
@@ -40,16 +40,14 @@
 # include <iprt/thread.h>
 #endif
 
+#include "PDMInline.h"
+
 
 /*********************************************************************************************************************************
 *   Defined Constants And Macros                                                                                                 *
 *********************************************************************************************************************************/
-/** The number loops to spin for in ring-3. */
-#define PDMCRITSECT_SPIN_COUNT_R3       20
-/** The number loops to spin for in ring-0. */
-#define PDMCRITSECT_SPIN_COUNT_R0       256
-/** The number loops to spin for in the raw-mode context. */
-#define PDMCRITSECT_SPIN_COUNT_RC       256
+/** How often (in pause iterations) to check the spin budget and the owner. */
+#define PDMCRITSECT_SPIN_CHECK_MASK     15
 
 
 /* Undefine the automatic VBOX_STRICT API mappings. */
@@ -79,6 +77,141 @@ DECL_FORCE_INLINE(RTNATIVETHREAD) pdmCritSectGetNativeSelf(PCPDMCRITSECT pCritSe
 }
 
 
+/**
+ * Gets a critical section profiler record.
+ *
+ * @returns Pointer to the record, NULL if the index is bad.
+ * @param   pVM             The cross context VM structure.
+ * @param   idxProf         The 1-based record index from the critical section.
+ */
+DECLINLINE(PPDMCRITSECTPROF) pdmCritSectProfGet(PVM pVM, uint32_t idxProf)
+{
+    AssertReturn(idxProf - 1 < pVM->pdm.s.cCritSectProfs, NULL);
+    return &pVM->pdm.s.CTX_SUFF(paCritSectProfs)[idxProf - 1];
+}
+
+
+/**
+ * Calculates the histogram bucket for a tick count.
+ *
+ * @returns Bucket index.
+ * @param   cTicks          The sample.
+ */
+DECLINLINE(unsigned) pdmCritSectProfBucket(uint64_t cTicks)
+{
+    unsigned iBucket = cTicks ? (ASMBitLastSetU64(cTicks) - 1) / 2 : 0;
+    return RT_MIN(iBucket, PDMCRITSECTPROF_HIST_BUCKETS - 1);
+}
+
+
+/**
+ * Atomically raises a maximum.
+ *
+ * @param   pcTicksMax      The maximum to update.
+ * @param   cTicks          The new sample.
+ */
+DECLINLINE(void) pdmCritSectProfUpdateMax(uint64_t volatile *pcTicksMax, uint64_t cTicks)
+{
+    uint64_t cTicksMax;
+    while ((cTicksMax = ASMAtomicReadU64(pcTicksMax)) < cTicks)
+        if (ASMAtomicCmpXchgU64(pcTicksMax, cTicks, cTicksMax))
+            break;
+}
+
+
+/**
+ * Profiler: Notes that the calling thread just became the exclusive owner.
+ *
+ * @param   pVM             The cross context VM structure.
+ * @param   idxProf         The profiler record index.
+ */
+void pdmCritSectProfOwned(PVM pVM, uint32_t idxProf)
+{
+    PPDMCRITSECTPROF pProf = pdmCritSectProfGet(pVM, idxProf);
+    if (pProf)
+        ASMAtomicWriteU64(&pProf->tsOwned, ASMReadTSC());
+}
+
+
+/**
+ * Profiler: Samples the hold time as the exclusive owner lets go.
+ *
+ * @param   pVM             The cross context VM structure.
+ * @param   idxProf         The profiler record index.
+ */
+void pdmCritSectProfReleased(PVM pVM, uint32_t idxProf)
+{
+    PPDMCRITSECTPROF pProf = pdmCritSectProfGet(pVM, idxProf);
+    uint64_t tsOwned;
+    if (   pProf
+        && (tsOwned = ASMAtomicReadU64(&pProf->tsOwned)) != 0) /* zero if profiling started while owned */
+    {
+        uint64_t cTicks = ASMReadTSC() - tsOwned;
+        if ((int64_t)cTicks < 0) /* TSC not synchronized between CPUs. */
+            cTicks = 0;
+        ASMAtomicIncU64(&pProf->cHolds);
+        ASMAtomicAddU64(&pProf->cTicksHoldTotal, cTicks);
+        pdmCritSectProfUpdateMax(&pProf->cTicksHoldMax, cTicks);
+        ASMAtomicIncU64(&pProf->acHoldHist[pdmCritSectProfBucket(cTicks)]);
+    }
+}
+
+
+/**
+ * Profiler: Records a contended enter attempt.
+ *
+ * @param   pVM             The cross context VM structure.
+ * @param   idxProf         The profiler record index.
+ * @param   cTicksWait      How long the caller waited.
+ * @param   uCaller         The return address of the enter call.
+ * @param   fBusy           Set if the caller gave up (try-enter or rcBusy)
+ *                          rather than getting the section.
+ */
+void pdmCritSectProfContended(PVM pVM, uint32_t idxProf, uint64_t cTicksWait, RTHCUINTPTR uCaller, bool fBusy)
+{
+    PPDMCRITSECTPROF pProf = pdmCritSectProfGet(pVM, idxProf);
+    if (!pProf)
+        return;
+    if ((int64_t)cTicksWait < 0)
+        cTicksWait = 0;
+
+    ASMAtomicIncU64(&pProf->cContentions);
+    if (fBusy)
+        ASMAtomicIncU64(&pProf->cBusy);
+    else
+    {
+        ASMAtomicAddU64(&pProf->cTicksWaitTotal, cTicksWait);
+        pdmCritSectProfUpdateMax(&pProf->cTicksWaitMax, cTicksWait);
+        ASMAtomicIncU64(&pProf->acWaitHist[pdmCritSectProfBucket(cTicksWait)]);
+    }
+
+    /*
+     * Account it to the call site.  When the site isn't in the table, it takes
+     * over the least contended entry including its count (space-saving), so
+     * frequent sites will stick while the odd one-offs get rotated out.
+     */
+    uint32_t const         enmCtx = PDMCRITSECTPROF_CTX_CUR;
+    PPDMCRITSECTPROFCALLER pMin   = &pProf->aCallers[0];
+    for (unsigned i = 0; i < RT_ELEMENTS(pProf->aCallers); i++)
+    {
+        PPDMCRITSECTPROFCALLER pCur = &pProf->aCallers[i];
+        if (   pCur->uCaller == uCaller
+            && pCur->enmCtx  == enmCtx)
+        {
+            ASMAtomicIncU32(&pCur->cContentions);
+            ASMAtomicAddU64(&pCur->cTicksWait, cTicksWait);
+            return;
+        }
+        if (pCur->cContentions < pMin->cContentions)
+            pMin = pCur;
+    }
+    ASMAtomicWriteU64(&pMin->uCaller, uCaller);
+    ASMAtomicWriteU32(&pMin->enmCtx, enmCtx);
+    ASMAtomicIncU32(&pMin->cContentions);
+    ASMAtomicAddU64(&pMin->cTicksWait, cTicksWait);
+}
+
+
 /**
  * Tail code called when we've won the battle for the lock.
  *
@@ -104,6 +237,8 @@ DECL_FORCE_INLINE(int) pdmCritSectEnterFirst(PPDMCRITSECT pCritSect, RTNATIVETHR
 # endif
 
     STAM_PROFILE_ADV_START(&pCritSect->s.StatLocked, l);
+    if (RT_UNLIKELY(pCritSect->s.idxProf))
+        pdmCritSectProfOwned(pCritSect->s.CTX_SUFF(pVM), pCritSect->s.idxProf);
     return VINF_SUCCESS;
 }
 
@@ -135,8 +270,10 @@ static int pdmR3R0CritSectEnterContended(PPDMCRITSECT pCritSect, RTNATIVETHREAD
     /*
      * The wait loop.
      */
-    PSUPDRVSESSION  pSession    = pCritSect->s.CTX_SUFF(pVM)->pSession;
+    PVM             pVM         = pCritSect->s.CTX_SUFF(pVM);
+    PSUPDRVSESSION  pSession    = pVM->pSession;
     SUPSEMEVENT     hEvent      = (SUPSEMEVENT)pCritSect->s.Core.EventSem;
+    PVMCPU          pVCpu       = VMMGetCpu(pVM); /* NULL if not EMT */
 # ifdef IN_RING3
 #  ifdef PDMCRITSECT_STRICT
     RTTHREAD        hThreadSelf = RTThreadSelfAutoAdopt();
@@ -169,11 +306,15 @@ static int pdmR3R0CritSectEnterContended(PPDMCRITSECT pCritSect, RTNATIVETHREAD
 #  else
         RTThreadBlocking(hThreadSelf, RTTHREADSTATE_CRITSECT, true);
 #  endif
+# endif
+        if (pVCpu)
+            ASMAtomicWriteBool(&pVCpu->pdm.s.fBlockedOnCritSect, true);
         int rc = SUPSemEventWaitNoResume(pSession, hEvent, RT_INDEFINITE_WAIT);
+        if (pVCpu)
+            ASMAtomicWriteBool(&pVCpu->pdm.s.fBlockedOnCritSect, false);
+# ifdef IN_RING3
         RTThreadUnblocked(hThreadSelf, RTTHREADSTATE_CRITSECT);
-# else  /* IN_RING0 */
-        int rc = SUPSemEventWaitNoResume(pSession, hEvent, RT_INDEFINITE_WAIT);
-# endif /* IN_RING0 */
+# endif
 
         /*
          * Deal with the return code and critsect destruction.
@@ -191,8 +332,7 @@ static int pdmR3R0CritSectEnterContended(PPDMCRITSECT pCritSect, RTNATIVETHREAD
            Note! We've incremented cLockers already and cannot safely decrement
                  it without creating a race with PDMCritSectLeave, resulting in
                  spurious wakeups. */
-        PVM     pVM   = pCritSect->s.CTX_SUFF(pVM); AssertPtr(pVM);
-        PVMCPU  pVCpu = VMMGetCpu(pVM);             AssertPtr(pVCpu);
+        AssertPtr(pVCpu);
         rc = VMMRZCallRing3(pVM, pVCpu, VMMCALLRING3_VM_R0_PREEMPT, NULL);
         AssertRC(rc);
 # endif
@@ -203,7 +343,8 @@ static int pdmR3R0CritSectEnterContended(PPDMCRITSECT pCritSect, RTNATIVETHREAD
 
 
 /**
- * Common worker for the debug and normal APIs.
+ * Deals with the contended case: spins adaptively before blocking (ring-3 and
+ * ring-0) or giving up (raw-mode and ring-0 with preemption disabled).
  *
  * @returns VINF_SUCCESS if entered successfully.
  * @returns rcBusy when encountering a busy critical section in GC/R0.
@@ -212,57 +353,45 @@ static int pdmR3R0CritSectEnterContended(PPDMCRITSECT pCritSect, RTNATIVETHREAD
  *
  * @param   pCritSect           The PDM critical section to enter.
  * @param   rcBusy              The status code to return when we're in GC or R0
+ * @param   hNativeSelf         The native handle of this thread.
  * @param   pSrcPos             The source position of the lock operation.
  */
-DECL_FORCE_INLINE(int) pdmCritSectEnter(PPDMCRITSECT pCritSect, int rcBusy, PCRTLOCKVALSRCPOS pSrcPos)
+DECL_FORCE_INLINE(int) pdmCritSectEnterSpinAndWait(PPDMCRITSECT pCritSect, int rcBusy, RTNATIVETHREAD hNativeSelf,
+                                                   PCRTLOCKVALSRCPOS pSrcPos)
 {
-    Assert(pCritSect->s.Core.cNestings < 8);  /* useful to catch incorrect locking */
-    Assert(pCritSect->s.Core.cNestings >= 0);
-
-    /*
-     * If the critical section has already been destroyed, then inform the caller.
-     */
-    AssertMsgReturn(pCritSect->s.Core.u32Magic == RTCRITSECT_MAGIC,
-                    ("%p %RX32\n", pCritSect, pCritSect->s.Core.u32Magic),
-                    VERR_SEM_DESTROYED);
-
-    /*
-     * See if we're lucky.
-     */
-    /* NOP ... */
-    if (pCritSect->s.Core.fFlags & RTCRITSECT_FLAGS_NOP)
-        return VINF_SUCCESS;
-
-    RTNATIVETHREAD hNativeSelf = pdmCritSectGetNativeSelf(pCritSect);
-    /* ... not owned ... */
-    if (ASMAtomicCmpXchgS32(&pCritSect->s.Core.cLockers, 0, -1))
-        return pdmCritSectEnterFirst(pCritSect, hNativeSelf, pSrcPos);
-
-    /* ... or nested. */
-    if (pCritSect->s.Core.NativeThreadOwner == hNativeSelf)
-    {
-        ASMAtomicIncS32(&pCritSect->s.Core.cLockers);
-        ASMAtomicIncS32(&pCritSect->s.Core.cNestings);
-        Assert(pCritSect->s.Core.cNestings > 1);
-        return VINF_SUCCESS;
-    }
-
     /*
-     * Spin for a bit without incrementing the counter.
+     * Spin without incrementing the counter for as long as the owner appears to
+     * be running and we're within the budget learned from earlier spins.  When
+     * the owner is halted or blocked it won't be letting go any time soon, so
+     * we go straight to the slow path.
      */
-    /** @todo Move this to cfgm variables since it doesn't make sense to spin on UNI
-     *        cpu systems. */
-    int32_t cSpinsLeft = CTX_SUFF(PDMCRITSECT_SPIN_COUNT_);
-    while (cSpinsLeft-- > 0)
+    PVM pVM = pCritSect->s.CTX_SUFF(pVM);
+    if (pdmCritSectIsOwnerRunning(pVM, pCritSect->s.Core.NativeThreadOwner))
     {
-        if (ASMAtomicCmpXchgS32(&pCritSect->s.Core.cLockers, 0, -1))
-            return pdmCritSectEnterFirst(pCritSect, hNativeSelf, pSrcPos);
-        ASMNopPause();
-        /** @todo Should use monitor/mwait on e.g. &cLockers here, possibly with a
-           cli'ed pendingpreemption check up front using sti w/ instruction fusing
-           for avoiding races. Hmm ... This is assuming the other party is actually
-           executing code on another CPU ... which we could keep track of if we
-           wanted. */
+        uint64_t const tsStart      = ASMReadTSC();
+        uint64_t const cTicksBudget = pdmCritSectSpinBudget(pCritSect->s.cTicksSpin, CTX_SUFF(PDMCRITSECT_SPIN_TICKS_MAX_));
+        for (uint32_t iLoop = 0; ; iLoop++)
+        {
+            if (ASMAtomicCmpXchgS32(&pCritSect->s.Core.cLockers, 0, -1))
+            {
+                pdmCritSectSpinUpdate(&pCritSect->s.cTicksSpin, ASMReadTSC() - tsStart, true /*fSuccess*/);
+                return pdmCritSectEnterFirst(pCritSect, hNativeSelf, pSrcPos);
+            }
+            ASMNopPause();
+            /** @todo Should use monitor/mwait on e.g. &cLockers here, possibly with a
+               cli'ed pendingpreemption check up front using sti w/ instruction fusing
+               for avoiding races. */
+            if ((iLoop & PDMCRITSECT_SPIN_CHECK_MASK) == PDMCRITSECT_SPIN_CHECK_MASK)
+            {
+                if (ASMReadTSC() - tsStart >= cTicksBudget)
+                {
+                    pdmCritSectSpinUpdate(&pCritSect->s.cTicksSpin, cTicksBudget, false /*fSuccess*/);
+                    break;
+                }
+                if (!pdmCritSectIsOwnerRunning(pVM, pCritSect->s.Core.NativeThreadOwner))
+                    break;
+            }
+        }
     }
 
 #ifdef IN_RING3
@@ -326,7 +455,7 @@ DECL_FORCE_INLINE(int) pdmCritSectEnter(PPDMCRITSECT pCritSect, int rcBusy, PCRT
      */
     if (rcBusy == VINF_SUCCESS)
     {
-        PVM     pVM   = pCritSect->s.CTX_SUFF(pVM); AssertPtr(pVM);
+        AssertPtr(pVM);
         PVMCPU  pVCpu = VMMGetCpu(pVM);             AssertPtr(pVCpu);
         return VMMRZCallRing3(pVM, pVCpu, VMMCALLRING3_PDM_CRIT_SECT_ENTER, MMHyperCCToR3(pVM, pCritSect));
     }
@@ -340,6 +469,67 @@ DECL_FORCE_INLINE(int) pdmCritSectEnter(PPDMCRITSECT pCritSect, int rcBusy, PCRT
 }
 
 
+/**
+ * Common worker for the debug and normal APIs.
+ *
+ * @returns VINF_SUCCESS if entered successfully.
+ * @returns rcBusy when encountering a busy critical section in GC/R0.
+ * @retval  VERR_SEM_DESTROYED if the critical section is delete before or
+ *          during the operation.
+ *
+ * @param   pCritSect           The PDM critical section to enter.
+ * @param   rcBusy              The status code to return when we're in GC or R0
+ * @param   pSrcPos             The source position of the lock operation.
+ * @param   uCaller             The return address of the API call, for the
+ *                              contention profiler.
+ */
+DECL_FORCE_INLINE(int) pdmCritSectEnter(PPDMCRITSECT pCritSect, int rcBusy, PCRTLOCKVALSRCPOS pSrcPos, RTHCUINTPTR uCaller)
+{
+    Assert(pCritSect->s.Core.cNestings < 8);  /* useful to catch incorrect locking */
+    Assert(pCritSect->s.Core.cNestings >= 0);
+
+    /*
+     * If the critical section has already been destroyed, then inform the caller.
+     */
+    AssertMsgReturn(pCritSect->s.Core.u32Magic == RTCRITSECT_MAGIC,
+                    ("%p %RX32\n", pCritSect, pCritSect->s.Core.u32Magic),
+                    VERR_SEM_DESTROYED);
+
+    /*
+     * See if we're lucky.
+     */
+    /* NOP ... */
+    if (pCritSect->s.Core.fFlags & RTCRITSECT_FLAGS_NOP)
+        return VINF_SUCCESS;
+
+    RTNATIVETHREAD hNativeSelf = pdmCritSectGetNativeSelf(pCritSect);
+    /* ... not owned ... */
+    if (ASMAtomicCmpXchgS32(&pCritSect->s.Core.cLockers, 0, -1))
+        return pdmCritSectEnterFirst(pCritSect, hNativeSelf, pSrcPos);
+
+    /* ... or nested. */
+    if (pCritSect->s.Core.NativeThreadOwner == hNativeSelf)
+    {
+        ASMAtomicIncS32(&pCritSect->s.Core.cLockers);
+        ASMAtomicIncS32(&pCritSect->s.Core.cNestings);
+        Assert(pCritSect->s.Core.cNestings > 1);
+        return VINF_SUCCESS;
+    }
+
+    /*
+     * Contended.  Time the wait if this section is being profiled.
+     */
+    uint32_t const idxProf = pCritSect->s.idxProf;
+    if (RT_LIKELY(!idxProf))
+        return pdmCritSectEnterSpinAndWait(pCritSect, rcBusy, hNativeSelf, pSrcPos);
+
+    uint64_t const tsStart = ASMReadTSC();
+    int rc = pdmCritSectEnterSpinAndWait(pCritSect, rcBusy, hNativeSelf, pSrcPos);
+    pdmCritSectProfContended(pCritSect->s.CTX_SUFF(pVM), idxProf, ASMReadTSC() - tsStart, uCaller, rc != VINF_SUCCESS);
+    return rc;
+}
+
+
 /**
  * Enters a PDM critical section.
  *
@@ -357,10 +547,10 @@ DECL_FORCE_INLINE(int) pdmCritSectEnter(PPDMCRITSECT pCritSect, int rcBusy, PCRT
 VMMDECL(int) PDMCritSectEnter(PPDMCRITSECT pCritSect, int rcBusy)
 {
 #ifndef PDMCRITSECT_STRICT
-    return pdmCritSectEnter(pCritSect, rcBusy, NULL);
+    return pdmCritSectEnter(pCritSect, rcBusy, NULL, (RTHCUINTPTR)ASMReturnAddress());
 #else
     RTLOCKVALSRCPOS SrcPos = RTLOCKVALSRCPOS_INIT_NORMAL_API();
-    return pdmCritSectEnter(pCritSect, rcBusy, &SrcPos);
+    return pdmCritSectEnter(pCritSect, rcBusy, &SrcPos, (RTHCUINTPTR)ASMReturnAddress());
 #endif
 }
 
@@ -387,10 +577,10 @@ VMMDECL(int) PDMCritSectEnterDebug(PPDMCRITSECT pCritSect, int rcBusy, RTHCUINTP
 {
 #ifdef PDMCRITSECT_STRICT
     RTLOCKVALSRCPOS SrcPos = RTLOCKVALSRCPOS_INIT_DEBUG_API();
-    return pdmCritSectEnter(pCritSect, rcBusy, &SrcPos);
+    return pdmCritSectEnter(pCritSect, rcBusy, &SrcPos, uId ? uId : (RTHCUINTPTR)ASMReturnAddress());
 #else
-    NOREF(uId); RT_SRC_POS_NOREF();
-    return pdmCritSectEnter(pCritSect, rcBusy, NULL);
+    RT_SRC_POS_NOREF();
+    return pdmCritSectEnter(pCritSect, rcBusy, NULL, uId ? uId : (RTHCUINTPTR)ASMReturnAddress());
 #endif
 }
 
@@ -406,8 +596,10 @@ VMMDECL(int) PDMCritSectEnterDebug(PPDMCRITSECT pCritSect, int rcBusy, RTHCUINTP
  *
  * @param   pCritSect   The critical section.
  * @param   pSrcPos     The source position of the lock operation.
+ * @param   uCaller     The return address of the API call, for the
+ *                      contention profiler.
  */
-static int pdmCritSectTryEnter(PPDMCRITSECT pCritSect, PCRTLOCKVALSRCPOS pSrcPos)
+static int pdmCritSectTryEnter(PPDMCRITSECT pCritSect, PCRTLOCKVALSRCPOS pSrcPos, RTHCUINTPTR uCaller)
 {
     /*
      * If the critical section has already been destroyed, then inform the caller.
@@ -447,6 +639,8 @@ static int pdmCritSectTryEnter(PPDMCRITSECT pCritSect, PCRTLOCKVALSRCPOS pSrcPos
 #else
     STAM_REL_COUNTER_INC(&pCritSect->s.StatContentionRZLock);
 #endif
+    if (RT_UNLIKELY(pCritSect->s.idxProf))
+        pdmCritSectProfContended(pCritSect->s.CTX_SUFF(pVM), pCritSect->s.idxProf, 0, uCaller, true /*fBusy*/);
     LogFlow(("PDMCritSectTryEnter: locked\n"));
     return VERR_SEM_BUSY;
 }
@@ -466,10 +660,10 @@ static int pdmCritSectTryEnter(PPDMCRITSECT pCritSect, PCRTLOCKVALSRCPOS pSrcPos
 VMMDECL(int) PDMCritSectTryEnter(PPDMCRITSECT pCritSect)
 {
 #ifndef PDMCRITSECT_STRICT
-    return pdmCritSectTryEnter(pCritSect, NULL);
+    return pdmCritSectTryEnter(pCritSect, NULL, (RTHCUINTPTR)ASMReturnAddress());
 #else
     RTLOCKVALSRCPOS SrcPos = RTLOCKVALSRCPOS_INIT_NORMAL_API();
-    return pdmCritSectTryEnter(pCritSect, &SrcPos);
+    return pdmCritSectTryEnter(pCritSect, &SrcPos, (RTHCUINTPTR)ASMReturnAddress());
 #endif
 }
 
@@ -493,10 +687,10 @@ VMMDECL(int) PDMCritSectTryEnterDebug(PPDMCRITSECT pCritSect, RTHCUINTPTR uId, R
 {
 #ifdef PDMCRITSECT_STRICT
     RTLOCKVALSRCPOS SrcPos = RTLOCKVALSRCPOS_INIT_DEBUG_API();
-    return pdmCritSectTryEnter(pCritSect, &SrcPos);
+    return pdmCritSectTryEnter(pCritSect, &SrcPos, uId ? uId : (RTHCUINTPTR)ASMReturnAddress());
 #else
-    NOREF(uId); RT_SRC_POS_NOREF();
-    return pdmCritSectTryEnter(pCritSect, NULL);
+    RT_SRC_POS_NOREF();
+    return pdmCritSectTryEnter(pCritSect, NULL, uId ? uId : (RTHCUINTPTR)ASMReturnAddress());
 #endif
 }
 
@@ -596,6 +790,8 @@ VMMDECL(int) PDMCritSectLeave(PPDMCRITSECT pCritSect)
         Assert(pCritSect->s.Core.cNestings == 0);
 
         /* stop and decrement lockers. */
+        if (RT_UNLIKELY(pCritSect->s.idxProf))
+            pdmCritSectProfReleased(pCritSect->s.CTX_SUFF(pVM), pCritSect->s.idxProf);
         STAM_PROFILE_ADV_STOP(&pCritSect->s.StatLocked, l);
         ASMCompilerBarrier();
         if (ASMAtomicDecS32(&pCritSect->s.Core.cLockers) >= 0)
@@ -633,6 +829,8 @@ VMMDECL(int) PDMCritSectLeave(PPDMCRITSECT pCritSect)
             ASMAtomicWriteS32(&pCritSect->s.Core.cNestings, 0);
             RTNATIVETHREAD hNativeThread = pCritSect->s.Core.NativeThreadOwner;
             ASMAtomicAndU32(&pCritSect->s.Core.fFlags, ~PDMCRITSECT_FLAGS_PENDING_UNLOCK);
+            if (RT_UNLIKELY(pCritSect->s.idxProf))
+                pdmCritSectProfReleased(pCritSect->s.CTX_SUFF(pVM), pCritSect->s.idxProf);
             STAM_PROFILE_ADV_STOP(&pCritSect->s.StatLocked, l);
 
             ASMAtomicWriteHandle(&pCritSect->s.Core.NativeThreadOwner, NIL_RTNATIVETHREAD);
@@ -642,6 +840,8 @@ VMMDECL(int) PDMCritSectLeave(PPDMCRITSECT pCritSect)
             /* darn, someone raced in on us. */
             ASMAtomicWriteHandle(&pCritSect->s.Core.NativeThreadOwner, hNativeThread);
             STAM_PROFILE_ADV_START(&pCritSect->s.StatLocked, l);
+            if (RT_UNLIKELY(pCritSect->s.idxProf))
+                pdmCritSectProfOwned(pCritSect->s.CTX_SUFF(pVM), pCritSect->s.idxProf);
             Assert(pCritSect->s.Core.cNestings == 0);
             ASMAtomicWriteS32(&pCritSect->s.Core.cNestings, 1);
         }
@@ -40,23 +40,14 @@
 # include <iprt/thread.h>
 #endif
 
+#include "PDMInline.h"
+
 
 /*********************************************************************************************************************************
 *   Defined Constants And Macros                                                                                                 *
 *********************************************************************************************************************************/
-/** The number loops to spin for shared access in ring-3. */
-#define PDMCRITSECTRW_SHRD_SPIN_COUNT_R3       20
-/** The number loops to spin for shared access in ring-0. */
-#define PDMCRITSECTRW_SHRD_SPIN_COUNT_R0       128
-/** The number loops to spin for shared access in the raw-mode context. */
-#define PDMCRITSECTRW_SHRD_SPIN_COUNT_RC       128
-
-/** The number loops to spin for exclusive access in ring-3. */
-#define PDMCRITSECTRW_EXCL_SPIN_COUNT_R3       20
-/** The number loops to spin for exclusive access in ring-0. */
-#define PDMCRITSECTRW_EXCL_SPIN_COUNT_R0       256
-/** The number loops to spin for exclusive access in the raw-mode context. */
-#define PDMCRITSECTRW_EXCL_SPIN_COUNT_RC       256
+/** How often (in pause iterations) to check the spin budget and the owner. */
+#define PDMCRITSECTRW_SPIN_CHECK_MASK          15
 
 
 /* Undefine the automatic VBOX_STRICT API mappings. */
@@ -138,6 +129,58 @@ static void pdmR0CritSectRwYieldToRing3(PPDMCRITSECTRW pThis)
 #endif /* IN_RING0 */
 
 
+/**
+ * Spins while the section is busy in the way that matters to the caller, for
+ * as long as the writer appears to be running and we're within the budget
+ * learned from earlier spins.
+ *
+ * The caller then proceeds with the normal enter logic, whether or not the
+ * section became available.
+ *
+ * @param   pThis       Pointer to the read/write critical section.
+ * @param   fExcl       Set if we want exclusive access, clear for shared.
+ */
+static void pdmCritSectRwSpin(PPDMCRITSECTRW pThis, bool fExcl)
+{
+    PVM            pVM = pThis->s.CTX_SUFF(pVM);
+    RTNATIVETHREAD hNativeWriter;
+    ASMAtomicUoReadHandle(&pThis->s.Core.hNativeWriter, &hNativeWriter);
+    if (!pdmCritSectIsOwnerRunning(pVM, hNativeWriter))
+        return;
+
+    uint64_t const tsStart      = ASMReadTSC();
+    uint64_t const cTicksBudget = pdmCritSectSpinBudget(pThis->s.cTicksSpin, CTX_SUFF(PDMCRITSECT_SPIN_TICKS_MAX_));
+    for (uint32_t iLoop = 0; ; iLoop++)
+    {
+        uint64_t const u64State = ASMAtomicReadU64(&pThis->s.Core.u64State);
+        bool const     fBusy    = fExcl
+                                ? (u64State & (RTCSRW_CNT_RD_MASK | RTCSRW_CNT_WR_MASK)) != 0
+                                :    (u64State & RTCSRW_DIR_MASK) == (RTCSRW_DIR_WRITE << RTCSRW_DIR_SHIFT)
+                                  && (u64State & RTCSRW_CNT_WR_MASK) != 0;
+        if (!fBusy)
+        {
+            if (iLoop)
+                pdmCritSectSpinUpdate(&pThis->s.cTicksSpin, ASMReadTSC() - tsStart, true /*fSuccess*/);
+            return;
+        }
+        ASMNopPause();
+        if ((iLoop & PDMCRITSECTRW_SPIN_CHECK_MASK) == PDMCRITSECTRW_SPIN_CHECK_MASK)
+        {
+            if (ASMReadTSC() - tsStart >= cTicksBudget)
+            {
+                pdmCritSectSpinUpdate(&pThis->s.cTicksSpin, cTicksBudget, false /*fSuccess*/);
+                return;
+            }
+            /* Readers are anonymous, so we can only check up on a writer. */
+            ASMAtomicUoReadHandle(&pThis->s.Core.hNativeWriter, &hNativeWriter);
+            if (   !pdmCritSectIsOwnerRunning(pVM, hNativeWriter)
+                || pThis->s.Core.u32Magic != RTCRITSECTRW_MAGIC)
+                return;
+        }
+    }
+}
+
+
 /**
  * Worker that enters a read/write critical section with shard access.
  *
@@ -147,8 +190,11 @@ static void pdmR0CritSectRwYieldToRing3(PPDMCRITSECTRW pThis)
  * @param   fTryOnly    Only try enter it, don't wait.
  * @param   pSrcPos     The source position. (Can be NULL.)
  * @param   fNoVal      No validation records.
+ * @param   uCaller     The return address of the API call, for the
+ *                      contention profiler.
  */
-static int pdmCritSectRwEnterShared(PPDMCRITSECTRW pThis, int rcBusy, bool fTryOnly, PCRTLOCKVALSRCPOS pSrcPos, bool fNoVal)
+static int pdmCritSectRwEnterShared(PPDMCRITSECTRW pThis, int rcBusy, bool fTryOnly, PCRTLOCKVALSRCPOS pSrcPos, bool fNoVal,
+                                    RTHCUINTPTR uCaller)
 {
     /*
      * Validate input.
@@ -181,7 +227,15 @@ static int pdmCritSectRwEnterShared(PPDMCRITSECTRW pThis, int rcBusy, bool fTryO
      * Get cracking...
      */
     uint64_t u64State    = ASMAtomicReadU64(&pThis->s.Core.u64State);
+    if (   !fTryOnly
+        && (u64State & RTCSRW_DIR_MASK) == (RTCSRW_DIR_WRITE << RTCSRW_DIR_SHIFT)
+        && (u64State & RTCSRW_CNT_WR_MASK) != 0)
+    {
+        pdmCritSectRwSpin(pThis, false /*fExcl*/);
+        u64State = ASMAtomicReadU64(&pThis->s.Core.u64State);
+    }
     uint64_t u64OldState = u64State;
+    uint64_t tsWaitStart = 0;
 
     for (;;)
     {
@@ -245,6 +299,8 @@ static int pdmCritSectRwEnterShared(PPDMCRITSECTRW pThis, int rcBusy, bool fTryO
             if (fTryOnly)
             {
                 STAM_REL_COUNTER_INC(&pThis->s.CTX_MID_Z(StatContention,EnterShared));
+                if (RT_UNLIKELY(pThis->s.idxProf))
+                    pdmCritSectProfContended(pThis->s.CTX_SUFF(pVM), pThis->s.idxProf, 0, uCaller, true /*fBusy*/);
                 return VERR_SEM_BUSY;
             }
 
@@ -271,6 +327,8 @@ static int pdmCritSectRwEnterShared(PPDMCRITSECTRW pThis, int rcBusy, bool fTryO
 
                 if (ASMAtomicCmpXchgU64(&pThis->s.Core.u64State, u64State, u64OldState))
                 {
+                    if (RT_UNLIKELY(pThis->s.idxProf))
+                        tsWaitStart = ASMReadTSC();
                     for (uint32_t iLoop = 0; ; iLoop++)
                     {
                         int rc;
@@ -285,6 +343,9 @@ static int pdmCritSectRwEnterShared(PPDMCRITSECTRW pThis, int rcBusy, bool fTryO
 #  endif
 # endif
                         {
+                            PVMCPU pVCpu = VMMGetCpu(pThis->s.CTX_SUFF(pVM)); /* NULL if not EMT */
+                            if (pVCpu)
+                                ASMAtomicWriteBool(&pVCpu->pdm.s.fBlockedOnCritSect, true);
                             for (;;)
                             {
                                 rc = SUPSemEventMultiWaitNoResume(pThis->s.CTX_SUFF(pVM)->pSession,
@@ -297,6 +358,8 @@ static int pdmCritSectRwEnterShared(PPDMCRITSECTRW pThis, int rcBusy, bool fTryO
                                 pdmR0CritSectRwYieldToRing3(pThis);
 # endif
                             }
+                            if (pVCpu)
+                                ASMAtomicWriteBool(&pVCpu->pdm.s.fBlockedOnCritSect, false);
 # ifdef IN_RING3
                             RTThreadUnblocked(hThreadSelf, RTTHREADSTATE_RW_READ);
 # endif
@@ -373,6 +436,8 @@ static int pdmCritSectRwEnterShared(PPDMCRITSECTRW pThis, int rcBusy, bool fTryO
                  * back to ring-3 and do it there or return rcBusy.
                  */
                 STAM_REL_COUNTER_INC(&pThis->s.CTX_MID_Z(StatContention,EnterShared));
+                if (RT_UNLIKELY(pThis->s.idxProf))
+                    pdmCritSectProfContended(pThis->s.CTX_SUFF(pVM), pThis->s.idxProf, 0, uCaller, true /*fBusy*/);
                 if (rcBusy == VINF_SUCCESS)
                 {
                     PVM     pVM   = pThis->s.CTX_SUFF(pVM);     AssertPtr(pVM);
@@ -396,6 +461,8 @@ static int pdmCritSectRwEnterShared(PPDMCRITSECTRW pThis, int rcBusy, bool fTryO
 
     /* got it! */
     STAM_REL_COUNTER_INC(&pThis->s.CTX_MID_Z(Stat,EnterShared));
+    if (tsWaitStart)
+        pdmCritSectProfContended(pThis->s.CTX_SUFF(pVM), pThis->s.idxProf, ASMReadTSC() - tsWaitStart, uCaller, false /*fBusy*/);
     Assert((ASMAtomicReadU64(&pThis->s.Core.u64State) & RTCSRW_DIR_MASK) == (RTCSRW_DIR_READ << RTCSRW_DIR_SHIFT));
     return VINF_SUCCESS;
 
@@ -423,10 +490,12 @@ static int pdmCritSectRwEnterShared(PPDMCRITSECTRW pThis, int rcBusy, bool fTryO
 VMMDECL(int) PDMCritSectRwEnterShared(PPDMCRITSECTRW pThis, int rcBusy)
 {
 #if !defined(PDMCRITSECTRW_STRICT) || !defined(IN_RING3)
-    return pdmCritSectRwEnterShared(pThis, rcBusy, false /*fTryOnly*/, NULL,    false /*fNoVal*/);
+    return pdmCritSectRwEnterShared(pThis, rcBusy, false /*fTryOnly*/, NULL,    false /*fNoVal*/,
+                                    (RTHCUINTPTR)ASMReturnAddress());
 #else
     RTLOCKVALSRCPOS SrcPos = RTLOCKVALSRCPOS_INIT_NORMAL_API();
-    return pdmCritSectRwEnterShared(pThis, rcBusy, false /*fTryOnly*/, &SrcPos, false /*fNoVal*/);
+    return pdmCritSectRwEnterShared(pThis, rcBusy, false /*fTryOnly*/, &SrcPos, false /*fNoVal*/,
+                                    (RTHCUINTPTR)ASMReturnAddress());
 #endif
 }
 
@@ -453,12 +522,13 @@ VMMDECL(int) PDMCritSectRwEnterShared(PPDMCRITSECTRW pThis, int rcBusy)
  */
 VMMDECL(int) PDMCritSectRwEnterSharedDebug(PPDMCRITSECTRW pThis, int rcBusy, RTHCUINTPTR uId, RT_SRC_POS_DECL)
 {
-    NOREF(uId); NOREF(pszFile); NOREF(iLine); NOREF(pszFunction);
+    NOREF(pszFile); NOREF(iLine); NOREF(pszFunction);
+    RTHCUINTPTR const uCaller = uId ? uId : (RTHCUINTPTR)ASMReturnAddress();
 #if !defined(PDMCRITSECTRW_STRICT) || !defined(IN_RING3)
-    return pdmCritSectRwEnterShared(pThis, rcBusy, false /*fTryOnly*/, NULL,    false /*fNoVal*/);
+    return pdmCritSectRwEnterShared(pThis, rcBusy, false /*fTryOnly*/, NULL,    false /*fNoVal*/, uCaller);
 #else
     RTLOCKVALSRCPOS SrcPos = RTLOCKVALSRCPOS_INIT_DEBUG_API();
-    return pdmCritSectRwEnterShared(pThis, rcBusy, false /*fTryOnly*/, &SrcPos, false /*fNoVal*/);
+    return pdmCritSectRwEnterShared(pThis, rcBusy, false /*fTryOnly*/, &SrcPos, false /*fNoVal*/, uCaller);
 #endif
 }
 
@@ -481,10 +551,12 @@ VMMDECL(int) PDMCritSectRwEnterSharedDebug(PPDMCRITSECTRW pThis, int rcBusy, RTH
 VMMDECL(int) PDMCritSectRwTryEnterShared(PPDMCRITSECTRW pThis)
 {
 #if !defined(PDMCRITSECTRW_STRICT) || !defined(IN_RING3)
-    return pdmCritSectRwEnterShared(pThis, VERR_SEM_BUSY, true /*fTryOnly*/, NULL,    false /*fNoVal*/);
+    return pdmCritSectRwEnterShared(pThis, VERR_SEM_BUSY, true /*fTryOnly*/, NULL,    false /*fNoVal*/,
+                                    (RTHCUINTPTR)ASMReturnAddress());
 #else
     RTLOCKVALSRCPOS SrcPos = RTLOCKVALSRCPOS_INIT_NORMAL_API();
-    return pdmCritSectRwEnterShared(pThis, VERR_SEM_BUSY, true /*fTryOnly*/, &SrcPos, false /*fNoVal*/);
+    return pdmCritSectRwEnterShared(pThis, VERR_SEM_BUSY, true /*fTryOnly*/, &SrcPos, false /*fNoVal*/,
+                                    (RTHCUINTPTR)ASMReturnAddress());
 #endif
 }
 
@@ -508,12 +580,13 @@ VMMDECL(int) PDMCritSectRwTryEnterShared(PPDMCRITSECTRW pThis)
  */
 VMMDECL(int) PDMCritSectRwTryEnterSharedDebug(PPDMCRITSECTRW pThis, RTHCUINTPTR uId, RT_SRC_POS_DECL)
 {
-    NOREF(uId); NOREF(pszFile); NOREF(iLine); NOREF(pszFunction);
+    NOREF(pszFile); NOREF(iLine); NOREF(pszFunction);
+    RTHCUINTPTR const uCaller = uId ? uId : (RTHCUINTPTR)ASMReturnAddress();
 #if !defined(PDMCRITSECTRW_STRICT) || !defined(IN_RING3)
-    return pdmCritSectRwEnterShared(pThis, VERR_SEM_BUSY, true /*fTryOnly*/, NULL,    false /*fNoVal*/);
+    return pdmCritSectRwEnterShared(pThis, VERR_SEM_BUSY, true /*fTryOnly*/, NULL,    false /*fNoVal*/, uCaller);
 #else
     RTLOCKVALSRCPOS SrcPos = RTLOCKVALSRCPOS_INIT_DEBUG_API();
-    return pdmCritSectRwEnterShared(pThis, VERR_SEM_BUSY, true /*fTryOnly*/, &SrcPos, false /*fNoVal*/);
+    return pdmCritSectRwEnterShared(pThis, VERR_SEM_BUSY, true /*fTryOnly*/, &SrcPos, false /*fNoVal*/, uCaller);
 #endif
 }
 
@@ -531,7 +604,7 @@ VMMDECL(int) PDMCritSectRwTryEnterSharedDebug(PPDMCRITSECTRW pThis, RTHCUINTPTR
  */
 VMMR3DECL(int) PDMR3CritSectRwEnterSharedEx(PPDMCRITSECTRW pThis, bool fCallRing3)
 {
-    return pdmCritSectRwEnterShared(pThis, VERR_SEM_BUSY, false /*fTryAgain*/, NULL, fCallRing3);
+    return pdmCritSectRwEnterShared(pThis, VERR_SEM_BUSY, false /*fTryAgain*/, NULL, fCallRing3, (RTHCUINTPTR)ASMReturnAddress());
 }
 #endif
 
@@ -697,8 +770,11 @@ void pdmCritSectRwLeaveSharedQueued(PPDMCRITSECTRW pThis)
  * @param   fTryOnly    Only try enter it, don't wait.
  * @param   pSrcPos     The source position. (Can be NULL.)
  * @param   fNoVal      No validation records.
+ * @param   uCaller     The return address of the API call, for the
+ *                      contention profiler.
  */
-static int pdmCritSectRwEnterExcl(PPDMCRITSECTRW pThis, int rcBusy, bool fTryOnly, PCRTLOCKVALSRCPOS pSrcPos, bool fNoVal)
+static int pdmCritSectRwEnterExcl(PPDMCRITSECTRW pThis, int rcBusy, bool fTryOnly, PCRTLOCKVALSRCPOS pSrcPos, bool fNoVal,
+                                  RTHCUINTPTR uCaller)
 {
     /*
      * Validate input.
@@ -749,6 +825,12 @@ static int pdmCritSectRwEnterExcl(PPDMCRITSECTRW pThis, int rcBusy, bool fTryOnl
      * Get cracking.
      */
     uint64_t u64State    = ASMAtomicReadU64(&pThis->s.Core.u64State);
+    if (   !fTryOnly
+        && (u64State & (RTCSRW_CNT_RD_MASK | RTCSRW_CNT_WR_MASK)) != 0)
+    {
+        pdmCritSectRwSpin(pThis, true /*fExcl*/);
+        u64State = ASMAtomicReadU64(&pThis->s.Core.u64State);
+    }
     uint64_t u64OldState = u64State;
 
     for (;;)
@@ -777,6 +859,8 @@ static int pdmCritSectRwEnterExcl(PPDMCRITSECTRW pThis, int rcBusy, bool fTryOnl
         {
             /* Wrong direction and we're not supposed to wait, just return. */
             STAM_REL_COUNTER_INC(&pThis->s.CTX_MID_Z(StatContention,EnterExcl));
+            if (RT_UNLIKELY(pThis->s.idxProf))
+                pdmCritSectProfContended(pThis->s.CTX_SUFF(pVM), pThis->s.idxProf, 0, uCaller, true /*fBusy*/);
             return VERR_SEM_BUSY;
         }
         else
@@ -811,9 +895,12 @@ static int pdmCritSectRwEnterExcl(PPDMCRITSECTRW pThis, int rcBusy, bool fTryOnl
                ;
     if (fDone)
         ASMAtomicCmpXchgHandle(&pThis->s.Core.hNativeWriter, hNativeSelf, NIL_RTNATIVETHREAD, fDone);
+    uint64_t tsWaitStart = 0;
     if (!fDone)
     {
         STAM_REL_COUNTER_INC(&pThis->s.CTX_MID_Z(StatContention,EnterExcl));
+        if (RT_UNLIKELY(pThis->s.idxProf))
+            tsWaitStart = ASMReadTSC();
 
 #if defined(IN_RING3) || defined(IN_RING0)
         if (   !fTryOnly
@@ -843,6 +930,9 @@ static int pdmCritSectRwEnterExcl(PPDMCRITSECTRW pThis, int rcBusy, bool fTryOnl
 #  endif
 # endif
                 {
+                    PVMCPU pVCpu = VMMGetCpu(pThis->s.CTX_SUFF(pVM)); /* NULL if not EMT */
+                    if (pVCpu)
+                        ASMAtomicWriteBool(&pVCpu->pdm.s.fBlockedOnCritSect, true);
                     for (;;)
                     {
                         rc = SUPSemEventWaitNoResume(pThis->s.CTX_SUFF(pVM)->pSession,
@@ -855,6 +945,8 @@ static int pdmCritSectRwEnterExcl(PPDMCRITSECTRW pThis, int rcBusy, bool fTryOnl
                         pdmR0CritSectRwYieldToRing3(pThis);
 # endif
                     }
+                    if (pVCpu)
+                        ASMAtomicWriteBool(&pVCpu->pdm.s.fBlockedOnCritSect, false);
 # ifdef IN_RING3
                     RTThreadUnblocked(hThreadSelf, RTTHREADSTATE_RW_WRITE);
 # endif
@@ -909,6 +1001,8 @@ static int pdmCritSectRwEnterExcl(PPDMCRITSECTRW pThis, int rcBusy, bool fTryOnl
                     break;
             }
 
+            if (tsWaitStart)
+                pdmCritSectProfContended(pThis->s.CTX_SUFF(pVM), pThis->s.idxProf, 0, uCaller, true /*fBusy*/);
 #ifdef IN_RING3
             return VERR_SEM_BUSY;
 #else
@@ -938,6 +1032,13 @@ static int pdmCritSectRwEnterExcl(PPDMCRITSECTRW pThis, int rcBusy, bool fTryOnl
 #endif
     STAM_REL_COUNTER_INC(&pThis->s.CTX_MID_Z(Stat,EnterExcl));
     STAM_PROFILE_ADV_START(&pThis->s.StatWriteLocked, swl);
+    if (RT_UNLIKELY(pThis->s.idxProf))
+    {
+        PVM pVM = pThis->s.CTX_SUFF(pVM);
+        if (tsWaitStart)
+            pdmCritSectProfContended(pVM, pThis->s.idxProf, ASMReadTSC() - tsWaitStart, uCaller, false /*fBusy*/);
+        pdmCritSectProfOwned(pVM, pThis->s.idxProf);
+    }
 
     return VINF_SUCCESS;
 }
@@ -965,10 +1066,10 @@ static int pdmCritSectRwEnterExcl(PPDMCRITSECTRW pThis, int rcBusy, bool fTryOnl
 VMMDECL(int) PDMCritSectRwEnterExcl(PPDMCRITSECTRW pThis, int rcBusy)
 {
 #if !defined(PDMCRITSECTRW_STRICT) || !defined(IN_RING3)
-    return pdmCritSectRwEnterExcl(pThis, rcBusy, false /*fTryAgain*/, NULL,    false /*fNoVal*/);
+    return pdmCritSectRwEnterExcl(pThis, rcBusy, false /*fTryAgain*/, NULL,    false /*fNoVal*/, (RTHCUINTPTR)ASMReturnAddress());
 #else
     RTLOCKVALSRCPOS SrcPos = RTLOCKVALSRCPOS_INIT_NORMAL_API();
-    return pdmCritSectRwEnterExcl(pThis, rcBusy, false /*fTryAgain*/, &SrcPos, false /*fNoVal*/);
+    return pdmCritSectRwEnterExcl(pThis, rcBusy, false /*fTryAgain*/, &SrcPos, false /*fNoVal*/, (RTHCUINTPTR)ASMReturnAddress());
 #endif
 }
 
@@ -996,12 +1097,13 @@ VMMDECL(int) PDMCritSectRwEnterExcl(PPDMCRITSECTRW pThis, int rcBusy)
  */
 VMMDECL(int) PDMCritSectRwEnterExclDebug(PPDMCRITSECTRW pThis, int rcBusy, RTHCUINTPTR uId, RT_SRC_POS_DECL)
 {
-    NOREF(uId); NOREF(pszFile); NOREF(iLine); NOREF(pszFunction);
+    NOREF(pszFile); NOREF(iLine); NOREF(pszFunction);
+    RTHCUINTPTR const uCaller = uId ? uId : (RTHCUINTPTR)ASMReturnAddress();
 #if !defined(PDMCRITSECTRW_STRICT) || !defined(IN_RING3)
-    return pdmCritSectRwEnterExcl(pThis, rcBusy, false /*fTryAgain*/, NULL,    false /*fNoVal*/);
+    return pdmCritSectRwEnterExcl(pThis, rcBusy, false /*fTryAgain*/, NULL,    false /*fNoVal*/, uCaller);
 #else
     RTLOCKVALSRCPOS SrcPos = RTLOCKVALSRCPOS_INIT_DEBUG_API();
-    return pdmCritSectRwEnterExcl(pThis, rcBusy, false /*fTryAgain*/, &SrcPos, false /*fNoVal*/);
+    return pdmCritSectRwEnterExcl(pThis, rcBusy, false /*fTryAgain*/, &SrcPos, false /*fNoVal*/, uCaller);
 #endif
 }
 
@@ -1024,10 +1126,12 @@ VMMDECL(int) PDMCritSectRwEnterExclDebug(PPDMCRITSECTRW pThis, int rcBusy, RTHCU
 VMMDECL(int) PDMCritSectRwTryEnterExcl(PPDMCRITSECTRW pThis)
 {
 #if !defined(PDMCRITSECTRW_STRICT) || !defined(IN_RING3)
-    return pdmCritSectRwEnterExcl(pThis, VERR_SEM_BUSY, true /*fTryAgain*/, NULL,    false /*fNoVal*/);
+    return pdmCritSectRwEnterExcl(pThis, VERR_SEM_BUSY, true /*fTryAgain*/, NULL,    false /*fNoVal*/,
+                                  (RTHCUINTPTR)ASMReturnAddress());
 #else
     RTLOCKVALSRCPOS SrcPos = RTLOCKVALSRCPOS_INIT_NORMAL_API();
-    return pdmCritSectRwEnterExcl(pThis, VERR_SEM_BUSY, true /*fTryAgain*/, &SrcPos, false /*fNoVal*/);
+    return pdmCritSectRwEnterExcl(pThis, VERR_SEM_BUSY, true /*fTryAgain*/, &SrcPos, false /*fNoVal*/,
+                                  (RTHCUINTPTR)ASMReturnAddress());
 #endif
 }
 
@@ -1051,12 +1155,13 @@ VMMDECL(int) PDMCritSectRwTryEnterExcl(PPDMCRITSECTRW pThis)
  */
 VMMDECL(int) PDMCritSectRwTryEnterExclDebug(PPDMCRITSECTRW pThis, RTHCUINTPTR uId, RT_SRC_POS_DECL)
 {
-    NOREF(uId); NOREF(pszFile); NOREF(iLine); NOREF(pszFunction);
+    NOREF(pszFile); NOREF(iLine); NOREF(pszFunction);
+    RTHCUINTPTR const uCaller = uId ? uId : (RTHCUINTPTR)ASMReturnAddress();
 #if !defined(PDMCRITSECTRW_STRICT) || !defined(IN_RING3)
-    return pdmCritSectRwEnterExcl(pThis, VERR_SEM_BUSY, true /*fTryAgain*/, NULL,    false /*fNoVal*/);
+    return pdmCritSectRwEnterExcl(pThis, VERR_SEM_BUSY, true /*fTryAgain*/, NULL,    false /*fNoVal*/, uCaller);
 #else
     RTLOCKVALSRCPOS SrcPos = RTLOCKVALSRCPOS_INIT_DEBUG_API();
-    return pdmCritSectRwEnterExcl(pThis, VERR_SEM_BUSY, true /*fTryAgain*/, &SrcPos, false /*fNoVal*/);
+    return pdmCritSectRwEnterExcl(pThis, VERR_SEM_BUSY, true /*fTryAgain*/, &SrcPos, false /*fNoVal*/, uCaller);
 #endif
 }
 
@@ -1074,7 +1179,8 @@ VMMDECL(int) PDMCritSectRwTryEnterExclDebug(PPDMCRITSECTRW pThis, RTHCUINTPTR uI
  */
 VMMR3DECL(int) PDMR3CritSectRwEnterExclEx(PPDMCRITSECTRW pThis, bool fCallRing3)
 {
-    return pdmCritSectRwEnterExcl(pThis, VERR_SEM_BUSY, false /*fTryAgain*/, NULL, fCallRing3 /*fNoVal*/);
+    return pdmCritSectRwEnterExcl(pThis, VERR_SEM_BUSY, false /*fTryAgain*/, NULL, fCallRing3 /*fNoVal*/,
+                                  (RTHCUINTPTR)ASMReturnAddress());
 }
 #endif /* IN_RING3 */
 
@@ -1132,6 +1238,8 @@ static int pdmCritSectRwLeaveExclWorker(PPDMCRITSECTRW pThis, bool fNoVal)
 # endif
         {
             ASMAtomicWriteU32(&pThis->s.Core.cWriteRecursions, 0);
+            if (RT_UNLIKELY(pThis->s.idxProf))
+                pdmCritSectProfReleased(pThis->s.CTX_SUFF(pVM), pThis->s.idxProf);
             STAM_PROFILE_ADV_STOP(&pThis->s.StatWriteLocked, swl);
             ASMAtomicWriteHandle(&pThis->s.Core.hNativeWriter, NIL_RTNATIVETHREAD);
 
@@ -86,6 +86,33 @@ static void pdmQueueSetFF(PPDMQUEUE pQueue)
 }
 
 
+/**
+ * Wakes up the worker thread of a PDMQUEUE_INTERVAL_WORKER_THREAD queue.
+ *
+ * Only the producer that finds the worker asleep signals the semaphore, so a
+ * burst of inserts results in a single wakeup and the worker takes the whole
+ * batch in one go.
+ *
+ * @param   pQueue              The PDM queue.
+ */
+static void pdmQueueWakeWorker(PPDMQUEUE pQueue)
+{
+#ifdef IN_RC
+    /* Can't signal SUP semaphores from raw-mode, let the EMT do it when it
+       gets back to ring-3 (see PDMR3QueueFlushAll). */
+    pdmQueueSetFF(pQueue);
+#else
+    if (ASMAtomicXchgBool(&pQueue->fWorkerSleeping, false))
+    {
+        PVM pVM = pQueue->CTX_SUFF(pVM);
+        STAM_REL_COUNTER_INC(&pQueue->StatWorkerWakeups);
+        int rc = SUPSemEventSignal(pVM->pSession, pQueue->hEvtWorker);
+        AssertRC(rc);
+    }
+#endif
+}
+
+
 /**
  * Queue an item.
  * The item must have been obtained using PDMQueueAlloc(). Once the item
@@ -116,7 +143,9 @@ VMMDECL(void) PDMQueueInsert(PPDMQUEUE pQueue, PPDMQUEUEITEMCORE pItem)
     } while (!ASMAtomicCmpXchgPtr(&pQueue->CTX_SUFF(pPending), pItem, pNext));
 #endif
 
-    if (!pQueue->pTimer)
+    if (pQueue->hEvtWorker != NIL_SUPSEMEVENT)
+        pdmQueueWakeWorker(pQueue);
+    else if (!pQueue->pTimer)
         pdmQueueSetFF(pQueue);
     STAM_REL_COUNTER_INC(&pQueue->StatInsert);
     STAM_STATS({ ASMAtomicIncU32(&pQueue->cStatPending); });
@@ -206,7 +235,10 @@ VMMDECL(bool) PDMQueueFlushIfNecessary(PPDMQUEUE pQueue)
         || pQueue->pPendingR0 != NIL_RTR0PTR
         || pQueue->pPendingRC != NIL_RTRCPTR)
     {
-        pdmQueueSetFF(pQueue);
+        if (pQueue->hEvtWorker != NIL_SUPSEMEVENT)
+            pdmQueueWakeWorker(pQueue);
+        else
+            pdmQueueSetFF(pQueue);
         return false;
     }
     return false;
@@ -617,20 +617,20 @@ void pgmPhysInvalidatePageMapTLBEntry(PVM pVM, RTGCPHYS GCPhys)
 
     STAM_COUNTER_INC(&pVM->pgm.s.CTX_SUFF(pStats)->StatPageMapTlbFlushEntry);
 
-#ifdef IN_RC
-    unsigned idx = PGM_PAGER3MAPTLB_IDX(GCPhys);
-    pVM->pgm.s.PhysTlbHC.aEntries[idx].GCPhys = NIL_RTGCPHYS;
-    pVM->pgm.s.PhysTlbHC.aEntries[idx].pPage = 0;
-    pVM->pgm.s.PhysTlbHC.aEntries[idx].pMap = 0;
-    pVM->pgm.s.PhysTlbHC.aEntries[idx].pv = 0;
-#else
-    /* Clear the shared R0/R3 TLB entry. */
-    PPGMPAGEMAPTLBE pTlbe = &pVM->pgm.s.CTXSUFF(PhysTlb).aEntries[PGM_PAGEMAPTLB_IDX(GCPhys)];
-    pTlbe->GCPhys = NIL_RTGCPHYS;
-    pTlbe->pPage  = 0;
-    pTlbe->pMap   = 0;
-    pTlbe->pv     = 0;
-#endif
+    /* Clear the shared R0/R3 TLB entry, whichever way of the set it is in. */
+    RTGCPHYS const GCPhysPage = GCPhys & X86_PTE_PAE_PG_MASK;
+    unsigned const idx        = PGM_PAGER3MAPTLB_IDX(GCPhys);
+    for (unsigned iWay = 0; iWay < PGM_PAGER3MAPTLB_WAYS; iWay++)
+    {
+        PPGMPAGER3MAPTLBE pTlbe = &pVM->pgm.s.PhysTlbHC.aEntries[idx + iWay];
+        if (pTlbe->GCPhys == GCPhysPage)
+        {
+            pTlbe->GCPhys = NIL_RTGCPHYS;
+            pTlbe->pPage  = 0;
+            pTlbe->pMap   = 0;
+            pTlbe->pv     = 0;
+        }
+    }
 
     /** @todo clear the RC TLB whenever we add it. */
 }
@@ -1414,8 +1414,9 @@ int pgmPhysPageMapReadOnly(PVM pVM, PPGMPAGE pPage, RTGCPHYS GCPhys, void const
  * @retval  VERR_PGM_INVALID_GC_PHYSICAL_ADDRESS if it's not a valid physical address.
  * @param   pPGM        The PGM instance pointer.
  * @param   GCPhys      The guest physical address in question.
+ * @param   ppTlbe      Where to return the TLB entry.
  */
-int pgmPhysPageLoadIntoTlb(PVM pVM, RTGCPHYS GCPhys)
+int pgmPhysPageLoadIntoTlb(PVM pVM, RTGCPHYS GCPhys, PPGMPAGER3MAPTLBE *ppTlbe)
 {
     PGM_LOCK_ASSERT_OWNER(pVM);
 
@@ -1427,10 +1428,11 @@ int pgmPhysPageLoadIntoTlb(PVM pVM, RTGCPHYS GCPhys)
     if (!pPage)
     {
         STAM_COUNTER_INC(&pVM->pgm.s.CTX_SUFF(pStats)->CTX_MID_Z(Stat,PageMapTlbMisses));
+        *ppTlbe = &pVM->pgm.s.PhysTlbHC.aEntries[PGM_PAGER3MAPTLB_IDX(GCPhys)];
         return VERR_PGM_INVALID_GC_PHYSICAL_ADDRESS;
     }
 
-    return pgmPhysPageLoadIntoTlbWithPage(pVM, pPage, GCPhys);
+    return pgmPhysPageLoadIntoTlbWithPage(pVM, pPage, GCPhys, ppTlbe);
 }
 
 
@@ -1445,8 +1447,9 @@ int pgmPhysPageLoadIntoTlb(PVM pVM, RTGCPHYS GCPhys)
  * @param   pPage       Pointer to the PGMPAGE structure corresponding to
  *                      GCPhys.
  * @param   GCPhys      The guest physical address in question.
+ * @param   ppTlbe      Where to return the TLB entry.
  */
-int pgmPhysPageLoadIntoTlbWithPage(PVM pVM, PPGMPAGE pPage, RTGCPHYS GCPhys)
+int pgmPhysPageLoadIntoTlbWithPage(PVM pVM, PPGMPAGE pPage, RTGCPHYS GCPhys, PPGMPAGER3MAPTLBE *ppTlbe)
 {
     PGM_LOCK_ASSERT_OWNER(pVM);
     STAM_COUNTER_INC(&pVM->pgm.s.CTX_SUFF(pStats)->CTX_MID_Z(Stat,PageMapTlbMisses));
@@ -1456,24 +1459,38 @@ int pgmPhysPageLoadIntoTlbWithPage(PVM pVM, PPGMPAGE pPage, RTGCPHYS GCPhys)
      * Make a special case for the zero page as it is kind of special.
      */
     PPGMPAGEMAPTLBE pTlbe = &pVM->pgm.s.CTXSUFF(PhysTlb).aEntries[PGM_PAGEMAPTLB_IDX(GCPhys)];
+    *ppTlbe = pTlbe;
+    void           *pv;
+    PPGMPAGEMAP     pMap;
     if (    !PGM_PAGE_IS_ZERO(pPage)
         &&  !PGM_PAGE_IS_BALLOONED(pPage))
     {
-        void *pv;
-        PPGMPAGEMAP pMap;
         int rc = pgmPhysPageMapCommon(pVM, pPage, GCPhys, &pMap, &pv);
         if (RT_FAILURE(rc))
             return rc;
-        pTlbe->pMap = pMap;
-        pTlbe->pv = pv;
-        Assert(!((uintptr_t)pTlbe->pv & PAGE_OFFSET_MASK));
+        Assert(!((uintptr_t)pv & PAGE_OFFSET_MASK));
     }
     else
     {
         AssertMsg(PGM_PAGE_GET_HCPHYS(pPage) == pVM->pgm.s.HCPhysZeroPg, ("%RGp/%R[pgmpage]\n", GCPhys, pPage));
-        pTlbe->pMap = NULL;
-        pTlbe->pv = pVM->pgm.s.CTXALLSUFF(pvZeroPg);
+        pMap = NULL;
+        pv   = pVM->pgm.s.CTXALLSUFF(pvZeroPg);
+    }
+
+    /*
+     * Way 0 holds the most recently loaded page; demote its current occupant
+     * to way 1 so that two pages competing for a set can both stay cached.
+     */
+    AssertCompile(PGM_PAGEMAPTLB_WAYS == 2);
+    if (pTlbe->GCPhys != NIL_RTGCPHYS)
+    {
+        pTlbe[1].GCPhys = pTlbe->GCPhys;
+        pTlbe[1].pPage  = pTlbe->pPage;
+        pTlbe[1].pMap   = pTlbe->pMap;
+        pTlbe[1].pv     = pTlbe->pv;
     }
+    pTlbe->pMap = pMap;
+    pTlbe->pv   = pv;
 #ifdef PGM_WITH_PHYS_TLB
     if (    PGM_PAGE_GET_TYPE(pPage) < PGMPAGETYPE_ROM_SHADOW
         ||  PGM_PAGE_GET_TYPE(pPage) > PGMPAGETYPE_ROM)
@@ -359,61 +359,6 @@ DECLINLINE(bool) tmTimerTryWithLink(PTMTIMER pTimer, TMTIMERSTATE enmStateNew, T
 }
 
 
-/**
- * Links a timer into the active list of a timer queue.
- *
- * @param   pQueue          The queue.
- * @param   pTimer          The timer.
- * @param   u64Expire       The timer expiration time.
- *
- * @remarks Called while owning the relevant queue lock.
- */
-DECL_FORCE_INLINE(void) tmTimerQueueLinkActive(PTMTIMERQUEUE pQueue, PTMTIMER pTimer, uint64_t u64Expire)
-{
-    Assert(!pTimer->offNext);
-    Assert(!pTimer->offPrev);
-    Assert(pTimer->enmState == TMTIMERSTATE_ACTIVE || pTimer->enmClock != TMCLOCK_VIRTUAL_SYNC); /* (active is not a stable state) */
-
-    PTMTIMER pCur = TMTIMER_GET_HEAD(pQueue);
-    if (pCur)
-    {
-        for (;; pCur = TMTIMER_GET_NEXT(pCur))
-        {
-            if (pCur->u64Expire > u64Expire)
-            {
-                const PTMTIMER pPrev = TMTIMER_GET_PREV(pCur);
-                TMTIMER_SET_NEXT(pTimer, pCur);
-                TMTIMER_SET_PREV(pTimer, pPrev);
-                if (pPrev)
-                    TMTIMER_SET_NEXT(pPrev, pTimer);
-                else
-                {
-                    TMTIMER_SET_HEAD(pQueue, pTimer);
-                    ASMAtomicWriteU64(&pQueue->u64Expire, u64Expire);
-                    DBGFTRACE_U64_TAG2(pTimer->CTX_SUFF(pVM), u64Expire, "tmTimerQueueLinkActive head", R3STRING(pTimer->pszDesc));
-                }
-                TMTIMER_SET_PREV(pCur, pTimer);
-                return;
-            }
-            if (!pCur->offNext)
-            {
-                TMTIMER_SET_NEXT(pCur, pTimer);
-                TMTIMER_SET_PREV(pTimer, pCur);
-                DBGFTRACE_U64_TAG2(pTimer->CTX_SUFF(pVM), u64Expire, "tmTimerQueueLinkActive tail", R3STRING(pTimer->pszDesc));
-                return;
-            }
-        }
-    }
-    else
-    {
-        TMTIMER_SET_HEAD(pQueue, pTimer);
-        ASMAtomicWriteU64(&pQueue->u64Expire, u64Expire);
-        DBGFTRACE_U64_TAG2(pTimer->CTX_SUFF(pVM), u64Expire, "tmTimerQueueLinkActive empty", R3STRING(pTimer->pszDesc));
-    }
-}
-
-
-
 /**
  * Schedules the given timer on the given queue.
  *
@@ -596,6 +541,19 @@ void tmTimerQueuesSanityChecks(PVM pVM, const char *pszWhere)
                     break;
             }
         }
+
+        /* The express lanes. */
+        for (unsigned iLvl = 0; iLvl < TMTIMER_SKIP_LEVELS; iLvl++)
+        {
+            pPrev = NULL;
+            for (PTMTIMER pCur = TMTIMER_GET_SKIP_HEAD(pQueue, iLvl); pCur; pPrev = pCur, pCur = TMTIMER_GET_SKIP_NEXT(pCur, iLvl))
+            {
+                AssertMsg(TMTIMER_GET_SKIP_PREV(pCur, iLvl) == pPrev,
+                          ("%s: lvl %u: %p != %p\n", pszWhere, iLvl, TMTIMER_GET_SKIP_PREV(pCur, iLvl), pPrev));
+                AssertMsg(tmTimerSkipLevels(pQueue, pCur) > iLvl, ("%s: lvl %u: %p\n", pszWhere, iLvl, pCur));
+                AssertMsg(pCur->offPrev || pCur == TMTIMER_GET_HEAD(pQueue), ("%s: lvl %u: %p\n", pszWhere, iLvl, pCur));
+            }
+        }
     }
 
 
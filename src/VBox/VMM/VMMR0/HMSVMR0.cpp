@@ -25,6 +25,7 @@
 
 #include <VBox/vmm/pdmapi.h>
 #include <VBox/vmm/dbgf.h>
+#include <VBox/vmm/dbgftrace.h>
 #include <VBox/vmm/iem.h>
 #include <VBox/vmm/iom.h>
 #include <VBox/vmm/tm.h>
@@ -3106,6 +3107,9 @@ static void hmR0SvmPreRunGuestCommitted(PVM pVM, PVMCPU pVCpu, PCPUMCTX pCtx, PS
     VMCPU_ASSERT_STATE(pVCpu, VMCPUSTATE_STARTED_HM);
     VMCPU_SET_STATE(pVCpu, VMCPUSTATE_STARTED_EXEC);            /* Indicate the start of guest execution. */
 
+    /* The guest may change its paging structures and use INVLPG without exiting. */
+    IEMTlbInvalidateAll(pVCpu);
+
     hmR0SvmInjectPendingEvent(pVCpu, pCtx);
 
     if (   pVCpu->hm.s.fPreloadGuestFpu
@@ -3349,6 +3353,12 @@ static int hmR0SvmRunGuestCodeNormal(PVM pVM, PVMCPU pVCpu, PCPUMCTX pCtx)
         HMSVM_EXITCODE_STAM_COUNTER_INC(SvmTransient.u64ExitCode);
         STAM_PROFILE_ADV_STOP_START(&pVCpu->hm.s.StatExit1, &pVCpu->hm.s.StatExit2, x);
         VBOXVMM_R0_HMSVM_VMEXIT(pVCpu, pCtx, SvmTransient.u64ExitCode, (PSVMVMCB)pVCpu->hm.s.svm.pvVmcb);
+        if (RT_UNLIKELY(pVCpu->fTraceGroups & DBGFTRACE_GRP_EXIT))
+        {
+            PSVMVMCB pVmcb = (PSVMVMCB)pVCpu->hm.s.svm.pvVmcb;
+            DBGFTraceRingRecord(pVCpu, DBGFTRACEEVT_VMEXIT, (uint32_t)SvmTransient.u64ExitCode, pVmcb->guest.u64RIP,
+                                pVmcb->ctrl.u64ExitInfo1);
+        }
         rc = hmR0SvmHandleExit(pVCpu, pCtx, &SvmTransient);
         STAM_PROFILE_ADV_STOP(&pVCpu->hm.s.StatExit2, x);
         if (rc != VINF_SUCCESS)
@@ -3427,6 +3437,12 @@ static int hmR0SvmRunGuestCodeStep(PVM pVM, PVMCPU pVCpu, PCPUMCTX pCtx)
         HMSVM_EXITCODE_STAM_COUNTER_INC(SvmTransient.u64ExitCode);
         STAM_PROFILE_ADV_STOP_START(&pVCpu->hm.s.StatExit1, &pVCpu->hm.s.StatExit2, x);
         VBOXVMM_R0_HMSVM_VMEXIT(pVCpu, pCtx, SvmTransient.u64ExitCode, (PSVMVMCB)pVCpu->hm.s.svm.pvVmcb);
+        if (RT_UNLIKELY(pVCpu->fTraceGroups & DBGFTRACE_GRP_EXIT))
+        {
+            PSVMVMCB pVmcb = (PSVMVMCB)pVCpu->hm.s.svm.pvVmcb;
+            DBGFTraceRingRecord(pVCpu, DBGFTRACEEVT_VMEXIT, (uint32_t)SvmTransient.u64ExitCode, pVmcb->guest.u64RIP,
+                                pVmcb->ctrl.u64ExitInfo1);
+        }
         rc = hmR0SvmHandleExit(pVCpu, pCtx, &SvmTransient);
         STAM_PROFILE_ADV_STOP(&pVCpu->hm.s.StatExit2, x);
         if (rc != VINF_SUCCESS)
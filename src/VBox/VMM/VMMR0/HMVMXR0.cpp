@@ -26,6 +26,7 @@
 
 #include <VBox/vmm/pdmapi.h>
 #include <VBox/vmm/dbgf.h>
+#include <VBox/vmm/dbgftrace.h>
 #include <VBox/vmm/iem.h>
 #include <VBox/vmm/iom.h>
 #include <VBox/vmm/selm.h>
@@ -8476,6 +8477,9 @@ static void hmR0VmxPreRunGuestCommitted(PVM pVM, PVMCPU pVCpu, PCPUMCTX pMixedCt
     VMCPU_ASSERT_STATE(pVCpu, VMCPUSTATE_STARTED_HM);
     VMCPU_SET_STATE(pVCpu, VMCPUSTATE_STARTED_EXEC);            /* Indicate the start of guest execution. */
 
+    /* The guest may change its paging structures and use INVLPG without exiting. */
+    IEMTlbInvalidateAll(pVCpu);
+
 #ifdef HMVMX_ALWAYS_SWAP_FPU_STATE
     if (!CPUMIsGuestFPUStateActive(pVCpu))
         CPUMR0LoadGuestFPU(pVM, pVCpu, pMixedCtx);
@@ -8769,6 +8773,12 @@ static int hmR0VmxRunGuestCodeNormal(PVM pVM, PVMCPU pVCpu, PCPUMCTX pCtx)
             hmR0VmxSaveGuestState(pVCpu, pCtx);
             VBOXVMM_R0_HMVMX_VMEXIT(pVCpu, pCtx, VmxTransient.uExitReason, VmxTransient.uExitQualification);
         }
+        if (RT_UNLIKELY(pVCpu->fTraceGroups & DBGFTRACE_GRP_EXIT))
+        {
+            hmR0VmxReadExitQualificationVmcs(pVCpu, &VmxTransient);
+            hmR0VmxSaveGuestRip(pVCpu, pCtx);
+            DBGFTraceRingRecord(pVCpu, DBGFTRACEEVT_VMEXIT, VmxTransient.uExitReason, pCtx->rip, VmxTransient.uExitQualification);
+        }
 
         /* Handle the VM-exit. */
 #ifdef HMVMX_USE_FUNCTION_TABLE
@@ -8853,6 +8863,12 @@ static int hmR0VmxRunGuestCodeStep(PVM pVM, PVMCPU pVCpu, PCPUMCTX pCtx)
             hmR0VmxSaveGuestState(pVCpu, pCtx);
             VBOXVMM_R0_HMVMX_VMEXIT(pVCpu, pCtx, VmxTransient.uExitReason, VmxTransient.uExitQualification);
         }
+        if (RT_UNLIKELY(pVCpu->fTraceGroups & DBGFTRACE_GRP_EXIT))
+        {
+            hmR0VmxReadExitQualificationVmcs(pVCpu, &VmxTransient);
+            hmR0VmxSaveGuestRip(pVCpu, pCtx);
+            DBGFTraceRingRecord(pVCpu, DBGFTRACEEVT_VMEXIT, VmxTransient.uExitReason, pCtx->rip, VmxTransient.uExitQualification);
+        }
 
         /* Handle the VM-exit - we quit earlier on certain VM-exits, see hmR0VmxHandleExitStep(). */
         rcStrict = hmR0VmxHandleExitStep(pVCpu, pCtx, &VmxTransient, VmxTransient.uExitReason, uCsStart, uRipStart);
@@ -49,6 +49,15 @@
  *      - Variable length byte strings. This can be used to get/put binary
  *        objects like for instance RTMAC.
  *
+ *
+ * @section sec_cfgm_lookup         Lookups
+ *
+ * Child nodes and values are kept in name sorted doubly linked lists.  Once a
+ * node has CFGM_HASH_THRESHOLD or more children (or values), it also gets a
+ * hash index so that the many queries made while constructing devices and
+ * drivers don't have to walk the lists.  The index is only an accelerator, if
+ * it cannot be allocated the lists are searched instead.
+ *
  */
 
 
@@ -155,6 +164,244 @@ static void cfgmR3StrFree(PVM pVM, char *pszString)
 }
 
 
+/**
+ * Calculates the hash of a node or value name (sdbm).
+ *
+ * @returns The hash value.
+ * @param   pchName             The name, doesn't need to be terminated.
+ * @param   cchName             The length of the name.
+ */
+DECLINLINE(uint32_t) cfgmR3HashName(const char *pchName, size_t cchName)
+{
+    uint32_t uHash = 0;
+    while (cchName-- > 0)
+        uHash = (uint8_t)*pchName++ + (uHash << 6) + (uHash << 16) - uHash;
+    return uHash;
+}
+
+
+/**
+ * Frees the hash indexes of a node.
+ *
+ * @param   pNode               The node.
+ */
+static void cfgmR3HashFree(PCFGMNODE pNode)
+{
+    if (pNode->papChildHash)
+    {
+        cfgmR3MemFree(pNode->pVM, pNode->papChildHash);
+        pNode->papChildHash = NULL;
+        pNode->cChildHash   = 0;
+    }
+    if (pNode->papLeafHash)
+    {
+        cfgmR3MemFree(pNode->pVM, pNode->papLeafHash);
+        pNode->papLeafHash  = NULL;
+        pNode->cLeafHash    = 0;
+    }
+}
+
+
+/**
+ * Calculates the bucket count for a hash index of @a cEntries entries.
+ *
+ * @returns Power of two bucket count.
+ * @param   cEntries            The number of entries to index.
+ */
+DECLINLINE(uint32_t) cfgmR3HashBuckets(uint32_t cEntries)
+{
+    uint32_t cBuckets = CFGM_HASH_THRESHOLD;
+    while (cBuckets < cEntries)
+        cBuckets <<= 1;
+    return cBuckets;
+}
+
+
+/**
+ * (Re)builds the child node hash index of a node.
+ *
+ * Running out of memory here isn't fatal, the node just falls back on
+ * linear list lookups.
+ *
+ * @param   pNode               The node.
+ */
+static void cfgmR3ChildHashRebuild(PCFGMNODE pNode)
+{
+    if (pNode->papChildHash)
+    {
+        cfgmR3MemFree(pNode->pVM, pNode->papChildHash);
+        pNode->papChildHash = NULL;
+        pNode->cChildHash   = 0;
+    }
+
+    uint32_t const cBuckets = cfgmR3HashBuckets(pNode->cChildren);
+    PCFGMNODE *papHash = (PCFGMNODE *)cfgmR3MemAlloc(pNode->pVM, MM_TAG_CFGM, sizeof(papHash[0]) * cBuckets);
+    if (papHash)
+    {
+        memset(papHash, 0, sizeof(papHash[0]) * cBuckets);
+        for (PCFGMNODE pChild = pNode->pFirstChild; pChild; pChild = pChild->pNext)
+        {
+            PCFGMNODE *ppHead = &papHash[pChild->uHash & (cBuckets - 1)];
+            pChild->pHashNext = *ppHead;
+            *ppHead = pChild;
+        }
+        pNode->papChildHash = papHash;
+        pNode->cChildHash   = cBuckets;
+    }
+}
+
+
+/**
+ * Adds a freshly linked child node to the hash index of its parent, creating
+ * or growing the index as needed.
+ *
+ * @param   pNode               The parent node.  cChildren must already
+ *                              include @a pChild.
+ * @param   pChild              The new child.
+ */
+static void cfgmR3ChildHashInsert(PCFGMNODE pNode, PCFGMNODE pChild)
+{
+    pChild->pHashNext = NULL;
+    if (pNode->papChildHash && pNode->cChildren <= pNode->cChildHash * 2)
+    {
+        PCFGMNODE *ppHead = &pNode->papChildHash[pChild->uHash & (pNode->cChildHash - 1)];
+        pChild->pHashNext = *ppHead;
+        *ppHead = pChild;
+    }
+    else if (pNode->cChildren >= CFGM_HASH_THRESHOLD)
+        cfgmR3ChildHashRebuild(pNode);
+}
+
+
+/**
+ * Removes a child node from the hash index of its parent.
+ *
+ * @param   pNode               The parent node.
+ * @param   pChild              The child being unlinked.
+ */
+static void cfgmR3ChildHashRemove(PCFGMNODE pNode, PCFGMNODE pChild)
+{
+    if (pNode->papChildHash)
+    {
+        PCFGMNODE *ppCur = &pNode->papChildHash[pChild->uHash & (pNode->cChildHash - 1)];
+        while (*ppCur && *ppCur != pChild)
+            ppCur = &(*ppCur)->pHashNext;
+        Assert(*ppCur == pChild);
+        if (*ppCur)
+            *ppCur = pChild->pHashNext;
+    }
+    pChild->pHashNext = NULL;
+}
+
+
+/**
+ * (Re)builds the value leaf hash index of a node.
+ *
+ * @param   pNode               The node.
+ */
+static void cfgmR3LeafHashRebuild(PCFGMNODE pNode)
+{
+    if (pNode->papLeafHash)
+    {
+        cfgmR3MemFree(pNode->pVM, pNode->papLeafHash);
+        pNode->papLeafHash  = NULL;
+        pNode->cLeafHash    = 0;
+    }
+
+    uint32_t const cBuckets = cfgmR3HashBuckets(pNode->cLeaves);
+    PCFGMLEAF *papHash = (PCFGMLEAF *)cfgmR3MemAlloc(pNode->pVM, MM_TAG_CFGM, sizeof(papHash[0]) * cBuckets);
+    if (papHash)
+    {
+        memset(papHash, 0, sizeof(papHash[0]) * cBuckets);
+        for (PCFGMLEAF pLeaf = pNode->pFirstLeaf; pLeaf; pLeaf = pLeaf->pNext)
+        {
+            PCFGMLEAF *ppHead = &papHash[pLeaf->uHash & (cBuckets - 1)];
+            pLeaf->pHashNext = *ppHead;
+            *ppHead = pLeaf;
+        }
+        pNode->papLeafHash  = papHash;
+        pNode->cLeafHash    = cBuckets;
+    }
+}
+
+
+/**
+ * Adds a freshly linked leaf to the hash index of its node, creating or
+ * growing the index as needed.
+ *
+ * @param   pNode               The node.  cLeaves must already include
+ *                              @a pLeaf.
+ * @param   pLeaf               The new leaf.
+ */
+static void cfgmR3LeafHashInsert(PCFGMNODE pNode, PCFGMLEAF pLeaf)
+{
+    pLeaf->pHashNext = NULL;
+    if (pNode->papLeafHash && pNode->cLeaves <= pNode->cLeafHash * 2)
+    {
+        PCFGMLEAF *ppHead = &pNode->papLeafHash[pLeaf->uHash & (pNode->cLeafHash - 1)];
+        pLeaf->pHashNext = *ppHead;
+        *ppHead = pLeaf;
+    }
+    else if (pNode->cLeaves >= CFGM_HASH_THRESHOLD)
+        cfgmR3LeafHashRebuild(pNode);
+}
+
+
+/**
+ * Removes a leaf from the hash index of its node.
+ *
+ * @param   pNode               The node.
+ * @param   pLeaf               The leaf being unlinked.
+ */
+static void cfgmR3LeafHashRemove(PCFGMNODE pNode, PCFGMLEAF pLeaf)
+{
+    if (pNode->papLeafHash)
+    {
+        PCFGMLEAF *ppCur = &pNode->papLeafHash[pLeaf->uHash & (pNode->cLeafHash - 1)];
+        while (*ppCur && *ppCur != pLeaf)
+            ppCur = &(*ppCur)->pHashNext;
+        Assert(*ppCur == pLeaf);
+        if (*ppCur)
+            *ppCur = pLeaf->pHashNext;
+    }
+    pLeaf->pHashNext = NULL;
+}
+
+
+/**
+ * Moves the children, values and hash indexes of one node over to another.
+ *
+ * @param   pDst                The destination node, must be empty.
+ * @param   pSrc                The source node, left empty.
+ */
+static void cfgmR3MoveContent(PCFGMNODE pDst, PCFGMNODE pSrc)
+{
+    Assert(!pDst->pFirstChild && !pDst->pFirstLeaf);
+    Assert(pDst->pVM == pSrc->pVM);
+    cfgmR3HashFree(pDst);
+
+    pDst->pFirstChild   = pSrc->pFirstChild;
+    pDst->pFirstLeaf    = pSrc->pFirstLeaf;
+    pDst->papChildHash  = pSrc->papChildHash;
+    pDst->papLeafHash   = pSrc->papLeafHash;
+    pDst->cChildHash    = pSrc->cChildHash;
+    pDst->cLeafHash     = pSrc->cLeafHash;
+    pDst->cChildren     = pSrc->cChildren;
+    pDst->cLeaves       = pSrc->cLeaves;
+    for (PCFGMNODE pChild = pDst->pFirstChild; pChild; pChild = pChild->pNext)
+        pChild->pParent = pDst;
+
+    pSrc->pFirstChild   = NULL;
+    pSrc->pFirstLeaf    = NULL;
+    pSrc->papChildHash  = NULL;
+    pSrc->papLeafHash   = NULL;
+    pSrc->cChildHash    = 0;
+    pSrc->cLeafHash     = 0;
+    pSrc->cChildren     = 0;
+    pSrc->cLeaves       = 0;
+}
+
+
 /**
  * Frees one node, leaving any children or leaves to the caller.
  *
@@ -162,6 +409,7 @@ static void cfgmR3StrFree(PVM pVM, char *pszString)
  */
 static void cfgmR3FreeNodeOnly(PCFGMNODE pNode)
 {
+    cfgmR3HashFree(pNode);
     pNode->pFirstLeaf    = NULL;
     pNode->pFirstChild   = NULL;
     pNode->pNext         = NULL;
@@ -1255,19 +1503,31 @@ static int cfgmR3ResolveNode(PCFGMNODE pNode, const char *pszPath, PCFGMNODE *pp
             pszNext = strchr(pszPath,  '\0');
         RTUINT cchName = pszNext - pszPath;
 
-        /* search child list. */
-        pChild = pNode->pFirstChild;
-        for ( ; pChild; pChild = pChild->pNext)
-            if (pChild->cchName == cchName)
-            {
-                int iDiff = memcmp(pszPath, pChild->szName, cchName);
-                if (iDiff <= 0)
-                {
-                    if (iDiff != 0)
-                        pChild = NULL;
+        /* search the child hash index or list. */
+        if (pNode->papChildHash)
+        {
+            uint32_t const uHash = cfgmR3HashName(pszPath, cchName);
+            for (pChild = pNode->papChildHash[uHash & (pNode->cChildHash - 1)]; pChild; pChild = pChild->pHashNext)
+                if (   pChild->uHash   == uHash
+                    && pChild->cchName == cchName
+                    && !memcmp(pszPath, pChild->szName, cchName))
                     break;
+        }
+        else
+        {
+            pChild = pNode->pFirstChild;
+            for ( ; pChild; pChild = pChild->pNext)
+                if (pChild->cchName == cchName)
+                {
+                    int iDiff = memcmp(pszPath, pChild->szName, cchName);
+                    if (iDiff <= 0)
+                    {
+                        if (iDiff != 0)
+                            pChild = NULL;
+                        break;
+                    }
                 }
-            }
+        }
         if (!pChild)
             return VERR_CFGM_CHILD_NOT_FOUND;
 
@@ -1295,6 +1555,20 @@ static int cfgmR3ResolveLeaf(PCFGMNODE pNode, const char *pszName, PCFGMLEAF *pp
         return VERR_CFGM_NO_PARENT;
 
     size_t      cchName = strlen(pszName);
+    if (pNode->papLeafHash)
+    {
+        uint32_t const uHash = cfgmR3HashName(pszName, cchName);
+        for (PCFGMLEAF pLeaf = pNode->papLeafHash[uHash & (pNode->cLeafHash - 1)]; pLeaf; pLeaf = pLeaf->pHashNext)
+            if (   pLeaf->uHash   == uHash
+                && pLeaf->cchName == cchName
+                && !memcmp(pszName, pLeaf->szName, cchName))
+            {
+                *ppLeaf = pLeaf;
+                return VINF_SUCCESS;
+            }
+        return VERR_CFGM_VALUE_NOT_FOUND;
+    }
+
     PCFGMLEAF   pLeaf   = pNode->pFirstLeaf;
     while (pLeaf)
     {
@@ -1353,6 +1627,14 @@ VMMR3DECL(PCFGMNODE) CFGMR3CreateTree(PUVM pUVM)
         pNew->pParent       = NULL;
         pNew->pFirstChild   = NULL;
         pNew->pFirstLeaf    = NULL;
+        pNew->pHashNext     = NULL;
+        pNew->papChildHash  = NULL;
+        pNew->papLeafHash   = NULL;
+        pNew->cChildHash    = 0;
+        pNew->cLeafHash     = 0;
+        pNew->cChildren     = 0;
+        pNew->cLeaves       = 0;
+        pNew->uHash         = 0;
         pNew->pVM           = pUVM ? pUVM->pVM : NULL;
         pNew->fRestrictedRoot = false;
         pNew->cchName       = 0;
@@ -1502,10 +1784,7 @@ VMMR3DECL(int) CFGMR3InsertSubTree(PCFGMNODE pNode, const char *pszName, PCFGMNO
         Assert(!pNewChild->pFirstChild);
         Assert(!pNewChild->pFirstLeaf);
 
-        pNewChild->pFirstChild = pSubTree->pFirstChild;
-        pNewChild->pFirstLeaf = pSubTree->pFirstLeaf;
-        for (PCFGMNODE pChild = pNewChild->pFirstChild; pChild; pChild = pChild->pNext)
-            pChild->pParent = pNewChild;
+        cfgmR3MoveContent(pNewChild, pSubTree);
 
         if (ppChild)
             *ppChild = pNewChild;
@@ -1555,10 +1834,7 @@ VMMR3DECL(int) CFGMR3ReplaceSubTree(PCFGMNODE pRoot, PCFGMNODE pNewRoot)
     /*
      * Copy all the properties from the new root to the current one.
      */
-    pRoot->pFirstLeaf       = pNewRoot->pFirstLeaf;
-    pRoot->pFirstChild      = pNewRoot->pFirstChild;
-    for (PCFGMNODE pChild = pRoot->pFirstChild; pChild; pChild = pChild->pNext)
-        pChild->pParent     = pRoot;
+    cfgmR3MoveContent(pRoot, pNewRoot);
 
     cfgmR3FreeNodeOnly(pNewRoot);
 
@@ -1778,6 +2054,13 @@ VMMR3DECL(int) CFGMR3InsertNode(PCFGMNODE pNode, const char *pszName, PCFGMNODE
                 pNew->pParent       = pNode;
                 pNew->pFirstChild   = NULL;
                 pNew->pFirstLeaf    = NULL;
+                pNew->papChildHash  = NULL;
+                pNew->papLeafHash   = NULL;
+                pNew->cChildHash    = 0;
+                pNew->cLeafHash     = 0;
+                pNew->cChildren     = 0;
+                pNew->cLeaves       = 0;
+                pNew->uHash         = cfgmR3HashName(pszName, cchName);
                 pNew->pVM           = pNode->pVM;
                 pNew->fRestrictedRoot = false;
                 pNew->cchName       = cchName;
@@ -1794,6 +2077,8 @@ VMMR3DECL(int) CFGMR3InsertNode(PCFGMNODE pNode, const char *pszName, PCFGMNODE
                 pNew->pNext         = pNext;
                 if (pNext)
                     pNext->pPrev    = pNew;
+                pNode->cChildren++;
+                cfgmR3ChildHashInsert(pNode, pNew);
 
                 if (ppChild)
                     *ppChild = pNew;
@@ -1917,6 +2202,7 @@ static int cfgmR3InsertLeaf(PCFGMNODE pNode, const char *pszName, PCFGMLEAF *ppL
             PCFGMLEAF pNew = (PCFGMLEAF)cfgmR3MemAlloc(pNode->pVM, MM_TAG_CFGM, sizeof(*pNew) + cchName);
             if (pNew)
             {
+                pNew->uHash         = cfgmR3HashName(pszName, cchName);
                 pNew->cchName       = cchName;
                 memcpy(pNew->szName, pszName, cchName + 1);
 
@@ -1931,6 +2217,8 @@ static int cfgmR3InsertLeaf(PCFGMNODE pNode, const char *pszName, PCFGMLEAF *ppL
                 pNew->pNext         = pNext;
                 if (pNext)
                     pNext->pPrev    = pNew;
+                pNode->cLeaves++;
+                cfgmR3LeafHashInsert(pNode, pNew);
 
                 *ppLeaf = pNew;
                 rc = VINF_SUCCESS;
@@ -1971,6 +2259,12 @@ VMMR3DECL(void) CFGMR3RemoveNode(PCFGMNODE pNode)
         /*
          * Unlink ourselves.
          */
+        if (pNode->pParent)
+        {
+            cfgmR3ChildHashRemove(pNode->pParent, pNode);
+            Assert(pNode->pParent->cChildren > 0);
+            pNode->pParent->cChildren--;
+        }
         if (pNode->pPrev)
             pNode->pPrev->pNext = pNode->pNext;
         else
@@ -2005,6 +2299,9 @@ static void cfgmR3RemoveLeaf(PCFGMNODE pNode, PCFGMLEAF pLeaf)
         /*
          * Unlink.
          */
+        cfgmR3LeafHashRemove(pNode, pLeaf);
+        Assert(pNode->cLeaves > 0);
+        pNode->cLeaves--;
         if (pLeaf->pPrev)
             pLeaf->pPrev->pNext = pLeaf->pNext;
         else
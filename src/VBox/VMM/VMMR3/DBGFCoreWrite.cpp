@@ -42,6 +42,20 @@
  *    ...
  * Memory dump
  *
+ * Memory ranges are written page by page.  When writing to a regular file,
+ * zero pages (which includes ballooned and never touched RAM) can be left as
+ * holes (DBGFCORE_F_SKIP_ZERO_PAGES), making the core a sparse file which
+ * reads back exactly like the full one.
+ *
+ * With DBGFCORE_F_GZIP the whole core is gzip compressed.  The stream is cut
+ * into DBGFCORE_ZIP_BLOCK_SIZE blocks that worker threads compress into
+ * separate gzip members while the EMT reads the next blocks out of guest
+ * memory.  Concatenated gzip members make a valid gzip file, so gunzip and
+ * friends read the result like any other.  Blocks consisting of zeros only
+ * reuse a member compressed up front.
+ *
+ * Compressed cores and cores written to pipes or stream callbacks
+ * (DBGFR3CoreWriteToStream) are written strictly sequentially.
  */
 
 
@@ -50,8 +64,10 @@
 *********************************************************************************************************************************/
 #define LOG_GROUP LOG_GROUP_DBGF
 #include <iprt/param.h>
+#include <iprt/asm.h>
 #include <iprt/file.h>
 #include <iprt/mem.h>
+#include <iprt/time.h>
 
 #include "DBGFInternal.h"
 
@@ -97,26 +113,157 @@ static const char *g_pcszCoreVBoxCpu  = "VBCPU";
  */
 typedef struct DBGFCOREDATA
 {
-    /** The name of the file to write the file to. */
-    const char *pszFilename;
-    /** Whether to replace (/overwrite) any existing file. */
-    bool        fReplaceFile;
+    /** The name of the file to write the file to, NULL if writing to
+     *  pfnWrite. */
+    const char         *pszFilename;
+    /** The stream output callback, NULL if writing to a file. */
+    PFNDBGFCOREWRITE    pfnWrite;
+    /** User argument for pfnWrite. */
+    void               *pvUser;
+    /** DBGFCORE_F_XXX. */
+    uint32_t            fFlags;
 } DBGFCOREDATA;
 /** Pointer to the guest core writer data.  */
 typedef DBGFCOREDATA *PDBGFCOREDATA;
 
 
+/**
+ * The core file output.
+ */
+typedef struct DBGFCOREOUT
+{
+    /** The output file, NIL_RTFILE when writing to pfnWrite. */
+    RTFILE              hFile;
+    /** The stream output callback, NULL when writing to hFile. */
+    PFNDBGFCOREWRITE    pfnWrite;
+    /** User argument for pfnWrite. */
+    void               *pvUser;
+    /** Whether zero pages can be left as holes in the output. */
+    bool                fSkipZeroPages;
+    /** Whether there is a hole before the current offset that needs seeking
+     *  past (or extending the file at the end). */
+    bool                fHole;
+    /** The current (uncompressed) output offset. */
+    uint64_t            off;
+    /** The number of bytes of zero pages skipped. */
+    uint64_t            cbSkipped;
+    /** The compressor, NULL if not compressing. */
+    PDBGFCOREZIP        pZip;
+} DBGFCOREOUT;
+/** Pointer to the core file output. */
+typedef DBGFCOREOUT *PDBGFCOREOUT;
+
+
+/**
+ * Writes raw bytes to the output file or stream.
+ *
+ * @returns IPRT status code.
+ * @param   pOut            The output.
+ * @param   pvBuf           What to write.
+ * @param   cbBuf           How much to write.
+ */
+static int dbgfR3CoreOutWriteRaw(PDBGFCOREOUT pOut, const void *pvBuf, size_t cbBuf)
+{
+    if (pOut->pfnWrite)
+        return pOut->pfnWrite(pOut->pvUser, pvBuf, cbBuf);
+    return RTFileWrite(pOut->hFile, pvBuf, cbBuf, NULL /* all */);
+}
+
+
+/**
+ * @callback_method_impl{FNDBGFCOREWRITE, Writes gzip members to the output.}
+ */
+static DECLCALLBACK(int) dbgfR3CoreOutZipOutput(void *pvUser, const void *pvBuf, size_t cbBuf)
+{
+    return dbgfR3CoreOutWriteRaw((PDBGFCOREOUT)pvUser, pvBuf, cbBuf);
+}
+
+
+/**
+ * Writes to the core file.
+ *
+ * @returns IPRT status code.
+ * @param   pOut            The output.
+ * @param   pvBuf           What to write.
+ * @param   cbBuf           How much to write.
+ * @param   fZero           Whether it's all zeros (only relevant when
+ *                          compressing).
+ */
+static int dbgfR3CoreOutWrite(PDBGFCOREOUT pOut, const void *pvBuf, size_t cbBuf, bool fZero)
+{
+    int rc;
+    if (pOut->pZip)
+        rc = dbgfR3CoreZipWrite(pOut->pZip, pvBuf, cbBuf, fZero);
+    else
+    {
+        if (pOut->fHole)
+        {
+            rc = RTFileSeek(pOut->hFile, pOut->off, RTFILE_SEEK_BEGIN, NULL);
+            if (RT_FAILURE(rc))
+                return rc;
+            pOut->fHole = false;
+        }
+        rc = dbgfR3CoreOutWriteRaw(pOut, pvBuf, cbBuf);
+    }
+    if (RT_SUCCESS(rc))
+        pOut->off += cbBuf;
+    return rc;
+}
+
+
+/**
+ * Writes a guest memory page to the core file, leaving a hole instead if
+ * it's a zero page and the output allows it.
+ *
+ * @returns IPRT status code.
+ * @param   pOut            The output.
+ * @param   pvPage          The page.
+ */
+static int dbgfR3CoreOutWritePage(PDBGFCOREOUT pOut, const void *pvPage)
+{
+    bool const fZero = ASMMemIsZeroPage(pvPage);
+    if (fZero && pOut->fSkipZeroPages)
+    {
+        pOut->off       += PAGE_SIZE;
+        pOut->cbSkipped += PAGE_SIZE;
+        pOut->fHole      = true;
+        return VINF_SUCCESS;
+    }
+    return dbgfR3CoreOutWrite(pOut, pvPage, PAGE_SIZE, fZero);
+}
+
+
+/**
+ * Flushes the core file output, i.e. writes the last compressed blocks or
+ * extends the file over a trailing hole.
+ *
+ * @returns IPRT status code.
+ * @param   pOut            The output.
+ */
+static int dbgfR3CoreOutFlush(PDBGFCOREOUT pOut)
+{
+    int rc = VINF_SUCCESS;
+    if (pOut->pZip)
+        rc = dbgfR3CoreZipFlush(pOut->pZip);
+    else if (pOut->fHole)
+    {
+        rc = RTFileSetSize(pOut->hFile, pOut->off);
+        pOut->fHole = false;
+    }
+    return rc;
+}
+
 
 /**
  * ELF function to write 64-bit ELF header.
  *
- * @param   hFile           The file to write to.
+ * @param   pOut            The output to write to.
  * @param   cProgHdrs       Number of program headers.
  * @param   cSecHdrs        Number of section headers.
  *
  * @return IPRT status code.
  */
-static int Elf64WriteElfHdr(RTFILE hFile, uint16_t cProgHdrs, uint16_t cSecHdrs)
+static int Elf64WriteElfHdr(PDBGFCOREOUT pOut, uint16_t cProgHdrs, uint16_t cSecHdrs)
 {
     Elf64_Ehdr ElfHdr;
     RT_ZERO(ElfHdr);
@@ -141,14 +288,14 @@ static int Elf64WriteElfHdr(RTFILE hFile, uint16_t cProgHdrs, uint16_t cSecHdrs)
     ElfHdr.e_phentsize       = sizeof(Elf64_Phdr);
     ElfHdr.e_shentsize       = sizeof(Elf64_Shdr);
 
-    return RTFileWrite(hFile, &ElfHdr, sizeof(ElfHdr), NULL /* all */);
+    return dbgfR3CoreOutWrite(pOut, &ElfHdr, sizeof(ElfHdr), false /*fZero*/);
 }
 
 
 /**
  * ELF function to write 64-bit program header.
  *
- * @param   hFile           The file to write to.
+ * @param   pOut            The output to write to.
  * @param   Type            Type of program header (PT_*).
  * @param   fFlags          Flags (access permissions, PF_*).
  * @param   offFileData     File offset of contents.
@@ -158,7 +305,7 @@ static int Elf64WriteElfHdr(RTFILE hFile, uint16_t cProgHdrs, uint16_t cSecHdrs)
  *
  * @return IPRT status code.
  */
-static int Elf64WriteProgHdr(RTFILE hFile, uint32_t Type, uint32_t fFlags, uint64_t offFileData, uint64_t cbFileData,
+static int Elf64WriteProgHdr(PDBGFCOREOUT pOut, uint32_t Type, uint32_t fFlags, uint64_t offFileData, uint64_t cbFileData,
                              uint64_t cbMemData, RTGCPHYS Phys)
 {
     Elf64_Phdr ProgHdr;
@@ -170,7 +317,7 @@ static int Elf64WriteProgHdr(RTFILE hFile, uint32_t Type, uint32_t fFlags, uint6
     ProgHdr.p_memsz  = cbMemData;
     ProgHdr.p_paddr  = Phys;
 
-    return RTFileWrite(hFile, &ProgHdr, sizeof(ProgHdr), NULL /* all */);
+    return dbgfR3CoreOutWrite(pOut, &ProgHdr, sizeof(ProgHdr), false /*fZero*/);
 }
 
 
@@ -198,7 +345,7 @@ static uint64_t Elf64NoteSectionSize(const char *pszName, uint64_t cbData)
 /**
  * Elf function to write 64-bit note header.
  *
- * @param   hFile       The file to write to.
+ * @param   pOut        The output to write to.
  * @param   Type        Type of this section.
  * @param   pszName     Name of this section.
  * @param   pvData      Opaque pointer to the data, if NULL only computes size.
@@ -206,7 +353,7 @@ static uint64_t Elf64NoteSectionSize(const char *pszName, uint64_t cbData)
  *
  * @returns IPRT status code.
  */
-static int Elf64WriteNoteHdr(RTFILE hFile, uint16_t Type, const char *pszName, const void *pvData, uint64_t cbData)
+static int Elf64WriteNoteHdr(PDBGFCOREOUT pOut, uint16_t Type, const char *pszName, const void *pvData, uint64_t cbData)
 {
     AssertReturn(pvData, VERR_INVALID_POINTER);
     AssertReturn(cbData > 0, VERR_NO_DATA);
@@ -250,41 +397,41 @@ static int Elf64WriteNoteHdr(RTFILE hFile, uint16_t Type, const char *pszName, c
     /*
      * Write note header.
      */
-    int rc = RTFileWrite(hFile, &ElfNoteHdr, sizeof(ElfNoteHdr), NULL /* all */);
+    int rc = dbgfR3CoreOutWrite(pOut, &ElfNoteHdr, sizeof(ElfNoteHdr), false /*fZero*/);
     if (RT_SUCCESS(rc))
     {
         /*
          * Write note name.
          */
-        rc = RTFileWrite(hFile, szNoteName, cbName, NULL /* all */);
+        rc = dbgfR3CoreOutWrite(pOut, szNoteName, cbName, false /*fZero*/);
         if (RT_SUCCESS(rc))
         {
             /*
              * Write note name padding if required.
              */
             if (cbNameAlign > cbName)
-                rc = RTFileWrite(hFile, s_achPad, cbNameAlign - cbName, NULL);
+                rc = dbgfR3CoreOutWrite(pOut, s_achPad, cbNameAlign - cbName, false /*fZero*/);
 
             if (RT_SUCCESS(rc))
             {
                 /*
                  * Write note data.
                  */
-                rc = RTFileWrite(hFile, pvData, cbData, NULL /* all */);
+                rc = dbgfR3CoreOutWrite(pOut, pvData, cbData, false /*fZero*/);
                 if (RT_SUCCESS(rc))
                 {
                     /*
                      * Write note data padding if required.
                      */
                     if (cbDataAlign > cbData)
-                        rc = RTFileWrite(hFile, s_achPad, cbDataAlign - cbData, NULL /* all*/);
+                        rc = dbgfR3CoreOutWrite(pOut, s_achPad, cbDataAlign - cbData, false /*fZero*/);
                 }
             }
         }
     }
 
     if (RT_FAILURE(rc))
-        LogRel((DBGFLOG_NAME ": RTFileWrite failed. rc=%Rrc pszName=%s cbName=%u cbNameAlign=%u cbData=%u cbDataAlign=%u\n",
+        LogRel((DBGFLOG_NAME ": Writing note failed. rc=%Rrc pszName=%s cbName=%u cbNameAlign=%u cbData=%u cbDataAlign=%u\n",
                 rc, pszName, cbName, cbNameAlign, cbData, cbDataAlign));
 
     return rc;
@@ -390,9 +537,10 @@ static void dbgfR3GetCoreCpu(PVM pVM, PCPUMCTX pCtx, PDBGFCORECPU pDbgfCpu)
  *
  * @returns VBox status code
  * @param   pVM                 The cross context VM structure.
- * @param   hFile               The file to write to.  Caller closes this.
+ * @param   pOut                The output to write to.  Caller flushes and
+ *                              closes this.
  */
-static int dbgfR3CoreWriteWorker(PVM pVM, RTFILE hFile)
+static int dbgfR3CoreWriteWorker(PVM pVM, PDBGFCOREOUT pOut)
 {
     /*
      * Collect core information.
@@ -415,7 +563,7 @@ static int dbgfR3CoreWriteWorker(PVM pVM, RTFILE hFile)
     /*
      * Compute the file layout (see pg_dbgf_vmcore).
      */
-    uint64_t const offElfHdr          = RTFileTell(hFile);
+    uint64_t const offElfHdr          = pOut->off;
     uint64_t const offNoteSection     = offElfHdr         + sizeof(Elf64_Ehdr);
     uint64_t const offLoadSections    = offNoteSection    + sizeof(Elf64_Phdr);
     uint64_t const cbLoadSections     = cMemRanges * sizeof(Elf64_Phdr);
@@ -431,7 +579,7 @@ static int dbgfR3CoreWriteWorker(PVM pVM, RTFILE hFile)
     /*
      * Write ELF header.
      */
-    int rc = Elf64WriteElfHdr(hFile, cProgHdrs, 0 /* cSecHdrs */);
+    int rc = Elf64WriteElfHdr(pOut, cProgHdrs, 0 /* cSecHdrs */);
     if (RT_FAILURE(rc))
     {
         LogRel((DBGFLOG_NAME ": Elf64WriteElfHdr failed. rc=%Rrc\n", rc));
@@ -441,8 +589,8 @@ static int dbgfR3CoreWriteWorker(PVM pVM, RTFILE hFile)
     /*
      * Write PT_NOTE program header.
      */
-    Assert(RTFileTell(hFile) == offNoteSection);
-    rc = Elf64WriteProgHdr(hFile, PT_NOTE, PF_R,
+    Assert(pOut->off == offNoteSection);
+    rc = Elf64WriteProgHdr(pOut, PT_NOTE, PF_R,
                            offNoteSectionData,  /* file offset to contents */
                            cbNoteSectionData,   /* size in core file */
                            cbNoteSectionData,   /* size in memory */
@@ -456,7 +604,7 @@ static int dbgfR3CoreWriteWorker(PVM pVM, RTFILE hFile)
     /*
      * Write PT_LOAD program header for each memory range.
      */
-    Assert(RTFileTell(hFile) == offLoadSections);
+    Assert(pOut->off == offLoadSections);
     uint64_t offMemRange = offMemory;
     for (uint16_t iRange = 0; iRange < cMemRanges; iRange++)
     {
@@ -476,7 +624,7 @@ static int dbgfR3CoreWriteWorker(PVM pVM, RTFILE hFile)
         Log((DBGFLOG_NAME ": PGMR3PhysGetRange iRange=%u GCPhysStart=%#x GCPhysEnd=%#x cbMemRange=%u\n",
              iRange, GCPhysStart, GCPhysEnd, cbMemRange));
 
-        rc = Elf64WriteProgHdr(hFile, PT_LOAD, PF_R,
+        rc = Elf64WriteProgHdr(pOut, PT_LOAD, PF_R,
                                offMemRange,                         /* file offset to contents */
                                cbFileRange,                         /* size in core file */
                                cbMemRange,                          /* size in memory */
@@ -494,8 +642,8 @@ static int dbgfR3CoreWriteWorker(PVM pVM, RTFILE hFile)
     /*
      * Write the Core descriptor note header and data.
      */
-    Assert(RTFileTell(hFile) == offCoreDescriptor);
-    rc = Elf64WriteNoteHdr(hFile, NT_VBOXCORE, g_pcszCoreVBoxCore, &CoreDescriptor, sizeof(CoreDescriptor));
+    Assert(pOut->off == offCoreDescriptor);
+    rc = Elf64WriteNoteHdr(pOut, NT_VBOXCORE, g_pcszCoreVBoxCore, &CoreDescriptor, sizeof(CoreDescriptor));
     if (RT_FAILURE(rc))
     {
         LogRel((DBGFLOG_NAME ": Elf64WriteNoteHdr failed for Note '%s' rc=%Rrc\n", g_pcszCoreVBoxCore, rc));
@@ -505,7 +653,7 @@ static int dbgfR3CoreWriteWorker(PVM pVM, RTFILE hFile)
     /*
      * Write the CPU context note headers and data.
      */
-    Assert(RTFileTell(hFile) == offCpuDumps);
+    Assert(pOut->off == offCpuDumps);
     PDBGFCORECPU pDbgfCoreCpu = (PDBGFCORECPU)RTMemAlloc(sizeof(*pDbgfCoreCpu));
     if (RT_UNLIKELY(!pDbgfCoreCpu))
     {
@@ -526,7 +674,7 @@ static int dbgfR3CoreWriteWorker(PVM pVM, RTFILE hFile)
 
         RT_BZERO(pDbgfCoreCpu, sizeof(*pDbgfCoreCpu));
         dbgfR3GetCoreCpu(pVM, pCtx, pDbgfCoreCpu);
-        rc = Elf64WriteNoteHdr(hFile, NT_VBOXCPU, g_pcszCoreVBoxCpu, pDbgfCoreCpu, sizeof(*pDbgfCoreCpu));
+        rc = Elf64WriteNoteHdr(pOut, NT_VBOXCPU, g_pcszCoreVBoxCpu, pDbgfCoreCpu, sizeof(*pDbgfCoreCpu));
         if (RT_FAILURE(rc))
         {
             LogRel((DBGFLOG_NAME ": Elf64WriteNoteHdr failed for vCPU[%u] rc=%Rrc\n", iCpu, rc));
@@ -540,7 +688,7 @@ static int dbgfR3CoreWriteWorker(PVM pVM, RTFILE hFile)
     /*
      * Write memory ranges.
      */
-    Assert(RTFileTell(hFile) == offMemory);
+    Assert(pOut->off == offMemory);
     for (uint16_t iRange = 0; iRange < cMemRanges; iRange++)
     {
         RTGCPHYS GCPhysStart;
@@ -575,10 +723,10 @@ static int dbgfR3CoreWriteWorker(PVM pVM, RTFILE hFile)
                 RT_ZERO(abPage);
             }
 
-            rc = RTFileWrite(hFile, abPage, sizeof(abPage), NULL /* all */);
+            rc = dbgfR3CoreOutWritePage(pOut, abPage);
             if (RT_FAILURE(rc))
             {
-                LogRel((DBGFLOG_NAME ": RTFileWrite failed. iRange=%u iPage=%u rc=%Rrc\n", iRange, iPage, rc));
+                LogRel((DBGFLOG_NAME ": Writing page failed. iRange=%u iPage=%u rc=%Rrc\n", iRange, iPage, rc));
                 return rc;
             }
         }
@@ -609,21 +757,62 @@ static DECLCALLBACK(VBOXSTRICTRC) dbgfR3CoreWriteRendezvous(PVM pVM, PVMCPU pVCp
     PDBGFCOREDATA pDbgfData = (PDBGFCOREDATA)pvData;
 
     /*
-     * Create the core file.
+     * Set up the output.
+     */
+    DBGFCOREOUT Out;
+    RT_ZERO(Out);
+    Out.hFile    = NIL_RTFILE;
+    Out.pfnWrite = pDbgfData->pfnWrite;
+    Out.pvUser   = pDbgfData->pvUser;
+
+    int rc = VINF_SUCCESS;
+    if (pDbgfData->pszFilename)
+    {
+        /*
+         * Create the core file.  Holes only work with regular files, not with
+         * pipes and such.
+         */
+        uint64_t fFlags = (pDbgfData->fFlags & DBGFCORE_F_REPLACE_FILE ? RTFILE_O_CREATE_REPLACE : RTFILE_O_CREATE)
+                        | RTFILE_O_WRITE
+                        | RTFILE_O_DENY_ALL
+                        | (0600 << RTFILE_O_CREATE_MODE_SHIFT);
+        rc = RTFileOpen(&Out.hFile, pDbgfData->pszFilename, fFlags);
+        if (RT_SUCCESS(rc))
+        {
+            RTFSOBJINFO ObjInfo;
+            if (   (pDbgfData->fFlags & (DBGFCORE_F_SKIP_ZERO_PAGES | DBGFCORE_F_GZIP)) == DBGFCORE_F_SKIP_ZERO_PAGES
+                && RT_SUCCESS(RTFileQueryInfo(Out.hFile, &ObjInfo, RTFSOBJATTRADD_NOTHING))
+                && RTFS_IS_FILE(ObjInfo.Attr.fMode))
+                Out.fSkipZeroPages = true;
+        }
+        else
+            LogRel((DBGFLOG_NAME ": RTFileOpen failed for '%s' rc=%Rrc\n", pDbgfData->pszFilename, rc));
+    }
+    if (RT_SUCCESS(rc) && (pDbgfData->fFlags & DBGFCORE_F_GZIP))
+    {
+        rc = dbgfR3CoreZipCreate(&Out.pZip, dbgfR3CoreOutZipOutput, &Out);
+        if (RT_FAILURE(rc))
+            LogRel((DBGFLOG_NAME ": Failed to set up the compression threads. rc=%Rrc\n", rc));
+    }
+
+    /*
+     * Write it.
      */
-    uint32_t fFlags = (pDbgfData->fReplaceFile ? RTFILE_O_CREATE_REPLACE : RTFILE_O_CREATE)
-                    | RTFILE_O_WRITE
-                    | RTFILE_O_DENY_ALL
-                    | (0600 << RTFILE_O_CREATE_MODE_SHIFT);
-    RTFILE   hFile;
-    int rc = RTFileOpen(&hFile, pDbgfData->pszFilename, fFlags);
     if (RT_SUCCESS(rc))
     {
-        rc = dbgfR3CoreWriteWorker(pVM, hFile);
-        RTFileClose(hFile);
+        uint64_t const nsStart = RTTimeNanoTS();
+        rc = dbgfR3CoreWriteWorker(pVM, &Out);
+        if (RT_SUCCESS(rc))
+            rc = dbgfR3CoreOutFlush(&Out);
+        if (RT_SUCCESS(rc))
+            LogRel((DBGFLOG_NAME ": Wrote %'RU64 bytes (%'RU64 bytes of zero pages skipped%s) in %'RU64 ms\n",
+                    Out.off, Out.cbSkipped, Out.pZip ? ", gzip compressed" : "", (RTTimeNanoTS() - nsStart) / RT_NS_1MS));
     }
-    else
-        LogRel((DBGFLOG_NAME ": RTFileOpen failed for '%s' rc=%Rrc\n", pDbgfData->pszFilename, rc));
+
+    if (Out.pZip)
+        dbgfR3CoreZipDestroy(Out.pZip);
+    if (Out.hFile != NIL_RTFILE)
+        RTFileClose(Out.hFile);
     return rc;
 }
 
@@ -642,27 +831,90 @@ static DECLCALLBACK(VBOXSTRICTRC) dbgfR3CoreWriteRendezvous(PVM pVM, PVMCPU pVCp
  *          only synchronizes EMTs.
  */
 VMMR3DECL(int) DBGFR3CoreWrite(PUVM pUVM, const char *pszFilename, bool fReplaceFile)
+{
+    return DBGFR3CoreWriteEx(pUVM, pszFilename,
+                             DBGFCORE_F_SKIP_ZERO_PAGES | (fReplaceFile ? DBGFCORE_F_REPLACE_FILE : 0));
+}
+
+
+/**
+ * Pass the core write request down to EMT rendezvous which makes sure other
+ * EMTs, if any, are not running. IO threads could still be running but we
+ * don't care about them.
+ *
+ * @returns VBox status code.
+ * @param   pVM                 The cross context VM structure.
+ * @param   pCoreData           The core writer parameters.
+ * @param   pszWhat             What we're writing to, for the release log.
+ */
+static int dbgfR3CoreWriteCommon(PVM pVM, PDBGFCOREDATA pCoreData, const char *pszWhat)
+{
+    int rc = VMMR3EmtRendezvous(pVM, VMMEMTRENDEZVOUS_FLAGS_TYPE_ONCE, dbgfR3CoreWriteRendezvous, pCoreData);
+    if (RT_SUCCESS(rc))
+        LogRel((DBGFLOG_NAME ": Successfully wrote guest core dump '%s'\n", pszWhat));
+    else
+        LogRel((DBGFLOG_NAME ": Failed to write guest core dump '%s'. rc=%Rrc\n", pszWhat, rc));
+    return rc;
+}
+
+
+/**
+ * Write core dump of the guest, extended version.
+ *
+ * @returns VBox status code.
+ * @param   pUVM                The user mode VM handle.
+ * @param   pszFilename         The name of the file to which the guest core
+ *                              dump should be written.  This can also be a
+ *                              named pipe (requires DBGFCORE_F_REPLACE_FILE
+ *                              as it exists already).
+ * @param   fFlags              DBGFCORE_F_XXX.
+ *
+ * @remarks The VM may need to be suspended before calling this function in
+ *          order to truly stop all device threads and drivers. This function
+ *          only synchronizes EMTs.
+ */
+VMMR3DECL(int) DBGFR3CoreWriteEx(PUVM pUVM, const char *pszFilename, uint32_t fFlags)
 {
     UVM_ASSERT_VALID_EXT_RETURN(pUVM, VERR_INVALID_VM_HANDLE);
     PVM pVM = pUVM->pVM;
     VM_ASSERT_VALID_EXT_RETURN(pVM, VERR_INVALID_VM_HANDLE);
     AssertReturn(pszFilename, VERR_INVALID_HANDLE);
+    AssertReturn(!(fFlags & ~DBGFCORE_F_VALID_MASK), VERR_INVALID_FLAGS);
 
-    /*
-     * Pass the core write request down to EMT rendezvous which makes sure
-     * other EMTs, if any, are not running. IO threads could still be running
-     * but we don't care about them.
-     */
     DBGFCOREDATA CoreData;
     RT_ZERO(CoreData);
-    CoreData.pszFilename  = pszFilename;
-    CoreData.fReplaceFile = fReplaceFile;
+    CoreData.pszFilename = pszFilename;
+    CoreData.fFlags      = fFlags;
+    return dbgfR3CoreWriteCommon(pVM, &CoreData, pszFilename);
+}
 
-    int rc = VMMR3EmtRendezvous(pVM, VMMEMTRENDEZVOUS_FLAGS_TYPE_ONCE, dbgfR3CoreWriteRendezvous, &CoreData);
-    if (RT_SUCCESS(rc))
-        LogRel((DBGFLOG_NAME ": Successfully wrote guest core dump '%s'\n", pszFilename));
-    else
-        LogRel((DBGFLOG_NAME ": Failed to write guest core dump '%s'. rc=%Rrc\n", pszFilename, rc));
-    return rc;
+
+/**
+ * Write core dump of the guest to a stream.
+ *
+ * The core is written strictly sequentially, so the callback can feed it to a
+ * pipe, socket or similar.  DBGFCORE_F_SKIP_ZERO_PAGES has no effect here.
+ *
+ * @returns VBox status code.
+ * @param   pUVM                The user mode VM handle.
+ * @param   pfnWrite            The output callback.  This is called on an
+ *                              EMT while all EMTs are stopped.
+ * @param   pvUser              User argument for the callback.
+ * @param   fFlags              DBGFCORE_F_XXX.
+ */
+VMMR3DECL(int) DBGFR3CoreWriteToStream(PUVM pUVM, PFNDBGFCOREWRITE pfnWrite, void *pvUser, uint32_t fFlags)
+{
+    UVM_ASSERT_VALID_EXT_RETURN(pUVM, VERR_INVALID_VM_HANDLE);
+    PVM pVM = pUVM->pVM;
+    VM_ASSERT_VALID_EXT_RETURN(pVM, VERR_INVALID_VM_HANDLE);
+    AssertPtrReturn(pfnWrite, VERR_INVALID_POINTER);
+    AssertReturn(!(fFlags & ~DBGFCORE_F_VALID_MASK), VERR_INVALID_FLAGS);
+
+    DBGFCOREDATA CoreData;
+    RT_ZERO(CoreData);
+    CoreData.pfnWrite = pfnWrite;
+    CoreData.pvUser   = pvUser;
+    CoreData.fFlags   = fFlags;
+    return dbgfR3CoreWriteCommon(pVM, &CoreData, "<stream>");
 }
 
@@ -0,0 +1,472 @@
+/* $Id$ */
+/** @file
+ * DBGF - Debugger Facility, Parallel gzip Compression of Guest Core Dumps.
+ */
+
+/*
+ * Copyright (C) 2010-2015 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+/*
+ * The output is cut into DBGFCORE_ZIP_BLOCK_SIZE blocks which worker threads
+ * compress into separate gzip members while the caller fills the next blocks.
+ * Concatenated gzip members make a valid gzip file.  See pg_dbgf_vmcore.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#define LOG_GROUP LOG_GROUP_DBGF
+#include <iprt/asm.h>
+#include <iprt/crc.h>
+#include <iprt/mem.h>
+#include <iprt/mp.h>
+#include <iprt/semaphore.h>
+#include <iprt/thread.h>
+#include <iprt/zip.h>
+
+#include "DBGFInternal.h"
+
+#include <VBox/err.h>
+#include <VBox/log.h>
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** The max number of compression threads. */
+#define DBGFCORE_ZIP_MAX_THREADS    8
+/** The size of the gzip member header we write. */
+#define DBGFCORE_GZIP_HDR_SIZE      10
+/** The size of the gzip member trailer (CRC32 and ISIZE). */
+#define DBGFCORE_GZIP_TRAILER_SIZE  8
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/**
+ * A compression block slot.
+ */
+typedef struct DBGFCOREZIPSLOT
+{
+    /** The uncompressed data (DBGFCORE_ZIP_BLOCK_SIZE bytes). */
+    uint8_t            *pbIn;
+    /** The number of bytes in pbIn. */
+    size_t              cbIn;
+    /** The gzip member. */
+    uint8_t            *pbOut;
+    /** The number of bytes in pbOut. */
+    size_t              cbOut;
+    /** The size of the pbOut allocation. */
+    size_t              cbOutAlloc;
+    /** Set while the writer is filling the slot, i.e. it holds data that has
+     *  not been submitted yet. */
+    bool                fFilling;
+    /** Whether pbIn holds nothing but zeros so far. */
+    bool                fAllZero;
+    /** Set by the compression thread if the precompressed block of zeros
+     *  should be written instead of pbOut. */
+    bool                fZeroMember;
+    /** Whether the RTZip type byte has been dropped yet. */
+    bool                fTypeByteSkipped;
+    /** Set when the compression thread is done with the block. */
+    bool volatile       fDone;
+    /** The compression status. */
+    int                 rc;
+    /** Signalled when fDone is set. */
+    RTSEMEVENT          hEvtDone;
+} DBGFCOREZIPSLOT;
+/** Pointer to a compression block slot. */
+typedef DBGFCOREZIPSLOT *PDBGFCOREZIPSLOT;
+
+
+/**
+ * Parallel gzip compression state.
+ *
+ * Block N lives in slot N % cSlots.  The writer fills and submits blocks in
+ * order and writes the finished gzip members in the same order.
+ */
+typedef struct DBGFCOREZIP
+{
+    /** The number of slots (twice the thread count). */
+    uint32_t            cSlots;
+    /** The number of compression threads. */
+    uint32_t            cThreads;
+    /** The number of blocks submitted for compression. */
+    uint32_t volatile   cSubmitted;
+    /** The next block a compression thread should pick up. */
+    uint32_t volatile   iNextTake;
+    /** The next block to write out. */
+    uint32_t            iNextWrite;
+    /** Tells the compression threads to quit. */
+    bool volatile       fTerminate;
+    /** Signalled when there are blocks to compress. */
+    RTSEMEVENT          hEvtWork;
+    /** The output callback for the gzip members. */
+    PFNDBGFCOREWRITE    pfnOutput;
+    /** User argument for pfnOutput. */
+    void               *pvUser;
+    /** The compression threads. */
+    RTTHREAD            ahThreads[DBGFCORE_ZIP_MAX_THREADS];
+    /** Precompressed gzip member of a full block of zeros. */
+    uint8_t            *pbZeroMember;
+    /** The size of pbZeroMember. */
+    size_t              cbZeroMember;
+    /** The block slots (variable size). */
+    DBGFCOREZIPSLOT     aSlots[1];
+} DBGFCOREZIP;
+
+
+/**
+ * @callback_method_impl{FNRTZIPOUT, Appends deflate data to the gzip member.}
+ */
+static DECLCALLBACK(int) dbgfR3CoreZipOut(void *pvUser, const void *pvBuf, size_t cbBuf)
+{
+    PDBGFCOREZIPSLOT pSlot = (PDBGFCOREZIPSLOT)pvUser;
+
+    /* RTZipComp streams start with a byte identifying the compression type,
+       that's not part of the deflate data. */
+    if (!pSlot->fTypeByteSkipped && cbBuf > 0)
+    {
+        pSlot->fTypeByteSkipped = true;
+        pvBuf = (uint8_t const *)pvBuf + 1;
+        cbBuf--;
+    }
+
+    if (pSlot->cbOut + cbBuf + DBGFCORE_GZIP_TRAILER_SIZE > pSlot->cbOutAlloc)
+    {
+        size_t cbNew = RT_ALIGN_Z(pSlot->cbOut + cbBuf + DBGFCORE_GZIP_TRAILER_SIZE + _64K, _64K);
+        void  *pvNew = RTMemRealloc(pSlot->pbOut, cbNew);
+        if (!pvNew)
+            return VERR_NO_MEMORY;
+        pSlot->pbOut      = (uint8_t *)pvNew;
+        pSlot->cbOutAlloc = cbNew;
+    }
+    memcpy(&pSlot->pbOut[pSlot->cbOut], pvBuf, cbBuf);
+    pSlot->cbOut += cbBuf;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Compresses the input of a slot into a complete gzip member.
+ *
+ * @returns IPRT status code.
+ * @param   pSlot           The slot.
+ */
+static int dbgfR3CoreZipBlock(PDBGFCOREZIPSLOT pSlot)
+{
+    /* Member header: magic, deflate, no flags, no mtime, no extra flags, unknown OS. */
+    static const uint8_t s_abHdr[DBGFCORE_GZIP_HDR_SIZE] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff };
+    pSlot->cbOut            = 0;
+    pSlot->fTypeByteSkipped = true;
+    int rc = dbgfR3CoreZipOut(pSlot, s_abHdr, sizeof(s_abHdr));
+    pSlot->fTypeByteSkipped = false;
+    if (RT_FAILURE(rc))
+        return rc;
+
+    PRTZIPCOMP pZip;
+    rc = RTZipCompCreate(&pZip, pSlot, dbgfR3CoreZipOut, RTZIPTYPE_ZLIB_NO_HEADER, RTZIPLEVEL_FAST);
+    if (RT_FAILURE(rc))
+        return rc;
+    rc = RTZipCompress(pZip, pSlot->pbIn, pSlot->cbIn);
+    if (RT_SUCCESS(rc))
+        rc = RTZipCompFinish(pZip);
+    RTZipCompDestroy(pZip);
+    if (RT_FAILURE(rc))
+        return rc;
+
+    /* Member trailer: CRC32 and size of the uncompressed data (room for it was
+       reserved by dbgfR3CoreZipOut). */
+    uint32_t const uCrc = RTCrc32(pSlot->pbIn, pSlot->cbIn);
+    uint32_t const cb   = (uint32_t)pSlot->cbIn;
+    uint8_t       *pb   = &pSlot->pbOut[pSlot->cbOut];
+    pb[0] = RT_BYTE1(uCrc); pb[1] = RT_BYTE2(uCrc); pb[2] = RT_BYTE3(uCrc); pb[3] = RT_BYTE4(uCrc);
+    pb[4] = RT_BYTE1(cb);   pb[5] = RT_BYTE2(cb);   pb[6] = RT_BYTE3(cb);   pb[7] = RT_BYTE4(cb);
+    pSlot->cbOut += DBGFCORE_GZIP_TRAILER_SIZE;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * @callback_method_impl{FNRTTHREAD, Core dump compression thread.}
+ */
+static DECLCALLBACK(int) dbgfR3CoreZipThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    PDBGFCOREZIP pZip = (PDBGFCOREZIP)pvUser;
+    NOREF(hThreadSelf);
+
+    for (;;)
+    {
+        uint32_t const iBlock = ASMAtomicReadU32(&pZip->iNextTake);
+        if (iBlock != ASMAtomicReadU32(&pZip->cSubmitted))
+        {
+            if (!ASMAtomicCmpXchgU32(&pZip->iNextTake, iBlock + 1, iBlock))
+                continue;
+
+            /* Wake up a sibling if there is more work. */
+            if (iBlock + 1 != ASMAtomicReadU32(&pZip->cSubmitted))
+                RTSemEventSignal(pZip->hEvtWork);
+
+            PDBGFCOREZIPSLOT pSlot = &pZip->aSlots[iBlock % pZip->cSlots];
+            if (pSlot->fAllZero && pSlot->cbIn == DBGFCORE_ZIP_BLOCK_SIZE)
+            {
+                pSlot->fZeroMember = true;
+                pSlot->rc          = VINF_SUCCESS;
+            }
+            else
+            {
+                pSlot->fZeroMember = false;
+                pSlot->rc          = dbgfR3CoreZipBlock(pSlot);
+            }
+            ASMAtomicWriteBool(&pSlot->fDone, true);
+            RTSemEventSignal(pSlot->hEvtDone);
+        }
+        else if (ASMAtomicReadBool(&pZip->fTerminate))
+            break;
+        else
+            RTSemEventWait(pZip->hEvtWork, RT_INDEFINITE_WAIT);
+    }
+
+    /* Pass the termination on to the other threads. */
+    RTSemEventSignal(pZip->hEvtWork);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Destroys the compressor, stopping the threads.
+ *
+ * Anything not flushed is discarded.
+ *
+ * @param   pZip            The compressor.
+ */
+void dbgfR3CoreZipDestroy(PDBGFCOREZIP pZip)
+{
+    ASMAtomicWriteBool(&pZip->fTerminate, true);
+    if (pZip->hEvtWork != NIL_RTSEMEVENT)
+        RTSemEventSignal(pZip->hEvtWork);
+    for (uint32_t i = 0; i < pZip->cThreads; i++)
+        RTThreadWait(pZip->ahThreads[i], RT_INDEFINITE_WAIT, NULL);
+    if (pZip->hEvtWork != NIL_RTSEMEVENT)
+        RTSemEventDestroy(pZip->hEvtWork);
+
+    for (uint32_t i = 0; i < pZip->cSlots; i++)
+    {
+        if (pZip->aSlots[i].pbIn)
+            RTMemPageFree(pZip->aSlots[i].pbIn, DBGFCORE_ZIP_BLOCK_SIZE);
+        RTMemFree(pZip->aSlots[i].pbOut);
+        if (pZip->aSlots[i].hEvtDone != NIL_RTSEMEVENT)
+            RTSemEventDestroy(pZip->aSlots[i].hEvtDone);
+    }
+    RTMemFree(pZip->pbZeroMember);
+    RTMemFree(pZip);
+}
+
+
+/**
+ * Creates the compressor and starts the compression threads.
+ *
+ * @returns IPRT status code.
+ * @param   ppZip           Where to return the compressor.
+ * @param   pfnOutput       The callback receiving the gzip members.  This is
+ *                          only called on the thread calling
+ *                          dbgfR3CoreZipWrite and dbgfR3CoreZipFlush.
+ * @param   pvUser          User argument for pfnOutput.
+ */
+int dbgfR3CoreZipCreate(PDBGFCOREZIP *ppZip, PFNDBGFCOREWRITE pfnOutput, void *pvUser)
+{
+    uint32_t const cThreads = RT_MIN(RT_MAX(RTMpGetOnlineCount(), 1), DBGFCORE_ZIP_MAX_THREADS);
+    uint32_t const cSlots   = cThreads * 2;
+    PDBGFCOREZIP   pZip     = (PDBGFCOREZIP)RTMemAllocZ(RT_OFFSETOF(DBGFCOREZIP, aSlots[cSlots]));
+    if (!pZip)
+        return VERR_NO_MEMORY;
+    pZip->cSlots    = cSlots;
+    pZip->hEvtWork  = NIL_RTSEMEVENT;
+    pZip->pfnOutput = pfnOutput;
+    pZip->pvUser    = pvUser;
+    for (uint32_t i = 0; i < cSlots; i++)
+        pZip->aSlots[i].hEvtDone = NIL_RTSEMEVENT;
+
+    int rc = VINF_SUCCESS;
+    for (uint32_t i = 0; i < cSlots && RT_SUCCESS(rc); i++)
+    {
+        pZip->aSlots[i].pbIn = (uint8_t *)RTMemPageAlloc(DBGFCORE_ZIP_BLOCK_SIZE);
+        if (!pZip->aSlots[i].pbIn)
+            rc = VERR_NO_MEMORY;
+        else
+            rc = RTSemEventCreate(&pZip->aSlots[i].hEvtDone);
+        pZip->aSlots[i].fAllZero = true;
+    }
+
+    /* Compress a block of zeros now, that's what most of a large guest's
+       memory typically consists of. */
+    if (RT_SUCCESS(rc))
+    {
+        PDBGFCOREZIPSLOT pSlot = &pZip->aSlots[0];
+        RT_BZERO(pSlot->pbIn, DBGFCORE_ZIP_BLOCK_SIZE);
+        pSlot->cbIn = DBGFCORE_ZIP_BLOCK_SIZE;
+        rc = dbgfR3CoreZipBlock(pSlot);
+        if (RT_SUCCESS(rc))
+        {
+            pZip->pbZeroMember = pSlot->pbOut;
+            pZip->cbZeroMember = pSlot->cbOut;
+            pSlot->pbOut       = NULL;
+            pSlot->cbOut       = 0;
+            pSlot->cbOutAlloc  = 0;
+        }
+        pSlot->cbIn = 0;
+    }
+
+    if (RT_SUCCESS(rc))
+        rc = RTSemEventCreate(&pZip->hEvtWork);
+    for (uint32_t i = 0; i < cThreads && RT_SUCCESS(rc); i++)
+    {
+        rc = RTThreadCreateF(&pZip->ahThreads[i], dbgfR3CoreZipThread, pZip, 0 /*cbStack*/, RTTHREADTYPE_DEFAULT,
+                             RTTHREADFLAGS_WAITABLE, "CoreZip%u", i);
+        if (RT_SUCCESS(rc))
+            pZip->cThreads++;
+    }
+
+    if (RT_SUCCESS(rc))
+        *ppZip = pZip;
+    else
+        dbgfR3CoreZipDestroy(pZip);
+    return rc;
+}
+
+
+/**
+ * Writes the gzip member of the next block in line once it's done.
+ *
+ * @returns IPRT status code.
+ * @param   pZip            The compressor.
+ * @param   fWait           Whether to wait for the block to be compressed.
+ *                          If not set we return VINF_TRY_AGAIN instead.
+ */
+static int dbgfR3CoreZipWriteNext(PDBGFCOREZIP pZip, bool fWait)
+{
+    PDBGFCOREZIPSLOT pSlot = &pZip->aSlots[pZip->iNextWrite % pZip->cSlots];
+    while (!ASMAtomicReadBool(&pSlot->fDone))
+    {
+        if (!fWait)
+            return VINF_TRY_AGAIN;
+        RTSemEventWait(pSlot->hEvtDone, RT_INDEFINITE_WAIT);
+    }
+
+    int rc = pSlot->rc;
+    if (RT_SUCCESS(rc))
+    {
+        if (!pSlot->fZeroMember)
+            rc = pZip->pfnOutput(pZip->pvUser, pSlot->pbOut, pSlot->cbOut);
+        else
+            rc = pZip->pfnOutput(pZip->pvUser, pZip->pbZeroMember, pZip->cbZeroMember);
+    }
+
+    pSlot->cbIn     = 0;
+    pSlot->fAllZero = true;
+    ASMAtomicWriteBool(&pSlot->fDone, false);
+    pZip->iNextWrite++;
+    return rc;
+}
+
+
+/**
+ * Hands the block being filled over to the compression threads.
+ *
+ * @returns IPRT status code.
+ * @param   pZip            The compressor.
+ */
+static int dbgfR3CoreZipSubmit(PDBGFCOREZIP pZip)
+{
+    PDBGFCOREZIPSLOT pSlot = &pZip->aSlots[pZip->cSubmitted % pZip->cSlots];
+    Assert(pSlot->fFilling);
+    pSlot->fFilling = false;
+    ASMAtomicIncU32(&pZip->cSubmitted);
+    RTSemEventSignal(pZip->hEvtWork);
+
+    /* Write whatever is done already. */
+    int rc = VINF_SUCCESS;
+    while (pZip->iNextWrite != pZip->cSubmitted)
+    {
+        rc = dbgfR3CoreZipWriteNext(pZip, false /*fWait*/);
+        if (rc != VINF_SUCCESS)
+            break;
+    }
+    return RT_FAILURE(rc) ? rc : VINF_SUCCESS;
+}
+
+
+/**
+ * Compresses data, writing the gzip members that are done as it goes.
+ *
+ * @returns IPRT status code.
+ * @param   pZip            The compressor.
+ * @param   pvBuf           What to write.
+ * @param   cbBuf           How much to write.
+ * @param   fZero           Whether it's all zeros.
+ */
+int dbgfR3CoreZipWrite(PDBGFCOREZIP pZip, const void *pvBuf, size_t cbBuf, bool fZero)
+{
+    uint8_t const *pbSrc  = (uint8_t const *)pvBuf;
+    size_t         cbLeft = cbBuf;
+    while (cbLeft > 0)
+    {
+        /* Make sure the slot is free before starting to fill it. */
+        PDBGFCOREZIPSLOT pSlot = &pZip->aSlots[pZip->cSubmitted % pZip->cSlots];
+        while (pZip->cSubmitted - pZip->iNextWrite >= pZip->cSlots)
+        {
+            int rc = dbgfR3CoreZipWriteNext(pZip, true /*fWait*/);
+            if (RT_FAILURE(rc))
+                return rc;
+        }
+
+        size_t const cbThis = RT_MIN(cbLeft, DBGFCORE_ZIP_BLOCK_SIZE - pSlot->cbIn);
+        memcpy(&pSlot->pbIn[pSlot->cbIn], pbSrc, cbThis);
+        pSlot->cbIn    += cbThis;
+        pSlot->fFilling = true;
+        if (!fZero)
+            pSlot->fAllZero = false;
+        if (pSlot->cbIn == DBGFCORE_ZIP_BLOCK_SIZE)
+        {
+            int rc = dbgfR3CoreZipSubmit(pZip);
+            if (RT_FAILURE(rc))
+                return rc;
+        }
+        pbSrc  += cbThis;
+        cbLeft -= cbThis;
+    }
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Submits the partial block, if any, and writes all outstanding gzip members.
+ *
+ * @returns IPRT status code.
+ * @param   pZip            The compressor.
+ */
+int dbgfR3CoreZipFlush(PDBGFCOREZIP pZip)
+{
+    /* Only a slot the writer is filling may be submitted.  When the output is
+       an exact multiple of the block size, the slot after the last submitted
+       block is either free or still holds an earlier block in flight. */
+    int rc = VINF_SUCCESS;
+    if (   pZip->cSubmitted - pZip->iNextWrite < pZip->cSlots
+        && pZip->aSlots[pZip->cSubmitted % pZip->cSlots].fFilling)
+        rc = dbgfR3CoreZipSubmit(pZip);
+    while (RT_SUCCESS(rc) && pZip->iNextWrite != pZip->cSubmitted)
+        rc = dbgfR3CoreZipWriteNext(pZip, true /*fWait*/);
+    return rc;
+}
+
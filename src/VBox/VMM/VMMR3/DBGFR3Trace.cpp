@@ -23,24 +23,46 @@
 #include <VBox/vmm/dbgftrace.h>
 #include <VBox/vmm/cfgm.h>
 #include <VBox/vmm/mm.h>
+#include <VBox/vmm/dbgftracefmt.h>
 #include <VBox/vmm/pdmapi.h>
 #include "DBGFInternal.h"
 #include <VBox/vmm/vm.h>
+#include <VBox/vmm/uvm.h>
 #include "VMMTracing.h"
 
 #include <VBox/err.h>
 #include <VBox/log.h>
 #include <VBox/param.h>
+#include <VBox/sup.h>
 
+#include <iprt/asm.h>
+#include <iprt/asm-amd64-x86.h>
+#include <iprt/asm-math.h>
 #include <iprt/assert.h>
 #include <iprt/ctype.h>
+#include <iprt/file.h>
+#include <iprt/mem.h>
+#include <iprt/semaphore.h>
+#include <iprt/string.h>
+#include <iprt/thread.h>
+#include <iprt/time.h>
 #include <iprt/trace.h>
 
 
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** The max number of entries the streaming thread packs into one chunk. */
+#define DBGF_TRACE_CHUNK_ENTRIES        1024
+/** How often the streaming thread drains the rings (ms). */
+#define DBGF_TRACE_DRAIN_INTERVAL_MS    50
+
+
 /*********************************************************************************************************************************
 *   Internal Functions                                                                                                           *
 *********************************************************************************************************************************/
 static DECLCALLBACK(void) dbgfR3TraceInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs);
+static DECLCALLBACK(void) dbgfR3TraceRingInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs);
 
 
 /*********************************************************************************************************************************
@@ -62,6 +84,21 @@ static const struct
     {  RT_STR_TUPLE("em"), VMMTPGROUP_EM },
     {  RT_STR_TUPLE("hm"), VMMTPGROUP_HM },
     {  RT_STR_TUPLE("tm"), VMMTPGROUP_TM },
+    {  RT_STR_TUPLE("exit"), DBGFTRACE_GRP_EXIT },
+    {  RT_STR_TUPLE("irq"), DBGFTRACE_GRP_IRQ },
+    {  RT_STR_TUPLE("io"), DBGFTRACE_GRP_IO },
+};
+
+/** Binary trace ring event names, indexed by DBGFTRACEEVT. */
+static const char * const g_apszTraceEvtNames[DBGFTRACEEVT_END] =
+{
+    "invalid",
+    "vmexit",
+    "irq",
+    "ioport-read",
+    "ioport-write",
+    "mmio-read",
+    "mmio-write",
 };
 
 
@@ -131,6 +168,206 @@ static int dbgfR3TraceEnable(PVM pVM, uint32_t cbEntry, uint32_t cEntries)
 }
 
 
+/**
+ * Allocates the per virtual CPU binary trace rings.
+ *
+ * @returns VBox status code
+ * @param   pVM         The cross context VM structure.
+ * @param   cEntries    The number of entries in each ring, power of two.
+ */
+static int dbgfR3TraceRingsCreate(PVM pVM, uint32_t cEntries)
+{
+    Assert(RT_IS_POWER_OF_TWO(cEntries));
+    size_t const cbRing = RT_ALIGN_Z(RT_OFFSETOF(DBGFTRACERING, aEntries) + cEntries * sizeof(DBGFTRACEENTRY), PAGE_SIZE);
+    for (VMCPUID idCpu = 0; idCpu < pVM->cCpus; idCpu++)
+    {
+        PVMCPU pVCpu = &pVM->aCpus[idCpu];
+        void  *pvRing;
+        int rc = MMR3HyperAllocOnceNoRel(pVM, cbRing, PAGE_SIZE, MM_TAG_DBGF, &pvRing);
+        if (RT_FAILURE(rc))
+            return rc;
+
+        PDBGFTRACERING pRing = (PDBGFTRACERING)pvRing;
+        pRing->cEntries = cEntries;
+        pRing->idCpu    = idCpu;
+        pVCpu->dbgf.s.pTraceRingR3 = pRing;
+        pVCpu->dbgf.s.pTraceRingR0 = MMHyperR3ToR0(pVM, pRing);
+        pVCpu->dbgf.s.pTraceRingRC = MMHyperR3ToRC(pVM, pRing);
+    }
+    LogRel(("DBGF: Binary trace rings: %u entries (%zu bytes) per virtual CPU\n", cEntries, cbRing));
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Drains the binary trace ring of one virtual CPU into the output file.
+ *
+ * @param   pUVM        The user mode VM handle.
+ * @param   pRing       The ring to drain.
+ * @param   paCopy      Scratch buffer for DBGF_TRACE_CHUNK_ENTRIES entries.
+ * @param   pbChunk     Scratch buffer for a packed chunk.
+ */
+static void dbgfR3TraceRingDrain(PUVM pUVM, PDBGFTRACERING pRing, PDBGFTRACEENTRY paCopy, uint8_t *pbChunk)
+{
+    uint32_t const cEntries = pRing->cEntries;
+    uint64_t const idxHead  = ASMAtomicReadU64(&pRing->idxHead);
+    uint64_t       idxTail  = pRing->idxTail;
+    uint64_t       cLost    = 0;
+    do
+    {
+        /*
+         * Skip whatever the producer has lapped already.
+         */
+        if (idxHead - idxTail > cEntries)
+        {
+            cLost  += idxHead - idxTail - cEntries;
+            idxTail = idxHead - cEntries;
+        }
+
+        /*
+         * Copy out a batch, then check how many of the copied entries the
+         * producer may have overwritten while we were at it.  The entry at the
+         * current head could be half written, so it counts as overwritten.
+         */
+        uint32_t cCopy = (uint32_t)RT_MIN(idxHead - idxTail, DBGF_TRACE_CHUNK_ENTRIES);
+        for (uint32_t i = 0; i < cCopy; i++)
+            paCopy[i] = pRing->aEntries[(idxTail + i) & (cEntries - 1)];
+        ASMCompilerBarrier();
+        uint64_t const idxHeadNow = ASMAtomicReadU64(&pRing->idxHead);
+        uint32_t       iFirst     = 0;
+        if (idxHeadNow + 1 > idxTail + cEntries)
+        {
+            iFirst = (uint32_t)RT_MIN(idxHeadNow + 1 - cEntries - idxTail, cCopy);
+            cLost += iFirst;
+        }
+
+        /*
+         * Pack and write the chunk.
+         */
+        PDBGFTRACECHUNKHDR pHdr   = (PDBGFTRACECHUNKHDR)pbChunk;
+        uint8_t           *pbDst  = (uint8_t *)(pHdr + 1);
+        uint64_t           uPrev  = iFirst < cCopy ? paCopy[iFirst].u64Tsc : 0;
+        pHdr->u32Magic    = DBGFTRACECHUNKHDR_MAGIC;
+        pHdr->idCpu       = (uint16_t)pRing->idCpu;
+        pHdr->cEntries    = (uint16_t)(cCopy - iFirst);
+        pHdr->cLost       = (uint32_t)RT_MIN(cLost, UINT32_MAX);
+        pHdr->u64TscFirst = uPrev;
+        for (uint32_t i = iFirst; i < cCopy; i++)
+        {
+            *pbDst++ = (uint8_t)paCopy[i].u16Evt;
+            pbDst = DBGFTracePackU64(pbDst, paCopy[i].u64Tsc - uPrev);
+            pbDst = DBGFTracePackU64(pbDst, paCopy[i].u32Arg);
+            pbDst = DBGFTracePackU64(pbDst, paCopy[i].u64Arg1);
+            pbDst = DBGFTracePackU64(pbDst, paCopy[i].u64Arg2);
+            uPrev = paCopy[i].u64Tsc;
+        }
+        pHdr->cbData = (uint32_t)(pbDst - (uint8_t *)(pHdr + 1));
+
+        if (   (pHdr->cEntries || pHdr->cLost)
+            && !pUVM->dbgf.s.fTraceWriteError)
+        {
+            int rc = RTFileWrite(pUVM->dbgf.s.hTraceFile, pbChunk, pbDst - pbChunk, NULL);
+            if (RT_SUCCESS(rc))
+                pUVM->dbgf.s.cbTraceWritten += pbDst - pbChunk;
+            else
+            {
+                LogRel(("DBGF: Writing the binary trace stream failed: %Rrc, giving up on it\n", rc));
+                pUVM->dbgf.s.fTraceWriteError = true;
+            }
+        }
+
+        pRing->cLost += cLost;
+        cLost    = 0;
+        idxTail += cCopy;
+    } while (idxTail != idxHead);
+    pRing->idxTail = idxTail;
+}
+
+
+/**
+ * @callback_method_impl{FNRTTHREAD, Streams the binary trace rings to file.}
+ */
+static DECLCALLBACK(int) dbgfR3TraceStreamThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    PVM  pVM  = (PVM)pvUser;
+    PUVM pUVM = pVM->pUVM;
+    NOREF(hThreadSelf);
+
+    PDBGFTRACEENTRY paCopy  = (PDBGFTRACEENTRY)RTMemAlloc(DBGF_TRACE_CHUNK_ENTRIES * sizeof(DBGFTRACEENTRY));
+    uint8_t        *pbChunk = (uint8_t *)RTMemAlloc(sizeof(DBGFTRACECHUNKHDR) + DBGF_TRACE_CHUNK_ENTRIES * DBGFTRACE_PACKED_ENTRY_MAX);
+    if (!paCopy || !pbChunk)
+    {
+        RTMemFree(paCopy);
+        RTMemFree(pbChunk);
+        return VERR_NO_MEMORY;
+    }
+
+    bool fDone;
+    do
+    {
+        fDone = ASMAtomicReadBool(&pUVM->dbgf.s.fTraceShutdown);
+        for (VMCPUID idCpu = 0; idCpu < pVM->cCpus; idCpu++)
+            dbgfR3TraceRingDrain(pUVM, pVM->aCpus[idCpu].dbgf.s.pTraceRingR3, paCopy, pbChunk);
+        if (!fDone)
+            RTSemEventWait(pUVM->dbgf.s.hTraceEvt, DBGF_TRACE_DRAIN_INTERVAL_MS);
+    } while (!fDone);
+
+    RTMemFree(paCopy);
+    RTMemFree(pbChunk);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Starts streaming the binary trace rings to the given file.
+ *
+ * @returns VBox status code
+ * @param   pVM         The cross context VM structure.
+ * @param   pszFile     The output file.
+ */
+static int dbgfR3TraceStreamStart(PVM pVM, const char *pszFile)
+{
+    PUVM pUVM = pVM->pUVM;
+    int rc = RTFileOpen(&pUVM->dbgf.s.hTraceFile, pszFile, RTFILE_O_WRITE | RTFILE_O_CREATE_REPLACE | RTFILE_O_DENY_WRITE);
+    if (RT_FAILURE(rc))
+        return VMSetError(pVM, rc, RT_SRC_POS, "Failed to create the trace ring file '%s': %Rrc", pszFile, rc);
+
+    DBGFTRACEFILEHDR Hdr;
+    RT_ZERO(Hdr);
+    memcpy(Hdr.szMagic, DBGFTRACEFILEHDR_MAGIC, sizeof(DBGFTRACEFILEHDR_MAGIC));
+    Hdr.u32Version   = DBGFTRACEFILEHDR_VERSION;
+    Hdr.cbHdr        = sizeof(Hdr);
+    Hdr.cCpus        = pVM->cCpus;
+    Hdr.cRingEntries = pVM->aCpus[0].dbgf.s.pTraceRingR3->cEntries;
+    Hdr.u64TscHz     = g_pSUPGlobalInfoPage ? SUPGetCpuHzFromGip(g_pSUPGlobalInfoPage) : 0;
+    Hdr.u64TscStart  = ASMReadTSC();
+    RTTIMESPEC Now;
+    Hdr.i64UtcStart  = RTTimeSpecGetNano(RTTimeNow(&Now));
+    rc = RTFileWrite(pUVM->dbgf.s.hTraceFile, &Hdr, sizeof(Hdr), NULL);
+    if (RT_SUCCESS(rc))
+    {
+        pUVM->dbgf.s.cbTraceWritten = sizeof(Hdr);
+        rc = RTSemEventCreate(&pUVM->dbgf.s.hTraceEvt);
+        if (RT_SUCCESS(rc))
+        {
+            rc = RTThreadCreate(&pUVM->dbgf.s.hTraceThread, dbgfR3TraceStreamThread, pVM, 0 /*cbStack*/,
+                                RTTHREADTYPE_IO, RTTHREADFLAGS_WAITABLE, "DbgfTrace");
+            if (RT_SUCCESS(rc))
+            {
+                LogRel(("DBGF: Streaming the binary trace rings to '%s'\n", pszFile));
+                return VINF_SUCCESS;
+            }
+            RTSemEventDestroy(pUVM->dbgf.s.hTraceEvt);
+            pUVM->dbgf.s.hTraceEvt    = NIL_RTSEMEVENT;
+            pUVM->dbgf.s.hTraceThread = NIL_RTTHREAD;
+        }
+    }
+    RTFileClose(pUVM->dbgf.s.hTraceFile);
+    pUVM->dbgf.s.hTraceFile = NIL_RTFILE;
+    return VMSetError(pVM, rc, RT_SRC_POS, "Failed to start streaming the trace rings to '%s': %Rrc", pszFile, rc);
+}
+
+
 /**
  * Initializes the tracing.
  *
@@ -146,6 +383,10 @@ int dbgfR3TraceInit(PVM pVM)
     pVM->hTraceBufR3 = NIL_RTTRACEBUF;
     pVM->hTraceBufRC = NIL_RTRCPTR;
     pVM->hTraceBufR0 = NIL_RTR0PTR;
+    PUVM pUVM = pVM->pUVM;
+    pUVM->dbgf.s.hTraceThread = NIL_RTTHREAD;
+    pUVM->dbgf.s.hTraceEvt    = NIL_RTSEMEVENT;
+    pUVM->dbgf.s.hTraceFile   = NIL_RTFILE;
 
     /*
      * Check the config and enable tracing if requested.
@@ -162,36 +403,68 @@ int dbgfR3TraceInit(PVM pVM)
     int rc = CFGMR3QueryBoolDef(pDbgfNode, "TracingEnabled", &fTracingEnabled, fDefault);
     AssertRCReturn(rc, rc);
     if (fTracingEnabled)
-    {
         rc = dbgfR3TraceEnable(pVM, 0, 0);
-        if (RT_SUCCESS(rc))
+
+    /** @cfgm{/DBGF/TraceRingEntries, uint32_t, 0}
+     * The number of entries in the per virtual CPU binary trace rings, rounded
+     * up to a power of two.  Zero disables the rings.  What is recorded is
+     * controlled by the "exit", "irq" and "io" groups of TracingConfig. */
+    uint32_t cRingEntries = 0;
+    if (RT_SUCCESS(rc))
+        rc = CFGMR3QueryU32Def(pDbgfNode, "TraceRingEntries", &cRingEntries, 0);
+    if (RT_SUCCESS(rc) && cRingEntries)
+    {
+        if (cRingEntries < 64 || cRingEntries > _16M)
+            return VMSetError(pVM, VERR_OUT_OF_RANGE, RT_SRC_POS, "TraceRingEntries=%u is out of range (64..16M)", cRingEntries);
+        if (!RT_IS_POWER_OF_TWO(cRingEntries))
+            cRingEntries = RT_BIT_32(ASMBitLastSetU32(cRingEntries));
+        rc = dbgfR3TraceRingsCreate(pVM, cRingEntries);
+    }
+
+    if (RT_SUCCESS(rc) && (fTracingEnabled || cRingEntries))
+    {
+        if (pDbgfNode)
         {
-            if (pDbgfNode)
-            {
-                char       *pszTracingConfig;
-                rc = CFGMR3QueryStringAllocDef(pDbgfNode, "TracingConfig", &pszTracingConfig, pszConfigDefault);
-                if (RT_SUCCESS(rc))
-                {
-                    rc = DBGFR3TraceConfig(pVM, pszTracingConfig);
-                    if (RT_FAILURE(rc))
-                        rc = VMSetError(pVM, rc, RT_SRC_POS, "TracingConfig=\"%s\" -> %Rrc", pszTracingConfig, rc);
-                    MMR3HeapFree(pszTracingConfig);
-                }
-            }
-            else
+            char       *pszTracingConfig;
+            rc = CFGMR3QueryStringAllocDef(pDbgfNode, "TracingConfig", &pszTracingConfig, pszConfigDefault);
+            if (RT_SUCCESS(rc))
             {
-                rc = DBGFR3TraceConfig(pVM, pszConfigDefault);
+                rc = DBGFR3TraceConfig(pVM, pszTracingConfig);
                 if (RT_FAILURE(rc))
-                    rc = VMSetError(pVM, rc, RT_SRC_POS, "TracingConfig=\"%s\" (default) -> %Rrc", pszConfigDefault, rc);
+                    rc = VMSetError(pVM, rc, RT_SRC_POS, "TracingConfig=\"%s\" -> %Rrc", pszTracingConfig, rc);
+                MMR3HeapFree(pszTracingConfig);
             }
         }
+        else
+        {
+            rc = DBGFR3TraceConfig(pVM, pszConfigDefault);
+            if (RT_FAILURE(rc))
+                rc = VMSetError(pVM, rc, RT_SRC_POS, "TracingConfig=\"%s\" (default) -> %Rrc", pszConfigDefault, rc);
+        }
+    }
+
+    /** @cfgm{/DBGF/TraceRingFile, string, none}
+     * Where to stream the binary trace rings to.  Without it the rings are only
+     * a flight recorder which can be inspected with the "tracering" info item.
+     * Use VBoxTraceDecode to turn the file into text. */
+    if (RT_SUCCESS(rc) && cRingEntries)
+    {
+        char *pszFile = NULL;
+        rc = CFGMR3QueryStringAllocDef(pDbgfNode, "TraceRingFile", &pszFile, NULL);
+        if (RT_SUCCESS(rc) && pszFile && *pszFile)
+            rc = dbgfR3TraceStreamStart(pVM, pszFile);
+        MMR3HeapFree(pszFile);
     }
 
     /*
-     * Register a debug info item that will dump the trace buffer content.
+     * Register debug info items that will dump the trace buffer and rings.
      */
     if (RT_SUCCESS(rc))
         rc = DBGFR3InfoRegisterInternal(pVM, "tracebuf", "Display the trace buffer content. No arguments.", dbgfR3TraceInfo);
+    if (RT_SUCCESS(rc))
+        rc = DBGFR3InfoRegisterInternal(pVM, "tracering",
+                                        "Display the most recent binary trace ring entries. Optional argument: entries per CPU.",
+                                        dbgfR3TraceRingInfo);
 
     return rc;
 }
@@ -204,13 +477,37 @@ int dbgfR3TraceInit(PVM pVM)
  */
 void dbgfR3TraceTerm(PVM pVM)
 {
-    /* nothing to do */
-    NOREF(pVM);
+    PUVM pUVM = pVM->pUVM;
+    if (pUVM->dbgf.s.hTraceThread != NIL_RTTHREAD)
+    {
+        /* The thread does a final drain before quitting. */
+        ASMAtomicWriteBool(&pUVM->dbgf.s.fTraceShutdown, true);
+        RTSemEventSignal(pUVM->dbgf.s.hTraceEvt);
+        int rc = RTThreadWait(pUVM->dbgf.s.hTraceThread, 30000, NULL);
+        AssertLogRelRC(rc);
+        pUVM->dbgf.s.hTraceThread = NIL_RTTHREAD;
+
+        uint64_t cLost = 0;
+        for (VMCPUID idCpu = 0; idCpu < pVM->cCpus; idCpu++)
+            cLost += pVM->aCpus[idCpu].dbgf.s.pTraceRingR3->cLost;
+        LogRel(("DBGF: Binary trace stream closed: %'RU64 bytes written, %'RU64 entries lost\n",
+                pUVM->dbgf.s.cbTraceWritten, cLost));
+    }
+    if (pUVM->dbgf.s.hTraceEvt != NIL_RTSEMEVENT)
+    {
+        RTSemEventDestroy(pUVM->dbgf.s.hTraceEvt);
+        pUVM->dbgf.s.hTraceEvt = NIL_RTSEMEVENT;
+    }
+    if (pUVM->dbgf.s.hTraceFile != NIL_RTFILE)
+    {
+        RTFileClose(pUVM->dbgf.s.hTraceFile);
+        pUVM->dbgf.s.hTraceFile = NIL_RTFILE;
+    }
 }
 
 
 /**
- * Relocates the trace buffer handle in RC.
+ * Relocates the trace buffer handle and the trace rings in RC.
  *
  * @param   pVM                 The cross context VM structure.
  */
@@ -218,6 +515,9 @@ void dbgfR3TraceRelocate(PVM pVM)
 {
     if (pVM->hTraceBufR3 != NIL_RTTRACEBUF)
         pVM->hTraceBufRC = MMHyperCCToRC(pVM, pVM->hTraceBufR3);
+    for (VMCPUID idCpu = 0; idCpu < pVM->cCpus; idCpu++)
+        if (pVM->aCpus[idCpu].dbgf.s.pTraceRingR3)
+            pVM->aCpus[idCpu].dbgf.s.pTraceRingRC = MMHyperR3ToRC(pVM, pVM->aCpus[idCpu].dbgf.s.pTraceRingR3);
 }
 
 
@@ -249,20 +549,26 @@ VMMDECL(int) DBGFR3TraceConfig(PVM pVM, const char *pszConfig)
 {
     VM_ASSERT_VALID_EXT_RETURN(pVM, VERR_INVALID_VM_HANDLE);
     AssertPtrReturn(pszConfig, VERR_INVALID_POINTER);
-    if (pVM->hTraceBufR3 == NIL_RTTRACEBUF)
+    if (   pVM->hTraceBufR3 == NIL_RTTRACEBUF
+        && !pVM->aCpus[0].dbgf.s.pTraceRingR3)
         return VERR_DBGF_NO_TRACE_BUFFER;
 
     /*
      * We do this in two passes, the first pass just validates the input string
      * and the second applies the changes.
      */
-    for (uint32_t uPass = 0; uPass < 1; uPass++)
+    const char * const pszStart = pszConfig;
+    for (uint32_t uPass = 0; uPass < 2; uPass++)
     {
+        pszConfig = pszStart;
         char ch;
         while ((ch = *pszConfig) != '\0')
         {
-            if (RT_C_IS_SPACE(ch))
+            if (RT_C_IS_SPACE(ch) || ch == ',')
+            {
+                pszConfig++;
                 continue;
+            }
 
             /*
              * Operation prefix.
@@ -294,6 +600,8 @@ VMMDECL(int) DBGFR3TraceConfig(PVM pVM, const char *pszConfig)
                    && !RT_C_IS_PUNCT(ch))
                 ch = *++pszConfig;
             size_t const cchName = pszConfig - pszName;
+            if (!cchName)
+                return VERR_NOT_FOUND;
 
             /*
              * 'all' - special group that enables or disables all trace points.
@@ -371,7 +679,8 @@ VMMDECL(int) DBGFR3TraceQueryConfig(PVM pVM, char *pszConfig, size_t cbConfig)
         return VERR_BUFFER_OVERFLOW;
     *pszConfig = '\0';
 
-    if (pVM->hTraceBufR3 == NIL_RTTRACEBUF)
+    if (   pVM->hTraceBufR3 == NIL_RTTRACEBUF
+        && !pVM->aCpus[0].dbgf.s.pTraceRingR3)
         return VERR_DBGF_NO_TRACE_BUFFER;
 
     int             rc           = VINF_SUCCESS;
@@ -447,3 +756,47 @@ static DECLCALLBACK(void) dbgfR3TraceInfo(PVM pVM, PCDBGFINFOHLP pHlp, const cha
     NOREF(pszArgs);
 }
 
+
+
+/**
+ * @callback_method_impl{FNDBGFHANDLERINT,
+ *      Info handler for displaying the most recent binary trace ring entries.}
+ *
+ * This only peeks at the rings, it doesn't consume anything.  Entries recorded
+ * while we're at it may show up torn.
+ */
+static DECLCALLBACK(void) dbgfR3TraceRingInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs)
+{
+    if (!pVM->aCpus[0].dbgf.s.pTraceRingR3)
+    {
+        pHlp->pfnPrintf(pHlp, "The binary trace rings are disabled (DBGF/TraceRingEntries)\n");
+        return;
+    }
+
+    uint32_t cMax = 32;
+    if (pszArgs && *pszArgs)
+        RTStrToUInt32Full(RTStrStripL(pszArgs), 0, &cMax);
+    uint64_t const uTscHz  = g_pSUPGlobalInfoPage ? SUPGetCpuHzFromGip(g_pSUPGlobalInfoPage) : 0;
+    uint64_t const uTscNow = ASMReadTSC();
+
+    for (VMCPUID idCpu = 0; idCpu < pVM->cCpus; idCpu++)
+    {
+        PDBGFTRACERING pRing   = pVM->aCpus[idCpu].dbgf.s.pTraceRingR3;
+        uint64_t const idxHead = ASMAtomicReadU64(&pRing->idxHead);
+        pHlp->pfnPrintf(pHlp, "CPU %u: %u entries, head=%'RU64 tail=%'RU64 lost=%'RU64\n",
+                        idCpu, pRing->cEntries, idxHead, pRing->idxTail, pRing->cLost);
+
+        uint64_t cShow = RT_MIN(RT_MIN(idxHead, (uint64_t)pRing->cEntries - 1), cMax);
+        for (uint64_t idx = idxHead - cShow; idx < idxHead; idx++)
+        {
+            DBGFTRACEENTRY const Entry = pRing->aEntries[idx & (pRing->cEntries - 1)];
+            uint64_t const       cTicksAgo = uTscNow - Entry.u64Tsc;
+            pHlp->pfnPrintf(pHlp, "  #%08RU64 -%'12RU64 %s %-12s %#010RX32 %#018RX64 %#018RX64\n",
+                            idx, uTscHz ? ASMMultU64ByU32DivByU32(cTicksAgo, RT_NS_1US, (uint32_t)(uTscHz / RT_US_1SEC)) : cTicksAgo,
+                            uTscHz ? "ns   " : "ticks",
+                            Entry.u16Evt < DBGFTRACEEVT_END ? g_apszTraceEvtNames[Entry.u16Evt] : "unknown",
+                            Entry.u32Arg, Entry.u64Arg1, Entry.u64Arg2);
+        }
+    }
+}
+
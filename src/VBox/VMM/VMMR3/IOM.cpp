@@ -33,9 +33,10 @@
  * disassembler (DIS) to figure which instruction caused it (there are a number
  * of instructions in addition to the I/O ones) and if it's an I/O port access
  * it will hand it to IOMRCIOPortHandler (via EMInterpretPortIO).
- * IOMRCIOPortHandler will lookup the port in the AVL tree of registered
- * handlers. If found, the handler will be called otherwise default action is
- * taken. (Default action is to write into the void and read all set bits.)
+ * IOMRCIOPortHandler will lookup the port in the direct indexed lookup table
+ * built from the AVL trees of registered handlers (IOMIOPORTLOOKUP). If found,
+ * the handler will be called otherwise default action is taken. (Default action
+ * is to write into the void and read all set bits.)
  *
  * Memory Mapped I/O (MMIO) is implemented as a slightly special case of PGM
  * access handlers. An MMIO range is registered with IOM which then registers it
@@ -101,6 +102,7 @@
 *********************************************************************************************************************************/
 #define LOG_GROUP LOG_GROUP_IOM
 #include <VBox/vmm/iom.h>
+#include <VBox/vmm/cfgm.h>
 #include <VBox/vmm/cpum.h>
 #include <VBox/vmm/pgm.h>
 #include <VBox/sup.h>
@@ -116,6 +118,8 @@
 #include <VBox/param.h>
 #include <iprt/assert.h>
 #include <iprt/alloc.h>
+#include <iprt/ctype.h>
+#include <iprt/sort.h>
 #include <iprt/string.h>
 #include <VBox/log.h>
 #include <VBox/err.h>
@@ -130,6 +134,7 @@ static void iomR3FlushCache(PVM pVM);
 static DECLCALLBACK(int) iomR3RelocateIOPortCallback(PAVLROIOPORTNODECORE pNode, void *pvUser);
 static DECLCALLBACK(int) iomR3RelocateMMIOCallback(PAVLROGCPHYSNODECORE pNode, void *pvUser);
 static DECLCALLBACK(void) iomR3IOPortInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs);
+static DECLCALLBACK(void) iomR3IOPortCountersInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs);
 static DECLCALLBACK(void) iomR3MMIOInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs);
 static FNIOMIOPORTIN        iomR3IOPortDummyIn;
 static FNIOMIOPORTOUT       iomR3IOPortDummyOut;
@@ -182,6 +187,39 @@ VMMR3_INT_DECL(int) IOMR3Init(PVM pVM)
         pVM->iom.s.pTreesRC = MMHyperR3ToRC(pVM, pVM->iom.s.pTreesR3);
         pVM->iom.s.pTreesR0 = MMHyperR3ToR0(pVM, pVM->iom.s.pTreesR3);
 
+        /*
+         * Allocate the I/O port lookup table and, if requested, the per port
+         * access counters.
+         */
+        rc = MMHyperAlloc(pVM, sizeof(*pVM->iom.s.pIOPortLookupR3), 0, MM_TAG_IOM, (void **)&pVM->iom.s.pIOPortLookupR3);
+        AssertRCReturn(rc, rc);
+        pVM->iom.s.pIOPortLookupRC = MMHyperR3ToRC(pVM, pVM->iom.s.pIOPortLookupR3);
+        pVM->iom.s.pIOPortLookupR0 = MMHyperR3ToR0(pVM, pVM->iom.s.pIOPortLookupR3);
+        iomR3IOPortLookupRebuild(pVM);
+
+        /** @cfgm{/IOM/PortCounters, boolean, false}
+         * Counts the accesses to each of the 64K I/O ports, so the ports a guest
+         * hammers can be found using the 'ioportcounts' info item.  Costs 256KB of
+         * hypervisor heap and an atomic increment per access. */
+        bool fPortCounters;
+        rc = CFGMR3QueryBoolDef(CFGMR3GetChild(CFGMR3GetRoot(pVM), "IOM"), "PortCounters", &fPortCounters, false);
+        AssertLogRelRCReturn(rc, rc);
+        if (fPortCounters)
+        {
+            rc = MMHyperAlloc(pVM, sizeof(uint32_t) * _64K, 0, MM_TAG_IOM, (void **)&pVM->iom.s.pau32PortCountersR3);
+            if (RT_SUCCESS(rc))
+            {
+                pVM->iom.s.pau32PortCountersRC = MMHyperR3ToRC(pVM, (void *)pVM->iom.s.pau32PortCountersR3);
+                pVM->iom.s.pau32PortCountersR0 = MMHyperR3ToR0(pVM, (void *)pVM->iom.s.pau32PortCountersR3);
+            }
+            else
+            {
+                LogRel(("IOM: Failed to allocate the I/O port counters, continuing without them (%Rrc)\n", rc));
+                pVM->iom.s.pau32PortCountersR3 = NULL;
+                rc = VINF_SUCCESS;
+            }
+        }
+
         /*
          * Register the MMIO access handler type.
          */
@@ -198,6 +236,10 @@ VMMR3_INT_DECL(int) IOMR3Init(PVM pVM)
              * Info.
              */
             DBGFR3InfoRegisterInternal(pVM, "ioport", "Dumps all IOPort ranges. No arguments.", &iomR3IOPortInfo);
+            DBGFR3InfoRegisterInternal(pVM, "ioportcounts",
+                                       "Dumps the most accessed I/O ports (requires /IOM/PortCounters). "
+                                       "Arguments: [count] [reset]",
+                                       &iomR3IOPortCountersInfo);
             DBGFR3InfoRegisterInternal(pVM, "mmio", "Dumps all MMIO ranges. No arguments.", &iomR3MMIOInfo);
 
             /*
@@ -227,6 +269,8 @@ VMMR3_INT_DECL(int) IOMR3Init(PVM pVM)
 #endif
             STAM_REG(pVM, &pVM->iom.s.StatRZInstOther,        STAMTYPE_COUNTER, "/IOM/RZ-MMIOHandler/Inst/Other",           STAMUNIT_OCCURENCES,     "Other instructions counter.");
             STAM_REG(pVM, &pVM->iom.s.StatR3MMIOHandler,      STAMTYPE_COUNTER, "/IOM/R3-MMIOHandler",                      STAMUNIT_OCCURENCES,     "Number of calls to iomR3MmioHandler.");
+            STAM_REL_REG(pVM, &pVM->iom.s.StatMmioDecodeCacheHits,   STAMTYPE_COUNTER, "/IOM/MMIODecodeCache/Hits",   STAMUNIT_OCCURENCES, "Number of MMIO accesses emulated straight from the decode cache.");
+            STAM_REL_REG(pVM, &pVM->iom.s.StatMmioDecodeCacheMisses, STAMTYPE_COUNTER, "/IOM/MMIODecodeCache/Misses", STAMUNIT_OCCURENCES, "Number of MMIO accesses that had to be decoded.");
             STAM_REG(pVM, &pVM->iom.s.StatInstIn,             STAMTYPE_COUNTER, "/IOM/IOWork/In",                           STAMUNIT_OCCURENCES,     "Counter of any IN instructions.");
             STAM_REG(pVM, &pVM->iom.s.StatInstOut,            STAMTYPE_COUNTER, "/IOM/IOWork/Out",                          STAMUNIT_OCCURENCES,     "Counter of any OUT instructions.");
             STAM_REG(pVM, &pVM->iom.s.StatInstIns,            STAMTYPE_COUNTER, "/IOM/IOWork/Ins",                          STAMUNIT_OCCURENCES,     "Counter of any INS instructions.");
@@ -261,26 +305,24 @@ static void iomR3FlushCache(PVM pVM)
     while (iCpu-- > 0)
     {
         PVMCPU pVCpu = &pVM->aCpus[iCpu];
-        pVCpu->iom.s.pRangeLastReadR0  = NIL_RTR0PTR;
-        pVCpu->iom.s.pRangeLastWriteR0 = NIL_RTR0PTR;
         pVCpu->iom.s.pStatsLastReadR0  = NIL_RTR0PTR;
         pVCpu->iom.s.pStatsLastWriteR0 = NIL_RTR0PTR;
         pVCpu->iom.s.pMMIORangeLastR0  = NIL_RTR0PTR;
         pVCpu->iom.s.pMMIOStatsLastR0  = NIL_RTR0PTR;
 
-        pVCpu->iom.s.pRangeLastReadR3  = NULL;
-        pVCpu->iom.s.pRangeLastWriteR3 = NULL;
         pVCpu->iom.s.pStatsLastReadR3  = NULL;
         pVCpu->iom.s.pStatsLastWriteR3 = NULL;
         pVCpu->iom.s.pMMIORangeLastR3  = NULL;
         pVCpu->iom.s.pMMIOStatsLastR3  = NULL;
 
-        pVCpu->iom.s.pRangeLastReadRC  = NIL_RTRCPTR;
-        pVCpu->iom.s.pRangeLastWriteRC = NIL_RTRCPTR;
         pVCpu->iom.s.pStatsLastReadRC  = NIL_RTRCPTR;
         pVCpu->iom.s.pStatsLastWriteRC = NIL_RTRCPTR;
         pVCpu->iom.s.pMMIORangeLastRC  = NIL_RTRCPTR;
         pVCpu->iom.s.pMMIOStatsLastRC  = NIL_RTRCPTR;
+
+        for (unsigned i = 0; i < RT_ELEMENTS(pVCpu->iom.s.aMmioDecodeCache); i++)
+            pVCpu->iom.s.aMmioDecodeCache[i].cbInstr = 0;
+        pVCpu->iom.s.GCPtrMmioDecodeLastMiss = NIL_RTGCPTR;
     }
 
     IOM_UNLOCK_EXCL(pVM);
@@ -319,6 +361,16 @@ VMMR3_INT_DECL(void) IOMR3Relocate(PVM pVM, RTGCINTPTR offDelta)
     RTAvlroIOPortDoWithAll(&pVM->iom.s.pTreesR3->IOPortTreeRC, true, iomR3RelocateIOPortCallback, &offDelta);
     RTAvlroGCPhysDoWithAll(&pVM->iom.s.pTreesR3->MMIOTree,     true, iomR3RelocateMMIOCallback,   &offDelta);
 
+    /*
+     * The lookup table holds raw-mode range pointers, so rebuild it.
+     */
+    pVM->iom.s.pIOPortLookupRC = MMHyperR3ToRC(pVM, pVM->iom.s.pIOPortLookupR3);
+    if (pVM->iom.s.pau32PortCountersR3)
+        pVM->iom.s.pau32PortCountersRC = MMHyperR3ToRC(pVM, (void *)pVM->iom.s.pau32PortCountersR3);
+    IOM_LOCK_EXCL(pVM);
+    iomR3IOPortLookupRebuild(pVM);
+    IOM_UNLOCK_EXCL(pVM);
+
     /*
      * Reset the raw-mode cache (don't bother relocating it).
      */
@@ -326,8 +378,6 @@ VMMR3_INT_DECL(void) IOMR3Relocate(PVM pVM, RTGCINTPTR offDelta)
     while (iCpu-- > 0)
     {
         PVMCPU pVCpu = &pVM->aCpus[iCpu];
-        pVCpu->iom.s.pRangeLastReadRC  = NIL_RTRCPTR;
-        pVCpu->iom.s.pRangeLastWriteRC = NIL_RTRCPTR;
         pVCpu->iom.s.pStatsLastReadRC  = NIL_RTRCPTR;
         pVCpu->iom.s.pStatsLastWriteRC = NIL_RTRCPTR;
         pVCpu->iom.s.pMMIORangeLastRC  = NIL_RTRCPTR;
@@ -605,6 +655,7 @@ VMMR3_INT_DECL(int) IOMR3IOPortRegisterR3(PVM pVM, PPDMDEVINS pDevIns, RTIOPORT
         IOM_LOCK_EXCL(pVM);
         if (RTAvlroIOPortInsert(&pVM->iom.s.pTreesR3->IOPortTreeR3, &pRange->Core))
         {
+            iomR3IOPortLookupUpdate(pVM, PortStart, pRange->Core.KeyLast);
 #ifdef VBOX_WITH_STATISTICS
             for (unsigned iPort = 0; iPort < cPorts; iPort++)
                 iomR3IOPortStatsCreate(pVM, PortStart + iPort, pszDesc);
@@ -726,6 +777,7 @@ VMMR3_INT_DECL(int) IOMR3IOPortRegisterRC(PVM pVM, PPDMDEVINS pDevIns, RTIOPORT
          */
         if (RTAvlroIOPortInsert(&pVM->iom.s.CTX_SUFF(pTrees)->IOPortTreeRC, &pRange->Core))
         {
+            iomR3IOPortLookupUpdate(pVM, PortStart, pRange->Core.KeyLast);
             IOM_UNLOCK_EXCL(pVM);
             return VINF_SUCCESS;
         }
@@ -841,6 +893,7 @@ VMMR3_INT_DECL(int) IOMR3IOPortRegisterR0(PVM pVM, PPDMDEVINS pDevIns, RTIOPORT
          */
         if (RTAvlroIOPortInsert(&pVM->iom.s.CTX_SUFF(pTrees)->IOPortTreeR0, &pRange->Core))
         {
+            iomR3IOPortLookupUpdate(pVM, PortStart, pRange->Core.KeyLast);
             IOM_UNLOCK_EXCL(pVM);
             return VINF_SUCCESS;
         }
@@ -897,6 +950,7 @@ VMMR3_INT_DECL(int) IOMR3IOPortDeregister(PVM pVM, PPDMDEVINS pDevIns, RTIOPORT
      * Check ownership.
      */
     RTIOPORT PortLast = PortStart + (cPorts - 1);
+    RTIOPORT PortUpdateLast = PortLast; /* Split off tails get new ranges. */
     RTIOPORT Port = PortStart;
     while (Port <= PortLast && Port >= PortStart)
     {
@@ -973,6 +1027,8 @@ VMMR3_INT_DECL(int) IOMR3IOPortDeregister(PVM pVM, PPDMDEVINS pDevIns, RTIOPORT
                 int rc2 = MMHyperAlloc(pVM, sizeof(*pRangeNew), 0, MM_TAG_IOM, (void **)&pRangeNew);
                 if (RT_FAILURE(rc2))
                 {
+                    /* Whatever got removed already must go from the lookup table too. */
+                    iomR3IOPortLookupRebuild(pVM);
                     IOM_UNLOCK_EXCL(pVM);
                     return rc2;
                 }
@@ -980,6 +1036,7 @@ VMMR3_INT_DECL(int) IOMR3IOPortDeregister(PVM pVM, PPDMDEVINS pDevIns, RTIOPORT
                 pRangeNew->Core.Key     = PortLast;
                 pRangeNew->Port         = PortLast;
                 pRangeNew->cPorts       = pRangeNew->Core.KeyLast - PortLast + 1;
+                PortUpdateLast          = RT_MAX(PortUpdateLast, pRangeNew->Core.KeyLast);
 
                 LogFlow(("IOMR3IOPortDeregister (rc): split the range; new %x\n", pRangeNew->Core.Key));
 
@@ -1056,6 +1113,8 @@ VMMR3_INT_DECL(int) IOMR3IOPortDeregister(PVM pVM, PPDMDEVINS pDevIns, RTIOPORT
                 int rc2 = MMHyperAlloc(pVM, sizeof(*pRangeNew), 0, MM_TAG_IOM, (void **)&pRangeNew);
                 if (RT_FAILURE(rc2))
                 {
+                    /* Whatever got removed already must go from the lookup table too. */
+                    iomR3IOPortLookupRebuild(pVM);
                     IOM_UNLOCK_EXCL(pVM);
                     return rc2;
                 }
@@ -1063,6 +1122,7 @@ VMMR3_INT_DECL(int) IOMR3IOPortDeregister(PVM pVM, PPDMDEVINS pDevIns, RTIOPORT
                 pRangeNew->Core.Key     = PortLast;
                 pRangeNew->Port         = PortLast;
                 pRangeNew->cPorts       = pRangeNew->Core.KeyLast - PortLast + 1;
+                PortUpdateLast          = RT_MAX(PortUpdateLast, pRangeNew->Core.KeyLast);
 
                 LogFlow(("IOMR3IOPortDeregister (r0): split the range; new %x\n", pRangeNew->Core.Key));
 
@@ -1138,6 +1198,8 @@ VMMR3_INT_DECL(int) IOMR3IOPortDeregister(PVM pVM, PPDMDEVINS pDevIns, RTIOPORT
                 int rc2 = MMHyperAlloc(pVM, sizeof(*pRangeNew), 0, MM_TAG_IOM, (void **)&pRangeNew);
                 if (RT_FAILURE(rc2))
                 {
+                    /* Whatever got removed already must go from the lookup table too. */
+                    iomR3IOPortLookupRebuild(pVM);
                     IOM_UNLOCK_EXCL(pVM);
                     return rc2;
                 }
@@ -1145,6 +1207,7 @@ VMMR3_INT_DECL(int) IOMR3IOPortDeregister(PVM pVM, PPDMDEVINS pDevIns, RTIOPORT
                 pRangeNew->Core.Key     = PortLast;
                 pRangeNew->Port         = PortLast;
                 pRangeNew->cPorts       = pRangeNew->Core.KeyLast - PortLast + 1;
+                PortUpdateLast          = RT_MAX(PortUpdateLast, pRangeNew->Core.KeyLast);
 
                 LogFlow(("IOMR3IOPortDeregister (r3): split the range; new %x\n", pRangeNew->Core.Key));
 
@@ -1167,11 +1230,176 @@ VMMR3_INT_DECL(int) IOMR3IOPortDeregister(PVM pVM, PPDMDEVINS pDevIns, RTIOPORT
     } /* for all ports - ring-3. */
 
     /* done */
+    iomR3IOPortLookupUpdate(pVM, PortStart, PortUpdateLast);
     IOM_UNLOCK_EXCL(pVM);
     return rc;
 }
 
 
+/**
+ * Finds or adds the lookup slot for the given set of ranges.
+ *
+ * @returns Slot index, 0 if out of slots.
+ * @param   pVM         The cross context VM structure.
+ * @param   pLookup     The lookup table (ring-3 mapping).
+ * @param   pRangeR3    The ring-3 range, NULL if none.
+ * @param   pRangeR0    The ring-0 range (ring-3 mapping), NULL if none.
+ * @param   pRangeRC    The raw-mode range (ring-3 mapping), NULL if none.
+ */
+static uint16_t iomR3IOPortLookupGetSlot(PVM pVM, PIOMIOPORTLOOKUP pLookup, PIOMIOPORTRANGER3 pRangeR3,
+                                         PIOMIOPORTRANGER0 pRangeR0, PIOMIOPORTRANGERC pRangeRC)
+{
+    RTR0PTR const R0PtrRange = pRangeR0 ? MMHyperR3ToR0(pVM, pRangeR0) : NIL_RTR0PTR;
+    RTRCPTR const RCPtrRange = pRangeRC ? MMHyperR3ToRC(pVM, pRangeRC) : NIL_RTRCPTR;
+    for (uint16_t iSlot = 1; iSlot < pLookup->cSlots; iSlot++)
+        if (   pLookup->aSlots[iSlot].pRangeR3 == pRangeR3
+            && pLookup->aSlots[iSlot].pRangeR0 == R0PtrRange
+            && pLookup->aSlots[iSlot].pRangeRC == RCPtrRange)
+            return iSlot;
+
+    uint16_t const iSlot = pLookup->cSlots;
+    if (iSlot >= RT_ELEMENTS(pLookup->aSlots))
+        return 0;
+    pLookup->aSlots[iSlot].pRangeR3 = pRangeR3;
+    pLookup->aSlots[iSlot].pRangeR0 = R0PtrRange;
+    pLookup->aSlots[iSlot].pRangeRC = RCPtrRange;
+    pLookup->cSlots = iSlot + 1;
+    return iSlot;
+}
+
+
+/**
+ * Enters the lookup slots for a range of I/O ports, looking them up in the
+ * range trees.
+ *
+ * @returns true on success, false if out of pages or slots.
+ * @param   pVM         The cross context VM structure.
+ * @param   pLookup     The lookup table (ring-3 mapping).
+ * @param   uFirst      The first port.
+ * @param   uLast       The last port (inclusive).
+ */
+static bool iomR3IOPortLookupFill(PVM pVM, PIOMIOPORTLOOKUP pLookup, uint32_t uFirst, uint32_t uLast)
+{
+    PIOMTREES         pTrees   = pVM->iom.s.pTreesR3;
+    PIOMIOPORTRANGER3 pRangeR3 = NULL;
+    PIOMIOPORTRANGER0 pRangeR0 = NULL;
+    PIOMIOPORTRANGERC pRangeRC = NULL;
+    uint16_t          iSlot    = 0;
+    for (uint32_t uPort = uFirst; uPort <= uLast; uPort++)
+    {
+        /*
+         * Look up the ranges covering this port, reusing the previous ones
+         * when we're still inside them.
+         */
+        bool fChanged = false;
+        if (!pRangeR3 || uPort - pRangeR3->Port >= pRangeR3->cPorts)
+        {
+            PIOMIOPORTRANGER3 pNew = (PIOMIOPORTRANGER3)RTAvlroIOPortRangeGet(&pTrees->IOPortTreeR3, (RTIOPORT)uPort);
+            fChanged |= pNew != pRangeR3;
+            pRangeR3  = pNew;
+        }
+        if (!pRangeR0 || uPort - pRangeR0->Port >= pRangeR0->cPorts)
+        {
+            PIOMIOPORTRANGER0 pNew = (PIOMIOPORTRANGER0)RTAvlroIOPortRangeGet(&pTrees->IOPortTreeR0, (RTIOPORT)uPort);
+            fChanged |= pNew != pRangeR0;
+            pRangeR0  = pNew;
+        }
+        if (!pRangeRC || uPort - pRangeRC->Port >= pRangeRC->cPorts)
+        {
+            PIOMIOPORTRANGERC pNew = (PIOMIOPORTRANGERC)RTAvlroIOPortRangeGet(&pTrees->IOPortTreeRC, (RTIOPORT)uPort);
+            fChanged |= pNew != pRangeRC;
+            pRangeRC  = pNew;
+        }
+        if (fChanged)
+        {
+            if (pRangeR3 || pRangeR0 || pRangeRC)
+            {
+                iSlot = iomR3IOPortLookupGetSlot(pVM, pLookup, pRangeR3, pRangeR0, pRangeRC);
+                if (!iSlot)
+                    return false;
+            }
+            else
+                iSlot = 0;
+        }
+
+        /*
+         * Make sure the port page has its own lookup page and enter the slot.
+         * Ports without ranges on pages without a lookup page are done.
+         */
+        uint32_t const iTop  = uPort >> IOM_IOPORT_LOOKUP_PAGE_SHIFT;
+        uint16_t       iPage = pLookup->aiPages[iTop];
+        if (!iPage)
+        {
+            if (!iSlot)
+                continue;
+            iPage = pLookup->cPages;
+            if (iPage >= RT_ELEMENTS(pLookup->aPages))
+                return false;
+            RT_ZERO(pLookup->aPages[iPage]);
+            pLookup->cPages        = iPage + 1;
+            pLookup->aiPages[iTop] = iPage;
+        }
+        pLookup->aPages[iPage].aiSlots[uPort & (IOM_IOPORT_LOOKUP_PAGE_PORTS - 1)] = iSlot;
+    }
+    return true;
+}
+
+
+/**
+ * Rebuilds the direct indexed I/O port lookup table from the range trees.
+ *
+ * Must be called while owning the IOM lock exclusively (or during init).  Leaves
+ * the table invalid, causing lookups to fall back on the trees, should it run
+ * out of pages or slots.
+ *
+ * @param   pVM         The cross context VM structure.
+ */
+void iomR3IOPortLookupRebuild(PVM pVM)
+{
+    PIOMIOPORTLOOKUP pLookup = pVM->iom.s.pIOPortLookupR3;
+    ASMAtomicWriteBool(&pLookup->fValid, false);
+
+    /* Page 0 and slot 0 are the empty ones. */
+    RT_ZERO(pLookup->aiPages);
+    RT_ZERO(pLookup->aPages[0]);
+    RT_ZERO(pLookup->aSlots[0]);
+    pLookup->aSlots[0].pRangeR0 = NIL_RTR0PTR;
+    pLookup->aSlots[0].pRangeRC = NIL_RTRCPTR;
+    pLookup->cPages = 1;
+    pLookup->cSlots = 1;
+
+    if (!iomR3IOPortLookupFill(pVM, pLookup, 0, _64K - 1))
+    {
+        LogRel(("IOM: Out of I/O port lookup pages or slots, falling back on the range trees\n"));
+        return;
+    }
+
+    Log(("iomR3IOPortLookupRebuild: cPages=%u cSlots=%u\n", pLookup->cPages, pLookup->cSlots));
+    ASMAtomicWriteBool(&pLookup->fValid, true);
+}
+
+
+/**
+ * Updates the direct indexed I/O port lookup table after the ranges covering
+ * the given ports changed in any context.
+ *
+ * Only the given ports are redone, unless the table is invalid or runs out of
+ * pages or slots, in which case it is rebuilt from scratch.
+ *
+ * @param   pVM         The cross context VM structure.
+ * @param   PortFirst   The first port affected.
+ * @param   PortLast    The last port affected (inclusive).
+ */
+void iomR3IOPortLookupUpdate(PVM pVM, RTIOPORT PortFirst, RTIOPORT PortLast)
+{
+    Assert(PortFirst <= PortLast);
+    PIOMIOPORTLOOKUP pLookup = pVM->iom.s.pIOPortLookupR3;
+    if (   !pLookup->fValid
+        || !iomR3IOPortLookupFill(pVM, pLookup, PortFirst, PortLast))
+        iomR3IOPortLookupRebuild(pVM);
+}
+
+
 /**
  * Dummy Port I/O Handler for IN operations.
  *
@@ -1331,6 +1559,115 @@ static DECLCALLBACK(void) iomR3IOPortInfo(PVM pVM, PCDBGFINFOHLP pHlp, const cha
 }
 
 
+/**
+ * I/O port access count entry for iomR3IOPortCountersInfo.
+ */
+typedef struct IOMIOPORTCOUNTENTRY
+{
+    uint32_t    cAccesses;
+    RTIOPORT    uPort;
+} IOMIOPORTCOUNTENTRY;
+
+
+/**
+ * @callback_method_impl{FNRTSORTCMP, Sorts by descending access count.}
+ */
+static DECLCALLBACK(int) iomR3IOPortCountCompare(void const *pvElement1, void const *pvElement2, void *pvUser)
+{
+    IOMIOPORTCOUNTENTRY const *pEntry1 = (IOMIOPORTCOUNTENTRY const *)pvElement1;
+    IOMIOPORTCOUNTENTRY const *pEntry2 = (IOMIOPORTCOUNTENTRY const *)pvElement2;
+    NOREF(pvUser);
+    if (pEntry1->cAccesses != pEntry2->cAccesses)
+        return pEntry1->cAccesses > pEntry2->cAccesses ? -1 : 1;
+    return (int)pEntry1->uPort - (int)pEntry2->uPort;
+}
+
+
+/**
+ * Display the most accessed I/O ports.
+ *
+ * @param   pVM         The cross context VM structure.
+ * @param   pHlp        The info helpers.
+ * @param   pszArgs     Max number of ports to list (default 32) and/or 'reset'
+ *                      to zero the counters after listing them.
+ */
+static DECLCALLBACK(void) iomR3IOPortCountersInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs)
+{
+    uint32_t volatile *pau32Counters = pVM->iom.s.pau32PortCountersR3;
+    if (!pau32Counters)
+    {
+        pHlp->pfnPrintf(pHlp, "I/O port counting is disabled, set /IOM/PortCounters to enable it.\n");
+        return;
+    }
+
+    uint32_t cMax   = 32;
+    bool     fReset = false;
+    if (pszArgs)
+    {
+        pszArgs = RTStrStripL(pszArgs);
+        if (RT_C_IS_DIGIT(*pszArgs))
+        {
+            char *pszNext;
+            RTStrToUInt32Ex(pszArgs, &pszNext, 0, &cMax);
+            pszArgs = pszNext;
+        }
+        fReset = strstr(pszArgs, "reset") != NULL;
+    }
+
+    /*
+     * Collect the ports which have been accessed and sort them.
+     */
+    uint32_t cEntries = 0;
+    for (uint32_t uPort = 0; uPort < _64K; uPort++)
+        cEntries += pau32Counters[uPort] != 0;
+    IOMIOPORTCOUNTENTRY *paEntries = cEntries
+                                   ? (IOMIOPORTCOUNTENTRY *)RTMemAlloc(sizeof(paEntries[0]) * cEntries) : NULL;
+    if (cEntries && !paEntries)
+    {
+        pHlp->pfnPrintf(pHlp, "Out of memory!\n");
+        return;
+    }
+    uint32_t i = 0;
+    for (uint32_t uPort = 0; uPort < _64K && i < cEntries; uPort++)
+    {
+        uint32_t const cAccesses = pau32Counters[uPort];
+        if (cAccesses)
+        {
+            paEntries[i].cAccesses = cAccesses;
+            paEntries[i].uPort     = (RTIOPORT)uPort;
+            i++;
+        }
+    }
+    cEntries = i;
+    if (cEntries)
+        RTSortShell(paEntries, cEntries, sizeof(paEntries[0]), iomR3IOPortCountCompare, NULL);
+
+    /*
+     * Display them.
+     */
+    pHlp->pfnPrintf(pHlp,
+                    "I/O port accesses (%u ports accessed, deferrals from R0/RC are counted in R3 too)\n"
+                    "Port       Accesses Description\n",
+                    cEntries);
+    IOM_LOCK_SHARED(pVM);
+    for (i = 0; i < cEntries && i < cMax; i++)
+    {
+        PIOMIOPORTRANGER3 pRange = iomIOPortGetRangeR3(pVM, paEntries[i].uPort);
+        pHlp->pfnPrintf(pHlp, "%04x %14u %s\n", paEntries[i].uPort, paEntries[i].cAccesses,
+                        pRange ? pRange->pszDesc : "<unassigned>");
+    }
+    IOM_UNLOCK_SHARED(pVM);
+    RTMemFree(paEntries);
+
+    if (fReset)
+    {
+        for (uint32_t uPort = 0; uPort < _64K; uPort++)
+            ASMAtomicWriteU32(&pau32Counters[uPort], 0);
+        pHlp->pfnPrintf(pHlp, "The counters have been reset.\n");
+    }
+}
+
+
 /**
  * Registers a Memory Mapped I/O R3 handler.
  *
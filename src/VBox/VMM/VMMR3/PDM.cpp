@@ -699,6 +699,9 @@ VMMR3_INT_DECL(int) PDMR3Term(PVM pVM)
     {
         pdmR3TermLuns(pVM, pDevIns->Internal.s.pLunsR3, pDevIns->pReg->szName, pDevIns->iInstance);
 
+        /* Queue workers must not call into a device being destroyed. */
+        pdmR3QueueStopWorkersDevice(pVM, pDevIns);
+
         if (pDevIns->pReg->pfnDestruct)
         {
             LogFlow(("pdmR3DevTerm: Destroying - device '%s'/%d\n",
@@ -99,47 +99,76 @@ DECLINLINE(void) pdmBlkCacheEntryRef(PPDMBLKCACHEENTRY pEntry)
 }
 
 #ifdef VBOX_STRICT
-static void pdmBlkCacheValidate(PPDMBLKCACHEGLOBAL pCache)
+static void pdmBlkCacheValidate(PPDMBLKCACHE pBlkCache)
 {
     /* Amount of cached data should never exceed the maximum amount. */
-    AssertMsg(pCache->cbCached <= pCache->cbMax,
+    AssertMsg(pBlkCache->cbCached <= pBlkCache->cbMax,
               ("Current amount of cached data exceeds maximum\n"));
 
     /* The amount of cached data in the LRU and FRU list should match cbCached */
-    AssertMsg(pCache->LruRecentlyUsedIn.cbCached + pCache->LruFrequentlyUsed.cbCached == pCache->cbCached,
+    AssertMsg(pBlkCache->LruRecentlyUsedIn.cbCached + pBlkCache->LruFrequentlyUsed.cbCached == pBlkCache->cbCached,
               ("Amount of cached data doesn't match\n"));
 
-    AssertMsg(pCache->LruRecentlyUsedOut.cbCached <= pCache->cbRecentlyUsedOutMax,
+    AssertMsg(pBlkCache->LruRecentlyUsedOut.cbCached <= pBlkCache->cbMax,
               ("Paged out list exceeds maximum\n"));
+    AssertMsg(pBlkCache->LruFrequentlyUsedOut.cbCached <= pBlkCache->cbMax,
+              ("Frequently used paged out list exceeds maximum\n"));
+    AssertMsg(pBlkCache->cbRecentlyUsedInTarget <= pBlkCache->cbMax,
+              ("Adaptive target exceeds maximum\n"));
 }
 #endif
 
 DECLINLINE(void) pdmBlkCacheLockEnter(PPDMBLKCACHEGLOBAL pCache)
 {
     RTCritSectEnter(&pCache->CritSect);
+}
+
+DECLINLINE(void) pdmBlkCacheLockLeave(PPDMBLKCACHEGLOBAL pCache)
+{
+    RTCritSectLeave(&pCache->CritSect);
+}
+
+DECLINLINE(void) pdmBlkCacheEpLockEnter(PPDMBLKCACHE pBlkCache)
+{
+    RTCritSectEnter(&pBlkCache->CritSect);
 #ifdef VBOX_STRICT
-    pdmBlkCacheValidate(pCache);
+    pdmBlkCacheValidate(pBlkCache);
 #endif
 }
 
-DECLINLINE(void) pdmBlkCacheLockLeave(PPDMBLKCACHEGLOBAL pCache)
+DECLINLINE(void) pdmBlkCacheEpLockLeave(PPDMBLKCACHE pBlkCache)
 {
 #ifdef VBOX_STRICT
-    pdmBlkCacheValidate(pCache);
+    pdmBlkCacheValidate(pBlkCache);
 #endif
-    RTCritSectLeave(&pCache->CritSect);
+    RTCritSectLeave(&pBlkCache->CritSect);
 }
 
-DECLINLINE(void) pdmBlkCacheSub(PPDMBLKCACHEGLOBAL pCache, uint32_t cbAmount)
+DECLINLINE(void) pdmBlkCacheSub(PPDMBLKCACHE pBlkCache, uint32_t cbAmount)
 {
-    PDMACFILECACHE_IS_CRITSECT_OWNER(pCache);
-    pCache->cbCached -= cbAmount;
+    PDMACFILECACHE_IS_CRITSECT_OWNER(pBlkCache);
+    pBlkCache->cbCached -= cbAmount;
+    ASMAtomicSubU32(&pBlkCache->pCache->cbCached, cbAmount);
 }
 
-DECLINLINE(void) pdmBlkCacheAdd(PPDMBLKCACHEGLOBAL pCache, uint32_t cbAmount)
+DECLINLINE(void) pdmBlkCacheAdd(PPDMBLKCACHE pBlkCache, uint32_t cbAmount)
 {
-    PDMACFILECACHE_IS_CRITSECT_OWNER(pCache);
-    pCache->cbCached += cbAmount;
+    PDMACFILECACHE_IS_CRITSECT_OWNER(pBlkCache);
+    pBlkCache->cbCached += cbAmount;
+    ASMAtomicAddU32(&pBlkCache->pCache->cbCached, cbAmount);
+}
+
+/**
+ * Checks whether the given entry is on one of the ghost lists of its endpoint.
+ *
+ * @returns true if the entry has no data assigned, false otherwise.
+ * @param   pBlkCache   The endpoint cache the entry belongs to.
+ * @param   pEntry      The entry to check.
+ */
+DECLINLINE(bool) pdmBlkCacheEntryIsGhost(PPDMBLKCACHE pBlkCache, PPDMBLKCACHEENTRY pEntry)
+{
+    return    pEntry->pList != &pBlkCache->LruRecentlyUsedIn
+           && pEntry->pList != &pBlkCache->LruFrequentlyUsed;
 }
 
 DECLINLINE(void) pdmBlkCacheListAdd(PPDMBLKLRULIST pList, uint32_t cbAmount)
@@ -307,7 +336,7 @@ static void pdmBlkCacheDestroyList(PPDMBLKLRULIST pList)
  * moving the entries to one of the given ghosts lists
  *
  * @returns Amount of data which could be freed.
- * @param    pCache           Pointer to the global cache data.
+ * @param    pBlkCache        The endpoint cache to evict data from.
  * @param    cbData           The amount of the data to free.
  * @param    pListSrc         The source list to evict data from.
  * @param    pGhostListDst    Where the ghost list removed entries should be
@@ -322,18 +351,21 @@ static void pdmBlkCacheDestroyList(PPDMBLKLRULIST pList)
  *          may be marked as non evictable if they are used for I/O at the
  *          moment.
  */
-static size_t pdmBlkCacheEvictPagesFrom(PPDMBLKCACHEGLOBAL pCache, size_t cbData,
+static size_t pdmBlkCacheEvictPagesFrom(PPDMBLKCACHE pBlkCache, size_t cbData,
                                         PPDMBLKLRULIST pListSrc, PPDMBLKLRULIST pGhostListDst,
                                         bool fReuseBuffer, uint8_t **ppbBuffer)
 {
+    PPDMBLKCACHEGLOBAL pCache = pBlkCache->pCache;
     size_t cbEvicted = 0;
+    NOREF(pCache);
 
-    PDMACFILECACHE_IS_CRITSECT_OWNER(pCache);
+    PDMACFILECACHE_IS_CRITSECT_OWNER(pBlkCache);
 
     AssertMsg(cbData > 0, ("Evicting 0 bytes not possible\n"));
     AssertMsg(   !pGhostListDst
-              || (pGhostListDst == &pCache->LruRecentlyUsedOut),
-              ("Destination list must be NULL or the recently used but paged out list\n"));
+              || (pGhostListDst == &pBlkCache->LruRecentlyUsedOut)
+              || (pGhostListDst == &pBlkCache->LruFrequentlyUsedOut),
+              ("Destination list must be NULL or one of the paged out lists\n"));
 
     if (fReuseBuffer)
     {
@@ -356,7 +388,7 @@ static size_t pdmBlkCacheEvictPagesFrom(PPDMBLKCACHEGLOBAL pCache, size_t cbData
         {
             /* Ok eviction candidate. Grab the endpoint semaphore and check again
              * because somebody else might have raced us. */
-            PPDMBLKCACHE pBlkCache = pCurr->pBlkCache;
+            Assert(pCurr->pBlkCache == pBlkCache);
             RTSemRWRequestWrite(pBlkCache->SemRWEntries, RT_INDEFINITE_WAIT);
 
             if (!(pCurr->fFlags & PDMBLKCACHE_NOT_EVICTABLE)
@@ -374,46 +406,40 @@ static size_t pdmBlkCacheEvictPagesFrom(PPDMBLKCACHEGLOBAL pCache, size_t cbData
 
                 pCurr->pbData = NULL;
                 cbEvicted += pCurr->cbData;
+                STAM_COUNTER_ADD(&pBlkCache->StatEvicted, pCurr->cbData);
 
                 pdmBlkCacheEntryRemoveFromList(pCurr);
-                pdmBlkCacheSub(pCache, pCurr->cbData);
+                pdmBlkCacheSub(pBlkCache, pCurr->cbData);
 
                 if (pGhostListDst)
                 {
-                    RTSemRWReleaseWrite(pBlkCache->SemRWEntries);
-
                     PPDMBLKCACHEENTRY pGhostEntFree = pGhostListDst->pTail;
 
                     /* We have to remove the last entries from the paged out list. */
-                    while (   pGhostListDst->cbCached + pCurr->cbData > pCache->cbRecentlyUsedOutMax
+                    while (   pGhostListDst->cbCached + pCurr->cbData > pBlkCache->cbMax
                            && pGhostEntFree)
                     {
                         PPDMBLKCACHEENTRY pFree = pGhostEntFree;
-                        PPDMBLKCACHE pBlkCacheFree = pFree->pBlkCache;
 
                         pGhostEntFree = pGhostEntFree->pPrev;
 
-                        RTSemRWRequestWrite(pBlkCacheFree->SemRWEntries, RT_INDEFINITE_WAIT);
-
                         if (ASMAtomicReadU32(&pFree->cRefs) == 0)
                         {
                             pdmBlkCacheEntryRemoveFromList(pFree);
 
                             STAM_PROFILE_ADV_START(&pCache->StatTreeRemove, Cache);
-                            RTAvlrU64Remove(pBlkCacheFree->pTree, pFree->Core.Key);
+                            RTAvlrU64Remove(pBlkCache->pTree, pFree->Core.Key);
                             STAM_PROFILE_ADV_STOP(&pCache->StatTreeRemove, Cache);
 
                             RTMemFree(pFree);
                         }
-
-                        RTSemRWReleaseWrite(pBlkCacheFree->SemRWEntries);
                     }
 
-                    if (pGhostListDst->cbCached + pCurr->cbData > pCache->cbRecentlyUsedOutMax)
+                    if (pGhostListDst->cbCached + pCurr->cbData > pBlkCache->cbMax)
                     {
                         /* Couldn't remove enough entries. Delete */
                         STAM_PROFILE_ADV_START(&pCache->StatTreeRemove, Cache);
-                        RTAvlrU64Remove(pCurr->pBlkCache->pTree, pCurr->Core.Key);
+                        RTAvlrU64Remove(pBlkCache->pTree, pCurr->Core.Key);
                         STAM_PROFILE_ADV_STOP(&pCache->StatTreeRemove, Cache);
 
                         RTMemFree(pCurr);
@@ -425,14 +451,14 @@ static size_t pdmBlkCacheEvictPagesFrom(PPDMBLKCACHEGLOBAL pCache, size_t cbData
                 {
                     /* Delete the entry from the AVL tree it is assigned to. */
                     STAM_PROFILE_ADV_START(&pCache->StatTreeRemove, Cache);
-                    RTAvlrU64Remove(pCurr->pBlkCache->pTree, pCurr->Core.Key);
+                    RTAvlrU64Remove(pBlkCache->pTree, pCurr->Core.Key);
                     STAM_PROFILE_ADV_STOP(&pCache->StatTreeRemove, Cache);
 
-                    RTSemRWReleaseWrite(pBlkCache->SemRWEntries);
                     RTMemFree(pCurr);
                 }
             }
 
+            RTSemRWReleaseWrite(pBlkCache->SemRWEntries);
         }
         else
             LogFlow(("Entry %#p (%u bytes) is still in progress and can't be evicted\n", pCurr, pCurr->cbData));
@@ -441,49 +467,250 @@ static size_t pdmBlkCacheEvictPagesFrom(PPDMBLKCACHEGLOBAL pCache, size_t cbData
     return cbEvicted;
 }
 
-static bool pdmBlkCacheReclaim(PPDMBLKCACHEGLOBAL pCache, size_t cbData, bool fReuseBuffer, uint8_t **ppbBuffer)
+/**
+ * Evicts the given amount of data from an endpoint following the ARC
+ * replacement policy.
+ *
+ * Entries are evicted from the recently used list (T1) if it exceeds the
+ * adaptive target size and from the frequently used list (T2) otherwise.
+ * Evicted entries are remembered on the matching ghost list.
+ *
+ * @returns Amount of data which could be freed.
+ * @param   pBlkCache       The endpoint cache to evict data from.
+ * @param   cbData          The amount of the data to free.
+ * @param   fGhostHitFreq   Flag whether the eviction is caused by a hit in the
+ *                          frequently used ghost list (B2).
+ * @param   fReuseBuffer    Flag whether a buffer should be reused if it has
+ *                          the same size.
+ * @param   ppbBuffer       Where to store the address of the buffer if an
+ *                          entry with the same size was found.
+ */
+static size_t pdmBlkCacheReplace(PPDMBLKCACHE pBlkCache, size_t cbData, bool fGhostHitFreq,
+                                 bool fReuseBuffer, uint8_t **ppbBuffer)
 {
-    size_t cbRemoved = 0;
+    PPDMBLKLRULIST pListFirst  = &pBlkCache->LruFrequentlyUsed;
+    PPDMBLKLRULIST pGhostFirst = &pBlkCache->LruFrequentlyUsedOut;
+    PPDMBLKLRULIST pListSecond = &pBlkCache->LruRecentlyUsedIn;
+    PPDMBLKLRULIST pGhostSecond = &pBlkCache->LruRecentlyUsedOut;
+
+    if (   pBlkCache->LruRecentlyUsedIn.cbCached
+        && (   pBlkCache->LruRecentlyUsedIn.cbCached > pBlkCache->cbRecentlyUsedInTarget
+            || (   fGhostHitFreq
+                && pBlkCache->LruRecentlyUsedIn.cbCached == pBlkCache->cbRecentlyUsedInTarget)))
+    {
+        pListFirst   = &pBlkCache->LruRecentlyUsedIn;
+        pGhostFirst  = &pBlkCache->LruRecentlyUsedOut;
+        pListSecond  = &pBlkCache->LruFrequentlyUsed;
+        pGhostSecond = &pBlkCache->LruFrequentlyUsedOut;
+    }
 
-    if ((pCache->cbCached + cbData) < pCache->cbMax)
-        return true;
-    else if ((pCache->LruRecentlyUsedIn.cbCached + cbData) > pCache->cbRecentlyUsedInMax)
+    size_t cbRemoved = pdmBlkCacheEvictPagesFrom(pBlkCache, cbData, pListFirst, pGhostFirst,
+                                                 fReuseBuffer, ppbBuffer);
+
+    /*
+     * If it was not possible to remove enough entries
+     * try the other list.
+     */
+    if (cbRemoved < cbData)
     {
-        /* Try to evict as many bytes as possible from A1in */
-        cbRemoved = pdmBlkCacheEvictPagesFrom(pCache, cbData, &pCache->LruRecentlyUsedIn,
-                                                 &pCache->LruRecentlyUsedOut, fReuseBuffer, ppbBuffer);
+        Assert(!fReuseBuffer || !*ppbBuffer); /* It is not possible that we got a buffer with the correct size but we didn't freed enough data. */
 
         /*
-         * If it was not possible to remove enough entries
-         * try the frequently accessed cache.
+         * If we removed something we can't pass the reuse buffer flag anymore because
+         * we don't need to evict that much data
          */
-        if (cbRemoved < cbData)
-        {
-            Assert(!fReuseBuffer || !*ppbBuffer); /* It is not possible that we got a buffer with the correct size but we didn't freed enough data. */
+        if (!cbRemoved)
+            cbRemoved += pdmBlkCacheEvictPagesFrom(pBlkCache, cbData, pListSecond, pGhostSecond,
+                                                   fReuseBuffer, ppbBuffer);
+        else
+            cbRemoved += pdmBlkCacheEvictPagesFrom(pBlkCache, cbData - cbRemoved, pListSecond, pGhostSecond,
+                                                   false, NULL);
+    }
 
-            /*
-             * If we removed something we can't pass the reuse buffer flag anymore because
-             * we don't need to evict that much data
-             */
-            if (!cbRemoved)
-                cbRemoved += pdmBlkCacheEvictPagesFrom(pCache, cbData, &pCache->LruFrequentlyUsed,
-                                                          NULL, fReuseBuffer, ppbBuffer);
-            else
-                cbRemoved += pdmBlkCacheEvictPagesFrom(pCache, cbData - cbRemoved, &pCache->LruFrequentlyUsed,
-                                                          NULL, false, NULL);
+    return cbRemoved;
+}
+
+/**
+ * Tries to free the given amount of data from other endpoints which occupy
+ * more than their guaranteed minimum.
+ *
+ * @returns Amount of data which could be freed.
+ * @param   pBlkCache       The endpoint cache requiring the space, the caller
+ *                          owns its critical section.
+ * @param   cbData          The amount of the data to free.
+ *
+ * @note    Only try-locks are used here because the caller already owns the
+ *          critical section of its own endpoint.
+ */
+static size_t pdmBlkCacheReclaimFromOthers(PPDMBLKCACHE pBlkCache, size_t cbData)
+{
+    PPDMBLKCACHEGLOBAL pCache = pBlkCache->pCache;
+    size_t cbRemoved = 0;
+
+    if (RT_FAILURE(RTCritSectTryEnter(&pCache->CritSect)))
+        return 0;
+
+    PPDMBLKCACHE pOther;
+    RTListForEach(&pCache->ListUsers, pOther, PDMBLKCACHE, NodeCacheUser)
+    {
+        if (cbRemoved >= cbData)
+            break;
+
+        if (   pOther != pBlkCache
+            && ASMAtomicReadU32(&pOther->cbCached) > ASMAtomicReadU32(&pOther->cbMin)
+            && RT_SUCCESS(RTCritSectTryEnter(&pOther->CritSect)))
+        {
+            /* Grab the entry semaphore upfront so the eviction can't block on it. */
+            if (RT_SUCCESS(RTSemRWRequestWrite(pOther->SemRWEntries, 0)))
+            {
+                size_t cbAvail = pOther->cbCached > pOther->cbMin ? pOther->cbCached - pOther->cbMin : 0;
+                if (cbAvail)
+                    cbRemoved += pdmBlkCacheReplace(pOther, RT_MIN(cbAvail, cbData - cbRemoved),
+                                                    false /*fGhostHitFreq*/, false /*fReuseBuffer*/, NULL);
+                RTSemRWReleaseWrite(pOther->SemRWEntries);
+            }
+            RTCritSectLeave(&pOther->CritSect);
         }
     }
-    else
+
+    RTCritSectLeave(&pCache->CritSect);
+
+    STAM_COUNTER_ADD(&pCache->StatBytesStolen, cbRemoved);
+    return cbRemoved;
+}
+
+/**
+ * Makes room for the given amount of data in an endpoint cache.
+ *
+ * @returns Flag whether enough room is available now.
+ * @param   pBlkCache       The endpoint cache, the caller owns its critical section.
+ * @param   cbData          The amount of data which needs to fit.
+ * @param   fGhostHitFreq   Flag whether the space is required because of a hit
+ *                          in the frequently used ghost list (B2).
+ * @param   fReuseBuffer    Flag whether a buffer should be reused if it has
+ *                          the same size.
+ * @param   ppbBuffer       Where to store the address of the buffer if an
+ *                          entry with the same size was found.
+ *
+ * @note    The global limit is only enforced by the endpoint making the
+ *          allocation, so concurrently allocating endpoints may exceed it by
+ *          at most one entry each.
+ */
+static bool pdmBlkCacheReclaim(PPDMBLKCACHE pBlkCache, size_t cbData, bool fGhostHitFreq,
+                               bool fReuseBuffer, uint8_t **ppbBuffer)
+{
+    PPDMBLKCACHEGLOBAL pCache = pBlkCache->pCache;
+    size_t cbRemoved = 0;
+
+    if (fReuseBuffer)
+        *ppbBuffer = NULL;
+
+    bool fOverEp     = pBlkCache->cbCached + cbData > pBlkCache->cbMax;
+    bool fOverGlobal = ASMAtomicReadU32(&pCache->cbCached) + cbData > pCache->cbMax;
+    if (!fOverEp && !fOverGlobal)
+        return true;
+
+    /*
+     * An endpoint below its guaranteed minimum takes the space from the others
+     * instead of evicting its own entries.
+     */
+    if (   !fOverEp
+        && pBlkCache->cbCached + cbData <= ASMAtomicReadU32(&pBlkCache->cbMin))
     {
-        /* We have to remove entries from frequently access list. */
-        cbRemoved = pdmBlkCacheEvictPagesFrom(pCache, cbData, &pCache->LruFrequentlyUsed,
-                                                 NULL, fReuseBuffer, ppbBuffer);
+        cbRemoved = pdmBlkCacheReclaimFromOthers(pBlkCache, cbData);
+        if (cbRemoved >= cbData)
+            return true;
     }
 
+    cbRemoved += pdmBlkCacheReplace(pBlkCache, cbData - cbRemoved, fGhostHitFreq,
+                                    fReuseBuffer && !cbRemoved, ppbBuffer);
+
     LogFlowFunc((": removed %u bytes, requested %u\n", cbRemoved, cbData));
     return (cbRemoved >= cbData);
 }
 
+/**
+ * Adapts the target size of the recently used list after a hit in one of the
+ * ghost lists.
+ *
+ * @returns nothing.
+ * @param   pBlkCache       The endpoint cache, the caller owns its critical section.
+ * @param   pEntry          The ghost entry which was hit, still linked into its list.
+ */
+static void pdmBlkCacheGhostHit(PPDMBLKCACHE pBlkCache, PPDMBLKCACHEENTRY pEntry)
+{
+    uint32_t cbRecentOut = RT_MAX(pBlkCache->LruRecentlyUsedOut.cbCached, 1);
+    uint32_t cbFreqOut   = RT_MAX(pBlkCache->LruFrequentlyUsedOut.cbCached, 1);
+
+    STAM_COUNTER_INC(&pBlkCache->StatGhostHits);
+
+    if (pEntry->pList == &pBlkCache->LruRecentlyUsedOut)
+    {
+        /* Recency is paying off, grow the target for T1. */
+        uint64_t cbDelta = (uint64_t)RT_MAX(cbFreqOut / cbRecentOut, 1) * pEntry->cbData;
+        pBlkCache->cbRecentlyUsedInTarget = (uint32_t)RT_MIN(pBlkCache->cbRecentlyUsedInTarget + cbDelta,
+                                                             pBlkCache->cbMax);
+    }
+    else
+    {
+        /* Frequency is paying off, shrink the target for T1. */
+        uint64_t cbDelta = (uint64_t)RT_MAX(cbRecentOut / cbFreqOut, 1) * pEntry->cbData;
+        pBlkCache->cbRecentlyUsedInTarget = pBlkCache->cbRecentlyUsedInTarget > cbDelta
+                                          ? pBlkCache->cbRecentlyUsedInTarget - (uint32_t)cbDelta
+                                          : 0;
+    }
+}
+
+/**
+ * Updates the sequential access detection of an endpoint.
+ *
+ * @returns Flag whether the endpoint is scanning, i.e. accessed more than the
+ *          configured threshold sequentially.
+ * @param   pBlkCache       The endpoint cache.
+ * @param   off             Start offset of the access.
+ * @param   cb              Size of the access.
+ */
+static bool pdmBlkCacheScanDetect(PPDMBLKCACHE pBlkCache, uint64_t off, size_t cb)
+{
+    uint32_t cbScanThreshold = pBlkCache->pCache->cbScanThreshold;
+
+    if (!cbScanThreshold)
+        return false;
+
+    /* Racing updates only make the heuristic less precise, they don't corrupt anything. */
+    uint64_t offSeqPrev = ASMAtomicXchgU64(&pBlkCache->offSeqNext, off + cb);
+    uint64_t cbSeqRun;
+    if (offSeqPrev == off)
+        cbSeqRun = ASMAtomicAddU64(&pBlkCache->cbSeqRun, cb) + cb;
+    else
+    {
+        ASMAtomicWriteU64(&pBlkCache->cbSeqRun, 0);
+        cbSeqRun = 0;
+    }
+
+    return cbSeqRun >= cbScanThreshold;
+}
+
+/**
+ * Recalculates the fair share minimum of all endpoints without an explicitly
+ * configured minimum.
+ *
+ * @returns nothing.
+ * @param   pCache          The global cache data, the caller owns the critical section.
+ */
+static void pdmBlkCacheUpdateFairShare(PPDMBLKCACHEGLOBAL pCache)
+{
+    PDMACFILECACHE_IS_CRITSECT_OWNER(pCache);
+
+    PPDMBLKCACHE pBlkCache;
+    RTListForEach(&pCache->ListUsers, pBlkCache, PDMBLKCACHE, NodeCacheUser)
+    {
+        if (!pBlkCache->fMinFixed)
+            ASMAtomicWriteU32(&pBlkCache->cbMin,
+                              RT_MIN(pCache->cbMax / RT_MAX(pCache->cRefs, 1), pBlkCache->cbMax));
+    }
+}
+
 DECLINLINE(int) pdmBlkCacheEnqueue(PPDMBLKCACHE pBlkCache, uint64_t off, size_t cbXfer, PPDMBLKCACHEIOXFER pIoXfer)
 {
     int rc = VINF_SUCCESS;
@@ -847,8 +1074,7 @@ static DECLCALLBACK(int) pdmR3BlkCacheSaveExec(PVM pVM, PSSMHANDLE pSSM)
             AssertMsg(pEntry->fFlags & PDMBLKCACHE_ENTRY_IS_DIRTY, ("Entry is not dirty\n"));
             AssertMsg(!(pEntry->fFlags & ~PDMBLKCACHE_ENTRY_IS_DIRTY), ("Invalid flags set\n"));
             AssertMsg(!pEntry->pWaitingHead && !pEntry->pWaitingTail, ("There are waiting requests\n"));
-            AssertMsg(   pEntry->pList == &pBlkCacheGlobal->LruRecentlyUsedIn
-                      || pEntry->pList == &pBlkCacheGlobal->LruFrequentlyUsed,
+            AssertMsg(!pdmBlkCacheEntryIsGhost(pBlkCache, pEntry),
                       ("Invalid list\n"));
             AssertMsg(pEntry->cbData == pEntry->Core.KeyLast - pEntry->Core.Key + 1,
                       ("Size and range do not match\n"));
@@ -960,8 +1186,10 @@ static DECLCALLBACK(int) pdmR3BlkCacheLoadExec(PVM pVM, PSSMHANDLE pSSM, uint32_
 
             /* Add to the dirty list. */
             pdmBlkCacheAddDirtyEntry(pBlkCache, pEntry);
-            pdmBlkCacheEntryAddToList(&pBlkCacheGlobal->LruRecentlyUsedIn, pEntry);
-            pdmBlkCacheAdd(pBlkCacheGlobal, cbEntry);
+            pdmBlkCacheEpLockEnter(pBlkCache);
+            pdmBlkCacheEntryAddToList(&pBlkCache->LruRecentlyUsedIn, pEntry);
+            pdmBlkCacheAdd(pBlkCache, cbEntry);
+            pdmBlkCacheEpLockLeave(pBlkCache);
             pdmBlkCacheEntryRelease(pEntry);
             cEntries--;
         }
@@ -1012,29 +1240,25 @@ int pdmR3BlkCacheInit(PVM pVM)
     pBlkCacheGlobal->cbCached  = 0;
     pBlkCacheGlobal->fCommitInProgress = false;
 
-    /* Initialize members */
-    pBlkCacheGlobal->LruRecentlyUsedIn.pHead    = NULL;
-    pBlkCacheGlobal->LruRecentlyUsedIn.pTail    = NULL;
-    pBlkCacheGlobal->LruRecentlyUsedIn.cbCached = 0;
-
-    pBlkCacheGlobal->LruRecentlyUsedOut.pHead    = NULL;
-    pBlkCacheGlobal->LruRecentlyUsedOut.pTail    = NULL;
-    pBlkCacheGlobal->LruRecentlyUsedOut.cbCached = 0;
-
-    pBlkCacheGlobal->LruFrequentlyUsed.pHead    = NULL;
-    pBlkCacheGlobal->LruFrequentlyUsed.pTail    = NULL;
-    pBlkCacheGlobal->LruFrequentlyUsed.cbCached = 0;
-
     do
     {
         rc = CFGMR3QueryU32Def(pCfgBlkCache, "CacheSize", &pBlkCacheGlobal->cbMax, 5 * _1M);
         AssertLogRelRCBreak(rc);
         LogFlowFunc(("Maximum number of bytes cached %u\n", pBlkCacheGlobal->cbMax));
 
-        pBlkCacheGlobal->cbRecentlyUsedInMax  = (pBlkCacheGlobal->cbMax / 100) * 25; /* 25% of the buffer size */
-        pBlkCacheGlobal->cbRecentlyUsedOutMax = (pBlkCacheGlobal->cbMax / 100) * 50; /* 50% of the buffer size */
-        LogFlowFunc(("cbRecentlyUsedInMax=%u cbRecentlyUsedOutMax=%u\n",
-                     pBlkCacheGlobal->cbRecentlyUsedInMax, pBlkCacheGlobal->cbRecentlyUsedOutMax));
+        /* Per endpoint budgets, a minimum of 0 means an equal share of the cache for every endpoint. */
+        rc = CFGMR3QueryU32Def(pCfgBlkCache, "EndpointMinSize", &pBlkCacheGlobal->cbEndpointMin, 0);
+        AssertLogRelRCBreak(rc);
+        rc = CFGMR3QueryU32Def(pCfgBlkCache, "EndpointMaxSize", &pBlkCacheGlobal->cbEndpointMax, pBlkCacheGlobal->cbMax);
+        AssertLogRelRCBreak(rc);
+        pBlkCacheGlobal->cbEndpointMax = RT_MIN(pBlkCacheGlobal->cbEndpointMax, pBlkCacheGlobal->cbMax);
+        pBlkCacheGlobal->cbEndpointMin = RT_MIN(pBlkCacheGlobal->cbEndpointMin, pBlkCacheGlobal->cbEndpointMax);
+
+        /* Sequential accesses beyond this amount bypass the cache. */
+        rc = CFGMR3QueryU32Def(pCfgBlkCache, "ScanThreshold", &pBlkCacheGlobal->cbScanThreshold, pBlkCacheGlobal->cbMax / 2);
+        AssertLogRelRCBreak(rc);
+        LogFlowFunc(("cbEndpointMin=%u cbEndpointMax=%u cbScanThreshold=%u\n",
+                     pBlkCacheGlobal->cbEndpointMin, pBlkCacheGlobal->cbEndpointMax, pBlkCacheGlobal->cbScanThreshold));
 
         /** @todo r=aeichner: Experiment to find optimal default values */
         rc = CFGMR3QueryU32Def(pCfgBlkCache, "CacheCommitIntervalMs", &pBlkCacheGlobal->u32CommitTimeoutMs, 10000 /* 10sec */);
@@ -1050,26 +1274,11 @@ int pdmR3BlkCacheInit(PVM pVM)
                        "/PDM/BlkCache/cbMax",
                        STAMUNIT_BYTES,
                        "Maximum cache size");
-        STAMR3Register(pVM, &pBlkCacheGlobal->cbCached,
+        STAMR3Register(pVM, (void *)&pBlkCacheGlobal->cbCached,
                        STAMTYPE_U32, STAMVISIBILITY_ALWAYS,
                        "/PDM/BlkCache/cbCached",
                        STAMUNIT_BYTES,
                        "Currently used cache");
-        STAMR3Register(pVM, &pBlkCacheGlobal->LruRecentlyUsedIn.cbCached,
-                       STAMTYPE_U32, STAMVISIBILITY_ALWAYS,
-                       "/PDM/BlkCache/cbCachedMruIn",
-                       STAMUNIT_BYTES,
-                       "Number of bytes cached in MRU list");
-        STAMR3Register(pVM, &pBlkCacheGlobal->LruRecentlyUsedOut.cbCached,
-                       STAMTYPE_U32, STAMVISIBILITY_ALWAYS,
-                       "/PDM/BlkCache/cbCachedMruOut",
-                       STAMUNIT_BYTES,
-                       "Number of bytes cached in FRU list");
-        STAMR3Register(pVM, &pBlkCacheGlobal->LruFrequentlyUsed.cbCached,
-                       STAMTYPE_U32, STAMVISIBILITY_ALWAYS,
-                       "/PDM/BlkCache/cbCachedFru",
-                       STAMUNIT_BYTES,
-                       "Number of bytes cached in FRU ghost list");
 
 #ifdef VBOX_WITH_STATISTICS
         STAMR3Register(pVM, &pBlkCacheGlobal->cHits,
@@ -1108,6 +1317,10 @@ int pdmR3BlkCacheInit(PVM pVM)
                        STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS,
                        "/PDM/BlkCache/CacheBuffersReused",
                        STAMUNIT_COUNT, "Number of times a buffer could be reused");
+        STAMR3Register(pVM, &pBlkCacheGlobal->StatBytesStolen,
+                       STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS,
+                       "/PDM/BlkCache/CacheBytesStolen",
+                       STAMUNIT_BYTES, "Number of bytes reclaimed from other endpoints");
 #endif
 
         /* Initialize the critical section */
@@ -1136,6 +1349,8 @@ int pdmR3BlkCacheInit(PVM pVM)
                 LogRel(("BlkCache: Cache successfully initialized. Cache size is %u bytes\n", pBlkCacheGlobal->cbMax));
                 LogRel(("BlkCache: Cache commit interval is %u ms\n", pBlkCacheGlobal->u32CommitTimeoutMs));
                 LogRel(("BlkCache: Cache commit threshold is %u bytes\n", pBlkCacheGlobal->cbCommitDirtyThreshold));
+                LogRel(("BlkCache: Endpoint budget is %u..%u bytes, scan threshold is %u bytes\n",
+                        pBlkCacheGlobal->cbEndpointMin, pBlkCacheGlobal->cbEndpointMax, pBlkCacheGlobal->cbScanThreshold));
                 pUVM->pdm.s.pBlkCacheGlobal = pBlkCacheGlobal;
                 return VINF_SUCCESS;
             }
@@ -1161,9 +1376,16 @@ void pdmR3BlkCacheTerm(PVM pVM)
         pdmBlkCacheLockEnter(pBlkCacheGlobal);
 
         /* Cleanup deleting all cache entries waiting for in progress entries to finish. */
-        pdmBlkCacheDestroyList(&pBlkCacheGlobal->LruRecentlyUsedIn);
-        pdmBlkCacheDestroyList(&pBlkCacheGlobal->LruRecentlyUsedOut);
-        pdmBlkCacheDestroyList(&pBlkCacheGlobal->LruFrequentlyUsed);
+        PPDMBLKCACHE pBlkCache;
+        RTListForEach(&pBlkCacheGlobal->ListUsers, pBlkCache, PDMBLKCACHE, NodeCacheUser)
+        {
+            pdmBlkCacheEpLockEnter(pBlkCache);
+            pdmBlkCacheDestroyList(&pBlkCache->LruRecentlyUsedIn);
+            pdmBlkCacheDestroyList(&pBlkCache->LruRecentlyUsedOut);
+            pdmBlkCacheDestroyList(&pBlkCache->LruFrequentlyUsed);
+            pdmBlkCacheDestroyList(&pBlkCache->LruFrequentlyUsedOut);
+            RTCritSectLeave(&pBlkCache->CritSect);
+        }
 
         pdmBlkCacheLockLeave(pBlkCacheGlobal);
 
@@ -1224,21 +1446,100 @@ static int pdmR3BlkCacheRetain(PVM pVM, PPPDMBLKCACHE ppBlkCache, const char *pc
             if (RT_SUCCESS(rc))
             {
                 rc = RTSemRWCreate(&pBlkCache->SemRWEntries);
+                if (RT_SUCCESS(rc))
+                    rc = RTCritSectInit(&pBlkCache->CritSect);
                 if (RT_SUCCESS(rc))
                 {
                     pBlkCache->pTree  = (PAVLRU64TREE)RTMemAllocZ(sizeof(AVLRFOFFTREE));
                     if (pBlkCache->pTree)
                     {
+                        /*
+                         * Query the budget of this endpoint, the global defaults
+                         * can be overridden in PDM/BlkCache/Endpoints/<Id>.
+                         */
+                        PCFGMNODE pCfgEp = CFGMR3GetChildF(CFGMR3GetRoot(pVM), "PDM/BlkCache/Endpoints/%s", pcszId);
+                        pBlkCache->fMinFixed = pBlkCacheGlobal->cbEndpointMin != 0;
+                        pBlkCache->cbMin     = pBlkCacheGlobal->cbEndpointMin;
+                        pBlkCache->cbMax     = pBlkCacheGlobal->cbEndpointMax;
+                        if (pCfgEp)
+                        {
+                            uint32_t cbMin = 0;
+                            int rc2 = CFGMR3QueryU32(pCfgEp, "MinSize", &cbMin);
+                            if (RT_SUCCESS(rc2))
+                            {
+                                pBlkCache->fMinFixed = true;
+                                pBlkCache->cbMin     = cbMin;
+                            }
+                            CFGMR3QueryU32(pCfgEp, "MaxSize", &pBlkCache->cbMax);
+                        }
+                        pBlkCache->cbMax = RT_MIN(pBlkCache->cbMax, pBlkCacheGlobal->cbMax);
+                        pBlkCache->cbMin = RT_MIN(pBlkCache->cbMin, pBlkCache->cbMax);
+                        pBlkCache->cbRecentlyUsedInTarget = 0;
+                        pBlkCache->offSeqNext             = UINT64_MAX;
+
+                        STAMR3RegisterF(pVM, (void *)&pBlkCache->cbCached,
+                                        STAMTYPE_U32, STAMVISIBILITY_ALWAYS,
+                                        STAMUNIT_BYTES, "Currently used cache",
+                                        "/PDM/BlkCache/%s/Cache/cbCached", pBlkCache->pszId);
+                        STAMR3RegisterF(pVM, (void *)&pBlkCache->cbMin,
+                                        STAMTYPE_U32, STAMVISIBILITY_ALWAYS,
+                                        STAMUNIT_BYTES, "Guaranteed minimum cache size",
+                                        "/PDM/BlkCache/%s/Cache/cbMin", pBlkCache->pszId);
+                        STAMR3RegisterF(pVM, &pBlkCache->cbRecentlyUsedInTarget,
+                                        STAMTYPE_U32, STAMVISIBILITY_ALWAYS,
+                                        STAMUNIT_BYTES, "Adaptive target size of the MRU list",
+                                        "/PDM/BlkCache/%s/Cache/cbTargetMruIn", pBlkCache->pszId);
+                        STAMR3RegisterF(pVM, &pBlkCache->LruRecentlyUsedIn.cbCached,
+                                        STAMTYPE_U32, STAMVISIBILITY_ALWAYS,
+                                        STAMUNIT_BYTES, "Number of bytes cached in MRU list",
+                                        "/PDM/BlkCache/%s/Cache/cbCachedMruIn", pBlkCache->pszId);
+                        STAMR3RegisterF(pVM, &pBlkCache->LruRecentlyUsedOut.cbCached,
+                                        STAMTYPE_U32, STAMVISIBILITY_ALWAYS,
+                                        STAMUNIT_BYTES, "Number of bytes cached in MRU ghost list",
+                                        "/PDM/BlkCache/%s/Cache/cbCachedMruOut", pBlkCache->pszId);
+                        STAMR3RegisterF(pVM, &pBlkCache->LruFrequentlyUsed.cbCached,
+                                        STAMTYPE_U32, STAMVISIBILITY_ALWAYS,
+                                        STAMUNIT_BYTES, "Number of bytes cached in FRU list",
+                                        "/PDM/BlkCache/%s/Cache/cbCachedFru", pBlkCache->pszId);
+                        STAMR3RegisterF(pVM, &pBlkCache->LruFrequentlyUsedOut.cbCached,
+                                        STAMTYPE_U32, STAMVISIBILITY_ALWAYS,
+                                        STAMUNIT_BYTES, "Number of bytes cached in FRU ghost list",
+                                        "/PDM/BlkCache/%s/Cache/cbCachedFruOut", pBlkCache->pszId);
 #ifdef VBOX_WITH_STATISTICS
-                        STAMR3RegisterF(pBlkCacheGlobal->pVM, &pBlkCache->StatWriteDeferred,
+                        STAMR3RegisterF(pVM, &pBlkCache->StatWriteDeferred,
                                         STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS,
                                         STAMUNIT_COUNT, "Number of deferred writes",
                                         "/PDM/BlkCache/%s/Cache/DeferredWrites", pBlkCache->pszId);
+                        STAMR3RegisterF(pVM, &pBlkCache->StatHits,
+                                        STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS,
+                                        STAMUNIT_COUNT, "Number of hits in the cache",
+                                        "/PDM/BlkCache/%s/Cache/Hits", pBlkCache->pszId);
+                        STAMR3RegisterF(pVM, &pBlkCache->StatPartialHits,
+                                        STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS,
+                                        STAMUNIT_COUNT, "Number of partial hits in the cache",
+                                        "/PDM/BlkCache/%s/Cache/PartialHits", pBlkCache->pszId);
+                        STAMR3RegisterF(pVM, &pBlkCache->StatMisses,
+                                        STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS,
+                                        STAMUNIT_COUNT, "Number of misses when accessing the cache",
+                                        "/PDM/BlkCache/%s/Cache/Misses", pBlkCache->pszId);
+                        STAMR3RegisterF(pVM, &pBlkCache->StatEvicted,
+                                        STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS,
+                                        STAMUNIT_BYTES, "Number of bytes evicted from the cache",
+                                        "/PDM/BlkCache/%s/Cache/Evicted", pBlkCache->pszId);
+                        STAMR3RegisterF(pVM, &pBlkCache->StatGhostHits,
+                                        STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS,
+                                        STAMUNIT_COUNT, "Number of hits in the ghost lists",
+                                        "/PDM/BlkCache/%s/Cache/GhostHits", pBlkCache->pszId);
+                        STAMR3RegisterF(pVM, &pBlkCache->StatScanBypassed,
+                                        STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS,
+                                        STAMUNIT_BYTES, "Number of bytes passed through because of a sequential scan",
+                                        "/PDM/BlkCache/%s/Cache/ScanBypassed", pBlkCache->pszId);
 #endif
 
                         /* Add to the list of users. */
                         pBlkCacheGlobal->cRefs++;
                         RTListAppend(&pBlkCacheGlobal->ListUsers, &pBlkCache->NodeCacheUser);
+                        pdmBlkCacheUpdateFairShare(pBlkCacheGlobal);
                         pdmBlkCacheLockLeave(pBlkCacheGlobal);
 
                         *ppBlkCache = pBlkCache;
@@ -1247,8 +1548,10 @@ static int pdmR3BlkCacheRetain(PVM pVM, PPPDMBLKCACHE ppBlkCache, const char *pc
                     }
 
                     rc = VERR_NO_MEMORY;
-                    RTSemRWDestroy(pBlkCache->SemRWEntries);
+                    RTCritSectDelete(&pBlkCache->CritSect);
                 }
+                if (pBlkCache->SemRWEntries != NIL_RTSEMRW)
+                    RTSemRWDestroy(pBlkCache->SemRWEntries);
 
                 RTSpinlockDestroy(pBlkCache->LockList);
             }
@@ -1379,20 +1682,20 @@ VMMR3DECL(int) PDMR3BlkCacheRetainInt(PVM pVM, void *pvUser, PPPDMBLKCACHE ppBlk
 static DECLCALLBACK(int) pdmBlkCacheEntryDestroy(PAVLRU64NODECORE pNode, void *pvUser)
 {
     PPDMBLKCACHEENTRY  pEntry = (PPDMBLKCACHEENTRY)pNode;
-    PPDMBLKCACHEGLOBAL pCache = (PPDMBLKCACHEGLOBAL)pvUser;
     PPDMBLKCACHE pBlkCache = pEntry->pBlkCache;
+    NOREF(pvUser);
 
     while (ASMAtomicReadU32(&pEntry->fFlags) & PDMBLKCACHE_ENTRY_IO_IN_PROGRESS)
     {
         /* Leave the locks to let the I/O thread make progress but reference the entry to prevent eviction. */
         pdmBlkCacheEntryRef(pEntry);
         RTSemRWReleaseWrite(pBlkCache->SemRWEntries);
-        pdmBlkCacheLockLeave(pCache);
+        pdmBlkCacheEpLockLeave(pBlkCache);
 
         RTThreadSleep(250);
 
         /* Re-enter all locks */
-        pdmBlkCacheLockEnter(pCache);
+        pdmBlkCacheEpLockEnter(pBlkCache);
         RTSemRWRequestWrite(pBlkCache->SemRWEntries, RT_INDEFINITE_WAIT);
         pdmBlkCacheEntryRelease(pEntry);
     }
@@ -1400,13 +1703,12 @@ static DECLCALLBACK(int) pdmBlkCacheEntryDestroy(PAVLRU64NODECORE pNode, void *p
     AssertMsg(!(pEntry->fFlags & PDMBLKCACHE_ENTRY_IO_IN_PROGRESS),
                 ("Entry is dirty and/or still in progress fFlags=%#x\n", pEntry->fFlags));
 
-    bool fUpdateCache =    pEntry->pList == &pCache->LruFrequentlyUsed
-                        || pEntry->pList == &pCache->LruRecentlyUsedIn;
+    bool fUpdateCache = !pdmBlkCacheEntryIsGhost(pBlkCache, pEntry);
 
     pdmBlkCacheEntryRemoveFromList(pEntry);
 
     if (fUpdateCache)
-        pdmBlkCacheSub(pCache, pEntry->cbData);
+        pdmBlkCacheSub(pBlkCache, pEntry->cbData);
 
     RTMemPageFree(pEntry->pbData, pEntry->cbData);
     RTMemFree(pEntry);
@@ -1434,22 +1736,24 @@ VMMR3DECL(void) PDMR3BlkCacheRelease(PPDMBLKCACHE pBlkCache)
 
     /* Make sure nobody is accessing the cache while we delete the tree. */
     pdmBlkCacheLockEnter(pCache);
+    pdmBlkCacheEpLockEnter(pBlkCache);
     RTSemRWRequestWrite(pBlkCache->SemRWEntries, RT_INDEFINITE_WAIT);
-    RTAvlrU64Destroy(pBlkCache->pTree, pdmBlkCacheEntryDestroy, pCache);
+    RTAvlrU64Destroy(pBlkCache->pTree, pdmBlkCacheEntryDestroy, NULL);
     RTSemRWReleaseWrite(pBlkCache->SemRWEntries);
+    pdmBlkCacheEpLockLeave(pBlkCache);
 
     RTSpinlockDestroy(pBlkCache->LockList);
 
     pCache->cRefs--;
     RTListNodeRemove(&pBlkCache->NodeCacheUser);
+    pdmBlkCacheUpdateFairShare(pCache);
 
     pdmBlkCacheLockLeave(pCache);
 
+    RTCritSectDelete(&pBlkCache->CritSect);
     RTSemRWDestroy(pBlkCache->SemRWEntries);
 
-#ifdef VBOX_WITH_STATISTICS
-    STAMR3DeregisterF(pCache->pVM->pUVM, "/PDM/BlkCache/%s/Cache/DeferredWrites", pBlkCache->pszId);
-#endif
+    STAMR3DeregisterF(pCache->pVM->pUVM, "/PDM/BlkCache/%s/Cache/*", pBlkCache->pszId);
 
     RTStrFree(pBlkCache->pszId);
     RTMemFree(pBlkCache);
@@ -1815,12 +2119,11 @@ static PPDMBLKCACHEENTRY pdmBlkCacheEntryCreate(PPDMBLKCACHE pBlkCache, uint64_t
     *pcbData = pdmBlkCacheEntryBoundariesCalc(pBlkCache, off, (uint32_t)cb, &cbEntry);
     AssertReturn(cb <= UINT32_MAX, NULL);
 
-    PPDMBLKCACHEGLOBAL pCache = pBlkCache->pCache;
-    pdmBlkCacheLockEnter(pCache);
+    pdmBlkCacheEpLockEnter(pBlkCache);
 
     PPDMBLKCACHEENTRY pEntryNew = NULL;
     uint8_t          *pbBuffer  = NULL;
-    bool fEnough = pdmBlkCacheReclaim(pCache, cbEntry, true, &pbBuffer);
+    bool fEnough = pdmBlkCacheReclaim(pBlkCache, cbEntry, false /*fGhostHitFreq*/, true, &pbBuffer);
     if (fEnough)
     {
         LogFlow(("Evicted enough bytes (%u requested). Creating new cache entry\n", cbEntry));
@@ -1828,9 +2131,9 @@ static PPDMBLKCACHEENTRY pdmBlkCacheEntryCreate(PPDMBLKCACHE pBlkCache, uint64_t
         pEntryNew = pdmBlkCacheEntryAlloc(pBlkCache, off, cbEntry, pbBuffer);
         if (RT_LIKELY(pEntryNew))
         {
-            pdmBlkCacheEntryAddToList(&pCache->LruRecentlyUsedIn, pEntryNew);
-            pdmBlkCacheAdd(pCache, cbEntry);
-            pdmBlkCacheLockLeave(pCache);
+            pdmBlkCacheEntryAddToList(&pBlkCache->LruRecentlyUsedIn, pEntryNew);
+            pdmBlkCacheAdd(pBlkCache, cbEntry);
+            pdmBlkCacheEpLockLeave(pBlkCache);
 
             pdmBlkCacheInsertEntry(pBlkCache, pEntryNew);
 
@@ -1839,10 +2142,14 @@ static PPDMBLKCACHEENTRY pdmBlkCacheEntryCreate(PPDMBLKCACHE pBlkCache, uint64_t
                       ("Overflow in calculation off=%llu\n", off));
         }
         else
-            pdmBlkCacheLockLeave(pCache);
+        {
+            if (pbBuffer)
+                RTMemPageFree(pbBuffer, cbEntry);
+            pdmBlkCacheEpLockLeave(pBlkCache);
+        }
     }
     else
-        pdmBlkCacheLockLeave(pCache);
+        pdmBlkCacheEpLockLeave(pBlkCache);
 
     return pEntryNew;
 }
@@ -1929,6 +2236,7 @@ VMMR3DECL(int) PDMR3BlkCacheRead(PPDMBLKCACHE pBlkCache, uint64_t off,
 
     AssertPtrReturn(pBlkCache, VERR_INVALID_POINTER);
     AssertReturn(!pBlkCache->fSuspended, VERR_INVALID_STATE);
+    NOREF(pCache);
 
     RTSGBUF SgBuf;
     RTSgBufClone(&SgBuf, pSgBuf);
@@ -1941,6 +2249,11 @@ VMMR3DECL(int) PDMR3BlkCacheRead(PPDMBLKCACHE pBlkCache, uint64_t off,
     /* Increment data transfer counter to keep the request valid while we access it. */
     ASMAtomicIncU32(&pReq->cXfersPending);
 
+#ifdef VBOX_WITH_IO_READ_CACHE
+    /* Sequential streams are not cached to keep them from flushing the working set. */
+    bool fScan = pdmBlkCacheScanDetect(pBlkCache, off, cbRead);
+#endif
+
     while (cbRead)
     {
         size_t cbToRead;
@@ -1977,15 +2290,20 @@ VMMR3DECL(int) PDMR3BlkCacheRead(PPDMBLKCACHE pBlkCache, uint64_t off,
             cbRead  -= cbToRead;
 
             if (!cbRead)
+            {
                 STAM_COUNTER_INC(&pCache->cHits);
+                STAM_COUNTER_INC(&pBlkCache->StatHits);
+            }
             else
+            {
                 STAM_COUNTER_INC(&pCache->cPartialHits);
+                STAM_COUNTER_INC(&pBlkCache->StatPartialHits);
+            }
 
             STAM_COUNTER_ADD(&pCache->StatRead, cbToRead);
 
             /* Ghost lists contain no data. */
-            if (   (pEntry->pList == &pCache->LruRecentlyUsedIn)
-                || (pEntry->pList == &pCache->LruFrequentlyUsed))
+            if (!pdmBlkCacheEntryIsGhost(pBlkCache, pEntry))
             {
                 if (pdmBlkCacheEntryFlagIsSetClearAcquireLock(pBlkCache, pEntry,
                                                               PDMBLKCACHE_ENTRY_IO_IN_PROGRESS,
@@ -2003,13 +2321,10 @@ VMMR3DECL(int) PDMR3BlkCacheRead(PPDMBLKCACHE pBlkCache, uint64_t off,
                     RTSgBufCopyFromBuf(&SgBuf, pEntry->pbData + offDiff, cbToRead);
                 }
 
-                /* Move this entry to the top position */
-                if (pEntry->pList == &pCache->LruFrequentlyUsed)
-                {
-                    pdmBlkCacheLockEnter(pCache);
-                    pdmBlkCacheEntryAddToList(&pCache->LruFrequentlyUsed, pEntry);
-                    pdmBlkCacheLockLeave(pCache);
-                }
+                /* Move this entry to the top position, a hit in T1 makes it frequently used. */
+                pdmBlkCacheEpLockEnter(pBlkCache);
+                pdmBlkCacheEntryAddToList(&pBlkCache->LruFrequentlyUsed, pEntry);
+                pdmBlkCacheEpLockLeave(pBlkCache);
                 /* Release the entry */
                 pdmBlkCacheEntryRelease(pEntry);
             }
@@ -2019,16 +2334,18 @@ VMMR3DECL(int) PDMR3BlkCacheRead(PPDMBLKCACHE pBlkCache, uint64_t off,
 
                 LogFlow(("Fetching data for ghost entry %#p from file\n", pEntry));
 
-                pdmBlkCacheLockEnter(pCache);
+                pdmBlkCacheEpLockEnter(pBlkCache);
+                bool fGhostHitFreq = pEntry->pList == &pBlkCache->LruFrequentlyUsedOut;
+                pdmBlkCacheGhostHit(pBlkCache, pEntry);
                 pdmBlkCacheEntryRemoveFromList(pEntry); /* Remove it before we remove data, otherwise it may get freed when evicting data. */
-                bool fEnough = pdmBlkCacheReclaim(pCache, pEntry->cbData, true, &pbBuffer);
+                bool fEnough = pdmBlkCacheReclaim(pBlkCache, pEntry->cbData, fGhostHitFreq, true, &pbBuffer);
 
                 /* Move the entry to Am and fetch it to the cache. */
                 if (fEnough)
                 {
-                    pdmBlkCacheEntryAddToList(&pCache->LruFrequentlyUsed, pEntry);
-                    pdmBlkCacheAdd(pCache, pEntry->cbData);
-                    pdmBlkCacheLockLeave(pCache);
+                    pdmBlkCacheEntryAddToList(&pBlkCache->LruFrequentlyUsed, pEntry);
+                    pdmBlkCacheAdd(pBlkCache, pEntry->cbData);
+                    pdmBlkCacheEpLockLeave(pBlkCache);
 
                     if (pbBuffer)
                         pEntry->pbData = pbBuffer;
@@ -2051,7 +2368,7 @@ VMMR3DECL(int) PDMR3BlkCacheRead(PPDMBLKCACHE pBlkCache, uint64_t off,
                     STAM_PROFILE_ADV_STOP(&pCache->StatTreeRemove, Cache);
                     RTSemRWReleaseWrite(pBlkCache->SemRWEntries);
 
-                    pdmBlkCacheLockLeave(pCache);
+                    pdmBlkCacheEpLockLeave(pBlkCache);
 
                     RTMemFree(pEntry);
 
@@ -2065,11 +2382,22 @@ VMMR3DECL(int) PDMR3BlkCacheRead(PPDMBLKCACHE pBlkCache, uint64_t off,
         {
 #ifdef VBOX_WITH_IO_READ_CACHE
             /* No entry found for this offset. Create a new entry and fetch the data to the cache. */
-            PPDMBLKCACHEENTRY pEntryNew = pdmBlkCacheEntryCreate(pBlkCache,
-                                                                 off, cbRead,
-                                                                 &cbToRead);
+            PPDMBLKCACHEENTRY pEntryNew = NULL;
 
-            cbRead -= cbToRead;
+            STAM_COUNTER_INC(&pBlkCache->StatMisses);
+            if (!fScan)
+            {
+                pEntryNew = pdmBlkCacheEntryCreate(pBlkCache, off, cbRead, &cbToRead);
+                cbRead -= cbToRead;
+            }
+            else
+            {
+                /* Scanning, just pass the read through up to the next cached entry. */
+                uint32_t cbEntry;
+                cbToRead = pdmBlkCacheEntryBoundariesCalc(pBlkCache, off, (uint32_t)RT_MIN(cbRead, UINT32_MAX), &cbEntry);
+                cbRead  -= cbToRead;
+                STAM_COUNTER_ADD(&pBlkCache->StatScanBypassed, cbToRead);
+            }
 
             if (pEntryNew)
             {
@@ -2161,6 +2489,9 @@ VMMR3DECL(int) PDMR3BlkCacheWrite(PPDMBLKCACHE pBlkCache, uint64_t off, PCRTSGBU
     /* Increment data transfer counter to keep the request valid while we access it. */
     ASMAtomicIncU32(&pReq->cXfersPending);
 
+    /* Sequential streams are not cached to keep them from flushing the working set. */
+    bool fScan = pdmBlkCacheScanDetect(pBlkCache, off, cbWrite);
+
     while (cbWrite)
     {
         size_t cbToWrite;
@@ -2178,15 +2509,20 @@ VMMR3DECL(int) PDMR3BlkCacheWrite(PPDMBLKCACHE pBlkCache, uint64_t off, PCRTSGBU
             cbWrite  -= cbToWrite;
 
             if (!cbWrite)
+            {
                 STAM_COUNTER_INC(&pCache->cHits);
+                STAM_COUNTER_INC(&pBlkCache->StatHits);
+            }
             else
+            {
                 STAM_COUNTER_INC(&pCache->cPartialHits);
+                STAM_COUNTER_INC(&pBlkCache->StatPartialHits);
+            }
 
             STAM_COUNTER_ADD(&pCache->StatWritten, cbToWrite);
 
             /* Ghost lists contain no data. */
-            if (   (pEntry->pList == &pCache->LruRecentlyUsedIn)
-                || (pEntry->pList == &pCache->LruFrequentlyUsed))
+            if (!pdmBlkCacheEntryIsGhost(pBlkCache, pEntry))
             {
                 /* Check if the entry is dirty. */
                 if (pdmBlkCacheEntryFlagIsSetClearAcquireLock(pBlkCache, pEntry,
@@ -2234,13 +2570,10 @@ VMMR3DECL(int) PDMR3BlkCacheWrite(PPDMBLKCACHE pBlkCache, uint64_t off, PCRTSGBU
                     }
                 } /* Dirty bit not set */
 
-                /* Move this entry to the top position */
-                if (pEntry->pList == &pCache->LruFrequentlyUsed)
-                {
-                    pdmBlkCacheLockEnter(pCache);
-                    pdmBlkCacheEntryAddToList(&pCache->LruFrequentlyUsed, pEntry);
-                    pdmBlkCacheLockLeave(pCache);
-                }
+                /* Move this entry to the top position, a hit in T1 makes it frequently used. */
+                pdmBlkCacheEpLockEnter(pBlkCache);
+                pdmBlkCacheEntryAddToList(&pBlkCache->LruFrequentlyUsed, pEntry);
+                pdmBlkCacheEpLockLeave(pBlkCache);
 
                 pdmBlkCacheEntryRelease(pEntry);
             }
@@ -2248,16 +2581,18 @@ VMMR3DECL(int) PDMR3BlkCacheWrite(PPDMBLKCACHE pBlkCache, uint64_t off, PCRTSGBU
             {
                 uint8_t *pbBuffer = NULL;
 
-                pdmBlkCacheLockEnter(pCache);
+                pdmBlkCacheEpLockEnter(pBlkCache);
+                bool fGhostHitFreq = pEntry->pList == &pBlkCache->LruFrequentlyUsedOut;
+                pdmBlkCacheGhostHit(pBlkCache, pEntry);
                 pdmBlkCacheEntryRemoveFromList(pEntry); /* Remove it before we remove data, otherwise it may get freed when evicting data. */
-                bool fEnough = pdmBlkCacheReclaim(pCache, pEntry->cbData, true, &pbBuffer);
+                bool fEnough = pdmBlkCacheReclaim(pBlkCache, pEntry->cbData, fGhostHitFreq, true, &pbBuffer);
 
                 if (fEnough)
                 {
                     /* Move the entry to Am and fetch it to the cache. */
-                    pdmBlkCacheEntryAddToList(&pCache->LruFrequentlyUsed, pEntry);
-                    pdmBlkCacheAdd(pCache, pEntry->cbData);
-                    pdmBlkCacheLockLeave(pCache);
+                    pdmBlkCacheEntryAddToList(&pBlkCache->LruFrequentlyUsed, pEntry);
+                    pdmBlkCacheAdd(pBlkCache, pEntry->cbData);
+                    pdmBlkCacheEpLockLeave(pBlkCache);
 
                     if (pbBuffer)
                         pEntry->pbData = pbBuffer;
@@ -2282,7 +2617,7 @@ VMMR3DECL(int) PDMR3BlkCacheWrite(PPDMBLKCACHE pBlkCache, uint64_t off, PCRTSGBU
                     STAM_PROFILE_ADV_STOP(&pCache->StatTreeRemove, Cache);
                     RTSemRWReleaseWrite(pBlkCache->SemRWEntries);
 
-                    pdmBlkCacheLockLeave(pCache);
+                    pdmBlkCacheEpLockLeave(pBlkCache);
 
                     RTMemFree(pEntry);
                     pdmBlkCacheRequestPassthrough(pBlkCache, pReq,
@@ -2291,6 +2626,21 @@ VMMR3DECL(int) PDMR3BlkCacheWrite(PPDMBLKCACHE pBlkCache, uint64_t off, PCRTSGBU
                 }
             }
         }
+        else if (fScan) /* No entry found and the endpoint is scanning */
+        {
+            /* Pass the write through up to the next cached entry. */
+            uint32_t cbEntry;
+            cbToWrite = pdmBlkCacheEntryBoundariesCalc(pBlkCache, off, (uint32_t)RT_MIN(cbWrite, UINT32_MAX), &cbEntry);
+            cbWrite  -= cbToWrite;
+
+            STAM_COUNTER_INC(&pCache->cMisses);
+            STAM_COUNTER_INC(&pBlkCache->StatMisses);
+            STAM_COUNTER_ADD(&pBlkCache->StatScanBypassed, cbToWrite);
+
+            pdmBlkCacheRequestPassthrough(pBlkCache, pReq,
+                                          &SgBuf, off, cbToWrite,
+                                          PDMBLKCACHEXFERDIR_WRITE);
+        }
         else /* No entry found */
         {
             /*
@@ -2302,6 +2652,7 @@ VMMR3DECL(int) PDMR3BlkCacheWrite(PPDMBLKCACHE pBlkCache, uint64_t off, PCRTSGBU
                                                                  &cbToWrite);
 
             cbWrite -= cbToWrite;
+            STAM_COUNTER_INC(&pBlkCache->StatMisses);
 
             if (pEntryNew)
             {
@@ -2405,6 +2756,7 @@ VMMR3DECL(int) PDMR3BlkCacheDiscard(PPDMBLKCACHE pBlkCache, PCRTRANGE paRanges,
 
     AssertPtrReturn(pBlkCache, VERR_INVALID_POINTER);
     AssertReturn(!pBlkCache->fSuspended, VERR_INVALID_STATE);
+    NOREF(pCache);
 
     /* Allocate new request structure. */
     pReq = pdmBlkCacheReqAlloc(pvUser);
@@ -2439,8 +2791,7 @@ VMMR3DECL(int) PDMR3BlkCacheDiscard(PPDMBLKCACHE pBlkCache, PCRTRANGE paRanges,
                 cbThisDiscard = RT_MIN(pEntry->cbData - offDiff, cbLeft);
 
                 /* Ghost lists contain no data. */
-                if (   (pEntry->pList == &pCache->LruRecentlyUsedIn)
-                    || (pEntry->pList == &pCache->LruFrequentlyUsed))
+                if (!pdmBlkCacheEntryIsGhost(pBlkCache, pEntry))
                 {
                     /* Check if the entry is dirty. */
                     if (pdmBlkCacheEntryFlagIsSetClearAcquireLock(pBlkCache, pEntry,
@@ -2450,14 +2801,15 @@ VMMR3DECL(int) PDMR3BlkCacheDiscard(PPDMBLKCACHE pBlkCache, PCRTRANGE paRanges,
                         /* If it is dirty but not yet in progress remove it. */
                         if (!(pEntry->fFlags & PDMBLKCACHE_ENTRY_IO_IN_PROGRESS))
                         {
-                            pdmBlkCacheLockEnter(pCache);
+                            pdmBlkCacheEpLockEnter(pBlkCache);
                             pdmBlkCacheEntryRemoveFromList(pEntry);
+                            pdmBlkCacheSub(pBlkCache, pEntry->cbData);
 
                             STAM_PROFILE_ADV_START(&pCache->StatTreeRemove, Cache);
                             RTAvlrU64Remove(pBlkCache->pTree, pEntry->Core.Key);
                             STAM_PROFILE_ADV_STOP(&pCache->StatTreeRemove, Cache);
 
-                            pdmBlkCacheLockLeave(pCache);
+                            pdmBlkCacheEpLockLeave(pBlkCache);
 
                             RTMemFree(pEntry);
                         }
@@ -2496,8 +2848,9 @@ VMMR3DECL(int) PDMR3BlkCacheDiscard(PPDMBLKCACHE pBlkCache, PCRTRANGE paRanges,
                         }
                         else /* I/O in progress flag not set */
                         {
-                            pdmBlkCacheLockEnter(pCache);
+                            pdmBlkCacheEpLockEnter(pBlkCache);
                             pdmBlkCacheEntryRemoveFromList(pEntry);
+                            pdmBlkCacheSub(pBlkCache, pEntry->cbData);
 
                             RTSemRWRequestWrite(pBlkCache->SemRWEntries, RT_INDEFINITE_WAIT);
                             STAM_PROFILE_ADV_START(&pCache->StatTreeRemove, Cache);
@@ -2505,7 +2858,7 @@ VMMR3DECL(int) PDMR3BlkCacheDiscard(PPDMBLKCACHE pBlkCache, PCRTRANGE paRanges,
                             STAM_PROFILE_ADV_STOP(&pCache->StatTreeRemove, Cache);
                             RTSemRWReleaseWrite(pBlkCache->SemRWEntries);
 
-                            pdmBlkCacheLockLeave(pCache);
+                            pdmBlkCacheEpLockLeave(pBlkCache);
 
                             RTMemFree(pEntry);
                         }
@@ -2513,7 +2866,7 @@ VMMR3DECL(int) PDMR3BlkCacheDiscard(PPDMBLKCACHE pBlkCache, PCRTRANGE paRanges,
                 }
                 else /* Entry is on the ghost list just remove cache entry. */
                 {
-                    pdmBlkCacheLockEnter(pCache);
+                    pdmBlkCacheEpLockEnter(pBlkCache);
                     pdmBlkCacheEntryRemoveFromList(pEntry);
 
                     RTSemRWRequestWrite(pBlkCache->SemRWEntries, RT_INDEFINITE_WAIT);
@@ -2522,7 +2875,7 @@ VMMR3DECL(int) PDMR3BlkCacheDiscard(PPDMBLKCACHE pBlkCache, PCRTRANGE paRanges,
                     STAM_PROFILE_ADV_STOP(&pCache->StatTreeRemove, Cache);
                     RTSemRWReleaseWrite(pBlkCache->SemRWEntries);
 
-                    pdmBlkCacheLockLeave(pCache);
+                    pdmBlkCacheEpLockLeave(pBlkCache);
 
                     RTMemFree(pEntry);
                 }
@@ -2753,12 +3106,12 @@ VMMR3DECL(int) PDMR3BlkCacheClear(PPDMBLKCACHE pBlkCache)
         pdmBlkCacheCommit(pBlkCache);
 
     /* Make sure nobody is accessing the cache while we delete the tree. */
-    pdmBlkCacheLockEnter(pCache);
+    pdmBlkCacheEpLockEnter(pBlkCache);
     RTSemRWRequestWrite(pBlkCache->SemRWEntries, RT_INDEFINITE_WAIT);
-    RTAvlrU64Destroy(pBlkCache->pTree, pdmBlkCacheEntryDestroy, pCache);
+    RTAvlrU64Destroy(pBlkCache->pTree, pdmBlkCacheEntryDestroy, NULL);
     RTSemRWReleaseWrite(pBlkCache->SemRWEntries);
 
-    pdmBlkCacheLockLeave(pCache);
+    pdmBlkCacheEpLockLeave(pBlkCache);
     return rc;
 }
 
@@ -23,6 +23,8 @@
 #include "PDMInternal.h"
 #include <VBox/vmm/pdmcritsect.h>
 #include <VBox/vmm/pdmcritsectrw.h>
+#include <VBox/vmm/cfgm.h>
+#include <VBox/vmm/dbgf.h>
 #include <VBox/vmm/mm.h>
 #include <VBox/vmm/vm.h>
 #include <VBox/vmm/uvm.h>
@@ -42,6 +44,8 @@
 *********************************************************************************************************************************/
 static int pdmR3CritSectDeleteOne(PVM pVM, PUVM pUVM, PPDMCRITSECTINT pCritSect, PPDMCRITSECTINT pPrev, bool fFinal);
 static int pdmR3CritSectRwDeleteOne(PVM pVM, PUVM pUVM, PPDMCRITSECTRWINT pCritSect, PPDMCRITSECTRWINT pPrev, bool fFinal);
+static uint32_t pdmR3CritSectProfAssign(PVM pVM, const char *pszName, bool fRw);
+static FNDBGFHANDLERINT pdmR3CritSectProfInfo;
 
 
 
@@ -55,10 +59,246 @@ int pdmR3CritSectBothInitStats(PVM pVM)
 {
     STAM_REG(pVM, &pVM->pdm.s.StatQueuedCritSectLeaves, STAMTYPE_COUNTER, "/PDM/QueuedCritSectLeaves", STAMUNIT_OCCURENCES,
              "Number of times a critical section leave request needed to be queued for ring-3 execution.");
+
+    /*
+     * The contention profiler.
+     */
+    /** @cfgm{/PDM/CritSectProfiling/Enabled, bool, false}
+     * Enables the critical section contention profiler.  This records wait and
+     * hold time histograms and the top contending call sites for each profiled
+     * section, see the 'critsectprof' info handler and /PDM/CritSects*\/x/Prof/. */
+    PCFGMNODE pCfg = CFGMR3GetChild(CFGMR3GetChild(CFGMR3GetRoot(pVM), "PDM"), "CritSectProfiling");
+    bool fEnabled;
+    int rc = CFGMR3QueryBoolDef(pCfg, "Enabled", &fEnabled, false);
+    AssertLogRelRCReturn(rc, rc);
+    if (!fEnabled)
+        return VINF_SUCCESS;
+
+    /** @cfgm{/PDM/CritSectProfiling/MaxSections, uint32_t, 64, 1, 65535}
+     * The max number of sections to profile.  Sections beyond this are ignored. */
+    uint32_t cMax;
+    rc = CFGMR3QueryU32Def(pCfg, "MaxSections", &cMax, 64);
+    AssertLogRelRCReturn(rc, rc);
+    if (cMax < 1 || cMax > UINT16_MAX)
+        return VMSetError(pVM, VERR_OUT_OF_RANGE, RT_SRC_POS,
+                          N_("Configuration error: /PDM/CritSectProfiling/MaxSections=%u is out of range (1..65535)"), cMax);
+
+    /** @cfgm{/PDM/CritSectProfiling/Filter, string, all}
+     * Pattern(s) selecting which sections to profile by name, multiple patterns
+     * are separated by '|'.  For instance "IOM*|PGM|TM*". */
+    rc = CFGMR3QueryStringAllocDef(pCfg, "Filter", &pVM->pdm.s.pszCritSectProfFilter, NULL);
+    AssertLogRelRCReturn(rc, rc);
+
+    rc = MMHyperAlloc(pVM, sizeof(PDMCRITSECTPROF) * cMax, 64, MM_TAG_PDM, (void **)&pVM->pdm.s.paCritSectProfsR3);
+    AssertLogRelRCReturn(rc, rc);
+    pVM->pdm.s.paCritSectProfsR0 = MMHyperR3ToR0(pVM, pVM->pdm.s.paCritSectProfsR3);
+    pVM->pdm.s.paCritSectProfsRC = MMHyperR3ToRC(pVM, pVM->pdm.s.paCritSectProfsR3);
+    pVM->pdm.s.cMaxCritSectProfs = cMax;
+
+    /*
+     * Pick up the sections created before PDM got initialized (MM, PGM, TM, IOM, ...).
+     */
+    PUVM pUVM = pVM->pUVM;
+    RTCritSectEnter(&pUVM->pdm.s.ListCritSect);
+    for (PPDMCRITSECTINT pCur = pUVM->pdm.s.pCritSects; pCur; pCur = pCur->pNext)
+        if (!pCur->idxProf)
+            pCur->idxProf = (uint16_t)pdmR3CritSectProfAssign(pVM, pCur->pszName, false /*fRw*/);
+    for (PPDMCRITSECTRWINT pCur = pUVM->pdm.s.pRwCritSects; pCur; pCur = pCur->pNext)
+        if (!pCur->idxProf)
+            pCur->idxProf = pdmR3CritSectProfAssign(pVM, pCur->pszName, true /*fRw*/);
+    RTCritSectLeave(&pUVM->pdm.s.ListCritSect);
+
+    LogRel(("PDM: Critical section contention profiling enabled: Filter='%s' MaxSections=%u (%u so far)\n",
+            pVM->pdm.s.pszCritSectProfFilter ? pVM->pdm.s.pszCritSectProfFilter : "*", cMax, pVM->pdm.s.cCritSectProfs));
+    DBGFR3InfoRegisterInternal(pVM, "critsectprof",
+                               "Displays the critical section contention profile. Optional argument: name pattern(s).",
+                               pdmR3CritSectProfInfo);
     return VINF_SUCCESS;
 }
 
 
+/**
+ * Assigns a contention profiler record to a critical section, provided the
+ * profiler is enabled, the name matches the filter and there are records left.
+ *
+ * @returns 1-based record index, 0 if the section shouldn't be profiled.
+ * @param   pVM         The cross context VM structure.
+ * @param   pszName     The critical section name.
+ * @param   fRw         Set if read/write critical section.
+ *
+ * @remarks Caller must have entered the ListCritSect.
+ */
+static uint32_t pdmR3CritSectProfAssign(PVM pVM, const char *pszName, bool fRw)
+{
+    Assert(RTCritSectIsOwner(&pVM->pUVM->pdm.s.ListCritSect));
+    if (   !pVM->pdm.s.paCritSectProfsR3
+        || pVM->pdm.s.cCritSectProfs >= pVM->pdm.s.cMaxCritSectProfs)
+        return 0;
+    if (   pVM->pdm.s.pszCritSectProfFilter
+        && !RTStrSimplePatternMultiMatch(pVM->pdm.s.pszCritSectProfFilter, RTSTR_MAX, pszName, RTSTR_MAX, NULL))
+        return 0;
+
+    uint32_t const   idxProf = ++pVM->pdm.s.cCritSectProfs;
+    PPDMCRITSECTPROF pProf   = &pVM->pdm.s.paCritSectProfsR3[idxProf - 1];
+    pProf->fRw = fRw;
+    RTStrCopy(pProf->szName, sizeof(pProf->szName), pszName);
+
+    const char *pszPrefix = fRw ? "/PDM/CritSectsRw" : "/PDM/CritSects";
+    STAMR3RegisterF(pVM, (void *)&pProf->cContentions,    STAMTYPE_U64, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Contended enter attempts.",                       "%s/%s/Prof/Contentions", pszPrefix, pszName);
+    STAMR3RegisterF(pVM, (void *)&pProf->cBusy,           STAMTYPE_U64, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Contended enter attempts that returned busy.",    "%s/%s/Prof/Busy", pszPrefix, pszName);
+    STAMR3RegisterF(pVM, (void *)&pProf->cTicksWaitTotal, STAMTYPE_U64, STAMVISIBILITY_ALWAYS, STAMUNIT_TICKS,      "Total time spent waiting to enter.",              "%s/%s/Prof/WaitTotal", pszPrefix, pszName);
+    STAMR3RegisterF(pVM, (void *)&pProf->cTicksWaitMax,   STAMTYPE_U64, STAMVISIBILITY_ALWAYS, STAMUNIT_TICKS,      "Longest wait to enter.",                          "%s/%s/Prof/WaitMax", pszPrefix, pszName);
+    STAMR3RegisterF(pVM, (void *)&pProf->cHolds,          STAMTYPE_U64, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES, "Exclusive ownership periods.",                    "%s/%s/Prof/Holds", pszPrefix, pszName);
+    STAMR3RegisterF(pVM, (void *)&pProf->cTicksHoldTotal, STAMTYPE_U64, STAMVISIBILITY_ALWAYS, STAMUNIT_TICKS,      "Total time held exclusively.",                    "%s/%s/Prof/HoldTotal", pszPrefix, pszName);
+    STAMR3RegisterF(pVM, (void *)&pProf->cTicksHoldMax,   STAMTYPE_U64, STAMVISIBILITY_ALWAYS, STAMUNIT_TICKS,      "Longest exclusive ownership period.",             "%s/%s/Prof/HoldMax", pszPrefix, pszName);
+    for (unsigned i = 0; i < PDMCRITSECTPROF_HIST_BUCKETS; i++)
+    {
+        STAMR3RegisterF(pVM, (void *)&pProf->acWaitHist[i], STAMTYPE_U64, STAMVISIBILITY_USED, STAMUNIT_OCCURENCES, "Waits of 4^N up to 4^(N+1) ticks.", "%s/%s/Prof/WaitHist/%02u", pszPrefix, pszName, i);
+        STAMR3RegisterF(pVM, (void *)&pProf->acHoldHist[i], STAMTYPE_U64, STAMVISIBILITY_USED, STAMUNIT_OCCURENCES, "Holds of 4^N up to 4^(N+1) ticks.", "%s/%s/Prof/HoldHist/%02u", pszPrefix, pszName, i);
+    }
+    return idxProf;
+}
+
+
+/**
+ * Detaches the contention profiler record from a critical section being deleted.
+ *
+ * The record itself is kept around so the numbers can still be inspected.
+ *
+ * @param   pVM         The cross context VM structure.
+ * @param   idxProf     The record index, 0 if none.
+ */
+static void pdmR3CritSectProfDetach(PVM pVM, uint32_t idxProf)
+{
+    if (idxProf && idxProf <= pVM->pdm.s.cCritSectProfs)
+        ASMAtomicWriteBool(&pVM->pdm.s.paCritSectProfsR3[idxProf - 1].fDeleted, true);
+}
+
+
+/**
+ * Converts TSC ticks to nanoseconds for display purposes.
+ *
+ * @returns Nanoseconds, or @a cTicks if the TSC frequency is unknown.
+ * @param   cTicks          The tick count.
+ * @param   uCpuHz          The TSC frequency.
+ */
+static uint64_t pdmR3CritSectProfTicksToNs(uint64_t cTicks, uint64_t uCpuHz)
+{
+    if (!uCpuHz)
+        return cTicks;
+    return cTicks / uCpuHz * RT_NS_1SEC + (cTicks % uCpuHz) * RT_NS_1SEC / uCpuHz;
+}
+
+
+/**
+ * Prints a profiler histogram.
+ *
+ * @param   pHlp            The info helpers.
+ * @param   pszWhat         What kind of histogram.
+ * @param   pacHist         The histogram buckets.
+ * @param   uCpuHz          The TSC frequency.
+ */
+static void pdmR3CritSectProfInfoHist(PCDBGFINFOHLP pHlp, const char *pszWhat, uint64_t const volatile *pacHist, uint64_t uCpuHz)
+{
+    bool fFirst = true;
+    for (unsigned i = 0; i < PDMCRITSECTPROF_HIST_BUCKETS; i++)
+    {
+        uint64_t const c = pacHist[i];
+        if (!c)
+            continue;
+        if (fFirst)
+            pHlp->pfnPrintf(pHlp, "    %s histogram:\n", pszWhat);
+        fFirst = false;
+        uint64_t const cTicksFirst = i ? RT_BIT_64(i * 2) : 0;
+        if (i + 1 < PDMCRITSECTPROF_HIST_BUCKETS)
+            pHlp->pfnPrintf(pHlp, "      %12RU64 - %12RU64 ns: %RU64\n", pdmR3CritSectProfTicksToNs(cTicksFirst, uCpuHz),
+                            pdmR3CritSectProfTicksToNs(RT_BIT_64(i * 2 + 2) - 1, uCpuHz), c);
+        else
+            pHlp->pfnPrintf(pHlp, "      %12RU64 ns and up:      %RU64\n", pdmR3CritSectProfTicksToNs(cTicksFirst, uCpuHz), c);
+    }
+}
+
+
+/**
+ * @callback_method_impl{FNDBGFHANDLERINT,
+ *      Displays the critical section contention profile.}
+ */
+static DECLCALLBACK(void) pdmR3CritSectProfInfo(PVM pVM, PCDBGFINFOHLP pHlp, const char *pszArgs)
+{
+    if (pszArgs)
+        pszArgs = RTStrStripL(pszArgs);
+    bool const     fAll   = !pszArgs || !*pszArgs;
+    uint64_t const uCpuHz = SUPGetCpuHzFromGip(g_pSUPGlobalInfoPage);
+    if (!uCpuHz)
+        pHlp->pfnPrintf(pHlp, "Warning: Unknown TSC frequency, times are in ticks rather than ns.\n");
+
+    uint32_t const cProfs = pVM->pdm.s.cCritSectProfs;
+    for (uint32_t iProf = 0; iProf < cProfs; iProf++)
+    {
+        PPDMCRITSECTPROF pProf = &pVM->pdm.s.paCritSectProfsR3[iProf];
+        if (!fAll && !RTStrSimplePatternMultiMatch(pszArgs, RTSTR_MAX, pProf->szName, RTSTR_MAX, NULL))
+            continue;
+
+        uint64_t const cContentions = pProf->cContentions;
+        uint64_t const cBusy        = pProf->cBusy;
+        uint64_t const cWaits       = cContentions - cBusy;
+        uint64_t const cHolds       = pProf->cHolds;
+        pHlp->pfnPrintf(pHlp, "%s%s%s:\n", pProf->szName, pProf->fRw ? " (rw)" : "", pProf->fDeleted ? " (deleted)" : "");
+        pHlp->pfnPrintf(pHlp, "    contentions=%RU64 busy=%RU64 wait-avg=%RU64ns wait-max=%RU64ns\n",
+                        cContentions, cBusy,
+                        pdmR3CritSectProfTicksToNs(cWaits ? pProf->cTicksWaitTotal / cWaits : 0, uCpuHz),
+                        pdmR3CritSectProfTicksToNs(pProf->cTicksWaitMax, uCpuHz));
+        pHlp->pfnPrintf(pHlp, "    holds=%RU64 hold-avg=%RU64ns hold-max=%RU64ns\n",
+                        cHolds,
+                        pdmR3CritSectProfTicksToNs(cHolds ? pProf->cTicksHoldTotal / cHolds : 0, uCpuHz),
+                        pdmR3CritSectProfTicksToNs(pProf->cTicksHoldMax, uCpuHz));
+        pdmR3CritSectProfInfoHist(pHlp, "Wait", pProf->acWaitHist, uCpuHz);
+        pdmR3CritSectProfInfoHist(pHlp, "Hold", pProf->acHoldHist, uCpuHz);
+
+        /* The call sites, most contended first. */
+        PDMCRITSECTPROFCALLER aCallers[PDMCRITSECTPROF_CALLERS];
+        unsigned              cCallers = 0;
+        for (unsigned i = 0; i < RT_ELEMENTS(aCallers); i++)
+        {
+            PDMCRITSECTPROFCALLER Caller = pProf->aCallers[i];
+            if (!Caller.cContentions)
+                continue;
+            unsigned j = cCallers++;
+            while (j > 0 && aCallers[j - 1].cContentions < Caller.cContentions)
+            {
+                aCallers[j] = aCallers[j - 1];
+                j--;
+            }
+            aCallers[j] = Caller;
+        }
+        if (cCallers)
+            pHlp->pfnPrintf(pHlp, "    Top contending call sites:\n");
+        for (unsigned i = 0; i < cCallers; i++)
+        {
+            static const char * const s_apszCtx[] = { "R3", "R0", "RC" };
+            char           szSymbol[128];
+            szSymbol[0] = '\0';
+            if (aCallers[i].enmCtx != PDMCRITSECTPROF_CTX_R3)
+            {
+                DBGFADDRESS Addr;
+                RTGCINTPTR  offDisp = 0;
+                RTDBGSYMBOL Symbol;
+                int rc = DBGFR3AsSymbolByAddr(pVM->pUVM,
+                                              aCallers[i].enmCtx == PDMCRITSECTPROF_CTX_R0 ? DBGF_AS_R0 : DBGF_AS_RC,
+                                              DBGFR3AddrFromFlat(pVM->pUVM, &Addr, aCallers[i].uCaller),
+                                              RTDBGSYMADDR_FLAGS_LESS_OR_EQUAL, &offDisp, &Symbol, NULL);
+                if (RT_SUCCESS(rc))
+                    RTStrPrintf(szSymbol, sizeof(szSymbol), " %s+%#RX64", Symbol.szName, (uint64_t)offDisp);
+            }
+            pHlp->pfnPrintf(pHlp, "      %s %RX64%s: %u times, wait-avg=%RU64ns\n",
+                            aCallers[i].enmCtx < RT_ELEMENTS(s_apszCtx) ? s_apszCtx[aCallers[i].enmCtx] : "??",
+                            aCallers[i].uCaller, szSymbol, aCallers[i].cContentions,
+                            pdmR3CritSectProfTicksToNs(aCallers[i].cTicksWait / aCallers[i].cContentions, uCpuHz));
+        }
+    }
+}
+
+
 /**
  * Relocates all the critical sections.
  *
@@ -80,6 +320,9 @@ void pdmR3CritSectBothRelocate(PVM pVM)
         pCur->pVMRC = pVM->pVMRC;
 
     RTCritSectLeave(&pUVM->pdm.s.ListCritSect);
+
+    if (pVM->pdm.s.paCritSectProfsR3)
+        pVM->pdm.s.paCritSectProfsRC = MMHyperR3ToRC(pVM, pVM->pdm.s.paCritSectProfsR3);
 }
 
 
@@ -120,6 +363,12 @@ VMMR3_INT_DECL(int) PDMR3CritSectBothTerm(PVM pVM)
     }
 
     RTCritSectLeave(&pUVM->pdm.s.ListCritSect);
+
+    if (pVM->pdm.s.pszCritSectProfFilter)
+    {
+        MMR3HeapFree(pVM->pdm.s.pszCritSectProfFilter);
+        pVM->pdm.s.pszCritSectProfFilter = NULL;
+    }
     return rc;
 }
 
@@ -193,6 +442,7 @@ static int pdmR3CritSectInitOne(PVM pVM, PPDMCRITSECTINT pCritSect, void *pvKey,
 
                 PUVM pUVM = pVM->pUVM;
                 RTCritSectEnter(&pUVM->pdm.s.ListCritSect);
+                pCritSect->idxProf = (uint16_t)pdmR3CritSectProfAssign(pVM, pszName, false /*fRw*/);
                 pCritSect->pNext = pUVM->pdm.s.pCritSects;
                 pUVM->pdm.s.pCritSects = pCritSect;
                 RTCritSectLeave(&pUVM->pdm.s.ListCritSect);
@@ -293,6 +543,7 @@ static int pdmR3CritSectRwInitOne(PVM pVM, PPDMCRITSECTRWINT pCritSect, void *pv
 
                     PUVM pUVM = pVM->pUVM;
                     RTCritSectEnter(&pUVM->pdm.s.ListCritSect);
+                    pCritSect->idxProf = pdmR3CritSectProfAssign(pVM, pszName, true /*fRw*/);
                     pCritSect->pNext = pUVM->pdm.s.pRwCritSects;
                     pUVM->pdm.s.pRwCritSects = pCritSect;
                     RTCritSectLeave(&pUVM->pdm.s.ListCritSect);
@@ -524,6 +775,8 @@ static int pdmR3CritSectDeleteOne(PVM pVM, PUVM pUVM, PPDMCRITSECTINT pCritSect,
     int rc = SUPSemEventClose(pVM->pSession, hEvent);
     AssertRC(rc);
     RTLockValidatorRecExclDestroy(&pCritSect->Core.pValidatorRec);
+    pdmR3CritSectProfDetach(pVM, pCritSect->idxProf);
+    pCritSect->idxProf = 0;
     pCritSect->pNext   = NULL;
     pCritSect->pvKey   = NULL;
     pCritSect->pVMR3   = NULL;
@@ -594,6 +847,8 @@ static int pdmR3CritSectRwDeleteOne(PVM pVM, PUVM pUVM, PPDMCRITSECTRWINT pCritS
 
     RTLockValidatorRecSharedDestroy(&pCritSect->Core.pValidatorRead);
     RTLockValidatorRecExclDestroy(&pCritSect->Core.pValidatorWrite);
+    pdmR3CritSectProfDetach(pVM, pCritSect->idxProf);
+    pCritSect->idxProf = 0;
 
     pCritSect->pNext   = NULL;
     pCritSect->pvKey   = NULL;
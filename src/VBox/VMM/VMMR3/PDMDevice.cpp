@@ -46,6 +46,7 @@
 #include <iprt/semaphore.h>
 #include <iprt/string.h>
 #include <iprt/thread.h>
+#include <iprt/time.h>
 
 
 /*********************************************************************************************************************************
@@ -390,7 +391,9 @@ int pdmR3DevInit(PVM pVM)
          */
         paDevs[i].pDev->cInstances++;
         Log(("PDM: Constructing device '%s' instance %d...\n", pDevIns->pReg->szName, pDevIns->iInstance));
+        uint64_t const nsStart = RTTimeNanoTS();
         rc = pDevIns->pReg->pfnConstruct(pDevIns, pDevIns->iInstance, pDevIns->pCfg);
+        pDevIns->Internal.s.cUsConstruct = (uint32_t)RT_MIN((RTTimeNanoTS() - nsStart) / RT_NS_1US, UINT32_MAX);
         if (RT_FAILURE(rc))
         {
             LogRel(("PDM: Failed to construct '%s'/%d! %Rra\n", pDevIns->pReg->szName, pDevIns->iInstance, rc));
@@ -401,6 +404,18 @@ int pdmR3DevInit(PVM pVM)
         }
     } /* for device instances */
 
+    /*
+     * Startup profile, to see which devices are slow to construct.
+     */
+    uint64_t cUsTotal = 0;
+    for (PPDMDEVINS pDevIns = pVM->pdm.s.pDevInstances; pDevIns; pDevIns = pDevIns->Internal.s.pNextR3)
+        cUsTotal += pDevIns->Internal.s.cUsConstruct;
+    LogRel(("PDM: Constructed %u device instances in %'RU64 us:\n", cDevs, cUsTotal));
+    for (PPDMDEVINS pDevIns = pVM->pdm.s.pDevInstances; pDevIns; pDevIns = pDevIns->Internal.s.pNextR3)
+        LogRel(("PDM:   %10'RU32 us %3u%%  %s/%u\n", pDevIns->Internal.s.cUsConstruct,
+                cUsTotal ? (unsigned)(pDevIns->Internal.s.cUsConstruct * UINT64_C(100) / cUsTotal) : 0,
+                pDevIns->pReg->szName, pDevIns->iInstance));
+
 #ifdef VBOX_WITH_USB
     /* ditto for USB Devices. */
     rc = pdmR3UsbInstantiateDevices(pVM);
@@ -31,6 +31,7 @@
 #include <VBox/err.h>
 
 #include <VBox/log.h>
+#include <VBox/sup.h>
 #include <iprt/asm.h>
 #include <iprt/assert.h>
 #include <iprt/thread.h>
@@ -42,6 +43,10 @@
 DECLINLINE(void)            pdmR3QueueFreeItem(PPDMQUEUE pQueue, PPDMQUEUEITEMCORE pItem);
 static bool                 pdmR3QueueFlush(PPDMQUEUE pQueue);
 static DECLCALLBACK(void)   pdmR3QueueTimer(PVM pVM, PTMTIMER pTimer, void *pvUser);
+static DECLCALLBACK(int)    pdmR3QueueWorkerThread(RTTHREAD hThreadSelf, void *pvUser);
+static void                 pdmR3QueueStopWorker(PVM pVM, PPDMQUEUE pQueue);
+static RTTHREAD             pdmR3QueueSignalWorker(PVM pVM, PPDMQUEUE pQueue);
+static void                 pdmR3QueueWaitWorker(RTTHREAD hThread, const char *pszName);
 
 
 
@@ -54,6 +59,7 @@ static DECLCALLBACK(void)   pdmR3QueueTimer(PVM pVM, PTMTIMER pTimer, void *pvUs
  * @param   cItems              Number of items.
  * @param   cMilliesInterval    Number of milliseconds between polling the queue.
  *                              If 0 then the emulation thread will be notified whenever an item arrives.
+ *                              If PDMQUEUE_INTERVAL_WORKER_THREAD the queue gets a dedicated consumer thread.
  * @param   fRZEnabled          Set if the queue will be used from RC/R0 and need to be allocated from the hyper heap.
  * @param   pszName             The queue name. Unique. Not copied.
  * @param   ppQueue             Where to store the queue handle.
@@ -92,6 +98,8 @@ static int pdmR3QueueCreate(PVM pVM, size_t cbItem, uint32_t cItems, uint32_t cM
     pQueue->pszName = pszName;
     pQueue->cMilliesInterval = cMilliesInterval;
     //pQueue->pTimer = NULL;
+    pQueue->hEvtWorker = NIL_SUPSEMEVENT;
+    pQueue->hWorkerThread = NIL_RTTHREAD;
     pQueue->cbItem = (uint32_t)cbItem;
     pQueue->cItems = cItems;
     //pQueue->pPendingR3 = NULL;
@@ -110,10 +118,46 @@ static int pdmR3QueueCreate(PVM pVM, size_t cbItem, uint32_t cItems, uint32_t cM
         }
     }
 
+    /*
+     * Create the worker thread?
+     */
+    if (cMilliesInterval == PDMQUEUE_INTERVAL_WORKER_THREAD)
+    {
+        rc = SUPSemEventCreate(pVM->pSession, &pQueue->hEvtWorker);
+        if (RT_SUCCESS(rc))
+        {
+            rc = RTThreadCreateF(&pQueue->hWorkerThread, pdmR3QueueWorkerThread, pQueue, 0, RTTHREADTYPE_IO,
+                                 RTTHREADFLAGS_WAITABLE, "Q-%.13s", pszName);
+            if (RT_FAILURE(rc))
+            {
+                AssertMsgFailed(("RTThreadCreateF failed rc=%Rrc\n", rc));
+                SUPSemEventClose(pVM->pSession, pQueue->hEvtWorker);
+                pQueue->hEvtWorker = NIL_SUPSEMEVENT;
+            }
+        }
+        else
+            AssertMsgFailed(("SUPSemEventCreate failed rc=%Rrc\n", rc));
+        if (RT_FAILURE(rc))
+        {
+            if (fRZEnabled)
+                MMHyperFree(pVM, pQueue);
+            else
+                MMR3HeapFree(pQueue);
+            return rc;
+        }
+
+        /*
+         * The timer list doubles as the list of worker thread driven queues.
+         */
+        pdmLock(pVM);
+        pQueue->pNext = pUVM->pdm.s.pQueuesTimer;
+        pUVM->pdm.s.pQueuesTimer = pQueue;
+        pdmUnlock(pVM);
+    }
     /*
      * Create timer?
      */
-    if (cMilliesInterval)
+    else if (cMilliesInterval)
     {
         rc = TMR3TimerCreateInternal(pVM, TMCLOCK_REAL, pdmR3QueueTimer, pQueue, "Queue timer", &pQueue->pTimer);
         if (RT_SUCCESS(rc))
@@ -178,6 +222,11 @@ static int pdmR3QueueCreate(PVM pVM, size_t cbItem, uint32_t cItems, uint32_t cM
     STAMR3RegisterF(pVM, &pQueue->StatInsert,           STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_CALLS,        "Calls to PDMQueueInsert.",         "/PDM/Queue/%s/Insert",         pQueue->pszName);
     STAMR3RegisterF(pVM, &pQueue->StatFlush,            STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_CALLS,        "Calls to pdmR3QueueFlush.",        "/PDM/Queue/%s/Flush",          pQueue->pszName);
     STAMR3RegisterF(pVM, &pQueue->StatFlushLeftovers,   STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,   "Left over items after flush.",     "/PDM/Queue/%s/FlushLeftovers", pQueue->pszName);
+    if (pQueue->hEvtWorker != NIL_SUPSEMEVENT)
+    {
+        STAMR3RegisterF(pVM, &pQueue->StatWorkerWakeups, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,  "Worker thread wakeups.",           "/PDM/Queue/%s/WorkerWakeups",  pQueue->pszName);
+        STAMR3RegisterF(pVM, &pQueue->StatWorkerBatches, STAMTYPE_COUNTER, STAMVISIBILITY_ALWAYS, STAMUNIT_OCCURENCES,  "Batches drained by the worker.",   "/PDM/Queue/%s/WorkerBatches",  pQueue->pszName);
+    }
 #ifdef VBOX_WITH_STATISTICS
     STAMR3RegisterF(pVM, &pQueue->StatFlushPrf,         STAMTYPE_PROFILE, STAMVISIBILITY_ALWAYS, STAMUNIT_CALLS,        "Profiling pdmR3QueueFlush.",       "/PDM/Queue/%s/FlushPrf",       pQueue->pszName);
     STAMR3RegisterF(pVM, (void *)&pQueue->cStatPending, STAMTYPE_U32,     STAMVISIBILITY_ALWAYS, STAMUNIT_COUNT,        "Pending items.",                   "/PDM/Queue/%s/Pending",        pQueue->pszName);
@@ -400,7 +449,7 @@ VMMR3_INT_DECL(int) PDMR3QueueDestroy(PPDMQUEUE pQueue)
     /*
      * Unlink it.
      */
-    if (pQueue->pTimer)
+    if (pQueue->cMilliesInterval)
     {
         if (pUVM->pdm.s.pQueuesTimer != pQueue)
         {
@@ -447,6 +496,16 @@ VMMR3_INT_DECL(int) PDMR3QueueDestroy(PPDMQUEUE pQueue)
      */
     STAMR3DeregisterF(pVM->pUVM, "/PDM/Queue/%s/cbItem", pQueue->pszName);
 
+    /*
+     * Stop the worker thread.
+     */
+    pdmR3QueueStopWorker(pVM, pQueue);
+    if (pQueue->hEvtWorker != NIL_SUPSEMEVENT)
+    {
+        SUPSemEventClose(pVM->pSession, pQueue->hEvtWorker);
+        pQueue->hEvtWorker = NIL_SUPSEMEVENT;
+    }
+
     /*
      * Destroy the timer and free it.
      */
@@ -520,6 +579,46 @@ VMMR3_INT_DECL(int) PDMR3QueueDestroyDevice(PVM pVM, PPDMDEVINS pDevIns)
 }
 
 
+/**
+ * Stops the worker threads of the queues owned by the specified device.
+ *
+ * Called before the device destructor, so the consumer callbacks won't be
+ * racing it.  Whatever is still pending is dropped with the queues.
+ *
+ * @param   pVM         The cross context VM structure.
+ * @param   pDevIns     Device instance.
+ * @thread  Emulation thread only.
+ */
+void pdmR3QueueStopWorkersDevice(PVM pVM, PPDMDEVINS pDevIns)
+{
+    /*
+     * Take the threads off the queues one by one under the lock and wait for
+     * them without it, the consumers may need the PDM lock to finish.
+     */
+    for (;;)
+    {
+        RTTHREAD    hThread = NIL_RTTHREAD;
+        const char *pszName = NULL;
+
+        pdmLock(pVM);
+        for (PPDMQUEUE pQueue = pVM->pUVM->pdm.s.pQueuesTimer; pQueue; pQueue = pQueue->pNext)
+            if (    pQueue->enmType == PDMQUEUETYPE_DEV
+                &&  pQueue->u.Dev.pDevIns == pDevIns
+                &&  pQueue->hWorkerThread != NIL_RTTHREAD)
+            {
+                hThread = pdmR3QueueSignalWorker(pVM, pQueue);
+                pszName = pQueue->pszName;
+                break;
+            }
+        pdmUnlock(pVM);
+
+        if (hThread == NIL_RTTHREAD)
+            break;
+        pdmR3QueueWaitWorker(hThread, pszName);
+    }
+}
+
+
 /**
  * Destroy a all queues owned by the specified driver.
  *
@@ -658,6 +757,12 @@ VMMR3_INT_DECL(void) PDMR3QueueFlushAll(PVM pVM)
                 ||  pCur->pPendingRC)
                 pdmR3QueueFlush(pCur);
 
+        /* Raw-mode cannot signal the worker thread queues, so do it for them. */
+        for (PPDMQUEUE pCur = pVM->pUVM->pdm.s.pQueuesTimer; pCur; pCur = pCur->pNext)
+            if (    pCur->hEvtWorker != NIL_SUPSEMEVENT
+                &&  pCur->pPendingRC)
+                PDMQueueFlushIfNecessary(pCur);
+
         ASMAtomicBitClear(&pVM->pdm.s.fQueueFlushing, PDM_QUEUE_FLUSH_FLAG_ACTIVE_BIT);
 
         /* We're done if there were no inserts while we were busy. */
@@ -839,7 +944,7 @@ static bool pdmR3QueueFlush(PPDMQUEUE pQueue)
  */
 DECLINLINE(void) pdmR3QueueFreeItem(PPDMQUEUE pQueue, PPDMQUEUEITEMCORE pItem)
 {
-    VM_ASSERT_EMT(pQueue->pVMR3);
+    Assert(pQueue->hWorkerThread != NIL_RTTHREAD ? pQueue->hWorkerThread == RTThreadSelf() : VM_IS_EMT(pQueue->pVMR3));
 
     int i = pQueue->iFreeHead;
     int iNext = (i + 1) % (pQueue->cItems + PDMQUEUE_FREE_SLACK);
@@ -878,3 +983,105 @@ static DECLCALLBACK(void) pdmR3QueueTimer(PVM pVM, PTMTIMER pTimer, void *pvUser
     AssertRC(rc);
 }
 
+
+/**
+ * Stops the worker thread of a queue, if it has a running one.
+ *
+ * @param   pVM         The cross context VM structure.
+ * @param   pQueue      The queue.
+ */
+static void pdmR3QueueStopWorker(PVM pVM, PPDMQUEUE pQueue)
+{
+    if (pQueue->hWorkerThread == NIL_RTTHREAD)
+        return;
+
+    RTTHREAD hThread = pdmR3QueueSignalWorker(pVM, pQueue);
+    pdmR3QueueWaitWorker(hThread, pQueue->pszName);
+}
+
+
+/**
+ * Tells the worker thread of a queue to terminate and detaches it from the
+ * queue.
+ *
+ * @returns The thread handle to pass to pdmR3QueueWaitWorker.
+ * @param   pVM         The cross context VM structure.
+ * @param   pQueue      The queue, must have a worker thread.
+ */
+static RTTHREAD pdmR3QueueSignalWorker(PVM pVM, PPDMQUEUE pQueue)
+{
+    RTTHREAD hThread = pQueue->hWorkerThread;
+    pQueue->hWorkerThread = NIL_RTTHREAD;
+
+    ASMAtomicWriteBool(&pQueue->fWorkerTerminate, true);
+    int rc = SUPSemEventSignal(pVM->pSession, pQueue->hEvtWorker);
+    AssertRC(rc);
+    return hThread;
+}
+
+
+/**
+ * Waits for a worker thread signalled by pdmR3QueueSignalWorker to terminate.
+ *
+ * @param   hThread     The thread handle.
+ * @param   pszName     The queue name, for logging.
+ */
+static void pdmR3QueueWaitWorker(RTTHREAD hThread, const char *pszName)
+{
+    int rc = RTThreadWait(hThread, 30000, NULL);
+    AssertLogRelMsgRC(rc, ("Queue %s: RTThreadWait -> %Rrc\n", pszName, rc));
+}
+
+
+/**
+ * The worker thread of a PDMQUEUE_INTERVAL_WORKER_THREAD queue.
+ *
+ * Drains the pending items in batches and only blocks on the event semaphore
+ * once the queue is empty, announcing it via PDMQUEUE::fWorkerSleeping so the
+ * producers know that a wakeup is needed.
+ *
+ * @returns VINF_SUCCESS.
+ * @param   hThreadSelf     The thread handle.
+ * @param   pvUser          Pointer to the queue.
+ */
+static DECLCALLBACK(int) pdmR3QueueWorkerThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    PPDMQUEUE pQueue   = (PPDMQUEUE)pvUser;
+    PVM       pVM      = pQueue->pVMR3;
+    NOREF(hThreadSelf);
+
+    while (!ASMAtomicReadBool(&pQueue->fWorkerTerminate))
+    {
+        uint32_t cMillies = RT_INDEFINITE_WAIT;
+        if (   pQueue->pPendingR3
+            || pQueue->pPendingR0
+            || pQueue->pPendingRC)
+        {
+            STAM_REL_COUNTER_INC(&pQueue->StatWorkerBatches);
+            if (pdmR3QueueFlush(pQueue))
+                continue;
+            cMillies = 1; /* The consumer is busy, retry shortly. */
+        }
+
+        /*
+         * Announce that we're going to sleep and recheck the queue to close
+         * the race with producers that didn't see the flag.
+         */
+        ASMAtomicXchgBool(&pQueue->fWorkerSleeping, true);
+        if (   cMillies == RT_INDEFINITE_WAIT
+            && (   pQueue->pPendingR3
+                || pQueue->pPendingR0
+                || pQueue->pPendingRC
+                || ASMAtomicReadBool(&pQueue->fWorkerTerminate)))
+        {
+            ASMAtomicXchgBool(&pQueue->fWorkerSleeping, false);
+            continue;
+        }
+
+        int rc = SUPSemEventWaitNoResume(pVM->pSession, pQueue->hEvtWorker, cMillies);
+        AssertLogRelMsg(RT_SUCCESS(rc) || rc == VERR_TIMEOUT || rc == VERR_INTERRUPTED, ("%Rrc\n", rc));
+        ASMAtomicXchgBool(&pQueue->fWorkerSleeping, false);
+    }
+
+    return VINF_SUCCESS;
+}
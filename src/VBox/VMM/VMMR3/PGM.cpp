@@ -1787,6 +1787,8 @@ static int pgmR3InitStats(PVM pVM)
     PGM_REG_COUNTER(&pStats->StatLargePageOverflow,             "/PGM/LargePage/Overflow",            "The number of times allocating a large page took too long.");
     PGM_REG_PROFILE(&pStats->StatR3IsValidLargePage,            "/PGM/LargePage/Prof/R3/IsValid",     "pgmPhysIsValidLargePage profiling - R3.");
     PGM_REG_PROFILE(&pStats->StatRZIsValidLargePage,            "/PGM/LargePage/Prof/RZ/IsValid",     "pgmPhysIsValidLargePage profiling - RZ.");
+    PGM_REG_PROFILE(&pStats->StatR3RamPreAlloc,                 "/PGM/R3/RamPreAlloc",                "pgmR3PhysRamPreAllocate profiling, allocating the pages.");
+    PGM_REG_PROFILE(&pStats->StatR3RamPreAllocClear,            "/PGM/R3/RamPreAlloc/Clear",          "pgmR3PhysRamPreAllocate profiling, clearing the pages.");
 
     PGM_REG_COUNTER(&pStats->StatR3DetectedConflicts,           "/PGM/R3/DetectedConflicts",          "The number of times PGMR3CheckMappingConflicts() detected a conflict.");
     PGM_REG_PROFILE(&pStats->StatR3ResolveConflict,             "/PGM/R3/ResolveConflict",            "pgmR3SyncPTResolveConflict() profiling (includes the entire relocation).");
@@ -2258,12 +2260,6 @@ VMMR3DECL(int) PGMR3InitFinalize(PVM pVM)
     else
         pVM->pgm.s.GCPhys4MBPSEMask = RT_BIT_64(32) - 1;
 
-    /*
-     * Allocate memory if we're supposed to do that.
-     */
-    if (pVM->pgm.s.fRamPreAlloc)
-        rc = pgmR3PhysRamPreAllocate(pVM);
-
     LogRel(("PGM: PGMR3InitFinalize: 4 MB PSE mask %RGp\n", pVM->pgm.s.GCPhys4MBPSEMask));
     return rc;
 }
@@ -2282,6 +2278,18 @@ VMMR3_INT_DECL(int) PGMR3InitCompleted(PVM pVM, VMINITCOMPLETED enmWhat)
     switch (enmWhat)
     {
         case VMINITCOMPLETED_HM:
+            /*
+             * Allocate memory if we're supposed to do that.  This is done
+             * here and not in PGMR3InitFinalize because HM has only now
+             * told us whether we can use large pages.
+             */
+            if (pVM->pgm.s.fRamPreAlloc)
+            {
+                int rc = pgmR3PhysRamPreAllocate(pVM);
+                if (RT_FAILURE(rc))
+                    return rc;
+            }
+
 #ifdef VBOX_WITH_PCI_PASSTHROUGH
             if (pVM->pgm.s.fPciPassthrough)
             {
@@ -21,6 +21,8 @@
 *********************************************************************************************************************************/
 #define LOG_GROUP LOG_GROUP_PGM_PHYS
 #include <VBox/vmm/pgm.h>
+#include <VBox/vmm/cfgm.h>
+#include <VBox/vmm/iem.h>
 #include <VBox/vmm/iom.h>
 #include <VBox/vmm/mm.h>
 #include <VBox/vmm/stam.h>
@@ -39,6 +41,7 @@
 #include <iprt/assert.h>
 #include <iprt/alloc.h>
 #include <iprt/asm.h>
+#include <iprt/mp.h>
 #ifdef VBOX_STRICT
 # include <iprt/crc.h>
 #endif
@@ -54,6 +57,41 @@
 #define PGMPHYS_FREE_PAGE_BATCH_SIZE    128
 
 
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/**
+ * A run of freshly allocated guest RAM that pgmR3PhysRamPreAllocate has yet
+ * to clear.
+ */
+typedef struct PGMPREALLOCRUN
+{
+    /** The ring-3 address of the first page. */
+    uint8_t                *pb;
+    /** The size of the run in bytes (GMM_CHUNK_SIZE at most). */
+    size_t                  cb;
+} PGMPREALLOCRUN;
+/** Pointer to a pre-allocation clearing run. */
+typedef PGMPREALLOCRUN *PPGMPREALLOCRUN;
+
+/**
+ * The clearing work shared by pgmR3PhysRamPreAllocate and its threads.
+ */
+typedef struct PGMPREALLOCCLEAR
+{
+    /** The runs. */
+    PPGMPREALLOCRUN         paRuns;
+    /** The number of runs. */
+    uint32_t                cRuns;
+    /** The number of entries allocated for paRuns. */
+    uint32_t                cRunsAlloc;
+    /** The index of the next run to clear. */
+    uint32_t volatile       iNextRun;
+} PGMPREALLOCCLEAR;
+/** Pointer to the pre-allocation clearing work. */
+typedef PGMPREALLOCCLEAR *PPGMPREALLOCCLEAR;
+
+
 /*
  * PGMR3PhysReadU8-64
  * PGMR3PhysWriteU8-64
@@ -1761,10 +1799,92 @@ VMMR3DECL(int) PGMR3PhysRegisterRam(PVM pVM, RTGCPHYS GCPhys, RTGCPHYS cb, const
 
 
 /**
- * Worker called by PGMR3InitFinalize if we're configured to pre-allocate RAM.
+ * Adds freshly allocated pages to the pre-allocation clearing runs.
+ *
+ * @param   pClear      The clearing state.
+ * @param   pv          The ring-3 address of the pages.
+ * @param   cb          The number of bytes (page aligned).
+ */
+static void pgmR3PhysRamPreAllocAddRun(PPGMPREALLOCCLEAR pClear, void *pv, size_t cb)
+{
+    /* Extend the previous run if adjacent, handy pages are usually handed
+       out in chunk order so this keeps the number of runs down. */
+    if (pClear->cRuns > 0)
+    {
+        PPGMPREALLOCRUN pLast = &pClear->paRuns[pClear->cRuns - 1];
+        if (   pLast->pb + pLast->cb == (uint8_t *)pv
+            && pLast->cb + cb <= GMM_CHUNK_SIZE)
+        {
+            pLast->cb += cb;
+            return;
+        }
+    }
+
+    if (pClear->cRuns >= pClear->cRunsAlloc)
+    {
+        uint32_t const cNew  = pClear->cRunsAlloc ? pClear->cRunsAlloc * 2 : _4K;
+        void          *pvNew = RTMemRealloc(pClear->paRuns, cNew * sizeof(pClear->paRuns[0]));
+        if (!pvNew)
+        {
+            /* Just clear them right away. */
+            for (size_t off = 0; off < cb; off += PAGE_SIZE)
+                ASMMemZeroPage((uint8_t *)pv + off);
+            return;
+        }
+        pClear->paRuns     = (PPGMPREALLOCRUN)pvNew;
+        pClear->cRunsAlloc = cNew;
+    }
+
+    pClear->paRuns[pClear->cRuns].pb = (uint8_t *)pv;
+    pClear->paRuns[pClear->cRuns].cb = cb;
+    pClear->cRuns++;
+}
+
+
+/**
+ * Clears pre-allocation runs until there are none left.
+ *
+ * This is executed by the EMT and the worker threads at the same time.
+ *
+ * @param   pClear      The clearing state.
+ */
+static void pgmR3PhysRamPreAllocClearRuns(PPGMPREALLOCCLEAR pClear)
+{
+    for (;;)
+    {
+        uint32_t const iRun = ASMAtomicIncU32(&pClear->iNextRun) - 1;
+        if (iRun >= pClear->cRuns)
+            break;
+        uint8_t     *pb = pClear->paRuns[iRun].pb;
+        size_t const cb = pClear->paRuns[iRun].cb;
+        for (size_t off = 0; off < cb; off += PAGE_SIZE)
+            ASMMemZeroPage(pb + off);
+    }
+}
+
+
+/**
+ * @callback_method_impl{FNRTTHREAD, Pre-allocation clearing thread.}
+ */
+static DECLCALLBACK(int) pgmR3PhysRamPreAllocClearThread(RTTHREAD hThreadSelf, void *pvUser)
+{
+    NOREF(hThreadSelf);
+    pgmR3PhysRamPreAllocClearRuns((PPGMPREALLOCCLEAR)pvUser);
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Worker called by PGMR3InitCompleted if we're configured to pre-allocate RAM.
  *
  * We do this late in the init process so that all the ROM and MMIO ranges have
- * been registered already and we don't go wasting memory on them.
+ * been registered already and we don't go wasting memory on them, and so that
+ * HM has decided whether we can use large pages.
+ *
+ * The allocation itself has to be done serially on the EMT while owning the
+ * PGM lock, but it only takes a ring-0 call per handy page batch or large
+ * page.  The bulk of the time goes into clearing (and thereby faulting in) the
+ * new pages, so this is deferred and done by a number of threads afterwards.
  *
  * @returns VBox status code.
  *
@@ -1775,14 +1895,34 @@ int pgmR3PhysRamPreAllocate(PVM pVM)
     Assert(pVM->pgm.s.fRamPreAlloc);
     Log(("pgmR3PhysRamPreAllocate: enter\n"));
 
+    /** @cfgm{/PGM/RamPreAllocThreads, uint32_t, host CPUs up to 16}
+     * The number of threads (including the EMT) clearing the pre-allocated RAM.
+     * 1 clears each handy page batch right away like on-demand allocation. */
+    RTTHREAD ahThreads[16];
+    uint32_t cThreads;
+    int rc = CFGMR3QueryU32Def(CFGMR3GetChild(CFGMR3GetRoot(pVM), "PGM"), "RamPreAllocThreads", &cThreads,
+                               (uint32_t)RT_MIN(RTMpGetOnlineCount(), RT_ELEMENTS(ahThreads)));
+    AssertLogRelRCReturn(rc, rc);
+    cThreads = RT_MAX(RT_MIN(cThreads, (uint32_t)RT_ELEMENTS(ahThreads)), 1);
+
+    /* The ring-3 addresses must stay valid until the pages have been
+       cleared, so don't defer if the chunk mapping cache is limited. */
+    bool const fDefer = cThreads > 1
+                     && pVM->pgm.s.ChunkR3Map.cMax == UINT32_MAX;
+    PGMPREALLOCCLEAR Clear;
+    RT_ZERO(Clear);
+
     /*
      * Walk the RAM ranges and allocate all RAM pages, halt at
      * the first allocation error.
      */
-    uint64_t cPages = 0;
-    uint64_t NanoTS = RTTimeNanoTS();
+    uint64_t       cPages       = 0;
+    uint32_t const cLargePages  = pVM->pgm.s.cLargePages;
+    uint64_t       NanoTS       = RTTimeNanoTS();
+    STAM_PROFILE_START(&pVM->pgm.s.CTX_SUFF(pStats)->StatR3RamPreAlloc, a);
     pgmLock(pVM);
-    for (PPGMRAMRANGE pRam = pVM->pgm.s.pRamRangesXR3; pRam; pRam = pRam->pNextR3)
+    pVM->pgm.s.fDeferPageClearing = fDefer;
+    for (PPGMRAMRANGE pRam = pVM->pgm.s.pRamRangesXR3; pRam && RT_SUCCESS(rc); pRam = pRam->pNextR3)
     {
         PPGMPAGE    pPage  = &pRam->aPages[0];
         RTGCPHYS    GCPhys = pRam->GCPhys;
@@ -1795,14 +1935,24 @@ int pgmR3PhysRamPreAllocate(PVM pVM)
                 {
                     case PGM_PAGE_STATE_ZERO:
                     {
-                        int rc = pgmPhysAllocPage(pVM, pPage, GCPhys);
+                        rc = pgmPhysAllocPage(pVM, pPage, GCPhys);
                         if (RT_FAILURE(rc))
                         {
                             LogRel(("PGM: RAM Pre-allocation failed at %RGp (in %s) with rc=%Rrc\n", GCPhys, pRam->pszDesc, rc));
-                            pgmUnlock(pVM);
-                            return rc;
+                            break;
+                        }
+
+                        /* A large page covers this and the following 511 pages. */
+                        size_t const cb = PGM_PAGE_GET_PDE_TYPE(pPage) == PGM_PAGE_PDE_TYPE_PDE ? _2M : PAGE_SIZE;
+                        Assert(cb == PAGE_SIZE || !(GCPhys & (_2M - 1)));
+                        cPages += cb >> PAGE_SHIFT;
+                        if (fDefer)
+                        {
+                            void *pv;
+                            rc = pgmPhysPageMapByPageID(pVM, PGM_PAGE_GET_PAGEID(pPage), PGM_PAGE_GET_HCPHYS(pPage), &pv);
+                            AssertLogRelMsgBreak(RT_SUCCESS(rc), ("%RGp: %Rrc\n", GCPhys, rc));
+                            pgmR3PhysRamPreAllocAddRun(&Clear, pv, cb);
                         }
-                        cPages++;
                         break;
                     }
 
@@ -1813,6 +1963,8 @@ int pgmR3PhysRamPreAllocate(PVM pVM)
                         /* nothing to do here. */
                         break;
                 }
+                if (RT_FAILURE(rc))
+                    break;
             }
 
             /* next */
@@ -1820,10 +1972,54 @@ int pgmR3PhysRamPreAllocate(PVM pVM)
             GCPhys += PAGE_SIZE;
         }
     }
+    STAM_PROFILE_STOP(&pVM->pgm.s.CTX_SUFF(pStats)->StatR3RamPreAlloc, a);
+    uint64_t const cNsAlloc = RTTimeNanoTS() - NanoTS;
+
+    /*
+     * Clear the pages.  Also the handy pages we didn't get around to
+     * using, those aren't in any run.  We keep owning the PGM lock till all
+     * of it is done so nobody gets to see the old page content.
+     */
+    uint32_t cStarted = 0;
+    if (fDefer)
+    {
+        STAM_PROFILE_START(&pVM->pgm.s.CTX_SUFF(pStats)->StatR3RamPreAllocClear, b);
+        for (uint32_t i = 0; i < pVM->pgm.s.cHandyPages; i++)
+        {
+            void *pv;
+            int rc2 = pgmPhysPageMapByPageID(pVM, pVM->pgm.s.aHandyPages[i].idPage,
+                                             pVM->pgm.s.aHandyPages[i].HCPhysGCPhys, &pv);
+            AssertLogRelRCBreakStmt(rc2, if (RT_SUCCESS(rc)) rc = rc2);
+            ASMMemZeroPage(pv);
+        }
+
+        while (cStarted < cThreads - 1 && Clear.cRuns > cStarted + 1)
+        {
+            int rc2 = RTThreadCreateF(&ahThreads[cStarted], pgmR3PhysRamPreAllocClearThread, &Clear, 0,
+                                      RTTHREADTYPE_DEFAULT, RTTHREADFLAGS_WAITABLE, "PreAlloc%u", cStarted);
+            if (RT_FAILURE(rc2))
+            {
+                LogRel(("PGM: Failed to create RAM pre-allocation thread #%u: %Rrc\n", cStarted, rc2));
+                break;
+            }
+            cStarted++;
+        }
+        pgmR3PhysRamPreAllocClearRuns(&Clear);
+        for (uint32_t i = 0; i < cStarted; i++)
+            RTThreadWait(ahThreads[i], RT_INDEFINITE_WAIT, NULL);
+
+        pVM->pgm.s.fDeferPageClearing = false;
+        STAM_PROFILE_STOP(&pVM->pgm.s.CTX_SUFF(pStats)->StatR3RamPreAllocClear, b);
+    }
     pgmUnlock(pVM);
     NanoTS = RTTimeNanoTS() - NanoTS;
 
-    LogRel(("PGM: Pre-allocated %llu pages in %llu ms\n", cPages, NanoTS / 1000000));
+    LogRel(("PGM: Pre-allocated %llu pages (%u large pages) in %llu ms; allocation %llu ms, clearing %llu ms using %u thread(s) and %u runs\n",
+            cPages, pVM->pgm.s.cLargePages - cLargePages, NanoTS / RT_NS_1MS, cNsAlloc / RT_NS_1MS,
+            (NanoTS - cNsAlloc) / RT_NS_1MS, cStarted + 1, Clear.cRuns));
+    RTMemFree(Clear.paRuns);
+    if (RT_FAILURE(rc))
+        return rc;
     Log(("pgmR3PhysRamPreAllocate: returns VINF_SUCCESS\n"));
     return VINF_SUCCESS;
 }
@@ -3756,6 +3952,7 @@ VMMDECL(void) PGMR3PhysSetA20(PVMCPU pVCpu, bool fEnable)
     {
         pVCpu->pgm.s.fA20Enabled = fEnable;
         pVCpu->pgm.s.GCPhysA20Mask = ~((RTGCPHYS)!fEnable << 20);
+        IEMTlbInvalidateAll(pVCpu);
 #ifdef VBOX_WITH_REM
         REMR3A20Set(pVCpu->pVMR3, pVCpu, fEnable);
 #endif
@@ -4208,7 +4405,8 @@ VMMR3DECL(int) PGMR3PhysAllocateLargeHandyPage(PVM pVM, RTGCPHYS GCPhys)
             STAM_PROFILE_START(&pVM->pgm.s.CTX_SUFF(pStats)->StatClearLargePage, b);
             for (unsigned i = 0; i < _2M/PAGE_SIZE; i++)
             {
-                ASMMemZeroPage(pv);
+                if (!pVM->pgm.s.fDeferPageClearing)
+                    ASMMemZeroPage(pv);
 
                 PPGMPAGE pPage;
                 rc = pgmPhysGetPageEx(pVM, GCPhys, &pPage);
@@ -4371,7 +4569,8 @@ VMMR3DECL(int) PGMR3PhysAllocateHandyPages(PVM pVM)
             AssertLogRelMsgBreak(RT_SUCCESS(rc),
                                  ("%u/%u: idPage=%#x HCPhysGCPhys=%RHp rc=%Rrc\n",
                                   iClear, pVM->pgm.s.cHandyPages, pPage->idPage, pPage->HCPhysGCPhys, rc));
-            ASMMemZeroPage(pv);
+            if (!pVM->pgm.s.fDeferPageClearing)
+                ASMMemZeroPage(pv);
             iClear++;
             Log3(("PGMR3PhysAllocateHandyPages: idPage=%#x HCPhys=%RGp\n", pPage->idPage, pPage->HCPhysGCPhys));
         }
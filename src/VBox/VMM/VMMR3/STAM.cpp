@@ -62,6 +62,7 @@
 #include <iprt/mem.h>
 #include <iprt/stream.h>
 #include <iprt/string.h>
+#include <iprt/time.h>
 
 
 /*********************************************************************************************************************************
@@ -119,6 +120,29 @@ typedef struct STAMR3SNAPSHOTONE
 } STAMR3SNAPSHOTONE, *PSTAMR3SNAPSHOTONE;
 
 
+/**
+ * The binary snapshot status structure.
+ * Argument package passed to stamR3SnapshotBinOne.
+ */
+typedef struct STAMR3SNAPSHOTBIN
+{
+    /** Pointer to the buffer start. */
+    uint8_t        *pbStart;
+    /** The current buffer offset. */
+    size_t          off;
+    /** The number of bytes allocated. */
+    size_t          cbAllocated;
+    /** The STAM_SNAPSHOT_BIN_F_XXX flags. */
+    uint32_t        fFlags;
+    /** The delta baseline to compare with and update, NULL if none. */
+    PSTAMSNAPSHOTBINBASELINE pBaseline;
+    /** Number of entries written. */
+    uint32_t        cEntries;
+    /** The status code. */
+    int             rc;
+} STAMR3SNAPSHOTBIN, *PSTAMR3SNAPSHOTBIN;
+
+
 /**
  * Init record for a ring-0 statistic sample.
  */
@@ -151,6 +175,7 @@ static DECLCALLBACK(void)   stamR3EnumRelLogPrintf(PSTAMR3PRINTONEARGS pvArg, co
 static DECLCALLBACK(void)   stamR3EnumPrintf(PSTAMR3PRINTONEARGS pvArg, const char *pszFormat, ...);
 static int                  stamR3SnapshotOne(PSTAMDESC pDesc, void *pvArg);
 static int                  stamR3SnapshotPrintf(PSTAMR3SNAPSHOTONE pThis, const char *pszFormat, ...);
+static int                  stamR3SnapshotBinOne(PSTAMDESC pDesc, void *pvArg);
 static int                  stamR3PrintOne(PSTAMDESC pDesc, void *pvArg);
 static int                  stamR3EnumOne(PSTAMDESC pDesc, void *pvArg);
 static bool                 stamR3MultiMatch(const char * const *papszExpressions, unsigned cExpressions, unsigned *piExpression, const char *pszName);
@@ -289,6 +314,17 @@ VMMR3DECL(int) STAMR3InitUVM(PUVM pUVM)
 
     RTListInit(&pUVM->stam.s.List);
 
+    /*
+     * Allocate the name hash table.
+     */
+    pUVM->stam.s.papHash = (PSTAMDESC *)RTMemAllocZ(STAM_HASH_SIZE * sizeof(PSTAMDESC));
+    if (!pUVM->stam.s.papHash)
+    {
+        RTSemRWDestroy(pUVM->stam.s.RWSem);
+        pUVM->stam.s.RWSem = NIL_RTSEMRW;
+        return VERR_NO_MEMORY;
+    }
+
 #ifdef STAM_WITH_LOOKUP_TREE
     /*
      * Initialize the root node.
@@ -296,6 +332,8 @@ VMMR3DECL(int) STAMR3InitUVM(PUVM pUVM)
     PSTAMLOOKUP pRoot = (PSTAMLOOKUP)RTMemAlloc(sizeof(STAMLOOKUP));
     if (!pRoot)
     {
+        RTMemFree(pUVM->stam.s.papHash);
+        pUVM->stam.s.papHash = NULL;
         RTSemRWDestroy(pUVM->stam.s.RWSem);
         pUVM->stam.s.RWSem = NIL_RTSEMRW;
         return VERR_NO_MEMORY;
@@ -360,6 +398,13 @@ VMMR3DECL(void) STAMR3TermUVM(PUVM pUVM)
     pUVM->stam.s.pRoot = NULL;
 #endif
 
+    RTMemFree(pUVM->stam.s.papHash);
+    pUVM->stam.s.papHash = NULL;
+    RTMemFree(pUVM->stam.s.papSamples);
+    pUVM->stam.s.papSamples = NULL;
+    pUVM->stam.s.cSamples = 0;
+    pUVM->stam.s.cSamplesAlloc = 0;
+
     Assert(pUVM->stam.s.RWSem != NIL_RTSEMRW);
     RTSemRWDestroy(pUVM->stam.s.RWSem);
     pUVM->stam.s.RWSem = NIL_RTSEMRW;
@@ -618,6 +663,49 @@ static int stamR3SlashCompare(const char *psz1, const char *psz2)
 #endif /* VBOX_STRICT */
 
 
+/**
+ * Looks up a sample descriptor by name using the hash table.
+ *
+ * @returns Pointer to the sample descriptor, NULL if not found.
+ * @param   pUVM                Pointer to the user mode VM structure.
+ * @param   pszName             The name to lookup.
+ * @remarks Caller must hold the STAM lock.
+ */
+static PSTAMDESC stamR3HashFindDesc(PUVM pUVM, const char *pszName)
+{
+    uint32_t const uHash = RTStrHash1(pszName);
+    for (PSTAMDESC pCur = pUVM->stam.s.papHash[uHash % STAM_HASH_SIZE]; pCur; pCur = pCur->pHashNext)
+        if (   pCur->uHash == uHash
+            && !strcmp(pCur->pszName, pszName))
+            return pCur;
+    return NULL;
+}
+
+
+/**
+ * Removes a sample descriptor from the hash table.
+ *
+ * @param   pUVM                Pointer to the user mode VM structure.
+ * @param   pDesc               The descriptor to remove.
+ * @remarks Caller must hold the STAM lock for writing.
+ */
+static void stamR3HashRemove(PUVM pUVM, PSTAMDESC pDesc)
+{
+    PSTAMDESC *ppCur = &pUVM->stam.s.papHash[pDesc->uHash % STAM_HASH_SIZE];
+    while (*ppCur)
+    {
+        if (*ppCur == pDesc)
+        {
+            *ppCur = pDesc->pHashNext;
+            pDesc->pHashNext = NULL;
+            return;
+        }
+        ppCur = &(*ppCur)->pHashNext;
+    }
+    AssertMsgFailed(("%s\n", pDesc->pszName));
+}
+
+
 #ifdef STAM_WITH_LOOKUP_TREE
 
 /**
@@ -856,33 +944,6 @@ static PSTAMDESC stamR3LookupFindNextWithDesc(PSTAMLOOKUP pLookup)
 }
 
 
-/**
- * Look up a sample descriptor by name.
- *
- * @returns Pointer to a sample descriptor.
- * @param   pRoot               The root node.
- * @param   pszName             The name to lookup.
- */
-static PSTAMDESC stamR3LookupFindDesc(PSTAMLOOKUP pRoot, const char *pszName)
-{
-    Assert(!pRoot->pParent);
-    while (*pszName++ == '/')
-    {
-        const char *pszEnd = strchr(pszName, '/');
-        uint32_t    cch    = pszEnd ? pszEnd - pszName : (uint32_t)strlen(pszName);
-        PSTAMLOOKUP pChild = stamR3LookupFindChild(pRoot, pszName, cch, NULL);
-        if (!pChild)
-            break;
-        if (!pszEnd)
-            return pChild->pDesc;
-        pszName = pszEnd;
-        pRoot   = pChild;
-    }
-
-    return NULL;
-}
-
-
 /**
  * Finds the first sample descriptor for a given lookup range.
  *
@@ -1399,6 +1460,22 @@ static int stamR3RegisterU(PUVM pUVM, void *pvSample, PFNSTAMR3CALLBACKRESET pfn
     }
 #endif /* VBOX_STRICT */
 
+    /*
+     * Make sure there is room in the sample index table.
+     */
+    if (pUVM->stam.s.cSamples >= pUVM->stam.s.cSamplesAlloc)
+    {
+        uint32_t  cNew      = pUVM->stam.s.cSamplesAlloc ? pUVM->stam.s.cSamplesAlloc * 2 : 1024;
+        PSTAMDESC *papNew   = (PSTAMDESC *)RTMemRealloc(pUVM->stam.s.papSamples, cNew * sizeof(PSTAMDESC));
+        if (!papNew)
+        {
+            STAM_UNLOCK_WR(pUVM);
+            return VERR_NO_MEMORY;
+        }
+        pUVM->stam.s.papSamples    = papNew;
+        pUVM->stam.s.cSamplesAlloc = cNew;
+    }
+
     /*
      * Create a new node and insert it at the current location.
      */
@@ -1434,6 +1511,13 @@ static int stamR3RegisterU(PUVM pUVM, void *pvSample, PFNSTAMR3CALLBACKRESET pfn
         stamR3LookupIncUsage(pLookup);
 #endif
 
+        pNew->uHash         = RTStrHash1(pNew->pszName);
+        pNew->pHashNext     = pUVM->stam.s.papHash[pNew->uHash % STAM_HASH_SIZE];
+        pUVM->stam.s.papHash[pNew->uHash % STAM_HASH_SIZE] = pNew;
+        pNew->iSample       = pUVM->stam.s.cSamples++;
+        pUVM->stam.s.papSamples[pNew->iSample] = pNew;
+        ASMAtomicIncU32(&pUVM->stam.s.uGeneration);
+
         stamR3ResetOne(pNew, pUVM->pVM);
         rc = VINF_SUCCESS;
     }
@@ -1455,6 +1539,9 @@ static int stamR3RegisterU(PUVM pUVM, void *pvSample, PFNSTAMR3CALLBACKRESET pfn
 static int stamR3DestroyDesc(PUVM pUVM, PSTAMDESC pCur)
 {
     RTListNodeRemove(&pCur->ListEntry);
+    stamR3HashRemove(pUVM, pCur);
+    pUVM->stam.s.papSamples[pCur->iSample] = NULL;
+    ASMAtomicIncU32(&pUVM->stam.s.uGeneration);
 #ifdef STAM_WITH_LOOKUP_TREE
     pCur->pLookup->pDesc = NULL; /** @todo free lookup nodes once it's working. */
     stamR3LookupDecUsage(pCur->pLookup);
@@ -2090,6 +2177,351 @@ VMMR3DECL(int)  STAMR3SnapshotFree(PUVM pUVM, char *pszSnapshot)
 }
 
 
+/**
+ * Creates a delta baseline for binary statistics snapshots.
+ *
+ * Each statistics consumer polling with STAM_SNAPSHOT_BIN_F_DELTA needs its
+ * own baseline, so consumers don't steal each others changes.
+ *
+ * @returns VBox status code.
+ * @param   phBaseline      Where to return the baseline handle.  Destroy
+ *                          using STAMR3SnapshotBinBaselineDestroy().
+ */
+VMMR3DECL(int) STAMR3SnapshotBinBaselineCreate(PSTAMSNAPSHOTBINBASELINE *phBaseline)
+{
+    AssertPtrReturn(phBaseline, VERR_INVALID_POINTER);
+    PSTAMSNAPSHOTBINBASELINE pBaseline = (PSTAMSNAPSHOTBINBASELINE)RTMemAllocZ(sizeof(*pBaseline));
+    if (!pBaseline)
+        return VERR_NO_MEMORY;
+    *phBaseline = pBaseline;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Destroys a delta baseline created by STAMR3SnapshotBinBaselineCreate().
+ *
+ * This may be called after the VM has been destroyed.
+ *
+ * @param   hBaseline       The baseline handle.  NULL is ignored.
+ */
+VMMR3DECL(void) STAMR3SnapshotBinBaselineDestroy(PSTAMSNAPSHOTBINBASELINE hBaseline)
+{
+    if (!hBaseline)
+        return;
+    if (hBaseline->pUVM)
+        VMR3ReleaseUVM(hBaseline->pUVM);
+    RTMemFree(hBaseline->pbmValid);
+    RTMemFree(hBaseline->pau64Last);
+    RTMemFree(hBaseline);
+}
+
+
+/**
+ * Prepares a delta baseline for taking a snapshot of the given VM.
+ *
+ * A baseline taken of a different VM is dropped.  The UVM is retained so its
+ * address can't be reused by a new VM while the baseline refers to it.
+ *
+ * @returns VBox status code.
+ * @param   pBaseline       The baseline.
+ * @param   pUVM            The user mode VM handle.
+ */
+static int stamR3SnapshotBinBaselinePrepare(PSTAMSNAPSHOTBINBASELINE pBaseline, PUVM pUVM)
+{
+    if (pBaseline->pUVM != pUVM)
+    {
+        if (pBaseline->pUVM)
+            VMR3ReleaseUVM(pBaseline->pUVM);
+        VMR3RetainUVM(pUVM);
+        pBaseline->pUVM = pUVM;
+        if (pBaseline->pbmValid)
+            RT_BZERO(pBaseline->pbmValid, RT_ALIGN_32(pBaseline->cSamples, 64) / 8);
+    }
+
+    /* Samples registered after this are simply reported as changed. */
+    uint32_t const cSamples = ASMAtomicReadU32(&pUVM->stam.s.cSamples);
+    if (cSamples > pBaseline->cSamples)
+    {
+        uint32_t const cNew   = RT_ALIGN_32(cSamples + 64, 64);
+        uint64_t      *pbmNew = (uint64_t *)RTMemRealloc(pBaseline->pbmValid, cNew / 8);
+        if (!pbmNew)
+            return VERR_NO_MEMORY;
+        pBaseline->pbmValid = pbmNew;
+        uint64_t *pau64New  = (uint64_t *)RTMemRealloc(pBaseline->pau64Last,
+                                                        cNew * STAM_SNAPSHOT_BIN_MAX_VALUES * sizeof(uint64_t));
+        if (!pau64New)
+            return VERR_NO_MEMORY;
+        pBaseline->pau64Last = pau64New;
+
+        uint32_t const cbOld = RT_ALIGN_32(pBaseline->cSamples, 64) / 8;
+        memset((uint8_t *)pbmNew + cbOld, 0, cNew / 8 - cbOld);
+        pBaseline->cSamples = cNew;
+    }
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Get a binary snapshot of the statistics.
+ *
+ * This is a low overhead alternative to STAMR3Snapshot for monitoring
+ * software polling the statistics at regular intervals: the sample values are
+ * copied raw without any string formatting, samples are identified by a
+ * stable index (names only on request), and with STAM_SNAPSHOT_BIN_F_DELTA
+ * only the samples which changed since the previous binary snapshot taken with
+ * the same baseline are included.  When no pattern is given, the samples are taken straight from
+ * the index table without any pattern matching.
+ *
+ * See STAMBINSNAPSHOTHDR and STAMBINSNAPSHOTENTRY for the format.  Callback
+ * samples are not included.
+ *
+ * @returns VBox status code.
+ * @param   pUVM            The user mode VM handle.
+ * @param   pszPat          The name matching pattern. NULL or "*" for all.
+ * @param   fFlags          STAM_SNAPSHOT_BIN_F_XXX.
+ * @param   hBaseline       The delta baseline of the caller, updated with the
+ *                          values in this snapshot.  Required with
+ *                          STAM_SNAPSHOT_BIN_F_DELTA, optional otherwise.
+ *                          The caller must serialize the use of it.
+ * @param   ppvSnapshot     Where to store the pointer to the snapshot data.
+ *                          Free using STAMR3SnapshotBinFree().
+ * @param   pcbSnapshot     Where to store the size of the snapshot data.
+ *                          Optional.
+ */
+VMMR3DECL(int) STAMR3SnapshotBin(PUVM pUVM, const char *pszPat, uint32_t fFlags, PSTAMSNAPSHOTBINBASELINE hBaseline,
+                                 void **ppvSnapshot, size_t *pcbSnapshot)
+{
+    UVM_ASSERT_VALID_EXT_RETURN(pUVM, VERR_INVALID_VM_HANDLE);
+    VM_ASSERT_VALID_EXT_RETURN(pUVM->pVM, VERR_INVALID_VM_HANDLE);
+    AssertReturn(!(fFlags & ~STAM_SNAPSHOT_BIN_F_VALID_MASK), VERR_INVALID_FLAGS);
+    AssertReturn(hBaseline || !(fFlags & STAM_SNAPSHOT_BIN_F_DELTA), VERR_INVALID_PARAMETER);
+    AssertPtrNullReturn(hBaseline, VERR_INVALID_HANDLE);
+    AssertPtrReturn(ppvSnapshot, VERR_INVALID_POINTER);
+    *ppvSnapshot = NULL;
+
+    AssertCompileSize(STAMBINSNAPSHOTHDR, 24);
+    AssertCompileSize(STAMBINSNAPSHOTENTRY, 8);
+    AssertCompile(STAM_MAX_NAME_LEN <= UINT8_MAX); /* STAMBINSNAPSHOTENTRY::cchName */
+
+    if (hBaseline)
+    {
+        int rc = stamR3SnapshotBinBaselinePrepare(hBaseline, pUVM);
+        if (RT_FAILURE(rc))
+            return rc;
+    }
+
+    STAMR3SNAPSHOTBIN State;
+    State.cbAllocated = _16K;
+    State.pbStart     = (uint8_t *)RTMemAlloc(State.cbAllocated);
+    if (!State.pbStart)
+        return VERR_NO_MEMORY;
+    State.off         = sizeof(STAMBINSNAPSHOTHDR);
+    State.fFlags      = fFlags;
+    State.pBaseline   = hBaseline;
+    State.cEntries    = 0;
+    State.rc          = VINF_SUCCESS;
+
+    int rc;
+    if (!pszPat || !*pszPat || !strcmp(pszPat, "*"))
+    {
+        /* Fast path: the raw index table, no pattern matching. */
+        stamR3Ring0StatsUpdateU(pUVM, "*");
+
+        rc = VINF_SUCCESS;
+        STAM_LOCK_RD(pUVM);
+        uint32_t const cSamples = pUVM->stam.s.cSamples;
+        for (uint32_t i = 0; i < cSamples && rc == VINF_SUCCESS; i++)
+        {
+            PSTAMDESC pDesc = pUVM->stam.s.papSamples[i];
+            if (pDesc)
+                rc = stamR3SnapshotBinOne(pDesc, &State);
+        }
+        STAM_UNLOCK_RD(pUVM);
+    }
+    else
+        rc = stamR3EnumU(pUVM, pszPat, true /* fUpdateRing0 */, stamR3SnapshotBinOne, &State);
+    if (RT_SUCCESS(rc))
+        rc = State.rc;
+    if (RT_FAILURE(rc))
+    {
+        RTMemFree(State.pbStart);
+        return rc;
+    }
+
+    /*
+     * Complete the header.
+     */
+    PSTAMBINSNAPSHOTHDR pHdr = (PSTAMBINSNAPSHOTHDR)State.pbStart;
+    pHdr->u32Magic    = STAMBINSNAPSHOTHDR_MAGIC;
+    pHdr->uVersion    = STAMBINSNAPSHOTHDR_VERSION;
+    pHdr->fFlags      = (uint16_t)fFlags;
+    pHdr->uGeneration = ASMAtomicReadU32(&pUVM->stam.s.uGeneration);
+    pHdr->cEntries    = State.cEntries;
+    pHdr->u64NanoTS   = RTTimeNanoTS();
+
+    *ppvSnapshot = State.pbStart;
+    if (pcbSnapshot)
+        *pcbSnapshot = State.off;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * stamR3EnumU callback employed by STAMR3SnapshotBin.
+ *
+ * @returns VBox status code, but it's interpreted as 0 == success / !0 == failure by enmR3Enum.
+ * @param   pDesc       The sample.
+ * @param   pvArg       The binary snapshot status structure.
+ */
+static int stamR3SnapshotBinOne(PSTAMDESC pDesc, void *pvArg)
+{
+    PSTAMR3SNAPSHOTBIN pThis = (PSTAMR3SNAPSHOTBIN)pvArg;
+
+    /*
+     * Copy out the raw values.
+     */
+    uint64_t au64[STAM_SNAPSHOT_BIN_MAX_VALUES];
+    uint8_t  cValues;
+    switch (pDesc->enmType)
+    {
+        case STAMTYPE_COUNTER:
+            au64[0] = pDesc->u.pCounter->c;
+            cValues = 1;
+            break;
+
+        case STAMTYPE_PROFILE:
+        case STAMTYPE_PROFILE_ADV:
+            au64[0] = pDesc->u.pProfile->cPeriods;
+            au64[1] = pDesc->u.pProfile->cTicks;
+            au64[2] = pDesc->u.pProfile->cTicksMax;
+            au64[3] = pDesc->u.pProfile->cTicksMin;
+            cValues = 4;
+            break;
+
+        case STAMTYPE_RATIO_U32:
+        case STAMTYPE_RATIO_U32_RESET:
+            au64[0] = pDesc->u.pRatioU32->u32A;
+            au64[1] = pDesc->u.pRatioU32->u32B;
+            cValues = 2;
+            break;
+
+        case STAMTYPE_U8:
+        case STAMTYPE_U8_RESET:
+        case STAMTYPE_X8:
+        case STAMTYPE_X8_RESET:
+            au64[0] = *pDesc->u.pu8;
+            cValues = 1;
+            break;
+
+        case STAMTYPE_U16:
+        case STAMTYPE_U16_RESET:
+        case STAMTYPE_X16:
+        case STAMTYPE_X16_RESET:
+            au64[0] = *pDesc->u.pu16;
+            cValues = 1;
+            break;
+
+        case STAMTYPE_U32:
+        case STAMTYPE_U32_RESET:
+        case STAMTYPE_X32:
+        case STAMTYPE_X32_RESET:
+            au64[0] = *pDesc->u.pu32;
+            cValues = 1;
+            break;
+
+        case STAMTYPE_U64:
+        case STAMTYPE_U64_RESET:
+        case STAMTYPE_X64:
+        case STAMTYPE_X64_RESET:
+            au64[0] = *pDesc->u.pu64;
+            cValues = 1;
+            break;
+
+        case STAMTYPE_BOOL:
+        case STAMTYPE_BOOL_RESET:
+            au64[0] = *pDesc->u.pf;
+            cValues = 1;
+            break;
+
+        case STAMTYPE_CALLBACK:
+            return VINF_SUCCESS;
+
+        default:
+            AssertMsgFailed(("enmType=%d\n", pDesc->enmType));
+            return VINF_SUCCESS;
+    }
+
+    /*
+     * Skip unchanged samples when doing deltas, comparing all the values
+     * with the ones of the previous snapshot.
+     */
+    PSTAMSNAPSHOTBINBASELINE pBaseline = pThis->pBaseline;
+    if (pBaseline && pDesc->iSample < pBaseline->cSamples)
+    {
+        uint64_t *pau64Last = &pBaseline->pau64Last[(size_t)pDesc->iSample * STAM_SNAPSHOT_BIN_MAX_VALUES];
+        if (   (pThis->fFlags & STAM_SNAPSHOT_BIN_F_DELTA)
+            && ASMBitTest(pBaseline->pbmValid, pDesc->iSample)
+            && !memcmp(pau64Last, au64, cValues * sizeof(uint64_t)))
+            return VINF_SUCCESS;
+        memcpy(pau64Last, au64, cValues * sizeof(uint64_t));
+        ASMBitSet(pBaseline->pbmValid, pDesc->iSample);
+    }
+
+    /*
+     * Append the entry, growing the buffer as needed.
+     */
+    size_t const cchName = pThis->fFlags & STAM_SNAPSHOT_BIN_F_NAMES ? strlen(pDesc->pszName) : 0;
+    size_t const cbEntry = RT_ALIGN_Z(sizeof(STAMBINSNAPSHOTENTRY) + cValues * sizeof(uint64_t) + (cchName ? cchName + 1 : 0), 8);
+    if (pThis->off + cbEntry > pThis->cbAllocated)
+    {
+        size_t   cbNew = RT_MAX(pThis->cbAllocated * 2, pThis->off + cbEntry);
+        uint8_t *pbNew = (uint8_t *)RTMemRealloc(pThis->pbStart, cbNew);
+        if (!pbNew)
+        {
+            pThis->rc = VERR_NO_MEMORY;
+            return VERR_NO_MEMORY;
+        }
+        pThis->pbStart     = pbNew;
+        pThis->cbAllocated = cbNew;
+    }
+
+    PSTAMBINSNAPSHOTENTRY pEntry = (PSTAMBINSNAPSHOTENTRY)&pThis->pbStart[pThis->off];
+    pEntry->iSample = pDesc->iSample;
+    pEntry->enmType = (uint8_t)pDesc->enmType;
+    pEntry->enmUnit = (uint8_t)pDesc->enmUnit;
+    pEntry->cValues = cValues;
+    pEntry->cchName = (uint8_t)cchName;
+    uint8_t *pb = (uint8_t *)(pEntry + 1);
+    memcpy(pb, au64, cValues * sizeof(uint64_t));
+    pb += cValues * sizeof(uint64_t);
+    if (cchName)
+    {
+        memcpy(pb, pDesc->pszName, cchName + 1);
+        pb += cchName + 1;
+    }
+    memset(pb, 0, &pThis->pbStart[pThis->off + cbEntry] - pb);
+
+    pThis->off += cbEntry;
+    pThis->cEntries++;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Releases a binary statistics snapshot returned by STAMR3SnapshotBin().
+ *
+ * @param   pUVM            The user mode VM handle.
+ * @param   pvSnapshot      The snapshot data pointer returned by
+ *                          STAMR3SnapshotBin(). NULL is allowed.
+ */
+VMMR3DECL(void) STAMR3SnapshotBinFree(PUVM pUVM, void *pvSnapshot)
+{
+    RTMemFree(pvSnapshot);
+    NOREF(pUVM);
+}
+
+
 /**
  * Dumps the selected statistics to the log.
  *
@@ -2521,15 +2953,15 @@ static int stamR3EnumU(PUVM pUVM, const char *pszPat, bool fUpdateRing0,
             stamR3Ring0StatsUpdateU(pUVM, pszPat);
 
         STAM_LOCK_RD(pUVM);
-#ifdef STAM_WITH_LOOKUP_TREE
         if (!stamR3IsPattern(pszPat))
         {
-            pCur = stamR3LookupFindDesc(pUVM->stam.s.pRoot, pszPat);
+            pCur = stamR3HashFindDesc(pUVM, pszPat);
             if (pCur)
                 rc = pfnCallback(pCur, pvArg);
         }
         else
         {
+#ifdef STAM_WITH_LOOKUP_TREE
             PSTAMDESC pLast;
             pCur = stamR3LookupFindPatternDescRange(pUVM->stam.s.pRoot, &pUVM->stam.s.List, pszPat, &pLast);
             if (pCur)
@@ -2550,19 +2982,18 @@ static int stamR3EnumU(PUVM pUVM, const char *pszPat, bool fUpdateRing0,
             }
             else
                 Assert(!pLast);
-
-        }
 #else
-        RTListForEach(&pUVM->stam.s.List, pCur, STAMDESC, ListEntry)
-        {
-            if (RTStrSimplePatternMatch(pszPat, pCur->pszName))
+            RTListForEach(&pUVM->stam.s.List, pCur, STAMDESC, ListEntry)
             {
-                rc = pfnCallback(pCur, pvArg);
-                if (rc)
-                    break;
+                if (RTStrSimplePatternMatch(pszPat, pCur->pszName))
+                {
+                    rc = pfnCallback(pCur, pvArg);
+                    if (rc)
+                        break;
+                }
             }
-        }
 #endif
+        }
         STAM_UNLOCK_RD(pUVM);
     }
 
@@ -43,6 +43,16 @@
 #include <iprt/time.h>
 
 
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** The largest poll window the global 2 halt method may be configured with,
+ * in nanoseconds.  Spinning longer than this is never worth it. */
+#define VM_HALT_GLOBAL2_POLL_MAX_LIMIT      UINT32_C(10000000)
+/** The largest grow and shrink factors of the global 2 halt method. */
+#define VM_HALT_GLOBAL2_POLL_FACTOR_LIMIT   UINT32_C(16)
+
+
 /*********************************************************************************************************************************
 *   Internal Functions                                                                                                           *
 *********************************************************************************************************************************/
@@ -286,6 +296,7 @@ static const char *vmR3GetHaltMethodName(VMHALTMETHOD enmMethod)
         case VMHALTMETHOD_1:            return "method1";
         //case VMHALTMETHOD_2:            return "method2";
         case VMHALTMETHOD_GLOBAL_1:     return "global1";
+        case VMHALTMETHOD_GLOBAL_2:     return "global2";
         default:                        return "unknown";
     }
 }
@@ -753,6 +764,159 @@ static DECLCALLBACK(int) vmR3HaltGlobal1Halt(PUVMCPU pUVCpu, const uint32_t fMas
 }
 
 
+/**
+ * Initialize the global 2 halt method.
+ *
+ * @return VBox status code.
+ * @param   pUVM            Pointer to the user mode VM structure.
+ */
+static DECLCALLBACK(int) vmR3HaltGlobal2Init(PUVM pUVM)
+{
+    int rc = vmR3HaltGlobal1Init(pUVM);
+    AssertRCReturn(rc, rc);
+
+    /*
+     * The defaults.
+     */
+    pUVM->vm.s.Halt.Global1.cNsPollMaxCfg   = 200000;
+    pUVM->vm.s.Halt.Global1.cNsPollStartCfg = 10000;
+    pUVM->vm.s.Halt.Global1.uPollGrowCfg    = 2;
+    pUVM->vm.s.Halt.Global1.uPollShrinkCfg  = 2;
+
+    /*
+     * Query overrides.
+     */
+    PCFGMNODE pCfg = CFGMR3GetChild(CFGMR3GetRoot(pUVM->pVM), "/VMM/HaltedGlobal2");
+    if (pCfg)
+    {
+        uint32_t u32;
+        if (RT_SUCCESS(CFGMR3QueryU32(pCfg, "SpinBlockThreshold", &u32)))
+            pUVM->vm.s.Halt.Global1.cNsSpinBlockThresholdCfg = u32;
+        if (RT_SUCCESS(CFGMR3QueryU32(pCfg, "PollMax", &u32)))
+        {
+            if (u32 > VM_HALT_GLOBAL2_POLL_MAX_LIMIT)
+                return VMSetError(pUVM->pVM, VERR_OUT_OF_RANGE, RT_SRC_POS,
+                                  N_("VMM/HaltedGlobal2/PollMax is out of range (%u, max %u ns)"),
+                                  u32, VM_HALT_GLOBAL2_POLL_MAX_LIMIT);
+            pUVM->vm.s.Halt.Global1.cNsPollMaxCfg = u32;
+        }
+        if (RT_SUCCESS(CFGMR3QueryU32(pCfg, "PollStart", &u32)))
+        {
+            if (u32 == 0 || u32 > VM_HALT_GLOBAL2_POLL_MAX_LIMIT)
+                return VMSetError(pUVM->pVM, VERR_OUT_OF_RANGE, RT_SRC_POS,
+                                  N_("VMM/HaltedGlobal2/PollStart is out of range (%u, 1..%u ns)"),
+                                  u32, VM_HALT_GLOBAL2_POLL_MAX_LIMIT);
+            pUVM->vm.s.Halt.Global1.cNsPollStartCfg = u32;
+        }
+        if (RT_SUCCESS(CFGMR3QueryU32(pCfg, "PollGrow", &u32)))
+        {
+            if (u32 < 2 || u32 > VM_HALT_GLOBAL2_POLL_FACTOR_LIMIT)
+                return VMSetError(pUVM->pVM, VERR_OUT_OF_RANGE, RT_SRC_POS,
+                                  N_("VMM/HaltedGlobal2/PollGrow is out of range (%u, 2..%u)"),
+                                  u32, VM_HALT_GLOBAL2_POLL_FACTOR_LIMIT);
+            pUVM->vm.s.Halt.Global1.uPollGrowCfg = u32;
+        }
+        if (RT_SUCCESS(CFGMR3QueryU32(pCfg, "PollShrink", &u32)))
+        {
+            if (u32 > VM_HALT_GLOBAL2_POLL_FACTOR_LIMIT)
+                return VMSetError(pUVM->pVM, VERR_OUT_OF_RANGE, RT_SRC_POS,
+                                  N_("VMM/HaltedGlobal2/PollShrink is out of range (%u, 0..%u)"),
+                                  u32, VM_HALT_GLOBAL2_POLL_FACTOR_LIMIT);
+            pUVM->vm.s.Halt.Global1.uPollShrinkCfg = u32;
+        }
+    }
+    if (pUVM->vm.s.Halt.Global1.cNsPollStartCfg > pUVM->vm.s.Halt.Global1.cNsPollMaxCfg)
+        pUVM->vm.s.Halt.Global1.cNsPollStartCfg = pUVM->vm.s.Halt.Global1.cNsPollMaxCfg;
+    LogRel(("VMEmt: HaltedGlobal2 config: cNsPollMaxCfg=%u cNsPollStartCfg=%u uPollGrowCfg=%u uPollShrinkCfg=%u\n",
+            pUVM->vm.s.Halt.Global1.cNsPollMaxCfg, pUVM->vm.s.Halt.Global1.cNsPollStartCfg,
+            pUVM->vm.s.Halt.Global1.uPollGrowCfg, pUVM->vm.s.Halt.Global1.uPollShrinkCfg));
+
+    for (VMCPUID idCpu = 0; idCpu < pUVM->cCpus; idCpu++)
+        pUVM->aCpus[idCpu].vm.s.cNsHaltPollWindow = 0;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * The global 2 halt method - Poll the force action flags for an adaptively
+ * sized window before blocking in GVMM like the global 1 method does.
+ *
+ * The window is grown when we end up blocking for less than the max window
+ * (i.e. a longer poll would've caught the event) and shrunk when we block for
+ * longer than that (polling is a waste of CPU cycles then), similar to what
+ * KVM does with halt_poll_ns.
+ */
+static DECLCALLBACK(int) vmR3HaltGlobal2Halt(PUVMCPU pUVCpu, const uint32_t fMask, uint64_t u64Now)
+{
+    PUVM     pUVM          = pUVCpu->pUVM;
+    PVMCPU   pVCpu         = pUVCpu->pVCpu;
+    PVM      pVM           = pUVCpu->pVM;
+    uint32_t cNsPollWindow = pUVCpu->vm.s.cNsHaltPollWindow;
+    uint32_t const cNsPollMax = pUVM->vm.s.Halt.Global1.cNsPollMaxCfg;
+    Assert(VMMGetCpu(pVM) == pVCpu);
+
+    /*
+     * Poll, without telling anyone that we're waiting so nobody will bother
+     * going to ring-0 to wake us up.  Don't poll past the next timer event.
+     */
+    if (cNsPollWindow)
+    {
+        uint64_t const u64StartPoll = RTTimeNanoTS();
+        uint64_t u64Delta;
+        TMTimerPollGIP(pVM, pVCpu, &u64Delta);
+        uint64_t const cNsPoll = RT_MIN(cNsPollWindow, u64Delta);
+        uint64_t       u64NowPoll;
+        for (;;)
+        {
+            if (    VM_FF_IS_PENDING(pVM, VM_FF_EXTERNAL_HALTED_MASK)
+                ||  VMCPU_FF_IS_PENDING(pVCpu, fMask))
+            {
+                u64NowPoll = RTTimeNanoTS();
+                STAM_REL_PROFILE_ADD_PERIOD(&pUVCpu->vm.s.StatHaltPollSpin, u64NowPoll - u64StartPoll);
+                STAM_REL_COUNTER_INC(&pUVCpu->vm.s.StatHaltPollHits);
+                return VINF_SUCCESS;
+            }
+            u64NowPoll = RTTimeNanoTS();
+            if (u64NowPoll - u64StartPoll >= cNsPoll)
+                break;
+            ASMNopPause();
+        }
+        STAM_REL_PROFILE_ADD_PERIOD(&pUVCpu->vm.s.StatHaltPollSpin, u64NowPoll - u64StartPoll);
+    }
+    STAM_REL_COUNTER_INC(&pUVCpu->vm.s.StatHaltPollMisses);
+
+    /*
+     * Block and adjust the window according to how long it took.
+     */
+    int rc = vmR3HaltGlobal1Halt(pUVCpu, fMask, u64Now);
+
+    uint64_t const cNsHalted = RTTimeNanoTS() - u64Now;
+    if (cNsHalted <= cNsPollMax)
+    {
+        if (cNsPollWindow < cNsPollMax)
+        {
+            uint32_t const uGrow = pUVM->vm.s.Halt.Global1.uPollGrowCfg;
+            if (!cNsPollWindow)
+                cNsPollWindow = pUVM->vm.s.Halt.Global1.cNsPollStartCfg;
+            else if (cNsPollWindow > cNsPollMax / uGrow)
+                cNsPollWindow = cNsPollMax;     /* Clamp before multiplying so it can't wrap. */
+            else
+                cNsPollWindow *= uGrow;
+            cNsPollWindow = RT_MIN(cNsPollWindow, cNsPollMax);
+        }
+    }
+    else if (cNsPollWindow)
+    {
+        uint32_t const uShrink = pUVM->vm.s.Halt.Global1.uPollShrinkCfg;
+        cNsPollWindow = uShrink ? cNsPollWindow / uShrink : 0;
+        if (cNsPollWindow < pUVM->vm.s.Halt.Global1.cNsPollStartCfg)
+            cNsPollWindow = 0;
+    }
+    pUVCpu->vm.s.cNsHaltPollWindow = cNsPollWindow;
+    return rc;
+}
+
+
 /**
  * The global 1 halt method - VMR3Wait() worker.
  *
@@ -990,6 +1154,7 @@ static const struct VMHALTMETHODDESC
     { VMHALTMETHOD_OLD,       NULL,                NULL,   vmR3HaltOldDoHalt,   vmR3DefaultWait,     vmR3DefaultNotifyCpuFF,     NULL },
     { VMHALTMETHOD_1,         vmR3HaltMethod1Init, NULL,   vmR3HaltMethod1Halt, vmR3DefaultWait,     vmR3DefaultNotifyCpuFF,     NULL },
     { VMHALTMETHOD_GLOBAL_1,  vmR3HaltGlobal1Init, NULL,   vmR3HaltGlobal1Halt, vmR3HaltGlobal1Wait, vmR3HaltGlobal1NotifyCpuFF, NULL },
+    { VMHALTMETHOD_GLOBAL_2,  vmR3HaltGlobal2Init, NULL,   vmR3HaltGlobal2Halt, vmR3HaltGlobal1Wait, vmR3HaltGlobal1NotifyCpuFF, NULL },
 };
 
 
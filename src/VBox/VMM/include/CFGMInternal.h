@@ -28,6 +28,11 @@
  */
 
 
+/** The number of children or values a node must have before we start
+ * maintaining a hash index for it. */
+#define CFGM_HASH_THRESHOLD         16
+
+
 /**
  * Configuration manager propertype value.
  */
@@ -71,6 +76,10 @@ typedef struct CFGMLEAF
     PCFGMLEAF       pNext;
     /** Pointer to the previous leaf. */
     PCFGMLEAF       pPrev;
+    /** Pointer to the next leaf in the same hash bucket. */
+    PCFGMLEAF       pHashNext;
+    /** The name hash. */
+    uint32_t        uHash;
 
     /** Property type. */
     CFGMVALUETYPE   enmType;
@@ -99,6 +108,23 @@ typedef struct CFGMNODE
     PCFGMNODE       pFirstChild;
     /** Pointer to first property leaf. */
     PCFGMLEAF       pFirstLeaf;
+    /** Pointer to the next node in the same hash bucket of the parent. */
+    PCFGMNODE       pHashNext;
+
+    /** Child node hash table, NULL if not indexed (see CFGM_HASH_THRESHOLD). */
+    PCFGMNODE      *papChildHash;
+    /** Property leaf hash table, NULL if not indexed. */
+    PCFGMLEAF      *papLeafHash;
+    /** Number of buckets in papChildHash (power of two). */
+    uint32_t        cChildHash;
+    /** Number of buckets in papLeafHash (power of two). */
+    uint32_t        cLeafHash;
+    /** Number of child nodes. */
+    uint32_t        cChildren;
+    /** Number of property leaves. */
+    uint32_t        cLeaves;
+    /** The name hash. */
+    uint32_t        uHash;
 
     /** Pointer to the VM owning this node. */
     PVM             pVM;
@@ -26,6 +26,7 @@
 #include <iprt/avl.h>
 #include <iprt/dbg.h>
 #include <VBox/vmm/dbgf.h>
+#include <VBox/vmm/dbgftrace.h>
 
 
 
@@ -254,6 +255,39 @@ typedef DBGF *PDBGF;
 /** Converts a DBGFCPU pointer into a VM pointer. */
 #define DBGFCPU_2_VM(pDbgfCpu) ((PVM)((uint8_t *)(pDbgfCpu) + (pDbgfCpu)->offVM))
 
+/**
+ * Per virtual CPU binary trace ring (hyper heap).
+ *
+ * Single producer (the owning EMT, any context), single consumer (the ring-3
+ * trace streaming thread or the info handler).  The producer never waits, if
+ * the consumer falls behind the oldest entries are overwritten and the
+ * consumer accounts them as lost.
+ */
+typedef struct DBGFTRACERING
+{
+    /** The number of entries, power of two. */
+    uint32_t                cEntries;
+    /** The ID of the owning virtual CPU. */
+    uint32_t                idCpu;
+    /** The producer index (free running), only written by the owner. */
+    uint64_t volatile       idxHead;
+    /** Keep the consumer index in a different cache line. */
+    uint8_t                 abPadding0[48];
+    /** The consumer index (free running), only used in ring-3. */
+    uint64_t                idxTail;
+    /** The number of entries the consumer lost to overruns. */
+    uint64_t                cLost;
+    /** Align the entries on a cache line. */
+    uint8_t                 abPadding1[48];
+    /** The entries (variable size). */
+    DBGFTRACEENTRY          aEntries[1];
+} DBGFTRACERING;
+AssertCompileMemberAlignment(DBGFTRACERING, idxTail, 64);
+AssertCompileMemberAlignment(DBGFTRACERING, aEntries, 64);
+/** Pointer to a binary trace ring. */
+typedef DBGFTRACERING *PDBGFTRACERING;
+
+
 /**
  * The per CPU data for DBGF.
  */
@@ -275,6 +309,15 @@ typedef struct DBGFCPU
 
     /** Padding the structure to 16 bytes. */
     bool                    afReserved[7];
+
+    /** The binary trace ring of this CPU - R3 Ptr. NULL if not enabled. */
+    R3PTRTYPE(PDBGFTRACERING) pTraceRingR3;
+    /** The binary trace ring of this CPU - R0 Ptr. */
+    R0PTRTYPE(PDBGFTRACERING) pTraceRingR0;
+    /** The binary trace ring of this CPU - RC Ptr. */
+    RCPTRTYPE(PDBGFTRACERING) pTraceRingRC;
+    /** Alignment padding. */
+    uint32_t                u32Padding;
 } DBGFCPU;
 /** Pointer to DBGFCPU data. */
 typedef DBGFCPU *PDBGFCPU;
@@ -330,6 +373,23 @@ typedef struct DBGFUSERPERVM
     /** List of registered info handlers. */
     R3PTRTYPE(PDBGFINFO)        pInfoFirst;
 
+    /** @name Binary trace ring streaming.
+     * @{ */
+    /** The streaming thread, NIL_RTTHREAD if not streaming. */
+    RTTHREAD                    hTraceThread;
+    /** Event the streaming thread waits on. */
+    RTSEMEVENT                  hTraceEvt;
+    /** The output file. */
+    RTFILE                      hTraceFile;
+    /** Set when the streaming thread should terminate. */
+    bool volatile               fTraceShutdown;
+    /** Set when writing failed, the thread stops writing (but keeps draining). */
+    bool                        fTraceWriteError;
+    /** Alignment padding. */
+    bool                        afAlignment3[6];
+    /** Number of bytes written to the output file. */
+    uint64_t                    cbTraceWritten;
+    /** @} */
 } DBGFUSERPERVM;
 typedef DBGFUSERPERVM *PDBGFUSERPERVM;
 typedef DBGFUSERPERVM const *PCDBGFUSERPERVM;
@@ -365,7 +425,14 @@ void dbgfR3PlugInTerm(PUVM pUVM);
 
 
 #ifdef IN_RING3
-
+/** The uncompressed size of a gzip member of a compressed core dump. */
+# define DBGFCORE_ZIP_BLOCK_SIZE    _1M
+/** Parallel gzip compressor for core dumps (opaque). */
+typedef struct DBGFCOREZIP *PDBGFCOREZIP;
+int  dbgfR3CoreZipCreate(PDBGFCOREZIP *ppZip, PFNDBGFCOREWRITE pfnOutput, void *pvUser);
+int  dbgfR3CoreZipWrite(PDBGFCOREZIP pZip, const void *pvBuf, size_t cbBuf, bool fZero);
+int  dbgfR3CoreZipFlush(PDBGFCOREZIP pZip);
+void dbgfR3CoreZipDestroy(PDBGFCOREZIP pZip);
 #endif
 
 /** @} */
@@ -230,6 +230,62 @@ typedef IEMVERIFYEVTREC *PIEMVERIFYEVTREC;
 #endif /* IEM_VERIFICATION_MODE_FULL */
 
 
+/** @name IEM TLB sizing.
+ * @{ */
+/** Number of entries in each of the IEM TLBs (power of two). */
+#define IEMTLB_ENTRIES                  64
+/** The revision increment, i.e. where the revision starts in the tag.
+ * Guest virtual page numbers are at most 52 bits wide. */
+#define IEMTLB_REVISION_INCR            RT_BIT_64(52)
+/** Calculates the TLB tag for a virtual address and the current revision. */
+#define IEMTLB_CALC_TAG(a_pTlb, a_GCPtr) \
+    ( ((uint64_t)(a_GCPtr) >> X86_PAGE_4K_SHIFT) | (a_pTlb)->uTlbRevision )
+/** Converts a TLB tag value into a TLB entry pointer. */
+#define IEMTLB_TAG_TO_ENTRY(a_pTlb, a_uTag) \
+    ( &(a_pTlb)->aEntries[(a_uTag) & (IEMTLB_ENTRIES - 1)] )
+/** @} */
+
+/**
+ * An IEM TLB entry.
+ *
+ * Caches the result of a PGMGstGetPage walk for one guest virtual page.
+ */
+typedef struct IEMTLBENTRY
+{
+    /** The TLB entry tag: the virtual page number ORed with the revision that
+     * was current when the entry was loaded.  Zero if never loaded. */
+    uint64_t                uTag;
+    /** The X86_PTE_XXX flags returned by PGMGstGetPage (effective). */
+    uint64_t                fFlags;
+    /** The guest physical address of the page. */
+    RTGCPHYS                GCPhys;
+} IEMTLBENTRY;
+AssertCompileSize(IEMTLBENTRY, 24);
+/** Pointer to an IEM TLB entry. */
+typedef IEMTLBENTRY *PIEMTLBENTRY;
+
+/**
+ * An IEM TLB (guest virtual to guest physical translations).
+ *
+ * The entries are direct mapped and tagged with a revision, so invalidating
+ * everything is just a matter of bumping uTlbRevision.
+ */
+typedef struct IEMTLB
+{
+    /** The TLB entries. */
+    IEMTLBENTRY             aEntries[IEMTLB_ENTRIES];
+    /** The current TLB revision (multiple of IEMTLB_REVISION_INCR). */
+    uint64_t                uTlbRevision;
+    /** Number of lookups satisfied by the TLB. */
+    uint32_t                cTlbHits;
+    /** Number of lookups which required a page table walk. */
+    uint32_t                cTlbMisses;
+} IEMTLB;
+AssertCompileSizeAlignment(IEMTLB, 8);
+/** Pointer to an IEM TLB. */
+typedef IEMTLB *PIEMTLB;
+
+
 /**
  * The per-CPU IEM state.
  */
@@ -440,6 +496,16 @@ typedef struct IEMCPU
     CPUMCPUVENDOR           enmHostCpuVendor;
     /** @} */
 
+    /** @name Translation lookaside buffers.
+     * These are invalidated by PGM on CR3 loads, INVLPG and paging mode changes,
+     * and by HM before executing guest code natively.
+     * @{ */
+    /** The code TLB (opcode fetching). */
+    IEMTLB                  CodeTlb;
+    /** The data TLB (iemMemMap and friends). */
+    IEMTLB                  DataTlb;
+    /** @} */
+
 #ifdef IEM_VERIFICATION_MODE_FULL
     /** The event verification records for what IEM did (LIFO). */
     R3PTRTYPE(PIEMVERIFYEVTREC)     pIemEvtRecHead;
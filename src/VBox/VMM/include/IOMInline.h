@@ -35,6 +35,13 @@
 DECLINLINE(CTX_SUFF(PIOMIOPORTRANGE)) iomIOPortGetRange(PVM pVM, RTIOPORT Port)
 {
     Assert(IOM_IS_SHARED_LOCK_OWNER(pVM));
+    PIOMIOPORTLOOKUP pLookup = pVM->iom.s.CTX_SUFF(pIOPortLookup);
+    if (RT_LIKELY(pLookup->fValid))
+    {
+        uint16_t const iPage = pLookup->aiPages[Port >> IOM_IOPORT_LOOKUP_PAGE_SHIFT];
+        uint16_t const iSlot = pLookup->aPages[iPage].aiSlots[Port & (IOM_IOPORT_LOOKUP_PAGE_PORTS - 1)];
+        return pLookup->aSlots[iSlot].CTX_SUFF(pRange);
+    }
     return (CTX_SUFF(PIOMIOPORTRANGE))RTAvlroIOPortRangeGet(&pVM->iom.s.CTX_SUFF(pTrees)->CTX_SUFF(IOPortTree), Port);
 }
 
@@ -51,10 +58,31 @@ DECLINLINE(CTX_SUFF(PIOMIOPORTRANGE)) iomIOPortGetRange(PVM pVM, RTIOPORT Port)
 DECLINLINE(PIOMIOPORTRANGER3) iomIOPortGetRangeR3(PVM pVM, RTIOPORT Port)
 {
     Assert(IOM_IS_SHARED_LOCK_OWNER(pVM));
+    PIOMIOPORTLOOKUP pLookup = pVM->iom.s.CTX_SUFF(pIOPortLookup);
+    if (RT_LIKELY(pLookup->fValid))
+    {
+        uint16_t const iPage = pLookup->aiPages[Port >> IOM_IOPORT_LOOKUP_PAGE_SHIFT];
+        uint16_t const iSlot = pLookup->aPages[iPage].aiSlots[Port & (IOM_IOPORT_LOOKUP_PAGE_PORTS - 1)];
+        return (PIOMIOPORTRANGER3)pLookup->aSlots[iSlot].pRangeR3; /* only good for NULL checks outside ring-3 */
+    }
     return (PIOMIOPORTRANGER3)RTAvlroIOPortRangeGet(&pVM->iom.s.CTX_SUFF(pTrees)->IOPortTreeR3, Port);
 }
 
 
+/**
+ * Counts an access to the specified I/O port if /IOM/PortCounters is enabled.
+ *
+ * @param   pVM     The cross context VM structure.
+ * @param   Port    The I/O port being accessed.
+ */
+DECLINLINE(void) iomIOPortCountAccess(PVM pVM, RTIOPORT Port)
+{
+    uint32_t volatile *pau32Counters = pVM->iom.s.CTX_SUFF(pau32PortCounters);
+    if (pau32Counters)
+        ASMAtomicIncU32(&pau32Counters[Port]);
+}
+
+
 /**
  * Gets the MMIO range for the specified physical address in the current context.
  *
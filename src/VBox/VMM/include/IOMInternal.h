@@ -270,6 +270,81 @@ AssertCompileMemberAlignment(IOMIOPORTSTATS, InR3, 8);
 typedef IOMIOPORTSTATS *PIOMIOPORTSTATS;
 
 
+/** @name I/O port lookup table geometry.
+ * @{ */
+/** The shift for getting the lookup page of an I/O port. */
+#define IOM_IOPORT_LOOKUP_PAGE_SHIFT    8
+/** The number of I/O ports covered by a lookup page. */
+#define IOM_IOPORT_LOOKUP_PAGE_PORTS    RT_BIT_32(IOM_IOPORT_LOOKUP_PAGE_SHIFT)
+/** The number of entries in the top level of the lookup table. */
+#define IOM_IOPORT_LOOKUP_TOP_ENTRIES   (_64K >> IOM_IOPORT_LOOKUP_PAGE_SHIFT)
+/** The max number of lookup pages, including the shared empty page 0. */
+#define IOM_IOPORT_LOOKUP_MAX_PAGES     32
+/** The max number of lookup slots, including the empty slot 0. */
+#define IOM_IOPORT_LOOKUP_MAX_SLOTS     256
+/** @} */
+
+/**
+ * I/O port lookup slot.
+ *
+ * Holds the ranges covering a run of I/O ports in each of the contexts.  Ports
+ * sharing the same set of ranges share the same slot.
+ */
+typedef struct IOMIOPORTLOOKUPSLOT
+{
+    /** The ring-3 range, NULL if none. */
+    R3PTRTYPE(PIOMIOPORTRANGER3)    pRangeR3;
+    /** The ring-0 range, NIL_RTR0PTR if none. */
+    R0PTRTYPE(PIOMIOPORTRANGER0)    pRangeR0;
+    /** The raw-mode range, NIL_RTRCPTR if none. */
+    RCPTRTYPE(PIOMIOPORTRANGERC)    pRangeRC;
+    /** Explicit alignment padding. */
+    uint32_t                        u32Padding;
+} IOMIOPORTLOOKUPSLOT;
+/** Pointer to an I/O port lookup slot. */
+typedef IOMIOPORTLOOKUPSLOT *PIOMIOPORTLOOKUPSLOT;
+
+/**
+ * Direct indexed I/O port lookup table.
+ *
+ * A two level table that maps any I/O port to its lookup slot in O(1) for all
+ * contexts, saving the AVL tree walks in IOMIOPortRead and friends.  Pages
+ * without any registered ports all point to the empty page 0, and ports
+ * without any ranges point to the empty slot 0.
+ *
+ * When ranges are registered or deregistered, iomR3IOPortLookupUpdate redoes
+ * the affected ports only, while holding the IOM lock exclusively.  Slots of
+ * removed ranges are reclaimed by a full iomR3IOPortLookupRebuild, which is
+ * done when running out of slots or pages and on relocation.  Should even that
+ * run out, fValid is cleared and lookups fall back on the trees.
+ */
+typedef struct IOMIOPORTLOOKUP
+{
+    /** Set if the table is in sync with the trees. */
+    bool volatile                   fValid;
+    /** Explicit alignment padding. */
+    bool                            afPadding[1];
+    /** The number of lookup pages in use. */
+    uint16_t                        cPages;
+    /** The number of lookup slots in use. */
+    uint16_t                        cSlots;
+    /** Explicit alignment padding. */
+    uint16_t                        u16Padding;
+    /** The lookup page index for each I/O port page (Port >> 8). */
+    uint16_t                        aiPages[IOM_IOPORT_LOOKUP_TOP_ENTRIES];
+    /** The lookup pages, giving the slot index for each port in the page. */
+    struct
+    {
+        uint16_t                    aiSlots[IOM_IOPORT_LOOKUP_PAGE_PORTS];
+    }                               aPages[IOM_IOPORT_LOOKUP_MAX_PAGES];
+    /** The lookup slots. */
+    IOMIOPORTLOOKUPSLOT             aSlots[IOM_IOPORT_LOOKUP_MAX_SLOTS];
+} IOMIOPORTLOOKUP;
+AssertCompileMemberAlignment(IOMIOPORTLOOKUP, aSlots, 8);
+/** Pointer to the I/O port lookup table. */
+typedef IOMIOPORTLOOKUP *PIOMIOPORTLOOKUP;
+
+
 /**
  * The IOM trees.
  * These are offset based the nodes and root must be in the same
@@ -297,6 +372,48 @@ typedef struct IOMTREES
 typedef IOMTREES *PIOMTREES;
 
 
+/** The number of entries in the per VCPU MMIO instruction decode cache. */
+#define IOM_MMIO_DECODE_CACHE_ENTRIES   4
+
+/**
+ * MMIO instruction decode cache entry.
+ *
+ * Remembers enough about a MOV, MOVZX or MOVSX instruction that accessed an
+ * MMIO range to emulate it again without decoding it.  Hits are validated
+ * against the current instruction bytes and CPU mode.
+ */
+typedef struct IOMMMIODECODEENTRY
+{
+    /** The flat address of the instruction. */
+    RTGCUINTPTR64               GCPtrInstr;
+    /** The start address of the MMIO range it accessed. */
+    RTGCPHYS                    GCPhysRange;
+    /** The DISUSE_XXX flags of the register or immediate operand. */
+    uint64_t                    fRegUse;
+    /** The immediate value, if fRegUse says it's an immediate. */
+    uint64_t                    uImmValue;
+    /** The instruction bytes. */
+    uint8_t                     abInstr[15];
+    /** The instruction length, 0 if the entry is free. */
+    uint8_t                     cbInstr;
+    /** The instruction (OP_MOV, OP_MOVZX or OP_MOVSX). */
+    uint16_t                    uOpcode;
+    /** The CPU mode (DISCPUMODE) the instruction was decoded in. */
+    uint8_t                     enmCpuMode;
+    /** Set if it writes to MMIO, clear if it reads. */
+    bool                        fWrite;
+    /** The size of the MMIO read (writes take it from the operand). */
+    uint8_t                     cbRead;
+    /** The general register index (DISGREG_XXX) of the register operand. */
+    uint8_t                     idxGenReg;
+    /** Explicit alignment padding. */
+    uint8_t                     abPadding[2];
+} IOMMMIODECODEENTRY;
+AssertCompileSize(IOMMMIODECODEENTRY, 56);
+/** Pointer to a MMIO instruction decode cache entry. */
+typedef IOMMMIODECODEENTRY *PIOMMMIODECODEENTRY;
+
+
 /**
  * Converts an IOM pointer into a VM pointer.
  * @returns Pointer to the VM structure the PGM is part of.
@@ -319,6 +436,21 @@ typedef struct IOM
     /** Pointer to the trees - R0 ptr. */
     R0PTRTYPE(PIOMTREES)            pTreesR0;
 
+    /** Pointer to the I/O port lookup table - R3 ptr. */
+    R3PTRTYPE(PIOMIOPORTLOOKUP)     pIOPortLookupR3;
+    /** Pointer to the I/O port lookup table - R0 ptr. */
+    R0PTRTYPE(PIOMIOPORTLOOKUP)     pIOPortLookupR0;
+    /** Pointer to the I/O port lookup table - RC ptr. */
+    RCPTRTYPE(PIOMIOPORTLOOKUP)     pIOPortLookupRC;
+
+    /** Pointer to the per I/O port access counters (64K entries) - RC ptr.
+     * NIL unless enabled via /IOM/PortCounters. */
+    RCPTRTYPE(uint32_t volatile *)  pau32PortCountersRC;
+    /** Pointer to the per I/O port access counters - R3 ptr. */
+    R3PTRTYPE(uint32_t volatile *)  pau32PortCountersR3;
+    /** Pointer to the per I/O port access counters - R0 ptr. */
+    R0PTRTYPE(uint32_t volatile *)  pau32PortCountersR0;
+
     /** MMIO physical access handler type.   */
     PGMPHYSHANDLERTYPE              hMmioHandlerType;
     uint32_t                        u32Padding;
@@ -368,6 +500,11 @@ typedef struct IOM
 
     STAMCOUNTER                     StatR3MMIOHandler;
 
+    /** Number of MMIO instructions emulated from the decode cache. */
+    STAMCOUNTER                     StatMmioDecodeCacheHits;
+    /** Number of MMIO instructions not found in the decode cache. */
+    STAMCOUNTER                     StatMmioDecodeCacheMisses;
+
     RTUINT                          cMovsMaxBytes;
     RTUINT                          cStosMaxBytes;
     /** @} */
@@ -385,30 +522,38 @@ typedef struct IOMCPU
      * on the stack. */
     DISCPUSTATE                     DisState;
 
-    /** @name Caching of I/O Port and MMIO ranges and statistics.
-     * (Saves quite some time in rep outs/ins instruction emulation.)
+    /** @name Caching of MMIO ranges and I/O Port and MMIO statistics.
+     * (Saves quite some time in rep outs/ins instruction emulation.  The I/O
+     * port ranges are looked up in the IOMIOPORTLOOKUP table instead.)
      * @{ */
-    R3PTRTYPE(PIOMIOPORTRANGER3)    pRangeLastReadR3;
-    R3PTRTYPE(PIOMIOPORTRANGER3)    pRangeLastWriteR3;
     R3PTRTYPE(PIOMIOPORTSTATS)      pStatsLastReadR3;
     R3PTRTYPE(PIOMIOPORTSTATS)      pStatsLastWriteR3;
     R3PTRTYPE(PIOMMMIORANGE)        pMMIORangeLastR3;
     R3PTRTYPE(PIOMMMIOSTATS)        pMMIOStatsLastR3;
 
-    R0PTRTYPE(PIOMIOPORTRANGER0)    pRangeLastReadR0;
-    R0PTRTYPE(PIOMIOPORTRANGER0)    pRangeLastWriteR0;
     R0PTRTYPE(PIOMIOPORTSTATS)      pStatsLastReadR0;
     R0PTRTYPE(PIOMIOPORTSTATS)      pStatsLastWriteR0;
     R0PTRTYPE(PIOMMMIORANGE)        pMMIORangeLastR0;
     R0PTRTYPE(PIOMMMIOSTATS)        pMMIOStatsLastR0;
 
-    RCPTRTYPE(PIOMIOPORTRANGERC)    pRangeLastReadRC;
-    RCPTRTYPE(PIOMIOPORTRANGERC)    pRangeLastWriteRC;
     RCPTRTYPE(PIOMIOPORTSTATS)      pStatsLastReadRC;
     RCPTRTYPE(PIOMIOPORTSTATS)      pStatsLastWriteRC;
     RCPTRTYPE(PIOMMMIORANGE)        pMMIORangeLastRC;
     RCPTRTYPE(PIOMMMIOSTATS)        pMMIOStatsLastRC;
     /** @} */
+
+    /** @name MMIO instruction decode cache.
+     * @{ */
+    /** The entries, searched fully associatively. */
+    IOMMMIODECODEENTRY              aMmioDecodeCache[IOM_MMIO_DECODE_CACHE_ENTRIES];
+    /** The flat address of the last instruction which missed the cache.  Used
+     * by the IEM path to only spend a disassembly on repeat offenders. */
+    RTGCUINTPTR64                   GCPtrMmioDecodeLastMiss;
+    /** The next entry to replace (round robin). */
+    uint8_t                         iMmioDecodeNext;
+    /** Explicit alignment padding. */
+    uint8_t                         abPadding[7];
+    /** @} */
 } IOMCPU;
 /** Pointer to IOM per virtual CPU instance data. */
 typedef IOMCPU *PIOMCPU;
@@ -419,6 +564,8 @@ RT_C_DECLS_BEGIN
 void                iomMmioFreeRange(PVM pVM, PIOMMMIORANGE pRange);
 #ifdef IN_RING3
 PIOMMMIOSTATS       iomR3MMIOStatsCreate(PVM pVM, RTGCPHYS GCPhys, const char *pszDesc);
+void                iomR3IOPortLookupRebuild(PVM pVM);
+void                iomR3IOPortLookupUpdate(PVM pVM, RTIOPORT PortFirst, RTIOPORT PortLast);
 #endif /* IN_RING3 */
 
 #ifndef IN_RING3
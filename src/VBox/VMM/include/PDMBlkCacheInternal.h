@@ -98,6 +98,10 @@ typedef struct PDMBLKLRULIST
 
 /**
  * Global cache data.
+ *
+ * The replacement state itself lives in the per endpoint data (see
+ * PDMBLKCACHE), each endpoint being a shard of the cache with its own lock.
+ * The global data only tracks the overall budget and the commit state.
  */
 typedef struct PDMBLKCACHEGLOBAL
 {
@@ -105,20 +109,16 @@ typedef struct PDMBLKCACHEGLOBAL
     PVM                 pVM;
     /** Maximum size of the cache in bytes. */
     uint32_t            cbMax;
-    /** Current size of the cache in bytes. */
-    uint32_t            cbCached;
-    /** Critical section protecting the cache. */
+    /** Current size of the cache in bytes (sum of all endpoints, updated atomically). */
+    volatile uint32_t   cbCached;
+    /** Critical section protecting the user list and the global state. */
     RTCRITSECT          CritSect;
-    /** Maximum number of bytes cached. */
-    uint32_t            cbRecentlyUsedInMax;
-    /** Maximum number of bytes in the paged out list .*/
-    uint32_t            cbRecentlyUsedOutMax;
-    /** Recently used cache entries list */
-    PDMBLKLRULIST       LruRecentlyUsedIn;
-    /** Scorecard cache entry list. */
-    PDMBLKLRULIST       LruRecentlyUsedOut;
-    /** List of frequently used cache entries */
-    PDMBLKLRULIST       LruFrequentlyUsed;
+    /** Default minimum number of bytes guaranteed for an endpoint, 0 for a fair share. */
+    uint32_t            cbEndpointMin;
+    /** Default maximum number of bytes an endpoint can occupy. */
+    uint32_t            cbEndpointMax;
+    /** Number of sequential bytes after which an endpoint is considered to be scanning, 0 to disable. */
+    uint32_t            cbScanThreshold;
     /** Commit timeout in milli seconds */
     uint32_t            u32CommitTimeoutMs;
     /** Number of dirty bytes needed to start a commit of the data to the disk. */
@@ -154,6 +154,8 @@ typedef struct PDMBLKCACHEGLOBAL
     STAMPROFILEADV      StatTreeRemove;
     /** Number of times a buffer could be reused. */
     STAMCOUNTER         StatBuffersReused;
+    /** Number of bytes an endpoint below its minimum reclaimed from other endpoints. */
+    STAMCOUNTER         StatBytesStolen;
 #endif
 } PDMBLKCACHEGLOBAL;
 #ifdef VBOX_WITH_STATISTICS
@@ -192,6 +194,30 @@ typedef struct PDMBLKCACHE
     RTSPINLOCK                    LockList;
     /** List of dirty but not committed entries for this endpoint. */
     RTLISTANCHOR                  ListDirtyNotCommitted;
+    /** Critical section protecting the LRU lists of this endpoint. */
+    RTCRITSECT                    CritSect;
+    /** Minimum number of bytes guaranteed for this endpoint. */
+    volatile uint32_t             cbMin;
+    /** Maximum number of bytes this endpoint can occupy (ARC cache size c). */
+    uint32_t                      cbMax;
+    /** Number of bytes currently cached for this endpoint (T1 + T2). */
+    volatile uint32_t             cbCached;
+    /** Adaptive target size of the recently used list (ARC p). */
+    uint32_t                      cbRecentlyUsedInTarget;
+    /** Flag whether the minimum was configured explicitly instead of a fair share. */
+    bool                          fMinFixed;
+    /** Recently used cache entries list (ARC T1). */
+    PDMBLKLRULIST                 LruRecentlyUsedIn;
+    /** Recently used but evicted entries, ghost list (ARC B1). */
+    PDMBLKLRULIST                 LruRecentlyUsedOut;
+    /** List of frequently used cache entries (ARC T2). */
+    PDMBLKLRULIST                 LruFrequentlyUsed;
+    /** Frequently used but evicted entries, ghost list (ARC B2). */
+    PDMBLKLRULIST                 LruFrequentlyUsedOut;
+    /** End offset of the last access, used for scan detection. */
+    volatile uint64_t             offSeqNext;
+    /** Number of bytes accessed sequentially so far. */
+    volatile uint64_t             cbSeqRun;
     /** Node of the cache user list. */
     RTLISTNODE                    NodeCacheUser;
     /** Block cache type. */
@@ -258,6 +284,18 @@ typedef struct PDMBLKCACHE
     STAMCOUNTER                   StatWriteDeferred;
     /** Number appended cache entries. */
     STAMCOUNTER                   StatAppendedWrites;
+    /** Hit counter. */
+    STAMCOUNTER                   StatHits;
+    /** Partial hit counter. */
+    STAMCOUNTER                   StatPartialHits;
+    /** Miss counter. */
+    STAMCOUNTER                   StatMisses;
+    /** Number of bytes evicted from this endpoint. */
+    STAMCOUNTER                   StatEvicted;
+    /** Number of hits in the ghost lists. */
+    STAMCOUNTER                   StatGhostHits;
+    /** Number of bytes passed through because a sequential scan was detected. */
+    STAMCOUNTER                   StatScanBypassed;
 #endif
 
     /** Flag whether the cache was suspended. */
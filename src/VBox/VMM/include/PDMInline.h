@@ -34,3 +34,67 @@ DECLINLINE(uint32_t) pdmCalcIrqTag(PVM pVM, uint32_t idTracer)
     return uTag;
 }
 
+
+
+/**
+ * Checks whether the owner of a critical section is likely to be running.
+ *
+ * We can only tell for EMTs; other threads are assumed to be running and it's
+ * left to the spin budget to cut the spinning short when they're not.
+ *
+ * @returns false if the owner is known to be halted or blocked, true otherwise.
+ * @param   pVM                 The cross context VM structure.
+ * @param   hOwner              The native (ring-3) handle of the owner thread.
+ */
+DECLINLINE(bool) pdmCritSectIsOwnerRunning(PVM pVM, RTNATIVETHREAD hOwner)
+{
+    if (hOwner == NIL_RTNATIVETHREAD)
+        return true; /* between owners */
+    for (VMCPUID idCpu = 0; idCpu < pVM->cCpus; idCpu++)
+    {
+        PVMCPU pVCpu = &pVM->aCpus[idCpu];
+        if (pVCpu->hNativeThread == hOwner)
+            return VMCPU_GET_STATE(pVCpu) != VMCPUSTATE_STARTED_HALTED
+                && !pVCpu->pdm.s.fBlockedOnCritSect;
+    }
+    return true;
+}
+
+
+/**
+ * Calculates the adaptive spin budget for a critical section.
+ *
+ * @returns Max number of TSC ticks to spin.
+ * @param   cTicksSpin          The section's running average of successful spins.
+ * @param   cTicksMax           The upper limit for the current context.
+ */
+DECLINLINE(uint64_t) pdmCritSectSpinBudget(uint32_t cTicksSpin, uint32_t cTicksMax)
+{
+    uint64_t cTicks = (uint64_t)cTicksSpin * 2 + PDMCRITSECT_SPIN_TICKS_MIN;
+    return RT_MIN(cTicks, cTicksMax);
+}
+
+
+/**
+ * Updates the adaptive spinning average after a spin.
+ *
+ * A successful spin moves the average 1/8th of the way towards the time it
+ * took.  A spin that ran out of budget means the section is typically held for
+ * longer than it pays to spin, so the average is cut by a quarter, and we'll
+ * end up spinning only briefly when the hold times are long.
+ *
+ * @param   pcTicksSpin         The section's running average.
+ * @param   cTicks              The number of ticks spent spinning.
+ * @param   fSuccess            Whether the section became available.
+ */
+DECLINLINE(void) pdmCritSectSpinUpdate(uint32_t volatile *pcTicksSpin, uint64_t cTicks, bool fSuccess)
+{
+    int64_t cTicksOld = *pcTicksSpin;
+    int64_t cTicksNew;
+    if (fSuccess)
+        cTicksNew = cTicksOld + ((int64_t)RT_MIN(cTicks, UINT32_MAX / 2) - cTicksOld) / 8;
+    else
+        cTicksNew = cTicksOld - cTicksOld / 4;
+    ASMAtomicWriteU32(pcTicksSpin, (uint32_t)cTicksNew); /* racy, but it's just a hint */
+}
+
@@ -163,8 +163,8 @@ typedef struct PDMDEVINSINT
     uint32_t                        fIntFlags;
     /** The last IRQ tag (for tracing it thru clearing). */
     uint32_t                        uLastIrqTag;
-    /** Size padding. */
-    uint32_t                        u32Padding;
+    /** Microseconds spent in the constructor (startup profile). */
+    uint32_t                        cUsConstruct;
 } PDMDEVINSINT;
 
 /** @name PDMDEVINSINT::fIntFlags
@@ -298,13 +298,19 @@ typedef struct PDMCRITSECTINT
     /** Set if the critical section is used by a timer or similar.
      * See PDMR3DevGetCritSect.  */
     bool                            fUsedByTimerOrSimilar;
-    /** Alignment padding. */
-    bool                            afPadding[2];
+    /** Contention profiler record index (1-based), 0 if not profiled.
+     * See PDMCRITSECTPROF. */
+    uint16_t volatile               idxProf;
     /** Support driver event semaphore that is scheduled to be signaled upon leaving
      * the critical section. This is only for Ring-3 and Ring-0. */
     SUPSEMEVENT                     hEventToSignal;
     /** The lock name. */
     R3PTRTYPE(const char *)         pszName;
+    /** Adaptive spinning: Running average of how long (TSC ticks) it took
+     * successful spinners to get the section.  See pdmCritSectSpinBudget. */
+    uint32_t volatile               cTicksSpin;
+    /** Alignment padding. */
+    uint32_t                        u32Padding;
     /** R0/RC lock contention. */
     STAMCOUNTER                     StatContentionRZLock;
     /** R0/RC unlock contention. */
@@ -322,6 +328,19 @@ typedef PDMCRITSECTINT *PPDMCRITSECTINT;
  * PDMCritSectIsOwner and PDMCritSectIsOwned optimizations. */
 #define PDMCRITSECT_FLAGS_PENDING_UNLOCK    RT_BIT_32(17)
 
+/** @name Adaptive spinning limits (TSC ticks).
+ * @{ */
+/** The least we'll spin on a section owned by a running thread. */
+#define PDMCRITSECT_SPIN_TICKS_MIN          1024
+/** The most we'll spin in ring-3 before blocking; roughly what a block and
+ * wake-up round trip costs. */
+#define PDMCRITSECT_SPIN_TICKS_MAX_R3       32768
+/** The most we'll spin in ring-0 before blocking or going to ring-3. */
+#define PDMCRITSECT_SPIN_TICKS_MAX_R0       65536
+/** The most we'll spin in raw-mode context before going to ring-3. */
+#define PDMCRITSECT_SPIN_TICKS_MAX_RC       65536
+/** @} */
+
 
 /**
  * Private critical section data.
@@ -345,9 +364,15 @@ typedef struct PDMCRITSECTRWINT
     PVMR0                               pVMR0;
     /** Pointer to the VM - GCPtr. */
     PVMRC                               pVMRC;
+    /** Contention profiler record index (1-based), 0 if not profiled.
+     * See PDMCRITSECTPROF. */
+    uint32_t volatile                   idxProf;
+    /** Adaptive spinning: Running average of how long (TSC ticks) it took
+     * successful spinners to see the section become available. */
+    uint32_t volatile                   cTicksSpin;
 #if HC_ARCH_BITS == 64
     /** Alignment padding. */
-    RTRCPTR                             RCPtrPadding;
+    uint32_t                            u32Padding;
 #endif
     /** The lock name. */
     R3PTRTYPE(const char *)             pszName;
@@ -380,6 +405,89 @@ AssertCompileMemberAlignment(PDMCRITSECTRWINT, Core.u64State, 8);
 typedef PDMCRITSECTRWINT *PPDMCRITSECTRWINT;
 
 
+/** Number of histogram buckets in a critical section profiler record.
+ * Bucket N counts samples of [4^N, 4^(N+1)) TSC ticks, the last one is open. */
+#define PDMCRITSECTPROF_HIST_BUCKETS        16
+/** Number of contending call sites tracked by a profiler record. */
+#define PDMCRITSECTPROF_CALLERS             8
+/** @name PDMCRITSECTPROF_CTX_XXX - Caller contexts.
+ * @{ */
+#define PDMCRITSECTPROF_CTX_R3              0
+#define PDMCRITSECTPROF_CTX_R0              1
+#define PDMCRITSECTPROF_CTX_RC              2
+#ifdef IN_RING3
+# define PDMCRITSECTPROF_CTX_CUR            PDMCRITSECTPROF_CTX_R3
+#elif defined(IN_RING0)
+# define PDMCRITSECTPROF_CTX_CUR            PDMCRITSECTPROF_CTX_R0
+#else
+# define PDMCRITSECTPROF_CTX_CUR            PDMCRITSECTPROF_CTX_RC
+#endif
+/** @} */
+
+/**
+ * A call site which ran into contention on a profiled critical section.
+ *
+ * The table is maintained using the space-saving algorithm without any
+ * locking, so the numbers are approximate.
+ */
+typedef struct PDMCRITSECTPROFCALLER
+{
+    /** The return address of the enter call. */
+    uint64_t volatile               uCaller;
+    /** The context the address belongs to, PDMCRITSECTPROF_CTX_XXX. */
+    uint32_t volatile               enmCtx;
+    /** Number of contended enter attempts from this site. */
+    uint32_t volatile               cContentions;
+    /** Total TSC ticks this site spent waiting. */
+    uint64_t volatile               cTicksWait;
+} PDMCRITSECTPROFCALLER;
+/** Pointer to a critical section profiler call site. */
+typedef PDMCRITSECTPROFCALLER *PPDMCRITSECTPROFCALLER;
+
+/**
+ * Critical section contention profiler record.
+ *
+ * Allocated on the hyper heap when /PDM/CritSectProfiling/Enabled is set, one
+ * for each critical section or read/write critical section matching the
+ * /PDM/CritSectProfiling/Filter pattern.  Everything is in TSC ticks.
+ */
+typedef struct PDMCRITSECTPROF
+{
+    /** TSC timestamp of when the current exclusive owner got the section. */
+    uint64_t volatile               tsOwned;
+    /** Number of contended enter attempts. */
+    uint64_t volatile               cContentions;
+    /** Number of contended enter attempts that gave up (try-enter, rcBusy). */
+    uint64_t volatile               cBusy;
+    /** Total ticks spent waiting on contended enters. */
+    uint64_t volatile               cTicksWaitTotal;
+    /** Longest wait. */
+    uint64_t volatile               cTicksWaitMax;
+    /** Number of exclusive ownership periods sampled. */
+    uint64_t volatile               cHolds;
+    /** Total ticks the section was held exclusively. */
+    uint64_t volatile               cTicksHoldTotal;
+    /** Longest exclusive ownership period. */
+    uint64_t volatile               cTicksHoldMax;
+    /** Wait time histogram. */
+    uint64_t volatile               acWaitHist[PDMCRITSECTPROF_HIST_BUCKETS];
+    /** Hold time histogram. */
+    uint64_t volatile               acHoldHist[PDMCRITSECTPROF_HIST_BUCKETS];
+    /** Top contending call sites. */
+    PDMCRITSECTPROFCALLER           aCallers[PDMCRITSECTPROF_CALLERS];
+    /** Set if this is for a read/write critical section. */
+    bool                            fRw;
+    /** Set when the critical section has been deleted. */
+    bool volatile                   fDeleted;
+    /** Copy of the critical section name (may be truncated). */
+    char                            szName[62];
+} PDMCRITSECTPROF;
+AssertCompileMemberAlignment(PDMCRITSECTPROF, acWaitHist, 8);
+AssertCompileSizeAlignment(PDMCRITSECTPROF, 8);
+/** Pointer to a critical section profiler record. */
+typedef PDMCRITSECTPROF *PPDMCRITSECTPROF;
+
+
 
 /**
  * The usual device/driver/internal/external stuff.
@@ -852,10 +960,24 @@ typedef struct PDMQUEUE
     PDMQUEUETYPE                    enmType;
     /** The interval between checking the queue for events.
      * The realtime timer below is used to do the waiting.
-     * If 0, the queue will use the VM_FF_PDM_QUEUE forced action. */
+     * If 0, the queue will use the VM_FF_PDM_QUEUE forced action.
+     * If PDMQUEUE_INTERVAL_WORKER_THREAD, the queue is serviced by its own
+     * worker thread. */
     uint32_t                        cMilliesInterval;
     /** Interval timer. Only used if cMilliesInterval is non-zero. */
     PTMTIMERR3                      pTimer;
+    /** The event semaphore the worker thread is waiting on.
+     * NIL_SUPSEMEVENT if not a worker thread queue. */
+    SUPSEMEVENT                     hEvtWorker;
+    /** The worker thread handle - R3 only. */
+    R3PTRTYPE(RTTHREAD)             hWorkerThread;
+    /** Set by the worker thread before it blocks on hEvtWorker.  The first
+     * producer clearing it is the one signalling the semaphore. */
+    bool volatile                   fWorkerSleeping;
+    /** Set when the worker thread should terminate. */
+    bool volatile                   fWorkerTerminate;
+    /** Alignment padding. */
+    bool                            afAlignment0[6];
     /** Pointer to the VM - R3. */
     PVMR3                           pVMR3;
     /** LIFO of pending items - R3. */
@@ -893,6 +1015,10 @@ typedef struct PDMQUEUE
     STAMCOUNTER                     StatFlush;
     /** Stat: Queue flushes with pending items left over. */
     STAMCOUNTER                     StatFlushLeftovers;
+    /** Stat: Worker thread wakeups signalled by producers. */
+    STAMCOUNTER                     StatWorkerWakeups;
+    /** Stat: Batches drained by the worker thread. */
+    STAMCOUNTER                     StatWorkerBatches;
 #ifdef VBOX_WITH_STATISTICS
     /** State: Profiling the flushing. */
     STAMPROFILE                     StatFlushPrf;
@@ -1029,7 +1155,11 @@ typedef struct PDMCPU
     /** The number of entries in the apQueuedCritSectsLeaves table that's currently
      * in use. */
     uint32_t                        cQueuedCritSectLeaves;
-    uint32_t                        uPadding0; /**< Alignment padding.*/
+    /** Set while the EMT is blocked waiting on a PDM critical section or
+     * read/write critical section.  Used by the adaptive spinning to tell
+     * whether a section owner is currently making progress. */
+    bool volatile                   fBlockedOnCritSect;
+    bool                            afPadding0[3]; /**< Alignment padding.*/
     /** Critical sections queued in RC/R0 because of contention preventing leave to
      * complete. (R3 Ptrs)
      * We will return to Ring-3 ASAP, so this queue doesn't have to be very long. */
@@ -1139,6 +1269,26 @@ typedef struct PDM
     RTGCPHYS                        GCPhysVMMDevHeap;
     /** @} */
 
+    /** @name   Critical section contention profiler
+     * @{ */
+    /** Profiler records - R3 Ptr.  NULL if profiling is disabled. */
+    R3PTRTYPE(PPDMCRITSECTPROF)     paCritSectProfsR3;
+    /** Profiler records - R0 Ptr. */
+    R0PTRTYPE(PPDMCRITSECTPROF)     paCritSectProfsR0;
+    /** Profiler records - RC Ptr. */
+    RCPTRTYPE(PPDMCRITSECTPROF)     paCritSectProfsRC;
+    /** Number of records in use. */
+    uint32_t                        cCritSectProfs;
+    /** Number of records allocated. */
+    uint32_t                        cMaxCritSectProfs;
+#if HC_ARCH_BITS == 64
+    /** Alignment padding. */
+    uint32_t                        u32Padding3;
+#endif
+    /** Name filter (RTStrSimplePatternMultiMatch); NULL means all. */
+    R3PTRTYPE(char *)               pszCritSectProfFilter;
+    /** @} */
+
     /** Number of times a critical section leave request needed to be queued for ring-3 execution. */
     STAMCOUNTER                     StatQueuedCritSectLeaves;
 } PDM;
@@ -1157,7 +1307,7 @@ typedef struct PDMUSERPERVM
 {
     /** @todo move more stuff over here. */
 
-    /** Linked list of timer driven PDM queues.
+    /** Linked list of timer and worker thread driven PDM queues.
      * Currently serialized by PDM::CritSect.  */
     R3PTRTYPE(struct PDMQUEUE *)    pQueuesTimer;
     /** Linked list of force action driven PDM queues.
@@ -1295,6 +1445,7 @@ char       *pdmR3FileR3(const char *pszFile, bool fShared);
 int         pdmR3LoadR3U(PUVM pUVM, const char *pszFilename, const char *pszName);
 
 void        pdmR3QueueRelocate(PVM pVM, RTGCINTPTR offDelta);
+void        pdmR3QueueStopWorkersDevice(PVM pVM, PPDMDEVINS pDevIns);
 
 int         pdmR3ThreadCreateDevice(PVM pVM, PPDMDEVINS pDevIns, PPPDMTHREAD ppThread, void *pvUser, PFNPDMTHREADDEV pfnThread,
                                     PFNPDMTHREADWAKEUPDEV pfnWakeup, size_t cbStack, RTTHREADTYPE enmType, const char *pszName);
@@ -1333,6 +1484,10 @@ int         pdmR3BlkCacheResume(PVM pVM);
 
 #endif /* IN_RING3 */
 
+void        pdmCritSectProfOwned(PVM pVM, uint32_t idxProf);
+void        pdmCritSectProfReleased(PVM pVM, uint32_t idxProf);
+void        pdmCritSectProfContended(PVM pVM, uint32_t idxProf, uint64_t cTicksWait, RTHCUINTPTR uCaller, bool fBusy);
+
 void        pdmLock(PVM pVM);
 int         pdmLockEx(PVM pVM, int rc);
 void        pdmUnlock(PVM pVM);
@@ -458,17 +458,17 @@ DECLINLINE(void *) pgmPoolMapPageV2Inlined(PVM pVM, PVMCPU pVCpu, PPGMPOOLPAGE p
  */
 DECLINLINE(int) pgmPhysPageQueryTlbe(PVM pVM, RTGCPHYS GCPhys, PPPGMPAGEMAPTLBE ppTlbe)
 {
-    int rc;
-    PPGMPAGEMAPTLBE pTlbe = &pVM->pgm.s.CTXSUFF(PhysTlb).aEntries[PGM_PAGEMAPTLB_IDX(GCPhys)];
-    if (pTlbe->GCPhys == (GCPhys & X86_PTE_PAE_PG_MASK))
+    RTGCPHYS const  GCPhysPage = GCPhys & X86_PTE_PAE_PG_MASK;
+    PPGMPAGEMAPTLBE pTlbe      = &pVM->pgm.s.CTXSUFF(PhysTlb).aEntries[PGM_PAGEMAPTLB_IDX(GCPhys)];
+    AssertCompile(PGM_PAGEMAPTLB_WAYS == 2);
+    if (   pTlbe->GCPhys == GCPhysPage
+        || (++pTlbe)->GCPhys == GCPhysPage)
     {
         STAM_COUNTER_INC(&pVM->pgm.s.CTX_SUFF(pStats)->CTX_MID_Z(Stat,PageMapTlbHits));
-        rc = VINF_SUCCESS;
+        *ppTlbe = pTlbe;
+        return VINF_SUCCESS;
     }
-    else
-        rc = pgmPhysPageLoadIntoTlb(pVM, GCPhys);
-    *ppTlbe = pTlbe;
-    return rc;
+    return pgmPhysPageLoadIntoTlb(pVM, GCPhys, ppTlbe);
 }
 
 
@@ -488,12 +488,13 @@ DECLINLINE(int) pgmPhysPageQueryTlbe(PVM pVM, RTGCPHYS GCPhys, PPPGMPAGEMAPTLBE
  */
 DECLINLINE(int) pgmPhysPageQueryTlbeWithPage(PVM pVM, PPGMPAGE pPage, RTGCPHYS GCPhys, PPPGMPAGEMAPTLBE ppTlbe)
 {
-    int rc;
-    PPGMPAGEMAPTLBE pTlbe = &pVM->pgm.s.CTXSUFF(PhysTlb).aEntries[PGM_PAGEMAPTLB_IDX(GCPhys)];
-    if (pTlbe->GCPhys == (GCPhys & X86_PTE_PAE_PG_MASK))
+    RTGCPHYS const  GCPhysPage = GCPhys & X86_PTE_PAE_PG_MASK;
+    PPGMPAGEMAPTLBE pTlbe      = &pVM->pgm.s.CTXSUFF(PhysTlb).aEntries[PGM_PAGEMAPTLB_IDX(GCPhys)];
+    AssertCompile(PGM_PAGEMAPTLB_WAYS == 2);
+    if (   pTlbe->GCPhys == GCPhysPage
+        || (++pTlbe)->GCPhys == GCPhysPage)
     {
         STAM_COUNTER_INC(&pVM->pgm.s.CTX_SUFF(pStats)->CTX_MID_Z(Stat,PageMapTlbHits));
-        rc = VINF_SUCCESS;
 # if 0 //def VBOX_WITH_2X_4GB_ADDR_SPACE_IN_R0
 #  ifdef IN_RING3
         if (pTlbe->pv == (void *)pVM->pgm.s.pvZeroPgR0)
@@ -506,11 +507,10 @@ DECLINLINE(int) pgmPhysPageQueryTlbeWithPage(PVM pVM, PPGMPAGE pPage, RTGCPHYS G
 # ifndef VBOX_WITH_2X_4GB_ADDR_SPACE_IN_R0
         Assert(!pTlbe->pMap || RT_VALID_PTR(pTlbe->pMap->pv));
 # endif
+        *ppTlbe = pTlbe;
+        return VINF_SUCCESS;
     }
-    else
-        rc = pgmPhysPageLoadIntoTlbWithPage(pVM, pPage, GCPhys);
-    *ppTlbe = pTlbe;
-    return rc;
+    return pgmPhysPageLoadIntoTlbWithPage(pVM, pPage, GCPhys, ppTlbe);
 }
 
 #endif /* !IN_RC */
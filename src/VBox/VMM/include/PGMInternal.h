@@ -1552,15 +1552,20 @@ typedef PGMRAMRANGE *PPGMRAMRANGE;
 
 /** The number of entries in the RAM range TLBs (there is one for each
  *  context).  Must be a power of two. */
-#define PGM_RAMRANGE_TLB_ENTRIES            8
+#define PGM_RAMRANGE_TLB_ENTRIES            64
 
 /**
  * Calculates the RAM range TLB index for the physical address.
  *
+ * The index is made from the megabyte number with the higher address bits
+ * folded in, so that MMIO2 ranges up near 4GB (and RAM above 4GB) doesn't
+ * keep evicting the entries for the low RAM ranges.
+ *
  * @returns RAM range TLB index.
  * @param   a_GCPhys    The guest physical address.
  */
-#define PGM_RAMRANGE_TLB_IDX(a_GCPhys)      ( ((a_GCPhys) >> 20) & (PGM_RAMRANGE_TLB_ENTRIES - 1) )
+#define PGM_RAMRANGE_TLB_IDX(a_GCPhys) \
+    ( (unsigned)( ((a_GCPhys) >> 20) ^ ((a_GCPhys) >> 26) ^ ((a_GCPhys) >> 32) ) & (PGM_RAMRANGE_TLB_ENTRIES - 1) )
 
 
 
@@ -1888,7 +1893,12 @@ typedef PGMPAGER3MAPTLBE *PPGMPAGER3MAPTLBE;
 
 /** The number of entries in the ring-3 guest page mapping TLB.
  * @remarks The value must be a power of two. */
-#define PGM_PAGER3MAPTLB_ENTRIES 256
+#define PGM_PAGER3MAPTLB_ENTRIES 512
+/** The associativity of the ring-3 guest page mapping TLB.
+ * The ways of a set are adjacent in PGMPAGER3MAPTLB::aEntries, way 0 being the
+ * most recently loaded one.
+ * @remarks The value must be a power of two. */
+#define PGM_PAGER3MAPTLB_WAYS    2
 
 /**
  * Ring-3 guest page mapping TLB.
@@ -1903,11 +1913,13 @@ typedef struct PGMPAGER3MAPTLB
 typedef PGMPAGER3MAPTLB *PPGMPAGER3MAPTLB;
 
 /**
- * Calculates the index of the TLB entry for the specified guest page.
- * @returns Physical TLB index.
+ * Calculates the index of the first TLB entry in the set for the specified
+ * guest page.
+ * @returns Physical TLB index of way 0.
  * @param   GCPhys      The guest physical address.
  */
-#define PGM_PAGER3MAPTLB_IDX(GCPhys)    ( ((GCPhys) >> PAGE_SHIFT) & (PGM_PAGER3MAPTLB_ENTRIES - 1) )
+#define PGM_PAGER3MAPTLB_IDX(GCPhys) \
+    ( ( ((GCPhys) >> PAGE_SHIFT) & (PGM_PAGER3MAPTLB_ENTRIES / PGM_PAGER3MAPTLB_WAYS - 1) ) * PGM_PAGER3MAPTLB_WAYS )
 
 
 /**
@@ -2071,8 +2083,11 @@ typedef PGMMAPSET *PPGMMAPSET;
  * The page mapper TLB entry pointer pointer type for the current context. */
 /** @def PGM_PAGEMAPTLB_ENTRIES
  * The number of TLB entries in the page mapper TLB for the current context. */
+/** @def PGM_PAGEMAPTLB_WAYS
+ * The number of ways in each set of the page mapper TLB for the current
+ * context. */
 /** @def PGM_PAGEMAPTLB_IDX
- * Calculate the TLB index for a guest physical address.
+ * Calculate the TLB index (of way 0 in the set) for a guest physical address.
  * @returns The TLB index.
  * @param   GCPhys      The guest physical address. */
 /** @typedef PPGMPAGEMAP
@@ -2100,6 +2115,7 @@ typedef PGMMAPSET *PPGMMAPSET;
  typedef PPGMPAGER3MAPTLBE              PPGMPAGEMAPTLBE;
  typedef PPGMPAGER3MAPTLBE             *PPPGMPAGEMAPTLBE;
 # define PGM_PAGEMAPTLB_ENTRIES         PGM_PAGER3MAPTLB_ENTRIES
+# define PGM_PAGEMAPTLB_WAYS            PGM_PAGER3MAPTLB_WAYS
 # define PGM_PAGEMAPTLB_IDX(GCPhys)     PGM_PAGER3MAPTLB_IDX(GCPhys)
  typedef PPGMCHUNKR3MAP                 PPGMPAGEMAP;
  typedef PPPGMCHUNKR3MAP                PPPGMPAGEMAP;
@@ -3187,6 +3203,10 @@ typedef struct PGMSTATS
     STAMPROFILE                 StatR3IsValidLargePage;
     /** pgmPhysIsValidLargePage profiling - RZ*/
     STAMPROFILE                 StatRZIsValidLargePage;
+    /** pgmR3PhysRamPreAllocate profiling, allocation phase. */
+    STAMPROFILE                 StatR3RamPreAlloc;
+    /** pgmR3PhysRamPreAllocate profiling, clearing phase. */
+    STAMPROFILE                 StatR3RamPreAllocClear;
 
     STAMPROFILE                 StatChunkAging;
     STAMPROFILE                 StatChunkFindCandidate;
@@ -3273,8 +3293,11 @@ typedef struct PGM
 
     /** Physical access handler type for ROM protection. */
     PGMPHYSHANDLERTYPE              hRomPhysHandlerType;
+    /** Set while pgmR3PhysRamPreAllocate is running with worker threads, the
+     * handy page allocators then leave clearing the new pages to it. */
+    bool                            fDeferPageClearing;
     /** Alignment padding.   */
-    uint32_t                        u32Padding;
+    bool                            afPadding0[3];
 
     /** 4 MB page mask; 32 or 36 bits depending on PSE-36 (identical for all VCPUs) */
     RTGCPHYS                        GCPhys4MBPSEMask;
@@ -4153,8 +4176,8 @@ int             pgmR3InitSavedState(PVM pVM, uint64_t cbRam);
 int             pgmPhysAllocPage(PVM pVM, PPGMPAGE pPage, RTGCPHYS GCPhys);
 int             pgmPhysAllocLargePage(PVM pVM, RTGCPHYS GCPhys);
 int             pgmPhysRecheckLargePage(PVM pVM, RTGCPHYS GCPhys, PPGMPAGE pLargePage);
-int             pgmPhysPageLoadIntoTlb(PVM pVM, RTGCPHYS GCPhys);
-int             pgmPhysPageLoadIntoTlbWithPage(PVM pVM, PPGMPAGE pPage, RTGCPHYS GCPhys);
+int             pgmPhysPageLoadIntoTlb(PVM pVM, RTGCPHYS GCPhys, PPGMPAGER3MAPTLBE *ppTlbe);
+int             pgmPhysPageLoadIntoTlbWithPage(PVM pVM, PPGMPAGE pPage, RTGCPHYS GCPhys, PPGMPAGER3MAPTLBE *ppTlbe);
 void            pgmPhysPageMakeWriteMonitoredWritable(PVM pVM, PPGMPAGE pPage);
 int             pgmPhysPageMakeWritable(PVM pVM, PPGMPAGE pPage, RTGCPHYS GCPhys);
 int             pgmPhysPageMakeWritableAndMap(PVM pVM, PPGMPAGE pPage, RTGCPHYS GCPhys, void **ppv);
@@ -40,6 +40,9 @@ RT_C_DECLS_BEGIN
  * This is an optimization for speeding up registration as well as query. */
 #define STAM_WITH_LOOKUP_TREE
 
+/** The number of buckets in the sample name hash table (power of two). */
+#define STAM_HASH_SIZE          4096
+
 
 /** Pointer to sample descriptor. */
 typedef struct STAMDESC    *PSTAMDESC;
@@ -81,6 +84,12 @@ typedef struct STAMDESC
     RTLISTNODE          ListEntry;
     /** Pointer to our lookup node. */
     PSTAMLOOKUP         pLookup;
+    /** Next descriptor in the name hash bucket. */
+    PSTAMDESC           pHashNext;
+    /** The name hash (RTStrHash1). */
+    uint32_t            uHash;
+    /** The stable sample index, see STAMUSERPERVM::papSamples. */
+    uint32_t            iSample;
     /** Sample name. */
     const char         *pszName;
     /** Sample type. */
@@ -128,6 +137,29 @@ typedef struct STAMDESC
 } STAMDESC;
 
 
+/**
+ * Binary snapshot delta baseline.
+ *
+ * This belongs to a single statistics consumer, which serializes its use.
+ */
+typedef struct STAMSNAPSHOTBINBASELINE
+{
+    /** The user mode VM handle the baseline is for (retained), NULL if not
+     *  used yet. */
+    PUVM                pUVM;
+    /** The number of sample indexes covered by the arrays below. */
+    uint32_t            cSamples;
+    /** Bitmap of the samples with a valid pau64Last entry. */
+    uint64_t           *pbmValid;
+    /** Sample values at the previous snapshot, STAM_SNAPSHOT_BIN_MAX_VALUES
+     *  entries per sample, indexed by STAMDESC::iSample. */
+    uint64_t           *pau64Last;
+} STAMSNAPSHOTBINBASELINE;
+
+/** The max number of values a binary snapshot entry has (STAMPROFILE). */
+#define STAM_SNAPSHOT_BIN_MAX_VALUES    4
+
+
 /**
  * STAM data kept in the UVM.
  */
@@ -141,6 +173,21 @@ typedef struct STAMUSERPERVM
     /** RW Lock for the list and tree. */
     RTSEMRW                 RWSem;
 
+    /** Name hash table (STAM_HASH_SIZE buckets), chained thru STAMDESC::pHashNext. */
+    PSTAMDESC              *papHash;
+    /** Sample index table, indexed by STAMDESC::iSample.  Entries of
+     * deregistered samples are set to NULL and never reused, so the indexes
+     * stay stable for the lifetime of the VM. */
+    PSTAMDESC              *papSamples;
+    /** Number of used entries in papSamples. */
+    uint32_t                cSamples;
+    /** Number of allocated entries in papSamples. */
+    uint32_t                cSamplesAlloc;
+    /** Incremented whenever a sample is registered or deregistered. */
+    uint32_t volatile       uGeneration;
+    /** Explicit alignment padding. */
+    uint32_t                uAlignment0;
+
     /** The copy of the GVMM statistics. */
     GVMMSTATS               GVMMStats;
     /** The number of registered host CPU leaves. */
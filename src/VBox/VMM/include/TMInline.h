@@ -20,21 +20,149 @@
 
 
 /**
- * Used to unlink a timer from the active list.
+ * Calculates how many skip list levels above the active chain a timer takes
+ * part in.
+ *
+ * This is derived from the queue relative offset of the timer, so it is the
+ * same in all contexts and does not need to be stored anywhere.  Roughly one in
+ * four timers makes it onto each successive level.
  *
+ * @returns Number of express lanes, 0 thru TMTIMER_SKIP_LEVELS.
  * @param   pQueue      The timer queue.
- * @param   pTimer      The timer that needs linking.
+ * @param   pTimer      The timer.
+ */
+DECLINLINE(unsigned) tmTimerSkipLevels(PTMTIMERQUEUE pQueue, PTMTIMER pTimer)
+{
+    uint32_t uHash   = (uint32_t)((intptr_t)pTimer - (intptr_t)pQueue) * UINT32_C(0x9e3779b1);
+    unsigned cLevels = 0;
+    while (cLevels < TMTIMER_SKIP_LEVELS && !(uHash & UINT32_C(0xc0000000)))
+    {
+        cLevels++;
+        uHash <<= 2;
+    }
+    return cLevels;
+}
+
+
+/**
+ * Links a timer into the active list of a timer queue.
+ *
+ * The express lanes are used to locate the insertion point, so this is
+ * O(log n) rather than a walk of the whole list.  Timers with the same expire
+ * time are kept in insertion order.
+ *
+ * @param   pQueue          The queue.
+ * @param   pTimer          The timer.
+ * @param   u64Expire       The timer expiration time.
  *
  * @remarks Called while owning the relevant queue lock.
  */
-DECL_FORCE_INLINE(void) tmTimerQueueUnlinkActive(PTMTIMERQUEUE pQueue, PTMTIMER pTimer)
+DECL_FORCE_INLINE(void) tmTimerQueueLinkActive(PTMTIMERQUEUE pQueue, PTMTIMER pTimer, uint64_t u64Expire)
 {
-#ifdef VBOX_STRICT
-    TMTIMERSTATE const enmState = pTimer->enmState;
-    Assert(  pTimer->enmClock == TMCLOCK_VIRTUAL_SYNC
-           ? enmState == TMTIMERSTATE_ACTIVE
-           : enmState == TMTIMERSTATE_PENDING_SCHEDULE || enmState == TMTIMERSTATE_PENDING_STOP_SCHEDULE);
-#endif
+    Assert(!pTimer->offNext);
+    Assert(!pTimer->offPrev);
+    Assert(pTimer->enmState == TMTIMERSTATE_ACTIVE || pTimer->enmClock != TMCLOCK_VIRTUAL_SYNC); /* (active is not a stable state) */
+
+    /*
+     * Descend the express lanes, recording the last timer on each of them that
+     * doesn't expire after the new one.  The walk on each level is bounded by
+     * where the level above stopped, so the levels stay consistent even when
+     * the expire time of a linked timer is being changed under our feet.
+     */
+    PTMTIMER apPrev[TMTIMER_SKIP_LEVELS];
+    PTMTIMER pPrev  = NULL;
+    PTMTIMER pLimit = NULL;
+    PTMTIMER pCur;
+    unsigned iLvl   = TMTIMER_SKIP_LEVELS;
+    while (iLvl-- > 0)
+    {
+        pCur = pPrev ? TMTIMER_GET_SKIP_NEXT(pPrev, iLvl) : TMTIMER_GET_SKIP_HEAD(pQueue, iLvl);
+        while (pCur && pCur != pLimit && pCur->u64Expire <= u64Expire)
+        {
+            pPrev = pCur;
+            pCur  = TMTIMER_GET_SKIP_NEXT(pCur, iLvl);
+        }
+        apPrev[iLvl] = pPrev;
+        pLimit       = pCur;
+    }
+
+    pCur = pPrev ? TMTIMER_GET_NEXT(pPrev) : TMTIMER_GET_HEAD(pQueue);
+    while (pCur && pCur != pLimit && pCur->u64Expire <= u64Expire)
+    {
+        pPrev = pCur;
+        pCur  = TMTIMER_GET_NEXT(pCur);
+    }
+
+    /*
+     * Link it into the chain.
+     */
+    TMTIMER_SET_NEXT(pTimer, pCur);
+    TMTIMER_SET_PREV(pTimer, pPrev);
+    if (pCur)
+        TMTIMER_SET_PREV(pCur, pTimer);
+    if (pPrev)
+    {
+        TMTIMER_SET_NEXT(pPrev, pTimer);
+        if (!pCur)
+            DBGFTRACE_U64_TAG2(pTimer->CTX_SUFF(pVM), u64Expire, "tmTimerQueueLinkActive tail", R3STRING(pTimer->pszDesc));
+    }
+    else
+    {
+        TMTIMER_SET_HEAD(pQueue, pTimer);
+        ASMAtomicWriteU64(&pQueue->u64Expire, u64Expire);
+        DBGFTRACE_U64_TAG2(pTimer->CTX_SUFF(pVM), u64Expire, pCur ? "tmTimerQueueLinkActive head" : "tmTimerQueueLinkActive empty",
+                           R3STRING(pTimer->pszDesc));
+    }
+
+    /*
+     * And into the express lanes it has been assigned to.
+     */
+    unsigned const cLevels = tmTimerSkipLevels(pQueue, pTimer);
+    for (iLvl = 0; iLvl < cLevels; iLvl++)
+    {
+        Assert(!pTimer->aoffSkipNext[iLvl]);
+        Assert(!pTimer->aoffSkipPrev[iLvl]);
+        PTMTIMER const pLvlPrev = apPrev[iLvl];
+        PTMTIMER const pLvlNext = pLvlPrev ? TMTIMER_GET_SKIP_NEXT(pLvlPrev, iLvl) : TMTIMER_GET_SKIP_HEAD(pQueue, iLvl);
+        TMTIMER_SET_SKIP_NEXT(pTimer, iLvl, pLvlNext);
+        TMTIMER_SET_SKIP_PREV(pTimer, iLvl, pLvlPrev);
+        if (pLvlNext)
+            TMTIMER_SET_SKIP_PREV(pLvlNext, iLvl, pTimer);
+        if (pLvlPrev)
+            TMTIMER_SET_SKIP_NEXT(pLvlPrev, iLvl, pTimer);
+        else
+            TMTIMER_SET_SKIP_HEAD(pQueue, iLvl, pTimer);
+    }
+}
+
+
+/**
+ * Unlinks a timer from the active list, no state checks.
+ *
+ * @param   pQueue      The timer queue.
+ * @param   pTimer      The timer that needs unlinking.
+ *
+ * @remarks Called while owning the relevant queue lock.
+ */
+DECL_FORCE_INLINE(void) tmTimerQueueUnlink(PTMTIMERQUEUE pQueue, PTMTIMER pTimer)
+{
+    unsigned const cLevels = tmTimerSkipLevels(pQueue, pTimer);
+    for (unsigned iLvl = 0; iLvl < cLevels; iLvl++)
+    {
+        const PTMTIMER pLvlPrev = TMTIMER_GET_SKIP_PREV(pTimer, iLvl);
+        const PTMTIMER pLvlNext = TMTIMER_GET_SKIP_NEXT(pTimer, iLvl);
+        if (pLvlPrev)
+            TMTIMER_SET_SKIP_NEXT(pLvlPrev, iLvl, pLvlNext);
+        else
+        {
+            Assert(TMTIMER_GET_SKIP_HEAD(pQueue, iLvl) == pTimer);
+            TMTIMER_SET_SKIP_HEAD(pQueue, iLvl, pLvlNext);
+        }
+        if (pLvlNext)
+            TMTIMER_SET_SKIP_PREV(pLvlNext, iLvl, pLvlPrev);
+        pTimer->aoffSkipNext[iLvl] = 0;
+        pTimer->aoffSkipPrev[iLvl] = 0;
+    }
 
     const PTMTIMER pPrev = TMTIMER_GET_PREV(pTimer);
     const PTMTIMER pNext = TMTIMER_GET_NEXT(pTimer);
@@ -44,7 +172,7 @@ DECL_FORCE_INLINE(void) tmTimerQueueUnlinkActive(PTMTIMERQUEUE pQueue, PTMTIMER
     {
         TMTIMER_SET_HEAD(pQueue, pNext);
         pQueue->u64Expire = pNext ? pNext->u64Expire : INT64_MAX;
-        DBGFTRACE_U64_TAG(pTimer->CTX_SUFF(pVM), pQueue->u64Expire, "tmTimerQueueUnlinkActive");
+        DBGFTRACE_U64_TAG(pTimer->CTX_SUFF(pVM), pQueue->u64Expire, "tmTimerQueueUnlink");
     }
     if (pNext)
         TMTIMER_SET_PREV(pNext, pPrev);
@@ -52,5 +180,25 @@ DECL_FORCE_INLINE(void) tmTimerQueueUnlinkActive(PTMTIMERQUEUE pQueue, PTMTIMER
     pTimer->offPrev = 0;
 }
 
+
+/**
+ * Used to unlink a timer from the active list.
+ *
+ * @param   pQueue      The timer queue.
+ * @param   pTimer      The timer that needs linking.
+ *
+ * @remarks Called while owning the relevant queue lock.
+ */
+DECL_FORCE_INLINE(void) tmTimerQueueUnlinkActive(PTMTIMERQUEUE pQueue, PTMTIMER pTimer)
+{
+#ifdef VBOX_STRICT
+    TMTIMERSTATE const enmState = pTimer->enmState;
+    Assert(  pTimer->enmClock == TMCLOCK_VIRTUAL_SYNC
+           ? enmState == TMTIMERSTATE_ACTIVE
+           : enmState == TMTIMERSTATE_PENDING_SCHEDULE || enmState == TMTIMERSTATE_PENDING_STOP_SCHEDULE);
+#endif
+    tmTimerQueueUnlink(pQueue, pTimer);
+}
+
 #endif
 
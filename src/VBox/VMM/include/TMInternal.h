@@ -103,6 +103,12 @@ typedef enum TMTIMERSTATE
      && (enmState) >= TMTIMERSTATE_PENDING_SCHEDULE_SET_EXPIRE)
 
 
+/** The number of skip list levels (express lanes) above the active timer
+ * chain.  Each level holds roughly a quarter of the timers of the level below,
+ * so four levels keeps insertion logarithmic up to around a thousand timers. */
+#define TMTIMER_SKIP_LEVELS     4
+
+
 /**
  * Internal representation of a timer.
  *
@@ -178,6 +184,13 @@ typedef struct TMTIMER
     int32_t                 offNext;
     /** Timer relative offset to the previous timer in the chain. */
     int32_t                 offPrev;
+    /** Timer relative offsets to the next timer on each of the express lanes
+     * (skip list levels) above the chain.  Only the first tmTimerSkipLevels()
+     * entries are used. */
+    int32_t                 aoffSkipNext[TMTIMER_SKIP_LEVELS];
+    /** Timer relative offsets to the previous timer on each of the express
+     * lanes above the chain. */
+    int32_t                 aoffSkipPrev[TMTIMER_SKIP_LEVELS];
 
     /** Pointer to the VM the timer belongs to - R3 Ptr. */
     PVMR3                   pVMR3;
@@ -243,6 +256,18 @@ AssertCompileMemberSize(TMTIMER, enmState, sizeof(uint32_t));
 #define TMTIMER_SET_PREV(pTimer, pPrev) ((pTimer)->offPrev = (pPrev) ? (intptr_t)(pPrev) - (intptr_t)(pTimer) : 0)
 /** Set the next timer link. */
 #define TMTIMER_SET_NEXT(pTimer, pNext) ((pTimer)->offNext = (pNext) ? (intptr_t)(pNext) - (intptr_t)(pTimer) : 0)
+/** Get the previous timer on skip list level @a iLvl. */
+#define TMTIMER_GET_SKIP_PREV(pTimer, iLvl) \
+    ((PTMTIMER)((pTimer)->aoffSkipPrev[iLvl] ? (intptr_t)(pTimer) + (pTimer)->aoffSkipPrev[iLvl] : 0))
+/** Get the next timer on skip list level @a iLvl. */
+#define TMTIMER_GET_SKIP_NEXT(pTimer, iLvl) \
+    ((PTMTIMER)((pTimer)->aoffSkipNext[iLvl] ? (intptr_t)(pTimer) + (pTimer)->aoffSkipNext[iLvl] : 0))
+/** Set the previous timer link on skip list level @a iLvl. */
+#define TMTIMER_SET_SKIP_PREV(pTimer, iLvl, pPrev) \
+    ((pTimer)->aoffSkipPrev[iLvl] = (pPrev) ? (intptr_t)(pPrev) - (intptr_t)(pTimer) : 0)
+/** Set the next timer link on skip list level @a iLvl. */
+#define TMTIMER_SET_SKIP_NEXT(pTimer, iLvl, pNext) \
+    ((pTimer)->aoffSkipNext[iLvl] = (pNext) ? (intptr_t)(pNext) - (intptr_t)(pTimer) : 0)
 
 
 /**
@@ -275,9 +300,18 @@ typedef struct TMTIMERQUEUE
     int32_t volatile        offSchedule;
     /** The clock for this queue. */
     TMCLOCK                 enmClock;
-    /** Pad the structure up to 32 bytes. */
-    uint32_t                au32Padding[3];
+    /** Heads of the skip list levels above the active list.
+     *
+     * Level N links a subset of the timers on level N-1 in the same order,
+     * allowing tmTimerQueueLinkActive to find the insertion point without
+     * walking the whole active list.  Same serialization as offActive.
+     *
+     * The offsets are relative to the queue structure. */
+    int32_t                 aoffSkipHead[TMTIMER_SKIP_LEVELS];
+    /** Pad the structure up to 64 bytes. */
+    uint32_t                au32Padding[7];
 } TMTIMERQUEUE;
+AssertCompileSize(TMTIMERQUEUE, 64);
 
 /** Pointer to a timer queue. */
 typedef TMTIMERQUEUE *PTMTIMERQUEUE;
@@ -286,6 +320,12 @@ typedef TMTIMERQUEUE *PTMTIMERQUEUE;
 #define TMTIMER_GET_HEAD(pQueue)        ((PTMTIMER)((pQueue)->offActive ? (intptr_t)(pQueue) + (pQueue)->offActive : 0))
 /** Set the head of the active timer list. */
 #define TMTIMER_SET_HEAD(pQueue, pHead) ((pQueue)->offActive = pHead ? (intptr_t)pHead - (intptr_t)(pQueue) : 0)
+/** Get the head of skip list level @a iLvl. */
+#define TMTIMER_GET_SKIP_HEAD(pQueue, iLvl) \
+    ((PTMTIMER)((pQueue)->aoffSkipHead[iLvl] ? (intptr_t)(pQueue) + (pQueue)->aoffSkipHead[iLvl] : 0))
+/** Set the head of skip list level @a iLvl. */
+#define TMTIMER_SET_SKIP_HEAD(pQueue, iLvl, pHead) \
+    ((pQueue)->aoffSkipHead[iLvl] = (pHead) ? (intptr_t)(pHead) - (intptr_t)(pQueue) : 0)
 
 
 /**
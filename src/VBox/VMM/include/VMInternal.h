@@ -141,6 +141,8 @@ typedef enum
     VMHALTMETHOD_1,
     /** The first go at a more global approach. */
     VMHALTMETHOD_GLOBAL_1,
+    /** Global 1 with adaptive polling before blocking. */
+    VMHALTMETHOD_GLOBAL_2,
     /** The end of valid methods. (not inclusive of course) */
     VMHALTMETHOD_END,
     /** The usual 32-bit max value. */
@@ -294,11 +296,23 @@ typedef struct VMINTUSERPERVM
 
        /**
         * The GVMM manages halted and waiting EMTs.
+        *
+        * Global 2 additionally polls the force action flags for a short,
+        * adaptively sized window before going to sleep in the GVMM, thus
+        * avoiding the wakeup cost for events arriving shortly after HLT.
         */
         struct
         {
             /** The threshold between spinning and blocking. */
             uint32_t                cNsSpinBlockThresholdCfg;
+            /** Global 2: The max halt polling window (ns). */
+            uint32_t                cNsPollMaxCfg;
+            /** Global 2: The window to start at when growing from zero (ns). */
+            uint32_t                cNsPollStartCfg;
+            /** Global 2: The factor to grow the window by. */
+            uint32_t                uPollGrowCfg;
+            /** Global 2: The divisor to shrink the window by, 0 to reset it. */
+            uint32_t                uPollShrinkCfg;
         }                           Global1;
     }                               Halt;
 
@@ -353,7 +367,8 @@ typedef struct VMINTUSERPERVMCPU
     uint32_t                        HaltFrequency;
     /** The number of halts in the current period. */
     uint32_t                        cHalts;
-    uint32_t                        padding; /**< alignment padding. */
+    /** The current halt polling window (ns), global 2 method only. */
+    uint32_t                        cNsHaltPollWindow;
     /** When we started counting halts in cHalts (RTTimeNanoTS). */
     uint64_t                        u64HaltsStartTS;
     /** @} */
@@ -435,6 +450,9 @@ typedef struct VMINTUSERPERVMCPU
     STAMPROFILE                     StatHaltBlockOnTime;
     STAMPROFILE                     StatHaltTimers;
     STAMPROFILE                     StatHaltPoll;
+    STAMPROFILE                     StatHaltPollSpin;
+    STAMCOUNTER                     StatHaltPollHits;
+    STAMCOUNTER                     StatHaltPollMisses;
     /** @} */
 } VMINTUSERPERVMCPU;
 AssertCompileMemberAlignment(VMINTUSERPERVMCPU, u64HaltsStartTS, 8);
@@ -36,6 +36,83 @@
 #include <iprt/test.h>
 
 
+static void doHashedNodeTests(PCFGMNODE pRoot)
+{
+    /* enough children and values to get the hash indexes created and grown */
+    PCFGMNODE pBig = NULL;
+    RTTESTI_CHECK_RC_RETV(CFGMR3InsertNode(pRoot, "Big", &pBig), VINF_SUCCESS);
+    unsigned const cEntries = 200;
+    for (unsigned i = 0; i < cEntries; i++)
+    {
+        unsigned const iEntry = (i * 7) % cEntries;
+        RTTESTI_CHECK_RC_RETV(CFGMR3InsertNodeF(pBig, NULL, "Child%u", iEntry), VINF_SUCCESS);
+        char szName[32];
+        RTStrPrintf(szName, sizeof(szName), "Value%u", iEntry);
+        RTTESTI_CHECK_RC_RETV(CFGMR3InsertInteger(pBig, szName, iEntry), VINF_SUCCESS);
+    }
+    RTTESTI_CHECK_RC(CFGMR3InsertNode(pBig, "Child42", NULL), VERR_CFGM_NODE_EXISTS);
+    RTTESTI_CHECK_RC(CFGMR3InsertInteger(pBig, "Value42", 42), VERR_CFGM_LEAF_EXISTS);
+
+    /* lookups, including through paths */
+    for (unsigned i = 0; i < cEntries; i++)
+    {
+        RTTESTI_CHECK(CFGMR3GetChildF(pBig, "Child%u", i) != NULL);
+        RTTESTI_CHECK(CFGMR3GetChildF(pRoot, "Big/Child%u", i) == CFGMR3GetChildF(pBig, "Child%u", i));
+        char szName[32];
+        RTStrPrintf(szName, sizeof(szName), "Value%u", i);
+        uint64_t u64 = UINT64_MAX;
+        RTTESTI_CHECK_RC(CFGMR3QueryU64(pBig, szName, &u64), VINF_SUCCESS);
+        RTTESTI_CHECK(u64 == i);
+    }
+    RTTESTI_CHECK(CFGMR3GetChild(pBig, "Child200") == NULL);
+    RTTESTI_CHECK(CFGMR3GetChild(pBig, "Child") == NULL);
+    uint64_t u64;
+    RTTESTI_CHECK_RC(CFGMR3QueryU64(pBig, "Value200", &u64), VERR_CFGM_VALUE_NOT_FOUND);
+
+    /* enumeration order must be unaffected */
+    unsigned cChildren = 0;
+    char szPrev[32] = "";
+    for (PCFGMNODE pChild = CFGMR3GetFirstChild(pBig); pChild; pChild = CFGMR3GetNextChild(pChild), cChildren++)
+    {
+        char szName[32];
+        RTTESTI_CHECK_RC_RETV(CFGMR3GetName(pChild, szName, sizeof(szName)), VINF_SUCCESS);
+        RTTESTI_CHECK(strcmp(szPrev, szName) < 0);
+        RTStrCopy(szPrev, sizeof(szPrev), szName);
+    }
+    RTTESTI_CHECK(cChildren == cEntries);
+
+    /* removal */
+    for (unsigned i = 0; i < cEntries; i += 2)
+    {
+        CFGMR3RemoveNode(CFGMR3GetChildF(pBig, "Child%u", i));
+        char szName[32];
+        RTStrPrintf(szName, sizeof(szName), "Value%u", i);
+        RTTESTI_CHECK_RC(CFGMR3RemoveValue(pBig, szName), VINF_SUCCESS);
+    }
+    for (unsigned i = 0; i < cEntries; i++)
+    {
+        RTTESTI_CHECK((CFGMR3GetChildF(pBig, "Child%u", i) != NULL) == (i & 1));
+        char szName[32];
+        RTStrPrintf(szName, sizeof(szName), "Value%u", i);
+        RTTESTI_CHECK(CFGMR3Exists(pBig, szName) == (i & 1));
+    }
+
+    /* the indexes must survive being moved around */
+    PCFGMNODE pCopy = NULL;
+    RTTESTI_CHECK_RC_RETV(CFGMR3DuplicateSubTree(pBig, &pCopy), VINF_SUCCESS);
+    RTTESTI_CHECK_RC_RETV(CFGMR3InsertSubTree(pRoot, "BigCopy", pCopy, &pCopy), VINF_SUCCESS);
+    for (unsigned i = 1; i < cEntries; i += 2)
+    {
+        RTTESTI_CHECK(CFGMR3GetChildF(pCopy, "Child%u", i) != NULL);
+        char szName[32];
+        RTStrPrintf(szName, sizeof(szName), "Value%u", i);
+        RTTESTI_CHECK(CFGMR3Exists(pCopy, szName));
+    }
+    CFGMR3RemoveNode(pCopy);
+    CFGMR3RemoveNode(pBig);
+}
+
+
 static void doGeneralTests(PCFGMNODE pRoot)
 {
     /* test multilevel node creation */
@@ -65,6 +142,7 @@ static void doGeneralTests(PCFGMNODE pRoot)
     RTTESTI_CHECK_RC(CFGMR3QueryBoolDef(NULL, "BoolValue", &f, false), VINF_SUCCESS);
     RTTESTI_CHECK(f == false);
 
+    doHashedNodeTests(pRoot);
 }
 
 
@@ -0,0 +1,238 @@
+/* $Id$ */
+/** @file
+ * Guest core dump testcase: stream output vs. file output.
+ */
+
+/*
+ * Copyright (C) 2010-2015 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include <VBox/vmm/vm.h>
+#include <VBox/vmm/vmm.h>
+#include <VBox/vmm/cfgm.h>
+#include <VBox/vmm/dbgf.h>
+#include <VBox/err.h>
+#include <iprt/file.h>
+#include <iprt/initterm.h>
+#include <iprt/mem.h>
+#include <iprt/path.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+
+#include <zlib.h>
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/** Output buffer for tstStreamOutput. */
+typedef struct TSTBUF
+{
+    uint8_t    *pb;
+    size_t      cb;
+    size_t      cbAlloc;
+    /** Fail once cb would exceed this. */
+    size_t      cbFailAt;
+} TSTBUF;
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+static RTTEST   g_hTest;
+
+
+/**
+ * @callback_method_impl{FNDBGFCOREWRITE, Collects the core in a TSTBUF.}
+ */
+static DECLCALLBACK(int) tstStreamOutput(void *pvUser, const void *pvBuf, size_t cbBuf)
+{
+    TSTBUF *pBuf = (TSTBUF *)pvUser;
+    if (pBuf->cb + cbBuf > pBuf->cbFailAt)
+        return VERR_DISK_FULL;
+    if (pBuf->cb + cbBuf > pBuf->cbAlloc)
+    {
+        size_t cbNew = RT_ALIGN_Z(pBuf->cb + cbBuf, _4M);
+        void  *pvNew = RTMemRealloc(pBuf->pb, cbNew);
+        if (!pvNew)
+            return VERR_NO_MEMORY;
+        pBuf->pb      = (uint8_t *)pvNew;
+        pBuf->cbAlloc = cbNew;
+    }
+    memcpy(&pBuf->pb[pBuf->cb], pvBuf, cbBuf);
+    pBuf->cb += cbBuf;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Writes the core to a TSTBUF.
+ */
+static int tstStream(PUVM pUVM, uint32_t fFlags, TSTBUF *pBuf, size_t cbFailAt = ~(size_t)0)
+{
+    RT_ZERO(*pBuf);
+    pBuf->cbFailAt = cbFailAt;
+    return DBGFR3CoreWriteToStream(pUVM, tstStreamOutput, pBuf, fFlags);
+}
+
+
+/**
+ * Inflates the concatenated gzip members in @a pIn into @a pOut.
+ */
+static bool tstGunzip(TSTBUF const *pIn, TSTBUF *pOut)
+{
+    RT_ZERO(*pOut);
+    pOut->cbFailAt = ~(size_t)0;
+
+    size_t off = 0;
+    while (off < pIn->cb)
+    {
+        /* The writer puts out fixed size member headers. */
+        RTTESTI_CHECK_RET(pIn->cb - off > 10 + 8, false);
+        RTTESTI_CHECK_RET(pIn->pb[off] == 0x1f && pIn->pb[off + 1] == 0x8b && pIn->pb[off + 2] == 8, false);
+
+        z_stream Strm;
+        RT_ZERO(Strm);
+        RTTESTI_CHECK_RET(inflateInit2(&Strm, -MAX_WBITS) == Z_OK, false);
+        Strm.next_in  = &pIn->pb[off + 10];
+        Strm.avail_in = (uInt)(pIn->cb - off - 10);
+        int rcZlib;
+        do
+        {
+            uint8_t abBuf[_64K];
+            Strm.next_out  = abBuf;
+            Strm.avail_out = sizeof(abBuf);
+            rcZlib = inflate(&Strm, Z_NO_FLUSH);
+            if (RT_FAILURE(tstStreamOutput(pOut, abBuf, sizeof(abBuf) - Strm.avail_out)))
+                rcZlib = Z_MEM_ERROR;
+        } while (rcZlib == Z_OK);
+        off = Strm.next_in - pIn->pb + 8 /* trailer */;
+        inflateEnd(&Strm);
+        RTTESTI_CHECK_MSG_RET(rcZlib == Z_STREAM_END, ("rcZlib=%d\n", rcZlib), false);
+    }
+    RTTESTI_CHECK_RET(off == pIn->cb, false);
+    return true;
+}
+
+
+/**
+ * Compares the stream output with the file output.
+ */
+static void tstCoreWrite(PUVM pUVM)
+{
+    char szPath[RTPATH_MAX];
+    RTTESTI_CHECK_RC_RETV(RTPathTemp(szPath, sizeof(szPath)), VINF_SUCCESS);
+    RTTESTI_CHECK_RC_RETV(RTPathAppend(szPath, sizeof(szPath), "tstDBGFCoreWrite.core"), VINF_SUCCESS);
+
+    RTTestSub(g_hTest, "File");
+    RTTESTI_CHECK_RC_RETV(DBGFR3CoreWriteEx(pUVM, szPath, DBGFCORE_F_REPLACE_FILE), VINF_SUCCESS);
+    void  *pvFile;
+    size_t cbFile;
+    int rc = RTFileReadAll(szPath, &pvFile, &cbFile);
+    RTFileDelete(szPath);
+    RTTESTI_CHECK_RC_RETV(rc, VINF_SUCCESS);
+    RTTestIPrintf(RTTESTLVL_ALWAYS, "%'zu bytes\n", cbFile);
+
+    RTTestSub(g_hTest, "Stream");
+    TSTBUF Plain;
+    RTTESTI_CHECK_RC(rc = tstStream(pUVM, 0, &Plain), VINF_SUCCESS);
+    if (RT_SUCCESS(rc))
+        RTTESTI_CHECK(Plain.cb == cbFile && !memcmp(Plain.pb, pvFile, cbFile));
+    RTMemFree(Plain.pb);
+
+    /* Holes are for regular files only. */
+    TSTBUF Sparse;
+    RTTESTI_CHECK_RC(rc = tstStream(pUVM, DBGFCORE_F_SKIP_ZERO_PAGES, &Sparse), VINF_SUCCESS);
+    if (RT_SUCCESS(rc))
+        RTTESTI_CHECK(Sparse.cb == cbFile && !memcmp(Sparse.pb, pvFile, cbFile));
+    RTMemFree(Sparse.pb);
+
+    RTTestSub(g_hTest, "Compressed stream");
+    TSTBUF Zipped;
+    RTTESTI_CHECK_RC(rc = tstStream(pUVM, DBGFCORE_F_GZIP, &Zipped), VINF_SUCCESS);
+    TSTBUF Unzipped;
+    if (RT_SUCCESS(rc) && tstGunzip(&Zipped, &Unzipped))
+    {
+        RTTestIPrintf(RTTESTLVL_ALWAYS, "%'zu bytes compressed\n", Zipped.cb);
+        RTTESTI_CHECK(Unzipped.cb == cbFile && !memcmp(Unzipped.pb, pvFile, cbFile));
+        RTMemFree(Unzipped.pb);
+    }
+    RTMemFree(Zipped.pb);
+
+    RTTestSub(g_hTest, "Stream errors");
+    TSTBUF Failed;
+    RTTESTI_CHECK_RC(tstStream(pUVM, 0, &Failed, cbFile / 2), VERR_DISK_FULL);
+    RTMemFree(Failed.pb);
+    RTTESTI_CHECK_RC(tstStream(pUVM, DBGFCORE_F_GZIP, &Failed, _1K), VERR_DISK_FULL);
+    RTMemFree(Failed.pb);
+
+    RTFileReadAllFree(pvFile, cbFile);
+}
+
+
+static DECLCALLBACK(int) tstDBGFCoreWriteConfigConstructor(PUVM pUVM, PVM pVM, void *pvUser)
+{
+    NOREF(pUVM); NOREF(pvUser);
+    int rc = CFGMR3ConstructDefaultTree(pVM);
+    if (RT_SUCCESS(rc))
+    {
+        /* Not the default multiple of the compression block size. */
+        PCFGMNODE pRoot = CFGMR3GetRoot(pVM);
+        CFGMR3RemoveValue(pRoot, "RamSize");
+        rc = CFGMR3InsertInteger(pRoot, "RamSize", 24 * _1M + 5 * _4K);
+    }
+    return rc;
+}
+
+
+/**
+ *  Entry point.
+ */
+extern "C" DECLEXPORT(int) TrustedMain(int argc, char **argv, char **envp)
+{
+    NOREF(envp);
+    RTR3InitExe(argc, &argv, RTR3INIT_FLAGS_SUPLIB);
+    int rc = RTTestCreate("tstDBGFCoreWrite", &g_hTest);
+    if (RT_FAILURE(rc))
+        return RTEXITCODE_INIT;
+    RTTestBanner(g_hTest);
+
+    PUVM pUVM;
+    rc = VMR3Create(1, NULL, NULL, NULL, tstDBGFCoreWriteConfigConstructor, NULL, NULL, &pUVM);
+    if (RT_SUCCESS(rc))
+    {
+        tstCoreWrite(pUVM);
+
+        RTTESTI_CHECK_RC(VMR3PowerOff(pUVM), VINF_SUCCESS);
+        RTTESTI_CHECK_RC(VMR3Destroy(pUVM), VINF_SUCCESS);
+        VMR3ReleaseUVM(pUVM);
+    }
+    else
+        RTTestFailed(g_hTest, "VMR3Create failed: %Rrc\n", rc);
+
+    return RTTestSummaryAndDestroy(g_hTest);
+}
+
+
+#if !defined(VBOX_WITH_HARDENING) || !defined(RT_OS_WINDOWS)
+/**
+ * Main entry point.
+ */
+int main(int argc, char **argv, char **envp)
+{
+    return TrustedMain(argc, argv, envp);
+}
+#endif
+
@@ -0,0 +1,198 @@
+/* $Id$ */
+/** @file
+ * Testcase for the parallel gzip compressor of the guest core writer.
+ */
+
+/*
+ * Copyright (C) 2010-2015 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include "DBGFInternal.h"
+
+#include <VBox/err.h>
+#include <iprt/crc.h>
+#include <iprt/mem.h>
+#include <iprt/param.h>
+#include <iprt/rand.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+
+#include <zlib.h>
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/** The compressed output collected by tstOutput. */
+typedef struct TSTOUTPUT
+{
+    uint8_t    *pb;
+    size_t      cb;
+    size_t      cbAlloc;
+} TSTOUTPUT;
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+static RTTEST   g_hTest;
+
+
+/**
+ * @callback_method_impl{FNDBGFCOREWRITE, Collects the gzip members.}
+ */
+static DECLCALLBACK(int) tstOutput(void *pvUser, const void *pvBuf, size_t cbBuf)
+{
+    TSTOUTPUT *pOutput = (TSTOUTPUT *)pvUser;
+    if (pOutput->cb + cbBuf > pOutput->cbAlloc)
+    {
+        size_t cbNew = RT_ALIGN_Z(pOutput->cb + cbBuf, _1M);
+        void  *pvNew = RTMemRealloc(pOutput->pb, cbNew);
+        if (!pvNew)
+            return VERR_NO_MEMORY;
+        pOutput->pb      = (uint8_t *)pvNew;
+        pOutput->cbAlloc = cbNew;
+    }
+    memcpy(&pOutput->pb[pOutput->cb], pvBuf, cbBuf);
+    pOutput->cb += cbBuf;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * Inflates the gzip members one by one, checking that every member but the
+ * last holds a full block, that none is empty and that the result matches the
+ * input.
+ */
+static void tstVerify(TSTOUTPUT const *pOutput, uint8_t const *pbExpect, size_t cbExpect)
+{
+    uint8_t *pbBlock = (uint8_t *)RTMemAlloc(DBGFCORE_ZIP_BLOCK_SIZE);
+    RTTESTI_CHECK_RETV(pbBlock);
+
+    size_t offIn  = 0;
+    size_t offOut = 0;
+    while (offIn < pOutput->cb)
+    {
+        /* Our members have a fixed size header without optional fields. */
+        uint8_t const *pbMember = &pOutput->pb[offIn];
+        if (   pOutput->cb - offIn < 10 + 8
+            || pbMember[0] != 0x1f || pbMember[1] != 0x8b || pbMember[2] != 8 || pbMember[3] != 0)
+        {
+            RTTestIFailed("Bad gzip member header at %#zx\n", offIn);
+            break;
+        }
+
+        z_stream Strm;
+        RT_ZERO(Strm);
+        RTTESTI_CHECK_BREAK(inflateInit2(&Strm, -MAX_WBITS) == Z_OK);
+        Strm.next_in   = (Bytef *)pbMember + 10;
+        Strm.avail_in  = (uInt)(pOutput->cb - offIn - 10);
+        Strm.next_out  = pbBlock;
+        Strm.avail_out = DBGFCORE_ZIP_BLOCK_SIZE;
+        int rcZlib = inflate(&Strm, Z_FINISH);
+        size_t const cbBlock = Strm.total_out;
+        offIn = (size_t)((uint8_t *)Strm.next_in - pOutput->pb);
+        inflateEnd(&Strm);
+        if (rcZlib != Z_STREAM_END || pOutput->cb - offIn < 8)
+        {
+            RTTestIFailed("inflate failed at %#zx: %d\n", offIn, rcZlib);
+            break;
+        }
+
+        uint8_t const *pbTrailer = &pOutput->pb[offIn];
+        uint32_t const uCrc = RT_MAKE_U32_FROM_U8(pbTrailer[0], pbTrailer[1], pbTrailer[2], pbTrailer[3]);
+        uint32_t const cb   = RT_MAKE_U32_FROM_U8(pbTrailer[4], pbTrailer[5], pbTrailer[6], pbTrailer[7]);
+        offIn += 8;
+        RTTESTI_CHECK_MSG(cb == cbBlock, ("cb=%#x cbBlock=%#zx\n", cb, cbBlock));
+        RTTESTI_CHECK(uCrc == RTCrc32(pbBlock, cbBlock));
+        RTTESTI_CHECK_MSG(cbBlock == DBGFCORE_ZIP_BLOCK_SIZE || (cbBlock > 0 && offIn == pOutput->cb),
+                          ("Short member (%#zx bytes) at %#zx\n", cbBlock, offOut));
+        RTTESTI_CHECK_MSG_BREAK(offOut + cbBlock <= cbExpect,
+                                ("Too much output: %#zx + %#zx > %#zx\n", offOut, cbBlock, cbExpect));
+        RTTESTI_CHECK_MSG_BREAK(!memcmp(&pbExpect[offOut], pbBlock, cbBlock), ("Mismatch in block at %#zx\n", offOut));
+        offOut += cbBlock;
+    }
+    RTTESTI_CHECK_MSG(offOut == cbExpect, ("offOut=%#zx cbExpect=%#zx\n", offOut, cbExpect));
+
+    RTMemFree(pbBlock);
+}
+
+
+/**
+ * Compresses @a cb bytes in @a cbChunk sized writes and checks the output.
+ */
+static void tstCompress(uint8_t const *pbInput, size_t cb, size_t cbChunk, bool fZero)
+{
+    RTTestIPrintf(RTTESTLVL_ALWAYS, "cb=%#zx cbChunk=%#zx fZero=%RTbool\n", cb, cbChunk, fZero);
+
+    TSTOUTPUT Output;
+    RT_ZERO(Output);
+    PDBGFCOREZIP pZip;
+    int rc = dbgfR3CoreZipCreate(&pZip, tstOutput, &Output);
+    RTTESTI_CHECK_RC_RETV(rc, VINF_SUCCESS);
+
+    for (size_t off = 0; off < cb && RT_SUCCESS(rc); off += cbChunk)
+        rc = dbgfR3CoreZipWrite(pZip, &pbInput[off], RT_MIN(cbChunk, cb - off), fZero);
+    RTTESTI_CHECK_RC(rc, VINF_SUCCESS);
+    if (RT_SUCCESS(rc))
+    {
+        rc = dbgfR3CoreZipFlush(pZip);
+        RTTESTI_CHECK_RC(rc, VINF_SUCCESS);
+    }
+    dbgfR3CoreZipDestroy(pZip);
+
+    if (RT_SUCCESS(rc))
+        tstVerify(&Output, pbInput, cb);
+    RTMemFree(Output.pb);
+}
+
+
+int main()
+{
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstDBGFCoreZip", &g_hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(g_hTest);
+
+    /* Enough blocks to have every slot in flight a few times over. */
+    size_t const cbMax = 48 * DBGFCORE_ZIP_BLOCK_SIZE + PAGE_SIZE;
+    uint8_t *pbRandom = (uint8_t *)RTMemAlloc(cbMax);
+    uint8_t *pbZeros  = (uint8_t *)RTMemAllocZ(cbMax);
+    RTTESTI_CHECK_RET(pbRandom && pbZeros, RTTestSummaryAndDestroy(g_hTest));
+    RTRandBytes(pbRandom, cbMax);
+
+    RTTestSub(g_hTest, "Partial blocks");
+    tstCompress(pbRandom, 0, PAGE_SIZE, false);
+    tstCompress(pbRandom, 1, PAGE_SIZE, false);
+    tstCompress(pbRandom, DBGFCORE_ZIP_BLOCK_SIZE - 1, PAGE_SIZE, false);
+    tstCompress(pbRandom, DBGFCORE_ZIP_BLOCK_SIZE + 1, PAGE_SIZE, false);
+    tstCompress(pbRandom, 48 * DBGFCORE_ZIP_BLOCK_SIZE + PAGE_SIZE, PAGE_SIZE, false);
+
+    /* The flush must not resubmit blocks that are still being compressed. */
+    RTTestSub(g_hTest, "Exact multiples of the block size");
+    tstCompress(pbRandom, DBGFCORE_ZIP_BLOCK_SIZE, PAGE_SIZE, false);
+    tstCompress(pbRandom, 2 * DBGFCORE_ZIP_BLOCK_SIZE, DBGFCORE_ZIP_BLOCK_SIZE, false);
+    tstCompress(pbRandom, 48 * DBGFCORE_ZIP_BLOCK_SIZE, PAGE_SIZE, false);
+    tstCompress(pbRandom, 48 * DBGFCORE_ZIP_BLOCK_SIZE, 3 * DBGFCORE_ZIP_BLOCK_SIZE, false);
+
+    RTTestSub(g_hTest, "Zero blocks");
+    tstCompress(pbZeros, 48 * DBGFCORE_ZIP_BLOCK_SIZE, PAGE_SIZE, true);
+    tstCompress(pbZeros, 48 * DBGFCORE_ZIP_BLOCK_SIZE + PAGE_SIZE, PAGE_SIZE, true);
+
+    RTMemFree(pbRandom);
+    RTMemFree(pbZeros);
+    return RTTestSummaryAndDestroy(g_hTest);
+}
+
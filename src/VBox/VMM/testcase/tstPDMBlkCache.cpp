@@ -0,0 +1,518 @@
+/* $Id$ */
+/** @file
+ * PDM block cache testcase: ARC list transitions and the global budget.
+ */
+
+/*
+ * Copyright (C) 2010-2015 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include <VBox/vmm/vm.h>
+#include <VBox/vmm/vmm.h>
+#include <VBox/vmm/cfgm.h>
+#include <VBox/vmm/pdmblkcache.h>
+#include <VBox/vmm/stam.h>
+#include <VBox/err.h>
+#include <iprt/asm.h>
+#include <iprt/initterm.h>
+#include <iprt/mem.h>
+#include <iprt/sg.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** The size of a block, every access covers exactly one block. */
+#define TST_BLOCK_SIZE      _64K
+/** The number of blocks fitting into the cache. */
+#define TST_CACHE_BLOCKS    16
+/** The size of the cache. */
+#define TST_CACHE_SIZE      (TST_CACHE_BLOCKS * TST_BLOCK_SIZE)
+/** The number of blocks of the emulated medium of each endpoint. */
+#define TST_DISK_BLOCKS     64
+/** Maximum number of transfers pending at the same time. */
+#define TST_XFERS_MAX       64
+
+
+/*********************************************************************************************************************************
+*   Structures and Typedefs                                                                                                      *
+*********************************************************************************************************************************/
+/**
+ * An endpoint using the block cache.
+ */
+typedef struct TSTENDPOINT
+{
+    /** The block cache handle. */
+    PPDMBLKCACHE        pBlkCache;
+    /** The endpoint id. */
+    const char         *pszId;
+    /** The emulated medium. */
+    uint8_t            *pbDisk;
+    /** Seed for the data pattern. */
+    uint8_t             bSeed;
+} TSTENDPOINT;
+/** Pointer to an endpoint. */
+typedef TSTENDPOINT *PTSTENDPOINT;
+
+/**
+ * A transfer the block cache enqueued.
+ */
+typedef struct TSTXFER
+{
+    PTSTENDPOINT        pEp;
+    PPDMBLKCACHEIOXFER  hIoXfer;
+    PDMBLKCACHEXFERDIR  enmXferDir;
+    uint64_t            off;
+    size_t              cbXfer;
+    PCRTSGBUF           pSgBuf;
+} TSTXFER;
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+static RTTEST               g_hTest;
+/** The transfers waiting to be processed. */
+static TSTXFER              g_aXfers[TST_XFERS_MAX];
+/** Number of entries in g_aXfers. */
+static unsigned             g_cXfers;
+/** Number of requests the block cache completed asynchronously. */
+static uint32_t volatile    g_cReqsCompleted;
+/** Status of the last asynchronously completed request. */
+static int volatile         g_rcReqLast;
+
+
+/**
+ * @callback_method_impl{FNPDMBLKCACHEXFERCOMPLETEINT}
+ */
+static DECLCALLBACK(void) tstXferComplete(void *pvUserInt, void *pvUser, int rc)
+{
+    NOREF(pvUserInt); NOREF(pvUser);
+    ASMAtomicWriteS32(&g_rcReqLast, rc);
+    ASMAtomicIncU32(&g_cReqsCompleted);
+}
+
+
+/**
+ * @callback_method_impl{FNPDMBLKCACHEXFERENQUEUEINT,
+ *      Queues the transfer, it is processed by tstXfersProcess() later so the
+ *      cache can't rely on synchronous completion.}
+ */
+static DECLCALLBACK(int) tstXferEnqueue(void *pvUser, PDMBLKCACHEXFERDIR enmXferDir, uint64_t off, size_t cbXfer,
+                                        PCRTSGBUF pSgBuf, PPDMBLKCACHEIOXFER hIoXfer)
+{
+    PTSTENDPOINT pEp = (PTSTENDPOINT)pvUser;
+    AssertReturn(g_cXfers < RT_ELEMENTS(g_aXfers), VERR_OUT_OF_RESOURCES);
+    AssertReturn(off + cbXfer <= TST_DISK_BLOCKS * TST_BLOCK_SIZE, VERR_OUT_OF_RANGE);
+
+    TSTXFER *pXfer    = &g_aXfers[g_cXfers++];
+    pXfer->pEp        = pEp;
+    pXfer->hIoXfer    = hIoXfer;
+    pXfer->enmXferDir = enmXferDir;
+    pXfer->off        = off;
+    pXfer->cbXfer     = cbXfer;
+    pXfer->pSgBuf     = pSgBuf;
+    return VINF_SUCCESS;
+}
+
+
+/**
+ * @callback_method_impl{FNPDMBLKCACHEXFERENQUEUEDISCARDINT}
+ */
+static DECLCALLBACK(int) tstXferEnqueueDiscard(void *pvUser, PCRTRANGE paRanges, unsigned cRanges,
+                                               PPDMBLKCACHEIOXFER hIoXfer)
+{
+    NOREF(pvUser); NOREF(paRanges); NOREF(cRanges); NOREF(hIoXfer);
+    return VERR_NOT_SUPPORTED;
+}
+
+
+/**
+ * Processes all queued transfers, including the ones queued while completing
+ * others.
+ */
+static void tstXfersProcess(void)
+{
+    while (g_cXfers)
+    {
+        TSTXFER Xfer = g_aXfers[--g_cXfers];
+
+        RTSGBUF SgBuf;
+        RTSgBufClone(&SgBuf, Xfer.pSgBuf);
+        size_t cbCopied = Xfer.cbXfer;
+        if (Xfer.enmXferDir == PDMBLKCACHEXFERDIR_READ)
+            cbCopied = RTSgBufCopyFromBuf(&SgBuf, Xfer.pEp->pbDisk + Xfer.off, Xfer.cbXfer);
+        else if (Xfer.enmXferDir == PDMBLKCACHEXFERDIR_WRITE)
+            cbCopied = RTSgBufCopyToBuf(&SgBuf, Xfer.pEp->pbDisk + Xfer.off, Xfer.cbXfer);
+        RTTESTI_CHECK_MSG(cbCopied == Xfer.cbXfer, ("Short transfer at %RU64: %zu of %zu bytes\n",
+                                                    Xfer.off, cbCopied, Xfer.cbXfer));
+
+        PDMR3BlkCacheIoXferComplete(Xfer.pEp->pBlkCache, Xfer.hIoXfer, VINF_SUCCESS);
+    }
+}
+
+
+/**
+ * @callback_method_impl{FNSTAMR3ENUM, Fetches a U32 value.}
+ */
+static DECLCALLBACK(int) tstGetU32(const char *pszName, STAMTYPE enmType, void *pvSample, STAMUNIT enmUnit,
+                                   STAMVISIBILITY enmVisiblity, const char *pszDesc, void *pvUser)
+{
+    NOREF(pszName); NOREF(enmUnit); NOREF(enmVisiblity); NOREF(pszDesc);
+    if (enmType == STAMTYPE_U32)
+        *(uint32_t *)pvUser = *(uint32_t *)pvSample;
+    return 0;
+}
+
+
+/**
+ * Gets a statistics value of the block cache.
+ *
+ * @returns The value, UINT32_MAX if it doesn't exist.
+ * @param   pUVM        The user mode VM handle.
+ * @param   pEp         The endpoint, NULL for the global values.
+ * @param   pszName     The name of the value.
+ */
+static uint32_t tstGetStat(PUVM pUVM, PTSTENDPOINT pEp, const char *pszName)
+{
+    char szPat[128];
+    if (pEp)
+        RTStrPrintf(szPat, sizeof(szPat), "/PDM/BlkCache/%s/Cache/%s", pEp->pszId, pszName);
+    else
+        RTStrPrintf(szPat, sizeof(szPat), "/PDM/BlkCache/%s", pszName);
+
+    uint32_t u32 = UINT32_MAX;
+    int rc = STAMR3Enum(pUVM, szPat, tstGetU32, &u32);
+    RTTESTI_CHECK_RC(rc, VINF_SUCCESS);
+    RTTESTI_CHECK_MSG(u32 != UINT32_MAX, ("%s not found\n", szPat));
+    return u32;
+}
+
+
+/**
+ * Checks the sizes of the lists of an endpoint, in blocks.
+ */
+static void tstCheckLists(PUVM pUVM, PTSTENDPOINT pEp, uint32_t cT1, uint32_t cT2, uint32_t cB1, uint32_t cB2)
+{
+    uint32_t const cbT1 = tstGetStat(pUVM, pEp, "cbCachedMruIn");
+    uint32_t const cbT2 = tstGetStat(pUVM, pEp, "cbCachedFru");
+    uint32_t const cbB1 = tstGetStat(pUVM, pEp, "cbCachedMruOut");
+    uint32_t const cbB2 = tstGetStat(pUVM, pEp, "cbCachedFruOut");
+    RTTESTI_CHECK_MSG(   cbT1 == cT1 * TST_BLOCK_SIZE
+                      && cbT2 == cT2 * TST_BLOCK_SIZE
+                      && cbB1 == cB1 * TST_BLOCK_SIZE
+                      && cbB2 == cB2 * TST_BLOCK_SIZE,
+                      ("%s: T1=%u T2=%u B1=%u B2=%u blocks, expected %u/%u/%u/%u\n", pEp->pszId,
+                       cbT1 / TST_BLOCK_SIZE, cbT2 / TST_BLOCK_SIZE, cbB1 / TST_BLOCK_SIZE, cbB2 / TST_BLOCK_SIZE,
+                       cT1, cT2, cB1, cB2));
+    RTTESTI_CHECK_MSG(tstGetStat(pUVM, pEp, "cbCached") == cbT1 + cbT2,
+                      ("%s: cbCached doesn't match T1 + T2\n", pEp->pszId));
+}
+
+
+/**
+ * Fills a buffer with the data pattern of a block.
+ */
+static void tstFillBlock(PTSTENDPOINT pEp, uint32_t iBlock, uint8_t *pb)
+{
+    memset(pb, (uint8_t)(pEp->bSeed + iBlock * 7), TST_BLOCK_SIZE);
+}
+
+
+/**
+ * Reads or writes a block through the cache and waits for the completion.
+ */
+static void tstIo(PTSTENDPOINT pEp, bool fWrite, uint32_t iBlock)
+{
+    static uint8_t s_abBuf[TST_BLOCK_SIZE];
+    static uint8_t s_abExpected[TST_BLOCK_SIZE];
+    tstFillBlock(pEp, iBlock, s_abExpected);
+    if (fWrite)
+        memcpy(s_abBuf, s_abExpected, sizeof(s_abBuf));
+    else
+        memset(s_abBuf, 0xff, sizeof(s_abBuf));
+
+    RTSGSEG Seg;
+    Seg.pvSeg = s_abBuf;
+    Seg.cbSeg = sizeof(s_abBuf);
+    RTSGBUF SgBuf;
+    RTSgBufInit(&SgBuf, &Seg, 1);
+
+    uint32_t const cReqsCompleted = ASMAtomicReadU32(&g_cReqsCompleted);
+    uint64_t const off = (uint64_t)iBlock * TST_BLOCK_SIZE;
+    int rc = fWrite
+           ? PDMR3BlkCacheWrite(pEp->pBlkCache, off, &SgBuf, TST_BLOCK_SIZE, NULL)
+           : PDMR3BlkCacheRead(pEp->pBlkCache, off, &SgBuf, TST_BLOCK_SIZE, NULL);
+    tstXfersProcess();
+    if (rc == VINF_AIO_TASK_PENDING)
+    {
+        RTTESTI_CHECK_MSG_RETV(ASMAtomicReadU32(&g_cReqsCompleted) == cReqsCompleted + 1,
+                               ("%s: request for block %u didn't complete\n", pEp->pszId, iBlock));
+        rc = ASMAtomicReadS32(&g_rcReqLast);
+    }
+    RTTESTI_CHECK_MSG_RETV(rc == VINF_SUCCESS, ("%s: %s of block %u failed with %Rrc\n",
+                                                pEp->pszId, fWrite ? "write" : "read", iBlock, rc));
+
+    if (memcmp(s_abBuf, s_abExpected, sizeof(s_abBuf)))
+        RTTestIFailed("%s: data mismatch in block %u\n", pEp->pszId, iBlock);
+}
+
+
+static DECLCALLBACK(int) tstRetain(PVM pVM, PTSTENDPOINT pEp)
+{
+    return PDMR3BlkCacheRetainInt(pVM, pEp, &pEp->pBlkCache, tstXferComplete, tstXferEnqueue, tstXferEnqueueDiscard,
+                                  pEp->pszId);
+}
+
+
+static DECLCALLBACK(void) tstRelease(PTSTENDPOINT pEp)
+{
+    PDMR3BlkCacheRelease(pEp->pBlkCache);
+    pEp->pBlkCache = NULL;
+}
+
+
+/**
+ * Creates an endpoint.
+ */
+static bool tstEpCreate(PUVM pUVM, PVM pVM, PTSTENDPOINT pEp, const char *pszId, uint8_t bSeed)
+{
+    pEp->pszId  = pszId;
+    pEp->bSeed  = bSeed;
+    pEp->pbDisk = (uint8_t *)RTMemAllocZ(TST_DISK_BLOCKS * TST_BLOCK_SIZE);
+    RTTESTI_CHECK_RET(pEp->pbDisk, false);
+
+    int rc = VMR3ReqCallWaitU(pUVM, 0 /*idDstCpu*/, (PFNRT)tstRetain, 2, pVM, pEp);
+    RTTESTI_CHECK_RC_OK_RET(rc, false);
+    return true;
+}
+
+
+/**
+ * Destroys an endpoint.
+ */
+static void tstEpDestroy(PUVM pUVM, PTSTENDPOINT pEp)
+{
+    if (pEp->pBlkCache)
+    {
+        int rc = VMR3ReqCallWaitU(pUVM, 0 /*idDstCpu*/, (PFNRT)tstRelease, 1, pEp);
+        RTTESTI_CHECK_RC(rc, VINF_SUCCESS);
+    }
+    RTMemFree(pEp->pbDisk);
+    pEp->pbDisk = NULL;
+}
+
+
+/**
+ * Walks a single endpoint through the T1/T2/B1/B2 transitions.
+ */
+static void tstArc(PUVM pUVM, PVM pVM)
+{
+    RTTestSub(g_hTest, "ARC lists");
+
+    TSTENDPOINT Ep;
+    if (!tstEpCreate(pUVM, pVM, &Ep, "tstArc", 0x11))
+        return;
+
+    /* New blocks go to T1. */
+    for (uint32_t i = 0; i < TST_CACHE_BLOCKS; i++)
+        tstIo(&Ep, true /*fWrite*/, i);
+    tstCheckLists(pUVM, &Ep, 16, 0, 0, 0);
+
+    /* A second access promotes them to T2. */
+    for (uint32_t i = 0; i < 4; i++)
+        tstIo(&Ep, false /*fWrite*/, i);
+    tstCheckLists(pUVM, &Ep, 12, 4, 0, 0);
+
+    /* T1 is above its target of 0, so it gives up its oldest blocks 4..7 to B1. */
+    for (uint32_t i = 16; i < 20; i++)
+        tstIo(&Ep, true /*fWrite*/, i);
+    tstCheckLists(pUVM, &Ep, 12, 4, 4, 0);
+
+    /* A hit in B1 grows the T1 target, fetches the block into T2 and evicts block 8 from T1. */
+    tstIo(&Ep, false /*fWrite*/, 4);
+    tstCheckLists(pUVM, &Ep, 11, 5, 4, 0);
+    RTTESTI_CHECK(tstGetStat(pUVM, &Ep, "cbTargetMruIn") == TST_BLOCK_SIZE);
+
+    /* Move everything left in T1 to T2. */
+    for (uint32_t i = 9; i < 20; i++)
+        tstIo(&Ep, false /*fWrite*/, i);
+    tstCheckLists(pUVM, &Ep, 0, 16, 4, 0);
+
+    /* With T1 empty the least recently used block of T2 (block 0) goes to B2. */
+    tstIo(&Ep, true /*fWrite*/, 20);
+    tstCheckLists(pUVM, &Ep, 1, 15, 4, 1);
+
+    /* A hit in B2 shrinks the T1 target again and T1 pays for the fetch. */
+    tstIo(&Ep, false /*fWrite*/, 0);
+    tstCheckLists(pUVM, &Ep, 0, 16, 5, 0);
+    RTTESTI_CHECK(tstGetStat(pUVM, &Ep, "cbTargetMruIn") == 0);
+
+    /* All the blocks must still read back correctly, cached or not. */
+    for (uint32_t i = 0; i <= 20; i++)
+        tstIo(&Ep, false /*fWrite*/, i);
+
+    tstEpDestroy(pUVM, &Ep);
+    RTTESTI_CHECK(tstGetStat(pUVM, NULL, "cbCached") == 0);
+}
+
+
+/**
+ * Checks that the endpoints never exceed the global budget together.
+ */
+static void tstCheckBudget(PUVM pUVM, PTSTENDPOINT paEps, unsigned cEps)
+{
+    uint32_t cbSum = 0;
+    for (unsigned i = 0; i < cEps; i++)
+        cbSum += tstGetStat(pUVM, &paEps[i], "cbCached");
+    uint32_t const cbGlobal = tstGetStat(pUVM, NULL, "cbCached");
+    RTTESTI_CHECK_MSG(cbSum == cbGlobal, ("Endpoints cache %u bytes, the global count is %u\n", cbSum, cbGlobal));
+    RTTESTI_CHECK_MSG(cbGlobal <= TST_CACHE_SIZE, ("%u bytes cached, the limit is %u\n", cbGlobal, TST_CACHE_SIZE));
+}
+
+
+/**
+ * Shares the cache between several endpoints.
+ */
+static void tstBudget(PUVM pUVM, PVM pVM)
+{
+    RTTestSub(g_hTest, "Global budget");
+
+    TSTENDPOINT aEps[3];
+    RT_ZERO(aEps);
+    if (   !tstEpCreate(pUVM, pVM, &aEps[0], "tstBudgetA", 0x21)
+        || !tstEpCreate(pUVM, pVM, &aEps[1], "tstBudgetB", 0x42))
+    {
+        tstEpDestroy(pUVM, &aEps[0]);
+        tstEpDestroy(pUVM, &aEps[1]);
+        return;
+    }
+    RTTESTI_CHECK(tstGetStat(pUVM, &aEps[0], "cbMin") == TST_CACHE_SIZE / 2);
+
+    /* Nobody else uses the cache, A may take all of it. */
+    for (uint32_t i = 0; i < TST_CACHE_BLOCKS; i++)
+        tstIo(&aEps[0], true /*fWrite*/, i);
+    RTTESTI_CHECK(tstGetStat(pUVM, &aEps[0], "cbCached") == TST_CACHE_SIZE);
+    tstCheckBudget(pUVM, aEps, 2);
+
+    /* B is below its fair share and takes the space from A. */
+    for (uint32_t i = 0; i < 8; i++)
+        tstIo(&aEps[1], true /*fWrite*/, i);
+    RTTESTI_CHECK(tstGetStat(pUVM, &aEps[0], "cbCached") == TST_CACHE_SIZE / 2);
+    RTTESTI_CHECK(tstGetStat(pUVM, &aEps[1], "cbCached") == TST_CACHE_SIZE / 2);
+    tstCheckBudget(pUVM, aEps, 2);
+
+    /* Beyond its fair share B has to evict its own blocks. */
+    for (uint32_t i = 8; i < 12; i++)
+        tstIo(&aEps[1], true /*fWrite*/, i);
+    tstCheckLists(pUVM, &aEps[1], 8, 0, 4, 0);
+    RTTESTI_CHECK(tstGetStat(pUVM, &aEps[0], "cbCached") == TST_CACHE_SIZE / 2);
+    tstCheckBudget(pUVM, aEps, 2);
+
+    /* A third endpoint lowers the fair share of the others and gets its part. */
+    if (tstEpCreate(pUVM, pVM, &aEps[2], "tstBudgetC", 0x63))
+    {
+        uint32_t const cbMin = tstGetStat(pUVM, &aEps[0], "cbMin");
+        RTTESTI_CHECK(cbMin == TST_CACHE_SIZE / 3);
+        RTTESTI_CHECK(tstGetStat(pUVM, &aEps[2], "cbMin") == cbMin);
+
+        for (uint32_t i = 0; i < 4; i++)
+            tstIo(&aEps[2], true /*fWrite*/, i);
+        tstCheckLists(pUVM, &aEps[2], 4, 0, 0, 0);
+        RTTESTI_CHECK(tstGetStat(pUVM, NULL, "cbCached") == TST_CACHE_SIZE);
+        for (unsigned i = 0; i < 2; i++)
+            RTTESTI_CHECK_MSG(tstGetStat(pUVM, &aEps[i], "cbCached") + TST_BLOCK_SIZE > cbMin,
+                              ("%s was pushed below its fair share\n", aEps[i].pszId));
+        tstCheckBudget(pUVM, aEps, 3);
+
+        /* Everything written must still be readable, whether it was evicted or not. */
+        for (unsigned i = 0; i < 3; i++)
+            for (uint32_t iBlock = 0; iBlock < 4; iBlock++)
+                tstIo(&aEps[i], false /*fWrite*/, iBlock);
+        tstCheckBudget(pUVM, aEps, 3);
+
+        tstEpDestroy(pUVM, &aEps[2]);
+        RTTESTI_CHECK(tstGetStat(pUVM, &aEps[0], "cbMin") == TST_CACHE_SIZE / 2);
+    }
+
+    tstEpDestroy(pUVM, &aEps[0]);
+    tstEpDestroy(pUVM, &aEps[1]);
+    RTTESTI_CHECK(tstGetStat(pUVM, NULL, "cbCached") == 0);
+}
+
+
+static DECLCALLBACK(int) tstConfigConstructor(PUVM pUVM, PVM pVM, void *pvUser)
+{
+    NOREF(pUVM); NOREF(pvUser);
+    int rc = CFGMR3ConstructDefaultTree(pVM);
+    if (RT_SUCCESS(rc))
+    {
+        /* A small cache committing right away and no scan detection keep the list sizes predictable. */
+        PCFGMNODE pBlkCache;
+        rc = CFGMR3InsertNode(CFGMR3GetChild(CFGMR3GetRoot(pVM), "PDM"), "BlkCache", &pBlkCache);
+        if (RT_SUCCESS(rc))
+            rc = CFGMR3InsertInteger(pBlkCache, "CacheSize", TST_CACHE_SIZE);
+        if (RT_SUCCESS(rc))
+            rc = CFGMR3InsertInteger(pBlkCache, "ScanThreshold", 0);
+        if (RT_SUCCESS(rc))
+            rc = CFGMR3InsertInteger(pBlkCache, "CacheCommitIntervalMs", 0);
+    }
+    return rc;
+}
+
+
+/**
+ *  Entry point.
+ */
+extern "C" DECLEXPORT(int) TrustedMain(int argc, char **argv, char **envp)
+{
+    NOREF(envp);
+    RTR3InitExe(argc, &argv, RTR3INIT_FLAGS_SUPLIB);
+    int rc = RTTestCreate("tstPDMBlkCache", &g_hTest);
+    if (RT_FAILURE(rc))
+        return RTEXITCODE_INIT;
+    RTTestBanner(g_hTest);
+
+    PUVM pUVM;
+    rc = VMR3Create(1, NULL, NULL, NULL, tstConfigConstructor, NULL, NULL, &pUVM);
+    if (RT_SUCCESS(rc))
+    {
+        PVM pVM = VMR3GetVM(pUVM);
+        tstArc(pUVM, pVM);
+        tstBudget(pUVM, pVM);
+
+        RTTESTI_CHECK_RC(VMR3PowerOff(pUVM), VINF_SUCCESS);
+        RTTESTI_CHECK_RC(VMR3Destroy(pUVM), VINF_SUCCESS);
+        VMR3ReleaseUVM(pUVM);
+    }
+    else
+        RTTestFailed(g_hTest, "VMR3Create failed: %Rrc\n", rc);
+
+    return RTTestSummaryAndDestroy(g_hTest);
+}
+
+
+#if !defined(VBOX_WITH_HARDENING) || !defined(RT_OS_WINDOWS)
+/**
+ * Main entry point.
+ */
+int main(int argc, char **argv, char **envp)
+{
+    return TrustedMain(argc, argv, envp);
+}
+#endif
+
@@ -0,0 +1,250 @@
+/* $Id$ */
+/** @file
+ * PDM queue testcase: worker thread wakeups and batching.
+ */
+
+/*
+ * Copyright (C) 2010-2015 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include <VBox/vmm/vm.h>
+#include <VBox/vmm/vmm.h>
+#include <VBox/vmm/pdmqueue.h>
+#include <VBox/vmm/stam.h>
+#include <VBox/err.h>
+#include <iprt/asm.h>
+#include <iprt/initterm.h>
+#include <iprt/semaphore.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+#include <iprt/thread.h>
+#include <iprt/time.h>
+
+
+/*********************************************************************************************************************************
+*   Defined Constants And Macros                                                                                                 *
+*********************************************************************************************************************************/
+/** The name of the test queue. */
+#define TST_QUEUE_NAME      "tstPDMQueue"
+/** The number of items in the test queue. */
+#define TST_QUEUE_ITEMS     16
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+static RTTEST               g_hTest;
+/** The thread the test is running on. */
+static RTTHREAD             g_hTestThread;
+/** Number of items consumed. */
+static uint32_t volatile    g_cConsumed;
+/** Number of items consumed on the test thread or an EMT. */
+static uint32_t volatile    g_cConsumedWrongThread;
+/** Makes the consumer block on the next item until g_hEvtRelease is signalled. */
+static bool volatile        g_fBlockNext;
+/** Signalled by the consumer when it blocks. */
+static RTSEMEVENT           g_hEvtEntered;
+/** Signalled by the test to let a blocked consumer continue. */
+static RTSEMEVENT           g_hEvtRelease;
+
+
+/**
+ * @callback_method_impl{FNPDMQUEUEEXT}
+ */
+static DECLCALLBACK(bool) tstConsumer(void *pvUser, PPDMQUEUEITEMCORE pItem)
+{
+    PVM pVM = (PVM)pvUser;
+    NOREF(pItem);
+
+    if (   RTThreadSelf() == g_hTestThread
+        || VMMGetCpu(pVM) != NULL)
+        ASMAtomicIncU32(&g_cConsumedWrongThread);
+
+    if (ASMAtomicXchgBool(&g_fBlockNext, false))
+    {
+        RTSemEventSignal(g_hEvtEntered);
+        RTSemEventWait(g_hEvtRelease, RT_INDEFINITE_WAIT);
+    }
+
+    ASMAtomicIncU32(&g_cConsumed);
+    return true;
+}
+
+
+/**
+ * @callback_method_impl{FNSTAMR3ENUM, Fetches a counter value.}
+ */
+static DECLCALLBACK(int) tstGetCounter(const char *pszName, STAMTYPE enmType, void *pvSample, STAMUNIT enmUnit,
+                                       STAMVISIBILITY enmVisiblity, const char *pszDesc, void *pvUser)
+{
+    NOREF(pszName); NOREF(enmUnit); NOREF(enmVisiblity); NOREF(pszDesc);
+    if (enmType == STAMTYPE_COUNTER)
+        *(uint64_t *)pvUser = ((PSTAMCOUNTER)pvSample)->c;
+    return 0;
+}
+
+
+/**
+ * Gets the number of times the queue worker thread was woken up.
+ */
+static uint64_t tstGetWakeups(PUVM pUVM)
+{
+    uint64_t cWakeups = UINT64_MAX;
+    int rc = STAMR3Enum(pUVM, "/PDM/Queue/" TST_QUEUE_NAME "/WorkerWakeups", tstGetCounter, &cWakeups);
+    RTTESTI_CHECK_RC(rc, VINF_SUCCESS);
+    RTTESTI_CHECK(cWakeups != UINT64_MAX);
+    return cWakeups;
+}
+
+
+/**
+ * Waits for the consumer to have processed @a cItems items.
+ */
+static bool tstWaitConsumed(uint32_t cItems)
+{
+    uint64_t const msStart = RTTimeMilliTS();
+    while (ASMAtomicReadU32(&g_cConsumed) < cItems)
+    {
+        if (RTTimeMilliTS() - msStart > 10000)
+        {
+            RTTestIFailed("Only %u of %u items consumed after 10s\n", ASMAtomicReadU32(&g_cConsumed), cItems);
+            return false;
+        }
+        RTThreadSleep(1);
+    }
+    return true;
+}
+
+
+/**
+ * Inserts @a cItems items into the queue.
+ */
+static void tstInsert(PPDMQUEUE pQueue, uint32_t cItems)
+{
+    for (uint32_t i = 0; i < cItems; i++)
+    {
+        PPDMQUEUEITEMCORE pItem = PDMQueueAlloc(pQueue);
+        RTTESTI_CHECK_RETV(pItem);
+        PDMQueueInsert(pQueue, pItem);
+    }
+}
+
+
+static DECLCALLBACK(int) tstCreateQueue(PVM pVM, PPDMQUEUE *ppQueue)
+{
+    return PDMR3QueueCreateExternal(pVM, sizeof(PDMQUEUEITEMCORE), TST_QUEUE_ITEMS, PDMQUEUE_INTERVAL_WORKER_THREAD,
+                                    tstConsumer, pVM, TST_QUEUE_NAME, ppQueue);
+}
+
+
+static DECLCALLBACK(int) tstDestroyQueue(PPDMQUEUE pQueue)
+{
+    return PDMR3QueueDestroy(pQueue);
+}
+
+
+/**
+ * Checks that inserting items wakes the worker thread and that it drains
+ * whatever piled up while it was busy in a single go.
+ */
+static void tstQueue(PUVM pUVM, PVM pVM)
+{
+    PPDMQUEUE pQueue = NULL;
+    int rc = VMR3ReqCallWaitU(pUVM, 0 /*idDstCpu*/, (PFNRT)tstCreateQueue, 2, pVM, &pQueue);
+    RTTESTI_CHECK_RC_RETV(rc, VINF_SUCCESS);
+
+    RTTestSub(g_hTest, "Wakeup");
+    uint64_t cWakeups = tstGetWakeups(pUVM);
+    tstInsert(pQueue, 1);
+    if (tstWaitConsumed(1))
+    {
+        RTTESTI_CHECK(ASMAtomicReadU32(&g_cConsumedWrongThread) == 0);
+        uint64_t const cNew = tstGetWakeups(pUVM);
+        RTTESTI_CHECK_MSG(cNew - cWakeups <= 1, ("%RU64 wakeups for one item\n", cNew - cWakeups));
+    }
+
+    RTTestSub(g_hTest, "Batching");
+    ASMAtomicWriteBool(&g_fBlockNext, true);
+    tstInsert(pQueue, 1);
+    rc = RTSemEventWait(g_hEvtEntered, 10000);
+    RTTESTI_CHECK_RC(rc, VINF_SUCCESS);
+    if (RT_SUCCESS(rc))
+    {
+        /* The worker is busy with the first item; the rest must not need a wakeup each. */
+        cWakeups = tstGetWakeups(pUVM);
+        tstInsert(pQueue, TST_QUEUE_ITEMS - 1);
+        RTSemEventSignal(g_hEvtRelease);
+        if (tstWaitConsumed(1 + TST_QUEUE_ITEMS))
+        {
+            RTTESTI_CHECK(ASMAtomicReadU32(&g_cConsumedWrongThread) == 0);
+            uint64_t const cNew = tstGetWakeups(pUVM);
+            RTTESTI_CHECK_MSG(cNew - cWakeups <= 1, ("%RU64 wakeups for %u items\n", cNew - cWakeups, TST_QUEUE_ITEMS - 1));
+        }
+    }
+    else
+        RTSemEventSignal(g_hEvtRelease);
+
+    RTTestSub(g_hTest, "Destroy");
+    tstInsert(pQueue, 1);
+    rc = VMR3ReqCallWaitU(pUVM, 0 /*idDstCpu*/, (PFNRT)tstDestroyQueue, 1, pQueue);
+    RTTESTI_CHECK_RC(rc, VINF_SUCCESS);
+}
+
+
+/**
+ *  Entry point.
+ */
+extern "C" DECLEXPORT(int) TrustedMain(int argc, char **argv, char **envp)
+{
+    NOREF(envp);
+    RTR3InitExe(argc, &argv, RTR3INIT_FLAGS_SUPLIB);
+    int rc = RTTestCreate("tstPDMQueue", &g_hTest);
+    if (RT_FAILURE(rc))
+        return RTEXITCODE_INIT;
+    RTTestBanner(g_hTest);
+    g_hTestThread = RTThreadSelf();
+
+    RTTESTI_CHECK_RC_RET(RTSemEventCreate(&g_hEvtEntered), VINF_SUCCESS, RTTestSummaryAndDestroy(g_hTest));
+    RTTESTI_CHECK_RC_RET(RTSemEventCreate(&g_hEvtRelease), VINF_SUCCESS, RTTestSummaryAndDestroy(g_hTest));
+
+    PUVM pUVM;
+    rc = VMR3Create(1, NULL, NULL, NULL, NULL, NULL, NULL, &pUVM);
+    if (RT_SUCCESS(rc))
+    {
+        tstQueue(pUVM, VMR3GetVM(pUVM));
+
+        RTTESTI_CHECK_RC(VMR3PowerOff(pUVM), VINF_SUCCESS);
+        RTTESTI_CHECK_RC(VMR3Destroy(pUVM), VINF_SUCCESS);
+        VMR3ReleaseUVM(pUVM);
+    }
+    else
+        RTTestFailed(g_hTest, "VMR3Create failed: %Rrc\n", rc);
+
+    RTSemEventDestroy(g_hEvtEntered);
+    RTSemEventDestroy(g_hEvtRelease);
+    return RTTestSummaryAndDestroy(g_hTest);
+}
+
+
+#if !defined(VBOX_WITH_HARDENING) || !defined(RT_OS_WINDOWS)
+/**
+ * Main entry point.
+ */
+int main(int argc, char **argv, char **envp)
+{
+    return TrustedMain(argc, argv, envp);
+}
+#endif
+
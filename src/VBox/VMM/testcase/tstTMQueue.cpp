@@ -0,0 +1,273 @@
+/* $Id$ */
+/** @file
+ * Testcase for the TM active timer queue linking, with re-arm benchmark.
+ */
+
+/*
+ * Copyright (C) 2006-2015 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include <VBox/vmm/tm.h>
+#include <VBox/vmm/dbgftrace.h>
+#include "TMInternal.h"
+#include <VBox/vmm/vm.h>
+
+#include <VBox/err.h>
+#include <iprt/asm.h>
+#include <iprt/mem.h>
+#include <iprt/rand.h>
+#include <iprt/string.h>
+#include <iprt/test.h>
+#include <iprt/time.h>
+
+#include "TMInline.h"
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+/** The maximum number of timers we test with. */
+#define TST_MAX_TIMERS      1000
+
+/** The test handle. */
+static RTTEST               g_hTest;
+/** The queue, followed by TST_MAX_TIMERS timers in the same allocation so
+ * that the relative offsets work like they do on the hyper heap. */
+static PTMTIMERQUEUE        g_pQueue;
+/** The timer array. */
+static PTMTIMER             g_paTimers;
+/** Pre-generated re-arm operations for the benchmark. */
+static struct
+{
+    uint32_t                iTimer;
+    uint32_t                cNsDelta;
+}                           g_aRearms[4096];
+
+
+/**
+ * Reference implementation: the plain sorted list insertion that the express
+ * lanes replaced.
+ */
+static void tstLinearLink(PTMTIMERQUEUE pQueue, PTMTIMER pTimer, uint64_t u64Expire)
+{
+    PTMTIMER pPrev = NULL;
+    PTMTIMER pCur  = TMTIMER_GET_HEAD(pQueue);
+    while (pCur && pCur->u64Expire <= u64Expire)
+    {
+        pPrev = pCur;
+        pCur  = TMTIMER_GET_NEXT(pCur);
+    }
+    TMTIMER_SET_NEXT(pTimer, pCur);
+    TMTIMER_SET_PREV(pTimer, pPrev);
+    if (pCur)
+        TMTIMER_SET_PREV(pCur, pTimer);
+    if (pPrev)
+        TMTIMER_SET_NEXT(pPrev, pTimer);
+    else
+    {
+        TMTIMER_SET_HEAD(pQueue, pTimer);
+        pQueue->u64Expire = u64Expire;
+    }
+}
+
+
+/**
+ * Reference implementation: unlink without express lanes.
+ */
+static void tstLinearUnlink(PTMTIMERQUEUE pQueue, PTMTIMER pTimer)
+{
+    const PTMTIMER pPrev = TMTIMER_GET_PREV(pTimer);
+    const PTMTIMER pNext = TMTIMER_GET_NEXT(pTimer);
+    if (pPrev)
+        TMTIMER_SET_NEXT(pPrev, pNext);
+    else
+    {
+        TMTIMER_SET_HEAD(pQueue, pNext);
+        pQueue->u64Expire = pNext ? pNext->u64Expire : INT64_MAX;
+    }
+    if (pNext)
+        TMTIMER_SET_PREV(pNext, pPrev);
+    pTimer->offNext = 0;
+    pTimer->offPrev = 0;
+}
+
+
+/**
+ * Resets the queue and all the timers.
+ */
+static void tstReset(void)
+{
+    RT_BZERO(g_pQueue, sizeof(*g_pQueue));
+    g_pQueue->enmClock  = TMCLOCK_VIRTUAL;
+    g_pQueue->u64Expire = INT64_MAX;
+    RT_BZERO(g_paTimers, sizeof(g_paTimers[0]) * TST_MAX_TIMERS);
+    for (unsigned i = 0; i < TST_MAX_TIMERS; i++)
+    {
+        g_paTimers[i].enmClock = TMCLOCK_VIRTUAL;
+        g_paTimers[i].enmState = TMTIMERSTATE_ACTIVE;
+        g_paTimers[i].pszDesc  = "tstTMQueue";
+    }
+}
+
+
+/**
+ * Checks that the active list and the express lanes are consistent.
+ */
+static void tstCheckQueue(unsigned cTimers)
+{
+    /* The chain. */
+    unsigned cFound = 0;
+    PTMTIMER pPrev  = NULL;
+    for (PTMTIMER pCur = TMTIMER_GET_HEAD(g_pQueue); pCur; pPrev = pCur, pCur = TMTIMER_GET_NEXT(pCur))
+    {
+        RTTESTI_CHECK_RETV(TMTIMER_GET_PREV(pCur) == pPrev);
+        RTTESTI_CHECK_RETV(!pPrev || pPrev->u64Expire <= pCur->u64Expire);
+        cFound++;
+    }
+    RTTESTI_CHECK_MSG(cFound == cTimers, ("cFound=%u cTimers=%u\n", cFound, cTimers));
+    PTMTIMER pHead = TMTIMER_GET_HEAD(g_pQueue);
+    RTTESTI_CHECK(g_pQueue->u64Expire == (pHead ? pHead->u64Expire : INT64_MAX));
+
+    /* The lanes must be ordered subsets of the level below. */
+    for (unsigned iLvl = 0; iLvl < TMTIMER_SKIP_LEVELS; iLvl++)
+    {
+        PTMTIMER pBelow = iLvl ? TMTIMER_GET_SKIP_HEAD(g_pQueue, iLvl - 1) : TMTIMER_GET_HEAD(g_pQueue);
+        pPrev = NULL;
+        for (PTMTIMER pCur = TMTIMER_GET_SKIP_HEAD(g_pQueue, iLvl); pCur; pPrev = pCur, pCur = TMTIMER_GET_SKIP_NEXT(pCur, iLvl))
+        {
+            RTTESTI_CHECK_RETV(TMTIMER_GET_SKIP_PREV(pCur, iLvl) == pPrev);
+            RTTESTI_CHECK_RETV(tmTimerSkipLevels(g_pQueue, pCur) > iLvl);
+            while (pBelow && pBelow != pCur)
+                pBelow = iLvl ? TMTIMER_GET_SKIP_NEXT(pBelow, iLvl - 1) : TMTIMER_GET_NEXT(pBelow);
+            RTTESTI_CHECK_RETV(pBelow == pCur);
+        }
+    }
+}
+
+
+/**
+ * Arms @a cTimers timers and re-arms random ones @a cIterations times.
+ */
+static void tstRearm(unsigned cTimers, unsigned cIterations, bool fLinear)
+{
+    tstReset();
+
+    uint64_t uNow = 0;
+    for (unsigned i = 0; i < cTimers; i++)
+    {
+        uint64_t u64Expire = RTRandU64Ex(1, 10000000);
+        g_paTimers[i].u64Expire = u64Expire;
+        if (fLinear)
+            tstLinearLink(g_pQueue, &g_paTimers[i], u64Expire);
+        else
+            tmTimerQueueLinkActive(g_pQueue, &g_paTimers[i], u64Expire);
+    }
+    if (!fLinear)
+        tstCheckQueue(cTimers);
+
+    /* Pick the victims and their new deadlines up front so we only time the queue operations. */
+    for (unsigned i = 0; i < RT_ELEMENTS(g_aRearms); i++)
+    {
+        g_aRearms[i].iTimer   = RTRandU32Ex(0, cTimers - 1);
+        g_aRearms[i].cNsDelta = RTRandU32Ex(1, 10000000);
+    }
+
+    uint64_t const nsStart = RTTimeNanoTS();
+    for (unsigned i = 0; i < cIterations; i++)
+    {
+        PTMTIMER pTimer    = &g_paTimers[g_aRearms[i % RT_ELEMENTS(g_aRearms)].iTimer];
+        uint64_t u64Expire = uNow + g_aRearms[i % RT_ELEMENTS(g_aRearms)].cNsDelta;
+        uNow += 1000;
+        if (fLinear)
+        {
+            tstLinearUnlink(g_pQueue, pTimer);
+            pTimer->u64Expire = u64Expire;
+            tstLinearLink(g_pQueue, pTimer, u64Expire);
+        }
+        else
+        {
+            tmTimerQueueUnlink(g_pQueue, pTimer);
+            pTimer->u64Expire = u64Expire;
+            tmTimerQueueLinkActive(g_pQueue, pTimer, u64Expire);
+        }
+    }
+    uint64_t const cNsElapsed = RTTimeNanoTS() - nsStart;
+
+    if (!fLinear)
+        tstCheckQueue(cTimers);
+    RTTestValueF(g_hTest, cNsElapsed / cIterations, RTTESTUNIT_NS_PER_CALL, "%s re-arm, %u timers",
+                 fLinear ? "Linear" : "Skip list", cTimers);
+}
+
+
+/**
+ * Drains the queue from the head like tmR3TimerQueueRun does.
+ */
+static void tstDrain(unsigned cTimers)
+{
+    tstReset();
+    for (unsigned i = 0; i < cTimers; i++)
+    {
+        uint64_t u64Expire = RTRandU64Ex(1, 1000); /* plenty of duplicates */
+        g_paTimers[i].u64Expire = u64Expire;
+        tmTimerQueueLinkActive(g_pQueue, &g_paTimers[i], u64Expire);
+    }
+    tstCheckQueue(cTimers);
+
+    uint64_t u64Last = 0;
+    for (unsigned i = 0; i < cTimers; i++)
+    {
+        PTMTIMER pHead = TMTIMER_GET_HEAD(g_pQueue);
+        RTTESTI_CHECK_RETV(pHead);
+        RTTESTI_CHECK_RETV(pHead->u64Expire >= u64Last);
+        RTTESTI_CHECK_RETV(g_pQueue->u64Expire == pHead->u64Expire);
+        u64Last = pHead->u64Expire;
+        tmTimerQueueUnlink(g_pQueue, pHead);
+    }
+    RTTESTI_CHECK(!TMTIMER_GET_HEAD(g_pQueue));
+    RTTESTI_CHECK(g_pQueue->u64Expire == INT64_MAX);
+    for (unsigned iLvl = 0; iLvl < TMTIMER_SKIP_LEVELS; iLvl++)
+        RTTESTI_CHECK(!g_pQueue->aoffSkipHead[iLvl]);
+}
+
+
+int main()
+{
+    RTEXITCODE rcExit = RTTestInitAndCreate("tstTMQueue", &g_hTest);
+    if (rcExit != RTEXITCODE_SUCCESS)
+        return rcExit;
+    RTTestBanner(g_hTest);
+
+    uint8_t *pb = (uint8_t *)RTMemAllocZ(sizeof(TMTIMERQUEUE) + sizeof(TMTIMER) * TST_MAX_TIMERS);
+    RTTESTI_CHECK_RET(pb, RTTestSummaryAndDestroy(g_hTest));
+    g_pQueue   = (PTMTIMERQUEUE)pb;
+    g_paTimers = (PTMTIMER)(pb + sizeof(TMTIMERQUEUE));
+
+    RTTestSub(g_hTest, "Ordering");
+    tstDrain(10);
+    tstDrain(TST_MAX_TIMERS);
+
+    static unsigned const s_acTimers[] = { 10, 100, 1000 };
+    RTTestSub(g_hTest, "Re-arm benchmark");
+    for (unsigned i = 0; i < RT_ELEMENTS(s_acTimers); i++)
+    {
+        tstRearm(s_acTimers[i], _256K, true /*fLinear*/);
+        tstRearm(s_acTimers[i], _256K, false /*fLinear*/);
+    }
+
+    RTMemFree(pb);
+    return RTTestSummaryAndDestroy(g_hTest);
+}
+
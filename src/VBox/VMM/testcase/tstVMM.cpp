@@ -22,6 +22,8 @@
 #include <VBox/vmm/vm.h>
 #include <VBox/vmm/vmm.h>
 #include <VBox/vmm/cpum.h>
+#include <VBox/vmm/mm.h>
+#include <VBox/vmm/pgm.h>
 #include <VBox/vmm/tm.h>
 #include <VBox/vmm/pdmapi.h>
 #include <VBox/err.h>
@@ -36,6 +38,7 @@
 #include <iprt/string.h>
 #include <iprt/test.h>
 #include <iprt/thread.h>
+#include <iprt/time.h>
 
 
 /*********************************************************************************************************************************
@@ -140,6 +143,55 @@ DECLCALLBACK(int) tstTMWorker(PVM pVM, RTTEST hTest)
 }
 
 
+/**
+ * This is called on an EMT and measures guest physical memory access the way
+ * device DMA does it (PGMPhysRead / PGMPhysWrite), which exercises the RAM
+ * range and page mapping TLBs.
+ *
+ * @returns VINF_SUCCESS, test failure is reported via RTTEST.
+ * @param   pVM         Pointer to the VM.
+ * @param   hTest       The test handle.
+ */
+DECLCALLBACK(int) tstPhysWorker(PVM pVM, RTTEST hTest)
+{
+    uint64_t const cbRam  = MMR3PhysGetRamSize(pVM);
+    uint32_t const cPages = (uint32_t)RT_MIN(cbRam >> PAGE_SHIFT, _1M);
+    RTTEST_CHECK_RET(hTest, cPages >= 16, VERR_OUT_OF_RANGE);
+
+    /*
+     * Working sets of increasing size, walked with a page stride that spreads
+     * the accesses over all the TLB sets.
+     */
+    static uint32_t const s_acWorkingSetPages[] = { 16, 256, 1024, 8192, 32768 };
+    uint8_t               abBuf[512];
+    for (unsigned iSet = 0; iSet < RT_ELEMENTS(s_acWorkingSetPages); iSet++)
+    {
+        uint32_t const cWsPages = RT_MIN(s_acWorkingSetPages[iSet], cPages);
+        uint32_t const cLoops   = 1000000;
+        uint32_t       iPage    = 0;
+        uint64_t const nsStart  = RTTimeNanoTS();
+        for (uint32_t iLoop = 0; iLoop < cLoops; iLoop++)
+        {
+            RTGCPHYS const GCPhys = ((RTGCPHYS)iPage << PAGE_SHIFT) + (iLoop & 7) * sizeof(abBuf);
+            VBOXSTRICTRC rcStrict;
+            if (iLoop & 1)
+                rcStrict = PGMPhysWrite(pVM, GCPhys, abBuf, sizeof(abBuf), PGMACCESSORIGIN_DEVICE);
+            else
+                rcStrict = PGMPhysRead(pVM, GCPhys, abBuf, sizeof(abBuf), PGMACCESSORIGIN_DEVICE);
+            if (rcStrict != VINF_SUCCESS)
+            {
+                RTTestFailed(hTest, "PGMPhysRead/Write(%RGp) -> %Rrc\n", GCPhys, VBOXSTRICTRC_VAL(rcStrict));
+                return VINF_SUCCESS;
+            }
+            iPage = (iPage + 97) % cWsPages;
+        }
+        uint64_t const cNsElapsed = RTTimeNanoTS() - nsStart;
+        RTTestValueF(hTest, cNsElapsed / cLoops, RTTESTUNIT_NS_PER_CALL, "PGMPhysRead/Write, %u page working set", cWsPages);
+    }
+    return VINF_SUCCESS;
+}
+
+
 /** PDMR3LdrEnumModules callback, see FNPDMR3ENUM. */
 static DECLCALLBACK(int)
 tstVMMLdrEnum(PVM pVM, const char *pszFilename, const char *pszName, RTUINTPTR ImageBase, size_t cbImage,
@@ -215,7 +267,7 @@ extern "C" DECLEXPORT(int) TrustedMain(int argc, char **argv, char **envp)
     };
     enum
     {
-        kTstVMMTest_VMM,  kTstVMMTest_TM, kTstVMMTest_MSRs, kTstVMMTest_KnownMSRs, kTstVMMTest_MSRExperiments
+        kTstVMMTest_VMM,  kTstVMMTest_TM, kTstVMMTest_Phys, kTstVMMTest_MSRs, kTstVMMTest_KnownMSRs, kTstVMMTest_MSRExperiments
     } enmTestOpt = kTstVMMTest_VMM;
 
     int ch;
@@ -235,6 +287,8 @@ extern "C" DECLEXPORT(int) TrustedMain(int argc, char **argv, char **envp)
                     enmTestOpt = kTstVMMTest_VMM;
                 else if (!strcmp("tm", ValueUnion.psz))
                     enmTestOpt = kTstVMMTest_TM;
+                else if (!strcmp("phys", ValueUnion.psz))
+                    enmTestOpt = kTstVMMTest_Phys;
                 else if (!strcmp("msr", ValueUnion.psz) || !strcmp("msrs", ValueUnion.psz))
                     enmTestOpt = kTstVMMTest_MSRs;
                 else if (!strcmp("known-msr", ValueUnion.psz) || !strcmp("known-msrs", ValueUnion.psz))
@@ -249,7 +303,7 @@ extern "C" DECLEXPORT(int) TrustedMain(int argc, char **argv, char **envp)
                 break;
 
             case 'h':
-                RTPrintf("usage: tstVMM [--cpus|-c cpus] [--test <vmm|tm|msrs|known-msrs>]\n");
+                RTPrintf("usage: tstVMM [--cpus|-c cpus] [--test <vmm|tm|phys|msrs|known-msrs>]\n");
                 return 1;
 
             case 'V':
@@ -306,6 +360,16 @@ extern "C" DECLEXPORT(int) TrustedMain(int argc, char **argv, char **envp)
                 break;
             }
 
+            case kTstVMMTest_Phys:
+            {
+                RTTestSub(hTest, "Phys");
+                rc = VMR3ReqCallWaitU(pUVM, 0 /*idDstCpu*/, (PFNRT)tstPhysWorker, 2, pVM, hTest);
+                if (RT_FAILURE(rc))
+                    RTTestFailed(hTest, "tstPhysWorker failed: rc=%Rrc\n", rc);
+                STAMR3Dump(pUVM, "/PGM/R3/*Tlb*");
+                break;
+            }
+
             case kTstVMMTest_MSRs:
             {
                 RTTestSub(hTest, "MSRs");
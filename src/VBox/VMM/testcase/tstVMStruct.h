@@ -230,6 +230,9 @@
     GEN_CHECK_SIZE(DBGFCPU);
     GEN_CHECK_OFF(DBGFCPU, iActiveBp);
     GEN_CHECK_OFF(DBGFCPU, fSingleSteppingRaw);
+    GEN_CHECK_OFF(DBGFCPU, pTraceRingR3);
+    GEN_CHECK_OFF(DBGFCPU, pTraceRingR0);
+    GEN_CHECK_OFF(DBGFCPU, pTraceRingRC);
     //GEN_CHECK_OFF(DBGFCPU, pGuestRegSet);
     //GEN_CHECK_OFF(DBGFCPU, pHyperRegSet);
 
@@ -269,6 +272,24 @@
     GEN_CHECK_OFF(IOM, pTreesRC);
     GEN_CHECK_OFF(IOM, pTreesR3);
     GEN_CHECK_OFF(IOM, pTreesR0);
+    GEN_CHECK_OFF(IOM, pIOPortLookupR3);
+    GEN_CHECK_OFF(IOM, pIOPortLookupR0);
+    GEN_CHECK_OFF(IOM, pIOPortLookupRC);
+    GEN_CHECK_OFF(IOM, pau32PortCountersRC);
+    GEN_CHECK_OFF(IOM, pau32PortCountersR3);
+    GEN_CHECK_OFF(IOM, pau32PortCountersR0);
+
+    GEN_CHECK_SIZE(IOMIOPORTLOOKUP);
+    GEN_CHECK_OFF(IOMIOPORTLOOKUP, fValid);
+    GEN_CHECK_OFF(IOMIOPORTLOOKUP, cPages);
+    GEN_CHECK_OFF(IOMIOPORTLOOKUP, cSlots);
+    GEN_CHECK_OFF(IOMIOPORTLOOKUP, aiPages);
+    GEN_CHECK_OFF(IOMIOPORTLOOKUP, aPages);
+    GEN_CHECK_OFF(IOMIOPORTLOOKUP, aSlots);
+    GEN_CHECK_SIZE(IOMIOPORTLOOKUPSLOT);
+    GEN_CHECK_OFF(IOMIOPORTLOOKUPSLOT, pRangeR3);
+    GEN_CHECK_OFF(IOMIOPORTLOOKUPSLOT, pRangeR0);
+    GEN_CHECK_OFF(IOMIOPORTLOOKUPSLOT, pRangeRC);
 
     GEN_CHECK_SIZE(IOMCPU);
     GEN_CHECK_OFF(IOMCPU, DisState);
@@ -278,8 +299,15 @@
     GEN_CHECK_OFF(IOMCPU, pMMIOStatsLastR0);
     GEN_CHECK_OFF(IOMCPU, pMMIORangeLastRC);
     GEN_CHECK_OFF(IOMCPU, pMMIOStatsLastRC);
-    GEN_CHECK_OFF(IOMCPU, pRangeLastReadR0);
-    GEN_CHECK_OFF(IOMCPU, pRangeLastReadRC);
+    GEN_CHECK_OFF(IOMCPU, pStatsLastReadR0);
+    GEN_CHECK_OFF(IOMCPU, pStatsLastReadRC);
+    GEN_CHECK_OFF(IOMCPU, aMmioDecodeCache);
+    GEN_CHECK_OFF(IOMCPU, GCPtrMmioDecodeLastMiss);
+    GEN_CHECK_OFF(IOMCPU, iMmioDecodeNext);
+    GEN_CHECK_SIZE(IOMMMIODECODEENTRY);
+    GEN_CHECK_OFF(IOMMMIODECODEENTRY, GCPtrInstr);
+    GEN_CHECK_OFF(IOMMMIODECODEENTRY, abInstr);
+    GEN_CHECK_OFF(IOMMMIODECODEENTRY, idxGenReg);
 
     GEN_CHECK_SIZE(IOMMMIORANGE);
     GEN_CHECK_OFF(IOMMMIORANGE, GCPhys);
@@ -562,6 +590,10 @@
     GEN_CHECK_OFF(PDMQUEUE, pVMRC);
     GEN_CHECK_OFF(PDMQUEUE, cMilliesInterval);
     GEN_CHECK_OFF(PDMQUEUE, pTimer);
+    GEN_CHECK_OFF(PDMQUEUE, hEvtWorker);
+    GEN_CHECK_OFF(PDMQUEUE, hWorkerThread);
+    GEN_CHECK_OFF(PDMQUEUE, fWorkerSleeping);
+    GEN_CHECK_OFF(PDMQUEUE, fWorkerTerminate);
     GEN_CHECK_OFF(PDMQUEUE, cbItem);
     GEN_CHECK_OFF(PDMQUEUE, cItems);
     GEN_CHECK_OFF(PDMQUEUE, pPendingR3);
@@ -574,6 +606,8 @@
     GEN_CHECK_OFF(PDMQUEUE, StatInsert);
     GEN_CHECK_OFF(PDMQUEUE, StatFlush);
     GEN_CHECK_OFF(PDMQUEUE, StatFlushLeftovers);
+    GEN_CHECK_OFF(PDMQUEUE, StatWorkerWakeups);
+    GEN_CHECK_OFF(PDMQUEUE, StatWorkerBatches);
     GEN_CHECK_OFF(PDMQUEUE, aFreeItems);
     GEN_CHECK_OFF(PDMQUEUE, aFreeItems[1]);
     GEN_CHECK_OFF_DOT(PDMQUEUE, aFreeItems[0].pItemR3);
@@ -1119,6 +1153,8 @@
     GEN_CHECK_OFF(TMTIMER, offScheduleNext);
     GEN_CHECK_OFF(TMTIMER, offNext);
     GEN_CHECK_OFF(TMTIMER, offPrev);
+    GEN_CHECK_OFF(TMTIMER, aoffSkipNext);
+    GEN_CHECK_OFF(TMTIMER, aoffSkipPrev);
     GEN_CHECK_OFF(TMTIMER, pVMR0);
     GEN_CHECK_OFF(TMTIMER, pVMR3);
     GEN_CHECK_OFF(TMTIMER, pVMRC);
@@ -1132,6 +1168,7 @@
     GEN_CHECK_OFF(TMTIMERQUEUE, offActive);
     GEN_CHECK_OFF(TMTIMERQUEUE, offSchedule);
     GEN_CHECK_OFF(TMTIMERQUEUE, enmClock);
+    GEN_CHECK_OFF(TMTIMERQUEUE, aoffSkipHead);
 
     GEN_CHECK_SIZE(TRPM); // has .mac
     GEN_CHECK_SIZE(TRPMCPU); // has .mac
@@ -0,0 +1,311 @@
+/* $Id$ */
+/** @file
+ * VBoxTraceDecode - Decodes DBGF binary trace ring streams.
+ */
+
+/*
+ * Copyright (C) 2015 Oracle Corporation
+ *
+ * This file is part of VirtualBox Open Source Edition (OSE), as
+ * available from http://www.virtualbox.org. This file is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License (GPL) as published by the Free Software
+ * Foundation, in version 2 as it comes in the "COPYING" file of the
+ * VirtualBox OSE distribution. VirtualBox OSE is distributed in the
+ * hope that it will be useful, but WITHOUT ANY WARRANTY of any kind.
+ */
+
+
+/*********************************************************************************************************************************
+*   Header Files                                                                                                                 *
+*********************************************************************************************************************************/
+#include <iprt/buildconfig.h>
+#include <iprt/file.h>
+#include <iprt/getopt.h>
+#include <iprt/initterm.h>
+#include <iprt/message.h>
+#include <iprt/mem.h>
+#include <iprt/string.h>
+#include <iprt/stream.h>
+#include <iprt/time.h>
+
+#include <VBox/err.h>
+#include <VBox/vmm/dbgftrace.h>
+#include <VBox/vmm/dbgftracefmt.h>
+
+
+/*********************************************************************************************************************************
+*   Global Variables                                                                                                             *
+*********************************************************************************************************************************/
+/** Event names, indexed by DBGFTRACEEVT. */
+static const char * const g_apszEvtNames[DBGFTRACEEVT_END] =
+{
+    "invalid",
+    "vmexit",
+    "irq",
+    "ioport-read",
+    "ioport-write",
+    "mmio-read",
+    "mmio-write",
+};
+
+/** The stream header. */
+static DBGFTRACEFILEHDR     g_Hdr;
+/** Only decode entries from this virtual CPU (UINT32_MAX = all). */
+static uint32_t             g_idCpuFilter = UINT32_MAX;
+/** Only print the summary. */
+static bool                 g_fSummaryOnly = false;
+/** Number of entries per event type. */
+static uint64_t             g_acEvents[DBGFTRACEEVT_END + 1];
+/** Number of entries lost to ring overruns. */
+static uint64_t             g_cLost;
+/** Number of chunks. */
+static uint64_t             g_cChunks;
+
+
+/**
+ * Converts a host TSC value to nanoseconds since the start of the stream.
+ *
+ * @returns Nanoseconds, or TSC ticks if the frequency isn't known.
+ * @param   u64Tsc      The TSC value.
+ */
+static uint64_t traceTscToNs(uint64_t u64Tsc)
+{
+    uint64_t const cTicks = u64Tsc - g_Hdr.u64TscStart;
+    if (!g_Hdr.u64TscHz)
+        return cTicks;
+    return cTicks / g_Hdr.u64TscHz * RT_NS_1SEC
+         + cTicks % g_Hdr.u64TscHz * RT_NS_1SEC / g_Hdr.u64TscHz;
+}
+
+
+/**
+ * Prints one decoded entry and counts it.
+ *
+ * @param   idCpu       The virtual CPU which recorded the entry.
+ * @param   bEvt        The event type (DBGFTRACEEVT).
+ * @param   u64Tsc      The host TSC of the entry.
+ * @param   u32Arg      Event argument.
+ * @param   u64Arg1     Event argument.
+ * @param   u64Arg2     Event argument.
+ */
+static void tracePrintEntry(uint32_t idCpu, uint8_t bEvt, uint64_t u64Tsc, uint64_t u32Arg, uint64_t u64Arg1, uint64_t u64Arg2)
+{
+    g_acEvents[bEvt < DBGFTRACEEVT_END ? bEvt : DBGFTRACEEVT_END]++;
+    if (g_fSummaryOnly)
+        return;
+
+    uint64_t const uNs = traceTscToNs(u64Tsc);
+    RTPrintf("%'16RU64 cpu%02u %-12s ", uNs, idCpu, bEvt < DBGFTRACEEVT_END ? g_apszEvtNames[bEvt] : "unknown");
+    switch (bEvt)
+    {
+        case DBGFTRACEEVT_VMEXIT:
+            RTPrintf("reason=%#x rip=%#RX64 qual=%#RX64\n", (uint32_t)u32Arg, u64Arg1, u64Arg2);
+            break;
+        case DBGFTRACEEVT_IRQ:
+            RTPrintf("vector=%#04x tag=%#RX64 src=%s\n", (uint32_t)u32Arg, u64Arg1, u64Arg2 ? "apic" : "pic");
+            break;
+        case DBGFTRACEEVT_IOPORT_READ:
+        case DBGFTRACEEVT_IOPORT_WRITE:
+            RTPrintf("port=%#06x value=%#RX64 cb=%RU64\n", (uint32_t)u32Arg, u64Arg1, u64Arg2);
+            break;
+        case DBGFTRACEEVT_MMIO_READ:
+        case DBGFTRACEEVT_MMIO_WRITE:
+            RTPrintf("gcphys=%RGp value=%#RX64 cb=%u\n", u64Arg1, u64Arg2, (uint32_t)u32Arg);
+            break;
+        default:
+            RTPrintf("%#RX32 %#RX64 %#RX64\n", (uint32_t)u32Arg, u64Arg1, u64Arg2);
+            break;
+    }
+}
+
+
+/**
+ * Decodes the packed entries of one chunk.
+ *
+ * @returns VBox status code.
+ * @param   pChunk      The chunk header.
+ * @param   pbData      The packed entries.
+ */
+static int traceDecodeChunk(PCDBGFTRACECHUNKHDR pChunk, uint8_t const *pbData)
+{
+    g_cChunks++;
+    g_cLost += pChunk->cLost;
+    if (g_idCpuFilter != UINT32_MAX && pChunk->idCpu != g_idCpuFilter)
+        return VINF_SUCCESS;
+    if (pChunk->cLost && !g_fSummaryOnly)
+        RTPrintf("%16s cpu%02u %u entries lost\n", "", pChunk->idCpu, pChunk->cLost);
+
+    uint8_t const *pbEnd  = pbData + pChunk->cbData;
+    uint64_t       u64Tsc = pChunk->u64TscFirst;
+    for (uint32_t i = 0; i < pChunk->cEntries; i++)
+    {
+        if (pbData >= pbEnd)
+            return VERR_EOF;
+        uint8_t const bEvt = *pbData++;
+        uint64_t cTicks, u32Arg, u64Arg1, u64Arg2;
+        pbData = DBGFTraceUnpackU64(pbData, pbEnd, &cTicks);
+        if (pbData)
+            pbData = DBGFTraceUnpackU64(pbData, pbEnd, &u32Arg);
+        if (pbData)
+            pbData = DBGFTraceUnpackU64(pbData, pbEnd, &u64Arg1);
+        if (pbData)
+            pbData = DBGFTraceUnpackU64(pbData, pbEnd, &u64Arg2);
+        if (!pbData)
+            return VERR_INVALID_STATE;
+        u64Tsc += cTicks;
+        tracePrintEntry(pChunk->idCpu, bEvt, u64Tsc, u32Arg, u64Arg1, u64Arg2);
+    }
+    return pbData == pbEnd ? VINF_SUCCESS : VERR_INVALID_STATE;
+}
+
+
+/**
+ * Decodes a trace stream file.
+ *
+ * @returns Exit code.
+ * @param   pszFile     The file to decode.
+ */
+static RTEXITCODE traceDecodeFile(const char *pszFile)
+{
+    RTFILE hFile;
+    int rc = RTFileOpen(&hFile, pszFile, RTFILE_O_READ | RTFILE_O_OPEN | RTFILE_O_DENY_NONE);
+    if (RT_FAILURE(rc))
+        return RTMsgErrorExit(RTEXITCODE_FAILURE, "Error opening '%s': %Rrc", pszFile, rc);
+
+    /*
+     * The header.
+     */
+    RTEXITCODE rcExit = RTEXITCODE_SUCCESS;
+    rc = RTFileRead(hFile, &g_Hdr, sizeof(g_Hdr), NULL);
+    if (RT_FAILURE(rc))
+        rcExit = RTMsgErrorExit(RTEXITCODE_FAILURE, "Error reading the header of '%s': %Rrc", pszFile, rc);
+    else if (   memcmp(g_Hdr.szMagic, DBGFTRACEFILEHDR_MAGIC, sizeof(DBGFTRACEFILEHDR_MAGIC))
+             || RT_HI_U16(g_Hdr.u32Version) != RT_HI_U16(DBGFTRACEFILEHDR_VERSION)
+             || g_Hdr.cbHdr < sizeof(g_Hdr))
+        rcExit = RTMsgErrorExit(RTEXITCODE_FAILURE, "'%s' is not a binary trace stream (or an incompatible version)", pszFile);
+    else
+    {
+        if (g_Hdr.cbHdr > sizeof(g_Hdr))
+            rc = RTFileSeek(hFile, g_Hdr.cbHdr, RTFILE_SEEK_BEGIN, NULL);
+        if (!g_fSummaryOnly)
+        {
+            RTTIMESPEC Start;
+            char       szStart[64];
+            RTTIME     Time;
+            RTTimeToString(RTTimeExplode(&Time, RTTimeSpecSetNano(&Start, g_Hdr.i64UtcStart)), szStart, sizeof(szStart));
+            RTPrintf("Trace of %u CPU(s) started %s, %u ring entries, TSC %'RU64 Hz%s\n",
+                     g_Hdr.cCpus, szStart, g_Hdr.cRingEntries, g_Hdr.u64TscHz, g_Hdr.u64TscHz ? "" : " (times in ticks)");
+            RTPrintf("%16s cpu   event        arguments\n", "ns");
+        }
+
+        /*
+         * The chunks.  These are in drain order, so entries from different
+         * CPUs are only roughly ordered in time.
+         */
+        size_t   cbBuf = 0;
+        uint8_t *pbBuf = NULL;
+        while (RT_SUCCESS(rc))
+        {
+            DBGFTRACECHUNKHDR Chunk;
+            size_t            cbRead = 0;
+            rc = RTFileRead(hFile, &Chunk, sizeof(Chunk), &cbRead);
+            if (RT_FAILURE(rc) || cbRead == 0)
+                break;
+            if (cbRead != sizeof(Chunk) || Chunk.u32Magic != DBGFTRACECHUNKHDR_MAGIC || Chunk.cbData > _16M)
+            {
+                rc = VERR_INVALID_MAGIC;
+                break;
+            }
+            if (Chunk.cbData > cbBuf)
+            {
+                void *pvNew = RTMemRealloc(pbBuf, Chunk.cbData);
+                if (!pvNew)
+                {
+                    rc = VERR_NO_MEMORY;
+                    break;
+                }
+                pbBuf = (uint8_t *)pvNew;
+                cbBuf = Chunk.cbData;
+            }
+            rc = RTFileRead(hFile, pbBuf, Chunk.cbData, NULL);
+            if (RT_SUCCESS(rc))
+                rc = traceDecodeChunk(&Chunk, pbBuf);
+        }
+        RTMemFree(pbBuf);
+        if (RT_FAILURE(rc))
+        {
+            uint64_t offFile = 0;
+            RTFileSeek(hFile, 0, RTFILE_SEEK_CURRENT, &offFile);
+            rcExit = RTMsgErrorExit(RTEXITCODE_FAILURE, "Corrupt or truncated stream near offset %#RX64: %Rrc", offFile, rc);
+        }
+
+        /*
+         * The summary.
+         */
+        RTPrintf("\n%'RU64 chunks, %'RU64 entries lost to ring overruns\n", g_cChunks, g_cLost);
+        for (unsigned i = 0; i <= DBGFTRACEEVT_END; i++)
+            if (g_acEvents[i])
+                RTPrintf("%'14RU64 %s\n", g_acEvents[i], i < DBGFTRACEEVT_END ? g_apszEvtNames[i] : "unknown");
+    }
+
+    RTFileClose(hFile);
+    return rcExit;
+}
+
+
+int main(int argc, char **argv)
+{
+    int rc = RTR3InitExe(argc, &argv, 0 /*fFlags*/);
+    if (RT_FAILURE(rc))
+        return RTMsgInitFailure(rc);
+
+    static const RTGETOPTDEF s_aOptions[] =
+    {
+        { "--cpu",      'c', RTGETOPT_REQ_UINT32  },
+        { "--summary",  's', RTGETOPT_REQ_NOTHING },
+    };
+    RTGETOPTSTATE State;
+    RTGetOptInit(&State, argc, argv, &s_aOptions[0], RT_ELEMENTS(s_aOptions), 1, RTGETOPTINIT_FLAGS_OPTS_FIRST);
+
+    RTEXITCODE rcExit = RTEXITCODE_SUCCESS;
+    unsigned   cFiles = 0;
+    int iOpt;
+    RTGETOPTUNION ValueUnion;
+    while ((iOpt = RTGetOpt(&State, &ValueUnion)) != 0)
+    {
+        switch (iOpt)
+        {
+            case 'c':
+                g_idCpuFilter = ValueUnion.u32;
+                break;
+
+            case 's':
+                g_fSummaryOnly = true;
+                break;
+
+            case VINF_GETOPT_NOT_OPTION:
+                cFiles++;
+                RT_ZERO(g_acEvents);
+                g_cLost   = 0;
+                g_cChunks = 0;
+                if (traceDecodeFile(ValueUnion.psz) != RTEXITCODE_SUCCESS)
+                    rcExit = RTEXITCODE_FAILURE;
+                break;
+
+            case 'h':
+                RTPrintf("Usage: VBoxTraceDecode [-c|--cpu <id>] [-s|--summary] [-h|--help] [-V|--version] <trace-file> [..]\n");
+                RTPrintf("Decodes the binary trace ring streams written when DBGF/TraceRingFile is configured.\n");
+                return RTEXITCODE_SUCCESS;
+            case 'V':
+                RTPrintf("%sr%s\n", RTBldCfgVersion(), RTBldCfgRevisionStr());
+                return RTEXITCODE_SUCCESS;
+            default:
+                return RTGetOptPrintError(iOpt, &ValueUnion);
+        }
+    }
+    if (!cFiles)
+        return RTMsgErrorExit(RTEXITCODE_SYNTAX, "No trace file given, try --help");
+    return rcExit;
+}
+